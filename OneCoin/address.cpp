@@ -0,0 +1,37 @@
+#include "address.h"
+#include "encoding.h"
+
+#include <algorithm>
+
+bool DecodeAddress(const std::string& str, const ChainParams& params, Script& scriptPubKey)
+{
+    std::vector<unsigned char> data;
+    if (!DecodeBase58Check(str, data))
+        return false;
+    const std::vector<unsigned char>& pubkey_prefix = params.Base58Prefix(ChainParams::PUBKEY_ADDRESS);
+    const std::vector<unsigned char>& script_prefix = params.Base58Prefix(ChainParams::SCRIPT_ADDRESS);
+    if (data.size() == pubkey_prefix.size() + 20 && std::equal(pubkey_prefix.begin(), pubkey_prefix.end(), data.begin())) {
+        scriptPubKey = GetScriptForPubKeyHash(&data[pubkey_prefix.size()]);
+        return true;
+    }
+    if (data.size() == script_prefix.size() + 20 && std::equal(script_prefix.begin(), script_prefix.end(), data.begin())) {
+        scriptPubKey = GetScriptForScriptHash(&data[script_prefix.size()]);
+        return true;
+    }
+    return false;
+}
+
+std::string EncodeAddress(const Script& scriptPubKey, const ChainParams& params)
+{
+    std::vector<unsigned char> data;
+    if (scriptPubKey.IsPayToPubKeyHash()) {
+        data = params.Base58Prefix(ChainParams::PUBKEY_ADDRESS);
+        data.insert(data.end(), scriptPubKey.begin() + 3, scriptPubKey.begin() + 23);
+    } else if (scriptPubKey.IsPayToScriptHash()) {
+        data = params.Base58Prefix(ChainParams::SCRIPT_ADDRESS);
+        data.insert(data.end(), scriptPubKey.begin() + 2, scriptPubKey.begin() + 22);
+    } else {
+        return std::string();
+    }
+    return EncodeBase58Check(data);
+}
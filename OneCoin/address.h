@@ -0,0 +1,15 @@
+#ifndef ONECOIN_ADDRESS_H
+#define ONECOIN_ADDRESS_H
+
+#include "chainparams.h"
+#include "script.h"
+
+#include <string>
+
+/** Output script for a Base58Check P2PKH or P2SH address of this network. */
+bool DecodeAddress(const std::string& str, const ChainParams& params, Script& scriptPubKey);
+
+/** Address for a P2PKH or P2SH output script; empty for other scripts. */
+std::string EncodeAddress(const Script& scriptPubKey, const ChainParams& params);
+
+#endif // ONECOIN_ADDRESS_H
@@ -0,0 +1,206 @@
+#include "addrindex.h"
+#include "hash.h"
+#include "serialize.h"
+
+#include <string.h>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+/** Entries are under 'a' + script hash + big-endian height and position
+ *  in the block + SPEND or RECEIVE + big-endian input or output index, so
+ *  a script's entries sort in chain order with a transaction's inputs
+ *  before its outputs. */
+const char DB_ADDRESS = 'a';
+const char ENTRY_SPEND = 0;
+const char ENTRY_RECEIVE = 1;
+const size_t ENTRY_KEY_SIZE = 1 + 32 + 4 + 4 + 1 + 4;
+
+void AppendBE32(std::string& s, uint32_t n)
+{
+    for (int i = 0; i < 4; i++)
+        s.push_back((char)(n >> (24 - 8 * i)));
+}
+
+uint32_t ReadBE32(const unsigned char* p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+std::string ScriptPrefix(const uint256& scriptHash)
+{
+    std::string key(1, DB_ADDRESS);
+    key.append((const char*)scriptHash.begin(), 32);
+    return key;
+}
+
+std::string EntryKey(const uint256& scriptHash, int nHeight, uint32_t nTxPos, char type, uint32_t n)
+{
+    std::string key = ScriptPrefix(scriptHash);
+    AppendBE32(key, (uint32_t)nHeight);
+    AppendBE32(key, nTxPos);
+    key.push_back(type);
+    AppendBE32(key, n);
+    return key;
+}
+
+/** The first key after every key starting with prefix. */
+std::string PrefixEnd(std::string prefix)
+{
+    while (!prefix.empty() && (unsigned char)prefix.back() == 0xff)
+        prefix.pop_back();
+    if (!prefix.empty())
+        prefix.back()++;
+    return prefix;
+}
+
+/** An entry of one block, written or, for a disconnected block, deleted. */
+struct Record {
+    std::string key;
+    std::string value;
+};
+
+} // namespace
+
+AddrIndex::AddrIndex(const std::string& dir, Chainstate& chainstate) : BaseIndex("address index", dir, chainstate)
+{
+    SetThreads(std::thread::hardware_concurrency());
+}
+
+AddrIndex::~AddrIndex()
+{
+    Stop();
+}
+
+void AddrIndex::SetThreads(unsigned int nThreads)
+{
+    workers.reset(new WorkerPool(nThreads > 1 ? nThreads : 1));
+}
+
+uint256 AddrIndex::GetScriptHash(const Script& script)
+{
+    unsigned char hash[32];
+    Sha256().Write(script.data(), script.size()).Finalize(hash);
+    return uint256(hash);
+}
+
+void AddrIndex::GetHistory(const uint256& scriptHash, std::vector<AddrIndexEntry>& entries) const
+{
+    entries.clear();
+    if (!store)
+        return;
+    std::string prefix = ScriptPrefix(scriptHash);
+    store->Scan(prefix, PrefixEnd(prefix), [&](const std::string& key, const std::string& value) {
+        if (key.size() != ENTRY_KEY_SIZE)
+            throw std::runtime_error("corrupt key in the address index");
+        const unsigned char* p = (const unsigned char*)key.data() + prefix.size();
+        AddrIndexEntry entry;
+        entry.nHeight = (int)ReadBE32(p);
+        entry.fSpend = p[8] == ENTRY_SPEND;
+        entry.n = ReadBE32(p + 9);
+        try {
+            ByteReader r((const unsigned char*)value.data(), value.size());
+            unsigned char hash[32];
+            r.ReadBytes(hash, sizeof(hash));
+            entry.txid = uint256(hash);
+            entry.nValue = (Amount)r.ReadVarInt();
+            if (entry.fSpend) {
+                r.ReadBytes(hash, sizeof(hash));
+                uint64_t n = r.ReadVarInt();
+                if (n > UINT32_MAX)
+                    throw SerializeError("output index out of range");
+                entry.prevout = OutPoint(uint256(hash), (uint32_t)n);
+            }
+            if (!r.Empty())
+                throw SerializeError("trailing bytes");
+        } catch (const SerializeError&) {
+            throw std::runtime_error("corrupt entry in the address index");
+        }
+        entries.push_back(entry);
+        return true;
+    });
+}
+
+Amount AddrIndex::GetBalance(const uint256& scriptHash) const
+{
+    std::vector<AddrIndexEntry> entries;
+    GetHistory(scriptHash, entries);
+    Amount nBalance = 0;
+    for (size_t i = 0; i < entries.size(); i++)
+        nBalance += entries[i].fSpend ? -entries[i].nValue : entries[i].nValue;
+    return nBalance;
+}
+
+void AddrIndex::WriteBlocks(const std::vector<BlockRef>& blocks, const uint256& hashBest)
+{
+    // Entries of block i that fall in shard s go to records[i * nShards + s],
+    // so each shard writes its own in block order.
+    const size_t nShards = workers->Size();
+    std::vector<std::vector<Record> > records(blocks.size() * nShards);
+    workers->Run(blocks.size(), [&](size_t i) {
+        const BlockRef& ref = blocks[i];
+        Block block;
+        BlockUndo undo;
+        ReadBlock(ref, block);
+        if (block.vtx.size() > 1)
+            ReadUndo(ref, undo);
+        if (undo.vtxundo.size() + 1 != block.vtx.size())
+            throw std::runtime_error("undo data does not match block " + ref.hashBlock.GetHex());
+
+        std::vector<unsigned char> value;
+        auto add = [&](const uint256& scriptHash, uint32_t nTxPos, char type, uint32_t n) {
+            Record record;
+            record.key = EntryKey(scriptHash, ref.nHeight, nTxPos, type, n);
+            record.value.assign(value.begin(), value.end());
+            records[i * nShards + scriptHash.begin()[0] % nShards].push_back(std::move(record));
+        };
+        for (size_t j = 0; j < block.vtx.size(); j++) {
+            const Transaction& tx = *block.vtx[j];
+            if (j > 0) {
+                const TxUndo& txundo = undo.vtxundo[j - 1];
+                if (txundo.vprevout.size() != tx.vin.size())
+                    throw std::runtime_error("undo data does not match block " + ref.hashBlock.GetHex());
+                for (size_t k = 0; k < tx.vin.size(); k++) {
+                    const TxOut& spent = txundo.vprevout[k].out;
+                    value.clear();
+                    ByteWriter w(value);
+                    w.WriteBytes(tx.GetHash().begin(), 32);
+                    w.WriteVarInt((uint64_t)spent.nValue);
+                    w.WriteBytes(tx.vin[k].prevout.hash.begin(), 32);
+                    w.WriteVarInt(tx.vin[k].prevout.n);
+                    add(GetScriptHash(spent.scriptPubKey), (uint32_t)j, ENTRY_SPEND, (uint32_t)k);
+                }
+            }
+            for (size_t k = 0; k < tx.vout.size(); k++) {
+                if (tx.vout[k].scriptPubKey.IsUnspendable())
+                    continue;
+                value.clear();
+                ByteWriter w(value);
+                w.WriteBytes(tx.GetHash().begin(), 32);
+                w.WriteVarInt((uint64_t)tx.vout[k].nValue);
+                add(GetScriptHash(tx.vout[k].scriptPubKey), (uint32_t)j, ENTRY_RECEIVE, (uint32_t)k);
+            }
+        }
+    });
+
+    // A block connected and disconnected within the batch ends up without
+    // entries, since a key always falls in the same shard.
+    workers->Run(nShards, [&](size_t s) {
+        LsmWriteBatch batch;
+        for (size_t i = 0; i < blocks.size(); i++) {
+            const std::vector<Record>& shard = records[i * nShards + s];
+            for (size_t j = 0; j < shard.size(); j++) {
+                if (blocks[i].fConnect)
+                    batch.Put(shard[j].key, shard[j].value);
+                else
+                    batch.Delete(shard[j].key);
+            }
+        }
+        if (batch.Count())
+            store->Write(batch);
+    });
+    LsmWriteBatch batch;
+    PutBestBlock(batch, hashBest);
+    store->Write(batch);
+}
@@ -0,0 +1,74 @@
+#ifndef ONECOIN_ADDRINDEX_H
+#define ONECOIN_ADDRINDEX_H
+
+#include "amount.h"
+#include "baseindex.h"
+#include "script.h"
+#include "transaction.h"
+#include "uint256.h"
+#include "workqueue.h"
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+/** One payment to or from a script on the active chain. */
+struct AddrIndexEntry {
+    int nHeight;
+    /** Whether the script's coin was spent rather than received. */
+    bool fSpend;
+    /** The receiving transaction and output, or the spending transaction
+     *  and input. */
+    uint256 txid;
+    uint32_t n;
+    Amount nValue;
+    /** For a spend, the outpoint spent. */
+    OutPoint prevout;
+
+    AddrIndexEntry() : nHeight(0), fSpend(false), n(0), nValue(0) {}
+};
+
+/**
+ * An optional index from script hash, the SHA-256 of an output script, to
+ * every output paying the script and every input spending one of those
+ * outputs, with their heights and amounts. The outputs of an address are
+ * those paying its script, so the index answers address history and
+ * balance queries with one range scan. See BaseIndex for how it is kept up
+ * to date.
+ *
+ * Entries sort by script hash, then height, position in the block and
+ * input or output index. A batch of blocks is indexed in parallel: the
+ * worker threads read the blocks and their undo data, which holds the
+ * scripts the inputs spend, and hash the scripts; then each takes a shard
+ * of the script hashes and writes its entries as one store write. Building
+ * the index after a reindex is where this pays off; after that it takes a
+ * block at a time.
+ *
+ * Entries of disconnected blocks are removed.
+ */
+class AddrIndex : public BaseIndex {
+public:
+    AddrIndex(const std::string& dir, Chainstate& chainstate);
+    ~AddrIndex();
+
+    /** Threads that index a batch of blocks, the index's own included.
+     *  Defaults to the number of cores; set before Start(). */
+    void SetThreads(unsigned int nThreads);
+    unsigned int GetThreads() const { return workers->Size(); }
+
+    static uint256 GetScriptHash(const Script& script);
+
+    /** Every entry of the script in chain order. */
+    void GetHistory(const uint256& scriptHash, std::vector<AddrIndexEntry>& entries) const;
+    /** What the script received minus what it spent. */
+    Amount GetBalance(const uint256& scriptHash) const;
+
+protected:
+    void WriteBlocks(const std::vector<BlockRef>& blocks, const uint256& hashBest);
+
+private:
+    std::unique_ptr<WorkerPool> workers;
+};
+
+#endif // ONECOIN_ADDRINDEX_H
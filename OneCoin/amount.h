@@ -0,0 +1,17 @@
+#ifndef ONECOIN_AMOUNT_H
+#define ONECOIN_AMOUNT_H
+
+#include <stdint.h>
+
+/** Amounts are counted in the smallest unit, 1e-8 of a coin. */
+typedef int64_t Amount;
+
+static const Amount COIN = 100000000;
+static const Amount MAX_MONEY = 21000000 * COIN;
+
+inline bool MoneyRange(Amount nValue)
+{
+    return nValue >= 0 && nValue <= MAX_MONEY;
+}
+
+#endif // ONECOIN_AMOUNT_H
@@ -0,0 +1,209 @@
+#include "arith_uint256.h"
+
+namespace {
+
+/** Full 64x64 -> 128-bit product. */
+inline uint64_t MulHiLo(uint64_t a, uint64_t b, uint64_t& hi)
+{
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 r = (unsigned __int128)a * b;
+    hi = (uint64_t)(r >> 64);
+    return (uint64_t)r;
+#else
+    uint64_t a_lo = (uint32_t)a, a_hi = a >> 32, b_lo = (uint32_t)b, b_hi = b >> 32;
+    uint64_t ll = a_lo * b_lo, lh = a_lo * b_hi, hl = a_hi * b_lo, hh = a_hi * b_hi;
+    uint64_t mid = (ll >> 32) + (uint32_t)lh + (uint32_t)hl;
+    hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+    return (mid << 32) | (uint32_t)ll;
+#endif
+}
+
+} // namespace
+
+arith_uint256& arith_uint256::SetCompact(uint32_t nCompact, bool* pfNegative, bool* pfOverflow)
+{
+    *this = FromCompact(nCompact);
+    if (pfNegative)
+        *pfNegative = CompactIsNegative(nCompact);
+    if (pfOverflow)
+        *pfOverflow = CompactOverflows(nCompact);
+    return *this;
+}
+
+uint32_t arith_uint256::GetCompact(bool fNegative) const
+{
+    int nSize = (bits() + 7) / 8;
+    uint32_t nCompact = 0;
+    if (nSize <= 3) {
+        nCompact = (uint32_t)(GetLow64() << 8 * (3 - nSize));
+    } else {
+        arith_uint256 bn = *this >> 8 * (nSize - 3);
+        nCompact = (uint32_t)bn.GetLow64();
+    }
+    // The 0x00800000 bit denotes the sign, so if it is already set, divide
+    // the mantissa by 256 and increase the exponent.
+    if (nCompact & 0x00800000) {
+        nCompact >>= 8;
+        nSize++;
+    }
+    nCompact |= nSize << 24;
+    nCompact |= (fNegative && (nCompact & 0x007fffff) ? 0x00800000 : 0);
+    return nCompact;
+}
+
+arith_uint256& arith_uint256::operator+=(const arith_uint256& b)
+{
+    uint64_t carry = 0;
+    for (int i = 0; i < LIMBS; i++) {
+        uint64_t s = pn[i] + carry;
+        uint64_t c1 = s < carry;
+        pn[i] = s + b.pn[i];
+        carry = c1 | (pn[i] < s);
+    }
+    return *this;
+}
+
+arith_uint256& arith_uint256::operator-=(const arith_uint256& b)
+{
+    uint64_t borrow = 0;
+    for (int i = 0; i < LIMBS; i++) {
+        uint64_t d = pn[i] - b.pn[i];
+        uint64_t out = (uint64_t)(pn[i] < b.pn[i]) | (uint64_t)(d < borrow);
+        pn[i] = d - borrow;
+        borrow = out;
+    }
+    return *this;
+}
+
+arith_uint256& arith_uint256::operator*=(uint32_t b)
+{
+    uint64_t carry = 0;
+    for (int i = 0; i < LIMBS; i++) {
+        uint64_t hi;
+        uint64_t lo = MulHiLo(pn[i], b, hi);
+        pn[i] = lo + carry;
+        carry = hi + (pn[i] < lo);
+    }
+    return *this;
+}
+
+arith_uint256& arith_uint256::operator*=(const arith_uint256& b)
+{
+    uint64_t r[LIMBS] = {0, 0, 0, 0};
+    for (int j = 0; j < LIMBS; j++) {
+        uint64_t carry = 0;
+        for (int i = 0; i + j < LIMBS; i++) {
+            uint64_t hi;
+            uint64_t lo = MulHiLo(pn[j], b.pn[i], hi);
+            uint64_t s = r[i + j] + lo;
+            hi += s < lo;
+            r[i + j] = s + carry;
+            carry = hi + (r[i + j] < s);
+        }
+    }
+    for (int i = 0; i < LIMBS; i++)
+        pn[i] = r[i];
+    return *this;
+}
+
+arith_uint256& arith_uint256::operator/=(const arith_uint256& b)
+{
+    arith_uint256 div = b;
+    arith_uint256 num = *this;
+    *this = arith_uint256();
+    int num_bits = num.bits();
+    int div_bits = div.bits();
+    if (div_bits == 0 || div_bits > num_bits)
+        return *this;
+    // Shift-subtract, starting at the highest possible quotient bit so the
+    // loop runs once per quotient bit rather than once per bit of width.
+    int shift = num_bits - div_bits;
+    div <<= shift;
+    while (shift >= 0) {
+        if (num >= div) {
+            num -= div;
+            pn[shift / 64] |= (uint64_t)1 << (shift % 64);
+        }
+        div >>= 1;
+        shift--;
+    }
+    return *this;
+}
+
+arith_uint256& arith_uint256::operator<<=(unsigned int shift)
+{
+    uint64_t a[LIMBS];
+    for (int i = 0; i < LIMBS; i++)
+        a[i] = pn[i];
+    int k = shift / 64;
+    shift %= 64;
+    for (int i = LIMBS - 1; i >= 0; i--) {
+        uint64_t v = 0;
+        if (i - k >= 0) {
+            v = a[i - k] << shift;
+            if (shift && i - k - 1 >= 0)
+                v |= a[i - k - 1] >> (64 - shift);
+        }
+        pn[i] = v;
+    }
+    return *this;
+}
+
+arith_uint256& arith_uint256::operator>>=(unsigned int shift)
+{
+    uint64_t a[LIMBS];
+    for (int i = 0; i < LIMBS; i++)
+        a[i] = pn[i];
+    int k = shift / 64;
+    shift %= 64;
+    for (int i = 0; i < LIMBS; i++) {
+        uint64_t v = 0;
+        if (i + k < LIMBS) {
+            v = a[i + k] >> shift;
+            if (shift && i + k + 1 < LIMBS)
+                v |= a[i + k + 1] << (64 - shift);
+        }
+        pn[i] = v;
+    }
+    return *this;
+}
+
+unsigned int arith_uint256::bits() const
+{
+    for (int pos = LIMBS - 1; pos >= 0; pos--) {
+        if (pn[pos])
+            return 64 * pos + (64 - __builtin_clzll(pn[pos]));
+    }
+    return 0;
+}
+
+double arith_uint256::getdouble() const
+{
+    double ret = 0;
+    for (int i = LIMBS - 1; i >= 0; i--)
+        ret = ret * 18446744073709551616.0 + (double)pn[i];
+    return ret;
+}
+
+std::string arith_uint256::GetHex() const
+{
+    return ArithToUint256(*this).GetHex();
+}
+
+uint256 ArithToUint256(const arith_uint256& a)
+{
+    unsigned char bytes[32];
+    for (int i = 0; i < arith_uint256::LIMBS; i++) {
+        for (int j = 0; j < 8; j++)
+            bytes[8 * i + j] = (unsigned char)(a.pn[i] >> (8 * j));
+    }
+    return uint256(bytes);
+}
+
+arith_uint256 UintToArith256(const uint256& a)
+{
+    arith_uint256 r;
+    for (int i = 0; i < arith_uint256::LIMBS; i++)
+        r.pn[i] = a.GetUint64(i);
+    return r;
+}
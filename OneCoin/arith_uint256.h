@@ -0,0 +1,130 @@
+#ifndef ONECOIN_ARITH_UINT256_H
+#define ONECOIN_ARITH_UINT256_H
+
+#include "uint256.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+/** Unsigned 256-bit integer on four 64-bit limbs (least significant first).
+ *  A plain value type: nothing here allocates, so targets and chainwork can
+ *  be handled per header without touching the heap. */
+class arith_uint256 {
+public:
+    static const int LIMBS = 4;
+
+    constexpr arith_uint256() : pn{0, 0, 0, 0} {}
+    constexpr arith_uint256(uint64_t b) : pn{b, 0, 0, 0} {}
+    constexpr arith_uint256(uint64_t l0, uint64_t l1, uint64_t l2, uint64_t l3) : pn{l0, l1, l2, l3} {}
+
+    /** Decodes the compact "nBits" representation used in block headers,
+     *  ignoring the sign and overflow conditions. Usable in constant
+     *  expressions, e.g. for chain parameters. */
+    static constexpr arith_uint256 FromCompact(uint32_t nCompact)
+    {
+        return CompactSize(nCompact) <= 3
+                   ? arith_uint256(CompactMantissa(nCompact))
+                   : arith_uint256(CompactLimb(nCompact, 0), CompactLimb(nCompact, 1),
+                         CompactLimb(nCompact, 2), CompactLimb(nCompact, 3));
+    }
+    static constexpr bool CompactIsNegative(uint32_t nCompact)
+    {
+        return CompactMantissa(nCompact) != 0 && (nCompact & 0x00800000) != 0;
+    }
+    static constexpr bool CompactOverflows(uint32_t nCompact)
+    {
+        return CompactMantissa(nCompact) != 0 &&
+               (CompactSize(nCompact) > 34 ||
+                   (CompactWord(nCompact) > 0xff && CompactSize(nCompact) > 33) ||
+                   (CompactWord(nCompact) > 0xffff && CompactSize(nCompact) > 32));
+    }
+
+    /** Sets the value from nBits and reports the error conditions consensus
+     *  code must reject. */
+    arith_uint256& SetCompact(uint32_t nCompact, bool* pfNegative = NULL, bool* pfOverflow = NULL);
+    uint32_t GetCompact(bool fNegative = false) const;
+
+    /** Branch-free comparisons: the result comes out of a borrow chain over
+     *  all four limbs instead of an early-exit loop. */
+    friend bool operator<(const arith_uint256& a, const arith_uint256& b) { return SubBorrows(a, b); }
+    friend bool operator>(const arith_uint256& a, const arith_uint256& b) { return SubBorrows(b, a); }
+    friend bool operator<=(const arith_uint256& a, const arith_uint256& b) { return !SubBorrows(b, a); }
+    friend bool operator>=(const arith_uint256& a, const arith_uint256& b) { return !SubBorrows(a, b); }
+    friend bool operator==(const arith_uint256& a, const arith_uint256& b)
+    {
+        return ((a.pn[0] ^ b.pn[0]) | (a.pn[1] ^ b.pn[1]) | (a.pn[2] ^ b.pn[2]) | (a.pn[3] ^ b.pn[3])) == 0;
+    }
+    friend bool operator!=(const arith_uint256& a, const arith_uint256& b) { return !(a == b); }
+    /** -1, 0 or 1. */
+    int CompareTo(const arith_uint256& b) const { return (int)SubBorrows(b, *this) - (int)SubBorrows(*this, b); }
+
+    arith_uint256& operator+=(const arith_uint256& b);
+    arith_uint256& operator-=(const arith_uint256& b);
+    arith_uint256& operator*=(uint32_t b);
+    arith_uint256& operator*=(const arith_uint256& b);
+    /** Division by zero yields zero; callers check divisors where it matters. */
+    arith_uint256& operator/=(const arith_uint256& b);
+    arith_uint256& operator<<=(unsigned int shift);
+    arith_uint256& operator>>=(unsigned int shift);
+    arith_uint256& operator++() { return *this += 1; }
+
+    arith_uint256 operator~() const { return arith_uint256(~pn[0], ~pn[1], ~pn[2], ~pn[3]); }
+    friend arith_uint256 operator+(arith_uint256 a, const arith_uint256& b) { return a += b; }
+    friend arith_uint256 operator-(arith_uint256 a, const arith_uint256& b) { return a -= b; }
+    friend arith_uint256 operator*(arith_uint256 a, uint32_t b) { return a *= b; }
+    friend arith_uint256 operator*(arith_uint256 a, const arith_uint256& b) { return a *= b; }
+    friend arith_uint256 operator/(arith_uint256 a, const arith_uint256& b) { return a /= b; }
+    friend arith_uint256 operator<<(arith_uint256 a, unsigned int shift) { return a <<= shift; }
+    friend arith_uint256 operator>>(arith_uint256 a, unsigned int shift) { return a >>= shift; }
+
+    /** Position of the highest set bit plus one; zero for zero. */
+    unsigned int bits() const;
+    constexpr uint64_t GetLow64() const { return pn[0]; }
+    constexpr uint64_t GetLimb(int i) const { return pn[i]; }
+    /** Approximate value, for difficulty reporting. */
+    double getdouble() const;
+    std::string GetHex() const;
+
+    friend uint256 ArithToUint256(const arith_uint256& a);
+    friend arith_uint256 UintToArith256(const uint256& a);
+
+private:
+    uint64_t pn[LIMBS];
+
+    static constexpr uint32_t CompactSize(uint32_t nCompact) { return nCompact >> 24; }
+    static constexpr uint64_t CompactWord(uint32_t nCompact) { return nCompact & 0x007fffff; }
+    /** The word after dropping bytes that fall below the exponent. */
+    static constexpr uint64_t CompactMantissa(uint32_t nCompact)
+    {
+        return CompactSize(nCompact) <= 3 ? CompactWord(nCompact) >> (8 * (3 - CompactSize(nCompact)))
+                                          : CompactWord(nCompact);
+    }
+    /** Limb i of CompactWord << 8 * (size - 3), for size > 3. */
+    static constexpr uint64_t CompactLimb(uint32_t nCompact, int i)
+    {
+        return CompactShiftedLimb(CompactWord(nCompact), 8 * (CompactSize(nCompact) - 3), i);
+    }
+    static constexpr uint64_t CompactShiftedLimb(uint64_t word, uint32_t shift, int i)
+    {
+        return ((uint32_t)i == shift / 64 ? word << (shift % 64) : 0) |
+               ((uint32_t)i == shift / 64 + 1 && shift % 64 ? word >> (64 - shift % 64) : 0);
+    }
+
+    /** True when a - b borrows, i.e. a < b. */
+    static bool SubBorrows(const arith_uint256& a, const arith_uint256& b)
+    {
+        uint64_t borrow = 0;
+        for (int i = 0; i < LIMBS; i++) {
+            uint64_t d = a.pn[i] - b.pn[i];
+            uint64_t out = (uint64_t)(a.pn[i] < b.pn[i]) | (uint64_t)(d < borrow);
+            borrow = out;
+        }
+        return borrow != 0;
+    }
+};
+
+uint256 ArithToUint256(const arith_uint256& a);
+arith_uint256 UintToArith256(const uint256& a);
+
+#endif // ONECOIN_ARITH_UINT256_H
@@ -0,0 +1,235 @@
+#include "baseindex.h"
+#include "fs.h"
+
+#include <stdexcept>
+
+namespace {
+
+/** Hash of the last block indexed. */
+const char DB_BEST_BLOCK = 'B';
+
+} // namespace
+
+BaseIndex::BaseIndex(const std::string& name, const std::string& dir, Chainstate& chainstate)
+    : name(name), dir(dir), blockStore(chainstate.GetBlockStore()), chainstate(chainstate), fBusy(false),
+      fStop(false), fRegistered(false), nBestHeight(-1)
+{
+}
+
+BaseIndex::~BaseIndex()
+{
+    Stop();
+}
+
+bool BaseIndex::Start(std::string& error)
+{
+    if (store) {
+        error = "the " + name + " is already running";
+        return false;
+    }
+    if (chainstate.IsPruneMode()) {
+        error = "the " + name + " is not available in prune mode";
+        return false;
+    }
+    std::unique_ptr<LsmStore> opened(new LsmStore(dir));
+    if (!opened->Open(error))
+        return false;
+
+    // Resume after the last indexed block still on the active chain; the
+    // blocks above it that left the chain are rolled back first.
+    const ActiveChain& chain = chainstate.GetActiveChain();
+    std::string value;
+    bool fRebuild = false;
+    const BlockIndex* pindexBest = NULL;
+    if (opened->Get(std::string(1, DB_BEST_BLOCK), value)) {
+        if (value.size() == 32)
+            pindexBest = chainstate.LookupBlockIndex(uint256((const unsigned char*)value.data()));
+        fRebuild = !pindexBest;
+    }
+    const BlockIndex* pindexFork = pindexBest;
+    for (; pindexFork && !chain.Contains(pindexFork); pindexFork = pindexFork->pprev) {
+        // A stale block connected before the last restart only; its undo
+        // data is not known.
+        if (!(pindexFork->nStatus & BLOCK_HAVE_UNDO))
+            fRebuild = true;
+    }
+    if (fRebuild) {
+        // The index's blocks cannot be rolled back: start it afresh.
+        opened->Close();
+        if (!RemoveAll(dir) || !opened->Open(error)) {
+            error = "cannot rebuild the " + name + " in " + dir;
+            return false;
+        }
+        pindexBest = pindexFork = NULL;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    store = std::move(opened);
+    if (!Init(error)) {
+        store.reset();
+        return false;
+    }
+    queue.clear();
+    fStop = false;
+    threadError.clear();
+    nBestHeight = pindexFork ? pindexFork->nHeight : -1;
+    for (const BlockIndex* pindex = pindexBest; pindex != pindexFork; pindex = pindex->pprev) {
+        BlockRef ref;
+        ref.fConnect = false;
+        ref.hashBlock = pindex->GetBlockHash();
+        ref.hashPrev = pindex->pprev->GetBlockHash();
+        ref.nHeight = pindex->nHeight;
+        ref.blockPos = pindex->blockPos;
+        ref.undoPos = pindex->undoPos;
+        queue.push_back(ref);
+    }
+    for (int nHeight = nBestHeight + 1; nHeight <= chain.Height(); nHeight++) {
+        const BlockIndex* pindex = chain[nHeight];
+        BlockRef ref;
+        ref.fConnect = true;
+        ref.hashBlock = pindex->GetBlockHash();
+        ref.hashPrev = pindex->pprev ? pindex->pprev->GetBlockHash() : uint256();
+        ref.nHeight = nHeight;
+        ref.blockPos = pindex->blockPos;
+        ref.undoPos = pindex->undoPos;
+        queue.push_back(ref);
+    }
+    chainstate.RegisterListener(this);
+    fRegistered = true;
+    thread = std::thread(&BaseIndex::ThreadIndex, this);
+    return true;
+}
+
+void BaseIndex::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        fStop = true;
+    }
+    cond.notify_all();
+    if (thread.joinable())
+        thread.join();
+    if (fRegistered) {
+        chainstate.UnregisterListener(this);
+        fRegistered = false;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    queue.clear();
+    store.reset();
+}
+
+int BaseIndex::BestHeight() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return nBestHeight;
+}
+
+bool BaseIndex::IsSynced() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return store && queue.empty() && !fBusy && threadError.empty();
+}
+
+bool BaseIndex::WaitForSync(std::string& error) const
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!store) {
+        error = "the " + name + " is not running";
+        return false;
+    }
+    cond.wait(lock, [this] { return (queue.empty() && !fBusy) || !threadError.empty(); });
+    error = threadError;
+    return error.empty();
+}
+
+void BaseIndex::BlockConnected(const Block& block, const BlockIndex* pindex)
+{
+    BlockRef ref;
+    ref.fConnect = true;
+    ref.hashBlock = pindex->GetBlockHash();
+    ref.hashPrev = block.hashPrevBlock;
+    ref.nHeight = pindex->nHeight;
+    ref.blockPos = pindex->blockPos;
+    ref.undoPos = pindex->undoPos;
+    Enqueue(ref);
+}
+
+void BaseIndex::BlockDisconnected(const Block& block, const BlockIndex* pindex)
+{
+    BlockRef ref;
+    ref.fConnect = false;
+    ref.hashBlock = pindex->GetBlockHash();
+    ref.hashPrev = block.hashPrevBlock;
+    ref.nHeight = pindex->nHeight;
+    ref.blockPos = pindex->blockPos;
+    ref.undoPos = pindex->undoPos;
+    Enqueue(ref);
+}
+
+void BaseIndex::Enqueue(const BlockRef& ref)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!threadError.empty())
+            return;
+        queue.push_back(ref);
+    }
+    cond.notify_all();
+}
+
+void BaseIndex::PutBestBlock(LsmWriteBatch& batch, const uint256& hashBest)
+{
+    batch.Put(std::string(1, DB_BEST_BLOCK), std::string((const char*)hashBest.begin(), 32));
+}
+
+void BaseIndex::ReadBlock(const BlockRef& ref, Block& block) const
+{
+    if (!blockStore.ReadBlock(ref.blockPos, block) || block.GetHash() != ref.hashBlock)
+        throw std::runtime_error("cannot read block " + ref.hashBlock.GetHex());
+}
+
+void BaseIndex::ReadUndo(const BlockRef& ref, BlockUndo& undo) const
+{
+    undo.vtxundo.clear();
+    if (ref.undoPos.IsNull() && ref.nHeight == 0)
+        return;
+    if (!blockStore.ReadUndo(ref.undoPos, ref.hashBlock, undo))
+        throw std::runtime_error("cannot read undo data of block " + ref.hashBlock.GetHex());
+}
+
+void BaseIndex::ThreadIndex()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        cond.wait(lock, [this] { return fStop || !queue.empty(); });
+        if (fStop)
+            return;
+        std::vector<BlockRef> blocks;
+        while (!queue.empty() && blocks.size() < INDEX_BATCH_BLOCKS) {
+            blocks.push_back(queue.front());
+            queue.pop_front();
+        }
+        fBusy = true;
+        lock.unlock();
+
+        const BlockRef& last = blocks.back();
+        std::string error;
+        try {
+            WriteBlocks(blocks, last.fConnect ? last.hashBlock : last.hashPrev);
+        } catch (const std::runtime_error& e) {
+            error = "the " + name + " stopped: " + e.what();
+        }
+
+        lock.lock();
+        fBusy = false;
+        if (error.empty()) {
+            nBestHeight = last.fConnect ? last.nHeight : last.nHeight - 1;
+        } else {
+            threadError = error;
+            queue.clear();
+        }
+        cond.notify_all();
+        if (!error.empty())
+            return;
+    }
+}
@@ -0,0 +1,115 @@
+#ifndef ONECOIN_BASEINDEX_H
+#define ONECOIN_BASEINDEX_H
+
+#include "block.h"
+#include "chain.h"
+#include "lsm.h"
+#include "undo.h"
+#include "uint256.h"
+#include "validation.h"
+
+#include <stddef.h>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/** Blocks an index takes off its queue and writes together. */
+static const size_t INDEX_BATCH_BLOCKS = 1000;
+
+/**
+ * An optional index over the active chain, kept in an LSM store of its own
+ * next to the chainstate and updated by a background thread.
+ *
+ * Start() queues the active-chain blocks after the index's best block, so
+ * the first start builds the index and later ones resume after the last
+ * batch written. Blocks the chain gains or loses meanwhile are queued
+ * behind them: BlockConnected() and BlockDisconnected() only copy where
+ * the block is stored, so changing the chain never waits for the index,
+ * and the thread reads the block back from the block files. The thread
+ * hands WriteBlocks() up to INDEX_BATCH_BLOCKS blocks at a time along with
+ * the best block after them, which it stores under the key 'B'.
+ *
+ * Indexes point into the block files or need them to catch up, so none is
+ * available in prune mode. A derived class calls Stop() in its destructor,
+ * before its own members go.
+ */
+class BaseIndex : public ChainListener {
+public:
+    /** name says which index failed in errors; chainstate must be loaded
+     *  before Start(). */
+    BaseIndex(const std::string& name, const std::string& dir, Chainstate& chainstate);
+    virtual ~BaseIndex();
+
+    /** Opens the store, queues the blocks it lacks and starts following the
+     *  chain. Call from the thread that changes the chain. */
+    bool Start(std::string& error);
+    /** Stops the thread and the chain notifications. Blocks still queued
+     *  are indexed by the next Start(). */
+    void Stop();
+
+    /** Height of the last block indexed, -1 before the genesis block. */
+    int BestHeight() const;
+    /** Whether every block queued so far is indexed. */
+    bool IsSynced() const;
+    /** Waits until IsSynced(); false if the index stopped on an error. */
+    bool WaitForSync(std::string& error) const;
+
+    void BlockConnected(const Block& block, const BlockIndex* pindex);
+    void BlockDisconnected(const Block& block, const BlockIndex* pindex);
+
+protected:
+    /** A block the active chain gained or lost, by where it is stored. */
+    struct BlockRef {
+        bool fConnect;
+        uint256 hashBlock;
+        uint256 hashPrev;
+        int nHeight;
+        FlatFilePos blockPos;
+        /** Null for the genesis block, which has no undo data. */
+        FlatFilePos undoPos;
+    };
+
+    const std::string name;
+    const std::string dir;
+    /** For block reads only; the thread never touches the chainstate. */
+    const BlockStore& blockStore;
+    /** Open while the index is started. */
+    std::unique_ptr<LsmStore> store;
+
+    /** Called by Start() once store is open and before any block is
+     *  written, for state kept outside the store. */
+    virtual bool Init(std::string& /* error */) { return true; }
+    /** Applies blocks in chain order and stores hashBest as the best block,
+     *  in the same write as the last entries or after them. Throws
+     *  std::runtime_error on failure. */
+    virtual void WriteBlocks(const std::vector<BlockRef>& blocks, const uint256& hashBest) = 0;
+
+    static void PutBestBlock(LsmWriteBatch& batch, const uint256& hashBest);
+    /** Read the block or undo data ref points at; throw std::runtime_error
+     *  when it is missing or corrupt. */
+    void ReadBlock(const BlockRef& ref, Block& block) const;
+    void ReadUndo(const BlockRef& ref, BlockUndo& undo) const;
+
+private:
+    Chainstate& chainstate;
+
+    mutable std::mutex mutex;
+    mutable std::condition_variable cond;
+    std::thread thread;
+    std::deque<BlockRef> queue;
+    /** Whether the thread is writing blocks it took off the queue. */
+    bool fBusy;
+    bool fStop;
+    bool fRegistered;
+    int nBestHeight;
+    std::string threadError;
+
+    void Enqueue(const BlockRef& ref);
+    void ThreadIndex();
+};
+
+#endif // ONECOIN_BASEINDEX_H
@@ -0,0 +1,253 @@
+#include "batchread.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+bool PreadAll(int fd, unsigned char* buf, size_t len, uint64_t offset)
+{
+    while (len) {
+        ssize_t n = pread(fd, buf, len, (off_t)offset);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        buf += n;
+        len -= n;
+        offset += n;
+    }
+    return true;
+}
+
+/**
+ * A minimal io_uring driven through the raw system calls: a submission ring
+ * of READ operations and a completion ring reaped by the calling thread.
+ */
+class BatchReader::IoUring {
+public:
+    static const unsigned int ENTRIES = 256;
+
+    IoUring() : fd(-1), sqMap(MAP_FAILED), cqMap(MAP_FAILED), sqeMap(MAP_FAILED), sqMapSize(0), cqMapSize(0),
+                sqeMapSize(0) {}
+    ~IoUring()
+    {
+        if (sqeMap != MAP_FAILED)
+            munmap(sqeMap, sqeMapSize);
+        if (cqMap != MAP_FAILED && cqMap != sqMap)
+            munmap(cqMap, cqMapSize);
+        if (sqMap != MAP_FAILED)
+            munmap(sqMap, sqMapSize);
+        if (fd >= 0)
+            close(fd);
+    }
+
+    bool Init()
+    {
+        struct io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        fd = (int)syscall(__NR_io_uring_setup, ENTRIES, &p);
+        if (fd < 0)
+            return false;
+        sqMapSize = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+        cqMapSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+        bool fSingle = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (fSingle)
+            sqMapSize = cqMapSize = std::max(sqMapSize, cqMapSize);
+        sqMap = mmap(NULL, sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sqMap == MAP_FAILED)
+            return false;
+        cqMap = fSingle ? sqMap : mmap(NULL, cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                                      IORING_OFF_CQ_RING);
+        if (cqMap == MAP_FAILED)
+            return false;
+        sqeMapSize = p.sq_entries * sizeof(struct io_uring_sqe);
+        sqeMap = mmap(NULL, sqeMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (sqeMap == MAP_FAILED)
+            return false;
+
+        unsigned char* sq = (unsigned char*)sqMap;
+        sqTail = (unsigned int*)(sq + p.sq_off.tail);
+        sqMask = *(unsigned int*)(sq + p.sq_off.ring_mask);
+        sqArray = (unsigned int*)(sq + p.sq_off.array);
+        sqEntries = p.sq_entries;
+        sqes = (struct io_uring_sqe*)sqeMap;
+        unsigned char* cq = (unsigned char*)cqMap;
+        cqHead = (unsigned int*)(cq + p.cq_off.head);
+        cqTail = (unsigned int*)(cq + p.cq_off.tail);
+        cqMask = *(unsigned int*)(cq + p.cq_off.ring_mask);
+        cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+        return true;
+    }
+
+    /** Returns 1 when every request was read, 0 on a read error and -1
+     *  when the kernel does not support the operation. */
+    int Read(int fdFile, const std::vector<ReadRequest>& requests)
+    {
+        size_t nNext = 0, nInFlight = 0;
+        bool fOk = true;
+        while (nNext < requests.size() || nInFlight > 0) {
+            unsigned int nSubmit = 0;
+            unsigned int tail = *sqTail;
+            while (nNext < requests.size() && nInFlight + nSubmit < sqEntries) {
+                const ReadRequest& req = requests[nNext];
+                unsigned int idx = tail & sqMask;
+                struct io_uring_sqe* sqe = &sqes[idx];
+                memset(sqe, 0, sizeof(*sqe));
+                sqe->opcode = IORING_OP_READ;
+                sqe->fd = fdFile;
+                sqe->off = req.nOffset;
+                sqe->addr = (uint64_t)(uintptr_t)req.data;
+                sqe->len = req.nSize;
+                sqe->user_data = nNext;
+                sqArray[idx] = idx;
+                tail++;
+                nSubmit++;
+                nNext++;
+            }
+            __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+
+            // Submit and wait for at least one completion in a single call.
+            int ret;
+            do {
+                ret = (int)syscall(__NR_io_uring_enter, fd, nSubmit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+            } while (ret < 0 && errno == EINTR);
+            if (ret < 0)
+                return -1;
+            nInFlight += nSubmit;
+
+            unsigned int head = *cqHead;
+            unsigned int cqTailNow = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+            for (; head != cqTailNow; head++, nInFlight--) {
+                const struct io_uring_cqe& cqe = cqes[head & cqMask];
+                const ReadRequest& req = requests[cqe.user_data];
+                if (cqe.res == -EINVAL || cqe.res == -EOPNOTSUPP)
+                    fUnsupported = true;
+                else if (cqe.res < 0)
+                    fOk = false;
+                else if ((uint32_t)cqe.res < req.nSize)
+                    fOk &= PreadAll(fdFile, req.data + cqe.res, req.nSize - cqe.res, req.nOffset + cqe.res);
+            }
+            __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        }
+        if (fUnsupported)
+            return -1;
+        return fOk ? 1 : 0;
+    }
+
+private:
+    int fd;
+    void* sqMap;
+    void* cqMap;
+    void* sqeMap;
+    size_t sqMapSize;
+    size_t cqMapSize;
+    size_t sqeMapSize;
+    unsigned int* sqTail;
+    unsigned int sqMask;
+    unsigned int* sqArray;
+    unsigned int sqEntries;
+    struct io_uring_sqe* sqes;
+    unsigned int* cqHead;
+    unsigned int* cqTail;
+    unsigned int cqMask;
+    struct io_uring_cqe* cqes;
+    bool fUnsupported = false;
+};
+
+BatchReader::BatchReader(Method methodIn, unsigned int nThreads)
+    : method(methodIn), nThreads(nThreads), batch(NULL), batchFd(-1), nNext(0), nPending(0), fBatchOk(true),
+      fStop(false)
+{
+    if (method == READ_AUTO || method == READ_IO_URING) {
+        ring.reset(new IoUring());
+        if (ring->Init()) {
+            method = READ_IO_URING;
+        } else {
+            ring.reset();
+            method = READ_THREADS;
+        }
+    }
+}
+
+BatchReader::~BatchReader()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        fStop = true;
+    }
+    workCond.notify_all();
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+}
+
+const char* BatchReader::MethodName(Method method)
+{
+    switch (method) {
+    case READ_AUTO: return "auto";
+    case READ_IO_URING: return "io_uring";
+    case READ_THREADS: return "threads";
+    case READ_SERIAL: return "serial";
+    }
+    return "unknown";
+}
+
+bool BatchReader::Read(int fd, const std::vector<ReadRequest>& requests)
+{
+    if (requests.size() == 1 || method == READ_SERIAL) {
+        for (size_t i = 0; i < requests.size(); i++) {
+            if (!PreadAll(fd, requests[i].data, requests[i].nSize, requests[i].nOffset))
+                return false;
+        }
+        return true;
+    }
+    if (requests.empty())
+        return true;
+    if (method == READ_IO_URING) {
+        int ret = ring->Read(fd, requests);
+        if (ret >= 0)
+            return ret == 1;
+        // Kernels before 5.6 have the ring but not IORING_OP_READ.
+        ring.reset();
+        method = READ_THREADS;
+    }
+    return ReadThreads(fd, requests);
+}
+
+bool BatchReader::ReadThreads(int fd, const std::vector<ReadRequest>& requests)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (threads.size() < nThreads)
+        threads.push_back(std::thread(&BatchReader::ThreadMain, this));
+    batch = &requests;
+    batchFd = fd;
+    nNext = 0;
+    nPending = requests.size();
+    fBatchOk = true;
+    workCond.notify_all();
+    doneCond.wait(lock, [this] { return nPending == 0; });
+    batch = NULL;
+    return fBatchOk;
+}
+
+void BatchReader::ThreadMain()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        workCond.wait(lock, [this] { return fStop || (batch && nNext < batch->size()); });
+        if (fStop)
+            return;
+        const ReadRequest& req = (*batch)[nNext++];
+        int fd = batchFd;
+        lock.unlock();
+        bool ok = PreadAll(fd, req.data, req.nSize, req.nOffset);
+        lock.lock();
+        if (!ok)
+            fBatchOk = false;
+        if (--nPending == 0)
+            doneCond.notify_one();
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef ONECOIN_BATCHREAD_H
+#define ONECOIN_BATCHREAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** One range of a file to read into data. */
+struct ReadRequest {
+    uint64_t nOffset;
+    uint32_t nSize;
+    unsigned char* data;
+};
+
+/**
+ * Reads many ranges of a file at once, so a batch of random reads costs
+ * about one device round trip instead of one per range. Uses io_uring when
+ * the kernel allows it and otherwise a pool of threads issuing pread.
+ * Not safe for concurrent use.
+ */
+class BatchReader {
+public:
+    enum Method {
+        READ_AUTO,
+        READ_IO_URING,
+        READ_THREADS,
+        /** One pread after another: the baseline. */
+        READ_SERIAL,
+    };
+
+    /** READ_AUTO and READ_IO_URING fall back to threads when io_uring is
+     *  unavailable. */
+    explicit BatchReader(Method method = READ_AUTO, unsigned int nThreads = 16);
+    ~BatchReader();
+
+    /** Fills every request. False on any read error or short file. */
+    bool Read(int fd, const std::vector<ReadRequest>& requests);
+
+    /** The method in use after any fallback. */
+    Method GetMethod() const { return method; }
+    static const char* MethodName(Method method);
+
+private:
+    class IoUring;
+
+    Method method;
+    std::unique_ptr<IoUring> ring;
+
+    // Thread pool, started on first use.
+    unsigned int nThreads;
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable workCond;
+    std::condition_variable doneCond;
+    const std::vector<ReadRequest>* batch;
+    int batchFd;
+    size_t nNext;
+    size_t nPending;
+    bool fBatchOk;
+    bool fStop;
+
+    bool ReadThreads(int fd, const std::vector<ReadRequest>& requests);
+    void ThreadMain();
+};
+
+/** pread until len bytes are in or the file ends. */
+bool PreadAll(int fd, unsigned char* buf, size_t len, uint64_t offset);
+
+#endif // ONECOIN_BATCHREAD_H
@@ -0,0 +1,77 @@
+#include "block.h"
+#include "hash.h"
+#include "serialize.h"
+
+#include <string.h>
+
+void BlockHeader::SetNull()
+{
+    nVersion = 0;
+    hashPrevBlock.SetNull();
+    hashMerkleRoot.SetNull();
+    nTime = 0;
+    nBits = 0;
+    nNonce = 0;
+}
+
+void BlockHeader::Serialize(unsigned char out[SIZE]) const
+{
+    WriteLE32(out, (uint32_t)nVersion);
+    memcpy(out + 4, hashPrevBlock.begin(), 32);
+    memcpy(out + 36, hashMerkleRoot.begin(), 32);
+    WriteLE32(out + 68, nTime);
+    WriteLE32(out + 72, nBits);
+    WriteLE32(out + 76, nNonce);
+}
+
+void BlockHeader::Deserialize(const unsigned char in[SIZE])
+{
+    nVersion = (int32_t)ReadLE32(in);
+    hashPrevBlock = uint256(in + 4);
+    hashMerkleRoot = uint256(in + 36);
+    nTime = ReadLE32(in + 68);
+    nBits = ReadLE32(in + 72);
+    nNonce = ReadLE32(in + 76);
+}
+
+uint256 BlockHeader::GetHash() const
+{
+    unsigned char buf[SIZE];
+    Serialize(buf);
+    unsigned char hash[32];
+    Sha256d(buf, SIZE, hash);
+    return uint256(hash);
+}
+
+void SerializeBlock(ByteWriter& w, const Block& block)
+{
+    unsigned char header[BlockHeader::SIZE];
+    block.Serialize(header);
+    w.WriteBytes(header, sizeof(header));
+    w.WriteCompactSize(block.vtx.size());
+    for (size_t i = 0; i < block.vtx.size(); i++)
+        SerializeTransaction(w, *block.vtx[i]);
+}
+
+std::vector<unsigned char> SerializeBlock(const Block& block)
+{
+    std::vector<unsigned char> out;
+    ByteWriter w(out);
+    SerializeBlock(w, block);
+    return out;
+}
+
+void UnserializeBlock(ByteReader& r, Block& block)
+{
+    unsigned char header[BlockHeader::SIZE];
+    r.ReadBytes(header, sizeof(header));
+    block.Deserialize(header);
+    uint64_t nTx = r.ReadCompactSize();
+    // The smallest transaction is 60 bytes.
+    if (nTx > r.Remaining() / 60)
+        throw SerializeError("transaction count exceeds data");
+    block.vtx.clear();
+    block.vtx.reserve(nTx);
+    for (uint64_t i = 0; i < nTx; i++)
+        block.vtx.push_back(ReadTransaction(r));
+}
@@ -0,0 +1,52 @@
+#ifndef ONECOIN_BLOCK_H
+#define ONECOIN_BLOCK_H
+
+#include "serialize.h"
+#include "transaction.h"
+#include "uint256.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/** The 80-byte header that is hashed for proof of work. */
+class BlockHeader {
+public:
+    static const size_t SIZE = 80;
+
+    int32_t nVersion;
+    uint256 hashPrevBlock;
+    uint256 hashMerkleRoot;
+    uint32_t nTime;
+    uint32_t nBits;
+    uint32_t nNonce;
+
+    BlockHeader() { SetNull(); }
+
+    void SetNull();
+    bool IsNull() const { return nBits == 0; }
+
+    void Serialize(unsigned char out[SIZE]) const;
+    void Deserialize(const unsigned char in[SIZE]);
+
+    /** Double SHA-256 of the serialized header; no heap use. */
+    uint256 GetHash() const;
+    int64_t GetBlockTime() const { return (int64_t)nTime; }
+};
+
+class Block : public BlockHeader {
+public:
+    std::vector<TransactionRef> vtx;
+
+    Block() {}
+    explicit Block(const BlockHeader& header) : BlockHeader(header) {}
+
+    const BlockHeader& GetHeader() const { return *this; }
+};
+
+void SerializeBlock(ByteWriter& w, const Block& block);
+std::vector<unsigned char> SerializeBlock(const Block& block);
+/** Throws SerializeError on malformed input. */
+void UnserializeBlock(ByteReader& r, Block& block);
+
+#endif // ONECOIN_BLOCK_H
@@ -0,0 +1,237 @@
+#include "blockfilter.h"
+#include "hash.h"
+#include "script.h"
+#include "serialize.h"
+
+#include <algorithm>
+
+namespace {
+
+/** floor(x * n / 2^64): maps a uniform 64-bit hash onto [0, n) without a
+ *  division. */
+inline uint64_t FastRange64(uint64_t x, uint64_t n)
+{
+    return (uint64_t)(((unsigned __int128)x * n) >> 64);
+}
+
+/** Appends bits most significant first. */
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<unsigned char>& out) : out(out), nBits(0), buffer(0) {}
+
+    /** Writes the low nCount bits of value, nCount <= 57. */
+    void Write(uint64_t value, int nCount)
+    {
+        buffer = (buffer << nCount) | (value & ((1ULL << nCount) - 1));
+        nBits += nCount;
+        while (nBits >= 8) {
+            nBits -= 8;
+            out.push_back((unsigned char)(buffer >> nBits));
+        }
+    }
+
+    /** Pads the last byte with zero bits. */
+    void Flush()
+    {
+        if (nBits > 0)
+            out.push_back((unsigned char)(buffer << (8 - nBits)));
+        nBits = 0;
+        buffer = 0;
+    }
+
+private:
+    std::vector<unsigned char>& out;
+    int nBits;
+    uint64_t buffer;
+};
+
+/** Reads bits most significant first; throws SerializeError past the end. */
+class BitReader {
+public:
+    BitReader(const unsigned char* data, size_t len) : data(data), len(len), nPos(0), nBits(0), byte(0) {}
+
+    bool ReadBit()
+    {
+        if (nBits == 0) {
+            if (nPos == len)
+                throw SerializeError("filter ends early");
+            byte = data[nPos++];
+            nBits = 8;
+        }
+        nBits--;
+        return (byte >> nBits) & 1;
+    }
+
+    uint64_t Read(int nCount)
+    {
+        uint64_t value = 0;
+        for (int i = 0; i < nCount; i++)
+            value = (value << 1) | (ReadBit() ? 1 : 0);
+        return value;
+    }
+
+private:
+    const unsigned char* data;
+    size_t len;
+    size_t nPos;
+    int nBits;
+    unsigned char byte;
+};
+
+void GolombRiceEncode(BitWriter& bits, uint8_t P, uint64_t x)
+{
+    // The quotient in unary, at most 57 bits at a time.
+    uint64_t q = x >> P;
+    while (q > 0) {
+        int n = q > 56 ? 56 : (int)q;
+        bits.Write(~0ULL, n);
+        q -= n;
+    }
+    bits.Write(0, 1);
+    bits.Write(x, P);
+}
+
+uint64_t GolombRiceDecode(BitReader& bits, uint8_t P)
+{
+    uint64_t q = 0;
+    while (bits.ReadBit())
+        q++;
+    return (q << P) + bits.Read(P);
+}
+
+} // namespace
+
+GCSFilter::GCSFilter(const Params& params) : params(params), N(0), F(0)
+{
+    ByteWriter w(encoded);
+    w.WriteCompactSize(0);
+}
+
+GCSFilter::GCSFilter(const Params& params, const GCSElementSet& elements)
+    : params(params), N((uint32_t)elements.size()), F((uint64_t)elements.size() * params.M)
+{
+    ByteWriter w(encoded);
+    w.WriteCompactSize(N);
+    std::vector<uint64_t> values = HashedSet(elements);
+    BitWriter bits(encoded);
+    uint64_t last = 0;
+    for (size_t i = 0; i < values.size(); i++) {
+        GolombRiceEncode(bits, params.P, values[i] - last);
+        last = values[i];
+    }
+    bits.Flush();
+}
+
+GCSFilter::GCSFilter(const Params& params, const std::vector<unsigned char>& encodedIn)
+    : params(params), encoded(encodedIn)
+{
+    ByteReader r(encoded);
+    uint64_t n = r.ReadCompactSize();
+    if (n > UINT32_MAX)
+        throw SerializeError("filter element count out of range");
+    N = (uint32_t)n;
+    F = (uint64_t)N * params.M;
+}
+
+std::vector<uint64_t> GCSFilter::HashedSet(const GCSElementSet& elements) const
+{
+    std::vector<uint64_t> values(elements.size());
+    if (!values.empty())
+        SipHashBatch(params.k0, params.k1, elements, values.data());
+    for (size_t i = 0; i < values.size(); i++)
+        values[i] = FastRange64(values[i], F);
+    std::sort(values.begin(), values.end());
+    return values;
+}
+
+bool GCSFilter::Match(const std::vector<unsigned char>& element) const
+{
+    return MatchAny(GCSElementSet(1, element));
+}
+
+bool GCSFilter::MatchAny(const GCSElementSet& elements) const
+{
+    if (N == 0 || elements.empty())
+        return false;
+    return MatchSorted(HashedSet(elements));
+}
+
+bool GCSFilter::MatchSorted(const std::vector<uint64_t>& queries) const
+{
+    // Walk the decoded set and the sorted queries together.
+    size_t nHeader = GetCompactSizeLen(N);
+    BitReader bits(encoded.data() + nHeader, encoded.size() - nHeader);
+    uint64_t value = 0;
+    size_t q = 0;
+    try {
+        for (uint32_t i = 0; i < N; i++) {
+            value += GolombRiceDecode(bits, params.P);
+            while (q < queries.size() && queries[q] < value)
+                q++;
+            if (q == queries.size())
+                return false;
+            if (queries[q] == value)
+                return true;
+        }
+    } catch (const SerializeError&) {
+        return false;
+    }
+    return false;
+}
+
+BlockFilter::BlockFilter(const Block& block, const BlockUndo& undo)
+    : hashBlock(block.GetHash()), filter(BasicParams(hashBlock), BasicElements(block, undo))
+{
+}
+
+BlockFilter::BlockFilter(const uint256& hashBlock, const std::vector<unsigned char>& encoded)
+    : hashBlock(hashBlock), filter(BasicParams(hashBlock), encoded)
+{
+}
+
+GCSFilter::Params BlockFilter::BasicParams(const uint256& hashBlock)
+{
+    return GCSFilter::Params(ReadLE64(hashBlock.begin()), ReadLE64(hashBlock.begin() + 8));
+}
+
+GCSElementSet BlockFilter::BasicElements(const Block& block, const BlockUndo& undo)
+{
+    GCSElementSet elements;
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        const Transaction& tx = *block.vtx[i];
+        for (size_t j = 0; j < tx.vout.size(); j++) {
+            const Script& script = tx.vout[j].scriptPubKey;
+            if (script.empty() || script[0] == OP_RETURN)
+                continue;
+            elements.push_back(script);
+        }
+    }
+    for (size_t i = 0; i < undo.vtxundo.size(); i++) {
+        const std::vector<Coin>& spent = undo.vtxundo[i].vprevout;
+        for (size_t j = 0; j < spent.size(); j++) {
+            if (!spent[j].out.scriptPubKey.empty())
+                elements.push_back(spent[j].out.scriptPubKey);
+        }
+    }
+    std::sort(elements.begin(), elements.end());
+    elements.erase(std::unique(elements.begin(), elements.end()), elements.end());
+    return elements;
+}
+
+uint256 BlockFilter::GetHash() const
+{
+    unsigned char hash[32];
+    Sha256d(GetEncoded(), hash);
+    return uint256(hash);
+}
+
+uint256 BlockFilter::ComputeHeader(const uint256& prevHeader) const
+{
+    unsigned char data[64];
+    uint256 hash = GetHash();
+    std::copy(hash.begin(), hash.begin() + 32, data);
+    std::copy(prevHeader.begin(), prevHeader.begin() + 32, data + 32);
+    unsigned char header[32];
+    Sha256d(data, sizeof(data), header);
+    return uint256(header);
+}
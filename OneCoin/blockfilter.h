@@ -0,0 +1,110 @@
+#ifndef ONECOIN_BLOCKFILTER_H
+#define ONECOIN_BLOCKFILTER_H
+
+#include "block.h"
+#include "undo.h"
+#include "uint256.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/** Filter types as numbered on the wire; only the basic filter exists. */
+enum BlockFilterType {
+    BLOCK_FILTER_BASIC = 0,
+};
+
+/** Golomb-Rice parameter and false positive rate (1 / M) of basic filters. */
+static const uint8_t BASIC_FILTER_P = 19;
+static const uint32_t BASIC_FILTER_M = 784931;
+
+typedef std::vector<std::vector<unsigned char> > GCSElementSet;
+
+/**
+ * A Golomb-coded set: a compact, probabilistic set of byte strings that
+ * answers membership with false positives at a rate of 1 / M and no false
+ * negatives.
+ *
+ * Each of the N elements is hashed with SipHash-2-4 under (k0, k1) and
+ * mapped uniformly onto [0, N * M). The sorted values are stored as
+ * differences, each split into a unary quotient and a P-bit remainder, so
+ * an element costs about P + 2 bits. The encoding is a compact size N
+ * followed by that bit stream, most significant bit first.
+ */
+class GCSFilter {
+public:
+    struct Params {
+        uint64_t k0;
+        uint64_t k1;
+        uint8_t P;
+        uint32_t M;
+
+        Params(uint64_t k0 = 0, uint64_t k1 = 0, uint8_t P = BASIC_FILTER_P, uint32_t M = BASIC_FILTER_M)
+            : k0(k0), k1(k1), P(P), M(M)
+        {
+        }
+    };
+
+    explicit GCSFilter(const Params& params = Params());
+    /** Builds the filter of elements, which must be distinct. */
+    GCSFilter(const Params& params, const GCSElementSet& elements);
+    /** Takes an encoded filter. Throws SerializeError when it does not
+     *  start with its element count. */
+    GCSFilter(const Params& params, const std::vector<unsigned char>& encoded);
+
+    uint32_t GetN() const { return N; }
+    const Params& GetParams() const { return params; }
+    const std::vector<unsigned char>& GetEncoded() const { return encoded; }
+
+    bool Match(const std::vector<unsigned char>& element) const;
+    /** Whether any of elements may be in the set; decodes the filter once
+     *  however many there are. */
+    bool MatchAny(const GCSElementSet& elements) const;
+
+private:
+    Params params;
+    uint32_t N;
+    /** N * M, the range elements are hashed onto. */
+    uint64_t F;
+    std::vector<unsigned char> encoded;
+
+    /** Hashes of elements mapped onto [0, F), sorted. */
+    std::vector<uint64_t> HashedSet(const GCSElementSet& elements) const;
+    bool MatchSorted(const std::vector<uint64_t>& queries) const;
+};
+
+/**
+ * The basic filter of a block (BIP 158): the output scripts it creates,
+ * except OP_RETURN ones, and the scripts of the outputs it spends, keyed by
+ * the first 16 bytes of the block hash. A light client matches its own
+ * scripts against it and fetches the block only on a hit.
+ */
+class BlockFilter {
+public:
+    BlockFilter() {}
+    /** undo holds the outputs block spends, as stored with it. */
+    BlockFilter(const Block& block, const BlockUndo& undo);
+    /** Takes an encoded filter. Throws SerializeError as GCSFilter does. */
+    BlockFilter(const uint256& hashBlock, const std::vector<unsigned char>& encoded);
+
+    const uint256& GetBlockHash() const { return hashBlock; }
+    const GCSFilter& GetFilter() const { return filter; }
+    const std::vector<unsigned char>& GetEncoded() const { return filter.GetEncoded(); }
+
+    /** Double SHA-256 of the encoded filter. */
+    uint256 GetHash() const;
+    /** The filter header: the double SHA-256 of the filter hash and the
+     *  previous block's header, zero before the genesis block. Headers
+     *  commit to every filter below them, so a client can check a filter
+     *  against headers from several peers. */
+    uint256 ComputeHeader(const uint256& prevHeader) const;
+
+    static GCSFilter::Params BasicParams(const uint256& hashBlock);
+    static GCSElementSet BasicElements(const Block& block, const BlockUndo& undo);
+
+private:
+    uint256 hashBlock;
+    GCSFilter filter;
+};
+
+#endif // ONECOIN_BLOCKFILTER_H
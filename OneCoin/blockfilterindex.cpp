@@ -0,0 +1,285 @@
+#include "blockfilterindex.h"
+#include "batchread.h"
+#include "fs.h"
+#include "serialize.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <map>
+#include <stdexcept>
+
+namespace {
+
+/** Entries are under 'f' + block hash; 'P' holds the end of the filter
+ *  files as of the last write. */
+const char DB_FILTER = 'f';
+const char DB_FILE_POS = 'P';
+
+std::string FilterKey(const uint256& hashBlock)
+{
+    std::string key(1 + 32, DB_FILTER);
+    memcpy(&key[1], hashBlock.begin(), 32);
+    return key;
+}
+
+} // namespace
+
+BlockFilterIndex::BlockFilterIndex(const std::string& dir, Chainstate& chainstate)
+    : BaseIndex("block filter index", dir, chainstate), file(NULL), nLastFile(0), nLastFileSize(0)
+{
+}
+
+BlockFilterIndex::~BlockFilterIndex()
+{
+    Stop();
+    if (file)
+        fclose(file);
+}
+
+std::string BlockFilterIndex::FilterFilePath(int nFile) const
+{
+    char name[16];
+    snprintf(name, sizeof(name), "fltr%05d.dat", nFile);
+    return dir + "/" + name;
+}
+
+bool BlockFilterIndex::Init(std::string& error)
+{
+    if (file) {
+        fclose(file);
+        file = NULL;
+    }
+    nLastFile = 0;
+    nLastFileSize = 0;
+    std::string value;
+    if (store->Get(std::string(1, DB_FILE_POS), value)) {
+        try {
+            ByteReader r((const unsigned char*)value.data(), value.size());
+            uint64_t n = r.ReadVarInt();
+            uint64_t nSize = r.ReadVarInt();
+            if (!r.Empty() || n > INT32_MAX || nSize > UINT32_MAX)
+                throw SerializeError("out of range");
+            nLastFile = (int)n;
+            nLastFileSize = (unsigned int)nSize;
+        } catch (const SerializeError&) {
+            error = "corrupt file position in the " + name;
+            return false;
+        }
+    }
+
+    // Drop whatever a crash left after the last record the store knows.
+    std::string path = FilterFilePath(nLastFile);
+    if (FileExists(path) && truncate(path.c_str(), nLastFileSize) != 0) {
+        error = "cannot truncate " + path;
+        return false;
+    }
+    file = fopen(path.c_str(), "ab");
+    if (!file) {
+        error = "cannot open " + path;
+        return false;
+    }
+    return true;
+}
+
+bool BlockFilterIndex::FindFilter(const uint256& hashBlock, BlockFilterEntry& entry) const
+{
+    std::string value;
+    if (!store || !store->Get(FilterKey(hashBlock), value))
+        return false;
+    try {
+        ByteReader r((const unsigned char*)value.data(), value.size());
+        uint64_t n = r.ReadVarInt();
+        uint64_t nPos = r.ReadVarInt();
+        uint64_t nSize = r.ReadVarInt();
+        unsigned char hash[32];
+        r.ReadBytes(hash, sizeof(hash));
+        entry.hashFilter = uint256(hash);
+        r.ReadBytes(hash, sizeof(hash));
+        entry.header = uint256(hash);
+        if (!r.Empty() || n > INT32_MAX || nPos > UINT32_MAX || nSize > MAX_FILTER_FILE_SIZE)
+            throw SerializeError("out of range");
+        entry.pos = FlatFilePos((int)n, (unsigned int)nPos);
+        entry.nSize = (uint32_t)nSize;
+    } catch (const SerializeError&) {
+        throw std::runtime_error("corrupt entry in the block filter index");
+    }
+    return true;
+}
+
+bool BlockFilterIndex::ReadFilter(const uint256& hashBlock, const BlockFilterEntry& entry, BlockFilter& filter) const
+{
+    if (entry.nSize < 32)
+        return false;
+    int fd = open(FilterFilePath(entry.pos.nFile).c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    std::vector<unsigned char> record(entry.nSize);
+    bool ok = PreadAll(fd, record.data(), record.size(), entry.pos.nPos);
+    close(fd);
+    if (!ok || uint256(record.data()) != hashBlock)
+        return false;
+    try {
+        filter = BlockFilter(hashBlock, std::vector<unsigned char>(record.begin() + 32, record.end()));
+    } catch (const SerializeError&) {
+        return false;
+    }
+    return filter.GetHash() == entry.hashFilter;
+}
+
+bool BlockFilterIndex::GetFilter(const uint256& hashBlock, BlockFilter& filter) const
+{
+    BlockFilterEntry entry;
+    return FindFilter(hashBlock, entry) && ReadFilter(hashBlock, entry, filter);
+}
+
+bool BlockFilterIndex::GetFilterHeader(const uint256& hashBlock, uint256& header) const
+{
+    BlockFilterEntry entry;
+    if (!FindFilter(hashBlock, entry))
+        return false;
+    header = entry.header;
+    return true;
+}
+
+bool BlockFilterIndex::RangeEntries(int nStartHeight, const BlockIndex* pindexStop, std::vector<uint256>& hashBlocks,
+    std::vector<BlockFilterEntry>& entries) const
+{
+    if (!pindexStop || nStartHeight < 0 || nStartHeight > pindexStop->nHeight ||
+        pindexStop->nHeight - nStartHeight >= MAX_FILTER_RANGE) {
+        return false;
+    }
+    size_t nCount = pindexStop->nHeight - nStartHeight + 1;
+    hashBlocks.resize(nCount);
+    entries.resize(nCount);
+    const BlockIndex* pindex = pindexStop;
+    for (size_t i = nCount; i-- > 0; pindex = pindex->pprev) {
+        hashBlocks[i] = pindex->GetBlockHash();
+        if (!FindFilter(hashBlocks[i], entries[i]))
+            return false;
+    }
+    return true;
+}
+
+bool BlockFilterIndex::GetFilterRange(int nStartHeight, const BlockIndex* pindexStop,
+    std::vector<BlockFilter>& filters) const
+{
+    std::vector<uint256> hashBlocks;
+    std::vector<BlockFilterEntry> entries;
+    if (!RangeEntries(nStartHeight, pindexStop, hashBlocks, entries))
+        return false;
+    filters.resize(entries.size());
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (!ReadFilter(hashBlocks[i], entries[i], filters[i]))
+            return false;
+    }
+    return true;
+}
+
+bool BlockFilterIndex::GetFilterHashRange(int nStartHeight, const BlockIndex* pindexStop,
+    std::vector<uint256>& hashes) const
+{
+    std::vector<uint256> hashBlocks;
+    std::vector<BlockFilterEntry> entries;
+    if (!RangeEntries(nStartHeight, pindexStop, hashBlocks, entries))
+        return false;
+    hashes.resize(entries.size());
+    for (size_t i = 0; i < entries.size(); i++)
+        hashes[i] = entries[i].hashFilter;
+    return true;
+}
+
+bool BlockFilterIndex::GetFilterHeaderRange(int nStartHeight, const BlockIndex* pindexStop,
+    std::vector<uint256>& headers) const
+{
+    std::vector<uint256> hashBlocks;
+    std::vector<BlockFilterEntry> entries;
+    if (!RangeEntries(nStartHeight, pindexStop, hashBlocks, entries))
+        return false;
+    headers.resize(entries.size());
+    for (size_t i = 0; i < entries.size(); i++)
+        headers[i] = entries[i].header;
+    return true;
+}
+
+void BlockFilterIndex::WriteBlocks(const std::vector<BlockRef>& blocks, const uint256& hashBest)
+{
+    // Headers of the blocks in this batch, which the store has yet to see.
+    std::map<uint256, uint256> headers;
+    LsmWriteBatch batch;
+    std::vector<unsigned char> buf;
+    for (size_t i = 0; i < blocks.size(); i++) {
+        const BlockRef& ref = blocks[i];
+        if (!ref.fConnect)
+            continue;
+        BlockFilterEntry entry;
+        if (FindFilter(ref.hashBlock, entry)) {
+            // Reconnected: the filter is the same as before.
+            headers[ref.hashBlock] = entry.header;
+            continue;
+        }
+        Block block;
+        BlockUndo undo;
+        ReadBlock(ref, block);
+        if (block.vtx.size() > 1)
+            ReadUndo(ref, undo);
+        if (undo.vtxundo.size() + 1 != block.vtx.size())
+            throw std::runtime_error("undo data does not match block " + ref.hashBlock.GetHex());
+        BlockFilter filter(block, undo);
+
+        uint256 prevHeader;
+        if (ref.nHeight > 0) {
+            std::map<uint256, uint256>::const_iterator it = headers.find(ref.hashPrev);
+            if (it != headers.end()) {
+                prevHeader = it->second;
+            } else if (FindFilter(ref.hashPrev, entry)) {
+                prevHeader = entry.header;
+            } else {
+                throw std::runtime_error("no filter header for block " + ref.hashPrev.GetHex());
+            }
+        }
+        entry.hashFilter = filter.GetHash();
+        entry.header = filter.ComputeHeader(prevHeader);
+        headers[ref.hashBlock] = entry.header;
+
+        const std::vector<unsigned char>& encoded = filter.GetEncoded();
+        entry.nSize = (uint32_t)(32 + encoded.size());
+        if (nLastFileSize > 0 && nLastFileSize + entry.nSize > MAX_FILTER_FILE_SIZE) {
+            if (fflush(file) != 0 || fdatasync(fileno(file)) != 0)
+                throw std::runtime_error("cannot write " + FilterFilePath(nLastFile));
+            fclose(file);
+            nLastFile++;
+            nLastFileSize = 0;
+            // Left over from a crash before the store recorded this file.
+            file = fopen(FilterFilePath(nLastFile).c_str(), "wb");
+            if (!file)
+                throw std::runtime_error("cannot open " + FilterFilePath(nLastFile));
+        }
+        if (fwrite(ref.hashBlock.begin(), 1, 32, file) != 32 ||
+            fwrite(encoded.data(), 1, encoded.size(), file) != encoded.size()) {
+            throw std::runtime_error("cannot write " + FilterFilePath(nLastFile));
+        }
+        entry.pos = FlatFilePos(nLastFile, nLastFileSize);
+        nLastFileSize += entry.nSize;
+
+        buf.clear();
+        ByteWriter w(buf);
+        w.WriteVarInt(entry.pos.nFile);
+        w.WriteVarInt(entry.pos.nPos);
+        w.WriteVarInt(entry.nSize);
+        w.WriteBytes(entry.hashFilter.begin(), 32);
+        w.WriteBytes(entry.header.begin(), 32);
+        batch.Put(FilterKey(ref.hashBlock), std::string(buf.begin(), buf.end()));
+    }
+
+    // The records must be durable before the store points at them.
+    if (fflush(file) != 0 || fdatasync(fileno(file)) != 0)
+        throw std::runtime_error("cannot write " + FilterFilePath(nLastFile));
+    buf.clear();
+    ByteWriter w(buf);
+    w.WriteVarInt(nLastFile);
+    w.WriteVarInt(nLastFileSize);
+    batch.Put(std::string(1, DB_FILE_POS), std::string(buf.begin(), buf.end()));
+    PutBestBlock(batch, hashBest);
+    store->Write(batch);
+}
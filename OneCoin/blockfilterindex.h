@@ -0,0 +1,81 @@
+#ifndef ONECOIN_BLOCKFILTERINDEX_H
+#define ONECOIN_BLOCKFILTERINDEX_H
+
+#include "baseindex.h"
+#include "blockfilter.h"
+#include "chain.h"
+#include "uint256.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+/** Most filters a client may ask for in one range request (BIP 157). */
+static const int MAX_FILTER_RANGE = 1000;
+
+/** The store's record of one block's filter. */
+struct BlockFilterEntry {
+    /** The filter's record in the filter files. */
+    FlatFilePos pos;
+    uint32_t nSize;
+    uint256 hashFilter;
+    uint256 header;
+
+    BlockFilterEntry() : nSize(0) {}
+};
+
+/**
+ * An optional index of the basic filter of every block the active chain
+ * connects, for light clients. See BaseIndex for how it is built and kept
+ * up to date.
+ *
+ * Filters go to append-only files fltrNNNNN.dat in the index directory,
+ * each record the block hash followed by the encoded filter; the store
+ * maps the block hash to the record, the filter hash and the filter
+ * header. The files are synced before the store write that points into
+ * them, and a start truncates the last file to the end the store
+ * recorded, so a crash leaves no record the store does not know about.
+ *
+ * Filters of disconnected blocks stay: clients may still ask for them by
+ * block hash.
+ */
+class BlockFilterIndex : public BaseIndex {
+public:
+    static const unsigned int MAX_FILTER_FILE_SIZE = 0x1000000; // 16 MiB
+
+    BlockFilterIndex(const std::string& dir, Chainstate& chainstate);
+    ~BlockFilterIndex();
+
+    bool FindFilter(const uint256& hashBlock, BlockFilterEntry& entry) const;
+    /** Reads a filter back from the filter files. */
+    bool GetFilter(const uint256& hashBlock, BlockFilter& filter) const;
+    bool GetFilterHeader(const uint256& hashBlock, uint256& header) const;
+
+    /** The filters, filter hashes or filter headers of the blocks from
+     *  height nStartHeight up to pindexStop on pindexStop's chain, as light
+     *  clients request them. False if the range is empty, spans more than
+     *  MAX_FILTER_RANGE blocks or is not fully indexed. */
+    bool GetFilterRange(int nStartHeight, const BlockIndex* pindexStop, std::vector<BlockFilter>& filters) const;
+    bool GetFilterHashRange(int nStartHeight, const BlockIndex* pindexStop, std::vector<uint256>& hashes) const;
+    bool GetFilterHeaderRange(int nStartHeight, const BlockIndex* pindexStop, std::vector<uint256>& headers) const;
+
+    std::string FilterFilePath(int nFile) const;
+
+protected:
+    bool Init(std::string& error);
+    void WriteBlocks(const std::vector<BlockRef>& blocks, const uint256& hashBest);
+
+private:
+    /** The filter file being appended to, owned by the index thread once
+     *  started. */
+    FILE* file;
+    int nLastFile;
+    unsigned int nLastFileSize;
+
+    bool RangeEntries(int nStartHeight, const BlockIndex* pindexStop, std::vector<uint256>& hashBlocks,
+        std::vector<BlockFilterEntry>& entries) const;
+    bool ReadFilter(const uint256& hashBlock, const BlockFilterEntry& entry, BlockFilter& filter) const;
+};
+
+#endif // ONECOIN_BLOCKFILTERINDEX_H
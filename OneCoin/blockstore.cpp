@@ -0,0 +1,306 @@
+#include "blockstore.h"
+#include "batchread.h"
+#include "crc32c.h"
+#include "fs.h"
+#include "serialize.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+
+namespace {
+
+uint32_t UndoChecksum(const uint256& hashBlock, const unsigned char* data, size_t len)
+{
+    return Crc32cExtend(Crc32c(hashBlock.begin(), 32), data, len);
+}
+
+} // namespace
+
+BlockStore::BlockStore(const std::string& dir, const unsigned char messageStartIn[4])
+    : dir(dir), nMaxFileSize(MAX_BLOCKFILE_SIZE), nLastFile(0), nLastFileSize(0), blockFile(NULL), undoFile(NULL),
+      fPruning(false), fPruneStop(false)
+{
+    memcpy(messageStart, messageStartIn, 4);
+}
+
+BlockStore::~BlockStore()
+{
+    // Queued files are still deleted: the caller has forgotten them.
+    {
+        std::lock_guard<std::mutex> lock(pruneMutex);
+        fPruneStop = true;
+    }
+    pruneCond.notify_all();
+    if (pruneThread.joinable())
+        pruneThread.join();
+    if (blockFile)
+        fclose(blockFile);
+    if (undoFile)
+        fclose(undoFile);
+}
+
+std::string BlockStore::BlockFilePath(int nFile) const
+{
+    char name[16];
+    snprintf(name, sizeof(name), "blk%05d.dat", nFile);
+    return dir + "/" + name;
+}
+
+std::string BlockStore::UndoFilePath(int nFile) const
+{
+    char name[16];
+    snprintf(name, sizeof(name), "rev%05d.dat", nFile);
+    return dir + "/" + name;
+}
+
+bool BlockStore::Open(std::string& error)
+{
+    if (!CreateDirectories(dir)) {
+        error = "cannot create " + dir;
+        return false;
+    }
+    std::vector<int> files = ListFiles();
+    nLastFile = files.empty() ? 0 : files.back();
+    int64_t size = FileSize(BlockFilePath(nLastFile));
+    nLastFileSize = size < 0 ? 0 : (unsigned int)size;
+
+    blockFile = fopen(BlockFilePath(nLastFile).c_str(), "ab");
+    undoFile = fopen(UndoFilePath(nLastFile).c_str(), "ab");
+    if (!blockFile || !undoFile) {
+        error = "cannot open block files in " + dir;
+        return false;
+    }
+    return true;
+}
+
+bool BlockStore::Append(FILE* file, const std::vector<unsigned char>& payload, uint32_t nChecksum, unsigned int& nPos)
+{
+    unsigned char header[RECORD_HEADER_SIZE];
+    memcpy(header, messageStart, 4);
+    WriteLE32(header + 4, (uint32_t)payload.size());
+    WriteLE32(header + 8, nChecksum);
+    long offset = ftell(file);
+    if (offset < 0 || fwrite(header, 1, sizeof(header), file) != sizeof(header) ||
+        fwrite(payload.data(), 1, payload.size(), file) != payload.size()) {
+        return false;
+    }
+    nPos = (unsigned int)offset + RECORD_HEADER_SIZE;
+    return true;
+}
+
+bool BlockStore::WriteBlock(const Block& block, FlatFilePos& pos)
+{
+    std::vector<unsigned char> payload = SerializeBlock(block);
+    if (nLastFileSize > 0 && nLastFileSize + RECORD_HEADER_SIZE + payload.size() > nMaxFileSize) {
+        Flush();
+        fclose(blockFile);
+        fclose(undoFile);
+        nLastFile++;
+        nLastFileSize = 0;
+        blockFile = fopen(BlockFilePath(nLastFile).c_str(), "ab");
+        undoFile = fopen(UndoFilePath(nLastFile).c_str(), "ab");
+        if (!blockFile || !undoFile)
+            return false;
+    }
+    unsigned int nPos;
+    if (!Append(blockFile, payload, Crc32c(payload.data(), payload.size()), nPos) || fflush(blockFile) != 0)
+        return false;
+    nLastFileSize = nPos + payload.size();
+    pos = FlatFilePos(nLastFile, nPos);
+    return true;
+}
+
+bool BlockStore::WriteUndo(const BlockUndo& undo, const uint256& hashBlock, int nFile, FlatFilePos& pos)
+{
+    std::vector<unsigned char> payload;
+    ByteWriter w(payload);
+    SerializeBlockUndo(w, undo);
+    uint32_t nChecksum = UndoChecksum(hashBlock, payload.data(), payload.size());
+
+    // Undo data for an older file is only written when blocks are connected
+    // long after they were stored, e.g. during a reindex.
+    FILE* file = nFile == nLastFile ? undoFile : fopen(UndoFilePath(nFile).c_str(), "ab");
+    if (!file)
+        return false;
+    unsigned int nPos;
+    bool ok = Append(file, payload, nChecksum, nPos) && fflush(file) == 0;
+    if (file != undoFile)
+        fclose(file);
+    if (ok)
+        pos = FlatFilePos(nFile, nPos);
+    return ok;
+}
+
+bool BlockStore::ReadRecord(const std::string& path, const FlatFilePos& pos, std::vector<unsigned char>& out,
+    uint32_t& nChecksum) const
+{
+    if (pos.nPos < RECORD_HEADER_SIZE)
+        return false;
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    unsigned char header[RECORD_HEADER_SIZE];
+    bool ok = PreadAll(fd, header, sizeof(header), pos.nPos - RECORD_HEADER_SIZE) &&
+              memcmp(header, messageStart, 4) == 0 && ReadLE32(header + 4) <= MAX_BLOCKFILE_SIZE;
+    if (ok) {
+        out.resize(ReadLE32(header + 4));
+        nChecksum = ReadLE32(header + 8);
+        ok = PreadAll(fd, out.data(), out.size(), pos.nPos);
+    }
+    close(fd);
+    return ok;
+}
+
+bool BlockStore::ReadRawBlock(const FlatFilePos& pos, std::vector<unsigned char>& out) const
+{
+    uint32_t nChecksum;
+    return ReadRecord(BlockFilePath(pos.nFile), pos, out, nChecksum) && Crc32c(out.data(), out.size()) == nChecksum;
+}
+
+bool BlockStore::ReadBlockPart(const FlatFilePos& pos, unsigned int nOffset, size_t nSize,
+    std::vector<unsigned char>& out) const
+{
+    if (pos.nPos < RECORD_HEADER_SIZE)
+        return false;
+    int fd = open(BlockFilePath(pos.nFile).c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    unsigned char header[RECORD_HEADER_SIZE];
+    bool ok = PreadAll(fd, header, sizeof(header), pos.nPos - RECORD_HEADER_SIZE) &&
+              memcmp(header, messageStart, 4) == 0 && (uint64_t)nOffset + nSize <= ReadLE32(header + 4);
+    if (ok) {
+        out.resize(nSize);
+        ok = PreadAll(fd, out.data(), nSize, (uint64_t)pos.nPos + nOffset);
+    }
+    close(fd);
+    return ok;
+}
+
+bool BlockStore::ReadBlock(const FlatFilePos& pos, Block& block) const
+{
+    std::vector<unsigned char> raw;
+    if (!ReadRawBlock(pos, raw))
+        return false;
+    try {
+        ByteReader r(raw);
+        UnserializeBlock(r, block);
+    } catch (const SerializeError&) {
+        return false;
+    }
+    return true;
+}
+
+bool BlockStore::ReadUndo(const FlatFilePos& pos, const uint256& hashBlock, BlockUndo& undo) const
+{
+    std::vector<unsigned char> raw;
+    uint32_t nChecksum;
+    if (!ReadRecord(UndoFilePath(pos.nFile), pos, raw, nChecksum) ||
+        UndoChecksum(hashBlock, raw.data(), raw.size()) != nChecksum) {
+        return false;
+    }
+    try {
+        ByteReader r(raw);
+        UnserializeBlockUndo(r, undo);
+    } catch (const SerializeError&) {
+        return false;
+    }
+    return true;
+}
+
+void BlockStore::Flush()
+{
+    if (blockFile)
+        fflush(blockFile);
+    if (undoFile)
+        fflush(undoFile);
+}
+
+bool BlockStore::ScanBlockFile(int nFile, const RecordFn& fn) const
+{
+    std::vector<unsigned char> data;
+    if (!ReadFile(BlockFilePath(nFile), data))
+        return false;
+    ScanBlockRecords(nFile, data.data(), data.size(), fn);
+    return true;
+}
+
+void BlockStore::ScanBlockRecords(int nFile, const unsigned char* data, size_t size, const RecordFn& fn) const
+{
+    size_t pos = 0;
+    while (pos + RECORD_HEADER_SIZE <= size) {
+        if (memcmp(data + pos, messageStart, 4) != 0) {
+            pos++;
+            continue;
+        }
+        uint32_t len = ReadLE32(data + pos + 4);
+        if (len > size - pos - RECORD_HEADER_SIZE ||
+            Crc32c(data + pos + RECORD_HEADER_SIZE, len) != ReadLE32(data + pos + 8)) {
+            pos++;
+            continue;
+        }
+        fn(FlatFilePos(nFile, (unsigned int)(pos + RECORD_HEADER_SIZE)), data + pos + RECORD_HEADER_SIZE, len);
+        pos += RECORD_HEADER_SIZE + len;
+    }
+}
+
+std::vector<int> BlockStore::ListFiles() const
+{
+    std::vector<std::string> names;
+    std::vector<int> files;
+    if (!ListDirectory(dir, names))
+        return files;
+    for (size_t i = 0; i < names.size(); i++) {
+        const std::string& name = names[i];
+        if (name.size() == 12 && name.compare(0, 3, "blk") == 0 && name.compare(8, 4, ".dat") == 0 &&
+            name.find_first_not_of("0123456789", 3) == 8)
+            files.push_back(atoi(name.c_str() + 3));
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+bool BlockStore::HaveFile(int nFile) const
+{
+    return FileExists(BlockFilePath(nFile));
+}
+
+void BlockStore::PruneFile(int nFile)
+{
+    std::lock_guard<std::mutex> lock(pruneMutex);
+    if (!pruneThread.joinable())
+        pruneThread = std::thread(&BlockStore::PruneThread, this);
+    pruneQueue.push_back(nFile);
+    pruneCond.notify_all();
+}
+
+void BlockStore::WaitForPruning()
+{
+    std::unique_lock<std::mutex> lock(pruneMutex);
+    while (!pruneQueue.empty() || fPruning)
+        pruneCond.wait(lock);
+}
+
+void BlockStore::PruneThread()
+{
+    std::unique_lock<std::mutex> lock(pruneMutex);
+    while (true) {
+        while (pruneQueue.empty() && !fPruneStop)
+            pruneCond.wait(lock);
+        if (pruneQueue.empty())
+            return;
+        int nFile = pruneQueue.front();
+        pruneQueue.pop_front();
+        fPruning = true;
+        lock.unlock();
+        // A file that cannot be removed only costs space; the block index
+        // already treats it as gone.
+        RemoveFile(BlockFilePath(nFile));
+        RemoveFile(UndoFilePath(nFile));
+        lock.lock();
+        fPruning = false;
+        pruneCond.notify_all();
+    }
+}
@@ -0,0 +1,116 @@
+#ifndef ONECOIN_BLOCKSTORE_H
+#define ONECOIN_BLOCKSTORE_H
+
+#include "block.h"
+#include "chain.h"
+#include "undo.h"
+#include "uint256.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Append-only block and undo files, blkNNNNN.dat and revNNNNN.dat.
+ *
+ * Every record is the network magic, a 4-byte little-endian payload length,
+ * a 4-byte little-endian CRC-32C and the payload: a serialized block, or
+ * serialized undo data. A block's checksum covers its payload, an undo
+ * record's the block hash followed by the payload, so undo data is only
+ * ever applied to its own block. Reads check it: a record whose bytes
+ * changed on disk reads as missing. FlatFilePos points at the payload.
+ * Undo data for a block always goes to the undo file with the block's
+ * file number.
+ *
+ * Old file pairs can be pruned: PruneFile() hands them to a background
+ * thread that deletes them, so the caller never waits on the filesystem.
+ * File numbers are not reused, so the files on disk may start above 0.
+ */
+class BlockStore {
+public:
+    static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
+    static const size_t RECORD_HEADER_SIZE = 12;
+
+    BlockStore(const std::string& dir, const unsigned char messageStart[4]);
+    ~BlockStore();
+
+    /** Creates the directory and resumes after the last block file. */
+    bool Open(std::string& error);
+    /** Size at which a new block file is started, MAX_BLOCKFILE_SIZE by
+     *  default. */
+    void SetMaxFileSize(unsigned int nBytes) { nMaxFileSize = nBytes; }
+
+    bool WriteBlock(const Block& block, FlatFilePos& pos);
+    bool ReadBlock(const FlatFilePos& pos, Block& block) const;
+    /** Raw serialized block at pos. */
+    bool ReadRawBlock(const FlatFilePos& pos, std::vector<unsigned char>& out) const;
+    /** nSize bytes at nOffset into the serialized block at pos, such as its
+     *  header or one of its transactions, without reading the rest. The
+     *  checksum covers the whole block, so it is not checked: the caller
+     *  checks what it reads, e.g. against a txid. */
+    bool ReadBlockPart(const FlatFilePos& pos, unsigned int nOffset, size_t nSize,
+        std::vector<unsigned char>& out) const;
+
+    bool WriteUndo(const BlockUndo& undo, const uint256& hashBlock, int nFile, FlatFilePos& pos);
+    bool ReadUndo(const FlatFilePos& pos, const uint256& hashBlock, BlockUndo& undo) const;
+
+    /** Pushes buffered writes to the OS. */
+    void Flush();
+
+    /** Highest block file number in use. */
+    int LastFile() const { return nLastFile; }
+    /** Numbers of the block files on disk in ascending order; works before
+     *  Open(). */
+    std::vector<int> ListFiles() const;
+    bool HaveFile(int nFile) const;
+    std::string BlockFilePath(int nFile) const;
+    std::string UndoFilePath(int nFile) const;
+    const std::string& Dir() const { return dir; }
+
+    typedef std::function<void(const FlatFilePos& pos, const unsigned char* data, size_t len)> RecordFn;
+    /** Calls fn for every well-formed record of block file nFile whose
+     *  checksum matches, skipping garbage between records. False if the
+     *  file cannot be read. */
+    bool ScanBlockFile(int nFile, const RecordFn& fn) const;
+    /** The same over block file nFile already in memory, e.g. mapped. */
+    void ScanBlockRecords(int nFile, const unsigned char* data, size_t size, const RecordFn& fn) const;
+
+    /** Queues the block and undo files of nFile, which must be below the
+     *  last file, for deletion in the background. */
+    void PruneFile(int nFile);
+    /** Waits until every queued file is deleted. */
+    void WaitForPruning();
+
+private:
+    std::string dir;
+    unsigned char messageStart[4];
+    unsigned int nMaxFileSize;
+    int nLastFile;
+    unsigned int nLastFileSize;
+    FILE* blockFile;
+    FILE* undoFile;
+
+    std::mutex pruneMutex;
+    std::condition_variable pruneCond;
+    /** Started by the first PruneFile(). */
+    std::thread pruneThread;
+    std::deque<int> pruneQueue;
+    /** Whether the prune thread is deleting a file it took off the queue. */
+    bool fPruning;
+    bool fPruneStop;
+
+    void PruneThread();
+
+    bool Append(FILE* file, const std::vector<unsigned char>& payload, uint32_t nChecksum, unsigned int& nPos);
+    /** The payload of the record at pos and the checksum stored with it. */
+    bool ReadRecord(const std::string& path, const FlatFilePos& pos, std::vector<unsigned char>& out,
+        uint32_t& nChecksum) const;
+};
+
+#endif // ONECOIN_BLOCKSTORE_H
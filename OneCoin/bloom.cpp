@@ -0,0 +1,118 @@
+#include "bloom.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <random>
+
+namespace {
+
+inline uint32_t RotateLeft32(uint32_t x, int r) { return (x << r) | (x >> (32 - r)); }
+
+/** Maps x uniformly onto [0, n) without a division. */
+inline uint32_t FastRange32(uint32_t x, uint32_t n) { return (uint32_t)(((uint64_t)x * n) >> 32); }
+
+} // namespace
+
+uint32_t MurmurHash3(uint32_t seed, const unsigned char* data, size_t len)
+{
+    const uint32_t c1 = 0xcc9e2d51, c2 = 0x1b873593;
+    uint32_t h1 = seed;
+    size_t nBlocks = len / 4;
+    for (size_t i = 0; i < nBlocks; i++) {
+        uint32_t k1;
+        memcpy(&k1, data + i * 4, 4);
+        k1 *= c1;
+        k1 = RotateLeft32(k1, 15);
+        k1 *= c2;
+        h1 ^= k1;
+        h1 = RotateLeft32(h1, 13);
+        h1 = h1 * 5 + 0xe6546b64;
+    }
+    const unsigned char* tail = data + nBlocks * 4;
+    uint32_t k1 = 0;
+    switch (len & 3) {
+    case 3:
+        k1 ^= tail[2] << 16;
+        // fall through
+    case 2:
+        k1 ^= tail[1] << 8;
+        // fall through
+    case 1:
+        k1 ^= tail[0];
+        k1 *= c1;
+        k1 = RotateLeft32(k1, 15);
+        k1 *= c2;
+        h1 ^= k1;
+    }
+    h1 ^= (uint32_t)len;
+    h1 ^= h1 >> 16;
+    h1 *= 0x85ebca6b;
+    h1 ^= h1 >> 13;
+    h1 *= 0xc2b2ae35;
+    h1 ^= h1 >> 16;
+    return h1;
+}
+
+RollingBloomFilter::RollingBloomFilter(unsigned int nElements, double fpRate)
+{
+    // Three generations of half the elements each are live at once.
+    nEntriesPerGeneration = (int)((nElements + 1) / 2);
+    double nMaxElements = nEntriesPerGeneration * 3.0;
+    double logFpRate = log(fpRate);
+    nHashFuncs = std::max(1, std::min((int)round(logFpRate / log(0.5)), 50));
+    uint32_t nFilterBits = (uint32_t)ceil(-1.0 * nHashFuncs * nMaxElements / log(1.0 - exp(logFpRate / nHashFuncs)));
+    data.resize(((nFilterBits + 63) / 64) * 2);
+    Reset();
+}
+
+uint32_t RollingBloomFilter::Hash(int n, const unsigned char* key, size_t len) const
+{
+    return MurmurHash3((uint32_t)n * 0xfba4c795 + nTweak, key, len);
+}
+
+void RollingBloomFilter::Insert(const unsigned char* key, size_t len)
+{
+    if (nEntriesThisGeneration == nEntriesPerGeneration) {
+        nEntriesThisGeneration = 0;
+        nGeneration = nGeneration == 3 ? 1 : nGeneration + 1;
+        // Clear every bit tagged with the generation being reused.
+        uint64_t nMask1 = 0 - (uint64_t)(nGeneration & 1);
+        uint64_t nMask2 = 0 - (uint64_t)(nGeneration >> 1);
+        for (size_t p = 0; p < data.size(); p += 2) {
+            uint64_t p1 = data[p], p2 = data[p + 1];
+            uint64_t mask = (p1 ^ nMask1) | (p2 ^ nMask2);
+            data[p] = p1 & mask;
+            data[p + 1] = p2 & mask;
+        }
+    }
+    nEntriesThisGeneration++;
+
+    for (int n = 0; n < nHashFuncs; n++) {
+        uint32_t h = Hash(n, key, len);
+        int bit = h & 0x3f;
+        uint32_t pos = FastRange32(h, (uint32_t)data.size());
+        data[pos & ~1U] = (data[pos & ~1U] & ~((uint64_t)1 << bit)) | ((uint64_t)(nGeneration & 1)) << bit;
+        data[pos | 1] = (data[pos | 1] & ~((uint64_t)1 << bit)) | ((uint64_t)(nGeneration >> 1)) << bit;
+    }
+}
+
+bool RollingBloomFilter::Contains(const unsigned char* key, size_t len) const
+{
+    for (int n = 0; n < nHashFuncs; n++) {
+        uint32_t h = Hash(n, key, len);
+        int bit = h & 0x3f;
+        uint32_t pos = FastRange32(h, (uint32_t)data.size());
+        if (!(((data[pos & ~1U] | data[pos | 1]) >> bit) & 1))
+            return false;
+    }
+    return true;
+}
+
+void RollingBloomFilter::Reset()
+{
+    nTweak = std::random_device()();
+    nEntriesThisGeneration = 0;
+    nGeneration = 1;
+    std::fill(data.begin(), data.end(), 0);
+}
@@ -0,0 +1,48 @@
+#ifndef ONECOIN_BLOOM_H
+#define ONECOIN_BLOOM_H
+
+#include "uint256.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/** MurmurHash3 (x86, 32-bit): fast and well mixed, not collision resistant. */
+uint32_t MurmurHash3(uint32_t seed, const unsigned char* data, size_t len);
+
+/**
+ * A bloom filter that remembers at least the last nElements insertions and
+ * forgets older ones, in fixed memory. Entries are tagged with one of three
+ * generations in two bit planes; starting a new generation clears the bits
+ * of the oldest. Hashes are keyed with a random tweak, so peers cannot aim
+ * for false positives.
+ *
+ * Made for recently rejected transactions: a re-announced txid is dropped
+ * with a lookup, and a false positive only costs fetching it again later.
+ */
+class RollingBloomFilter {
+public:
+    RollingBloomFilter(unsigned int nElements, double fpRate);
+
+    void Insert(const unsigned char* data, size_t len);
+    void Insert(const uint256& hash) { Insert(hash.begin(), 32); }
+    bool Contains(const unsigned char* data, size_t len) const;
+    bool Contains(const uint256& hash) const { return Contains(hash.begin(), 32); }
+    /** Forgets everything and picks a new tweak. */
+    void Reset();
+
+    size_t MemoryUsage() const { return data.size() * sizeof(uint64_t); }
+
+private:
+    int nEntriesPerGeneration;
+    int nEntriesThisGeneration;
+    int nGeneration;
+    int nHashFuncs;
+    uint32_t nTweak;
+    /** Pairs of words: bit i of the pair holds bit i's generation. */
+    std::vector<uint64_t> data;
+
+    uint32_t Hash(int n, const unsigned char* key, size_t len) const;
+};
+
+#endif // ONECOIN_BLOOM_H
@@ -0,0 +1,149 @@
+#include "chain.h"
+
+#include <algorithm>
+
+BlockHeader BlockIndex::GetBlockHeader() const
+{
+    BlockHeader header;
+    header.nVersion = nVersion;
+    if (pprev)
+        header.hashPrevBlock = pprev->GetBlockHash();
+    header.hashMerkleRoot = hashMerkleRoot;
+    header.nTime = nTime;
+    header.nBits = nBits;
+    header.nNonce = nNonce;
+    return header;
+}
+
+int64_t BlockIndex::GetMedianTimePast() const
+{
+    int64_t times[MEDIAN_TIME_SPAN];
+    int n = 0;
+    for (const BlockIndex* pindex = this; pindex && n < MEDIAN_TIME_SPAN; pindex = pindex->pprev)
+        times[n++] = pindex->GetBlockTime();
+    std::sort(times, times + n);
+    return times[n / 2];
+}
+
+namespace {
+
+/** Clears the lowest set bit. */
+int InvertLowestOne(int n) { return n & (n - 1); }
+
+/** Height pskip points to: far enough back for O(log n) lookups, and shared
+ *  by nearby heights so walks from different blocks meet quickly. */
+int GetSkipHeight(int height)
+{
+    if (height < 2)
+        return 0;
+    return (height & 1) ? InvertLowestOne(InvertLowestOne(height - 1)) + 1 : InvertLowestOne(height);
+}
+
+} // namespace
+
+void BlockIndex::BuildSkip()
+{
+    if (pprev)
+        pskip = pprev->GetAncestor(GetSkipHeight(nHeight));
+}
+
+BlockIndex* BlockIndex::GetAncestor(int height)
+{
+    if (height > nHeight || height < 0)
+        return NULL;
+    BlockIndex* pindex = this;
+    int heightWalk = nHeight;
+    while (heightWalk > height) {
+        int heightSkip = GetSkipHeight(heightWalk);
+        int heightSkipPrev = GetSkipHeight(heightWalk - 1);
+        // Take the skip unless stepping back one first would skip closer.
+        if (pindex->pskip &&
+            (heightSkip == height || (heightSkip > height && !(heightSkipPrev < heightSkip - 2 && heightSkipPrev >= height)))) {
+            pindex = pindex->pskip;
+            heightWalk = heightSkip;
+        } else {
+            pindex = pindex->pprev;
+            heightWalk--;
+        }
+    }
+    return pindex;
+}
+
+const BlockIndex* BlockIndex::GetAncestor(int height) const
+{
+    return const_cast<BlockIndex*>(this)->GetAncestor(height);
+}
+
+const BlockIndex* LastCommonAncestor(const BlockIndex* a, const BlockIndex* b)
+{
+    if (a->nHeight > b->nHeight)
+        a = a->GetAncestor(b->nHeight);
+    else if (b->nHeight > a->nHeight)
+        b = b->GetAncestor(a->nHeight);
+    // At equal heights the skip links land at equal heights too; take them
+    // while they still differ.
+    while (a != b) {
+        if (a->pskip && b->pskip && a->pskip != b->pskip) {
+            a = a->pskip;
+            b = b->pskip;
+        } else {
+            a = a->pprev;
+            b = b->pprev;
+        }
+    }
+    return a;
+}
+
+BlockIndex* BlockIndexArena::Add(const BlockHeader& header)
+{
+    if (chunks.empty() || chunks.back().size() == CHUNK_SIZE) {
+        chunks.push_back(std::vector<BlockIndex>());
+        chunks.back().reserve(CHUNK_SIZE);
+    }
+    chunks.back().push_back(BlockIndex(header));
+    nSize++;
+    return &chunks.back().back();
+}
+
+void ActiveChain::SetTip(BlockIndex* pindex)
+{
+    if (!pindex) {
+        vChain.clear();
+        return;
+    }
+    vChain.resize(pindex->nHeight + 1);
+    while (pindex && vChain[pindex->nHeight] != pindex) {
+        vChain[pindex->nHeight] = pindex;
+        pindex = pindex->pprev;
+    }
+}
+
+const BlockIndex* ActiveChain::FindFork(const BlockIndex* pindex) const
+{
+    if (!pindex)
+        return NULL;
+    if (pindex->nHeight > Height())
+        pindex = pindex->GetAncestor(Height());
+    while (pindex && !Contains(pindex))
+        pindex = pindex->pprev;
+    return pindex;
+}
+
+std::vector<uint256> ActiveChain::GetLocator(const BlockIndex* pindex) const
+{
+    if (!pindex)
+        pindex = Tip();
+    std::vector<uint256> have;
+    int nStep = 1;
+    while (pindex) {
+        have.push_back(pindex->GetBlockHash());
+        if (pindex->nHeight == 0)
+            break;
+        int nHeight = std::max(pindex->nHeight - nStep, 0);
+        // On the active chain the vector answers; elsewhere the skip links.
+        pindex = Contains(pindex) ? (*this)[nHeight] : pindex->GetAncestor(nHeight);
+        if (have.size() > 10)
+            nStep *= 2;
+    }
+    return have;
+}
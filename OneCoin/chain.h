@@ -0,0 +1,143 @@
+#ifndef ONECOIN_CHAIN_H
+#define ONECOIN_CHAIN_H
+
+#include "arith_uint256.h"
+#include "block.h"
+#include "uint256.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/** Where a record lives in the block or undo files. */
+struct FlatFilePos {
+    int nFile;
+    unsigned int nPos;
+
+    FlatFilePos() : nFile(-1), nPos(0) {}
+    FlatFilePos(int nFile, unsigned int nPos) : nFile(nFile), nPos(nPos) {}
+
+    bool IsNull() const { return nFile == -1; }
+};
+
+enum BlockStatus {
+    /** Full block is stored in the block files. */
+    BLOCK_HAVE_DATA = 1,
+    /** Undo data is stored in the undo files. */
+    BLOCK_HAVE_UNDO = 2,
+    /** Passed context-free and header checks. */
+    BLOCK_VALID_TREE = 4,
+    /** Connected to the UTXO set at least once. */
+    BLOCK_VALID_SCRIPTS = 8,
+    /** Failed validation itself. */
+    BLOCK_FAILED_VALID = 16,
+    /** Descends from a block that failed. */
+    BLOCK_FAILED_CHILD = 32,
+    BLOCK_FAILED_MASK = BLOCK_FAILED_VALID | BLOCK_FAILED_CHILD,
+};
+
+/** One entry of the block tree. Entries live in a BlockIndexArena and are
+ *  linked to their parent, so any chain can be walked back to genesis. */
+class BlockIndex {
+public:
+    /** Points at the key of the owning map entry. */
+    const uint256* phashBlock;
+    BlockIndex* pprev;
+    /** An ancestor further back, set by BuildSkip(). */
+    BlockIndex* pskip;
+    int nHeight;
+    /** Total work of the chain up to and including this block. */
+    arith_uint256 nChainWork;
+    unsigned int nTx;
+    uint32_t nStatus;
+    FlatFilePos blockPos;
+    FlatFilePos undoPos;
+    /** Order in which block data arrived; breaks chainwork ties. */
+    uint64_t nSequenceId;
+
+    int32_t nVersion;
+    uint256 hashMerkleRoot;
+    uint32_t nTime;
+    uint32_t nBits;
+    uint32_t nNonce;
+
+    explicit BlockIndex(const BlockHeader& header)
+        : phashBlock(NULL), pprev(NULL), pskip(NULL), nHeight(0), nTx(0), nStatus(0), nSequenceId(0),
+          nVersion(header.nVersion), hashMerkleRoot(header.hashMerkleRoot), nTime(header.nTime),
+          nBits(header.nBits), nNonce(header.nNonce)
+    {
+    }
+
+    const uint256& GetBlockHash() const { return *phashBlock; }
+    BlockHeader GetBlockHeader() const;
+    int64_t GetBlockTime() const { return (int64_t)nTime; }
+
+    static const int MEDIAN_TIME_SPAN = 11;
+    /** Median time of this block and up to ten predecessors. */
+    int64_t GetMedianTimePast() const;
+
+    /** Points pskip at the ancestor GetAncestor() jumps to; call once
+     *  pprev and nHeight are set. */
+    void BuildSkip();
+
+    /** Ancestor at nHeight, in O(log n) hops along skip and parent links. */
+    BlockIndex* GetAncestor(int nHeight);
+    const BlockIndex* GetAncestor(int nHeight) const;
+};
+
+/** Last block both a and b descend from. */
+const BlockIndex* LastCommonAncestor(const BlockIndex* a, const BlockIndex* b);
+
+/**
+ * Owns block index entries in fixed-size chunks. Entries added together sit
+ * next to each other in memory and never move, so pprev, pskip and
+ * phashBlock stay valid for the arena's lifetime.
+ */
+class BlockIndexArena {
+public:
+    static const size_t CHUNK_SIZE = 4096;
+
+    BlockIndexArena() : nSize(0) {}
+
+    BlockIndex* Add(const BlockHeader& header);
+    size_t size() const { return nSize; }
+
+private:
+    /** Each reserved to CHUNK_SIZE up front, so it never reallocates. */
+    std::vector<std::vector<BlockIndex> > chunks;
+    size_t nSize;
+};
+
+/** The active chain as a vector indexed by height: membership, the block at
+ *  a height and the fork point with another chain are array lookups. */
+class ActiveChain {
+public:
+    BlockIndex* Tip() const { return vChain.empty() ? NULL : vChain.back(); }
+    BlockIndex* Genesis() const { return vChain.empty() ? NULL : vChain[0]; }
+    int Height() const { return (int)vChain.size() - 1; }
+
+    BlockIndex* operator[](int nHeight) const
+    {
+        return nHeight < 0 || nHeight >= (int)vChain.size() ? NULL : vChain[nHeight];
+    }
+    bool Contains(const BlockIndex* pindex) const { return (*this)[pindex->nHeight] == pindex; }
+    /** Successor of pindex, if both are on the chain. */
+    BlockIndex* Next(const BlockIndex* pindex) const
+    {
+        return Contains(pindex) ? (*this)[pindex->nHeight + 1] : NULL;
+    }
+
+    /** Makes pindex the tip, rewriting only the heights that changed; NULL
+     *  empties the chain. */
+    void SetTip(BlockIndex* pindex);
+    /** Last block of this chain that pindex descends from, or NULL. */
+    const BlockIndex* FindFork(const BlockIndex* pindex) const;
+    /** Hashes back from pindex (default the tip): the last ten, then
+     *  doubling steps, ending at genesis. */
+    std::vector<uint256> GetLocator(const BlockIndex* pindex = NULL) const;
+
+private:
+    std::vector<BlockIndex*> vChain;
+};
+
+#endif // ONECOIN_CHAIN_H
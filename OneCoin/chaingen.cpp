@@ -0,0 +1,703 @@
+#include "chaingen.h"
+#include "encoding.h"
+#include "fs.h"
+#include "hash.h"
+#include "key.h"
+#include "miner.h"
+#include "pow.h"
+#include "sighash.h"
+#include "validation.h"
+
+#include "../include/catch2/json.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <random>
+
+using nlohmann::json;
+
+const char* const ChainGenerator::MANIFEST_NAME = "manifest.json";
+
+namespace {
+
+/** Outputs at this value are dust: created, never spent. */
+const Amount DUST_VALUE = 546;
+/** Smallest output the generator otherwise creates. */
+const Amount MIN_OUTPUT = 10000;
+/** Blocks are closed below the consensus limit to leave room for the
+ *  coinbase and for size estimates being a little short. */
+const size_t BLOCK_FILL_SIZE = MAX_BLOCK_SIZE - 50000;
+/** Below this many spendable coins every transaction is a fan-out, so the
+ *  wallet grows quickly once the first coinbases mature. */
+const size_t WALLET_LOW_WATER = 64;
+const int64_t CHAIN_DURATION = 300 * 24 * 60 * 60;
+
+const char* const SHAPE_NAMES[SHAPE_COUNT] = {"payment", "fan_out", "fan_in", "multisig", "chain", "dust"};
+
+enum CoinKind {
+    COIN_P2PKH,
+    COIN_P2SH_MULTISIG, //!< 2-of-3 behind a script hash
+    COIN_BARE_MULTISIG, //!< 1-of-2 in the output itself
+};
+
+struct WalletCoin {
+    OutPoint outpoint;
+    Amount nValue;
+    CoinKind kind;
+    /** First key of the script; multisig scripts use the keys after it. */
+    int nKey;
+};
+
+/** Serialized size of an input spending a coin of the given kind, with
+ *  72-byte signatures; real signatures are rarely longer. */
+size_t InputSize(CoinKind kind)
+{
+    switch (kind) {
+    case COIN_P2PKH:
+        return 32 + 4 + 1 + (1 + 72) + (1 + 33) + 4;
+    case COIN_P2SH_MULTISIG:
+        return 32 + 4 + 3 + 1 + 2 * (1 + 72) + (2 + 105) + 4;
+    case COIN_BARE_MULTISIG:
+        return 32 + 4 + 1 + 1 + (1 + 72) + 4;
+    }
+    return 0;
+}
+
+class Workload {
+public:
+    Workload(const ChainGenOptions& options, ChainManifest& manifest)
+        : options(options), manifest(manifest), rng(options.seed)
+    {
+        for (int i = 0; i < options.nKeys; i++)
+            MakeKey(i);
+        for (int i = 0; i < options.nKeys; i++) {
+            std::vector<std::vector<unsigned char> > pubkeys;
+            for (int j = 0; j < 3; j++)
+                pubkeys.push_back(pubkeys_[(i + j) % options.nKeys].Raw());
+            redeemScripts.push_back(GetScriptForMultisig(2, pubkeys));
+            pubkeys.pop_back();
+            bareScripts.push_back(GetScriptForMultisig(1, pubkeys));
+        }
+        for (int i = 0; i < SHAPE_COUNT; i++)
+            nTotalWeight += options.weights[i];
+    }
+
+    Script CoinbaseScript(int nHeight) const { return ScriptFor(COIN_P2PKH, nHeight % options.nKeys); }
+
+    void CoinbaseConnected(const Transaction& coinbase, int nHeight)
+    {
+        WalletCoin coin;
+        coin.outpoint = OutPoint(coinbase.GetHash(), 0);
+        coin.nValue = coinbase.vout[0].nValue;
+        coin.kind = COIN_P2PKH;
+        coin.nKey = nHeight % options.nKeys;
+        immature.push_back(std::make_pair(nHeight + COINBASE_MATURITY, coin));
+    }
+
+    /** Transactions for the block at nHeight, in dependency order. */
+    void FillBlock(int nHeight, std::vector<TransactionRef>& txs, std::vector<Amount>& fees)
+    {
+        while (!immature.empty() && immature.front().first <= nHeight) {
+            wallet.push_back(immature.front().second);
+            immature.erase(immature.begin());
+        }
+        size_t nBlockSize = 0;
+        for (int n = 0; n < options.nTxPerBlock && !wallet.empty() && nBlockSize < BLOCK_FILL_SIZE; n++) {
+            ChainGenShape shape = wallet.size() < WALLET_LOW_WATER ? SHAPE_FAN_OUT : PickShape();
+            size_t nBefore = txs.size();
+            bool fBuilt = false;
+            switch (shape) {
+            case SHAPE_PAYMENT: fBuilt = BuildPayment(txs, fees, 0); break;
+            case SHAPE_FAN_OUT: fBuilt = BuildFanOut(txs, fees); break;
+            case SHAPE_FAN_IN: fBuilt = BuildFanIn(txs, fees); break;
+            case SHAPE_MULTISIG: fBuilt = BuildMultisig(txs, fees); break;
+            case SHAPE_CHAIN: fBuilt = BuildChain(txs, fees, BLOCK_FILL_SIZE - nBlockSize); break;
+            case SHAPE_DUST: fBuilt = BuildPayment(txs, fees, 1 + Rand(3)); break;
+            case SHAPE_COUNT: break;
+            }
+            if (!fBuilt)
+                continue;
+            manifest.nShapes[shape]++;
+            for (size_t i = nBefore; i < txs.size(); i++)
+                nBlockSize += txs[i]->GetTotalSize();
+        }
+        // Change becomes spendable in the next block.
+        wallet.insert(wallet.end(), created.begin(), created.end());
+        created.clear();
+    }
+
+private:
+    const ChainGenOptions& options;
+    ChainManifest& manifest;
+    /** Engines are fully specified by the standard; distributions are not,
+     *  so draws go through Rand() to stay identical across libraries. */
+    std::mt19937_64 rng;
+    unsigned int nTotalWeight = 0;
+
+    std::vector<Key> keys;
+    std::vector<PubKey> pubkeys_;
+    std::vector<Script> p2pkhScripts;
+    std::vector<Script> redeemScripts;
+    std::vector<Script> bareScripts;
+
+    std::vector<WalletCoin> wallet;
+    std::vector<WalletCoin> created;
+    std::vector<std::pair<int, WalletCoin> > immature;
+
+    uint64_t Rand(uint64_t n) { return rng() % n; }
+
+    void MakeKey(int i)
+    {
+        Key key;
+        for (uint32_t nCounter = 0; !key.IsValid(); nCounter++) {
+            unsigned char data[20], secret[32];
+            WriteLE64(data, options.seed);
+            memcpy(data + 8, "key ", 4);
+            WriteLE32(data + 12, (uint32_t)i);
+            WriteLE32(data + 16, nCounter);
+            Sha256Hash(data, sizeof(data), secret);
+            key.Set(secret);
+        }
+        keys.push_back(key);
+        pubkeys_.push_back(key.GetPubKey());
+        unsigned char hash[20];
+        pubkeys_.back().GetHash160(hash);
+        p2pkhScripts.push_back(GetScriptForPubKeyHash(hash));
+    }
+
+    Script ScriptFor(CoinKind kind, int nKey) const
+    {
+        switch (kind) {
+        case COIN_P2PKH:
+            return p2pkhScripts[nKey];
+        case COIN_P2SH_MULTISIG: {
+            unsigned char hash[20];
+            Hash160(redeemScripts[nKey].data(), redeemScripts[nKey].size(), hash);
+            return GetScriptForScriptHash(hash);
+        }
+        case COIN_BARE_MULTISIG:
+            return bareScripts[nKey];
+        }
+        return Script();
+    }
+
+    ChainGenShape PickShape()
+    {
+        uint64_t r = Rand(nTotalWeight);
+        for (int i = 0; i < SHAPE_COUNT; i++) {
+            if (r < options.weights[i])
+                return (ChainGenShape)i;
+            r -= options.weights[i];
+        }
+        return SHAPE_PAYMENT;
+    }
+
+    WalletCoin TakeCoin()
+    {
+        size_t i = Rand(wallet.size());
+        WalletCoin coin = wallet[i];
+        wallet[i] = wallet.back();
+        wallet.pop_back();
+        return coin;
+    }
+
+    /** Takes up to n coins, fewer when the wallet runs short. */
+    std::vector<WalletCoin> TakeCoins(size_t n)
+    {
+        std::vector<WalletCoin> coins;
+        while (coins.size() < n && !wallet.empty())
+            coins.push_back(TakeCoin());
+        return coins;
+    }
+
+    void ReturnCoins(const std::vector<WalletCoin>& coins) { wallet.insert(wallet.end(), coins.begin(), coins.end()); }
+
+    /** A random fee rate of 1-20 units per byte, skewed low. */
+    Amount Fee(size_t nSize)
+    {
+        uint64_t r = Rand(20);
+        return (Amount)nSize * (Amount)(1 + (r * r) / 20);
+    }
+
+    /** Output to a random key: mostly P2PKH. */
+    TxOut RandomOutput(Amount nValue, CoinKind& kind, int& nKey)
+    {
+        kind = COIN_P2PKH;
+        nKey = (int)Rand(options.nKeys);
+        return TxOut(nValue, ScriptFor(kind, nKey));
+    }
+
+    size_t EstimateSize(const std::vector<WalletCoin>& coins, const std::vector<TxOut>& vout) const
+    {
+        size_t n = 4 + 1 + 1 + 4;
+        for (size_t i = 0; i < coins.size(); i++)
+            n += InputSize(coins[i].kind);
+        for (size_t i = 0; i < vout.size(); i++)
+            n += 8 + 1 + vout[i].scriptPubKey.size();
+        return n;
+    }
+
+    /** Signs every input of tx, which spends coins in order. */
+    void Sign(MutableTransaction& tx, const std::vector<WalletCoin>& coins) const
+    {
+        Transaction txConst(tx);
+        for (size_t i = 0; i < coins.size(); i++) {
+            const WalletCoin& coin = coins[i];
+            Script scriptCode =
+                coin.kind == COIN_P2SH_MULTISIG ? redeemScripts[coin.nKey] : ScriptFor(coin.kind, coin.nKey);
+            uint256 hash = SignatureHash(scriptCode, txConst, (unsigned int)i, SIGHASH_ALL);
+            Script scriptSig;
+            int nSigs = coin.kind == COIN_P2SH_MULTISIG ? 2 : 1;
+            if (coin.kind != COIN_P2PKH)
+                scriptSig << OP_0;
+            for (int j = 0; j < nSigs; j++) {
+                std::vector<unsigned char> sig;
+                keys[(coin.nKey + j) % options.nKeys].Sign(hash, sig);
+                sig.push_back((unsigned char)SIGHASH_ALL);
+                scriptSig << sig;
+            }
+            if (coin.kind == COIN_P2PKH)
+                scriptSig << pubkeys_[coin.nKey].Raw();
+            else if (coin.kind == COIN_P2SH_MULTISIG)
+                scriptSig << std::vector<unsigned char>(redeemScripts[coin.nKey].begin(), redeemScripts[coin.nKey].end());
+            tx.vin[i].scriptSig = scriptSig;
+        }
+    }
+
+    /**
+     * Signs and records a transaction spending coins. outKinds/outKeys
+     * describe vout; entries with a negative key are not tracked by the
+     * wallet (dust). Output fSpendable of them go back to the wallet unless
+     * fHold, in which case the caller keeps them.
+     */
+    TransactionRef Finish(const std::vector<WalletCoin>& coins, std::vector<TxOut>& vout,
+        const std::vector<CoinKind>& outKinds, const std::vector<int>& outKeys, std::vector<TransactionRef>& txs,
+        std::vector<Amount>& fees, Amount nFee, bool fHold = false)
+    {
+        MutableTransaction mtx;
+        for (size_t i = 0; i < coins.size(); i++)
+            mtx.vin.push_back(TxIn(coins[i].outpoint));
+        mtx.vout = vout;
+        Sign(mtx, coins);
+        TransactionRef tx = MakeTransactionRef(std::move(mtx));
+        txs.push_back(tx);
+        fees.push_back(nFee);
+        manifest.nTransactions++;
+        manifest.nInputs += tx->vin.size();
+        manifest.nOutputs += tx->vout.size();
+        if (!fHold) {
+            for (size_t i = 0; i < tx->vout.size(); i++) {
+                if (outKeys[i] < 0) {
+                    manifest.nDustOutputs++;
+                    continue;
+                }
+                WalletCoin coin;
+                coin.outpoint = OutPoint(tx->GetHash(), (uint32_t)i);
+                coin.nValue = tx->vout[i].nValue;
+                coin.kind = outKinds[i];
+                coin.nKey = outKeys[i];
+                created.push_back(coin);
+            }
+        }
+        return tx;
+    }
+
+    static Amount Sum(const std::vector<WalletCoin>& coins)
+    {
+        Amount n = 0;
+        for (size_t i = 0; i < coins.size(); i++)
+            n += coins[i].nValue;
+        return n;
+    }
+
+    /** One or two inputs to a payee plus change, and nDust dust outputs. */
+    bool BuildPayment(std::vector<TransactionRef>& txs, std::vector<Amount>& fees, int nDust)
+    {
+        std::vector<WalletCoin> coins = TakeCoins(1 + Rand(2));
+        Amount nIn = Sum(coins);
+        std::vector<TxOut> vout(2);
+        std::vector<CoinKind> kinds(2);
+        std::vector<int> keyIdx(2);
+        vout[0] = RandomOutput(0, kinds[0], keyIdx[0]);
+        vout[1] = RandomOutput(0, kinds[1], keyIdx[1]);
+        for (int i = 0; i < nDust; i++) {
+            vout.push_back(TxOut(DUST_VALUE, p2pkhScripts[Rand(options.nKeys)]));
+            kinds.push_back(COIN_P2PKH);
+            keyIdx.push_back(-1);
+        }
+        Amount nFee = Fee(EstimateSize(coins, vout));
+        Amount nAvail = nIn - nFee - nDust * DUST_VALUE;
+        if (nAvail < 2 * MIN_OUTPUT) {
+            // Too small to split: merge it into the next fan-in instead.
+            if (nAvail < MIN_OUTPUT) {
+                ReturnCoins(coins);
+                return false;
+            }
+            vout.erase(vout.begin() + 1);
+            kinds.erase(kinds.begin() + 1);
+            keyIdx.erase(keyIdx.begin() + 1);
+            vout[0].nValue = nAvail;
+        } else {
+            vout[0].nValue = MIN_OUTPUT + (Amount)Rand((uint64_t)(nAvail - 2 * MIN_OUTPUT + 1));
+            vout[1].nValue = nAvail - vout[0].nValue;
+        }
+        Finish(coins, vout, kinds, keyIdx, txs, fees, nFee);
+        return true;
+    }
+
+    /** One input split into 20-100 outputs. */
+    bool BuildFanOut(std::vector<TransactionRef>& txs, std::vector<Amount>& fees)
+    {
+        std::vector<WalletCoin> coins = TakeCoins(1);
+        size_t nOut = 20 + Rand(81);
+        Amount nIn = Sum(coins);
+        std::vector<TxOut> vout(nOut);
+        std::vector<CoinKind> kinds(nOut);
+        std::vector<int> keyIdx(nOut);
+        for (size_t i = 0; i < nOut; i++)
+            vout[i] = RandomOutput(0, kinds[i], keyIdx[i]);
+        Amount nFee = Fee(EstimateSize(coins, vout));
+        Amount nAvail = nIn - nFee;
+        if (nAvail < (Amount)nOut * MIN_OUTPUT) {
+            ReturnCoins(coins);
+            return false;
+        }
+        // Random weights so output values vary over a factor of ten or so.
+        std::vector<uint64_t> weights(nOut);
+        uint64_t nTotal = 0;
+        for (size_t i = 0; i < nOut; i++)
+            nTotal += weights[i] = 1 + Rand(10);
+        Amount nSpread = nAvail - (Amount)nOut * MIN_OUTPUT;
+        Amount nLeft = nAvail;
+        for (size_t i = 0; i + 1 < nOut; i++) {
+            vout[i].nValue = MIN_OUTPUT + (Amount)((double)nSpread * weights[i] / nTotal);
+            nLeft -= vout[i].nValue;
+        }
+        vout[nOut - 1].nValue = nLeft;
+        Finish(coins, vout, kinds, keyIdx, txs, fees, nFee);
+        return true;
+    }
+
+    /** 10-40 inputs consolidated into one output. */
+    bool BuildFanIn(std::vector<TransactionRef>& txs, std::vector<Amount>& fees)
+    {
+        // Keep enough coins around for the rest of the block.
+        size_t nWant = std::min<size_t>(10 + Rand(31), wallet.size() / 2);
+        if (nWant < 2)
+            return false;
+        std::vector<WalletCoin> coins = TakeCoins(nWant);
+        std::vector<TxOut> vout(1);
+        std::vector<CoinKind> kinds(1);
+        std::vector<int> keyIdx(1);
+        vout[0] = RandomOutput(0, kinds[0], keyIdx[0]);
+        Amount nFee = Fee(EstimateSize(coins, vout));
+        vout[0].nValue = Sum(coins) - nFee;
+        if (vout[0].nValue < MIN_OUTPUT) {
+            ReturnCoins(coins);
+            return false;
+        }
+        Finish(coins, vout, kinds, keyIdx, txs, fees, nFee);
+        return true;
+    }
+
+    /** Pays a P2SH 2-of-3 and a bare 1-of-2 output, plus change. */
+    bool BuildMultisig(std::vector<TransactionRef>& txs, std::vector<Amount>& fees)
+    {
+        std::vector<WalletCoin> coins = TakeCoins(1 + Rand(2));
+        std::vector<TxOut> vout(3);
+        std::vector<CoinKind> kinds(3);
+        std::vector<int> keyIdx(3);
+        kinds[0] = COIN_P2SH_MULTISIG;
+        keyIdx[0] = (int)Rand(options.nKeys);
+        vout[0] = TxOut(0, ScriptFor(kinds[0], keyIdx[0]));
+        kinds[1] = COIN_BARE_MULTISIG;
+        keyIdx[1] = (int)Rand(options.nKeys);
+        vout[1] = TxOut(0, ScriptFor(kinds[1], keyIdx[1]));
+        vout[2] = RandomOutput(0, kinds[2], keyIdx[2]);
+        Amount nFee = Fee(EstimateSize(coins, vout));
+        Amount nAvail = Sum(coins) - nFee;
+        if (nAvail < 3 * MIN_OUTPUT) {
+            ReturnCoins(coins);
+            return false;
+        }
+        Amount nSpread = nAvail - 3 * MIN_OUTPUT;
+        vout[0].nValue = MIN_OUTPUT + (Amount)Rand((uint64_t)nSpread / 2 + 1);
+        vout[1].nValue = MIN_OUTPUT + (Amount)Rand((uint64_t)nSpread / 4 + 1);
+        vout[2].nValue = nAvail - vout[0].nValue - vout[1].nValue;
+        Finish(coins, vout, kinds, keyIdx, txs, fees, nFee);
+        return true;
+    }
+
+    /** 2 to nMaxChainLength transactions, each spending the one before it
+     *  in the same block. Stops early once nRoom bytes are used. */
+    bool BuildChain(std::vector<TransactionRef>& txs, std::vector<Amount>& fees, size_t nRoom)
+    {
+        int nLength = 2 + (int)Rand(std::max(options.nMaxChainLength - 1, 1));
+        std::vector<WalletCoin> coins = TakeCoins(1);
+        size_t nUsed = 0;
+        int nBuilt = 0;
+        for (; nBuilt < nLength && nUsed < nRoom; nBuilt++) {
+            std::vector<TxOut> vout(1);
+            std::vector<CoinKind> kinds(1);
+            std::vector<int> keyIdx(1);
+            vout[0] = RandomOutput(0, kinds[0], keyIdx[0]);
+            Amount nFee = Fee(EstimateSize(coins, vout));
+            vout[0].nValue = coins[0].nValue - nFee;
+            if (vout[0].nValue < MIN_OUTPUT)
+                break;
+            bool fLast = nBuilt + 1 == nLength;
+            TransactionRef tx = Finish(coins, vout, kinds, keyIdx, txs, fees, nFee, !fLast);
+            nUsed += tx->GetTotalSize();
+            coins[0].outpoint = OutPoint(tx->GetHash(), 0);
+            coins[0].nValue = vout[0].nValue;
+            coins[0].kind = kinds[0];
+            coins[0].nKey = keyIdx[0];
+        }
+        // A chain cut short still owns its last output.
+        if (nBuilt < nLength)
+            created.push_back(coins[0]);
+        return nBuilt > 0;
+    }
+};
+
+/** Keeps block times deterministic and in the past: one target spacing
+ *  apart, squeezed when the chain would otherwise run past
+ *  genesis + CHAIN_DURATION. */
+int64_t BlockTime(const ChainParams& params, int nHeight, int nChainHeight)
+{
+    int64_t nSpacing = params.GetConsensus().nPowTargetSpacing;
+    if (nChainHeight > 0)
+        nSpacing = std::max<int64_t>(1, std::min<int64_t>(nSpacing, CHAIN_DURATION / nChainHeight));
+    return params.GenesisBlock().GetBlockTime() + nHeight * nSpacing;
+}
+
+bool HashFile(const std::string& path, uint64_t& size, std::string& hex)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+    Sha256 hasher;
+    std::vector<unsigned char> buf(1 << 20);
+    size_t n;
+    while ((n = fread(buf.data(), 1, buf.size(), file)) > 0)
+        hasher.Write(buf.data(), n);
+    bool ok = !ferror(file);
+    fclose(file);
+    size = hasher.Size();
+    unsigned char hash[32];
+    hasher.Finalize(hash);
+    hex = HexStr(hash, sizeof(hash));
+    return ok;
+}
+
+} // namespace
+
+const char* ChainGenShapeName(ChainGenShape shape)
+{
+    return shape < SHAPE_COUNT ? SHAPE_NAMES[shape] : "unknown";
+}
+
+ChainGenerator::ChainGenerator(const ChainParams& params, const ChainGenOptions& options)
+    : params(params), options(options)
+{
+}
+
+bool ChainGenerator::Run(const std::string& datadir, ChainManifest& manifest, std::string& error, std::ostream* log)
+{
+    unsigned int nTotalWeight = 0;
+    for (int i = 0; i < SHAPE_COUNT; i++)
+        nTotalWeight += options.weights[i];
+    if (options.nKeys < 3 || options.nHeight < 1 || options.nTxPerBlock < 0 || nTotalWeight == 0) {
+        error = "invalid generator options";
+        return false;
+    }
+    if (FileExists(datadir + "/blocks/blk00000.dat")) {
+        error = datadir + " already holds block files";
+        return false;
+    }
+    manifest = ChainManifest();
+    manifest.version = MANIFEST_VERSION;
+    manifest.network = params.NetworkIDString();
+    manifest.options = options;
+    manifest.nTransactions = manifest.nInputs = manifest.nOutputs = 0;
+    manifest.nDustOutputs = manifest.nBlockBytes = 0;
+    for (int i = 0; i < SHAPE_COUNT; i++)
+        manifest.nShapes[i] = 0;
+
+    const ConsensusParams& consensus = params.GetConsensus();
+    Chainstate chainstate(params, datadir);
+    if (!chainstate.Load(error))
+        return false;
+    Workload workload(options, manifest);
+    BlockAssembler assembler(params);
+
+    for (int nHeight = 1; nHeight <= options.nHeight; nHeight++) {
+        const BlockIndex* pindexPrev = chainstate.Tip();
+        std::vector<TransactionRef> txs;
+        std::vector<Amount> fees;
+        workload.FillBlock(nHeight, txs, fees);
+        BlockTemplate tmpl = assembler.CreateNewBlock(pindexPrev->GetBlockHash(), nHeight,
+            GetNextWorkRequired(pindexPrev, consensus), BlockTime(params, nHeight, options.nHeight),
+            pindexPrev->GetMedianTimePast() + 1, workload.CoinbaseScript(nHeight), txs, fees);
+        Block& block = tmpl.block;
+        while (!CheckProofOfWork(block.GetHash(), block.nBits, consensus)) {
+            if (++block.nNonce == 0) {
+                error = "nonce space exhausted";
+                return false;
+            }
+        }
+        ValidationState state;
+        if (!chainstate.ProcessNewBlock(block, state)) {
+            error = "block " + std::to_string(nHeight) + " rejected: " + state.GetRejectReason();
+            return false;
+        }
+        workload.CoinbaseConnected(*block.vtx[0], nHeight);
+        manifest.nTransactions++;
+        manifest.nInputs++;
+        manifest.nOutputs++;
+        manifest.nBlockBytes += SerializeBlock(block).size();
+        if (log && (nHeight % 1000 == 0 || nHeight == options.nHeight)) {
+            *log << "height " << nHeight << "/" << options.nHeight << ", " << manifest.nTransactions << " txs, "
+                 << manifest.nBlockBytes / 1000000 << " MB" << std::endl;
+        }
+    }
+    chainstate.Flush();
+    manifest.nHeight = chainstate.Height();
+    manifest.tip = chainstate.Tip()->GetBlockHash();
+    if (!HashBlockFiles(datadir, manifest.files, error))
+        return false;
+    return WriteChainManifest(datadir, manifest, error);
+}
+
+bool HashBlockFiles(const std::string& datadir, std::vector<ChainManifest::File>& files, std::string& error)
+{
+    files.clear();
+    for (int nFile = 0;; nFile++) {
+        // Room for any int.
+        char name[32];
+        snprintf(name, sizeof(name), "blk%05d.dat", nFile);
+        std::string path = datadir + "/blocks/" + name;
+        if (!FileExists(path))
+            break;
+        ChainManifest::File file;
+        file.name = name;
+        if (!HashFile(path, file.size, file.sha256)) {
+            error = "cannot read " + path;
+            return false;
+        }
+        files.push_back(file);
+    }
+    return true;
+}
+
+bool WriteChainManifest(const std::string& datadir, const ChainManifest& manifest, std::string& error)
+{
+    const ChainGenOptions& options = manifest.options;
+    json weights, shapes;
+    for (int i = 0; i < SHAPE_COUNT; i++) {
+        weights[SHAPE_NAMES[i]] = options.weights[i];
+        shapes[SHAPE_NAMES[i]] = manifest.nShapes[i];
+    }
+    json files = json::array();
+    for (size_t i = 0; i < manifest.files.size(); i++) {
+        const ChainManifest::File& file = manifest.files[i];
+        files.push_back({{"name", file.name}, {"size", file.size}, {"sha256", file.sha256}});
+    }
+    json doc;
+    doc["version"] = manifest.version;
+    doc["network"] = manifest.network;
+    doc["options"] = {{"seed", options.seed}, {"height", options.nHeight}, {"txperblock", options.nTxPerBlock},
+        {"maxchainlength", options.nMaxChainLength}, {"keys", options.nKeys}, {"weights", weights}};
+    doc["height"] = manifest.nHeight;
+    doc["tip"] = manifest.tip.GetHex();
+    doc["stats"] = {{"transactions", manifest.nTransactions}, {"inputs", manifest.nInputs},
+        {"outputs", manifest.nOutputs}, {"dust_outputs", manifest.nDustOutputs},
+        {"block_bytes", manifest.nBlockBytes}, {"shapes", shapes}};
+    doc["files"] = files;
+
+    std::string path = datadir + "/" + ChainGenerator::MANIFEST_NAME;
+    std::string text = doc.dump(2) + "\n";
+    FILE* out = fopen(path.c_str(), "wb");
+    bool ok = out && fwrite(text.data(), 1, text.size(), out) == text.size();
+    if (out)
+        ok &= fclose(out) == 0;
+    if (!ok)
+        error = "cannot write " + path;
+    return ok;
+}
+
+bool ReadChainManifest(const std::string& datadir, ChainManifest& manifest, std::string& error)
+{
+    std::string path = datadir + "/" + ChainGenerator::MANIFEST_NAME;
+    std::vector<unsigned char> data;
+    if (!ReadFile(path, data)) {
+        error = "cannot read " + path;
+        return false;
+    }
+    json doc = json::parse(data.begin(), data.end(), nullptr, false);
+    if (doc.is_discarded() || !doc.is_object()) {
+        error = path + " is not valid JSON";
+        return false;
+    }
+    try {
+        manifest = ChainManifest();
+        manifest.version = doc.at("version").get<int>();
+        if (manifest.version != ChainGenerator::MANIFEST_VERSION) {
+            error = path + " has unsupported version " + std::to_string(manifest.version);
+            return false;
+        }
+        manifest.network = doc.at("network").get<std::string>();
+        const json& options = doc.at("options");
+        manifest.options.seed = options.at("seed").get<uint64_t>();
+        manifest.options.nHeight = options.at("height").get<int>();
+        manifest.options.nTxPerBlock = options.at("txperblock").get<int>();
+        manifest.options.nMaxChainLength = options.at("maxchainlength").get<int>();
+        manifest.options.nKeys = options.at("keys").get<int>();
+        const json& stats = doc.at("stats");
+        for (int i = 0; i < SHAPE_COUNT; i++) {
+            manifest.options.weights[i] = options.at("weights").at(SHAPE_NAMES[i]).get<unsigned int>();
+            manifest.nShapes[i] = stats.at("shapes").at(SHAPE_NAMES[i]).get<uint64_t>();
+        }
+        manifest.nHeight = doc.at("height").get<int>();
+        if (!manifest.tip.SetHex(doc.at("tip").get<std::string>())) {
+            error = path + ": bad tip hash";
+            return false;
+        }
+        manifest.nTransactions = stats.at("transactions").get<uint64_t>();
+        manifest.nInputs = stats.at("inputs").get<uint64_t>();
+        manifest.nOutputs = stats.at("outputs").get<uint64_t>();
+        manifest.nDustOutputs = stats.at("dust_outputs").get<uint64_t>();
+        manifest.nBlockBytes = stats.at("block_bytes").get<uint64_t>();
+        for (const json& entry : doc.at("files")) {
+            ChainManifest::File file;
+            file.name = entry.at("name").get<std::string>();
+            file.size = entry.at("size").get<uint64_t>();
+            file.sha256 = entry.at("sha256").get<std::string>();
+            manifest.files.push_back(file);
+        }
+    } catch (const json::exception& e) {
+        error = path + ": " + e.what();
+        return false;
+    }
+    return true;
+}
+
+bool VerifyChainDataset(const std::string& datadir, const ChainManifest& manifest, std::string& error)
+{
+    std::vector<ChainManifest::File> files;
+    if (!HashBlockFiles(datadir, files, error))
+        return false;
+    if (files.size() != manifest.files.size()) {
+        error = "expected " + std::to_string(manifest.files.size()) + " block files, found " +
+                std::to_string(files.size());
+        return false;
+    }
+    for (size_t i = 0; i < files.size(); i++) {
+        if (files[i].size != manifest.files[i].size || files[i].sha256 != manifest.files[i].sha256) {
+            error = files[i].name + " does not match the manifest";
+            return false;
+        }
+    }
+    return true;
+}
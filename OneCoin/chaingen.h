@@ -0,0 +1,102 @@
+#ifndef ONECOIN_CHAINGEN_H
+#define ONECOIN_CHAINGEN_H
+
+#include "chainparams.h"
+#include "uint256.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/** Transaction shapes the generator mixes into blocks. */
+enum ChainGenShape {
+    SHAPE_PAYMENT,  //!< 1-2 inputs, payee plus change
+    SHAPE_FAN_OUT,  //!< 1 input, 20-100 outputs
+    SHAPE_FAN_IN,   //!< 10-40 inputs consolidated into one output
+    SHAPE_MULTISIG, //!< pays P2SH 2-of-3 and bare 1-of-2 multisig outputs
+    SHAPE_CHAIN,    //!< a run of transactions each spending the previous one
+    SHAPE_DUST,     //!< a payment that also leaves never-spent dust outputs
+    SHAPE_COUNT,
+};
+
+struct ChainGenOptions {
+    uint64_t seed;
+    /** Height of the last block generated. */
+    int nHeight;
+    /** Transactions per block once the first coinbases have matured; a
+     *  chain counts as one. Blocks stop short at the size limit. */
+    int nTxPerBlock;
+    /** Relative weight of each ChainGenShape. */
+    unsigned int weights[SHAPE_COUNT];
+    /** Longest dependency chain SHAPE_CHAIN builds. */
+    int nMaxChainLength;
+    /** Distinct signing keys; addresses are reused across the chain. */
+    int nKeys;
+
+    ChainGenOptions() : seed(1), nHeight(1000), nTxPerBlock(200), nMaxChainLength(50), nKeys(256)
+    {
+        const unsigned int defaults[SHAPE_COUNT] = {55, 6, 8, 15, 4, 12};
+        for (int i = 0; i < SHAPE_COUNT; i++)
+            weights[i] = defaults[i];
+    }
+};
+
+/** What a generated dataset holds, as recorded in its manifest. */
+struct ChainManifest {
+    struct File {
+        std::string name;
+        uint64_t size;
+        /** SHA-256 of the file, hex. */
+        std::string sha256;
+    };
+
+    int version;
+    std::string network;
+    ChainGenOptions options;
+    int nHeight;
+    uint256 tip;
+    uint64_t nTransactions;
+    uint64_t nInputs;
+    uint64_t nOutputs;
+    uint64_t nShapes[SHAPE_COUNT];
+    uint64_t nDustOutputs;
+    uint64_t nBlockBytes;
+    uint64_t nUtxos;
+    std::vector<File> files;
+};
+
+/**
+ * Builds a reproducible regtest chain from a seed: every key, value, shape
+ * and timestamp comes from the seed, so the same options give byte-for-byte
+ * identical block files on any machine. Blocks are connected to a
+ * Chainstate as they are made, which both validates them and writes them
+ * in the normal block-file format under datadir/blocks; datadir/manifest.json
+ * describes the result.
+ */
+class ChainGenerator {
+public:
+    static const char* const MANIFEST_NAME;
+    static const int MANIFEST_VERSION = 2;
+
+    ChainGenerator(const ChainParams& params, const ChainGenOptions& options);
+
+    /** Fails if datadir already holds blocks. Progress lines go to *log. */
+    bool Run(const std::string& datadir, ChainManifest& manifest, std::string& error, std::ostream* log = NULL);
+
+private:
+    const ChainParams& params;
+    ChainGenOptions options;
+};
+
+bool WriteChainManifest(const std::string& datadir, const ChainManifest& manifest, std::string& error);
+bool ReadChainManifest(const std::string& datadir, ChainManifest& manifest, std::string& error);
+/** Hashes the block files and compares them with the manifest. */
+bool VerifyChainDataset(const std::string& datadir, const ChainManifest& manifest, std::string& error);
+/** Sizes and hashes of the block files in datadir/blocks. */
+bool HashBlockFiles(const std::string& datadir, std::vector<ChainManifest::File>& files, std::string& error);
+
+const char* ChainGenShapeName(ChainGenShape shape);
+
+#endif // ONECOIN_CHAINGEN_H
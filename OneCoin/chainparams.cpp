@@ -0,0 +1,117 @@
+#include "chainparams.h"
+#include "merkle.h"
+
+#include <assert.h>
+#include <stdexcept>
+#include <string.h>
+
+Block CreateGenesisBlock(uint32_t nTime, uint32_t nNonce, uint32_t nBits, int32_t nVersion, Amount genesisReward)
+{
+    const char* pszTimestamp = "OneCoin 01/Jan/2025 One chain, one coin";
+    MutableTransaction txNew;
+    txNew.vin.resize(1);
+    txNew.vout.resize(1);
+    txNew.vin[0].scriptSig = Script() << (int64_t)486604799 << (int64_t)4
+                                      << std::vector<unsigned char>(pszTimestamp, pszTimestamp + strlen(pszTimestamp));
+    txNew.vout[0].nValue = genesisReward;
+    txNew.vout[0].scriptPubKey = Script() << OP_RETURN;
+
+    Block genesis;
+    genesis.nTime = nTime;
+    genesis.nBits = nBits;
+    genesis.nNonce = nNonce;
+    genesis.nVersion = nVersion;
+    genesis.vtx.push_back(MakeTransactionRef(std::move(txNew)));
+    genesis.hashMerkleRoot = BlockMerkleRoot(genesis);
+    return genesis;
+}
+
+namespace {
+
+class MainParams : public ChainParams {
+public:
+    MainParams()
+    {
+        strNetworkID = "main";
+        consensus.nSubsidyHalvingInterval = 210000;
+        consensus.powLimit = arith_uint256::FromCompact(0x1e0fffff);
+        consensus.nPowTargetTimespan = 14 * 24 * 60 * 60;
+        consensus.nPowTargetSpacing = 10 * 60;
+        consensus.fPowNoRetargeting = false;
+        consensus.defaultAssumeValid = uint256();
+
+        pchMessageStart[0] = 0xf1;
+        pchMessageStart[1] = 0xc0;
+        pchMessageStart[2] = 0x1c;
+        pchMessageStart[3] = 0x01;
+        nDefaultPort = 9333;
+        nDefaultStratumPort = 3333;
+
+        genesis = CreateGenesisBlock(1735689600, 1137326, 0x1e0ffff0, 1, 50 * COIN);
+        consensus.hashGenesisBlock = genesis.GetHash();
+        assert(consensus.hashGenesisBlock == uint256::FromHex("000001b86c68297b9172f30fbaae20d5006717bed66d1be27c7d3700f90ae2a2"));
+        assert(genesis.hashMerkleRoot == uint256::FromHex("fd564b654bd8ff4e7f3ea2ee323b952515cceddf694010bb5bc196fe2932402d"));
+
+        base58Prefixes[PUBKEY_ADDRESS] = std::vector<unsigned char>(1, 115);
+        base58Prefixes[SCRIPT_ADDRESS] = std::vector<unsigned char>(1, 5);
+        base58Prefixes[SECRET_KEY] = std::vector<unsigned char>(1, 128);
+        bech32_hrp = "oc";
+    }
+};
+
+/** Local test chain: trivial difficulty, no retargeting, fast halvings.
+ *  Blocks can be mined on one core as fast as they can be validated. */
+class RegTestParams : public ChainParams {
+public:
+    RegTestParams()
+    {
+        strNetworkID = "regtest";
+        consensus.nSubsidyHalvingInterval = 150;
+        consensus.powLimit = arith_uint256::FromCompact(0x207fffff);
+        consensus.nPowTargetTimespan = 14 * 24 * 60 * 60;
+        consensus.nPowTargetSpacing = 10 * 60;
+        consensus.fPowNoRetargeting = true;
+        consensus.defaultAssumeValid = uint256();
+
+        pchMessageStart[0] = 0xfa;
+        pchMessageStart[1] = 0xbf;
+        pchMessageStart[2] = 0xb5;
+        pchMessageStart[3] = 0xda;
+        nDefaultPort = 19444;
+        nDefaultStratumPort = 13333;
+
+        genesis = CreateGenesisBlock(1735689600, 5, 0x207fffff, 1, 50 * COIN);
+        consensus.hashGenesisBlock = genesis.GetHash();
+        assert(consensus.hashGenesisBlock == uint256::FromHex("0980cf9456875edddf1a0a7e6922df6cf551696e83530e519a590af8625d1e61"));
+        assert(genesis.hashMerkleRoot == uint256::FromHex("fd564b654bd8ff4e7f3ea2ee323b952515cceddf694010bb5bc196fe2932402d"));
+
+        base58Prefixes[PUBKEY_ADDRESS] = std::vector<unsigned char>(1, 111);
+        base58Prefixes[SCRIPT_ADDRESS] = std::vector<unsigned char>(1, 196);
+        base58Prefixes[SECRET_KEY] = std::vector<unsigned char>(1, 239);
+        bech32_hrp = "ocrt";
+    }
+};
+
+std::unique_ptr<const ChainParams> globalChainParams;
+
+} // namespace
+
+std::unique_ptr<const ChainParams> CreateChainParams(const std::string& network)
+{
+    if (network == "main")
+        return std::unique_ptr<const ChainParams>(new MainParams());
+    if (network == "regtest")
+        return std::unique_ptr<const ChainParams>(new RegTestParams());
+    throw std::runtime_error("Unknown chain " + network);
+}
+
+const ChainParams& Params()
+{
+    assert(globalChainParams);
+    return *globalChainParams;
+}
+
+void SelectParams(const std::string& network)
+{
+    globalChainParams = CreateChainParams(network);
+}
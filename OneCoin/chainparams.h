@@ -0,0 +1,55 @@
+#ifndef ONECOIN_CHAINPARAMS_H
+#define ONECOIN_CHAINPARAMS_H
+
+#include "block.h"
+#include "consensus.h"
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+/** Everything that differs between networks: consensus rules, the genesis
+ *  block and the prefixes used to tell addresses of different networks apart. */
+class ChainParams {
+public:
+    enum Base58Type {
+        PUBKEY_ADDRESS,
+        SCRIPT_ADDRESS,
+        SECRET_KEY,
+
+        MAX_BASE58_TYPES
+    };
+
+    const ConsensusParams& GetConsensus() const { return consensus; }
+    const unsigned char* MessageStart() const { return pchMessageStart; }
+    uint16_t GetDefaultPort() const { return nDefaultPort; }
+    uint16_t GetDefaultStratumPort() const { return nDefaultStratumPort; }
+    const Block& GenesisBlock() const { return genesis; }
+    const std::string& NetworkIDString() const { return strNetworkID; }
+    const std::vector<unsigned char>& Base58Prefix(Base58Type type) const { return base58Prefixes[type]; }
+    const std::string& Bech32HRP() const { return bech32_hrp; }
+
+protected:
+    ChainParams() {}
+
+    ConsensusParams consensus;
+    unsigned char pchMessageStart[4];
+    uint16_t nDefaultPort;
+    uint16_t nDefaultStratumPort;
+    std::string strNetworkID;
+    Block genesis;
+    std::vector<unsigned char> base58Prefixes[MAX_BASE58_TYPES];
+    std::string bech32_hrp;
+};
+
+/** Throws std::runtime_error for an unknown network name. */
+std::unique_ptr<const ChainParams> CreateChainParams(const std::string& network);
+
+/** Parameters of the selected network; SelectParams must be called first. */
+const ChainParams& Params();
+void SelectParams(const std::string& network);
+
+Block CreateGenesisBlock(uint32_t nTime, uint32_t nNonce, uint32_t nBits, int32_t nVersion, Amount genesisReward);
+
+#endif // ONECOIN_CHAINPARAMS_H
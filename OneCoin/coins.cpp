@@ -0,0 +1,270 @@
+#include "coins.h"
+
+#include <algorithm>
+
+bool CoinsViewMemory::GetCoin(const OutPoint& outpoint, Coin& coin) const
+{
+    auto it = map.find(outpoint);
+    if (it == map.end())
+        return false;
+    coin = it->second;
+    return true;
+}
+
+void CoinsViewMemory::BatchWrite(CoinsMap& coins, const uint256& hashBlockIn)
+{
+    for (CoinsMap::iterator it = coins.begin(); it != coins.end(); ++it) {
+        if (!(it->second.flags & CoinsCacheEntry::DIRTY))
+            continue;
+        if (it->second.coin.IsSpent())
+            map.erase(it->first);
+        else
+            map[it->first] = std::move(it->second.coin);
+    }
+    coins.clear();
+    if (!hashBlockIn.IsNull())
+        hashBlock = hashBlockIn;
+}
+
+CoinsMap::iterator CoinsViewCache::FetchCoin(const OutPoint& outpoint) const
+{
+    CoinsMap::iterator it = cacheCoins.find(outpoint);
+    if (it != cacheCoins.end())
+        return it;
+    Coin coin;
+    if (!base->GetCoin(outpoint, coin))
+        return cacheCoins.end();
+    it = cacheCoins.emplace(outpoint, CoinsCacheEntry()).first;
+    it->second.coin = std::move(coin);
+    return it;
+}
+
+bool CoinsViewCache::GetCoin(const OutPoint& outpoint, Coin& coin) const
+{
+    CoinsMap::iterator it = FetchCoin(outpoint);
+    if (it == cacheCoins.end() || it->second.coin.IsSpent())
+        return false;
+    coin = it->second.coin;
+    return true;
+}
+
+bool CoinsViewCache::HaveCoin(const OutPoint& outpoint) const
+{
+    CoinsMap::iterator it = FetchCoin(outpoint);
+    return it != cacheCoins.end() && !it->second.coin.IsSpent();
+}
+
+void CoinsViewCache::FetchCoins(const std::vector<OutPoint>& outpoints) const
+{
+    std::vector<OutPoint> missing;
+    for (size_t i = 0; i < outpoints.size(); i++) {
+        if (!cacheCoins.count(outpoints[i]))
+            missing.push_back(outpoints[i]);
+    }
+    if (missing.empty())
+        return;
+    std::vector<Coin> coins;
+    base->GetCoins(missing, coins);
+    for (size_t i = 0; i < missing.size(); i++) {
+        if (coins[i].IsSpent())
+            continue;
+        std::pair<CoinsMap::iterator, bool> ins = cacheCoins.emplace(missing[i], CoinsCacheEntry());
+        if (ins.second)
+            ins.first->second.coin = std::move(coins[i]);
+    }
+}
+
+void CoinsViewCache::GetCoins(const std::vector<OutPoint>& outpoints, std::vector<Coin>& coins) const
+{
+    FetchCoins(outpoints);
+    coins.assign(outpoints.size(), Coin());
+    for (size_t i = 0; i < outpoints.size(); i++) {
+        CoinsMap::const_iterator it = cacheCoins.find(outpoints[i]);
+        if (it != cacheCoins.end())
+            coins[i] = it->second.coin;
+    }
+}
+
+uint256 CoinsViewCache::GetBestBlock() const
+{
+    if (hashBlock.IsNull())
+        hashBlock = base->GetBestBlock();
+    return hashBlock;
+}
+
+const Coin& CoinsViewCache::AccessCoin(const OutPoint& outpoint) const
+{
+    static const Coin coinEmpty;
+    CoinsMap::iterator it = FetchCoin(outpoint);
+    return it == cacheCoins.end() ? coinEmpty : it->second.coin;
+}
+
+void CoinsViewCache::AddCoin(const OutPoint& outpoint, Coin&& coin, bool fPossibleOverwrite)
+{
+    if (coin.out.scriptPubKey.IsUnspendable())
+        return;
+    std::pair<CoinsMap::iterator, bool> ins = cacheCoins.emplace(outpoint, CoinsCacheEntry());
+    CoinsCacheEntry& entry = ins.first->second;
+    bool fresh = false;
+    if (!fPossibleOverwrite) {
+        // A new entry, or one the parent only knows as spent, can be
+        // dropped entirely if it is spent again before a flush.
+        fresh = ins.second || (entry.coin.IsSpent() && !(entry.flags & CoinsCacheEntry::DIRTY));
+    } else if (ins.second) {
+        // Stores count coins by FRESH, so it has to say whether the
+        // parent has this one.
+        fresh = !base->HaveCoin(outpoint);
+    }
+    entry.coin = std::move(coin);
+    entry.flags |= CoinsCacheEntry::DIRTY | (fresh ? CoinsCacheEntry::FRESH : 0);
+}
+
+void CoinsViewCache::AddCoins(const Transaction& tx, int nHeight, bool fCheckOverwrite)
+{
+    bool fCoinbase = tx.IsCoinBase();
+    const uint256& txid = tx.GetHash();
+    for (size_t i = 0; i < tx.vout.size(); i++) {
+        OutPoint outpoint(txid, (uint32_t)i);
+        // Coinbases commit to their height, so their txids never repeat.
+        bool overwrite = fCheckOverwrite && HaveCoin(outpoint);
+        AddCoin(outpoint, Coin(tx.vout[i], nHeight, fCoinbase), overwrite);
+    }
+}
+
+bool CoinsViewCache::SpendCoin(const OutPoint& outpoint, Coin* moveout)
+{
+    CoinsMap::iterator it = FetchCoin(outpoint);
+    if (it == cacheCoins.end() || it->second.coin.IsSpent())
+        return false;
+    if (moveout)
+        *moveout = std::move(it->second.coin);
+    if (it->second.flags & CoinsCacheEntry::FRESH) {
+        cacheCoins.erase(it);
+    } else {
+        it->second.flags |= CoinsCacheEntry::DIRTY;
+        it->second.coin.Clear();
+    }
+    return true;
+}
+
+void CoinsViewCache::BatchWrite(CoinsMap& coins, const uint256& hashBlockIn)
+{
+    for (CoinsMap::iterator it = coins.begin(); it != coins.end(); ++it) {
+        if (!(it->second.flags & CoinsCacheEntry::DIRTY))
+            continue;
+        std::pair<CoinsMap::iterator, bool> ins = cacheCoins.emplace(it->first, CoinsCacheEntry());
+        CoinsCacheEntry& entry = ins.first->second;
+        if (ins.second) {
+            // The child's FRESH flag stays valid: we did not know the coin
+            // either, so our parent cannot have it.
+            if ((it->second.flags & CoinsCacheEntry::FRESH) && it->second.coin.IsSpent()) {
+                cacheCoins.erase(ins.first);
+                continue;
+            }
+            entry.coin = std::move(it->second.coin);
+            entry.flags = CoinsCacheEntry::DIRTY | (it->second.flags & CoinsCacheEntry::FRESH);
+        } else if ((entry.flags & CoinsCacheEntry::FRESH) && it->second.coin.IsSpent()) {
+            cacheCoins.erase(ins.first);
+        } else {
+            entry.coin = std::move(it->second.coin);
+            entry.flags |= CoinsCacheEntry::DIRTY;
+        }
+    }
+    coins.clear();
+    if (!hashBlockIn.IsNull())
+        hashBlock = hashBlockIn;
+}
+
+void CoinsViewCache::Flush()
+{
+    base->BatchWrite(cacheCoins, GetBestBlock());
+    cacheCoins.clear();
+}
+
+void CoinsViewCache::ReleaseMemory()
+{
+    {
+        CoinsMap empty(0, cacheCoins.hash_function(), cacheCoins.key_eq(), cacheCoins.get_allocator());
+        cacheCoins.swap(empty);
+    }
+    cacheCoins.get_allocator().GetArena()->Trim();
+}
+
+bool CoinsViewSharded::LockedView::GetCoin(const OutPoint& outpoint, Coin& coin) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return base->GetCoin(outpoint, coin);
+}
+
+uint256 CoinsViewSharded::LockedView::GetBestBlock() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return base->GetBestBlock();
+}
+
+void CoinsViewSharded::LockedView::BatchWrite(CoinsMap& coins, const uint256& hashBlock)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    base->BatchWrite(coins, hashBlock);
+}
+
+size_t CoinsViewSharded::LockedView::GetCoinCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return base->GetCoinCount();
+}
+
+CoinsViewSharded::CoinsViewSharded(CoinsView* base, size_t nShards) : baseLocked(base)
+{
+    for (size_t i = 0; i < std::max<size_t>(nShards, 1); i++) {
+        shards.push_back(std::unique_ptr<Shard>(new Shard()));
+        shards.back()->cache.reset(new CoinsViewCache(&baseLocked));
+    }
+}
+
+CoinsViewSharded::Shard& CoinsViewSharded::ShardFor(const OutPoint& outpoint) const
+{
+    // The high bits: the shard maps bucket by the low ones.
+    return *shards[(hasher(outpoint) >> 32) % shards.size()];
+}
+
+bool CoinsViewSharded::GetCoin(const OutPoint& outpoint, Coin& coin) const
+{
+    Shard& shard = ShardFor(outpoint);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.cache->GetCoin(outpoint, coin);
+}
+
+bool CoinsViewSharded::HaveCoin(const OutPoint& outpoint) const
+{
+    Shard& shard = ShardFor(outpoint);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.cache->HaveCoin(outpoint);
+}
+
+void CoinsViewSharded::BatchWrite(CoinsMap& coins, const uint256& hashBlock)
+{
+    // Small batches touch few shards: only those get a map.
+    std::vector<std::unique_ptr<CoinsMap> > split(shards.size());
+    for (CoinsMap::iterator it = coins.begin(); it != coins.end(); ++it) {
+        if (!(it->second.flags & CoinsCacheEntry::DIRTY))
+            continue;
+        std::unique_ptr<CoinsMap>& part = split[(hasher(it->first) >> 32) % shards.size()];
+        if (!part)
+            part.reset(new CoinsMap());
+        part->emplace(it->first, std::move(it->second));
+    }
+    coins.clear();
+    for (size_t i = 0; i < shards.size(); i++) {
+        if (!split[i])
+            continue;
+        std::lock_guard<std::mutex> lock(shards[i]->mutex);
+        shards[i]->cache->BatchWrite(*split[i], hashBlock);
+    }
+}
+
+void CoinsViewSharded::Flush()
+{
+    for (size_t i = 0; i < shards.size(); i++)
+        shards[i]->cache->Flush();
+}
@@ -0,0 +1,190 @@
+#ifndef ONECOIN_COINS_H
+#define ONECOIN_COINS_H
+
+#include "pagearena.h"
+#include "transaction.h"
+#include "uint256.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/** An unspent transaction output with the facts needed to spend it. */
+class Coin {
+public:
+    TxOut out;
+    int nHeight;
+    bool fCoinBase;
+
+    Coin() : nHeight(0), fCoinBase(false) {}
+    Coin(const TxOut& out, int nHeight, bool fCoinBase) : out(out), nHeight(nHeight), fCoinBase(fCoinBase) {}
+
+    bool IsSpent() const { return out.IsNull(); }
+    void Clear()
+    {
+        out = TxOut();
+        nHeight = 0;
+        fCoinBase = false;
+    }
+};
+
+/** A cache slot. DIRTY entries differ from the parent view; FRESH entries
+ *  do not exist in the parent at all, so spending them needs no write.
+ *  Entries without FRESH are unspent in the parent. */
+struct CoinsCacheEntry {
+    enum Flags {
+        DIRTY = 1,
+        FRESH = 2,
+    };
+
+    Coin coin;
+    unsigned char flags;
+
+    CoinsCacheEntry() : flags(0) {}
+};
+
+/** Nodes and buckets come from a PageArena, so a large cache can sit on
+ *  huge pages. */
+typedef std::unordered_map<OutPoint, CoinsCacheEntry, OutPointHasher, std::equal_to<OutPoint>,
+    ArenaAllocator<std::pair<const OutPoint, CoinsCacheEntry> > > CoinsMap;
+
+/** Read access to a UTXO set plus a batched write path for caches. */
+class CoinsView {
+public:
+    virtual ~CoinsView() {}
+
+    /** False when the output does not exist or is spent. */
+    virtual bool GetCoin(const OutPoint& outpoint, Coin& coin) const = 0;
+    virtual bool HaveCoin(const OutPoint& outpoint) const
+    {
+        Coin coin;
+        return GetCoin(outpoint, coin);
+    }
+    /** Looks up many coins at once; missing ones come back spent. Views
+     *  over slow storage override this to overlap the reads. */
+    virtual void GetCoins(const std::vector<OutPoint>& outpoints, std::vector<Coin>& coins) const
+    {
+        coins.assign(outpoints.size(), Coin());
+        for (size_t i = 0; i < outpoints.size(); i++)
+            GetCoin(outpoints[i], coins[i]);
+    }
+    /** Block the view is consistent with. */
+    virtual uint256 GetBestBlock() const = 0;
+    /** Applies the DIRTY entries of a child cache; the map may be consumed. */
+    virtual void BatchWrite(CoinsMap& coins, const uint256& hashBlock) = 0;
+    virtual size_t GetCoinCount() const = 0;
+};
+
+/** Backing store that keeps every coin in memory. */
+class CoinsViewMemory : public CoinsView {
+public:
+    bool GetCoin(const OutPoint& outpoint, Coin& coin) const;
+    uint256 GetBestBlock() const { return hashBlock; }
+    void BatchWrite(CoinsMap& coins, const uint256& hashBlock);
+    size_t GetCoinCount() const { return map.size(); }
+
+private:
+    std::unordered_map<OutPoint, Coin, OutPointHasher, std::equal_to<OutPoint>,
+        ArenaAllocator<std::pair<const OutPoint, Coin> > > map;
+    uint256 hashBlock;
+};
+
+/** Write-back cache over another view. Block connection works on a cache
+ *  of its own so a failed block leaves the parent untouched. */
+class CoinsViewCache : public CoinsView {
+public:
+    explicit CoinsViewCache(CoinsView* base) : base(base) {}
+
+    bool GetCoin(const OutPoint& outpoint, Coin& coin) const;
+    bool HaveCoin(const OutPoint& outpoint) const;
+    void GetCoins(const std::vector<OutPoint>& outpoints, std::vector<Coin>& coins) const;
+    uint256 GetBestBlock() const;
+    void BatchWrite(CoinsMap& coins, const uint256& hashBlock);
+    /** Coin count of the base view; exact only after Flush(). */
+    size_t GetCoinCount() const { return base->GetCoinCount(); }
+
+    /** The coin, or a spent coin when missing. The reference is valid
+     *  until the cache is next modified. */
+    const Coin& AccessCoin(const OutPoint& outpoint) const;
+    /** Brings the coins into the cache, looking up all the ones it lacks
+     *  in one batch from the base view. */
+    void FetchCoins(const std::vector<OutPoint>& outpoints) const;
+    /** Adds a coin. fPossibleOverwrite allows replacing an unspent coin,
+     *  looked up in the parent unless the cache has it already. */
+    void AddCoin(const OutPoint& outpoint, Coin&& coin, bool fPossibleOverwrite);
+    /** Adds all outputs of tx, skipping unspendable ones. */
+    void AddCoins(const Transaction& tx, int nHeight, bool fCheckOverwrite = false);
+    /** Spends a coin, moving it into *moveout when given. False when the
+     *  coin was already missing or spent. */
+    bool SpendCoin(const OutPoint& outpoint, Coin* moveout = NULL);
+
+    void SetBestBlock(const uint256& hash) { hashBlock = hash; }
+    /** Pushes all changes down to the base view and empties the cache. */
+    void Flush();
+    /** Frees the buckets an empty cache kept from its peak size and returns
+     *  the arena chunks left idle to the system. For after a Flush() of a
+     *  large cache; one reused for every block should keep its buckets. */
+    void ReleaseMemory();
+    size_t CacheSize() const { return cacheCoins.size(); }
+
+private:
+    CoinsView* base;
+    mutable CoinsMap cacheCoins;
+    mutable uint256 hashBlock;
+
+    CoinsMap::iterator FetchCoin(const OutPoint& outpoint) const;
+};
+
+/**
+ * A cache split by outpoint into shards, each behind its own lock, that
+ * threads applying independent transactions of one block share. Each
+ * thread works in a CoinsViewCache of its own on top and flushes it here;
+ * Flush() then hands everything to the base view from one thread. Misses
+ * go to the base view under one lock, so its coins are best fetched
+ * beforehand.
+ */
+class CoinsViewSharded : public CoinsView {
+public:
+    CoinsViewSharded(CoinsView* base, size_t nShards);
+
+    bool GetCoin(const OutPoint& outpoint, Coin& coin) const;
+    bool HaveCoin(const OutPoint& outpoint) const;
+    uint256 GetBestBlock() const { return baseLocked.GetBestBlock(); }
+    void BatchWrite(CoinsMap& coins, const uint256& hashBlock);
+    size_t GetCoinCount() const { return baseLocked.GetCoinCount(); }
+
+    /** Pushes every shard down to the base view. Not thread-safe. */
+    void Flush();
+
+private:
+    /** The base view with every call under one lock. */
+    class LockedView : public CoinsView {
+    public:
+        explicit LockedView(CoinsView* base) : base(base) {}
+
+        bool GetCoin(const OutPoint& outpoint, Coin& coin) const;
+        uint256 GetBestBlock() const;
+        void BatchWrite(CoinsMap& coins, const uint256& hashBlock);
+        size_t GetCoinCount() const;
+
+    private:
+        CoinsView* base;
+        mutable std::mutex mutex;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::unique_ptr<CoinsViewCache> cache;
+    };
+
+    LockedView baseLocked;
+    std::vector<std::unique_ptr<Shard> > shards;
+    OutPointHasher hasher;
+
+    Shard& ShardFor(const OutPoint& outpoint) const;
+};
+
+#endif // ONECOIN_COINS_H
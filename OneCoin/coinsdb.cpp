@@ -0,0 +1,345 @@
+#include "coinsdb.h"
+#include "compressor.h"
+#include "fs.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+/** Records read back per batch while compacting or iterating. */
+const size_t COMPACT_BATCH = 4096;
+
+bool PwriteAll(int fd, const unsigned char* buf, size_t len, uint64_t offset)
+{
+    while (len) {
+        ssize_t n = pwrite(fd, buf, len, (off_t)offset);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        buf += n;
+        len -= n;
+        offset += n;
+    }
+    return true;
+}
+
+void DecodeCoin(const unsigned char* data, size_t len, Coin& coin)
+{
+    try {
+        ByteReader r(data, len);
+        UnserializeCompressedCoin(r, coin);
+    } catch (const SerializeError&) {
+        throw std::runtime_error("corrupt record in the coins database");
+    }
+}
+
+} // namespace
+
+CoinsViewDB::CoinsViewDB(const std::string& dir, BatchReader::Method method)
+    : dir(dir), path(dir + "/coins.dat"), fd(-1), reader(new BatchReader(method)), nFileSize(0), nDeadBytes(0),
+      nCompactThreshold(64 << 20)
+{
+}
+
+CoinsViewDB::~CoinsViewDB()
+{
+    if (fd >= 0)
+        close(fd);
+}
+
+bool CoinsViewDB::Open(std::string& error)
+{
+    if (!CreateDirectories(dir)) {
+        error = "cannot create " + dir;
+        return false;
+    }
+    if (fd >= 0)
+        close(fd);
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        error = "cannot open " + path;
+        return false;
+    }
+    index.clear();
+    nFileSize = 0;
+    nDeadBytes = 0;
+    hashBlock = uint256();
+    return true;
+}
+
+bool CoinsViewDB::GetCoin(const OutPoint& outpoint, Coin& coin) const
+{
+    IndexMap::const_iterator it = index.find(outpoint);
+    if (it == index.end())
+        return false;
+    unsigned char buf[256];
+    std::vector<unsigned char> big;
+    unsigned char* data = buf;
+    if (it->second.nSize > sizeof(buf)) {
+        big.resize(it->second.nSize);
+        data = big.data();
+    }
+    if (!PreadAll(fd, data, it->second.nSize, it->second.nPos))
+        throw std::runtime_error("cannot read " + path);
+    DecodeCoin(data, it->second.nSize, coin);
+    return true;
+}
+
+void CoinsViewDB::GetCoins(const std::vector<OutPoint>& outpoints, std::vector<Coin>& coins) const
+{
+    coins.assign(outpoints.size(), Coin());
+    std::vector<size_t> found;
+    std::vector<ReadRequest> requests;
+    size_t nBytes = 0;
+    for (size_t i = 0; i < outpoints.size(); i++) {
+        IndexMap::const_iterator it = index.find(outpoints[i]);
+        if (it == index.end())
+            continue;
+        ReadRequest req;
+        req.nOffset = it->second.nPos;
+        req.nSize = it->second.nSize;
+        req.data = NULL;
+        requests.push_back(req);
+        found.push_back(i);
+        nBytes += req.nSize;
+    }
+    if (requests.empty())
+        return;
+    std::vector<unsigned char> buf(nBytes);
+    size_t nOffset = 0;
+    for (size_t i = 0; i < requests.size(); i++) {
+        requests[i].data = buf.data() + nOffset;
+        nOffset += requests[i].nSize;
+    }
+    if (!reader->Read(fd, requests))
+        throw std::runtime_error("cannot read " + path);
+    for (size_t i = 0; i < requests.size(); i++)
+        DecodeCoin(requests[i].data, requests[i].nSize, coins[found[i]]);
+}
+
+void CoinsViewDB::BatchWrite(CoinsMap& coins, const uint256& hashBlockIn)
+{
+    std::vector<unsigned char> buf;
+    ByteWriter w(buf);
+    for (CoinsMap::iterator it = coins.begin(); it != coins.end(); ++it) {
+        if (!(it->second.flags & CoinsCacheEntry::DIRTY))
+            continue;
+        IndexMap::iterator pos = index.find(it->first);
+        if (pos != index.end()) {
+            nDeadBytes += pos->second.nSize;
+            if (it->second.coin.IsSpent())
+                index.erase(pos);
+        }
+        if (it->second.coin.IsSpent())
+            continue;
+        RecordPos& record = index[it->first];
+        record.nPos = nFileSize + buf.size();
+        SerializeCompressedCoin(w, it->second.coin);
+        record.nSize = (uint32_t)(nFileSize + buf.size() - record.nPos);
+    }
+    coins.clear();
+    if (!hashBlockIn.IsNull())
+        hashBlock = hashBlockIn;
+    if (buf.empty())
+        return;
+    if (fd < 0 || !PwriteAll(fd, buf.data(), buf.size(), nFileSize))
+        throw std::runtime_error("cannot write " + path);
+    nFileSize += buf.size();
+    if (nDeadBytes > nCompactThreshold && nDeadBytes > nFileSize - nDeadBytes)
+        Compact();
+}
+
+void CoinsViewDB::ForEachCoin(const CoinFn& fn) const
+{
+    std::vector<OutPoint> outpoints;
+    outpoints.reserve(index.size());
+    for (IndexMap::const_iterator it = index.begin(); it != index.end(); ++it)
+        outpoints.push_back(it->first);
+    std::sort(outpoints.begin(), outpoints.end());
+    std::vector<OutPoint> batch;
+    std::vector<Coin> coins;
+    for (size_t i = 0; i < outpoints.size(); i += COMPACT_BATCH) {
+        batch.assign(outpoints.begin() + i, outpoints.begin() + std::min(outpoints.size(), i + COMPACT_BATCH));
+        GetCoins(batch, coins);
+        for (size_t j = 0; j < batch.size(); j++) {
+            if (!fn(batch[j], coins[j]))
+                return;
+        }
+    }
+}
+
+void CoinsViewDB::Compact()
+{
+    std::string tmpPath = path + ".new";
+    int tmp = open(tmpPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (tmp < 0)
+        throw std::runtime_error("cannot open " + tmpPath);
+
+    std::vector<RecordPos*> batch;
+    std::vector<ReadRequest> requests;
+    std::vector<unsigned char> buf;
+    std::vector<uint64_t> newPos;
+    newPos.reserve(index.size());
+    uint64_t nNewSize = 0;
+    IndexMap::iterator it = index.begin();
+    bool ok = true;
+    while (ok && it != index.end()) {
+        batch.clear();
+        requests.clear();
+        size_t nBytes = 0;
+        for (; it != index.end() && batch.size() < COMPACT_BATCH; ++it) {
+            batch.push_back(&it->second);
+            nBytes += it->second.nSize;
+        }
+        buf.resize(nBytes);
+        size_t nOffset = 0;
+        for (size_t i = 0; i < batch.size(); i++) {
+            ReadRequest req;
+            req.nOffset = batch[i]->nPos;
+            req.nSize = batch[i]->nSize;
+            req.data = buf.data() + nOffset;
+            requests.push_back(req);
+            newPos.push_back(nNewSize + nOffset);
+            nOffset += req.nSize;
+        }
+        ok = reader->Read(fd, requests) && PwriteAll(tmp, buf.data(), buf.size(), nNewSize);
+        nNewSize += nBytes;
+    }
+    if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        close(tmp);
+        RemoveFile(tmpPath);
+        throw std::runtime_error("cannot compact " + path);
+    }
+
+    // Positions follow iteration order, which nothing above changed.
+    size_t i = 0;
+    for (it = index.begin(); it != index.end(); ++it)
+        it->second.nPos = newPos[i++];
+    close(fd);
+    fd = tmp;
+    nFileSize = nNewSize;
+    nDeadBytes = 0;
+}
+
+namespace {
+
+/** Coins are under 'c' + txid + index, so they sort by transaction. */
+const char DB_COIN = 'c';
+/** Best block hash and coin count. */
+const char DB_META = 'M';
+
+std::string CoinKey(const OutPoint& outpoint)
+{
+    std::string key(1 + 32 + 4, DB_COIN);
+    memcpy(&key[1], outpoint.hash.begin(), 32);
+    // Big-endian, so the outputs of a transaction sort by index.
+    for (int i = 0; i < 4; i++)
+        key[33 + i] = (char)(outpoint.n >> (24 - 8 * i));
+    return key;
+}
+
+} // namespace
+
+CoinsViewLsm::CoinsViewLsm(const std::string& dir, const LsmOptions& options)
+    : store(dir, options), fSyncWrites(false), nCoinCount(0)
+{
+}
+
+bool CoinsViewLsm::Open(std::string& error)
+{
+    store.Close();
+    hashBlock = uint256();
+    nCoinCount = 0;
+    if (!store.Open(error))
+        return false;
+    std::string value;
+    if (!store.Get(std::string(1, DB_META), value))
+        return true;
+    try {
+        ByteReader r((const unsigned char*)value.data(), value.size());
+        unsigned char hash[32];
+        r.ReadBytes(hash, sizeof(hash));
+        uint64_t nCount = r.ReadU64();
+        if (!r.Empty())
+            throw SerializeError("trailing data");
+        hashBlock = uint256(hash);
+        nCoinCount = (size_t)nCount;
+    } catch (const SerializeError& e) {
+        error = "corrupt best block record in " + store.Dir() + ": " + e.what();
+        return false;
+    }
+    return true;
+}
+
+bool CoinsViewLsm::GetCoin(const OutPoint& outpoint, Coin& coin) const
+{
+    std::string value;
+    if (!store.Get(CoinKey(outpoint), value))
+        return false;
+    DecodeCoin((const unsigned char*)value.data(), value.size(), coin);
+    return true;
+}
+
+bool CoinsViewLsm::HaveCoin(const OutPoint& outpoint) const
+{
+    std::string value;
+    return store.Get(CoinKey(outpoint), value);
+}
+
+void CoinsViewLsm::BatchWrite(CoinsMap& coins, const uint256& hashBlockIn)
+{
+    LsmWriteBatch batch;
+    std::vector<unsigned char> buf;
+    for (CoinsMap::iterator it = coins.begin(); it != coins.end(); ++it) {
+        if (!(it->second.flags & CoinsCacheEntry::DIRTY))
+            continue;
+        // FRESH coins are new here and the others are all here, so the
+        // flags keep the count without looking anything up.
+        bool fExists = !(it->second.flags & CoinsCacheEntry::FRESH);
+        if (it->second.coin.IsSpent()) {
+            if (fExists) {
+                batch.Delete(CoinKey(it->first));
+                nCoinCount--;
+            }
+            continue;
+        }
+        buf.clear();
+        ByteWriter w(buf);
+        SerializeCompressedCoin(w, it->second.coin);
+        batch.Put(CoinKey(it->first), std::string(buf.begin(), buf.end()));
+        if (!fExists)
+            nCoinCount++;
+    }
+    coins.clear();
+    if (batch.Count() == 0 && (hashBlockIn.IsNull() || hashBlockIn == hashBlock))
+        return;
+    if (!hashBlockIn.IsNull())
+        hashBlock = hashBlockIn;
+    buf.clear();
+    ByteWriter w(buf);
+    w.WriteBytes(hashBlock.begin(), 32);
+    w.WriteU64(nCoinCount);
+    batch.Put(std::string(1, DB_META), std::string(buf.begin(), buf.end()));
+    store.Write(batch, fSyncWrites);
+}
+
+void CoinsViewLsm::ForEachCoin(const CoinFn& fn) const
+{
+    store.Scan(std::string(1, DB_COIN), std::string(1, DB_COIN + 1),
+        [&](const std::string& key, const std::string& value) {
+            if (key.size() != 1 + 32 + 4)
+                throw std::runtime_error("corrupt key in the coins database");
+            const unsigned char* p = (const unsigned char*)key.data() + 1;
+            OutPoint outpoint(uint256(p), (uint32_t)p[32] << 24 | (uint32_t)p[33] << 16 | (uint32_t)p[34] << 8 | p[35]);
+            Coin coin;
+            DecodeCoin((const unsigned char*)value.data(), value.size(), coin);
+            return fn(outpoint, coin);
+        });
+}
@@ -0,0 +1,121 @@
+#ifndef ONECOIN_COINSDB_H
+#define ONECOIN_COINSDB_H
+
+#include "batchread.h"
+#include "coins.h"
+#include "lsm.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+/** A UTXO set on disk. Open() either gets back the coins flushed before
+ *  a restart or starts afresh, for the chainstate to rebuild from the
+ *  block files. */
+class CoinsViewStore : public CoinsView {
+public:
+    typedef std::function<bool(const OutPoint& outpoint, const Coin& coin)> CoinFn;
+
+    virtual bool Open(std::string& error) = 0;
+    /** Whether Open() gets back what was flushed before. */
+    virtual bool IsPersistent() const = 0;
+    /** Calls fn on every coin in outpoint order until it returns false. */
+    virtual void ForEachCoin(const CoinFn& fn) const = 0;
+};
+
+/**
+ * The UTXO set on disk. Coin records are appended to dir/coins.dat and
+ * found through an in-memory index of outpoints, so only the scripts and
+ * amounts live on disk, in the compressed form of compressor.h. Batched
+ * lookups issue all their reads at once.
+ *
+ * Load() rebuilds the UTXO set from the block files, so the file is
+ * started afresh on Open(). A failed read or write leaves the set unknown
+ * and throws std::runtime_error rather than reporting a missing coin.
+ */
+class CoinsViewDB : public CoinsViewStore {
+public:
+    explicit CoinsViewDB(const std::string& dir, BatchReader::Method method = BatchReader::READ_AUTO);
+    ~CoinsViewDB();
+
+    bool Open(std::string& error);
+    bool IsPersistent() const { return false; }
+
+    bool GetCoin(const OutPoint& outpoint, Coin& coin) const;
+    void GetCoins(const std::vector<OutPoint>& outpoints, std::vector<Coin>& coins) const;
+    bool HaveCoin(const OutPoint& outpoint) const { return index.count(outpoint) != 0; }
+    uint256 GetBestBlock() const { return hashBlock; }
+    void BatchWrite(CoinsMap& coins, const uint256& hashBlock);
+    size_t GetCoinCount() const { return index.size(); }
+    /** Sorts the index first, then reads the coins in batches. */
+    void ForEachCoin(const CoinFn& fn) const;
+
+    /** Rewrites the file without spent records once they take more space
+     *  than both the live ones and this many bytes. */
+    void SetCompactThreshold(uint64_t nBytes) { nCompactThreshold = nBytes; }
+    uint64_t FileSize() const { return nFileSize; }
+    const std::string& FilePath() const { return path; }
+    BatchReader::Method GetReadMethod() const { return reader->GetMethod(); }
+    /** Switches how batched lookups read the file. */
+    void SetReadMethod(BatchReader::Method method) { reader.reset(new BatchReader(method)); }
+
+private:
+    struct RecordPos {
+        uint64_t nPos;
+        uint32_t nSize;
+    };
+    typedef std::unordered_map<OutPoint, RecordPos, OutPointHasher, std::equal_to<OutPoint>,
+        ArenaAllocator<std::pair<const OutPoint, RecordPos> > > IndexMap;
+
+    std::string dir;
+    std::string path;
+    int fd;
+    std::unique_ptr<BatchReader> reader;
+    IndexMap index;
+    uint64_t nFileSize;
+    uint64_t nDeadBytes;
+    uint64_t nCompactThreshold;
+    uint256 hashBlock;
+
+    void Compact();
+};
+
+/**
+ * The UTXO set in an LsmStore, keyed by outpoint, with compressed coins
+ * as values. Unlike CoinsViewDB it keeps no per-coin state in memory, only
+ * the store's table indexes and filters, so it keeps working once the set
+ * outgrows RAM. The best block and the coin count are stored with every
+ * batch of coins, and Open() recovers the store and reads them back.
+ *
+ * With sync writes each flush is durable when BatchWrite() returns;
+ * flushes from several threads then share fdatasync calls through the
+ * store's group commit.
+ */
+class CoinsViewLsm : public CoinsViewStore {
+public:
+    explicit CoinsViewLsm(const std::string& dir, const LsmOptions& options = LsmOptions());
+
+    bool Open(std::string& error);
+    bool IsPersistent() const { return true; }
+
+    bool GetCoin(const OutPoint& outpoint, Coin& coin) const;
+    bool HaveCoin(const OutPoint& outpoint) const;
+    uint256 GetBestBlock() const { return hashBlock; }
+    void BatchWrite(CoinsMap& coins, const uint256& hashBlock);
+    size_t GetCoinCount() const { return nCoinCount; }
+    void ForEachCoin(const CoinFn& fn) const;
+
+    void SetSyncWrites(bool fSync) { fSyncWrites = fSync; }
+    LsmStore& GetStore() { return store; }
+
+private:
+    LsmStore store;
+    bool fSyncWrites;
+    uint256 hashBlock;
+    size_t nCoinCount;
+};
+
+#endif // ONECOIN_COINSDB_H
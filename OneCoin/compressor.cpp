@@ -0,0 +1,123 @@
+#include "compressor.h"
+
+#include <algorithm>
+
+namespace {
+
+enum ScriptType {
+    SCRIPT_P2PKH = 0,
+    SCRIPT_P2SH = 1,
+    // 2 and 3 are the prefix of the compressed public key.
+    SCRIPT_P2PK_EVEN = 2,
+    SCRIPT_P2PK_ODD = 3,
+};
+
+bool IsCompressedPayToPubKey(const Script& script)
+{
+    return script.size() == 35 && script[0] == 33 && script[34] == OP_CHECKSIG &&
+           (script[1] == 0x02 || script[1] == 0x03);
+}
+
+} // namespace
+
+uint64_t CompressAmount(uint64_t n)
+{
+    if (n == 0)
+        return 0;
+    int e = 0;
+    while ((n % 10) == 0 && e < 9) {
+        n /= 10;
+        e++;
+    }
+    if (e < 9) {
+        int d = (int)(n % 10);
+        n /= 10;
+        return 1 + (n * 9 + d - 1) * 10 + e;
+    }
+    return 1 + (n - 1) * 10 + 9;
+}
+
+uint64_t DecompressAmount(uint64_t x)
+{
+    if (x == 0)
+        return 0;
+    x--;
+    int e = (int)(x % 10);
+    x /= 10;
+    uint64_t n = 0;
+    if (e < 9) {
+        int d = (int)(x % 9) + 1;
+        x /= 9;
+        n = x * 10 + d;
+    } else {
+        n = x + 1;
+    }
+    while (e--)
+        n *= 10;
+    return n;
+}
+
+void WriteCompressedScript(ByteWriter& w, const Script& script)
+{
+    if (script.IsPayToPubKeyHash()) {
+        w.WriteU8(SCRIPT_P2PKH);
+        w.WriteBytes(&script[3], 20);
+    } else if (script.IsPayToScriptHash()) {
+        w.WriteU8(SCRIPT_P2SH);
+        w.WriteBytes(&script[2], 20);
+    } else if (IsCompressedPayToPubKey(script)) {
+        w.WriteBytes(&script[1], 33);
+    } else {
+        w.WriteVarInt(script.size() + SPECIAL_SCRIPTS);
+        w.WriteBytes(script.data(), script.size());
+    }
+}
+
+void ReadCompressedScript(ByteReader& r, Script& script)
+{
+    uint64_t nSize = r.ReadVarInt();
+    unsigned char data[33];
+    switch (nSize) {
+    case SCRIPT_P2PKH:
+        r.ReadBytes(data, 20);
+        script = GetScriptForPubKeyHash(data);
+        return;
+    case SCRIPT_P2SH:
+        r.ReadBytes(data, 20);
+        script = GetScriptForScriptHash(data);
+        return;
+    case SCRIPT_P2PK_EVEN:
+    case SCRIPT_P2PK_ODD:
+        data[0] = (unsigned char)nSize;
+        r.ReadBytes(data + 1, 32);
+        script.assign(35, OP_CHECKSIG);
+        script[0] = 33;
+        std::copy(data, data + 33, script.begin() + 1);
+        return;
+    }
+    if (nSize < SPECIAL_SCRIPTS)
+        throw SerializeError("unknown compressed script type");
+    nSize -= SPECIAL_SCRIPTS;
+    if (nSize > r.Remaining())
+        throw SerializeError("compressed script exceeds data");
+    script.resize(nSize);
+    r.ReadBytes(script.data(), nSize);
+}
+
+void SerializeCompressedCoin(ByteWriter& w, const Coin& coin)
+{
+    w.WriteVarInt((uint64_t)coin.nHeight * 2 + (coin.fCoinBase ? 1 : 0));
+    w.WriteVarInt(CompressAmount((uint64_t)coin.out.nValue));
+    WriteCompressedScript(w, coin.out.scriptPubKey);
+}
+
+void UnserializeCompressedCoin(ByteReader& r, Coin& coin)
+{
+    uint64_t code = r.ReadVarInt();
+    if ((code >> 1) > INT32_MAX)
+        throw SerializeError("coin height out of range");
+    coin.nHeight = (int)(code >> 1);
+    coin.fCoinBase = code & 1;
+    coin.out.nValue = (Amount)DecompressAmount(r.ReadVarInt());
+    ReadCompressedScript(r, coin.out.scriptPubKey);
+}
@@ -0,0 +1,35 @@
+#ifndef ONECOIN_COMPRESSOR_H
+#define ONECOIN_COMPRESSOR_H
+
+#include "coins.h"
+#include "script.h"
+#include "serialize.h"
+
+#include <stdint.h>
+
+/**
+ * Compact forms of amounts and output scripts for stored coins.
+ *
+ * Amounts drop their trailing decimal zeros into an exponent, so round
+ * values fit a byte or two as a varint. Pay-to-pubkey-hash and
+ * pay-to-script-hash scripts shrink to a type byte and their 20-byte hash,
+ * pay-to-pubkey scripts with a compressed key to the key's 33 bytes, whose
+ * first byte doubles as the type. Other scripts are stored whole after a
+ * varint of their size plus SPECIAL_SCRIPTS.
+ */
+
+static const unsigned int SPECIAL_SCRIPTS = 6;
+
+uint64_t CompressAmount(uint64_t n);
+uint64_t DecompressAmount(uint64_t x);
+
+void WriteCompressedScript(ByteWriter& w, const Script& script);
+/** Throws SerializeError on malformed input. */
+void ReadCompressedScript(ByteReader& r, Script& script);
+
+/** Height, coinbase flag, amount and script, each compressed. */
+void SerializeCompressedCoin(ByteWriter& w, const Coin& coin);
+/** Throws SerializeError on malformed input. */
+void UnserializeCompressedCoin(ByteReader& r, Coin& coin);
+
+#endif // ONECOIN_COMPRESSOR_H
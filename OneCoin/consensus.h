@@ -0,0 +1,40 @@
+#ifndef ONECOIN_CONSENSUS_H
+#define ONECOIN_CONSENSUS_H
+
+#include "amount.h"
+#include "arith_uint256.h"
+#include "uint256.h"
+
+#include <stdint.h>
+
+/** Largest serialized block we accept. */
+static const unsigned int MAX_BLOCK_SIZE = 1000000;
+/** Coinbase outputs can be spent this many blocks after their own. */
+static const int COINBASE_MATURITY = 100;
+
+/** Parameters that determine which chain is valid. */
+struct ConsensusParams {
+    uint256 hashGenesisBlock;
+    /** Easiest allowed target. */
+    arith_uint256 powLimit;
+    int64_t nPowTargetSpacing;
+    int64_t nPowTargetTimespan;
+    /** Keep nBits fixed forever (test chains). */
+    bool fPowNoRetargeting;
+    int nSubsidyHalvingInterval;
+    /** Scripts of this block and its ancestors are not run, unless
+     *  overridden; null checks every block. */
+    uint256 defaultAssumeValid;
+
+    int64_t DifficultyAdjustmentInterval() const { return nPowTargetTimespan / nPowTargetSpacing; }
+};
+
+inline Amount GetBlockSubsidy(int nHeight, const ConsensusParams& params)
+{
+    int halvings = nHeight / params.nSubsidyHalvingInterval;
+    if (halvings >= 64)
+        return 0;
+    return (50 * COIN) >> halvings;
+}
+
+#endif // ONECOIN_CONSENSUS_H
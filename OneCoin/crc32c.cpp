@@ -0,0 +1,172 @@
+#include "crc32c.h"
+#include "serialize.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+#endif
+
+namespace {
+
+/** The Castagnoli polynomial, bit-reversed. */
+const uint32_t CRC32C_POLY = 0x82f63b78;
+
+/** Bytes per stream when the hardware path runs three at once, long and
+ *  short; powers of two, for BuildZeros(). */
+const size_t CRC32C_LONG = 8192;
+const size_t CRC32C_SHORT = 256;
+
+/** Multiplies the 32x32 GF(2) matrix mat by vec. */
+uint32_t Gf2MatrixTimes(const uint32_t* mat, uint32_t vec)
+{
+    uint32_t sum = 0;
+    for (; vec; vec >>= 1, mat++) {
+        if (vec & 1)
+            sum ^= *mat;
+    }
+    return sum;
+}
+
+void Gf2MatrixSquare(uint32_t* square, const uint32_t* mat)
+{
+    for (int n = 0; n < 32; n++)
+        square[n] = Gf2MatrixTimes(mat, mat[n]);
+}
+
+struct Crc32cTables {
+    /** Slicing-by-8: slice[k][b] is the CRC of byte b followed by k zero
+     *  bytes. */
+    uint32_t slice[8][256];
+    /** What running a CRC register through CRC32C_LONG and CRC32C_SHORT
+     *  zero bytes does to it, a byte of the register at a time. */
+    uint32_t zerosLong[4][256];
+    uint32_t zerosShort[4][256];
+
+    Crc32cTables()
+    {
+        for (uint32_t b = 0; b < 256; b++) {
+            uint32_t crc = b;
+            for (int i = 0; i < 8; i++)
+                crc = (crc >> 1) ^ (CRC32C_POLY & (0 - (crc & 1)));
+            slice[0][b] = crc;
+        }
+        for (uint32_t b = 0; b < 256; b++) {
+            for (int k = 1; k < 8; k++)
+                slice[k][b] = (slice[k - 1][b] >> 8) ^ slice[0][slice[k - 1][b] & 0xff];
+        }
+        BuildZeros(zerosLong, CRC32C_LONG);
+        BuildZeros(zerosShort, CRC32C_SHORT);
+    }
+
+    /** By repeated squaring of the operator for one zero bit. */
+    static void BuildZeros(uint32_t zeros[4][256], size_t len)
+    {
+        uint32_t even[32], odd[32];
+        odd[0] = CRC32C_POLY;
+        for (int n = 1; n < 32; n++)
+            odd[n] = 1u << (n - 1);
+        Gf2MatrixSquare(even, odd); // two zero bits
+        Gf2MatrixSquare(odd, even); // four
+        // Each pass doubles: the first gives a zero byte.
+        const uint32_t* op = odd;
+        while (len) {
+            Gf2MatrixSquare(even, odd);
+            op = even;
+            len >>= 1;
+            if (!len)
+                break;
+            Gf2MatrixSquare(odd, even);
+            op = odd;
+            len >>= 1;
+        }
+        for (uint32_t n = 0; n < 256; n++) {
+            for (int k = 0; k < 4; k++)
+                zeros[k][n] = Gf2MatrixTimes(op, n << (8 * k));
+        }
+    }
+};
+
+const Crc32cTables& Tables()
+{
+    static const Crc32cTables tables;
+    return tables;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+inline uint32_t Shift(const uint32_t zeros[4][256], uint32_t crc)
+{
+    return zeros[0][crc & 0xff] ^ zeros[1][(crc >> 8) & 0xff] ^ zeros[2][(crc >> 16) & 0xff] ^ zeros[3][crc >> 24];
+}
+
+/** Three streams of nLen bytes at once, to cover the latency of the
+ *  instruction, combined by shifting each past the next. */
+__attribute__((target("sse4.2"))) inline void Crc32cSse42Streams(uint64_t& crc0, const unsigned char*& data,
+    size_t& len, size_t nLen, const uint32_t zeros[4][256])
+{
+    while (len >= 3 * nLen) {
+        uint64_t crc1 = 0, crc2 = 0;
+        const unsigned char* end = data + nLen;
+        do {
+            crc0 = _mm_crc32_u64(crc0, ReadLE64(data));
+            crc1 = _mm_crc32_u64(crc1, ReadLE64(data + nLen));
+            crc2 = _mm_crc32_u64(crc2, ReadLE64(data + 2 * nLen));
+            data += 8;
+        } while (data < end);
+        crc0 = Shift(zeros, (uint32_t)crc0) ^ (uint32_t)crc1;
+        crc0 = Shift(zeros, (uint32_t)crc0) ^ (uint32_t)crc2;
+        data += 2 * nLen;
+        len -= 3 * nLen;
+    }
+}
+
+__attribute__((target("sse4.2"))) uint32_t Crc32cSse42(uint32_t crc, const unsigned char* data, size_t len)
+{
+    const Crc32cTables& tables = Tables();
+    uint64_t crc0 = crc ^ 0xffffffff;
+    Crc32cSse42Streams(crc0, data, len, CRC32C_LONG, tables.zerosLong);
+    Crc32cSse42Streams(crc0, data, len, CRC32C_SHORT, tables.zerosShort);
+    for (; len >= 8; data += 8, len -= 8)
+        crc0 = _mm_crc32_u64(crc0, ReadLE64(data));
+    uint32_t crc32 = (uint32_t)crc0;
+    for (; len > 0; data++, len--)
+        crc32 = _mm_crc32_u8(crc32, *data);
+    return crc32 ^ 0xffffffff;
+}
+
+bool HaveSse42()
+{
+    static const bool fSse42 = __builtin_cpu_supports("sse4.2");
+    return fSse42;
+}
+#endif
+
+} // namespace
+
+uint32_t Crc32cExtendPortable(uint32_t crc, const unsigned char* data, size_t len)
+{
+    const Crc32cTables& tables = Tables();
+    const uint32_t (*t)[256] = tables.slice;
+    crc ^= 0xffffffff;
+    for (; len >= 8; data += 8, len -= 8) {
+        crc ^= ReadLE32(data);
+        uint32_t hi = ReadLE32(data + 4);
+        crc = t[7][crc & 0xff] ^ t[6][(crc >> 8) & 0xff] ^ t[5][(crc >> 16) & 0xff] ^ t[4][crc >> 24] ^
+              t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+    }
+    for (; len > 0; data++, len--)
+        crc = (crc >> 8) ^ t[0][(crc ^ *data) & 0xff];
+    return crc ^ 0xffffffff;
+}
+
+uint32_t Crc32cExtend(uint32_t crc, const unsigned char* data, size_t len)
+{
+#if defined(__x86_64__) && defined(__GNUC__)
+    if (HaveSse42())
+        return Crc32cSse42(crc, data, len);
+#endif
+    return Crc32cExtendPortable(crc, data, len);
+}
+
+uint32_t Crc32c(const unsigned char* data, size_t len)
+{
+    return Crc32cExtend(0, data, len);
+}
@@ -0,0 +1,18 @@
+#ifndef ONECOIN_CRC32C_H
+#define ONECOIN_CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** CRC-32C (Castagnoli) of data, the checksum of every record the node
+ *  writes to disk. Uses the SSE4.2 crc32 instruction where the CPU has it,
+ *  eight bytes a step, and a slicing-by-8 table otherwise. */
+uint32_t Crc32c(const unsigned char* data, size_t len);
+/** The CRC-32C of the bytes crc was computed over followed by data, so a
+ *  record can be checksummed in pieces: Crc32cExtend(0, ...) == Crc32c(...). */
+uint32_t Crc32cExtend(uint32_t crc, const unsigned char* data, size_t len);
+/** Crc32cExtend() with the table, whatever the CPU, for tests and
+ *  benchmarks. */
+uint32_t Crc32cExtendPortable(uint32_t crc, const unsigned char* data, size_t len);
+
+#endif // ONECOIN_CRC32C_H
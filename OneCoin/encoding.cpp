@@ -0,0 +1,555 @@
+#include "encoding.h"
+#include "hash.h"
+
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const char HEX_DIGITS[] = "0123456789abcdef";
+
+/** Maps a character to its hex nibble, or -1. */
+const signed char HEX_VALUES[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+#if defined(__SSE2__)
+/** Turns 16 nibbles into their lowercase ASCII digits. */
+inline __m128i NibblesToAscii(__m128i n)
+{
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i gap = _mm_set1_epi8('a' - '0' - 10);
+    __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(n, nine), gap);
+    return _mm_add_epi8(_mm_add_epi8(n, zero), letters);
+}
+
+/** Turns 16 hex characters into nibbles; valid gets 0xff for each good lane. */
+inline __m128i AsciiToNibbles(__m128i c, __m128i& valid)
+{
+    const __m128i below0 = _mm_set1_epi8('0' - 1);
+    const __m128i above9 = _mm_set1_epi8('9' + 1);
+    const __m128i belowA = _mm_set1_epi8('a' - 1);
+    const __m128i aboveF = _mm_set1_epi8('f' + 1);
+    __m128i is_digit = _mm_and_si128(_mm_cmpgt_epi8(c, below0), _mm_cmplt_epi8(c, above9));
+    __m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+    __m128i is_alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, belowA), _mm_cmplt_epi8(lower, aboveF));
+    __m128i digit = _mm_and_si128(is_digit, _mm_sub_epi8(c, _mm_set1_epi8('0')));
+    __m128i alpha = _mm_and_si128(is_alpha, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10)));
+    valid = _mm_or_si128(is_digit, is_alpha);
+    return _mm_or_si128(digit, alpha);
+}
+
+/** Packs pairs of nibbles (high first) from two registers into 16 bytes. */
+inline __m128i PackNibblePairs(__m128i a, __m128i b)
+{
+    const __m128i low = _mm_set1_epi16(0x00ff);
+    __m128i pa = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(a, low), 4), _mm_srli_epi16(a, 8));
+    __m128i pb = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(b, low), 4), _mm_srli_epi16(b, 8));
+    return _mm_packus_epi16(pa, pb);
+}
+#endif
+
+const char BASE58_DIGITS[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+
+const signed char BASE58_VALUES[128] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1,  0,  1,  2,  3,  4,  5,  6,  7,  8, -1, -1, -1, -1, -1, -1,
+    -1,  9, 10, 11, 12, 13, 14, 15, 16, -1, 17, 18, 19, 20, 21, -1,
+    22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, -1, -1, -1, -1, -1,
+    -1, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, -1, 44, 45, 46,
+    47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, -1, -1, -1, -1, -1,
+};
+
+/** Base58 digits are produced and consumed five at a time: 58^5 fits in
+ *  32 bits, so each pass over the limbs does the work of five byte-wise
+ *  passes of the textbook algorithm. */
+const uint32_t BASE58_POW5 = 656356768;
+
+inline int Base58Value(char c)
+{
+    unsigned char uc = (unsigned char)c;
+    return uc < 128 ? BASE58_VALUES[uc] : -1;
+}
+
+/** Loads big-endian bytes into big-endian 32-bit limbs, left-padded with zeros. */
+void BytesToLimbs(const unsigned char* data, size_t len, uint32_t* limbs, size_t nlimbs)
+{
+    memset(limbs, 0, nlimbs * sizeof(uint32_t));
+    size_t pad = nlimbs * 4 - len;
+    for (size_t i = 0; i < len; i++) {
+        size_t pos = pad + i;
+        limbs[pos / 4] |= (uint32_t)data[i] << (8 * (3 - pos % 4));
+    }
+}
+
+/** Divides the limbs by 58^5 in place and returns the remainder. */
+inline uint32_t DivModPow5(uint32_t* limbs, size_t begin, size_t nlimbs)
+{
+    uint64_t rem = 0;
+    for (size_t i = begin; i < nlimbs; i++) {
+        uint64_t cur = (rem << 32) | limbs[i];
+        limbs[i] = (uint32_t)(cur / BASE58_POW5);
+        rem = cur % BASE58_POW5;
+    }
+    return (uint32_t)rem;
+}
+
+/** Emits five base58 digit values, least significant last, ending at p. */
+inline unsigned char* EmitDigits(unsigned char* p, uint32_t rem)
+{
+    for (int k = 0; k < 5; k++) {
+        *--p = rem % 58;
+        rem /= 58;
+    }
+    return p;
+}
+
+/** Multiplies little-endian limbs by mul and adds add. Returns the carry out. */
+inline uint32_t MulAddLimbs(uint32_t* limbs, size_t nlimbs, uint32_t mul, uint32_t add)
+{
+    uint64_t carry = add;
+    for (size_t i = 0; i < nlimbs; i++) {
+        uint64_t cur = (uint64_t)limbs[i] * mul + carry;
+        limbs[i] = (uint32_t)cur;
+        carry = cur >> 32;
+    }
+    return (uint32_t)carry;
+}
+
+/** Renders digit values as base58 text after `zeros` leading '1's. */
+std::string DigitsToString(size_t zeros, const unsigned char* digits, const unsigned char* end)
+{
+    while (digits != end && *digits == 0)
+        digits++;
+    std::string str;
+    str.reserve(zeros + (end - digits));
+    str.assign(zeros, '1');
+    while (digits != end)
+        str += BASE58_DIGITS[*digits++];
+    return str;
+}
+
+size_t CountLeadingZeros(const unsigned char* data, size_t len)
+{
+    size_t zeros = 0;
+    while (zeros < len && data[zeros] == 0)
+        zeros++;
+    return zeros;
+}
+
+const uint32_t BECH32_CONST = 1;
+const uint32_t BECH32M_CONST = 0x2bc830a3;
+
+const char BECH32_CHARSET[] = "qpzry9x8gf2tvdw0s3jn54khce6mua7l";
+
+const signed char BECH32_VALUES[128] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    15, -1, 10, 17, 21, 20, 26, 30,  7,  5, -1, -1, -1, -1, -1, -1,
+    -1, 29, -1, 24, 13, 25,  9,  8, 23, -1, 18, 22, 31, 27, 19, -1,
+     1,  0,  3, 16, 11, 28, 12, 14,  6,  4,  2, -1, -1, -1, -1, -1,
+    -1, 29, -1, 24, 13, 25,  9,  8, 23, -1, 18, 22, 31, 27, 19, -1,
+     1,  0,  3, 16, 11, 28, 12, 14,  6,  4,  2, -1, -1, -1, -1, -1,
+};
+
+/** XOR of the BCH generator terms selected by the five bits shifted out of
+ *  the checksum, so each polymod step is one lookup instead of five branches. */
+const uint32_t BECH32_GEN_TABLE[32] = {
+    0x00000000, 0x3b6a57b2, 0x26508e6d, 0x1d3ad9df, 0x1ea119fa, 0x25cb4e48, 0x38f19797, 0x039bc025,
+    0x3d4233dd, 0x0628646f, 0x1b12bdb0, 0x2078ea02, 0x23e32a27, 0x18897d95, 0x05b3a44a, 0x3ed9f3f8,
+    0x2a1462b3, 0x117e3501, 0x0c44ecde, 0x372ebb6c, 0x34b57b49, 0x0fdf2cfb, 0x12e5f524, 0x298fa296,
+    0x1756516e, 0x2c3c06dc, 0x3106df03, 0x0a6c88b1, 0x09f74894, 0x329d1f26, 0x2fa7c6f9, 0x14cd914b,
+};
+
+inline uint32_t PolyModStep(uint32_t c, uint8_t v)
+{
+    return ((c & 0x1ffffff) << 5) ^ v ^ BECH32_GEN_TABLE[c >> 25];
+}
+
+uint32_t PolyModHrp(const std::string& hrp)
+{
+    uint32_t c = 1;
+    for (size_t i = 0; i < hrp.size(); i++)
+        c = PolyModStep(c, (unsigned char)hrp[i] >> 5);
+    c = PolyModStep(c, 0);
+    for (size_t i = 0; i < hrp.size(); i++)
+        c = PolyModStep(c, hrp[i] & 31);
+    return c;
+}
+
+uint32_t EncodingConstant(bech32::Encoding encoding)
+{
+    return encoding == bech32::BECH32 ? BECH32_CONST : BECH32M_CONST;
+}
+
+} // namespace
+
+void HexEncode(const unsigned char* in, size_t len, char* out)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+        __m128i hi = NibblesToAscii(_mm_and_si128(_mm_srli_epi16(v, 4), mask));
+        __m128i lo = NibblesToAscii(_mm_and_si128(v, mask));
+        _mm_storeu_si128((__m128i*)(out + 2 * i), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i*)(out + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+#endif
+    for (; i < len; i++) {
+        out[2 * i] = HEX_DIGITS[in[i] >> 4];
+        out[2 * i + 1] = HEX_DIGITS[in[i] & 15];
+    }
+}
+
+bool HexDecode(const char* in, size_t len, unsigned char* out)
+{
+    if (len % 2)
+        return false;
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 32 <= len; i += 32) {
+        __m128i va, vb;
+        __m128i a = AsciiToNibbles(_mm_loadu_si128((const __m128i*)(in + i)), va);
+        __m128i b = AsciiToNibbles(_mm_loadu_si128((const __m128i*)(in + i + 16)), vb);
+        if (_mm_movemask_epi8(_mm_and_si128(va, vb)) != 0xffff)
+            return false;
+        _mm_storeu_si128((__m128i*)(out + i / 2), PackNibblePairs(a, b));
+    }
+#endif
+    for (; i < len; i += 2) {
+        int hi = HEX_VALUES[(unsigned char)in[i]];
+        int lo = HEX_VALUES[(unsigned char)in[i + 1]];
+        if ((hi | lo) < 0)
+            return false;
+        out[i / 2] = (unsigned char)((hi << 4) | lo);
+    }
+    return true;
+}
+
+std::string HexStr(const unsigned char* data, size_t len)
+{
+    std::string str(len * 2, '\0');
+    if (len)
+        HexEncode(data, len, &str[0]);
+    return str;
+}
+
+std::string HexStr(const std::vector<unsigned char>& data)
+{
+    return HexStr(data.data(), data.size());
+}
+
+bool IsHex(const std::string& str)
+{
+    if (str.empty() || str.size() % 2)
+        return false;
+    for (size_t i = 0; i < str.size(); i++) {
+        if (HEX_VALUES[(unsigned char)str[i]] < 0)
+            return false;
+    }
+    return true;
+}
+
+std::vector<unsigned char> ParseHex(const std::string& str)
+{
+    std::vector<unsigned char> out(str.size() / 2);
+    if (!HexDecode(str.data(), str.size(), out.data()))
+        out.clear();
+    return out;
+}
+
+std::string EncodeBase58(const unsigned char* data, size_t len)
+{
+    size_t zeros = CountLeadingZeros(data, len);
+    data += zeros;
+    len -= zeros;
+
+    size_t nlimbs = (len + 3) / 4;
+    std::vector<uint32_t> limbs(nlimbs);
+    BytesToLimbs(data, len, limbs.data(), nlimbs);
+
+    // Each pass emits five digits, so round the capacity up to a multiple of five.
+    size_t cap = (Base58MaxEncodedSize(len) + 4) / 5 * 5;
+    std::vector<unsigned char> digits(cap);
+    unsigned char* end = digits.data() + cap;
+    unsigned char* p = end;
+    size_t begin = 0;
+    while (begin < nlimbs && limbs[begin] == 0)
+        begin++;
+    while (begin < nlimbs) {
+        p = EmitDigits(p, DivModPow5(limbs.data(), begin, nlimbs));
+        while (begin < nlimbs && limbs[begin] == 0)
+            begin++;
+    }
+    return DigitsToString(zeros, p, end);
+}
+
+std::string EncodeBase58(const std::vector<unsigned char>& data)
+{
+    return EncodeBase58(data.data(), data.size());
+}
+
+bool DecodeBase58(const std::string& str, std::vector<unsigned char>& out)
+{
+    size_t zeros = 0;
+    while (zeros < str.size() && str[zeros] == '1')
+        zeros++;
+
+    std::vector<uint32_t> limbs; // little-endian
+    uint32_t acc = 0, mul = 1;
+    for (size_t i = zeros; i < str.size(); i++) {
+        int v = Base58Value(str[i]);
+        if (v < 0)
+            return false;
+        acc = acc * 58 + v;
+        mul *= 58;
+        if (mul == BASE58_POW5 || i + 1 == str.size()) {
+            uint32_t carry = MulAddLimbs(limbs.data(), limbs.size(), mul, acc);
+            if (carry)
+                limbs.push_back(carry);
+            acc = 0;
+            mul = 1;
+        }
+    }
+
+    out.assign(zeros, 0);
+    bool leading = true;
+    for (size_t i = limbs.size(); i-- > 0;) {
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            unsigned char b = (unsigned char)(limbs[i] >> shift);
+            if (leading && b == 0)
+                continue;
+            leading = false;
+            out.push_back(b);
+        }
+    }
+    return true;
+}
+
+std::string EncodeBase58Address(const unsigned char payload[BASE58_ADDRESS_PAYLOAD])
+{
+    // 25 bytes fit in 7 limbs and always produce at most 35 digits, so every
+    // loop below has a compile-time trip count.
+    uint32_t limbs[7];
+    BytesToLimbs(payload, BASE58_ADDRESS_PAYLOAD, limbs, 7);
+    unsigned char digits[35];
+    unsigned char* p = digits + sizeof(digits);
+    for (int round = 0; round < 7; round++)
+        p = EmitDigits(p, DivModPow5(limbs, 0, 7));
+    return DigitsToString(CountLeadingZeros(payload, BASE58_ADDRESS_PAYLOAD), digits, digits + sizeof(digits));
+}
+
+bool DecodeBase58Address(const std::string& str, unsigned char payload[BASE58_ADDRESS_PAYLOAD])
+{
+    if (str.size() > 35)
+        return false;
+    size_t zeros = 0;
+    while (zeros < str.size() && str[zeros] == '1')
+        zeros++;
+
+    uint32_t limbs[7] = {0, 0, 0, 0, 0, 0, 0}; // little-endian
+    uint32_t acc = 0, mul = 1;
+    for (size_t i = zeros; i < str.size(); i++) {
+        int v = Base58Value(str[i]);
+        if (v < 0)
+            return false;
+        acc = acc * 58 + v;
+        mul *= 58;
+        if (mul == BASE58_POW5 || i + 1 == str.size()) {
+            if (MulAddLimbs(limbs, 7, mul, acc))
+                return false;
+            acc = 0;
+            mul = 1;
+        }
+    }
+    if (limbs[6] >> 8)
+        return false;
+
+    for (size_t i = 0; i < BASE58_ADDRESS_PAYLOAD; i++) {
+        size_t shift = (BASE58_ADDRESS_PAYLOAD - 1 - i) * 8;
+        payload[i] = (unsigned char)(limbs[shift / 32] >> (shift % 32));
+    }
+    // The number of leading '1's must match the leading zero bytes exactly,
+    // otherwise the string encodes a payload of a different length.
+    return CountLeadingZeros(payload, BASE58_ADDRESS_PAYLOAD) == zeros;
+}
+
+std::string EncodeBase58Check(const std::vector<unsigned char>& data)
+{
+    std::vector<unsigned char> buf(data);
+    unsigned char hash[32];
+    Sha256d(data.data(), data.size(), hash);
+    buf.insert(buf.end(), hash, hash + 4);
+    if (buf.size() == BASE58_ADDRESS_PAYLOAD)
+        return EncodeBase58Address(buf.data());
+    return EncodeBase58(buf);
+}
+
+bool DecodeBase58Check(const std::string& str, std::vector<unsigned char>& out)
+{
+    unsigned char payload[BASE58_ADDRESS_PAYLOAD];
+    if (DecodeBase58Address(str, payload)) {
+        out.assign(payload, payload + BASE58_ADDRESS_PAYLOAD);
+    } else if (!DecodeBase58(str, out)) {
+        return false;
+    }
+    if (out.size() < 4) {
+        out.clear();
+        return false;
+    }
+    unsigned char hash[32];
+    Sha256d(out.data(), out.size() - 4, hash);
+    if (memcmp(hash, out.data() + out.size() - 4, 4) != 0) {
+        out.clear();
+        return false;
+    }
+    out.resize(out.size() - 4);
+    return true;
+}
+
+namespace bech32 {
+
+std::string Encode(Encoding encoding, const std::string& hrp, const std::vector<uint8_t>& values)
+{
+    uint32_t c = PolyModHrp(hrp);
+    for (size_t i = 0; i < values.size(); i++)
+        c = PolyModStep(c, values[i]);
+    for (int i = 0; i < 6; i++)
+        c = PolyModStep(c, 0);
+    c ^= EncodingConstant(encoding);
+
+    std::string str;
+    str.reserve(hrp.size() + 1 + values.size() + 6);
+    str += hrp;
+    str += '1';
+    for (size_t i = 0; i < values.size(); i++)
+        str += BECH32_CHARSET[values[i]];
+    for (int i = 0; i < 6; i++)
+        str += BECH32_CHARSET[(c >> (5 * (5 - i))) & 31];
+    return str;
+}
+
+DecodeResult Decode(const std::string& str)
+{
+    DecodeResult result;
+    if (str.size() > 90)
+        return result;
+    bool lower = false, upper = false;
+    for (size_t i = 0; i < str.size(); i++) {
+        unsigned char ch = str[i];
+        if (ch < 33 || ch > 126)
+            return result;
+        lower |= (ch >= 'a' && ch <= 'z');
+        upper |= (ch >= 'A' && ch <= 'Z');
+    }
+    if (lower && upper)
+        return result;
+    size_t pos = str.rfind('1');
+    if (pos == std::string::npos || pos == 0 || pos + 7 > str.size())
+        return result;
+
+    std::string hrp(str, 0, pos);
+    for (size_t i = 0; i < hrp.size(); i++) {
+        if (hrp[i] >= 'A' && hrp[i] <= 'Z')
+            hrp[i] += 'a' - 'A';
+    }
+    std::vector<uint8_t> values(str.size() - pos - 1);
+    uint32_t c = PolyModHrp(hrp);
+    for (size_t i = 0; i < values.size(); i++) {
+        unsigned char ch = str[pos + 1 + i];
+        int v = BECH32_VALUES[ch];
+        if (v < 0)
+            return result;
+        values[i] = (uint8_t)v;
+        c = PolyModStep(c, values[i]);
+    }
+    if (c == BECH32_CONST) {
+        result.encoding = BECH32;
+    } else if (c == BECH32M_CONST) {
+        result.encoding = BECH32M;
+    } else {
+        return result;
+    }
+    values.resize(values.size() - 6);
+    result.hrp.swap(hrp);
+    result.data.swap(values);
+    return result;
+}
+
+bool ConvertBits(int frombits, int tobits, bool pad, const std::vector<uint8_t>& in, std::vector<uint8_t>& out)
+{
+    uint32_t acc = 0;
+    int bits = 0;
+    const uint32_t maxv = (1 << tobits) - 1;
+    const uint32_t max_acc = (1 << (frombits + tobits - 1)) - 1;
+    for (size_t i = 0; i < in.size(); i++) {
+        if (in[i] >> frombits)
+            return false;
+        acc = ((acc << frombits) | in[i]) & max_acc;
+        bits += frombits;
+        while (bits >= tobits) {
+            bits -= tobits;
+            out.push_back((acc >> bits) & maxv);
+        }
+    }
+    if (pad) {
+        if (bits)
+            out.push_back((acc << (tobits - bits)) & maxv);
+    } else if (bits >= frombits || ((acc << (tobits - bits)) & maxv)) {
+        return false;
+    }
+    return true;
+}
+
+std::string EncodeAddress(const std::string& hrp, int witver, const std::vector<uint8_t>& program)
+{
+    std::vector<uint8_t> values(1, (uint8_t)witver);
+    ConvertBits(8, 5, true, program, values);
+    return Encode(witver == 0 ? BECH32 : BECH32M, hrp, values);
+}
+
+bool DecodeAddress(const std::string& hrp, const std::string& addr, int& witver, std::vector<uint8_t>& program)
+{
+    DecodeResult dec = Decode(addr);
+    if (dec.encoding == INVALID || dec.hrp != hrp || dec.data.empty() || dec.data[0] > 16)
+        return false;
+    std::vector<uint8_t> data(dec.data.begin() + 1, dec.data.end());
+    std::vector<uint8_t> prog;
+    if (!ConvertBits(5, 8, false, data, prog))
+        return false;
+    if (prog.size() < 2 || prog.size() > 40)
+        return false;
+    if (dec.data[0] == 0 && prog.size() != 20 && prog.size() != 32)
+        return false;
+    if ((dec.data[0] == 0) != (dec.encoding == BECH32))
+        return false;
+    witver = dec.data[0];
+    program.swap(prog);
+    return true;
+}
+
+} // namespace bech32
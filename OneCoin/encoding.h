@@ -0,0 +1,76 @@
+#ifndef ONECOIN_ENCODING_H
+#define ONECOIN_ENCODING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/*
+ * Text codecs used by the RPC layer: hex for transactions and hashes,
+ * Base58Check for legacy addresses and Bech32/Bech32m for witness-style
+ * addresses. All encoders write into caller-sized buffers where possible so
+ * JSON responses can be built without intermediate copies.
+ */
+
+/** Writes 2*len lowercase hex characters to out. Uses SSE2 where available. */
+void HexEncode(const unsigned char* in, size_t len, char* out);
+
+/** Decodes len/2 bytes from len hex characters (either case).
+ *  Returns false on an odd length or a non-hex character. */
+bool HexDecode(const char* in, size_t len, unsigned char* out);
+
+std::string HexStr(const unsigned char* data, size_t len);
+std::string HexStr(const std::vector<unsigned char>& data);
+bool IsHex(const std::string& str);
+/** Returns an empty vector when str is not valid hex. */
+std::vector<unsigned char> ParseHex(const std::string& str);
+
+/** Largest output EncodeBase58 can produce for len input bytes. */
+inline size_t Base58MaxEncodedSize(size_t len) { return len * 138 / 100 + 1; }
+
+std::string EncodeBase58(const unsigned char* data, size_t len);
+std::string EncodeBase58(const std::vector<unsigned char>& data);
+bool DecodeBase58(const std::string& str, std::vector<unsigned char>& out);
+
+/** Base58 with a 4-byte double-SHA256 checksum appended. */
+std::string EncodeBase58Check(const std::vector<unsigned char>& data);
+bool DecodeBase58Check(const std::string& str, std::vector<unsigned char>& out);
+
+/** Fixed-size path for 25-byte payloads (version + hash160 + checksum), the
+ *  shape of every legacy address. Runs in constant time over fixed limbs. */
+static const size_t BASE58_ADDRESS_PAYLOAD = 25;
+std::string EncodeBase58Address(const unsigned char payload[BASE58_ADDRESS_PAYLOAD]);
+bool DecodeBase58Address(const std::string& str, unsigned char payload[BASE58_ADDRESS_PAYLOAD]);
+
+namespace bech32 {
+
+enum Encoding {
+    INVALID,
+    BECH32,  //!< BIP173
+    BECH32M, //!< BIP350
+};
+
+/** Encodes 5-bit values with a human-readable part. hrp must be lowercase. */
+std::string Encode(Encoding encoding, const std::string& hrp, const std::vector<uint8_t>& values);
+
+struct DecodeResult {
+    Encoding encoding;
+    std::string hrp;
+    std::vector<uint8_t> data;
+
+    DecodeResult() : encoding(INVALID) {}
+};
+
+DecodeResult Decode(const std::string& str);
+
+/** Regroups bits, e.g. 8-bit bytes into 5-bit values and back. */
+bool ConvertBits(int frombits, int tobits, bool pad, const std::vector<uint8_t>& in, std::vector<uint8_t>& out);
+
+/** Witness address: version 0 uses Bech32, later versions Bech32m. */
+std::string EncodeAddress(const std::string& hrp, int witver, const std::vector<uint8_t>& program);
+bool DecodeAddress(const std::string& hrp, const std::string& addr, int& witver, std::vector<uint8_t>& program);
+
+} // namespace bech32
+
+#endif // ONECOIN_ENCODING_H
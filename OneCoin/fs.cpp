@@ -0,0 +1,159 @@
+#include "fs.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool CreateDirectories(const std::string& path)
+{
+    if (path.empty())
+        return false;
+    for (size_t pos = 1; pos <= path.size(); pos++) {
+        if (pos != path.size() && path[pos] != '/')
+            continue;
+        std::string prefix = path.substr(0, pos);
+        if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST)
+            return false;
+    }
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+bool FileExists(const std::string& path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+}
+
+int64_t FileSize(const std::string& path)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return -1;
+    return (int64_t)st.st_size;
+}
+
+bool RemoveFile(const std::string& path)
+{
+    return unlink(path.c_str()) == 0 || errno == ENOENT;
+}
+
+bool RemoveAll(const std::string& path)
+{
+    struct stat st;
+    if (lstat(path.c_str(), &st) != 0)
+        return errno == ENOENT;
+    if (!S_ISDIR(st.st_mode))
+        return unlink(path.c_str()) == 0;
+    DIR* dir = opendir(path.c_str());
+    if (!dir)
+        return false;
+    bool ok = true;
+    while (struct dirent* entry = readdir(dir)) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+        ok &= RemoveAll(path + "/" + entry->d_name);
+    }
+    closedir(dir);
+    return ok && rmdir(path.c_str()) == 0;
+}
+
+bool ReplaceFile(const std::string& path, const std::vector<unsigned char>& data)
+{
+    std::string tmpPath = path + ".new";
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t n = write(fd, data.data() + done, data.size() - done);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR)
+                continue;
+            break;
+        }
+        done += n;
+    }
+    bool ok = done == data.size() && fdatasync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool ReadFile(const std::string& path, std::vector<unsigned char>& out)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    out.resize(st.st_size);
+    size_t done = 0;
+    while (done < out.size()) {
+        ssize_t n = read(fd, out.data() + done, out.size() - done);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR)
+                continue;
+            close(fd);
+            return false;
+        }
+        done += n;
+    }
+    close(fd);
+    return true;
+}
+
+bool ListDirectory(const std::string& path, std::vector<std::string>& names)
+{
+    names.clear();
+    DIR* dir = opendir(path.c_str());
+    if (!dir)
+        return false;
+    while (struct dirent* entry = readdir(dir)) {
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+            names.push_back(entry->d_name);
+    }
+    closedir(dir);
+    return true;
+}
+
+bool MappedFile::Open(const std::string& path)
+{
+    Close();
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0;
+    if (ok && st.st_size > 0) {
+        void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ok = p != MAP_FAILED;
+        if (ok) {
+            data = (unsigned char*)p;
+            size = st.st_size;
+            // Records are read front to back, then again in chain order.
+            madvise(p, size, MADV_WILLNEED);
+        }
+    }
+    close(fd);
+    return ok;
+}
+
+void MappedFile::Close()
+{
+    if (data)
+        munmap(data, size);
+    data = NULL;
+    size = 0;
+}
@@ -0,0 +1,47 @@
+#ifndef ONECOIN_FS_H
+#define ONECOIN_FS_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/** Thin POSIX filesystem helpers; C++11 has no <filesystem>. */
+
+/** Creates path and any missing parents. True if it exists afterwards. */
+bool CreateDirectories(const std::string& path);
+bool FileExists(const std::string& path);
+/** Size in bytes, or -1 when the file cannot be examined. */
+int64_t FileSize(const std::string& path);
+bool RemoveFile(const std::string& path);
+/** Removes path and everything below it. */
+bool RemoveAll(const std::string& path);
+/** Reads a whole file. False on any error. */
+bool ReadFile(const std::string& path, std::vector<unsigned char>& out);
+/** Writes data to a temporary file, syncs it and renames it over path, so
+ *  a crash leaves either the old contents or the new. */
+bool ReplaceFile(const std::string& path, const std::vector<unsigned char>& data);
+/** Names of the entries in a directory, without "." and "..". */
+bool ListDirectory(const std::string& path, std::vector<std::string>& names);
+
+/** A whole file mapped read-only into memory; an empty file maps to no
+ *  data. The mapping stays valid until Close() or destruction. */
+class MappedFile {
+public:
+    MappedFile() : data(NULL), size(0) {}
+    ~MappedFile() { Close(); }
+
+    bool Open(const std::string& path);
+    void Close();
+
+    const unsigned char* Data() const { return data; }
+    size_t Size() const { return size; }
+
+private:
+    unsigned char* data;
+    size_t size;
+
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+};
+
+#endif // ONECOIN_FS_H
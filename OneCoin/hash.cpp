@@ -0,0 +1,338 @@
+#define OPENSSL_SUPPRESS_DEPRECATED
+#include "hash.h"
+#include "serialize.h"
+
+#include <string.h>
+#include <openssl/ripemd.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+inline uint32_t Rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+inline uint64_t Rotl64(uint64_t x, int n) { return (x << n) | (x >> (64 - n)); }
+
+inline void SipRound(uint64_t& v0, uint64_t& v1, uint64_t& v2, uint64_t& v3)
+{
+    v0 += v1; v1 = Rotl64(v1, 13); v1 ^= v0; v0 = Rotl64(v0, 32);
+    v2 += v3; v3 = Rotl64(v3, 16); v3 ^= v2;
+    v0 += v3; v3 = Rotl64(v3, 21); v3 ^= v0;
+    v2 += v1; v1 = Rotl64(v1, 17); v1 ^= v2; v2 = Rotl64(v2, 32);
+}
+
+/** The last SipHash word: the trailing bytes and the length in the top byte. */
+inline uint64_t SipLastWord(const unsigned char* data, size_t len)
+{
+    uint64_t b = (uint64_t)len << 56;
+    size_t nWords = len / 8;
+    for (size_t i = 0; i < len % 8; i++)
+        b |= (uint64_t)data[nWords * 8 + i] << (8 * i);
+    return b;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define ONECOIN_SIPHASH_AVX2
+
+template <int N>
+__attribute__((target("avx2"))) inline __m256i Rotl64x4(__m256i x)
+{
+    return _mm256_or_si256(_mm256_slli_epi64(x, N), _mm256_srli_epi64(x, 64 - N));
+}
+
+/** Rotation by 32 swaps the halves of each lane. */
+__attribute__((target("avx2"))) inline __m256i Rotl64x4By32(__m256i x)
+{
+    return _mm256_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+__attribute__((target("avx2"))) inline void SipRound4(__m256i& v0, __m256i& v1, __m256i& v2, __m256i& v3)
+{
+    v0 = _mm256_add_epi64(v0, v1); v1 = Rotl64x4<13>(v1); v1 = _mm256_xor_si256(v1, v0); v0 = Rotl64x4By32(v0);
+    v2 = _mm256_add_epi64(v2, v3); v3 = Rotl64x4<16>(v3); v3 = _mm256_xor_si256(v3, v2);
+    v0 = _mm256_add_epi64(v0, v3); v3 = Rotl64x4<21>(v3); v3 = _mm256_xor_si256(v3, v0);
+    v2 = _mm256_add_epi64(v2, v1); v1 = Rotl64x4<17>(v1); v1 = _mm256_xor_si256(v1, v2); v2 = Rotl64x4By32(v2);
+}
+
+/** Four SipHash-2-4 runs over items of the same length in words, one per
+ *  64-bit lane of AVX2 registers. */
+__attribute__((target("avx2"))) void SipHash4(uint64_t k0, uint64_t k1,
+    const std::vector<unsigned char>* const items[4], uint64_t* const out[4])
+{
+    __m256i v0 = _mm256_set1_epi64x(k0 ^ 0x736f6d6570736575ULL);
+    __m256i v1 = _mm256_set1_epi64x(k1 ^ 0x646f72616e646f6dULL);
+    __m256i v2 = _mm256_set1_epi64x(k0 ^ 0x6c7967656e657261ULL);
+    __m256i v3 = _mm256_set1_epi64x(k1 ^ 0x7465646279746573ULL);
+    const unsigned char* p0 = items[0]->data();
+    const unsigned char* p1 = items[1]->data();
+    const unsigned char* p2 = items[2]->data();
+    const unsigned char* p3 = items[3]->data();
+    size_t nWords = items[0]->size() / 8;
+    for (size_t i = 0; i < nWords; i++) {
+        __m256i m = _mm256_set_epi64x(ReadLE64(p3 + 8 * i), ReadLE64(p2 + 8 * i), ReadLE64(p1 + 8 * i),
+            ReadLE64(p0 + 8 * i));
+        v3 = _mm256_xor_si256(v3, m);
+        SipRound4(v0, v1, v2, v3);
+        SipRound4(v0, v1, v2, v3);
+        v0 = _mm256_xor_si256(v0, m);
+    }
+    __m256i b = _mm256_set_epi64x(SipLastWord(p3, items[3]->size()), SipLastWord(p2, items[2]->size()),
+        SipLastWord(p1, items[1]->size()), SipLastWord(p0, items[0]->size()));
+    v3 = _mm256_xor_si256(v3, b);
+    SipRound4(v0, v1, v2, v3);
+    SipRound4(v0, v1, v2, v3);
+    v0 = _mm256_xor_si256(v0, b);
+    v2 = _mm256_xor_si256(v2, _mm256_set1_epi64x(0xff));
+    for (int r = 0; r < 4; r++)
+        SipRound4(v0, v1, v2, v3);
+    uint64_t result[4];
+    _mm256_storeu_si256((__m256i*)result, _mm256_xor_si256(_mm256_xor_si256(v0, v1), _mm256_xor_si256(v2, v3)));
+    for (int l = 0; l < 4; l++)
+        *out[l] = result[l];
+}
+
+bool HaveAvx2()
+{
+    static const bool fAvx2 = __builtin_cpu_supports("avx2");
+    return fAvx2;
+}
+#endif
+
+inline uint32_t ReadBE32(const unsigned char* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+inline void WriteBE32(unsigned char* p, uint32_t x)
+{
+    p[0] = x >> 24;
+    p[1] = x >> 16;
+    p[2] = x >> 8;
+    p[3] = x;
+}
+
+inline void WriteBE64(unsigned char* p, uint64_t x)
+{
+    WriteBE32(p, (uint32_t)(x >> 32));
+    WriteBE32(p + 4, (uint32_t)x);
+}
+
+void InitState(uint32_t s[8])
+{
+    s[0] = 0x6a09e667;
+    s[1] = 0xbb67ae85;
+    s[2] = 0x3c6ef372;
+    s[3] = 0xa54ff53a;
+    s[4] = 0x510e527f;
+    s[5] = 0x9b05688c;
+    s[6] = 0x1f83d9ab;
+    s[7] = 0x5be0cd19;
+}
+
+} // namespace
+
+void Sha256Transform(uint32_t s[8], const unsigned char block[64])
+{
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++)
+        w[i] = ReadBE32(block + 4 * i);
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = Rotr(w[i - 15], 7) ^ Rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = Rotr(w[i - 2], 17) ^ Rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (Rotr(e, 6) ^ Rotr(e, 11) ^ Rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+        uint32_t t2 = (Rotr(a, 2) ^ Rotr(a, 13) ^ Rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    s[0] += a;
+    s[1] += b;
+    s[2] += c;
+    s[3] += d;
+    s[4] += e;
+    s[5] += f;
+    s[6] += g;
+    s[7] += h;
+}
+
+Sha256::Sha256() : bytes(0)
+{
+    InitState(s);
+}
+
+Sha256& Sha256::Write(const unsigned char* data, size_t len)
+{
+    const unsigned char* end = data + len;
+    size_t bufsize = bytes % 64;
+    if (bufsize && bufsize + len >= 64) {
+        memcpy(buf + bufsize, data, 64 - bufsize);
+        bytes += 64 - bufsize;
+        data += 64 - bufsize;
+        Sha256Transform(s, buf);
+        bufsize = 0;
+    }
+    while (end - data >= 64) {
+        Sha256Transform(s, data);
+        bytes += 64;
+        data += 64;
+    }
+    if (end > data) {
+        memcpy(buf + bufsize, data, end - data);
+        bytes += end - data;
+    }
+    return *this;
+}
+
+void Sha256::Finalize(unsigned char hash[OUTPUT_SIZE])
+{
+    static const unsigned char pad[64] = {0x80};
+    unsigned char sizedesc[8];
+    WriteBE64(sizedesc, bytes << 3);
+    Write(pad, 1 + ((119 - (bytes % 64)) % 64));
+    Write(sizedesc, 8);
+    for (int i = 0; i < 8; i++)
+        WriteBE32(hash + 4 * i, s[i]);
+}
+
+Sha256& Sha256::Reset()
+{
+    bytes = 0;
+    InitState(s);
+    return *this;
+}
+
+void Hash160Writer::Finalize(unsigned char hash[OUTPUT_SIZE])
+{
+    unsigned char tmp[Sha256::OUTPUT_SIZE];
+    sha.Finalize(tmp);
+    Ripemd160(tmp, sizeof(tmp), hash);
+}
+
+void Sha256Hash(const unsigned char* data, size_t len, unsigned char out[32])
+{
+    Sha256().Write(data, len).Finalize(out);
+}
+
+void Sha256d(const unsigned char* data, size_t len, unsigned char out[32])
+{
+    unsigned char tmp[32];
+    Sha256().Write(data, len).Finalize(tmp);
+    Sha256().Write(tmp, 32).Finalize(out);
+}
+
+void Hash160(const unsigned char* data, size_t len, unsigned char out[20])
+{
+    Hash160Writer().Write(data, len).Finalize(out);
+}
+
+void Ripemd160(const unsigned char* data, size_t len, unsigned char out[20])
+{
+    RIPEMD160(data, len, out);
+}
+
+HmacSha256::HmacSha256(const unsigned char* key, size_t keylen)
+{
+    unsigned char rkey[64];
+    if (keylen <= 64) {
+        memcpy(rkey, key, keylen);
+        memset(rkey + keylen, 0, 64 - keylen);
+    } else {
+        Sha256().Write(key, keylen).Finalize(rkey);
+        memset(rkey + 32, 0, 32);
+    }
+    for (int i = 0; i < 64; i++)
+        rkey[i] ^= 0x5c;
+    outer.Write(rkey, 64);
+    for (int i = 0; i < 64; i++)
+        rkey[i] ^= 0x5c ^ 0x36;
+    inner.Write(rkey, 64);
+}
+
+void HmacSha256::Finalize(unsigned char hash[OUTPUT_SIZE])
+{
+    unsigned char temp[32];
+    inner.Finalize(temp);
+    outer.Write(temp, 32).Finalize(hash);
+}
+
+uint64_t SipHash(uint64_t k0, uint64_t k1, const unsigned char* data, size_t len)
+{
+    uint64_t v0 = k0 ^ 0x736f6d6570736575ULL;
+    uint64_t v1 = k1 ^ 0x646f72616e646f6dULL;
+    uint64_t v2 = k0 ^ 0x6c7967656e657261ULL;
+    uint64_t v3 = k1 ^ 0x7465646279746573ULL;
+    for (size_t i = 0; i < len / 8; i++) {
+        uint64_t m = ReadLE64(data + 8 * i);
+        v3 ^= m;
+        SipRound(v0, v1, v2, v3);
+        SipRound(v0, v1, v2, v3);
+        v0 ^= m;
+    }
+    uint64_t b = SipLastWord(data, len);
+    v3 ^= b;
+    SipRound(v0, v1, v2, v3);
+    SipRound(v0, v1, v2, v3);
+    v0 ^= b;
+    v2 ^= 0xff;
+    for (int r = 0; r < 4; r++)
+        SipRound(v0, v1, v2, v3);
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+void SipHashBatch(uint64_t k0, uint64_t k1, const std::vector<std::vector<unsigned char> >& items, uint64_t* out)
+{
+#ifdef ONECOIN_SIPHASH_AVX2
+    if (HaveAvx2()) {
+        // Items wait in a slot for their length in words until four fill
+        // it; a block's scripts mostly share a handful of lengths. Longer
+        // items and those left over at the end are hashed one at a time.
+        static const size_t SLOTS = 16;
+        const std::vector<unsigned char>* pending[SLOTS][4];
+        uint64_t* pendingOut[SLOTS][4];
+        int nPending[SLOTS] = {0};
+        for (size_t i = 0; i < items.size(); i++) {
+            size_t nWords = items[i].size() / 8;
+            if (nWords >= SLOTS) {
+                out[i] = SipHash(k0, k1, items[i].data(), items[i].size());
+                continue;
+            }
+            int& n = nPending[nWords];
+            pending[nWords][n] = &items[i];
+            pendingOut[nWords][n] = &out[i];
+            if (++n == 4) {
+                SipHash4(k0, k1, pending[nWords], pendingOut[nWords]);
+                n = 0;
+            }
+        }
+        for (size_t w = 0; w < SLOTS; w++) {
+            for (int l = 0; l < nPending[w]; l++)
+                *pendingOut[w][l] = SipHash(k0, k1, pending[w][l]->data(), pending[w][l]->size());
+        }
+        return;
+    }
+#endif
+    for (size_t i = 0; i < items.size(); i++)
+        out[i] = SipHash(k0, k1, items[i].data(), items[i].size());
+}
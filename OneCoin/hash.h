@@ -0,0 +1,84 @@
+#ifndef ONECOIN_HASH_H
+#define ONECOIN_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/** Streaming SHA-256. The state can be copied at any 64-byte boundary and
+ *  resumed later, which is what miners and share validators call a midstate. */
+class Sha256 {
+public:
+    static const size_t OUTPUT_SIZE = 32;
+
+    Sha256();
+    Sha256& Write(const unsigned char* data, size_t len);
+    void Finalize(unsigned char hash[OUTPUT_SIZE]);
+    Sha256& Reset();
+
+    /** Number of bytes written so far. */
+    uint64_t Size() const { return bytes; }
+
+private:
+    uint32_t s[8];
+    unsigned char buf[64];
+    uint64_t bytes;
+};
+
+/** Hash160 = RIPEMD-160(SHA-256(x)), used for addresses. */
+class Hash160Writer {
+public:
+    static const size_t OUTPUT_SIZE = 20;
+
+    Hash160Writer& Write(const unsigned char* data, size_t len)
+    {
+        sha.Write(data, len);
+        return *this;
+    }
+    void Finalize(unsigned char hash[OUTPUT_SIZE]);
+
+private:
+    Sha256 sha;
+};
+
+/** HMAC-SHA256 (RFC 2104). */
+class HmacSha256 {
+public:
+    static const size_t OUTPUT_SIZE = 32;
+
+    HmacSha256(const unsigned char* key, size_t keylen);
+    HmacSha256& Write(const unsigned char* data, size_t len)
+    {
+        inner.Write(data, len);
+        return *this;
+    }
+    void Finalize(unsigned char hash[OUTPUT_SIZE]);
+
+private:
+    Sha256 outer;
+    Sha256 inner;
+};
+
+/** Single SHA-256 compression of one 64-byte block into state s. */
+void Sha256Transform(uint32_t s[8], const unsigned char block[64]);
+
+void Sha256Hash(const unsigned char* data, size_t len, unsigned char out[32]);
+void Sha256d(const unsigned char* data, size_t len, unsigned char out[32]);
+void Hash160(const unsigned char* data, size_t len, unsigned char out[20]);
+void Ripemd160(const unsigned char* data, size_t len, unsigned char out[20]);
+
+inline void Sha256d(const std::vector<unsigned char>& v, unsigned char out[32])
+{
+    Sha256d(v.data(), v.size(), out);
+}
+
+/** SipHash-2-4 of data under the 128-bit key (k0, k1). */
+uint64_t SipHash(uint64_t k0, uint64_t k1, const unsigned char* data, size_t len);
+/** SipHash-2-4 of every item under one key, into out[i]. On x86-64 CPUs
+ *  with AVX2, items of the same length in 8-byte words are hashed four at a
+ *  time, one per 64-bit vector lane; on short items such as output scripts
+ *  that is about twice the throughput of SipHash() in a loop. */
+void SipHashBatch(uint64_t k0, uint64_t k1, const std::vector<std::vector<unsigned char> >& items, uint64_t* out);
+
+#endif // ONECOIN_HASH_H
@@ -0,0 +1,56 @@
+#include "headersync.h"
+#include "pow.h"
+
+HeaderSyncValidator::HeaderSyncValidator(const ConsensusParams& params, const HeaderSyncTip& tip)
+    : params(params), tip(tip), cachedBits(tip.nBits), cachedProof(GetBlockProof(tip.nBits))
+{
+}
+
+HeaderSyncValidator::Result HeaderSyncValidator::Process(const BlockHeader& header)
+{
+    if (header.hashPrevBlock != tip.hash)
+        return HEADER_BAD_PREVBLK;
+
+    int nHeight = tip.nHeight + 1;
+    int64_t interval = params.DifficultyAdjustmentInterval();
+    bool fRetarget = nHeight % interval == 0;
+    uint32_t nExpectedBits = tip.nBits;
+    if (fRetarget)
+        nExpectedBits = CalculateNextWorkRequired(tip.nBits, tip.nPeriodStartTime, tip.nTime, params);
+    if (header.nBits != nExpectedBits)
+        return HEADER_BAD_DIFFBITS;
+
+    uint256 hash = header.GetHash();
+    if (!CheckProofOfWork(hash, header.nBits, params))
+        return HEADER_HIGH_HASH;
+
+    if (header.nBits != cachedBits) {
+        cachedBits = header.nBits;
+        cachedProof = GetBlockProof(header.nBits);
+    }
+    tip.hash = hash;
+    tip.nHeight = nHeight;
+    tip.nBits = header.nBits;
+    tip.nTime = header.GetBlockTime();
+    if (fRetarget)
+        tip.nPeriodStartTime = tip.nTime;
+    tip.nChainWork += cachedProof;
+    return HEADER_OK;
+}
+
+HeaderSyncValidator::Result HeaderSyncValidator::ProcessRaw(const unsigned char* data, size_t count, size_t* processed)
+{
+    BlockHeader header;
+    for (size_t i = 0; i < count; i++) {
+        header.Deserialize(data + i * BlockHeader::SIZE);
+        Result result = Process(header);
+        if (result != HEADER_OK) {
+            if (processed)
+                *processed = i;
+            return result;
+        }
+    }
+    if (processed)
+        *processed = count;
+    return HEADER_OK;
+}
@@ -0,0 +1,58 @@
+#ifndef ONECOIN_HEADERSYNC_H
+#define ONECOIN_HEADERSYNC_H
+
+#include "arith_uint256.h"
+#include "block.h"
+#include "consensus.h"
+#include "uint256.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Contextual state needed to check the next header on a chain. */
+struct HeaderSyncTip {
+    uint256 hash;
+    int nHeight;
+    uint32_t nBits;
+    int64_t nTime;
+    /** Time of the header that opened the current retarget period. */
+    int64_t nPeriodStartTime;
+    arith_uint256 nChainWork;
+};
+
+/**
+ * Checks runs of headers received from a peer before any of them are stored:
+ * linkage to the previous header, the expected nBits (including retargets)
+ * and proof of work, while accumulating chainwork. Everything is held in
+ * fixed-size values, so validating a header never allocates.
+ */
+class HeaderSyncValidator {
+public:
+    enum Result {
+        HEADER_OK,
+        HEADER_BAD_PREVBLK,
+        HEADER_BAD_DIFFBITS,
+        HEADER_HIGH_HASH,
+    };
+
+    HeaderSyncValidator(const ConsensusParams& params, const HeaderSyncTip& tip);
+
+    /** Checks header against the current tip and advances on success. */
+    Result Process(const BlockHeader& header);
+
+    /** Processes count consecutive 80-byte serialized headers straight out of
+     *  a message buffer. On failure *processed is the index of the bad one. */
+    Result ProcessRaw(const unsigned char* data, size_t count, size_t* processed);
+
+    const HeaderSyncTip& Tip() const { return tip; }
+
+private:
+    const ConsensusParams& params;
+    HeaderSyncTip tip;
+
+    /** Proof for the last nBits seen; it only changes at retargets. */
+    uint32_t cachedBits;
+    arith_uint256 cachedProof;
+};
+
+#endif // ONECOIN_HEADERSYNC_H
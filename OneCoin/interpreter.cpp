@@ -0,0 +1,843 @@
+#define OPENSSL_SUPPRESS_DEPRECATED
+#include "interpreter.h"
+#include "hash.h"
+#include "key.h"
+#include "sighash.h"
+
+#include <string.h>
+#include <algorithm>
+#include <openssl/sha.h>
+
+const char* ScriptErrorString(ScriptError error)
+{
+    switch (error) {
+    case SCRIPT_ERR_OK: return "No error";
+    case SCRIPT_ERR_UNKNOWN_ERROR: return "unknown error";
+    case SCRIPT_ERR_EVAL_FALSE: return "Script evaluated without error but finished with a false/empty top stack element";
+    case SCRIPT_ERR_OP_RETURN: return "OP_RETURN was encountered";
+    case SCRIPT_ERR_SCRIPT_SIZE: return "Script is too big";
+    case SCRIPT_ERR_PUSH_SIZE: return "Push value size limit exceeded";
+    case SCRIPT_ERR_OP_COUNT: return "Operation limit exceeded";
+    case SCRIPT_ERR_STACK_SIZE: return "Stack size limit exceeded";
+    case SCRIPT_ERR_SIG_COUNT: return "Signature count negative or greater than pubkey count";
+    case SCRIPT_ERR_PUBKEY_COUNT: return "Pubkey count negative or limit exceeded";
+    case SCRIPT_ERR_NUM_OVERFLOW: return "Script number overflow";
+    case SCRIPT_ERR_VERIFY: return "Script failed an OP_VERIFY operation";
+    case SCRIPT_ERR_EQUALVERIFY: return "Script failed an OP_EQUALVERIFY operation";
+    case SCRIPT_ERR_CHECKMULTISIGVERIFY: return "Script failed an OP_CHECKMULTISIGVERIFY operation";
+    case SCRIPT_ERR_CHECKSIGVERIFY: return "Script failed an OP_CHECKSIGVERIFY operation";
+    case SCRIPT_ERR_NUMEQUALVERIFY: return "Script failed an OP_NUMEQUALVERIFY operation";
+    case SCRIPT_ERR_BAD_OPCODE: return "Opcode missing or not understood";
+    case SCRIPT_ERR_DISABLED_OPCODE: return "Attempted to use a disabled opcode";
+    case SCRIPT_ERR_INVALID_STACK_OPERATION: return "Operation not valid with the current stack size";
+    case SCRIPT_ERR_INVALID_ALTSTACK_OPERATION: return "Operation not valid with the current altstack size";
+    case SCRIPT_ERR_UNBALANCED_CONDITIONAL: return "Invalid OP_IF construction";
+    case SCRIPT_ERR_SIG_PUSHONLY: return "Only push operators allowed in signatures";
+    }
+    return "unknown error";
+}
+
+DecodedScript::DecodedScript(const Script& script)
+    : script(script), fComplete(true), fPushOnly(true), fDataPushOnly(true)
+{
+    // Most scripts are a handful of operations; one allocation covers them.
+    ops.reserve(std::min<size_t>(script.size(), 32));
+    const unsigned char* begin = script.data();
+    const unsigned char* end = begin + script.size();
+    const unsigned char* pc = begin;
+    while (pc < end) {
+        ScriptOp op;
+        op.nPos = (uint32_t)(pc - begin);
+        unsigned int opcode = *pc++;
+        size_t nSize = 0;
+        if (opcode <= OP_PUSHDATA4) {
+            size_t nLenBytes = opcode < OP_PUSHDATA1 ? 0 : opcode == OP_PUSHDATA1 ? 1 : opcode == OP_PUSHDATA2 ? 2 : 4;
+            if ((size_t)(end - pc) < nLenBytes) {
+                fComplete = false;
+                break;
+            }
+            nSize = nLenBytes == 0 ? opcode : nLenBytes == 1 ? *pc : nLenBytes == 2 ? ReadLE16(pc) : ReadLE32(pc);
+            pc += nLenBytes;
+            if ((size_t)(end - pc) < nSize) {
+                fComplete = false;
+                break;
+            }
+            if (nSize > MAX_SCRIPT_ELEMENT_SIZE)
+                fDataPushOnly = false;
+        } else {
+            fDataPushOnly = false;
+            if (opcode > OP_16)
+                fPushOnly = false;
+        }
+        op.nData = (uint32_t)(pc - begin);
+        op.nSize = (uint32_t)nSize;
+        op.opcode = (opcodetype)opcode;
+        ops.push_back(op);
+        pc += nSize;
+    }
+}
+
+ScriptTemplate DecodedScript::GetTemplate(int* nRequired) const
+{
+    if (script.IsPayToPubKeyHash())
+        return TX_PUBKEYHASH;
+    if (script.IsPayToScriptHash())
+        return TX_SCRIPTHASH;
+    // OP_m <pubkey>... OP_n OP_CHECKMULTISIG
+    size_t nOps = ops.size();
+    if (!fComplete || nOps < 4 || ops[nOps - 1].opcode != OP_CHECKMULTISIG)
+        return TX_NONSTANDARD;
+    opcodetype opM = ops[0].opcode, opN = ops[nOps - 2].opcode;
+    if (opM < OP_1 || opM > OP_16 || opN < OP_1 || opN > OP_16)
+        return TX_NONSTANDARD;
+    int m = Script::DecodeOP_N(opM), n = Script::DecodeOP_N(opN);
+    if (m > n || (size_t)n != nOps - 3)
+        return TX_NONSTANDARD;
+    for (size_t i = 1; i <= (size_t)n; i++) {
+        if (ops[i].opcode > OP_PUSHDATA4 || (ops[i].nSize != PubKey::COMPRESSED_SIZE && ops[i].nSize != PubKey::SIZE))
+            return TX_NONSTANDARD;
+    }
+    if (nRequired)
+        *nRequired = m;
+    return TX_MULTISIG;
+}
+
+StackItem& StackItem::operator=(StackItem&& other)
+{
+    if (this == &other)
+        return *this;
+    if (other.heap) {
+        heap = std::move(other.heap);
+        nSize = other.nSize;
+    } else {
+        heap.reset();
+        nSize = other.nSize;
+        memcpy(buf, other.buf, nSize);
+    }
+    other.nSize = 0;
+    return *this;
+}
+
+void StackItem::Assign(const unsigned char* p, size_t len)
+{
+    if (len <= INLINE_SIZE) {
+        // p may point into our own heap buffer.
+        memmove(buf, p, len);
+        heap.reset();
+    } else {
+        std::unique_ptr<unsigned char[]> fresh(new unsigned char[len]);
+        memcpy(fresh.get(), p, len);
+        heap = std::move(fresh);
+    }
+    nSize = (uint32_t)len;
+}
+
+StackItem StackItem::FromNum(int64_t n)
+{
+    StackItem item;
+    if (n == 0)
+        return item;
+    bool neg = n < 0;
+    uint64_t absvalue = neg ? ~(uint64_t)n + 1 : (uint64_t)n;
+    while (absvalue) {
+        item.buf[item.nSize++] = absvalue & 0xff;
+        absvalue >>= 8;
+    }
+    if (item.buf[item.nSize - 1] & 0x80)
+        item.buf[item.nSize++] = neg ? 0x80 : 0;
+    else if (neg)
+        item.buf[item.nSize - 1] |= 0x80;
+    return item;
+}
+
+bool operator==(const StackItem& a, const StackItem& b)
+{
+    return a.nSize == b.nSize && memcmp(a.data(), b.data(), a.nSize) == 0;
+}
+
+bool TransactionSignatureChecker::CheckSig(const StackItem& sig, const StackItem& pubkey, const Script& scriptCode) const
+{
+    if (sig.empty())
+        return false;
+    PubKey key(pubkey.begin(), pubkey.end());
+    if (!key.IsFullyValidSize())
+        return false;
+    int nHashType = sig.data()[sig.size() - 1];
+    uint256 hash = SignatureHash(scriptCode, txTo, nIn, nHashType);
+    return key.Verify(hash, std::vector<unsigned char>(sig.begin(), sig.end() - 1));
+}
+
+namespace {
+
+const size_t MAX_NUM_SIZE = 4;
+
+inline bool SetError(ScriptError* ret, ScriptError error)
+{
+    if (ret)
+        *ret = error;
+    return error == SCRIPT_ERR_OK;
+}
+
+inline bool CastToBool(const StackItem& item)
+{
+    const unsigned char* p = item.data();
+    for (size_t i = 0; i < item.size(); i++) {
+        if (p[i] != 0) {
+            // Negative zero is false.
+            return !(i == item.size() - 1 && p[i] == 0x80);
+        }
+    }
+    return false;
+}
+
+/** Decodes a script number of at most MAX_NUM_SIZE bytes. */
+inline bool GetNum(const StackItem& item, int64_t& n)
+{
+    size_t len = item.size();
+    if (len > MAX_NUM_SIZE)
+        return false;
+    n = 0;
+    if (len == 0)
+        return true;
+    const unsigned char* p = item.data();
+    for (size_t i = 0; i < len; i++)
+        n |= (int64_t)p[i] << (8 * i);
+    if (p[len - 1] & 0x80)
+        n = -(int64_t)(n & ~(0x80LL << (8 * (len - 1))));
+    return true;
+}
+
+inline bool IsDisabled(opcodetype opcode)
+{
+    switch (opcode) {
+    case OP_CAT:
+    case OP_SUBSTR:
+    case OP_LEFT:
+    case OP_RIGHT:
+    case OP_INVERT:
+    case OP_AND:
+    case OP_OR:
+    case OP_XOR:
+    case OP_2MUL:
+    case OP_2DIV:
+    case OP_MUL:
+    case OP_DIV:
+    case OP_MOD:
+    case OP_LSHIFT:
+    case OP_RSHIFT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/** The IF/ELSE nesting, as a depth and the position of the first false
+ *  branch, which is all execution needs to know. */
+class ConditionStack {
+public:
+    bool Empty() const { return nSize == 0; }
+    bool AllTrue() const { return nFirstFalse == NO_FALSE; }
+    void PushBack(bool f)
+    {
+        if (nFirstFalse == NO_FALSE && !f)
+            nFirstFalse = nSize;
+        nSize++;
+    }
+    void PopBack()
+    {
+        nSize--;
+        if (nFirstFalse == nSize)
+            nFirstFalse = NO_FALSE;
+    }
+    void ToggleTop()
+    {
+        if (nFirstFalse == NO_FALSE)
+            nFirstFalse = nSize - 1;
+        else if (nFirstFalse == nSize - 1)
+            nFirstFalse = NO_FALSE;
+    }
+
+private:
+    static const uint32_t NO_FALSE = 0xffffffff;
+    uint32_t nSize = 0;
+    uint32_t nFirstFalse = NO_FALSE;
+};
+
+/** Removes every push of data from script at an operation boundary, as
+ *  signature checks do with the signature they check. */
+void FindAndDelete(Script& script, const StackItem& data)
+{
+    Script pattern;
+    pattern << std::vector<unsigned char>(data.begin(), data.end());
+    Script result;
+    bool fFound = false;
+    Script::const_iterator pc = script.begin(), pc2 = script.begin(), end = script.end();
+    opcodetype opcode;
+    do {
+        result.insert(result.end(), pc2, pc);
+        while ((size_t)(end - pc) >= pattern.size() && std::equal(pattern.begin(), pattern.end(), pc)) {
+            pc += pattern.size();
+            fFound = true;
+        }
+        pc2 = pc;
+    } while (script.GetOp(pc, opcode));
+    if (fFound) {
+        result.insert(result.end(), pc2, end);
+        script.swap(result);
+    }
+}
+
+inline StackItem& Top(ScriptStack& stack, int i)
+{
+    return stack[stack.size() + i];
+}
+
+/** OP_CHECKMULTISIG over the given signatures and keys, which the stack
+ *  holds last-first: both are walked from the end, matching each
+ *  signature to the next key that accepts it. */
+bool CheckMultisig(const StackItem* sigs, int nSigs, const StackItem* keys, int nKeys, const Script& scriptCode,
+    const BaseSignatureChecker& checker)
+{
+    int isig = nSigs - 1, ikey = nKeys - 1;
+    while (nSigs > 0) {
+        if (checker.CheckSig(sigs[isig], keys[ikey], scriptCode)) {
+            isig--;
+            nSigs--;
+        }
+        ikey--;
+        nKeys--;
+        if (nSigs > nKeys)
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool EvalScript(ScriptStack& stack, const DecodedScript& decoded, unsigned int /* flags */,
+    const BaseSignatureChecker& checker, ScriptError* serror)
+{
+    static const unsigned char vchZero = 0;
+    const Script& script = decoded.GetScript();
+    if (script.size() > MAX_SCRIPT_SIZE)
+        return SetError(serror, SCRIPT_ERR_SCRIPT_SIZE);
+
+    ConditionStack vfExec;
+    ScriptStack altstack;
+    size_t nCodeHashBegin = 0;
+    int nOpCount = 0;
+    SetError(serror, SCRIPT_ERR_UNKNOWN_ERROR);
+
+    const std::vector<ScriptOp>& ops = decoded.Ops();
+    for (size_t iop = 0; iop < ops.size(); iop++) {
+        const ScriptOp& op = ops[iop];
+        const opcodetype opcode = op.opcode;
+        const bool fExec = vfExec.AllTrue();
+
+        if (op.nSize > MAX_SCRIPT_ELEMENT_SIZE)
+            return SetError(serror, SCRIPT_ERR_PUSH_SIZE);
+        // Counted whether or not the branch executes.
+        if (opcode > OP_16 && ++nOpCount > MAX_OPS_PER_SCRIPT)
+            return SetError(serror, SCRIPT_ERR_OP_COUNT);
+        if (IsDisabled(opcode))
+            return SetError(serror, SCRIPT_ERR_DISABLED_OPCODE);
+
+        if (fExec && opcode <= OP_PUSHDATA4) {
+            stack.push_back(StackItem(decoded.Data(op), op.nSize));
+        } else if (fExec || (OP_IF <= opcode && opcode <= OP_ENDIF)) {
+            switch (opcode) {
+            case OP_1NEGATE:
+            case OP_1: case OP_2: case OP_3: case OP_4: case OP_5: case OP_6: case OP_7: case OP_8:
+            case OP_9: case OP_10: case OP_11: case OP_12: case OP_13: case OP_14: case OP_15: case OP_16:
+                stack.push_back(StackItem::FromNum((int64_t)opcode - (int64_t)(OP_1 - 1)));
+                break;
+
+            case OP_NOP:
+            case OP_NOP1: case OP_CHECKLOCKTIMEVERIFY: case OP_CHECKSEQUENCEVERIFY: case OP_NOP4: case OP_NOP5:
+            case OP_NOP6: case OP_NOP7: case OP_NOP8: case OP_NOP9: case OP_NOP10:
+                break;
+
+            case OP_IF:
+            case OP_NOTIF: {
+                bool fValue = false;
+                if (fExec) {
+                    if (stack.empty())
+                        return SetError(serror, SCRIPT_ERR_UNBALANCED_CONDITIONAL);
+                    fValue = CastToBool(Top(stack, -1));
+                    if (opcode == OP_NOTIF)
+                        fValue = !fValue;
+                    stack.pop_back();
+                }
+                vfExec.PushBack(fValue);
+                break;
+            }
+            case OP_ELSE:
+                if (vfExec.Empty())
+                    return SetError(serror, SCRIPT_ERR_UNBALANCED_CONDITIONAL);
+                vfExec.ToggleTop();
+                break;
+            case OP_ENDIF:
+                if (vfExec.Empty())
+                    return SetError(serror, SCRIPT_ERR_UNBALANCED_CONDITIONAL);
+                vfExec.PopBack();
+                break;
+
+            case OP_VERIFY:
+                if (stack.empty())
+                    return SetError(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
+                if (!CastToBool(Top(stack, -1)))
+                    return SetError(serror, SCRIPT_ERR_VERIFY);
+                stack.pop_back();
+                break;
+            case OP_RETURN:
+                return SetError(serror, SCRIPT_ERR_OP_RETURN);
+
+            case OP_TOALTSTACK:
+                if (stack.empty())
+                    return SetError(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
+                altstack.push_back(std::move(Top(stack, -1)));
+                stack.pop_back();
+                break;
+            case OP_FROMALTSTACK:
+                if (altstack.empty())
+                    return SetError(serror, SCRIPT_ERR_INVALID_ALTSTACK_OPERATION);
+                stack.push_back(std::move(altstack.back()));
+                altstack.pop_back();
+                break;
+            case OP_2DROP:
+                if (stack.size() < 2)
+                    return SetError(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
+                stack.pop_back();
+                stack.pop_back();
+                break;
+            case OP_2DUP: {
+                if (stack.size() < 2)
+                    return SetError(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
+                StackItem a = Top(stack, -2), b = Top(stack, -1);
+                stack.push_back(std::move(a));
+                stack.push_back(std::move(b));
+                break;
+            }
+            case OP_3DUP: {
+                if (stack.size() < 3)
+                    return SetError(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
+                StackItem a = Top(stack, -3), b = Top(stack, -2), c = Top(stack, -1);
+                stack.push_back(std::move(a));
+                stack.push_back(std::move(b));
+                stack.push_back(std::move(c));
+                break;
+            }
+            case OP_2OVER: {
+                if (stack.size() < 4)
+                    return SetError(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
+                StackItem a = Top(stack, -4), b = Top(stack, -3);
+                stack.push_back(std::move(a));
+                stack.push_back(std::move(b));
+                break;
+            }
+            case OP_2ROT: {
+                if (stack.size() < 6)
+                    return SetError(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
+                StackItem a = std::move(Top(stack, -6)), b = std::move(Top(stack, -5));
+                stack.erase(stack.end() - 6, stack.end() - 4);
+                stack.push_back(std::move(a));
+                stack.push_back(std::move(b));
+                break;
+            }
+            case OP_2SWAP:
+                if (stack.size() < 4)
+                    return SetError(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
+                std::swap(Top(stack, -4), Top(stack, -2));
+                std::swap(Top(stack, -3), Top(stack, -1));
+                break;
+            case OP_IFDUP: {
+                if (stack.empty())
+                    return SetError(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
+                if (CastToBool(Top(stack, -1))) {
+                    StackItem a = Top(stack, -1);
+                    stack.push_back(std::move(a));
+                }
+                break;
+            }
+            case OP_DEPTH:
+                stack.push_back(StackItem::FromNum((int64_t)stack.size()));
+                break;
+            case OP_DROP:
+                if (stack.empty())
+                    return SetError(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
+                stack.pop_back();
+                break;
+            case OP_DUP: {
+                if (stack.empty())
+                    return SetError(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
+                StackItem a = Top(stack, -1);
+                stack.push_back(std::move(a));
+                break;
+            }
+            case OP_NIP:
+                if (stack.size() < 2)
+                    return SetError(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
+                stack.erase(stack.end() - 2);
+                break;
+            case OP_OVER: {
+                if (stack.size() < 2)
+                    return SetError(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
+                StackItem a = Top(stack, -2);
+                stack.push_back(std::move(a));
+                break;
+            }
+            case OP_PICK:
+            case OP_ROLL: {
+                if (stack.size() < 2)
+                    return SetError(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
+                int64_t n;
+                if (!GetNum(Top(stack, -1), n))
+                    return SetError(serror, SCRIPT_ERR_NUM_OVERFLOW);
+                stack.pop_back();
+                if (n < 0 || n >= (int64_t)stack.size())
+                    return SetError(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
+                StackItem a = Top(stack, -(int)n - 1);
+                if (opcode == OP_ROLL)
+                    stack.erase(stack.end() - n - 1);
+                stack.push_back(std::move(a));
+                break;
+            }
+            case OP_ROT:
+                if (stack.size() < 3)
+                    return SetError(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
+                std::swap(Top(stack, -3), Top(stack, -2));
+                std::swap(Top(stack, -2), Top(stack, -1));
+                break;
+            case OP_SWAP:
+                if (stack.size() < 2)
+                    return SetError(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
+                std::swap(Top(stack, -2), Top(stack, -1));
+                break;
+            case OP_TUCK: {
+                if (stack.size() < 2)
+                    return SetError(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
+                StackItem a = Top(stack, -1);
+                stack.insert(stack.end() - 2, std::move(a));
+                break;
+            }
+            case OP_SIZE:
+                if (stack.empty())
+                    return SetError(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
+                stack.push_back(StackItem::FromNum((int64_t)Top(stack, -1).size()));
+                break;
+
+            case OP_EQUAL:
+            case OP_EQUALVERIFY: {
+                if (stack.size() < 2)
+                    return SetError(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
+                bool fEqual = Top(stack, -2) == Top(stack, -1);
+                stack.pop_back();
+                stack.pop_back();
+                stack.push_back(StackItem::FromBool(fEqual));
+                if (opcode == OP_EQUALVERIFY) {
+                    if (!fEqual)
+                        return SetError(serror, SCRIPT_ERR_EQUALVERIFY);
+                    stack.pop_back();
+                }
+                break;
+            }
+
+            case OP_1ADD: case OP_1SUB: case OP_NEGATE: case OP_ABS: case OP_NOT: case OP_0NOTEQUAL: {
+                if (stack.empty())
+                    return SetError(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
+                int64_t n;
+                if (!GetNum(Top(stack, -1), n))
+                    return SetError(serror, SCRIPT_ERR_NUM_OVERFLOW);
+                switch (opcode) {
+                case OP_1ADD: n += 1; break;
+                case OP_1SUB: n -= 1; break;
+                case OP_NEGATE: n = -n; break;
+                case OP_ABS: if (n < 0) n = -n; break;
+                case OP_NOT: n = (n == 0); break;
+                case OP_0NOTEQUAL: n = (n != 0); break;
+                default: break;
+                }
+                Top(stack, -1) = StackItem::FromNum(n);
+                break;
+            }
+            case OP_ADD: case OP_SUB: case OP_BOOLAND: case OP_BOOLOR: case OP_NUMEQUAL: case OP_NUMEQUALVERIFY:
+            case OP_NUMNOTEQUAL: case OP_LESSTHAN: case OP_GREATERTHAN: case OP_LESSTHANOREQUAL:
+            case OP_GREATERTHANOREQUAL: case OP_MIN: case OP_MAX: {
+                if (stack.size() < 2)
+                    return SetError(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
+                int64_t a, b, n = 0;
+                if (!GetNum(Top(stack, -2), a) || !GetNum(Top(stack, -1), b))
+                    return SetError(serror, SCRIPT_ERR_NUM_OVERFLOW);
+                switch (opcode) {
+                case OP_ADD: n = a + b; break;
+                case OP_SUB: n = a - b; break;
+                case OP_BOOLAND: n = a != 0 && b != 0; break;
+                case OP_BOOLOR: n = a != 0 || b != 0; break;
+                case OP_NUMEQUAL: case OP_NUMEQUALVERIFY: n = a == b; break;
+                case OP_NUMNOTEQUAL: n = a != b; break;
+                case OP_LESSTHAN: n = a < b; break;
+                case OP_GREATERTHAN: n = a > b; break;
+                case OP_LESSTHANOREQUAL: n = a <= b; break;
+                case OP_GREATERTHANOREQUAL: n = a >= b; break;
+                case OP_MIN: n = a < b ? a : b; break;
+                case OP_MAX: n = a > b ? a : b; break;
+                default: break;
+                }
+                stack.pop_back();
+                stack.pop_back();
+                stack.push_back(StackItem::FromNum(n));
+                if (opcode == OP_NUMEQUALVERIFY) {
+                    if (!CastToBool(Top(stack, -1)))
+                        return SetError(serror, SCRIPT_ERR_NUMEQUALVERIFY);
+                    stack.pop_back();
+                }
+                break;
+            }
+            case OP_WITHIN: {
+                if (stack.size() < 3)
+                    return SetError(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
+                int64_t x, lo, hi;
+                if (!GetNum(Top(stack, -3), x) || !GetNum(Top(stack, -2), lo) || !GetNum(Top(stack, -1), hi))
+                    return SetError(serror, SCRIPT_ERR_NUM_OVERFLOW);
+                stack.resize(stack.size() - 3);
+                stack.push_back(StackItem::FromBool(lo <= x && x < hi));
+                break;
+            }
+
+            case OP_RIPEMD160: case OP_SHA1: case OP_SHA256: case OP_HASH160: case OP_HASH256: {
+                if (stack.empty())
+                    return SetError(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
+                StackItem& item = Top(stack, -1);
+                unsigned char hash[32];
+                size_t nHashSize = 32;
+                if (opcode == OP_RIPEMD160) {
+                    Ripemd160(item.data(), item.size(), hash);
+                    nHashSize = 20;
+                } else if (opcode == OP_SHA1) {
+                    SHA1(item.size() ? item.data() : &vchZero, item.size(), hash);
+                    nHashSize = 20;
+                } else if (opcode == OP_SHA256) {
+                    Sha256Hash(item.data(), item.size(), hash);
+                } else if (opcode == OP_HASH160) {
+                    Hash160(item.data(), item.size(), hash);
+                    nHashSize = 20;
+                } else {
+                    Sha256d(item.data(), item.size(), hash);
+                }
+                item.Assign(hash, nHashSize);
+                break;
+            }
+            case OP_CODESEPARATOR:
+                nCodeHashBegin = op.nPos + 1;
+                break;
+
+            case OP_CHECKSIG:
+            case OP_CHECKSIGVERIFY: {
+                if (stack.size() < 2)
+                    return SetError(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
+                const StackItem& sig = Top(stack, -2);
+                const StackItem& pubkey = Top(stack, -1);
+                Script scriptCode(script.begin() + nCodeHashBegin, script.end());
+                FindAndDelete(scriptCode, sig);
+                bool fSuccess = checker.CheckSig(sig, pubkey, scriptCode);
+                stack.pop_back();
+                stack.pop_back();
+                stack.push_back(StackItem::FromBool(fSuccess));
+                if (opcode == OP_CHECKSIGVERIFY) {
+                    if (!fSuccess)
+                        return SetError(serror, SCRIPT_ERR_CHECKSIGVERIFY);
+                    stack.pop_back();
+                }
+                break;
+            }
+            case OP_CHECKMULTISIG:
+            case OP_CHECKMULTISIGVERIFY: {
+                // Stack: dummy sig... nSigs key... nKeys
+                int i = 1;
+                if ((int)stack.size() < i)
+                    return SetError(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
+                int64_t nKeys;
+                if (!GetNum(Top(stack, -i), nKeys))
+                    return SetError(serror, SCRIPT_ERR_NUM_OVERFLOW);
+                if (nKeys < 0 || nKeys > MAX_PUBKEYS_PER_MULTISIG)
+                    return SetError(serror, SCRIPT_ERR_PUBKEY_COUNT);
+                nOpCount += (int)nKeys;
+                if (nOpCount > MAX_OPS_PER_SCRIPT)
+                    return SetError(serror, SCRIPT_ERR_OP_COUNT);
+                i += (int)nKeys + 1;
+                if ((int)stack.size() < i)
+                    return SetError(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
+                int64_t nSigs;
+                if (!GetNum(Top(stack, -i), nSigs))
+                    return SetError(serror, SCRIPT_ERR_NUM_OVERFLOW);
+                if (nSigs < 0 || nSigs > nKeys)
+                    return SetError(serror, SCRIPT_ERR_SIG_COUNT);
+                // One more than the arguments: the original client also
+                // pops an unused element below the signatures.
+                i += (int)nSigs + 1;
+                if ((int)stack.size() < i)
+                    return SetError(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
+
+                const StackItem* keys = &stack[stack.size() - 1 - nKeys];
+                const StackItem* sigs = &stack[stack.size() - i + 1];
+                Script scriptCode(script.begin() + nCodeHashBegin, script.end());
+                for (int k = 0; k < nSigs; k++)
+                    FindAndDelete(scriptCode, sigs[k]);
+                bool fSuccess = CheckMultisig(sigs, (int)nSigs, keys, (int)nKeys, scriptCode, checker);
+
+                stack.resize(stack.size() - i);
+                stack.push_back(StackItem::FromBool(fSuccess));
+                if (opcode == OP_CHECKMULTISIGVERIFY) {
+                    if (!fSuccess)
+                        return SetError(serror, SCRIPT_ERR_CHECKMULTISIGVERIFY);
+                    stack.pop_back();
+                }
+                break;
+            }
+
+            default:
+                return SetError(serror, SCRIPT_ERR_BAD_OPCODE);
+            }
+        }
+
+        if (stack.size() + altstack.size() > MAX_STACK_SIZE)
+            return SetError(serror, SCRIPT_ERR_STACK_SIZE);
+    }
+
+    if (!decoded.IsComplete())
+        return SetError(serror, SCRIPT_ERR_BAD_OPCODE);
+    if (!vfExec.Empty())
+        return SetError(serror, SCRIPT_ERR_UNBALANCED_CONDITIONAL);
+    return SetError(serror, SCRIPT_ERR_OK);
+}
+
+bool VerifyScriptGeneric(const Script& scriptSig, const Script& scriptPubKey, unsigned int flags,
+    const BaseSignatureChecker& checker, ScriptError* serror)
+{
+    DecodedScript decodedSig(scriptSig);
+    DecodedScript decodedPubKey(scriptPubKey);
+    ScriptStack stack, stackCopy;
+    stack.reserve(8);
+    if (!EvalScript(stack, decodedSig, flags, checker, serror))
+        return false;
+    bool fP2SH = (flags & SCRIPT_VERIFY_P2SH) && scriptPubKey.IsPayToScriptHash();
+    if (fP2SH)
+        stackCopy = stack;
+    if (!EvalScript(stack, decodedPubKey, flags, checker, serror))
+        return false;
+    if (stack.empty() || !CastToBool(stack.back()))
+        return SetError(serror, SCRIPT_ERR_EVAL_FALSE);
+
+    if (fP2SH) {
+        if (!decodedSig.IsPushOnly())
+            return SetError(serror, SCRIPT_ERR_SIG_PUSHONLY);
+        // scriptPubKey hashed the top element, so it exists.
+        stack.swap(stackCopy);
+        Script redeemScript(stack.back().begin(), stack.back().end());
+        stack.pop_back();
+        if (!EvalScript(stack, DecodedScript(redeemScript), flags, checker, serror))
+            return false;
+        if (stack.empty() || !CastToBool(stack.back()))
+            return SetError(serror, SCRIPT_ERR_EVAL_FALSE);
+    }
+    return SetError(serror, SCRIPT_ERR_OK);
+}
+
+namespace {
+
+/** Multisig spend whose scriptSig pushes exactly the dummy and nRequired
+ *  signatures. Returns false, leaving *pResult alone, when the generic path
+ *  must decide. */
+bool TryMultisig(const DecodedScript& sig, size_t nFirst, size_t nPushes, const DecodedScript& multisig,
+    int nRequired, const BaseSignatureChecker& checker, bool* pResult)
+{
+    if (nPushes != (size_t)nRequired + 1)
+        return false;
+    const std::vector<ScriptOp>& sigOps = sig.Ops();
+    const std::vector<ScriptOp>& keyOps = multisig.Ops();
+    StackItem sigs[16];
+    StackItem keys[16];
+    for (int k = 0; k < nRequired; k++) {
+        const ScriptOp& op = sigOps[nFirst + 1 + k];
+        // A signature the size of a key push could be deleted from the
+        // script code; leave that to FindAndDelete.
+        if (op.nSize == PubKey::COMPRESSED_SIZE || op.nSize == PubKey::SIZE)
+            return false;
+        sigs[k].Assign(sig.Data(op), op.nSize);
+    }
+    int nKeys = (int)keyOps.size() - 3;
+    for (int k = 0; k < nKeys; k++)
+        keys[k].Assign(multisig.Data(keyOps[k + 1]), keyOps[k + 1].nSize);
+    *pResult = CheckMultisig(sigs, nRequired, keys, nKeys, multisig.GetScript(), checker);
+    return true;
+}
+
+} // namespace
+
+bool VerifyScript(const Script& scriptSig, const Script& scriptPubKey, unsigned int flags,
+    const BaseSignatureChecker& checker, ScriptError* serror)
+{
+    if (scriptSig.size() > MAX_SCRIPT_SIZE)
+        return VerifyScriptGeneric(scriptSig, scriptPubKey, flags, checker, serror);
+    DecodedScript decodedSig(scriptSig);
+    if (!decodedSig.IsDataPushOnly())
+        return VerifyScriptGeneric(scriptSig, scriptPubKey, flags, checker, serror);
+    const std::vector<ScriptOp>& pushes = decodedSig.Ops();
+
+    DecodedScript decodedPubKey(scriptPubKey);
+    int nRequired = 0;
+    switch (decodedPubKey.GetTemplate(&nRequired)) {
+    case TX_PUBKEYHASH: {
+        // <sig> <pubkey> | OP_DUP OP_HASH160 <hash> OP_EQUALVERIFY OP_CHECKSIG
+        // A 20-byte signature could match the hash push in FindAndDelete.
+        if (pushes.size() != 2 || pushes[0].nSize == 20)
+            break;
+        StackItem sig(decodedSig.Data(pushes[0]), pushes[0].nSize);
+        StackItem pubkey(decodedSig.Data(pushes[1]), pushes[1].nSize);
+        unsigned char hash[20];
+        Hash160(pubkey.data(), pubkey.size(), hash);
+        if (memcmp(hash, scriptPubKey.data() + 3, 20) != 0)
+            return SetError(serror, SCRIPT_ERR_EQUALVERIFY);
+        if (!checker.CheckSig(sig, pubkey, scriptPubKey))
+            return SetError(serror, SCRIPT_ERR_EVAL_FALSE);
+        return SetError(serror, SCRIPT_ERR_OK);
+    }
+    case TX_SCRIPTHASH: {
+        // <push>... <redeem script> | OP_HASH160 <hash> OP_EQUAL
+        if (!(flags & SCRIPT_VERIFY_P2SH) || pushes.empty())
+            break;
+        const ScriptOp& last = pushes.back();
+        unsigned char hash[20];
+        Hash160(decodedSig.Data(last), last.nSize, hash);
+        if (memcmp(hash, scriptPubKey.data() + 2, 20) != 0)
+            return SetError(serror, SCRIPT_ERR_EVAL_FALSE);
+        Script redeemScript(decodedSig.Data(last), decodedSig.Data(last) + last.nSize);
+        DecodedScript decodedRedeem(redeemScript);
+        int nRedeemRequired = 0;
+        bool fResult;
+        if (decodedRedeem.GetTemplate(&nRedeemRequired) == TX_MULTISIG &&
+            TryMultisig(decodedSig, 0, pushes.size() - 1, decodedRedeem, nRedeemRequired, checker, &fResult)) {
+            return SetError(serror, fResult ? SCRIPT_ERR_OK : SCRIPT_ERR_EVAL_FALSE);
+        }
+        // Any other redeem script runs on the pushes below it.
+        ScriptStack stack;
+        stack.reserve(pushes.size() + 4);
+        for (size_t i = 0; i + 1 < pushes.size(); i++)
+            stack.push_back(StackItem(decodedSig.Data(pushes[i]), pushes[i].nSize));
+        if (!EvalScript(stack, decodedRedeem, flags, checker, serror))
+            return false;
+        if (stack.empty() || !CastToBool(stack.back()))
+            return SetError(serror, SCRIPT_ERR_EVAL_FALSE);
+        return SetError(serror, SCRIPT_ERR_OK);
+    }
+    case TX_MULTISIG: {
+        bool fResult;
+        if (TryMultisig(decodedSig, 0, pushes.size(), decodedPubKey, nRequired, checker, &fResult))
+            return SetError(serror, fResult ? SCRIPT_ERR_OK : SCRIPT_ERR_EVAL_FALSE);
+        break;
+    }
+    case TX_NONSTANDARD:
+        break;
+    }
+    return VerifyScriptGeneric(scriptSig, scriptPubKey, flags, checker, serror);
+}
@@ -0,0 +1,191 @@
+#ifndef ONECOIN_INTERPRETER_H
+#define ONECOIN_INTERPRETER_H
+
+#include "script.h"
+#include "transaction.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+enum ScriptError {
+    SCRIPT_ERR_OK,
+    SCRIPT_ERR_UNKNOWN_ERROR,
+    SCRIPT_ERR_EVAL_FALSE,
+    SCRIPT_ERR_OP_RETURN,
+
+    SCRIPT_ERR_SCRIPT_SIZE,
+    SCRIPT_ERR_PUSH_SIZE,
+    SCRIPT_ERR_OP_COUNT,
+    SCRIPT_ERR_STACK_SIZE,
+    SCRIPT_ERR_SIG_COUNT,
+    SCRIPT_ERR_PUBKEY_COUNT,
+    SCRIPT_ERR_NUM_OVERFLOW,
+
+    SCRIPT_ERR_VERIFY,
+    SCRIPT_ERR_EQUALVERIFY,
+    SCRIPT_ERR_CHECKMULTISIGVERIFY,
+    SCRIPT_ERR_CHECKSIGVERIFY,
+    SCRIPT_ERR_NUMEQUALVERIFY,
+
+    SCRIPT_ERR_BAD_OPCODE,
+    SCRIPT_ERR_DISABLED_OPCODE,
+    SCRIPT_ERR_INVALID_STACK_OPERATION,
+    SCRIPT_ERR_INVALID_ALTSTACK_OPERATION,
+    SCRIPT_ERR_UNBALANCED_CONDITIONAL,
+
+    SCRIPT_ERR_SIG_PUSHONLY,
+};
+
+const char* ScriptErrorString(ScriptError error);
+
+/** Script verification flags. */
+enum {
+    SCRIPT_VERIFY_NONE = 0,
+    /** Evaluate pay-to-script-hash redeem scripts. */
+    SCRIPT_VERIFY_P2SH = (1U << 0),
+};
+
+/** Flags every block is checked with, from the genesis block on. */
+static const unsigned int MANDATORY_SCRIPT_VERIFY_FLAGS = SCRIPT_VERIFY_P2SH;
+
+static const int MAX_OPS_PER_SCRIPT = 201;
+static const int MAX_PUBKEYS_PER_MULTISIG = 20;
+/** Combined size of the main and alt stacks. */
+static const size_t MAX_STACK_SIZE = 1000;
+
+/** One operation of a decoded script. Push data is not copied: nData and
+ *  nSize locate it in the script. */
+struct ScriptOp {
+    uint32_t nPos;
+    uint32_t nData;
+    uint32_t nSize;
+    opcodetype opcode;
+};
+
+/** Output script forms the verifier has fast paths for. */
+enum ScriptTemplate {
+    TX_NONSTANDARD,
+    TX_PUBKEYHASH,
+    TX_SCRIPTHASH,
+    TX_MULTISIG,
+};
+
+/**
+ * A script split into operations once, so execution and the template and
+ * push-only checks walk a flat array instead of re-parsing push lengths.
+ * The script must outlive the decoded form.
+ */
+class DecodedScript {
+public:
+    explicit DecodedScript(const Script& script);
+
+    const Script& GetScript() const { return script; }
+    const std::vector<ScriptOp>& Ops() const { return ops; }
+    const unsigned char* Data(const ScriptOp& op) const { return script.data() + op.nData; }
+
+    /** False when the script ends inside a push; ops stop before it. */
+    bool IsComplete() const { return fComplete; }
+    /** Only push operations (OP_16 and below), as Script::IsPushOnly(). */
+    bool IsPushOnly() const { return fComplete && fPushOnly; }
+    /** Only data pushes (OP_PUSHDATA4 and below), none larger than
+     *  MAX_SCRIPT_ELEMENT_SIZE: the scriptSig shape fast paths accept. */
+    bool IsDataPushOnly() const { return fComplete && fDataPushOnly; }
+
+    /** For TX_MULTISIG, nRequired is m and the pubkeys are ops 1..n. */
+    ScriptTemplate GetTemplate(int* nRequired = NULL) const;
+
+private:
+    const Script& script;
+    std::vector<ScriptOp> ops;
+    bool fComplete;
+    bool fPushOnly;
+    bool fDataPushOnly;
+};
+
+/**
+ * A stack element. Signatures, public keys, hashes and numbers fit in the
+ * inline buffer, so the common scripts run without allocating; larger
+ * pushes such as redeem scripts go to the heap.
+ */
+class StackItem {
+public:
+    static const size_t INLINE_SIZE = 76;
+
+    StackItem() : nSize(0) {}
+    StackItem(const unsigned char* data, size_t len) : nSize(0) { Assign(data, len); }
+    StackItem(const StackItem& other) : nSize(0) { Assign(other.data(), other.size()); }
+    StackItem(StackItem&& other) : nSize(0) { *this = std::move(other); }
+    StackItem& operator=(const StackItem& other)
+    {
+        if (this != &other)
+            Assign(other.data(), other.size());
+        return *this;
+    }
+    StackItem& operator=(StackItem&& other);
+
+    void Assign(const unsigned char* data, size_t len);
+    /** Minimal script number encoding of n. */
+    static StackItem FromNum(int64_t n);
+    static StackItem FromBool(bool f) { return f ? FromNum(1) : StackItem(); }
+
+    const unsigned char* data() const { return heap ? heap.get() : buf; }
+    unsigned char* data() { return heap ? heap.get() : buf; }
+    size_t size() const { return nSize; }
+    bool empty() const { return nSize == 0; }
+    const unsigned char* begin() const { return data(); }
+    const unsigned char* end() const { return data() + nSize; }
+
+    friend bool operator==(const StackItem& a, const StackItem& b);
+
+private:
+    uint32_t nSize;
+    unsigned char buf[INLINE_SIZE];
+    std::unique_ptr<unsigned char[]> heap;
+};
+
+typedef std::vector<StackItem> ScriptStack;
+
+/** Checks signatures on behalf of the interpreter. The base class accepts
+ *  none. */
+class BaseSignatureChecker {
+public:
+    virtual ~BaseSignatureChecker() {}
+    /** sig carries the hash type as its last byte. */
+    virtual bool CheckSig(const StackItem& /* sig */, const StackItem& /* pubkey */,
+        const Script& /* scriptCode */) const
+    {
+        return false;
+    }
+};
+
+/** Checks signatures over input nIn of txTo. */
+class TransactionSignatureChecker : public BaseSignatureChecker {
+public:
+    TransactionSignatureChecker(const Transaction& txTo, unsigned int nIn) : txTo(txTo), nIn(nIn) {}
+    bool CheckSig(const StackItem& sig, const StackItem& pubkey, const Script& scriptCode) const;
+
+private:
+    const Transaction& txTo;
+    unsigned int nIn;
+};
+
+/** Runs script on stack. */
+bool EvalScript(ScriptStack& stack, const DecodedScript& script, unsigned int flags,
+    const BaseSignatureChecker& checker, ScriptError* error = NULL);
+
+/**
+ * Checks that scriptSig satisfies scriptPubKey. P2PKH, P2SH and bare
+ * multisig spends whose scriptSig is plain data pushes take fast paths that
+ * skip the interpreter; they give the same result and error as the generic
+ * path in every case they accept, and hand everything else to it.
+ */
+bool VerifyScript(const Script& scriptSig, const Script& scriptPubKey, unsigned int flags,
+    const BaseSignatureChecker& checker, ScriptError* error = NULL);
+/** VerifyScript without the fast paths: the reference they are tested and
+ *  benchmarked against. */
+bool VerifyScriptGeneric(const Script& scriptSig, const Script& scriptPubKey, unsigned int flags,
+    const BaseSignatureChecker& checker, ScriptError* error = NULL);
+
+#endif // ONECOIN_INTERPRETER_H
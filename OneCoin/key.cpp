@@ -0,0 +1,205 @@
+#define OPENSSL_SUPPRESS_DEPRECATED
+#include "key.h"
+#include "hash.h"
+
+#include <string.h>
+#include <memory>
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+#include <openssl/ecdsa.h>
+#include <openssl/obj_mac.h>
+
+namespace {
+
+struct BnFree {
+    void operator()(BIGNUM* bn) const { BN_clear_free(bn); }
+};
+struct BnCtxFree {
+    void operator()(BN_CTX* ctx) const { BN_CTX_free(ctx); }
+};
+struct EcKeyFree {
+    void operator()(EC_KEY* key) const { EC_KEY_free(key); }
+};
+struct EcPointFree {
+    void operator()(EC_POINT* point) const { EC_POINT_free(point); }
+};
+struct EcdsaSigFree {
+    void operator()(ECDSA_SIG* sig) const { ECDSA_SIG_free(sig); }
+};
+
+typedef std::unique_ptr<BIGNUM, BnFree> BnPtr;
+typedef std::unique_ptr<BN_CTX, BnCtxFree> BnCtxPtr;
+typedef std::unique_ptr<EC_KEY, EcKeyFree> EcKeyPtr;
+typedef std::unique_ptr<EC_POINT, EcPointFree> EcPointPtr;
+typedef std::unique_ptr<ECDSA_SIG, EcdsaSigFree> EcdsaSigPtr;
+
+/** The curve and its order, built once and only read afterwards. */
+struct Secp256k1 {
+    EC_GROUP* group;
+    BIGNUM* order;
+    BIGNUM* halfOrder;
+
+    Secp256k1()
+    {
+        group = EC_GROUP_new_by_curve_name(NID_secp256k1);
+        order = BN_new();
+        halfOrder = BN_new();
+        EC_GROUP_get_order(group, order, NULL);
+        BN_rshift1(halfOrder, order);
+    }
+};
+
+const Secp256k1& Curve()
+{
+    static const Secp256k1 curve;
+    return curve;
+}
+
+/** Private key only: given k^-1 and r, signing needs no public point. */
+EcKeyPtr MakeKey(const unsigned char secret[32])
+{
+    EcKeyPtr key(EC_KEY_new());
+    EC_KEY_set_group(key.get(), Curve().group);
+    BnPtr priv(BN_bin2bn(secret, 32, NULL));
+    if (!EC_KEY_set_private_key(key.get(), priv.get()))
+        return EcKeyPtr();
+    return key;
+}
+
+/** RFC 6979 nonce generation with HMAC-SHA256; qlen equals hlen, so
+ *  bits2int is the identity and candidates are simply retried. */
+class Rfc6979 {
+public:
+    Rfc6979(const unsigned char secret[32], const unsigned char hash[32])
+    {
+        // bits2octets(h1) = h1 mod q, which differs from h1 only for the
+        // rare hashes at or above the order.
+        BnPtr h(BN_bin2bn(hash, 32, NULL));
+        if (BN_cmp(h.get(), Curve().order) >= 0)
+            BN_sub(h.get(), h.get(), Curve().order);
+        unsigned char h1[32];
+        BN_bn2binpad(h.get(), h1, 32);
+
+        memset(v, 0x01, 32);
+        memset(k, 0x00, 32);
+        for (unsigned char round = 0; round < 2; round++) {
+            HmacSha256(k, 32).Write(v, 32).Write(&round, 1).Write(secret, 32).Write(h1, 32).Finalize(k);
+            HmacSha256(k, 32).Write(v, 32).Finalize(v);
+        }
+    }
+
+    void Next(unsigned char out[32])
+    {
+        if (retry) {
+            const unsigned char zero = 0;
+            HmacSha256(k, 32).Write(v, 32).Write(&zero, 1).Finalize(k);
+            HmacSha256(k, 32).Write(v, 32).Finalize(v);
+        }
+        HmacSha256(k, 32).Write(v, 32).Finalize(v);
+        memcpy(out, v, 32);
+        retry = true;
+    }
+
+private:
+    unsigned char v[32];
+    unsigned char k[32];
+    bool retry = false;
+};
+
+} // namespace
+
+void PubKey::GetHash160(unsigned char out[20]) const
+{
+    Hash160(vch.data(), vch.size(), out);
+}
+
+bool PubKey::Verify(const uint256& hash, const std::vector<unsigned char>& sig) const
+{
+    if (!IsFullyValidSize() || sig.empty())
+        return false;
+    EcKeyPtr key(EC_KEY_new());
+    EC_KEY_set_group(key.get(), Curve().group);
+    EcPointPtr point(EC_POINT_new(Curve().group));
+    if (!EC_POINT_oct2point(Curve().group, point.get(), vch.data(), vch.size(), NULL) ||
+        !EC_KEY_set_public_key(key.get(), point.get())) {
+        return false;
+    }
+    const unsigned char* p = sig.data();
+    EcdsaSigPtr s(d2i_ECDSA_SIG(NULL, &p, (long)sig.size()));
+    if (!s)
+        return false;
+    return ECDSA_do_verify(hash.begin(), 32, s.get(), key.get()) == 1;
+}
+
+bool Key::Set(const unsigned char secretIn[32])
+{
+    BnPtr bn(BN_bin2bn(secretIn, 32, NULL));
+    valid = !BN_is_zero(bn.get()) && BN_cmp(bn.get(), Curve().order) < 0;
+    if (valid)
+        memcpy(secret, secretIn, 32);
+    return valid;
+}
+
+PubKey Key::GetPubKey() const
+{
+    if (!valid)
+        return PubKey();
+    BnCtxPtr ctx(BN_CTX_new());
+    BnPtr priv(BN_bin2bn(secret, 32, NULL));
+    EcPointPtr pub(EC_POINT_new(Curve().group));
+    EC_POINT_mul(Curve().group, pub.get(), priv.get(), NULL, NULL, ctx.get());
+    std::vector<unsigned char> out(PubKey::COMPRESSED_SIZE);
+    EC_POINT_point2oct(Curve().group, pub.get(), POINT_CONVERSION_COMPRESSED, out.data(), out.size(), ctx.get());
+    return PubKey(out);
+}
+
+bool Key::Sign(const uint256& hash, std::vector<unsigned char>& sig) const
+{
+    if (!valid)
+        return false;
+    BnCtxPtr ctx(BN_CTX_new());
+    EcKeyPtr key = MakeKey(secret);
+    if (!key)
+        return false;
+
+    Rfc6979 nonces(secret, hash.begin());
+    EcdsaSigPtr s;
+    while (!s) {
+        unsigned char kbytes[32];
+        nonces.Next(kbytes);
+        BnPtr k(BN_bin2bn(kbytes, 32, NULL));
+        if (BN_is_zero(k.get()) || BN_cmp(k.get(), Curve().order) >= 0)
+            continue;
+        // Hand OpenSSL k^-1 and r so it signs with our nonce.
+        EcPointPtr R(EC_POINT_new(Curve().group));
+        BnPtr r(BN_new());
+        BnPtr kinv(BN_new());
+        if (!EC_POINT_mul(Curve().group, R.get(), k.get(), NULL, NULL, ctx.get()) ||
+            !EC_POINT_get_affine_coordinates(Curve().group, R.get(), r.get(), NULL, ctx.get()) ||
+            !BN_nnmod(r.get(), r.get(), Curve().order, ctx.get()) ||
+            !BN_mod_inverse(kinv.get(), k.get(), Curve().order, ctx.get())) {
+            return false;
+        }
+        if (BN_is_zero(r.get()))
+            continue;
+        s.reset(ECDSA_do_sign_ex(hash.begin(), 32, kinv.get(), r.get(), key.get()));
+        if (!s)
+            return false;
+    }
+
+    const BIGNUM* sr;
+    const BIGNUM* ss;
+    ECDSA_SIG_get0(s.get(), &sr, &ss);
+    if (BN_cmp(ss, Curve().halfOrder) > 0) {
+        BIGNUM* low = BN_new();
+        BN_sub(low, Curve().order, ss);
+        ECDSA_SIG_set0(s.get(), BN_dup(sr), low);
+    }
+    int len = i2d_ECDSA_SIG(s.get(), NULL);
+    if (len <= 0)
+        return false;
+    sig.resize(len);
+    unsigned char* p = sig.data();
+    i2d_ECDSA_SIG(s.get(), &p);
+    return true;
+}
@@ -0,0 +1,68 @@
+#ifndef ONECOIN_KEY_H
+#define ONECOIN_KEY_H
+
+#include "uint256.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/** A serialized secp256k1 public key: 33 bytes compressed or 65 bytes
+ *  uncompressed. */
+class PubKey {
+public:
+    static const size_t COMPRESSED_SIZE = 33;
+    static const size_t SIZE = 65;
+
+    PubKey() {}
+    explicit PubKey(const std::vector<unsigned char>& vch) : vch(vch) {}
+    PubKey(const unsigned char* begin, const unsigned char* end) : vch(begin, end) {}
+
+    /** Has the length and prefix byte of a serialized key; says nothing
+     *  about the point being on the curve. */
+    bool IsFullyValidSize() const
+    {
+        return (vch.size() == COMPRESSED_SIZE && (vch[0] == 0x02 || vch[0] == 0x03)) ||
+               (vch.size() == SIZE && vch[0] == 0x04);
+    }
+
+    const std::vector<unsigned char>& Raw() const { return vch; }
+    const unsigned char* begin() const { return vch.data(); }
+    const unsigned char* end() const { return vch.data() + vch.size(); }
+    size_t size() const { return vch.size(); }
+
+    void GetHash160(unsigned char out[20]) const;
+
+    /** Checks a DER-encoded ECDSA signature over hash. */
+    bool Verify(const uint256& hash, const std::vector<unsigned char>& sig) const;
+
+    friend bool operator==(const PubKey& a, const PubKey& b) { return a.vch == b.vch; }
+
+private:
+    std::vector<unsigned char> vch;
+};
+
+/** A secp256k1 private key. Signatures are deterministic (RFC 6979) and use
+ *  the low-S form, so the same key, message and data always produce the
+ *  same bytes. */
+class Key {
+public:
+    Key() : valid(false) {}
+
+    /** False for zero or values not below the group order. */
+    bool Set(const unsigned char secret[32]);
+    bool IsValid() const { return valid; }
+    const unsigned char* begin() const { return secret; }
+
+    /** Compressed public key. */
+    PubKey GetPubKey() const;
+
+    /** DER-encoded signature over hash. */
+    bool Sign(const uint256& hash, std::vector<unsigned char>& sig) const;
+
+private:
+    unsigned char secret[32];
+    bool valid;
+};
+
+#endif // ONECOIN_KEY_H
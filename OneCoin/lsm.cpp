@@ -0,0 +1,1521 @@
+#include "lsm.h"
+#include "batchread.h"
+#include "bloom.h"
+#include "crc32c.h"
+#include "fs.h"
+#include "lz.h"
+#include "serialize.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <set>
+#include <stdexcept>
+
+namespace {
+
+const unsigned char TYPE_DELETION = 0;
+const unsigned char TYPE_VALUE = 1;
+
+const unsigned char BLOCK_RAW = 0;
+const unsigned char BLOCK_LZ = 1;
+/** Compression type and checksum after every block. */
+const size_t BLOCK_TRAILER_SIZE = 5;
+/** Entries between full keys in a data block. */
+const int RESTART_INTERVAL = 16;
+/** Largest block a table may claim to expand to. */
+const uint64_t MAX_BLOCK_SIZE = 64 << 20;
+
+const uint64_t TABLE_MAGIC = 0x4f4e45434f4c534dULL;
+/** Filter handle, index handle and magic. */
+const size_t FOOTER_SIZE = 40;
+const uint32_t MANIFEST_MAGIC = 0x4c534d31;
+/** Log records: length, checksum, batch. */
+const size_t LOG_HEADER_SIZE = 8;
+/** Memtable bookkeeping per entry on top of key and value. */
+const size_t MEM_ENTRY_OVERHEAD = 64;
+/** Batches a group commit may take on behind the first. */
+const size_t MAX_GROUP_BYTES = 1 << 20;
+
+uint32_t Checksum(const unsigned char* data, size_t len) { return Crc32c(data, len); }
+
+uint32_t KeyHash(const std::string& key)
+{
+    return MurmurHash3(0xbc9f1d34, (const unsigned char*)key.data(), key.size());
+}
+
+bool WriteAll(int fd, const unsigned char* buf, size_t len)
+{
+    while (len) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+bool SyncDirectory(const std::string& dir)
+{
+    int fd = open(dir.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+std::runtime_error Corruption(const std::string& path) { return std::runtime_error("corrupt data in " + path); }
+
+struct BlockHandle {
+    uint64_t nOffset;
+    /** Without the trailer. */
+    uint64_t nSize;
+
+    BlockHandle() : nOffset(0), nSize(0) {}
+};
+
+/** Bloom filter over key hashes, LevelDB style: k probes derived from one
+ *  hash by double hashing, k stored in the last byte. */
+void BuildFilter(const std::vector<uint32_t>& hashes, int nBitsPerKey, std::vector<unsigned char>& out)
+{
+    size_t nBits = std::max<size_t>(hashes.size() * nBitsPerKey, 64);
+    size_t nBytes = (nBits + 7) / 8;
+    nBits = nBytes * 8;
+    int k = std::max(1, std::min((int)(nBitsPerKey * 0.69), 30));
+    out.assign(nBytes, 0);
+    out.push_back((unsigned char)k);
+    for (size_t i = 0; i < hashes.size(); i++) {
+        uint32_t h = hashes[i];
+        uint32_t delta = (h >> 17) | (h << 15);
+        for (int j = 0; j < k; j++) {
+            size_t bit = h % nBits;
+            out[bit / 8] |= 1 << (bit % 8);
+            h += delta;
+        }
+    }
+}
+
+bool FilterMayContain(const std::vector<unsigned char>& filter, uint32_t h)
+{
+    if (filter.size() < 2)
+        return true;
+    size_t nBits = (filter.size() - 1) * 8;
+    int k = filter.back();
+    uint32_t delta = (h >> 17) | (h << 15);
+    for (int j = 0; j < k; j++) {
+        size_t bit = h % nBits;
+        if (!(filter[bit / 8] & (1 << (bit % 8))))
+            return false;
+        h += delta;
+    }
+    return true;
+}
+
+/** Reads, checks and expands one block. */
+void ReadBlock(int fd, const std::string& path, const BlockHandle& handle, std::vector<unsigned char>& out)
+{
+    if (handle.nSize > MAX_BLOCK_SIZE)
+        throw Corruption(path);
+    std::vector<unsigned char> buf(handle.nSize + BLOCK_TRAILER_SIZE);
+    if (!PreadAll(fd, buf.data(), buf.size(), handle.nOffset))
+        throw std::runtime_error("cannot read " + path);
+    if (ReadLE32(&buf[handle.nSize + 1]) != Checksum(buf.data(), handle.nSize + 1))
+        throw Corruption(path);
+    unsigned char type = buf[handle.nSize];
+    if (type == BLOCK_RAW) {
+        buf.resize(handle.nSize);
+        out.swap(buf);
+        return;
+    }
+    if (type != BLOCK_LZ)
+        throw Corruption(path);
+    try {
+        ByteReader r(buf.data(), handle.nSize);
+        uint64_t nRawSize = r.ReadVarInt();
+        if (nRawSize > MAX_BLOCK_SIZE || !LzDecompress(r.Position(), r.Remaining(), nRawSize, out))
+            throw Corruption(path);
+    } catch (const SerializeError&) {
+        throw Corruption(path);
+    }
+}
+
+/**
+ * A position in a data block. Entries share a prefix with the key before
+ * them, except at the restart points listed after the entries, which a
+ * seek binary-searches before scanning forward.
+ */
+class BlockCursor {
+public:
+    BlockCursor() : nEntriesEnd(0), nRestarts(0), nNext(0), fValid(false), fDeleted(false) {}
+
+    /** Takes over contents, which must be a whole data block. */
+    void Reset(std::vector<unsigned char>& contents)
+    {
+        data.swap(contents);
+        fValid = false;
+        if (data.size() < 4)
+            throw std::runtime_error("corrupt table block");
+        nRestarts = ReadLE32(&data[data.size() - 4]);
+        if (nRestarts == 0 || nRestarts > (data.size() - 4) / 4)
+            throw std::runtime_error("corrupt table block");
+        nEntriesEnd = data.size() - 4 - 4 * (size_t)nRestarts;
+    }
+
+    bool Valid() const { return fValid; }
+    void SeekToFirst()
+    {
+        nNext = 0;
+        key.clear();
+        ParseNext();
+    }
+    void Seek(const std::string& target)
+    {
+        uint32_t lo = 0, hi = nRestarts - 1;
+        while (lo < hi) {
+            uint32_t mid = (lo + hi + 1) / 2;
+            SeekToRestart(mid);
+            if (fValid && key < target)
+                lo = mid;
+            else
+                hi = mid - 1;
+        }
+        SeekToRestart(lo);
+        while (fValid && key < target)
+            ParseNext();
+    }
+    void Next() { ParseNext(); }
+    const std::string& Key() const { return key; }
+    const std::string& Value() const { return value; }
+    bool IsDeletion() const { return fDeleted; }
+
+private:
+    std::vector<unsigned char> data;
+    size_t nEntriesEnd;
+    uint32_t nRestarts;
+    size_t nNext;
+    bool fValid;
+    std::string key;
+    std::string value;
+    bool fDeleted;
+
+    void SeekToRestart(uint32_t i)
+    {
+        nNext = ReadLE32(&data[nEntriesEnd + 4 * (size_t)i]);
+        key.clear();
+        ParseNext();
+    }
+
+    void ParseNext()
+    {
+        if (nNext >= nEntriesEnd) {
+            fValid = false;
+            return;
+        }
+        try {
+            ByteReader r(&data[nNext], nEntriesEnd - nNext);
+            uint64_t nShared = r.ReadVarInt();
+            uint64_t nUnshared = r.ReadVarInt();
+            uint64_t nValue = r.ReadVarInt();
+            unsigned char type = r.ReadU8();
+            if (nShared > key.size() || type > TYPE_VALUE)
+                throw SerializeError("bad entry");
+            const unsigned char* p = r.Position();
+            r.Skip(nUnshared);
+            r.Skip(nValue);
+            key.resize(nShared);
+            key.append((const char*)p, nUnshared);
+            value.assign((const char*)p + nUnshared, nValue);
+            fDeleted = type == TYPE_DELETION;
+            nNext = r.Position() - data.data();
+            fValid = true;
+        } catch (const SerializeError&) {
+            throw std::runtime_error("corrupt table block");
+        }
+    }
+};
+
+/**
+ * Writes one table: data blocks of sorted entries, a filter block, an
+ * index block with the last key and position of each data block, and a
+ * footer locating the last two.
+ */
+class TableBuilder {
+public:
+    TableBuilder(const std::string& path, const LsmOptions& options)
+        : path(path), options(options), nOffset(0), nCounter(0), nEntries(0)
+    {
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            throw std::runtime_error("cannot create " + path);
+    }
+    ~TableBuilder()
+    {
+        if (fd >= 0)
+            close(fd);
+    }
+
+    /** Keys must come in strictly increasing order. */
+    void Add(const std::string& key, const std::string& value, bool fDeleted)
+    {
+        if (nEntries == 0)
+            smallest = key;
+        size_t nShared = 0;
+        // A block starts at an implicit restart point at offset 0.
+        if (!block.empty() && nCounter == RESTART_INTERVAL) {
+            restarts.push_back((uint32_t)block.size());
+            nCounter = 0;
+        } else if (!block.empty()) {
+            size_t nMax = std::min(lastKey.size(), key.size());
+            while (nShared < nMax && lastKey[nShared] == key[nShared])
+                nShared++;
+        }
+        ByteWriter w(block);
+        w.WriteVarInt(nShared);
+        w.WriteVarInt(key.size() - nShared);
+        w.WriteVarInt(value.size());
+        w.WriteU8(fDeleted ? TYPE_DELETION : TYPE_VALUE);
+        w.WriteBytes((const unsigned char*)key.data() + nShared, key.size() - nShared);
+        w.WriteBytes((const unsigned char*)value.data(), value.size());
+        lastKey = key;
+        nCounter++;
+        nEntries++;
+        hashes.push_back(KeyHash(key));
+        if (block.size() + 4 * restarts.size() >= options.nBlockSize)
+            FlushBlock();
+    }
+
+    /** Writes the filter, index and footer and syncs the file. */
+    void Finish()
+    {
+        FlushBlock();
+        std::vector<unsigned char> filter;
+        BuildFilter(hashes, options.nBloomBitsPerKey, filter);
+        BlockHandle filterHandle = WriteBlock(filter, false);
+        std::vector<unsigned char> index;
+        ByteWriter w(index);
+        for (size_t i = 0; i < indexKeys.size(); i++) {
+            w.WriteVarInt(indexKeys[i].size());
+            w.WriteBytes((const unsigned char*)indexKeys[i].data(), indexKeys[i].size());
+            w.WriteVarInt(indexHandles[i].nOffset);
+            w.WriteVarInt(indexHandles[i].nSize);
+        }
+        BlockHandle indexHandle = WriteBlock(index, false);
+        std::vector<unsigned char> footer;
+        ByteWriter f(footer);
+        f.WriteU64(filterHandle.nOffset);
+        f.WriteU64(filterHandle.nSize);
+        f.WriteU64(indexHandle.nOffset);
+        f.WriteU64(indexHandle.nSize);
+        f.WriteU64(TABLE_MAGIC);
+        Append(footer.data(), footer.size());
+        if (!WriteAll(fd, pending.data(), pending.size()) || fdatasync(fd) != 0)
+            throw std::runtime_error("cannot write " + path);
+        pending.clear();
+        close(fd);
+        fd = -1;
+    }
+
+    /** Bytes written so far, not counting the block being filled. */
+    uint64_t FileSize() const { return nOffset; }
+    size_t NumEntries() const { return nEntries; }
+    const std::string& Smallest() const { return smallest; }
+    const std::string& Largest() const { return lastKey; }
+
+private:
+    const std::string path;
+    const LsmOptions& options;
+    int fd;
+    /** Bytes appended to the file, including those still in pending. */
+    uint64_t nOffset;
+    std::vector<unsigned char> pending;
+    std::vector<unsigned char> block;
+    std::vector<uint32_t> restarts;
+    int nCounter;
+    size_t nEntries;
+    std::string smallest;
+    std::string lastKey;
+    std::vector<uint32_t> hashes;
+    std::vector<std::string> indexKeys;
+    std::vector<BlockHandle> indexHandles;
+
+    void FlushBlock()
+    {
+        if (block.empty())
+            return;
+        ByteWriter w(block);
+        w.WriteU32(0);
+        for (size_t i = 0; i < restarts.size(); i++)
+            w.WriteU32(restarts[i]);
+        w.WriteU32((uint32_t)restarts.size() + 1);
+        indexKeys.push_back(lastKey);
+        indexHandles.push_back(WriteBlock(block, options.fCompress));
+        block.clear();
+        restarts.clear();
+        nCounter = 0;
+    }
+
+    BlockHandle WriteBlock(const std::vector<unsigned char>& raw, bool fCompress)
+    {
+        std::vector<unsigned char> out;
+        unsigned char type = BLOCK_RAW;
+        if (fCompress) {
+            ByteWriter w(out);
+            w.WriteVarInt(raw.size());
+            LzCompress(raw.data(), raw.size(), out);
+            if (out.size() <= raw.size() - raw.size() / 8)
+                type = BLOCK_LZ;
+        }
+        if (type == BLOCK_RAW)
+            out = raw;
+        BlockHandle handle;
+        handle.nOffset = nOffset;
+        handle.nSize = out.size();
+        out.push_back(type);
+        ByteWriter w(out);
+        w.WriteU32(Checksum(out.data(), out.size()));
+        Append(out.data(), out.size());
+        return handle;
+    }
+
+    void Append(const unsigned char* data, size_t len)
+    {
+        pending.insert(pending.end(), data, data + len);
+        nOffset += len;
+        if (pending.size() >= (1 << 16)) {
+            if (!WriteAll(fd, pending.data(), pending.size()))
+                throw std::runtime_error("cannot write " + path);
+            pending.clear();
+        }
+    }
+};
+
+} // namespace
+
+/** One table file with its index and filter in memory. The file is
+ *  removed once the table is obsolete and the last reader lets go. */
+struct LsmTable {
+    uint64_t nNumber;
+    uint64_t nFileSize;
+    std::string path;
+    std::string smallest;
+    std::string largest;
+    int fd;
+    /** Last key of each data block. */
+    std::vector<std::string> indexKeys;
+    std::vector<BlockHandle> indexHandles;
+    std::vector<unsigned char> filter;
+    std::atomic<bool> fObsolete;
+
+    LsmTable() : nNumber(0), nFileSize(0), fd(-1), fObsolete(false) {}
+    ~LsmTable()
+    {
+        if (fd >= 0)
+            close(fd);
+        if (fObsolete)
+            RemoveFile(path);
+    }
+
+    /** Finds key, whose KeyHash() is nHash; fDeleted tells a deletion
+     *  from a value. */
+    bool Get(const std::string& key, uint32_t nHash, std::string& value, bool& fDeleted) const
+    {
+        if (!FilterMayContain(filter, nHash))
+            return false;
+        size_t nBlock = std::lower_bound(indexKeys.begin(), indexKeys.end(), key) - indexKeys.begin();
+        if (nBlock == indexKeys.size())
+            return false;
+        std::vector<unsigned char> contents;
+        ReadBlock(fd, path, indexHandles[nBlock], contents);
+        BlockCursor cursor;
+        cursor.Reset(contents);
+        cursor.Seek(key);
+        if (!cursor.Valid() || cursor.Key() != key)
+            return false;
+        value = cursor.Value();
+        fDeleted = cursor.IsDeletion();
+        return true;
+    }
+};
+
+/** Tables of a level: by file number in level 0, where they may overlap,
+ *  and by key range elsewhere. */
+struct LsmVersion {
+    std::vector<std::shared_ptr<LsmTable> > files[LSM_LEVELS];
+};
+
+class LsmIterator {
+public:
+    virtual ~LsmIterator() {}
+
+    virtual bool Valid() const = 0;
+    virtual void SeekToFirst() = 0;
+    /** Moves to the first entry whose key is not less than target. */
+    virtual void Seek(const std::string& target) = 0;
+    virtual void Next() = 0;
+    virtual const std::string& Key() const = 0;
+    virtual const std::string& Value() const = 0;
+    virtual bool IsDeletion() const = 0;
+};
+
+namespace {
+
+typedef std::shared_ptr<LsmTable> TableRef;
+
+TableRef OpenTable(const std::string& path, uint64_t nNumber, const std::string& smallest, const std::string& largest)
+{
+    TableRef table(new LsmTable);
+    table->nNumber = nNumber;
+    table->path = path;
+    table->smallest = smallest;
+    table->largest = largest;
+    table->fd = open(path.c_str(), O_RDONLY);
+    int64_t nSize = FileSize(path);
+    if (table->fd < 0 || nSize < 0)
+        throw std::runtime_error("cannot open " + path);
+    table->nFileSize = nSize;
+    if (table->nFileSize < FOOTER_SIZE)
+        throw Corruption(path);
+    unsigned char footer[FOOTER_SIZE];
+    if (!PreadAll(table->fd, footer, FOOTER_SIZE, table->nFileSize - FOOTER_SIZE))
+        throw std::runtime_error("cannot read " + path);
+    if (ReadLE64(footer + 32) != TABLE_MAGIC)
+        throw Corruption(path);
+    BlockHandle filterHandle, indexHandle;
+    filterHandle.nOffset = ReadLE64(footer);
+    filterHandle.nSize = ReadLE64(footer + 8);
+    indexHandle.nOffset = ReadLE64(footer + 16);
+    indexHandle.nSize = ReadLE64(footer + 24);
+    ReadBlock(table->fd, path, filterHandle, table->filter);
+    std::vector<unsigned char> index;
+    ReadBlock(table->fd, path, indexHandle, index);
+    try {
+        ByteReader r(index);
+        while (!r.Empty()) {
+            uint64_t nKey = r.ReadVarInt();
+            const unsigned char* p = r.Position();
+            r.Skip(nKey);
+            table->indexKeys.push_back(std::string((const char*)p, nKey));
+            BlockHandle handle;
+            handle.nOffset = r.ReadVarInt();
+            handle.nSize = r.ReadVarInt();
+            table->indexHandles.push_back(handle);
+        }
+    } catch (const SerializeError&) {
+        throw Corruption(path);
+    }
+    return table;
+}
+
+template <typename Map>
+class MemIterator : public LsmIterator {
+public:
+    explicit MemIterator(const std::shared_ptr<Map>& table) : table(table), it(table->end()) {}
+
+    bool Valid() const { return it != table->end(); }
+    void SeekToFirst() { it = table->begin(); }
+    void Seek(const std::string& target) { it = table->lower_bound(target); }
+    void Next() { ++it; }
+    const std::string& Key() const { return it->first; }
+    const std::string& Value() const { return it->second.value; }
+    bool IsDeletion() const { return it->second.fDeleted; }
+
+private:
+    std::shared_ptr<Map> table;
+    typename Map::const_iterator it;
+};
+
+class TableIterator : public LsmIterator {
+public:
+    explicit TableIterator(const TableRef& table) : table(table), nBlock(0) {}
+
+    bool Valid() const { return nBlock < table->indexHandles.size() && cursor.Valid(); }
+    void SeekToFirst()
+    {
+        nBlock = 0;
+        if (LoadBlock())
+            cursor.SeekToFirst();
+        SkipEmptyBlocks();
+    }
+    void Seek(const std::string& target)
+    {
+        nBlock = std::lower_bound(table->indexKeys.begin(), table->indexKeys.end(), target) - table->indexKeys.begin();
+        if (LoadBlock())
+            cursor.Seek(target);
+        SkipEmptyBlocks();
+    }
+    void Next()
+    {
+        cursor.Next();
+        SkipEmptyBlocks();
+    }
+    const std::string& Key() const { return cursor.Key(); }
+    const std::string& Value() const { return cursor.Value(); }
+    bool IsDeletion() const { return cursor.IsDeletion(); }
+
+private:
+    TableRef table;
+    size_t nBlock;
+    BlockCursor cursor;
+
+    bool LoadBlock()
+    {
+        if (nBlock >= table->indexHandles.size())
+            return false;
+        std::vector<unsigned char> contents;
+        ReadBlock(table->fd, table->path, table->indexHandles[nBlock], contents);
+        cursor.Reset(contents);
+        return true;
+    }
+
+    void SkipEmptyBlocks()
+    {
+        while (nBlock < table->indexHandles.size() && !cursor.Valid()) {
+            nBlock++;
+            if (LoadBlock())
+                cursor.SeekToFirst();
+        }
+    }
+};
+
+/** The tables of one level past level 0, one after the other. */
+class LevelIterator : public LsmIterator {
+public:
+    explicit LevelIterator(const std::vector<TableRef>& files) : files(files), nFile(0) {}
+
+    bool Valid() const { return current && current->Valid(); }
+    void SeekToFirst()
+    {
+        nFile = 0;
+        OpenFile();
+        if (current)
+            current->SeekToFirst();
+        SkipEmptyFiles();
+    }
+    void Seek(const std::string& target)
+    {
+        nFile = 0;
+        while (nFile < files.size() && files[nFile]->largest < target)
+            nFile++;
+        OpenFile();
+        if (current)
+            current->Seek(target);
+        SkipEmptyFiles();
+    }
+    void Next()
+    {
+        current->Next();
+        SkipEmptyFiles();
+    }
+    const std::string& Key() const { return current->Key(); }
+    const std::string& Value() const { return current->Value(); }
+    bool IsDeletion() const { return current->IsDeletion(); }
+
+private:
+    std::vector<TableRef> files;
+    size_t nFile;
+    std::unique_ptr<TableIterator> current;
+
+    void OpenFile() { current.reset(nFile < files.size() ? new TableIterator(files[nFile]) : NULL); }
+
+    void SkipEmptyFiles()
+    {
+        while (current && !current->Valid()) {
+            nFile++;
+            OpenFile();
+            if (current)
+                current->SeekToFirst();
+        }
+    }
+};
+
+/** Merges sorted children given newest first. Of entries with the same
+ *  key only the newest is seen. */
+class MergingIterator : public LsmIterator {
+public:
+    explicit MergingIterator(std::vector<std::unique_ptr<LsmIterator> >&& children)
+        : children(std::move(children)), nCurrent(-1)
+    {
+    }
+
+    bool Valid() const { return nCurrent >= 0; }
+    void SeekToFirst()
+    {
+        for (size_t i = 0; i < children.size(); i++)
+            children[i]->SeekToFirst();
+        FindSmallest();
+    }
+    void Seek(const std::string& target)
+    {
+        for (size_t i = 0; i < children.size(); i++)
+            children[i]->Seek(target);
+        FindSmallest();
+    }
+    void Next()
+    {
+        std::string key = Key();
+        for (size_t i = 0; i < children.size(); i++) {
+            if (children[i]->Valid() && children[i]->Key() == key)
+                children[i]->Next();
+        }
+        FindSmallest();
+    }
+    const std::string& Key() const { return children[nCurrent]->Key(); }
+    const std::string& Value() const { return children[nCurrent]->Value(); }
+    bool IsDeletion() const { return children[nCurrent]->IsDeletion(); }
+
+private:
+    std::vector<std::unique_ptr<LsmIterator> > children;
+    int nCurrent;
+
+    void FindSmallest()
+    {
+        nCurrent = -1;
+        for (size_t i = 0; i < children.size(); i++) {
+            if (children[i]->Valid() && (nCurrent < 0 || children[i]->Key() < children[nCurrent]->Key()))
+                nCurrent = (int)i;
+        }
+    }
+};
+
+bool ByNumber(const TableRef& a, const TableRef& b) { return a->nNumber < b->nNumber; }
+bool BySmallest(const TableRef& a, const TableRef& b) { return a->smallest < b->smallest; }
+
+void GetOverlapping(const std::vector<TableRef>& files, const std::string& smallest, const std::string& largest,
+    std::vector<TableRef>& out)
+{
+    for (size_t i = 0; i < files.size(); i++) {
+        if (!(files[i]->largest < smallest || largest < files[i]->smallest))
+            out.push_back(files[i]);
+    }
+}
+
+void GetRange(const std::vector<TableRef>& files, std::string& smallest, std::string& largest)
+{
+    for (size_t i = 0; i < files.size(); i++) {
+        if (i == 0 || files[i]->smallest < smallest)
+            smallest = files[i]->smallest;
+        if (i == 0 || largest < files[i]->largest)
+            largest = files[i]->largest;
+    }
+}
+
+uint64_t TotalBytes(const std::vector<TableRef>& files)
+{
+    uint64_t nBytes = 0;
+    for (size_t i = 0; i < files.size(); i++)
+        nBytes += files[i]->nFileSize;
+    return nBytes;
+}
+
+} // namespace
+
+LsmOptions::LsmOptions()
+    : nMemtableBytes(4 << 20), nBlockSize(4096), nBloomBitsPerKey(10), nL0CompactionTrigger(4),
+      nL0StopWritesTrigger(12), nLevel1Bytes(10 << 20), nTargetFileBytes(2 << 20), nBackgroundThreads(2), fSync(false),
+      fCompress(true)
+{
+}
+
+LsmStats::LsmStats()
+    : nWrites(0), nLogWrites(0), nSyncs(0), nFlushes(0), nCompactions(0), nTrivialMoves(0), nBytesCompacted(0),
+      nStalls(0)
+{
+    for (int i = 0; i < LSM_LEVELS; i++) {
+        nFiles[i] = 0;
+        nBytes[i] = 0;
+    }
+}
+
+void LsmWriteBatch::Put(const std::string& key, const std::string& value)
+{
+    ByteWriter w(rep);
+    w.WriteU8(TYPE_VALUE);
+    w.WriteVarInt(key.size());
+    w.WriteBytes((const unsigned char*)key.data(), key.size());
+    w.WriteVarInt(value.size());
+    w.WriteBytes((const unsigned char*)value.data(), value.size());
+    nCount++;
+}
+
+void LsmWriteBatch::Delete(const std::string& key)
+{
+    ByteWriter w(rep);
+    w.WriteU8(TYPE_DELETION);
+    w.WriteVarInt(key.size());
+    w.WriteBytes((const unsigned char*)key.data(), key.size());
+    nCount++;
+}
+
+void LsmWriteBatch::Clear()
+{
+    rep.clear();
+    nCount = 0;
+}
+
+LsmStore::LsmStore(const std::string& dir, const LsmOptions& options)
+    : dir(dir), options(options), fOpen(false), fStop(false), nMemBytes(0), fFlushing(false), logFd(-1),
+      nLogNumber(0), nImmLogNumber(0), nNextFile(1)
+{
+    for (int i = 0; i < LSM_LEVELS; i++)
+        fLevelBusy[i] = false;
+}
+
+LsmStore::~LsmStore()
+{
+    Close();
+}
+
+std::string LsmStore::FilePath(uint64_t nNumber, const char* ext) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "/%06llu.%s", (unsigned long long)nNumber, ext);
+    return dir + name;
+}
+
+bool LsmStore::Open(std::string& error)
+{
+    Close();
+    if (!CreateDirectories(dir)) {
+        error = "cannot create " + dir;
+        return false;
+    }
+    mem.reset(new MemTable);
+    nMemBytes = 0;
+    imm.reset();
+    current.reset(new LsmVersion);
+    backgroundError.clear();
+    stats = LsmStats();
+    for (int i = 0; i < LSM_LEVELS; i++) {
+        fLevelBusy[i] = false;
+        compactPointer[i].clear();
+    }
+    try {
+        if (!Recover(error))
+            return false;
+    } catch (const std::runtime_error& e) {
+        error = e.what();
+        return false;
+    }
+    fOpen = true;
+    fStop = false;
+    for (unsigned int i = 0; i < std::max(options.nBackgroundThreads, 1U); i++)
+        threads.push_back(std::thread(&LsmStore::BackgroundThread, this));
+    return true;
+}
+
+bool LsmStore::Recover(std::string& error)
+{
+    std::shared_ptr<LsmVersion> version(new LsmVersion);
+    std::set<uint64_t> live;
+    uint64_t nManifestLog = 0;
+    std::string manifestPath = dir + "/MANIFEST";
+    if (FileExists(manifestPath)) {
+        std::vector<unsigned char> data;
+        if (!ReadFile(manifestPath, data)) {
+            error = "cannot read " + manifestPath;
+            return false;
+        }
+        if (data.size() < 8 || ReadLE32(&data[data.size() - 4]) != Checksum(data.data(), data.size() - 4)) {
+            error = "corrupt " + manifestPath;
+            return false;
+        }
+        try {
+            ByteReader r(data.data(), data.size() - 4);
+            if (r.ReadU32() != MANIFEST_MAGIC)
+                throw SerializeError("bad magic");
+            nNextFile = r.ReadVarInt();
+            nManifestLog = r.ReadVarInt();
+            uint64_t nFiles = r.ReadVarInt();
+            for (uint64_t i = 0; i < nFiles; i++) {
+                unsigned int nLevel = r.ReadU8();
+                uint64_t nNumber = r.ReadVarInt();
+                std::vector<unsigned char> smallest, largest;
+                r.ReadVarBytes(smallest);
+                r.ReadVarBytes(largest);
+                if (nLevel >= (unsigned int)LSM_LEVELS)
+                    throw SerializeError("bad level");
+                version->files[nLevel].push_back(OpenTable(FilePath(nNumber, "sst"), nNumber,
+                    std::string(smallest.begin(), smallest.end()), std::string(largest.begin(), largest.end())));
+                live.insert(nNumber);
+            }
+        } catch (const SerializeError&) {
+            error = "corrupt " + manifestPath;
+            return false;
+        }
+        for (int i = 0; i < LSM_LEVELS; i++)
+            std::sort(version->files[i].begin(), version->files[i].end(), i == 0 ? ByNumber : BySmallest);
+    }
+
+    // Files the manifest does not know were being written when the store
+    // stopped, except logs that were still being filled.
+    std::vector<std::string> names;
+    if (!ListDirectory(dir, names)) {
+        error = "cannot list " + dir;
+        return false;
+    }
+    std::vector<uint64_t> logs;
+    for (size_t i = 0; i < names.size(); i++) {
+        char* end;
+        uint64_t nNumber = strtoull(names[i].c_str(), &end, 10);
+        std::string ext = end;
+        if (end == names[i].c_str())
+            continue;
+        nNextFile = std::max(nNextFile, nNumber + 1);
+        if (ext == ".wal" && nNumber >= nManifestLog)
+            logs.push_back(nNumber);
+        else if ((ext == ".sst" && !live.count(nNumber)) || ext == ".wal")
+            RemoveFile(dir + "/" + names[i]);
+    }
+    std::sort(logs.begin(), logs.end());
+    for (size_t i = 0; i < logs.size(); i++) {
+        if (!ReplayLog(FilePath(logs[i], "wal"), error))
+            return false;
+    }
+
+    current = version;
+    NewLog();
+    if (!mem->empty()) {
+        std::vector<TableRef> outputs;
+        MemIterator<const MemTable> it(mem);
+        it.SeekToFirst();
+        WriteTables(it, false, UINT64_MAX, outputs);
+        mem.reset(new MemTable);
+        nMemBytes = 0;
+        InstallVersion(std::vector<TableRef>(), outputs, 0);
+    } else {
+        WriteManifest(*current, nLogNumber);
+    }
+    for (size_t i = 0; i < logs.size(); i++)
+        RemoveFile(FilePath(logs[i], "wal"));
+    return true;
+}
+
+bool LsmStore::ReplayLog(const std::string& path, std::string& error)
+{
+    std::vector<unsigned char> data;
+    if (!ReadFile(path, data)) {
+        error = "cannot read " + path;
+        return false;
+    }
+    // A torn record at the end is a write the store never acknowledged;
+    // a bad one before others is corruption.
+    size_t nPos = 0;
+    while (data.size() - nPos >= LOG_HEADER_SIZE) {
+        uint32_t nLen = ReadLE32(&data[nPos]);
+        if (data.size() - nPos - LOG_HEADER_SIZE < nLen)
+            break;
+        const unsigned char* rep = &data[nPos + LOG_HEADER_SIZE];
+        if (ReadLE32(&data[nPos + 4]) != Checksum(rep, nLen)) {
+            if (data.size() - nPos - LOG_HEADER_SIZE == nLen)
+                break;
+            error = "corrupt record in " + path;
+            return false;
+        }
+        try {
+            ApplyToMemTable(rep, nLen, *mem, nMemBytes);
+        } catch (const SerializeError&) {
+            error = "corrupt record in " + path;
+            return false;
+        }
+        nPos += LOG_HEADER_SIZE + nLen;
+    }
+    return true;
+}
+
+void LsmStore::ApplyToMemTable(const unsigned char* rep, size_t len, MemTable& table, size_t& nBytes) const
+{
+    ByteReader r(rep, len);
+    while (!r.Empty()) {
+        unsigned char type = r.ReadU8();
+        uint64_t nKey = r.ReadVarInt();
+        const unsigned char* p = r.Position();
+        r.Skip(nKey);
+        MemEntry& entry = table[std::string((const char*)p, nKey)];
+        nBytes += nKey + MEM_ENTRY_OVERHEAD;
+        if (type == TYPE_VALUE) {
+            uint64_t nValue = r.ReadVarInt();
+            p = r.Position();
+            r.Skip(nValue);
+            entry.value.assign((const char*)p, nValue);
+            entry.fDeleted = false;
+            nBytes += nValue;
+        } else if (type == TYPE_DELETION) {
+            entry.value.clear();
+            entry.fDeleted = true;
+        } else {
+            throw SerializeError("unknown record type");
+        }
+    }
+}
+
+void LsmStore::NewLog()
+{
+    uint64_t nNumber = nNextFile++;
+    std::string path = FilePath(nNumber, "wal");
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd < 0)
+        throw std::runtime_error("cannot create " + path);
+    if (logFd >= 0) {
+        fdatasync(logFd);
+        close(logFd);
+    }
+    logFd = fd;
+    nLogNumber = nNumber;
+}
+
+void LsmStore::Close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        fStop = true;
+        workCond.notify_all();
+    }
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+    threads.clear();
+    if (logFd >= 0) {
+        fdatasync(logFd);
+        close(logFd);
+        logFd = -1;
+    }
+    current.reset();
+    mem.reset();
+    imm.reset();
+    fOpen = false;
+}
+
+void LsmStore::CheckBackgroundError() const
+{
+    if (!backgroundError.empty())
+        throw std::runtime_error(backgroundError);
+}
+
+bool LsmStore::Get(const std::string& key, std::string& value) const
+{
+    std::shared_ptr<const LsmVersion> version;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!fOpen)
+            throw std::runtime_error(dir + " is not open");
+        const MemTable* tables[2] = {mem.get(), imm.get()};
+        for (int i = 0; i < 2; i++) {
+            if (!tables[i])
+                continue;
+            MemTable::const_iterator it = tables[i]->find(key);
+            if (it != tables[i]->end()) {
+                if (it->second.fDeleted)
+                    return false;
+                value = it->second.value;
+                return true;
+            }
+        }
+        version = current;
+    }
+
+    bool fDeleted;
+    uint32_t nHash = KeyHash(key);
+    const std::vector<TableRef>& level0 = version->files[0];
+    for (size_t i = level0.size(); i-- > 0;) {
+        if (key < level0[i]->smallest || level0[i]->largest < key)
+            continue;
+        if (level0[i]->Get(key, nHash, value, fDeleted))
+            return !fDeleted;
+    }
+    for (int nLevel = 1; nLevel < LSM_LEVELS; nLevel++) {
+        const std::vector<TableRef>& files = version->files[nLevel];
+        size_t lo = 0, hi = files.size();
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (files[mid]->largest < key)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        if (lo == files.size() || key < files[lo]->smallest)
+            continue;
+        if (files[lo]->Get(key, nHash, value, fDeleted))
+            return !fDeleted;
+    }
+    return false;
+}
+
+void LsmStore::Write(const LsmWriteBatch& batch, bool fSync)
+{
+    if (batch.nCount == 0)
+        return;
+    Writer w(&batch, fSync || options.fSync);
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!fOpen)
+        throw std::runtime_error(dir + " is not open");
+    stats.nWrites++;
+    RunWriter(lock, w);
+}
+
+void LsmStore::RunWriter(std::unique_lock<std::mutex>& lock, Writer& w)
+{
+    writers.push_back(&w);
+    while (!w.fDone && writers.front() != &w)
+        w.cond.wait(lock);
+    if (w.fDone) {
+        if (!w.error.empty())
+            throw std::runtime_error(w.error);
+        return;
+    }
+
+    // In front: write the log for the writers queued up to a flush.
+    Writer* last = &w;
+    std::string error;
+    try {
+        MakeRoomForWrite(lock, w.batch == NULL);
+        if (w.batch) {
+            std::vector<unsigned char> record(LOG_HEADER_SIZE);
+            bool fSync = false;
+            for (std::deque<Writer*>::iterator it = writers.begin(); it != writers.end(); ++it) {
+                const LsmWriteBatch* batch = (*it)->batch;
+                if (!batch || (*it != &w && record.size() + batch->rep.size() > MAX_GROUP_BYTES))
+                    break;
+                record.insert(record.end(), batch->rep.begin(), batch->rep.end());
+                fSync |= (*it)->fSync;
+                last = *it;
+            }
+            size_t nLen = record.size() - LOG_HEADER_SIZE;
+            WriteLE32(&record[0], (uint32_t)nLen);
+            WriteLE32(&record[4], Checksum(&record[LOG_HEADER_SIZE], nLen));
+
+            // Only the front writer switches logs, so logFd holds still
+            // while the lock is released for the write and the sync.
+            int fd = logFd;
+            lock.unlock();
+            bool ok = WriteAll(fd, record.data(), record.size()) && (!fSync || fdatasync(fd) == 0);
+            lock.lock();
+            if (!ok) {
+                // Later records would follow a torn one and be lost.
+                backgroundError = "cannot write " + FilePath(nLogNumber, "wal");
+                throw std::runtime_error(backgroundError);
+            }
+            stats.nLogWrites++;
+            if (fSync)
+                stats.nSyncs++;
+            ApplyToMemTable(&record[LOG_HEADER_SIZE], nLen, *mem, nMemBytes);
+        }
+    } catch (const std::exception& e) {
+        error = e.what();
+    }
+
+    while (true) {
+        Writer* p = writers.front();
+        writers.pop_front();
+        if (p != &w) {
+            p->error = error;
+            p->fDone = true;
+            p->cond.notify_one();
+        }
+        if (p == last)
+            break;
+    }
+    if (!writers.empty())
+        writers.front()->cond.notify_one();
+    if (!error.empty())
+        throw std::runtime_error(error);
+}
+
+void LsmStore::Put(const std::string& key, const std::string& value)
+{
+    LsmWriteBatch batch;
+    batch.Put(key, value);
+    Write(batch);
+}
+
+void LsmStore::Delete(const std::string& key)
+{
+    LsmWriteBatch batch;
+    batch.Delete(key);
+    Write(batch);
+}
+
+void LsmStore::MakeRoomForWrite(std::unique_lock<std::mutex>& lock, bool fForce)
+{
+    bool fStalled = false;
+    while (true) {
+        CheckBackgroundError();
+        if (fForce ? mem->empty() : nMemBytes < options.nMemtableBytes)
+            break;
+        if (imm || current->files[0].size() >= (size_t)options.nL0StopWritesTrigger) {
+            if (!fStalled)
+                stats.nStalls++;
+            fStalled = true;
+            doneCond.wait(lock);
+            continue;
+        }
+        // Switch to a fresh memtable and log; a worker writes out the old.
+        nImmLogNumber = nLogNumber;
+        NewLog();
+        imm = mem;
+        mem.reset(new MemTable);
+        nMemBytes = 0;
+        workCond.notify_one();
+        break;
+    }
+}
+
+void LsmStore::Scan(const std::string& start, const std::string& end,
+    const std::function<bool(const std::string& key, const std::string& value)>& fn) const
+{
+    std::vector<std::unique_ptr<LsmIterator> > children;
+    std::shared_ptr<const LsmVersion> version;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!fOpen)
+            throw std::runtime_error(dir + " is not open");
+        // The memtable changes under the lock, so the range is copied out.
+        std::shared_ptr<MemTable> snapshot(new MemTable);
+        MemTable::const_iterator it = mem->lower_bound(start);
+        for (; it != mem->end() && (end.empty() || it->first < end); ++it)
+            snapshot->insert(*it);
+        children.push_back(std::unique_ptr<LsmIterator>(new MemIterator<const MemTable>(snapshot)));
+        if (imm)
+            children.push_back(std::unique_ptr<LsmIterator>(new MemIterator<const MemTable>(imm)));
+        version = current;
+    }
+    for (size_t i = version->files[0].size(); i-- > 0;)
+        children.push_back(std::unique_ptr<LsmIterator>(new TableIterator(version->files[0][i])));
+    for (int nLevel = 1; nLevel < LSM_LEVELS; nLevel++) {
+        if (!version->files[nLevel].empty())
+            children.push_back(std::unique_ptr<LsmIterator>(new LevelIterator(version->files[nLevel])));
+    }
+    MergingIterator it(std::move(children));
+    for (it.Seek(start); it.Valid() && (end.empty() || it.Key() < end); it.Next()) {
+        if (!it.IsDeletion() && !fn(it.Key(), it.Value()))
+            break;
+    }
+}
+
+void LsmStore::Flush()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!fOpen)
+        return;
+    Writer w(NULL, false);
+    RunWriter(lock, w);
+    while (imm && backgroundError.empty())
+        doneCond.wait(lock);
+    CheckBackgroundError();
+}
+
+void LsmStore::WaitForCompactions()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!fOpen)
+        return;
+    while (backgroundError.empty()) {
+        bool fPending = imm != NULL;
+        for (int i = 0; i < LSM_LEVELS && !fPending; i++)
+            fPending = fLevelBusy[i] || (i < LSM_LEVELS - 1 && LevelScore(*current, i) >= 1);
+        if (!fPending)
+            break;
+        doneCond.wait(lock);
+    }
+    CheckBackgroundError();
+}
+
+LsmStats LsmStore::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    LsmStats result = stats;
+    if (current) {
+        for (int i = 0; i < LSM_LEVELS; i++) {
+            result.nFiles[i] = (int)current->files[i].size();
+            result.nBytes[i] = TotalBytes(current->files[i]);
+        }
+    }
+    return result;
+}
+
+double LsmStore::LevelScore(const LsmVersion& version, int nLevel) const
+{
+    if (nLevel == 0)
+        return (double)version.files[0].size() / options.nL0CompactionTrigger;
+    double nMaxBytes = (double)options.nLevel1Bytes;
+    for (int i = 1; i < nLevel; i++)
+        nMaxBytes *= 10;
+    return TotalBytes(version.files[nLevel]) / nMaxBytes;
+}
+
+bool LsmStore::NeedsCompaction() const
+{
+    for (int i = 0; i < LSM_LEVELS - 1; i++) {
+        if (!fLevelBusy[i] && !fLevelBusy[i + 1] && LevelScore(*current, i) >= 1)
+            return true;
+    }
+    return false;
+}
+
+void LsmStore::BackgroundThread()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        workCond.wait(lock, [this] {
+            return fStop || (backgroundError.empty() && ((imm && !fFlushing) || NeedsCompaction()));
+        });
+        if (fStop)
+            return;
+        Compaction c;
+        if (imm && !fFlushing)
+            FlushMemTable(lock);
+        else if (PickCompaction(c))
+            RunCompaction(lock, c);
+    }
+}
+
+void LsmStore::FlushMemTable(std::unique_lock<std::mutex>& lock)
+{
+    fFlushing = true;
+    std::shared_ptr<MemTable> table = imm;
+    lock.unlock();
+
+    std::vector<TableRef> outputs;
+    std::string error;
+    try {
+        MemIterator<const MemTable> it(table);
+        it.SeekToFirst();
+        WriteTables(it, false, UINT64_MAX, outputs);
+    } catch (const std::exception& e) {
+        error = e.what();
+    }
+
+    lock.lock();
+    if (error.empty()) {
+        // The log of imm can go once the manifest no longer needs it.
+        imm.reset();
+        try {
+            InstallVersion(std::vector<TableRef>(), outputs, 0);
+            RemoveFile(FilePath(nImmLogNumber, "wal"));
+            stats.nFlushes++;
+        } catch (const std::exception& e) {
+            imm = table;
+            error = e.what();
+        }
+    }
+    if (!error.empty()) {
+        backgroundError = error;
+        for (size_t i = 0; i < outputs.size(); i++)
+            outputs[i]->fObsolete = true;
+    }
+    fFlushing = false;
+    doneCond.notify_all();
+    workCond.notify_all();
+}
+
+bool LsmStore::PickCompaction(Compaction& c)
+{
+    int nBest = -1;
+    double nBestScore = 1;
+    for (int i = 0; i < LSM_LEVELS - 1; i++) {
+        if (fLevelBusy[i] || fLevelBusy[i + 1])
+            continue;
+        double nScore = LevelScore(*current, i);
+        if (nScore >= nBestScore) {
+            nBest = i;
+            nBestScore = nScore;
+        }
+    }
+    if (nBest < 0)
+        return false;
+
+    c.nLevel = nBest;
+    c.version = current;
+    const std::vector<TableRef>& files = current->files[nBest];
+    if (nBest == 0) {
+        // Level-0 tables overlap, so all of them go at once.
+        c.inputs[0] = files;
+    } else {
+        // Round-robin through the key space of the level.
+        size_t i = 0;
+        while (i < files.size() && !compactPointer[nBest].empty() && files[i]->largest <= compactPointer[nBest])
+            i++;
+        c.inputs[0].push_back(files[i == files.size() ? 0 : i]);
+    }
+    std::string smallest, largest;
+    GetRange(c.inputs[0], smallest, largest);
+    GetOverlapping(current->files[nBest + 1], smallest, largest, c.inputs[1]);
+    compactPointer[nBest] = largest;
+    fLevelBusy[nBest] = true;
+    fLevelBusy[nBest + 1] = true;
+    return true;
+}
+
+void LsmStore::RunCompaction(std::unique_lock<std::mutex>& lock, Compaction& c)
+{
+    int nLevel = c.nLevel;
+    std::vector<TableRef> removed(c.inputs[0]);
+    removed.insert(removed.end(), c.inputs[1].begin(), c.inputs[1].end());
+    std::vector<TableRef> outputs;
+    std::string error;
+
+    if (nLevel > 0 && c.inputs[0].size() == 1 && c.inputs[1].empty()) {
+        // Nothing to merge with: the table moves down as it is.
+        try {
+            InstallVersion(c.inputs[0], c.inputs[0], nLevel + 1);
+            stats.nTrivialMoves++;
+        } catch (const std::exception& e) {
+            backgroundError = e.what();
+        }
+    } else {
+        // Deletions can go when no deeper level may hold an older value.
+        std::string smallest, largest;
+        GetRange(removed, smallest, largest);
+        bool fDropDeletions = true;
+        for (int i = nLevel + 2; i < LSM_LEVELS && fDropDeletions; i++) {
+            std::vector<TableRef> overlap;
+            GetOverlapping(c.version->files[i], smallest, largest, overlap);
+            fDropDeletions = overlap.empty();
+        }
+        lock.unlock();
+
+        try {
+            std::vector<std::unique_ptr<LsmIterator> > children;
+            if (nLevel == 0) {
+                std::vector<TableRef> level0(c.inputs[0]);
+                std::sort(level0.begin(), level0.end(), ByNumber);
+                for (size_t i = level0.size(); i-- > 0;)
+                    children.push_back(std::unique_ptr<LsmIterator>(new TableIterator(level0[i])));
+            } else {
+                children.push_back(std::unique_ptr<LsmIterator>(new LevelIterator(c.inputs[0])));
+            }
+            children.push_back(std::unique_ptr<LsmIterator>(new LevelIterator(c.inputs[1])));
+            MergingIterator it(std::move(children));
+            it.SeekToFirst();
+            WriteTables(it, fDropDeletions, options.nTargetFileBytes, outputs);
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+
+        lock.lock();
+        if (error.empty()) {
+            try {
+                InstallVersion(removed, outputs, nLevel + 1);
+                stats.nCompactions++;
+                stats.nBytesCompacted += TotalBytes(removed);
+            } catch (const std::exception& e) {
+                error = e.what();
+            }
+        }
+        if (!error.empty()) {
+            backgroundError = error;
+            for (size_t i = 0; i < outputs.size(); i++)
+                outputs[i]->fObsolete = true;
+        }
+    }
+    fLevelBusy[nLevel] = false;
+    fLevelBusy[nLevel + 1] = false;
+    doneCond.notify_all();
+    workCond.notify_all();
+}
+
+void LsmStore::WriteTables(LsmIterator& it, bool fDropDeletions, uint64_t nMaxFileBytes,
+    std::vector<TableRef>& outputs)
+{
+    std::unique_ptr<TableBuilder> builder;
+    uint64_t nNumber = 0;
+    auto finish = [&]() {
+        builder->Finish();
+        outputs.push_back(OpenTable(FilePath(nNumber, "sst"), nNumber, builder->Smallest(), builder->Largest()));
+        builder.reset();
+    };
+    try {
+        for (; it.Valid(); it.Next()) {
+            if (fDropDeletions && it.IsDeletion())
+                continue;
+            if (!builder) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    nNumber = nNextFile++;
+                }
+                builder.reset(new TableBuilder(FilePath(nNumber, "sst"), options));
+            }
+            builder->Add(it.Key(), it.Value(), it.IsDeletion());
+            if (builder->FileSize() >= nMaxFileBytes)
+                finish();
+        }
+        if (builder)
+            finish();
+    } catch (...) {
+        if (builder)
+            RemoveFile(FilePath(nNumber, "sst"));
+        for (size_t i = 0; i < outputs.size(); i++)
+            outputs[i]->fObsolete = true;
+        throw;
+    }
+}
+
+void LsmStore::InstallVersion(const std::vector<TableRef>& removed, const std::vector<TableRef>& added, int nAddLevel)
+{
+    std::set<uint64_t> setRemoved, setAdded;
+    for (size_t i = 0; i < removed.size(); i++)
+        setRemoved.insert(removed[i]->nNumber);
+    for (size_t i = 0; i < added.size(); i++)
+        setAdded.insert(added[i]->nNumber);
+
+    std::shared_ptr<LsmVersion> version(new LsmVersion);
+    for (int i = 0; i < LSM_LEVELS; i++) {
+        for (size_t j = 0; j < current->files[i].size(); j++) {
+            if (!setRemoved.count(current->files[i][j]->nNumber))
+                version->files[i].push_back(current->files[i][j]);
+        }
+    }
+    std::vector<TableRef>& files = version->files[nAddLevel];
+    files.insert(files.end(), added.begin(), added.end());
+    std::sort(files.begin(), files.end(), nAddLevel == 0 ? ByNumber : BySmallest);
+
+    // Logs from before imm's hold nothing the tables lack.
+    WriteManifest(*version, imm ? nImmLogNumber : nLogNumber);
+    current = version;
+    for (size_t i = 0; i < removed.size(); i++) {
+        if (!setAdded.count(removed[i]->nNumber))
+            removed[i]->fObsolete = true;
+    }
+}
+
+void LsmStore::WriteManifest(const LsmVersion& version, uint64_t nLogNumberIn)
+{
+    std::vector<unsigned char> data;
+    ByteWriter w(data);
+    w.WriteU32(MANIFEST_MAGIC);
+    w.WriteVarInt(nNextFile);
+    w.WriteVarInt(nLogNumberIn);
+    size_t nFiles = 0;
+    for (int i = 0; i < LSM_LEVELS; i++)
+        nFiles += version.files[i].size();
+    w.WriteVarInt(nFiles);
+    for (int i = 0; i < LSM_LEVELS; i++) {
+        for (size_t j = 0; j < version.files[i].size(); j++) {
+            const LsmTable& table = *version.files[i][j];
+            w.WriteU8((uint8_t)i);
+            w.WriteVarInt(table.nNumber);
+            w.WriteVarBytes(std::vector<unsigned char>(table.smallest.begin(), table.smallest.end()));
+            w.WriteVarBytes(std::vector<unsigned char>(table.largest.begin(), table.largest.end()));
+        }
+    }
+    w.WriteU32(Checksum(data.data(), data.size()));
+
+    // Written aside and renamed over, so a crash leaves one or the other.
+    std::string path = dir + "/MANIFEST";
+    std::string tmpPath = path + ".tmp";
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    bool ok = fd >= 0 && WriteAll(fd, data.data(), data.size()) && fdatasync(fd) == 0;
+    if (fd >= 0)
+        close(fd);
+    if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0 || !SyncDirectory(dir)) {
+        RemoveFile(tmpPath);
+        throw std::runtime_error("cannot write " + path);
+    }
+}
@@ -0,0 +1,228 @@
+#ifndef ONECOIN_LSM_H
+#define ONECOIN_LSM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/** Levels of sorted tables below the memtable. */
+static const int LSM_LEVELS = 7;
+
+struct LsmOptions {
+    /** Memtable size at which it is frozen and written out as a table. */
+    size_t nMemtableBytes;
+    /** Uncompressed size of a table data block. */
+    size_t nBlockSize;
+    /** Bloom filter bits per key; 10 gives about 1% false positives. */
+    int nBloomBitsPerKey;
+    /** Level-0 tables that start a compaction into level 1. */
+    int nL0CompactionTrigger;
+    /** Level-0 tables at which writes wait for compaction to catch up. */
+    int nL0StopWritesTrigger;
+    /** Size of level 1; each deeper level holds ten times more. */
+    uint64_t nLevel1Bytes;
+    /** Size at which compaction starts a new output table. */
+    uint64_t nTargetFileBytes;
+    /** Threads that flush memtables and run compactions. */
+    unsigned int nBackgroundThreads;
+    /** fdatasync the log for every write, as if each asked for it. */
+    bool fSync;
+    /** LZ-compress data blocks that shrink by at least an eighth. */
+    bool fCompress;
+
+    LsmOptions();
+};
+
+/** Updates applied to a store atomically. */
+class LsmWriteBatch {
+public:
+    LsmWriteBatch() : nCount(0) {}
+
+    void Put(const std::string& key, const std::string& value);
+    void Delete(const std::string& key);
+    void Clear();
+    size_t Count() const { return nCount; }
+    size_t ApproximateSize() const { return rep.size(); }
+
+private:
+    friend class LsmStore;
+
+    /** Records of a type byte, a varint-prefixed key and, for a put, a
+     *  varint-prefixed value; the log stores this as is. */
+    std::vector<unsigned char> rep;
+    size_t nCount;
+};
+
+struct LsmStats {
+    int nFiles[LSM_LEVELS];
+    uint64_t nBytes[LSM_LEVELS];
+    uint64_t nWrites;
+    /** Log appends; each carries the batches of one group of writers. */
+    uint64_t nLogWrites;
+    uint64_t nSyncs;
+    uint64_t nFlushes;
+    uint64_t nCompactions;
+    /** Compactions that moved a table down a level without rewriting it. */
+    uint64_t nTrivialMoves;
+    uint64_t nBytesCompacted;
+    /** Writes that waited for a flush or for level 0 to drain. */
+    uint64_t nStalls;
+
+    LsmStats();
+};
+
+struct LsmTable;
+struct LsmVersion;
+class LsmIterator;
+
+/**
+ * An ordered key-value store in one directory, built as a log-structured
+ * merge tree. Writes go to a write-ahead log and an in-memory table; a
+ * full memtable is written out as a sorted table in level 0 by a
+ * background thread. Tables are made of prefix-compressed, LZ-compressed
+ * blocks plus an index and a bloom filter that stay in memory, so a
+ * lookup costs at most one block read per level, and usually only in the
+ * level holding the key. Background threads merge tables into deeper
+ * levels that are each ten times larger and hold disjoint key ranges.
+ *
+ * Which tables make up the store is kept in dir/MANIFEST, rewritten in
+ * full whenever it changes, along with the oldest log whose writes are not
+ * in a table yet. That log is the checkpoint Open() replays from. Log
+ * records, table blocks and the manifest each carry a CRC-32C, checked on
+ * every read.
+ *
+ * Writers commit in groups: concurrent Write() calls queue up, and the
+ * first in line appends the batches of everyone queued behind it to the
+ * log in one write and one fdatasync, then applies them all. On storage
+ * where a sync costs milliseconds, durable writes from many threads cost
+ * about one sync per group instead of one each.
+ *
+ * Reads and writes are thread-safe. Failed reads or writes throw
+ * std::runtime_error, as do writes after a background job failed.
+ */
+class LsmStore {
+public:
+    explicit LsmStore(const std::string& dir, const LsmOptions& options = LsmOptions());
+    ~LsmStore();
+
+    bool Open(std::string& error);
+    /** Stops the background threads and closes the files. Unflushed
+     *  writes stay in the log. */
+    void Close();
+
+    bool Get(const std::string& key, std::string& value) const;
+    /** Applies batch. With fSync it is on stable storage on return. */
+    void Write(const LsmWriteBatch& batch, bool fSync = false);
+    void Put(const std::string& key, const std::string& value);
+    void Delete(const std::string& key);
+    /** Calls fn on the entries with start <= key < end in key order until
+     *  it returns false; an empty end means no upper bound. Writes made
+     *  meanwhile may or may not be seen. */
+    void Scan(const std::string& start, const std::string& end,
+        const std::function<bool(const std::string& key, const std::string& value)>& fn) const;
+
+    /** Writes the memtable out as a table and waits for it, which moves
+     *  the checkpoint past every write so far. */
+    void Flush();
+    /** Waits until no level needs compacting. */
+    void WaitForCompactions();
+    LsmStats GetStats() const;
+    const std::string& Dir() const { return dir; }
+
+private:
+    struct MemEntry {
+        std::string value;
+        bool fDeleted;
+    };
+    typedef std::map<std::string, MemEntry> MemTable;
+
+    /** A Write() or Flush() waiting its turn. */
+    struct Writer {
+        /** NULL for a Flush(), which switches memtables in turn. */
+        const LsmWriteBatch* batch;
+        bool fSync;
+        bool fDone;
+        std::string error;
+        std::condition_variable cond;
+
+        Writer(const LsmWriteBatch* batch, bool fSync) : batch(batch), fSync(fSync), fDone(false) {}
+    };
+
+    /** A compaction picked under the lock and run without it. */
+    struct Compaction {
+        int nLevel;
+        std::vector<std::shared_ptr<LsmTable> > inputs[2];
+        std::shared_ptr<const LsmVersion> version;
+    };
+
+    const std::string dir;
+    const LsmOptions options;
+
+    mutable std::mutex mutex;
+    /** Signalled when there is background work or the store closes. */
+    std::condition_variable workCond;
+    /** Signalled when background work finishes. */
+    std::condition_variable doneCond;
+    std::vector<std::thread> threads;
+    /** Queued writers; the one in front writes the log for a group. */
+    std::deque<Writer*> writers;
+    bool fOpen;
+    bool fStop;
+
+    std::shared_ptr<MemTable> mem;
+    size_t nMemBytes;
+    /** A full memtable being written out; reads still see it. */
+    std::shared_ptr<MemTable> imm;
+    bool fFlushing;
+    std::shared_ptr<const LsmVersion> current;
+    /** Levels taking part in a running compaction. */
+    bool fLevelBusy[LSM_LEVELS];
+    /** Where the next compaction out of each level starts. */
+    std::string compactPointer[LSM_LEVELS];
+
+    int logFd;
+    uint64_t nLogNumber;
+    /** The log of imm, removed once imm is in a table. */
+    uint64_t nImmLogNumber;
+    uint64_t nNextFile;
+    std::string backgroundError;
+    LsmStats stats;
+
+    std::string FilePath(uint64_t nNumber, const char* ext) const;
+    bool Recover(std::string& error);
+    bool ReplayLog(const std::string& path, std::string& error);
+    void ApplyToMemTable(const unsigned char* rep, size_t len, MemTable& table, size_t& nBytes) const;
+    /** Queues w and waits until it is written, writing the log for a
+     *  group of writers when w reaches the front. */
+    void RunWriter(std::unique_lock<std::mutex>& lock, Writer& w);
+    void NewLog();
+    /** Makes room in the memtable, waiting on flushes and level 0. */
+    void MakeRoomForWrite(std::unique_lock<std::mutex>& lock, bool fForce);
+    void CheckBackgroundError() const;
+
+    void BackgroundThread();
+    /** Whether some level is past its size limit and free to compact. */
+    bool NeedsCompaction() const;
+    bool PickCompaction(Compaction& c);
+    void FlushMemTable(std::unique_lock<std::mutex>& lock);
+    void RunCompaction(std::unique_lock<std::mutex>& lock, Compaction& c);
+    /** Writes the entries of it into tables of about nMaxFileBytes each,
+     *  dropping deletions when fDropDeletions. */
+    void WriteTables(LsmIterator& it, bool fDropDeletions, uint64_t nMaxFileBytes,
+        std::vector<std::shared_ptr<LsmTable> >& outputs);
+    /** Installs a version with removed replaced by added, under the lock. */
+    void InstallVersion(const std::vector<std::shared_ptr<LsmTable> >& removed,
+        const std::vector<std::shared_ptr<LsmTable> >& added, int nAddLevel);
+    void WriteManifest(const LsmVersion& version, uint64_t nLogNumberIn);
+    double LevelScore(const LsmVersion& version, int nLevel) const;
+};
+
+#endif // ONECOIN_LSM_H
@@ -0,0 +1,130 @@
+#include "lz.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+
+namespace {
+
+const int HASH_BITS = 12;
+const size_t MIN_MATCH = 4;
+const size_t MAX_OFFSET = 65535;
+
+inline uint32_t Read32(const unsigned char* p)
+{
+    uint32_t x;
+    memcpy(&x, p, 4);
+    return x;
+}
+
+inline size_t HashOf(uint32_t x) { return (x * 2654435761U) >> (32 - HASH_BITS); }
+
+/** A length past the 15 its token nibble holds, as a run of 255s. */
+void WriteLengthTail(std::vector<unsigned char>& out, size_t n)
+{
+    for (; n >= 255; n -= 255)
+        out.push_back(255);
+    out.push_back((unsigned char)n);
+}
+
+void WriteSequence(std::vector<unsigned char>& out, const unsigned char* literals, size_t nLiterals, size_t nOffset,
+    size_t nMatch)
+{
+    size_t nMatchCode = nMatch ? nMatch - MIN_MATCH : 0;
+    out.push_back((unsigned char)((std::min<size_t>(nLiterals, 15) << 4) | std::min<size_t>(nMatchCode, 15)));
+    if (nLiterals >= 15)
+        WriteLengthTail(out, nLiterals - 15);
+    out.insert(out.end(), literals, literals + nLiterals);
+    if (!nMatch)
+        return;
+    out.push_back((unsigned char)nOffset);
+    out.push_back((unsigned char)(nOffset >> 8));
+    if (nMatchCode >= 15)
+        WriteLengthTail(out, nMatchCode - 15);
+}
+
+bool ReadLength(const unsigned char*& p, const unsigned char* end, size_t& n)
+{
+    if (n != 15)
+        return true;
+    while (true) {
+        if (p == end)
+            return false;
+        unsigned char b = *p++;
+        n += b;
+        if (b != 255)
+            return true;
+    }
+}
+
+} // namespace
+
+void LzCompress(const unsigned char* data, size_t len, std::vector<unsigned char>& out)
+{
+    size_t anchor = 0;
+    if (len > MIN_MATCH) {
+        // Positions plus one, so zero means empty.
+        std::vector<uint32_t> table((size_t)1 << HASH_BITS, 0);
+        size_t i = 0;
+        while (i + MIN_MATCH <= len) {
+            uint32_t x = Read32(data + i);
+            uint32_t& slot = table[HashOf(x)];
+            size_t candidate = slot;
+            slot = (uint32_t)(i + 1);
+            if (candidate && i - (candidate - 1) <= MAX_OFFSET && Read32(data + candidate - 1) == x) {
+                candidate--;
+                size_t nMatch = MIN_MATCH;
+                while (i + nMatch < len && data[candidate + nMatch] == data[i + nMatch])
+                    nMatch++;
+                WriteSequence(out, data + anchor, i - anchor, i - candidate, nMatch);
+                i += nMatch;
+                anchor = i;
+            } else {
+                i++;
+            }
+        }
+    }
+    // The last sequence is literals only.
+    WriteSequence(out, data + anchor, len - anchor, 0, 0);
+}
+
+bool LzDecompress(const unsigned char* data, size_t len, size_t nSize, std::vector<unsigned char>& out)
+{
+    out.resize(nSize);
+    unsigned char* dst = out.data();
+    size_t nOut = 0;
+    const unsigned char* p = data;
+    const unsigned char* end = data + len;
+    while (p < end) {
+        unsigned char token = *p++;
+        size_t nLiterals = token >> 4;
+        if (!ReadLength(p, end, nLiterals) || (size_t)(end - p) < nLiterals || nSize - nOut < nLiterals)
+            return false;
+        if (nLiterals)
+            memcpy(dst + nOut, p, nLiterals);
+        nOut += nLiterals;
+        p += nLiterals;
+        if (p == end)
+            break;
+        if (end - p < 2)
+            return false;
+        size_t nOffset = p[0] | ((size_t)p[1] << 8);
+        p += 2;
+        size_t nMatch = token & 15;
+        if (!ReadLength(p, end, nMatch))
+            return false;
+        nMatch += MIN_MATCH;
+        if (nOffset == 0 || nOffset > nOut || nSize - nOut < nMatch)
+            return false;
+        const unsigned char* from = dst + nOut - nOffset;
+        if (nOffset >= nMatch) {
+            memcpy(dst + nOut, from, nMatch);
+        } else {
+            // The match overlaps the bytes it produces.
+            for (size_t i = 0; i < nMatch; i++)
+                dst[nOut + i] = from[i];
+        }
+        nOut += nMatch;
+    }
+    return nOut == nSize;
+}
@@ -0,0 +1,21 @@
+#ifndef ONECOIN_LZ_H
+#define ONECOIN_LZ_H
+
+#include <stddef.h>
+#include <vector>
+
+/**
+ * LZ77 block compression in the LZ4 block layout: each sequence is a token
+ * byte holding the literal and match lengths, the literals, and a 16-bit
+ * back reference. Greedy matching over a small hash table keeps it fast
+ * enough to run on every storage block, with no library behind it.
+ */
+
+/** Appends the compressed form of data to out. */
+void LzCompress(const unsigned char* data, size_t len, std::vector<unsigned char>& out);
+
+/** Replaces out with the nSize bytes data expands to. False if data is
+ *  malformed or does not expand to exactly nSize bytes. */
+bool LzDecompress(const unsigned char* data, size_t len, size_t nSize, std::vector<unsigned char>& out);
+
+#endif // ONECOIN_LZ_H
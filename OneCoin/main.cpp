@@ -1,8 +1,502 @@
 #include <iostream>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "addrindex.h"
+#include "blockfilterindex.h"
+#include "address.h"
+#include "chaingen.h"
+#include "chainparams.h"
+#include "encoding.h"
+#include "miner.h"
+#include "pagearena.h"
+#include "pow.h"
+#include "snapshot.h"
+#include "stratum.h"
+#include "txindex.h"
+#include "validation.h"
+
 using namespace std;
 
-int main() {
-    cout << "Hello, World!" << endl;
+static volatile sig_atomic_t fRequestShutdown = 0;
+
+static void HandleSignal(int)
+{
+    fRequestShutdown = 1;
+}
+
+static bool GetArg(int argc, char* argv[], const string& name, string& value)
+{
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == name) {
+            value = "";
+            return true;
+        }
+        if (arg.compare(0, name.size() + 1, name + "=") == 0) {
+            value = arg.substr(name.size() + 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+/** Non-option arguments, in order. */
+static vector<string> GetCommand(int argc, char* argv[])
+{
+    vector<string> command;
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] != '-')
+            command.push_back(argv[i]);
+    }
+    return command;
+}
+
+static string GetDataDir(int argc, char* argv[])
+{
+    string value;
+    if (GetArg(argc, argv, "-datadir", value) && !value.empty())
+        return value + "/" + Params().NetworkIDString();
+    const char* home = getenv("HOME");
+    return string(home ? home : ".") + "/.onecoin/" + Params().NetworkIDString();
+}
+
+/** -assumevalid=<hash> connects that block and its ancestors without running
+ *  their scripts; 0 runs every script. Without it the network default
+ *  applies. -connectthreads=<n> sets the threads that connect one block's
+ *  transactions, one per core by default. -coinsdb=lsm keeps the UTXO set
+ *  across restarts in an LSM store instead of rebuilding it in the coins
+ *  log. -prune=<MiB> deletes the oldest block files beyond that budget; 0
+ *  keeps them all. -reindex rebuilds the block tree from the block files'
+ *  headers and connects the blocks in height order instead of file order.
+ *  -hugepages=thp|explicit backs the UTXO cache with transparent or
+ *  reserved 2 MiB pages, and -numainterleave spreads it across every NUMA
+ *  node. */
+static bool ApplyChainstateOptions(int argc, char* argv[], Chainstate& chainstate)
+{
+    string value;
+    if (GetArg(argc, argv, "-assumevalid", value)) {
+        uint256 hash;
+        if (value != "0" && !hash.SetHex(value)) {
+            cerr << "invalid -assumevalid hash " << value << endl;
+            return false;
+        }
+        chainstate.SetAssumeValid(hash);
+    }
+    if (GetArg(argc, argv, "-connectthreads", value))
+        chainstate.SetConnectThreads((unsigned int)atoi(value.c_str()));
+    if (GetArg(argc, argv, "-coinsdb", value)) {
+        if (value != "log" && value != "lsm") {
+            cerr << "invalid -coinsdb " << value << ", expected log or lsm" << endl;
+            return false;
+        }
+        chainstate.SetCoinsBackend(value == "lsm" ? COINS_BACKEND_LSM : COINS_BACKEND_LOG);
+    }
+    if (GetArg(argc, argv, "-prune", value)) {
+        uint64_t nBytes = strtoull(value.c_str(), NULL, 10) << 20;
+        if (nBytes != 0 && nBytes < MIN_PRUNE_TARGET) {
+            cerr << "-prune must be 0 or at least " << (MIN_PRUNE_TARGET >> 20) << " MiB" << endl;
+            return false;
+        }
+        chainstate.SetPruneTarget(nBytes);
+    }
+    if (GetArg(argc, argv, "-reindex", value))
+        chainstate.SetReindex(true);
+    PageArena::Options arenaOptions = PageArena::Default().GetOptions();
+    if (GetArg(argc, argv, "-hugepages", value)) {
+        if (value == "off")
+            arenaOptions.hugePages = PageArena::HUGEPAGES_OFF;
+        else if (value == "thp")
+            arenaOptions.hugePages = PageArena::HUGEPAGES_TRANSPARENT;
+        else if (value == "explicit")
+            arenaOptions.hugePages = PageArena::HUGEPAGES_EXPLICIT;
+        else {
+            cerr << "invalid -hugepages " << value << ", expected off, thp or explicit" << endl;
+            return false;
+        }
+    }
+    if (GetArg(argc, argv, "-numainterleave", value))
+        arenaOptions.fNumaInterleave = value != "0";
+    PageArena::Default().SetOptions(arenaOptions);
+    return true;
+}
+
+/** How the blocks connected so far were validated. */
+static string FormatConnectStats(const Chainstate& chainstate)
+{
+    const ConnectStats& stats = chainstate.GetConnectStats();
+    return to_string(stats.nScriptChecked) + " script-checked, " + to_string(stats.nAssumedValid) + " assumed valid, " +
+           to_string(stats.nReconnected) + " reconnected";
+}
+
+/** generate N [address]: mines N blocks on the local chain and connects
+ *  them. Without an address the coinbases pay an anyone-can-spend script,
+ *  which is what benchmarks building on the chain want. */
+static int RunGenerate(int argc, char* argv[], const vector<string>& command)
+{
+    const ChainParams& params = Params();
+    if (params.NetworkIDString() != "regtest") {
+        cerr << "generate is only available with -regtest" << endl;
+        return 1;
+    }
+    int n = command.size() > 1 ? atoi(command[1].c_str()) : 0;
+    if (n <= 0) {
+        cerr << "usage: app -regtest [-datadir=<dir>] [-assumevalid=<hash>] [-connectthreads=<n>] [-coinsdb=log|lsm] [-prune=<MiB>] [-reindex] [-hugepages=off|thp|explicit] [-numainterleave] generate <blocks> [address]" << endl;
+        return 1;
+    }
+    Script payout = Script() << OP_TRUE;
+    if (command.size() > 2 && !DecodeAddress(command[2], params, payout)) {
+        cerr << "invalid address " << command[2] << endl;
+        return 1;
+    }
+
+    Chainstate chainstate(params, GetDataDir(argc, argv));
+    if (!ApplyChainstateOptions(argc, argv, chainstate))
+        return 1;
+    string error;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    if (!chainstate.Load(error)) {
+        cerr << "loading chain: " << error << endl;
+        return 1;
+    }
+    double loadSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "loaded " << chainstate.Height() << " blocks in " << loadSeconds << " s ("
+         << FormatConnectStats(chainstate) << ")" << endl;
+
+    start = chrono::steady_clock::now();
+    ValidationState state;
+    vector<uint256> hashes = GenerateBlocks(chainstate, payout, n, state);
+    chainstate.Flush();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "generated " << hashes.size() << " blocks in " << seconds << " s ("
+         << (seconds > 0 ? hashes.size() / seconds : 0) << " blocks/s)" << endl;
+    cout << "tip " << chainstate.Height() << " " << chainstate.Tip()->GetBlockHash().GetHex() << endl;
+    if (chainstate.GetPruneHeight() >= 0)
+        cout << "pruned blocks up to height " << chainstate.GetPruneHeight() << endl;
+    if ((int)hashes.size() != n) {
+        cerr << "generate failed: " << state.GetRejectReason() << endl;
+        return 1;
+    }
+    return 0;
+}
+
+/** generatechain N: writes a synthetic chain of height N with a mixed
+ *  transaction workload and a manifest into an empty data directory. The
+ *  same -seed always gives the same block files. */
+static int RunGenerateChain(int argc, char* argv[], const vector<string>& command)
+{
+    const ChainParams& params = Params();
+    if (params.NetworkIDString() != "regtest") {
+        cerr << "generatechain is only available with -regtest" << endl;
+        return 1;
+    }
+    ChainGenOptions options;
+    options.nHeight = command.size() > 1 ? atoi(command[1].c_str()) : 0;
+    string value;
+    if (GetArg(argc, argv, "-seed", value))
+        options.seed = strtoull(value.c_str(), NULL, 10);
+    if (GetArg(argc, argv, "-txperblock", value))
+        options.nTxPerBlock = atoi(value.c_str());
+    if (options.nHeight <= 0) {
+        cerr << "usage: app -regtest [-datadir=<dir>] [-seed=<n>] [-txperblock=<n>] generatechain <height>" << endl;
+        return 1;
+    }
+
+    string datadir = GetDataDir(argc, argv);
+    ChainManifest manifest;
+    string error;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    if (!ChainGenerator(params, options).Run(datadir, manifest, error, &cout)) {
+        cerr << "generatechain failed: " << error << endl;
+        return 1;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "wrote " << manifest.nTransactions << " transactions in " << manifest.nHeight << " blocks ("
+         << manifest.nBlockBytes << " bytes) in " << seconds << " s" << endl;
+    cout << "manifest " << datadir << "/" << ChainGenerator::MANIFEST_NAME << endl;
+    return 0;
+}
 
+/** dumptxoutset <file>: writes the UTXO set at the tip to a snapshot
+ *  file, see snapshot.h. */
+static int RunDumpTxOutSet(int argc, char* argv[], const vector<string>& command)
+{
+    if (command.size() != 2) {
+        cerr << "usage: app [-regtest] [-datadir=<dir>] [-coinsdb=log|lsm] [-prune=<MiB>] dumptxoutset <file>" << endl;
+        return 1;
+    }
+    Chainstate chainstate(Params(), GetDataDir(argc, argv));
+    if (!ApplyChainstateOptions(argc, argv, chainstate))
+        return 1;
+    string error;
+    if (!chainstate.Load(error)) {
+        cerr << "loading chain: " << error << endl;
+        return 1;
+    }
+    chainstate.Flush();
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    SnapshotInfo info;
+    if (!WriteCoinsSnapshot(chainstate.CoinsDB(), command[1], info, error)) {
+        cerr << "dumptxoutset: " << error << endl;
+        return 1;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "wrote " << info.nCoins << " coins (" << info.nBytes << " bytes) at height " << chainstate.Height()
+         << " " << info.hashBlock.GetHex() << " in " << seconds << " s" << endl;
+    return 0;
+}
+
+/** getrawtransaction <txid>: prints a confirmed transaction in hex and the
+ *  block holding it, from the transaction index. The index is brought up
+ *  to the tip first, which only takes long the first time. */
+static int RunGetRawTransaction(int argc, char* argv[], const vector<string>& command)
+{
+    if (command.size() != 2 || command[1].size() != 64 || !IsHex(command[1])) {
+        cerr << "usage: app [-regtest] [-datadir=<dir>] [-coinsdb=log|lsm] getrawtransaction <txid>" << endl;
+        return 1;
+    }
+    string datadir = GetDataDir(argc, argv);
+    Chainstate chainstate(Params(), datadir);
+    if (!ApplyChainstateOptions(argc, argv, chainstate))
+        return 1;
+    string error;
+    if (!chainstate.Load(error)) {
+        cerr << "loading chain: " << error << endl;
+        return 1;
+    }
+    TxIndex txindex(datadir + "/indexes/txindex", chainstate);
+    if (!txindex.Start(error) || !txindex.WaitForSync(error)) {
+        cerr << "txindex: " << error << endl;
+        return 1;
+    }
+    TransactionRef tx;
+    uint256 hashBlock;
+    if (!txindex.GetTransaction(uint256::FromHex(command[1]), tx, hashBlock)) {
+        cerr << "no confirmed transaction " << command[1] << endl;
+        return 1;
+    }
+    cout << HexStr(SerializeTransaction(*tx)) << endl;
+    const BlockIndex* pindex = chainstate.LookupBlockIndex(hashBlock);
+    cout << "block " << hashBlock.GetHex();
+    if (pindex && chainstate.GetActiveChain().Contains(pindex))
+        cout << " height " << pindex->nHeight;
+    else
+        cout << " (not in the active chain)";
+    cout << endl;
+    return 0;
+}
+
+/** Coins with eight decimals. */
+static string FormatAmount(Amount nValue)
+{
+    char buf[32];
+    Amount nAbs = nValue < 0 ? -nValue : nValue;
+    snprintf(buf, sizeof(buf), "%s%lld.%08lld", nValue < 0 ? "-" : "", (long long)(nAbs / COIN),
+        (long long)(nAbs % COIN));
+    return buf;
+}
+
+/** getaddresshistory <address>: prints every payment to and from the
+ *  address on the active chain and its balance, from the address index.
+ *  The index is brought up to the tip first, which only takes long the
+ *  first time. */
+static int RunGetAddressHistory(int argc, char* argv[], const vector<string>& command)
+{
+    Script script;
+    if (command.size() != 2 || !DecodeAddress(command[1], Params(), script)) {
+        cerr << "usage: app [-regtest] [-datadir=<dir>] [-coinsdb=log|lsm] getaddresshistory <address>" << endl;
+        return 1;
+    }
+    string datadir = GetDataDir(argc, argv);
+    Chainstate chainstate(Params(), datadir);
+    if (!ApplyChainstateOptions(argc, argv, chainstate))
+        return 1;
+    string error;
+    if (!chainstate.Load(error)) {
+        cerr << "loading chain: " << error << endl;
+        return 1;
+    }
+    AddrIndex addrindex(datadir + "/indexes/addrindex", chainstate);
+    if (!addrindex.Start(error) || !addrindex.WaitForSync(error)) {
+        cerr << "addrindex: " << error << endl;
+        return 1;
+    }
+    uint256 scriptHash = AddrIndex::GetScriptHash(script);
+    vector<AddrIndexEntry> entries;
+    addrindex.GetHistory(scriptHash, entries);
+    for (size_t i = 0; i < entries.size(); i++) {
+        const AddrIndexEntry& entry = entries[i];
+        cout << entry.nHeight << " " << entry.txid.GetHex() << (entry.fSpend ? " in " : " out ") << entry.n << " "
+             << FormatAmount(entry.fSpend ? -entry.nValue : entry.nValue) << endl;
+    }
+    cout << "balance " << FormatAmount(addrindex.GetBalance(scriptHash)) << endl;
+    return 0;
+}
+
+/** getblockfilter <blockhash>: prints the basic filter of a block in hex
+ *  and its filter header, from the block filter index. The index is
+ *  brought up to the tip first, which only takes long the first time. */
+static int RunGetBlockFilter(int argc, char* argv[], const vector<string>& command)
+{
+    if (command.size() != 2 || command[1].size() != 64 || !IsHex(command[1])) {
+        cerr << "usage: app [-regtest] [-datadir=<dir>] [-coinsdb=log|lsm] getblockfilter <blockhash>" << endl;
+        return 1;
+    }
+    string datadir = GetDataDir(argc, argv);
+    Chainstate chainstate(Params(), datadir);
+    if (!ApplyChainstateOptions(argc, argv, chainstate))
+        return 1;
+    string error;
+    if (!chainstate.Load(error)) {
+        cerr << "loading chain: " << error << endl;
+        return 1;
+    }
+    BlockFilterIndex filterindex(datadir + "/indexes/blockfilter", chainstate);
+    if (!filterindex.Start(error) || !filterindex.WaitForSync(error)) {
+        cerr << "blockfilterindex: " << error << endl;
+        return 1;
+    }
+    uint256 hashBlock = uint256::FromHex(command[1]);
+    BlockFilter filter;
+    uint256 header;
+    if (!filterindex.GetFilter(hashBlock, filter) || !filterindex.GetFilterHeader(hashBlock, header)) {
+        cerr << "no filter for block " << command[1] << endl;
+        return 1;
+    }
+    cout << HexStr(filter.GetEncoded()) << endl;
+    cout << "header " << header.GetHex() << endl;
+    return 0;
+}
+
+/** Serves block templates on the local chain to external miners until
+ *  interrupted; solved blocks are connected and mining moves on. With
+ *  -txindex, -addrindex and -blockfilterindex those indexes follow the
+ *  chain meanwhile. */
+static int RunStratum(int argc, char* argv[])
+{
+    const ChainParams& params = Params();
+    string value;
+
+    Script payout;
+    if (!GetArg(argc, argv, "-stratumpayout", value) || !DecodeAddress(value, params, payout)) {
+        cerr << "-stratum requires -stratumpayout=<address>" << endl;
+        return 1;
+    }
+    StratumServer::Options options;
+    options.port = params.GetDefaultStratumPort();
+    if (GetArg(argc, argv, "-stratumport", value))
+        options.port = (uint16_t)atoi(value.c_str());
+    if (GetArg(argc, argv, "-stratumbind", value))
+        options.bindAddress = value;
+    if (GetArg(argc, argv, "-stratumdifficulty", value))
+        options.difficulty = atof(value.c_str());
+
+    Chainstate chainstate(params, GetDataDir(argc, argv));
+    if (!ApplyChainstateOptions(argc, argv, chainstate))
+        return 1;
+    string error;
+    if (!chainstate.Load(error)) {
+        cerr << "loading chain: " << error << endl;
+        return 1;
+    }
+    cout << "loaded " << chainstate.Height() << " blocks (" << FormatConnectStats(chainstate) << ")" << endl;
+    TxIndex txindex(GetDataDir(argc, argv) + "/indexes/txindex", chainstate);
+    if (GetArg(argc, argv, "-txindex", value) && !txindex.Start(error)) {
+        cerr << "txindex: " << error << endl;
+        return 1;
+    }
+    AddrIndex addrindex(GetDataDir(argc, argv) + "/indexes/addrindex", chainstate);
+    if (GetArg(argc, argv, "-addrindex", value) && !addrindex.Start(error)) {
+        cerr << "addrindex: " << error << endl;
+        return 1;
+    }
+    BlockFilterIndex filterindex(GetDataDir(argc, argv) + "/indexes/blockfilter", chainstate);
+    if (GetArg(argc, argv, "-blockfilterindex", value) && !filterindex.Start(error)) {
+        cerr << "blockfilterindex: " << error << endl;
+        return 1;
+    }
+    std::mutex chainMutex;
+    BlockAssembler assembler(params);
+    auto createTemplate = [&]() {
+        const BlockIndex* pindexPrev = chainstate.Tip();
+        return assembler.CreateNewBlock(pindexPrev->GetBlockHash(), pindexPrev->nHeight + 1,
+            GetNextWorkRequired(pindexPrev, params.GetConsensus()), time(NULL),
+            pindexPrev->GetMedianTimePast() + 1, payout, vector<TransactionRef>(), vector<Amount>());
+    };
+
+    StratumServer* server = NULL;
+    StratumServer::BlockFoundFn onBlock = [&](const Block& block) {
+        std::lock_guard<std::mutex> lock(chainMutex);
+        ValidationState state;
+        if (!chainstate.ProcessNewBlock(block, state)) {
+            cerr << "mined block rejected: " << state.GetRejectReason() << endl;
+            return;
+        }
+        cout << "block " << chainstate.Height() << " " << chainstate.Tip()->GetBlockHash().GetHex() << endl;
+        server->UpdateTemplate(createTemplate());
+    };
+    StratumServer stratum(options, onBlock);
+    server = &stratum;
+
+    if (!stratum.Start(error)) {
+        cerr << "stratum: " << error << endl;
+        return 1;
+    }
+    cout << "stratum listening on " << options.bindAddress << ":" << stratum.GetPort() << endl;
+    {
+        std::lock_guard<std::mutex> lock(chainMutex);
+        stratum.UpdateTemplate(createTemplate());
+    }
+
+    signal(SIGINT, HandleSignal);
+    signal(SIGTERM, HandleSignal);
+    // A fresh job now and then picks up the clock and new transactions; the
+    // server renews a job by itself when its share history fills up.
+    chrono::steady_clock::time_point lastTemplate = chrono::steady_clock::now();
+    while (!fRequestShutdown) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        if (chrono::steady_clock::now() - lastTemplate >= chrono::seconds(30)) {
+            std::lock_guard<std::mutex> lock(chainMutex);
+            stratum.UpdateTemplate(createTemplate());
+            lastTemplate = chrono::steady_clock::now();
+        }
+    }
+    stratum.Stop();
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    string value;
+    SelectParams(GetArg(argc, argv, "-regtest", value) ? "regtest" : "main");
+
+    if (GetArg(argc, argv, "-stratum", value))
+        return RunStratum(argc, argv);
+    vector<string> command = GetCommand(argc, argv);
+    if (!command.empty() && command[0] == "generate")
+        return RunGenerate(argc, argv, command);
+    if (!command.empty() && command[0] == "generatechain")
+        return RunGenerateChain(argc, argv, command);
+    if (!command.empty() && command[0] == "dumptxoutset")
+        return RunDumpTxOutSet(argc, argv, command);
+    if (!command.empty() && command[0] == "getrawtransaction")
+        return RunGetRawTransaction(argc, argv, command);
+    if (!command.empty() && command[0] == "getaddresshistory")
+        return RunGetAddressHistory(argc, argv, command);
+    if (!command.empty() && command[0] == "getblockfilter")
+        return RunGetBlockFilter(argc, argv, command);
+    if (!command.empty()) {
+        cerr << "unknown command " << command[0] << endl;
+        return 1;
+    }
+
+    cout << "Hello, World!" << endl;
     return (0);
-}
\ No newline at end of file
+}
@@ -0,0 +1,71 @@
+#include "merkle.h"
+#include "hash.h"
+
+#include <string.h>
+
+uint256 Hash64(const uint256& left, const uint256& right)
+{
+    unsigned char buf[64];
+    memcpy(buf, left.begin(), 32);
+    memcpy(buf + 32, right.begin(), 32);
+    unsigned char out[32];
+    Sha256d(buf, sizeof(buf), out);
+    return uint256(out);
+}
+
+uint256 ComputeMerkleRoot(std::vector<uint256> hashes, bool* mutated)
+{
+    bool mutation = false;
+    while (hashes.size() > 1) {
+        if (mutated) {
+            for (size_t pos = 0; pos + 1 < hashes.size(); pos += 2) {
+                if (hashes[pos] == hashes[pos + 1])
+                    mutation = true;
+            }
+        }
+        if (hashes.size() & 1)
+            hashes.push_back(hashes.back());
+        for (size_t i = 0; i < hashes.size() / 2; i++)
+            hashes[i] = Hash64(hashes[2 * i], hashes[2 * i + 1]);
+        hashes.resize(hashes.size() / 2);
+    }
+    if (mutated)
+        *mutated = mutation;
+    if (hashes.empty())
+        return uint256();
+    return hashes[0];
+}
+
+uint256 BlockMerkleRoot(const Block& block, bool* mutated)
+{
+    std::vector<uint256> leaves(block.vtx.size());
+    for (size_t i = 0; i < block.vtx.size(); i++)
+        leaves[i] = block.vtx[i]->GetHash();
+    return ComputeMerkleRoot(leaves, mutated);
+}
+
+std::vector<uint256> ComputeMerkleBranch(const std::vector<uint256>& leaves, uint32_t position)
+{
+    std::vector<uint256> branch;
+    std::vector<uint256> level(leaves);
+    while (level.size() > 1) {
+        if (level.size() & 1)
+            level.push_back(level.back());
+        branch.push_back(level[position ^ 1]);
+        for (size_t i = 0; i < level.size() / 2; i++)
+            level[i] = Hash64(level[2 * i], level[2 * i + 1]);
+        level.resize(level.size() / 2);
+        position >>= 1;
+    }
+    return branch;
+}
+
+uint256 ComputeMerkleRootFromBranch(const uint256& leaf, const std::vector<uint256>& branch, uint32_t position)
+{
+    uint256 hash = leaf;
+    for (size_t i = 0; i < branch.size(); i++) {
+        hash = (position & 1) ? Hash64(branch[i], hash) : Hash64(hash, branch[i]);
+        position >>= 1;
+    }
+    return hash;
+}
@@ -0,0 +1,25 @@
+#ifndef ONECOIN_MERKLE_H
+#define ONECOIN_MERKLE_H
+
+#include "block.h"
+#include "uint256.h"
+
+#include <stdint.h>
+#include <vector>
+
+/** Root of the Merkle tree over hashes, duplicating the last hash on odd
+ *  levels. *mutated is set when two identical hashes are paired, which
+ *  lets a different transaction list produce the same root (CVE-2012-2459). */
+uint256 ComputeMerkleRoot(std::vector<uint256> hashes, bool* mutated = NULL);
+
+uint256 BlockMerkleRoot(const Block& block, bool* mutated = NULL);
+
+/** Sibling hashes from leaf `position` up to the root. */
+std::vector<uint256> ComputeMerkleBranch(const std::vector<uint256>& leaves, uint32_t position);
+
+uint256 ComputeMerkleRootFromBranch(const uint256& leaf, const std::vector<uint256>& branch, uint32_t position);
+
+/** Double SHA-256 of the concatenation of two hashes. */
+uint256 Hash64(const uint256& left, const uint256& right);
+
+#endif // ONECOIN_MERKLE_H
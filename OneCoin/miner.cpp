@@ -0,0 +1,81 @@
+#include "miner.h"
+#include "merkle.h"
+#include "pow.h"
+
+#include <time.h>
+#include <algorithm>
+
+Script CoinbaseHeightScript(int nHeight)
+{
+    return Script() << (int64_t)nHeight;
+}
+
+MutableTransaction CreateCoinbase(int nHeight, Amount value, const Script& scriptPubKey,
+    const std::vector<unsigned char>& extraNonce)
+{
+    MutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = CoinbaseHeightScript(nHeight) << extraNonce;
+    tx.vout.resize(1);
+    tx.vout[0].nValue = value;
+    tx.vout[0].scriptPubKey = scriptPubKey;
+    return tx;
+}
+
+BlockTemplate BlockAssembler::CreateNewBlock(const uint256& hashPrev, int nHeight, uint32_t nBits, int64_t nTime,
+    int64_t nMinTime, const Script& scriptPubKey, const std::vector<TransactionRef>& txs,
+    const std::vector<Amount>& fees) const
+{
+    BlockTemplate tmpl;
+    tmpl.nHeight = nHeight;
+    tmpl.nFees = 0;
+    for (size_t i = 0; i < fees.size(); i++)
+        tmpl.nFees += fees[i];
+    tmpl.nCoinbaseValue = GetBlockSubsidy(nHeight, params.GetConsensus()) + tmpl.nFees;
+    tmpl.nMinTime = nMinTime;
+
+    Block& block = tmpl.block;
+    block.nVersion = 1;
+    block.hashPrevBlock = hashPrev;
+    block.nTime = (uint32_t)(nTime < nMinTime ? nMinTime : nTime);
+    block.nBits = nBits;
+    block.nNonce = 0;
+    block.vtx.reserve(txs.size() + 1);
+    block.vtx.push_back(MakeTransactionRef(CreateCoinbase(nHeight, tmpl.nCoinbaseValue, scriptPubKey,
+        std::vector<unsigned char>(8, 0))));
+    block.vtx.insert(block.vtx.end(), txs.begin(), txs.end());
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    return tmpl;
+}
+
+int64_t GetNextBlockTime(const BlockIndex* pindexPrev, const ConsensusParams& params, int64_t nNow)
+{
+    int64_t nTime = std::min(nNow, pindexPrev->GetBlockTime() + params.nPowTargetSpacing);
+    return std::max(nTime, pindexPrev->GetMedianTimePast() + 1);
+}
+
+std::vector<uint256> GenerateBlocks(Chainstate& chainstate, const Script& scriptPubKey, int n, ValidationState& state)
+{
+    const ConsensusParams& consensus = chainstate.GetParams().GetConsensus();
+    BlockAssembler assembler(chainstate.GetParams());
+    std::vector<uint256> hashes;
+    hashes.reserve(n);
+    for (int i = 0; i < n; i++) {
+        const BlockIndex* pindexPrev = chainstate.Tip();
+        int64_t nMinTime = pindexPrev->GetMedianTimePast() + 1;
+        BlockTemplate tmpl = assembler.CreateNewBlock(pindexPrev->GetBlockHash(), pindexPrev->nHeight + 1,
+            GetNextWorkRequired(pindexPrev, consensus), GetNextBlockTime(pindexPrev, consensus, time(NULL)), nMinTime,
+            scriptPubKey, std::vector<TransactionRef>(), std::vector<Amount>());
+        Block& block = tmpl.block;
+        while (!CheckProofOfWork(block.GetHash(), block.nBits, consensus)) {
+            if (++block.nNonce == 0) {
+                state.Invalid("nonce-space-exhausted");
+                return hashes;
+            }
+        }
+        if (!chainstate.ProcessNewBlock(block, state))
+            return hashes;
+        hashes.push_back(block.GetHash());
+    }
+    return hashes;
+}
@@ -0,0 +1,58 @@
+#ifndef ONECOIN_MINER_H
+#define ONECOIN_MINER_H
+
+#include "amount.h"
+#include "block.h"
+#include "chainparams.h"
+#include "script.h"
+#include "validation.h"
+
+#include <stdint.h>
+#include <vector>
+
+/** A block ready to be mined: vtx[0] is the coinbase. */
+struct BlockTemplate {
+    Block block;
+    int nHeight;
+    Amount nFees;
+    /** Subsidy plus fees, i.e. what the coinbase may claim. */
+    Amount nCoinbaseValue;
+    /** Earliest nTime the block may carry. */
+    int64_t nMinTime;
+};
+
+/** Coinbase paying value to scriptPubKey. The scriptSig starts with the
+ *  height and ends with extraNonce, which miners vary. */
+MutableTransaction CreateCoinbase(int nHeight, Amount value, const Script& scriptPubKey,
+    const std::vector<unsigned char>& extraNonce);
+
+/** The coinbase scriptSig prefix: a push of the block height. */
+Script CoinbaseHeightScript(int nHeight);
+
+class BlockAssembler {
+public:
+    explicit BlockAssembler(const ChainParams& params) : params(params) {}
+
+    /** Builds a template on top of hashPrev at nHeight. txs must already be
+     *  valid and in dependency order; fees[i] belongs to txs[i]. */
+    BlockTemplate CreateNewBlock(const uint256& hashPrev, int nHeight, uint32_t nBits, int64_t nTime,
+        int64_t nMinTime, const Script& scriptPubKey, const std::vector<TransactionRef>& txs,
+        const std::vector<Amount>& fees) const;
+
+private:
+    const ChainParams& params;
+};
+
+/** Timestamp for a locally mined block on top of pindexPrev: one target
+ *  spacing after it while the chain is behind the clock, so chains built in
+ *  a burst keep realistic times, then the clock itself. Always above the
+ *  median time past. */
+int64_t GetNextBlockTime(const BlockIndex* pindexPrev, const ConsensusParams& params, int64_t nNow);
+
+/** Mines n blocks on the active tip and connects each one, as regtest's
+ *  generate does. Returns the hashes of the blocks mined; on failure the
+ *  result is short and state says why. Only practical where the chain's
+ *  proof-of-work limit is trivial. */
+std::vector<uint256> GenerateBlocks(Chainstate& chainstate, const Script& scriptPubKey, int n, ValidationState& state);
+
+#endif // ONECOIN_MINER_H
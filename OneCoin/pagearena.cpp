@@ -0,0 +1,339 @@
+#include "pagearena.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <new>
+
+namespace {
+
+/** From linux/mempolicy.h, which not every libc installs. */
+const int MPOL_INTERLEAVE_MODE = 3;
+
+/** The 2 MiB-aligned chunk p lies in. */
+unsigned char* ChunkOf(void* p)
+{
+    return (unsigned char*)((uintptr_t)p & ~(uintptr_t)(PageArena::CHUNK_SIZE - 1));
+}
+
+/** The pool the calling thread allocates from, handed out in turn. */
+size_t ThreadPoolIndex()
+{
+    static std::atomic<size_t> nNext(0);
+    static thread_local size_t nIndex = nNext++;
+    return nIndex;
+}
+
+/** The online NUMA nodes as a bit mask, from a list such as "0-1,3". */
+uint64_t OnlineNumaNodes()
+{
+    FILE* file = fopen("/sys/devices/system/node/online", "r");
+    if (!file)
+        return 1;
+    char list[256];
+    bool ok = fgets(list, sizeof(list), file) != NULL;
+    fclose(file);
+    uint64_t mask = 0;
+    for (const char* p = list; ok && *p >= '0' && *p <= '9';) {
+        char* end;
+        unsigned long nFirst = strtoul(p, &end, 10);
+        unsigned long nLast = nFirst;
+        if (*end == '-')
+            nLast = strtoul(end + 1, &end, 10);
+        for (unsigned long n = nFirst; n <= nLast && n < 64; n++)
+            mask |= 1ULL << n;
+        p = *end == ',' ? end + 1 : end;
+    }
+    return mask ? mask : 1;
+}
+
+} // namespace
+
+const size_t PageArena::CHUNK_SIZE;
+const size_t PageArena::MAX_SMALL_SIZE;
+const size_t PageArena::MAX_MID_SIZE;
+
+PageArena::PageArena(const Options& options) : options(options)
+{
+}
+
+PageArena::~PageArena()
+{
+    for (size_t i = 0; i < chunks.size(); i++)
+        munmap(chunks[i], CHUNK_SIZE);
+}
+
+PageArena& PageArena::Default()
+{
+    // Never destroyed: static containers may free into it during exit.
+    static PageArena* arena = new PageArena();
+    return *arena;
+}
+
+void PageArena::SetOptions(const Options& optionsIn)
+{
+    std::lock_guard<std::mutex> lock(mapMutex);
+    options = optionsIn;
+}
+
+PageArena::Options PageArena::GetOptions() const
+{
+    std::lock_guard<std::mutex> lock(mapMutex);
+    return options;
+}
+
+PageArena::Stats PageArena::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(mapMutex);
+    return stats;
+}
+
+const char* PageArena::HugePagesName(HugePages hugePages)
+{
+    switch (hugePages) {
+    case HUGEPAGES_OFF:
+        return "off";
+    case HUGEPAGES_TRANSPARENT:
+        return "transparent";
+    case HUGEPAGES_EXPLICIT:
+        return "explicit";
+    }
+    return "unknown";
+}
+
+int PageArena::NumaNodes()
+{
+    return __builtin_popcountll(OnlineNumaNodes());
+}
+
+void* PageArena::Map(size_t nSize)
+{
+    std::unique_lock<std::mutex> lock(mapMutex);
+    Options current = options;
+    lock.unlock();
+
+    void* p = MAP_FAILED;
+    bool fExplicit = false;
+#ifdef MAP_HUGETLB
+    if (current.hugePages == HUGEPAGES_EXPLICIT) {
+        // Explicit huge pages come aligned to their size.
+        p = mmap(NULL, nSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        fExplicit = p != MAP_FAILED;
+    }
+#endif
+    if (!fExplicit) {
+        // Over-allocate by a chunk and trim to an aligned range.
+        unsigned char* base = (unsigned char*)mmap(NULL, nSize + CHUNK_SIZE, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED)
+            return NULL;
+        size_t nHead = (CHUNK_SIZE - (uintptr_t)base % CHUNK_SIZE) % CHUNK_SIZE;
+        if (nHead)
+            munmap(base, nHead);
+        munmap(base + nHead + nSize, CHUNK_SIZE - nHead);
+        p = base + nHead;
+#ifdef MADV_HUGEPAGE
+        if (current.hugePages != HUGEPAGES_OFF)
+            madvise(p, nSize, MADV_HUGEPAGE);
+#endif
+    }
+
+    // Before any page is touched, or they are placed already.
+    bool fInterleaved = false;
+#ifdef SYS_mbind
+    uint64_t nodes = current.fNumaInterleave ? OnlineNumaNodes() : 1;
+    if (nodes & (nodes - 1)) {
+        unsigned long mask = (unsigned long)nodes;
+        fInterleaved = syscall(SYS_mbind, p, nSize, MPOL_INTERLEAVE_MODE, &mask, 8 * sizeof(mask) + 1, 0) == 0;
+    }
+#endif
+
+    lock.lock();
+    stats.nMappedBytes += nSize;
+    if (fExplicit)
+        stats.nExplicitBytes += nSize;
+    else if (current.hugePages == HUGEPAGES_EXPLICIT)
+        stats.nExplicitFallbacks++;
+    if (fInterleaved)
+        stats.nInterleaved++;
+    return p;
+}
+
+void PageArena::Unmap(void* p, size_t nSize)
+{
+    munmap(p, nSize);
+    std::lock_guard<std::mutex> lock(mapMutex);
+    stats.nMappedBytes -= nSize;
+}
+
+void PageArena::ReleaseChunks(const std::set<void*>& released)
+{
+    if (released.empty())
+        return;
+    for (std::set<void*>::const_iterator it = released.begin(); it != released.end(); ++it)
+        Unmap(*it, CHUNK_SIZE);
+    std::lock_guard<std::mutex> lock(mapMutex);
+    size_t nKept = 0;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        if (!released.count(chunks[i]))
+            chunks[nKept++] = chunks[i];
+    }
+    chunks.resize(nKept);
+}
+
+void* PageArena::Allocate(size_t nSize)
+{
+    if (nSize > MAX_SMALL_SIZE) {
+        if (nSize <= MAX_MID_SIZE)
+            return AllocateMid(nSize);
+        void* p = Map((nSize + CHUNK_SIZE - 1) / CHUNK_SIZE * CHUNK_SIZE);
+        if (!p)
+            throw std::bad_alloc();
+        return p;
+    }
+    size_t nClass = nSize == 0 ? 0 : (nSize - 1) / 16;
+    size_t nBytes = (nClass + 1) * 16;
+    size_t nPool = ThreadPoolIndex() % NUM_POOLS;
+    Pool& pool = pools[nPool];
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    void* p = pool.freeList[nClass];
+    if (p) {
+        pool.freeList[nClass] = *(void**)p;
+    } else {
+        if (pool.nBumpLeft < nBytes) {
+            unsigned char* chunk = (unsigned char*)Map(CHUNK_SIZE);
+            if (!chunk)
+                throw std::bad_alloc();
+            {
+                std::lock_guard<std::mutex> mapLock(mapMutex);
+                chunks.push_back(chunk);
+            }
+            ChunkHeader* header = (ChunkHeader*)chunk;
+            header->nPool = nPool;
+            header->nLive = 0;
+            pool.pBumpChunk = chunk;
+            pool.pBump = chunk + CHUNK_HEADER_SIZE;
+            pool.nBumpLeft = CHUNK_SIZE - CHUNK_HEADER_SIZE;
+        }
+        p = pool.pBump;
+        pool.pBump += nBytes;
+        pool.nBumpLeft -= nBytes;
+    }
+    ((ChunkHeader*)ChunkOf(p))->nLive++;
+    return p;
+}
+
+void PageArena::Deallocate(void* p, size_t nSize)
+{
+    if (!p)
+        return;
+    if (nSize > MAX_SMALL_SIZE) {
+        if (nSize <= MAX_MID_SIZE)
+            DeallocateMid(p, nSize);
+        else
+            Unmap(p, (nSize + CHUNK_SIZE - 1) / CHUNK_SIZE * CHUNK_SIZE);
+        return;
+    }
+    size_t nClass = nSize == 0 ? 0 : (nSize - 1) / 16;
+    ChunkHeader* header = (ChunkHeader*)ChunkOf(p);
+    Pool& pool = pools[header->nPool];
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    *(void**)p = pool.freeList[nClass];
+    pool.freeList[nClass] = p;
+    header->nLive--;
+}
+
+void* PageArena::AllocateMid(size_t nSize)
+{
+    size_t nClass = 0;
+    while (((size_t)1 << (MIN_MID_SHIFT + nClass)) < nSize)
+        nClass++;
+    size_t nBytes = (size_t)1 << (MIN_MID_SHIFT + nClass);
+    std::lock_guard<std::mutex> lock(midMutex);
+    std::vector<void*>& freeBlocks = midFree[nClass];
+    if (freeBlocks.empty()) {
+        unsigned char* chunk = (unsigned char*)Map(CHUNK_SIZE);
+        if (!chunk)
+            throw std::bad_alloc();
+        {
+            std::lock_guard<std::mutex> mapLock(mapMutex);
+            chunks.push_back(chunk);
+        }
+        MidChunk& mid = midChunks[chunk];
+        mid.nClass = nClass;
+        mid.nLive = 0;
+        // Lowest address first.
+        for (size_t nOffset = CHUNK_SIZE; nOffset > 0; nOffset -= nBytes)
+            freeBlocks.push_back(chunk + nOffset - nBytes);
+    }
+    void* p = freeBlocks.back();
+    freeBlocks.pop_back();
+    midChunks[ChunkOf(p)].nLive++;
+    return p;
+}
+
+void PageArena::DeallocateMid(void* p, size_t nSize)
+{
+    size_t nClass = 0;
+    while (((size_t)1 << (MIN_MID_SHIFT + nClass)) < nSize)
+        nClass++;
+    std::lock_guard<std::mutex> lock(midMutex);
+    midFree[nClass].push_back(p);
+    midChunks[ChunkOf(p)].nLive--;
+}
+
+size_t PageArena::Trim()
+{
+    std::set<void*> released;
+    for (size_t nPool = 0; nPool < NUM_POOLS; nPool++) {
+        Pool& pool = pools[nPool];
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        // Every block of an idle chunk is on one of its pool's free lists.
+        for (size_t nClass = 0; nClass < NUM_CLASSES; nClass++) {
+            void** link = &pool.freeList[nClass];
+            while (*link) {
+                unsigned char* chunk = ChunkOf(*link);
+                if (((ChunkHeader*)chunk)->nLive == 0) {
+                    released.insert(chunk);
+                    *link = *(void**)*link;
+                } else {
+                    link = (void**)*link;
+                }
+            }
+        }
+        if (pool.pBumpChunk && ((ChunkHeader*)pool.pBumpChunk)->nLive == 0) {
+            released.insert(pool.pBumpChunk);
+            pool.pBumpChunk = NULL;
+            pool.pBump = NULL;
+            pool.nBumpLeft = 0;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(midMutex);
+        std::set<void*> idle;
+        for (std::map<void*, MidChunk>::iterator it = midChunks.begin(); it != midChunks.end();) {
+            if (it->second.nLive == 0) {
+                idle.insert(it->first);
+                midChunks.erase(it++);
+            } else {
+                ++it;
+            }
+        }
+        for (size_t nClass = 0; nClass < NUM_MID_CLASSES && !idle.empty(); nClass++) {
+            std::vector<void*>& freeBlocks = midFree[nClass];
+            size_t nKept = 0;
+            for (size_t i = 0; i < freeBlocks.size(); i++) {
+                if (!idle.count(ChunkOf(freeBlocks[i])))
+                    freeBlocks[nKept++] = freeBlocks[i];
+            }
+            freeBlocks.resize(nKept);
+        }
+        released.insert(idle.begin(), idle.end());
+    }
+    ReleaseChunks(released);
+    return released.size() * CHUNK_SIZE;
+}
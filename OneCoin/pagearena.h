@@ -0,0 +1,199 @@
+#ifndef ONECOIN_PAGEARENA_H
+#define ONECOIN_PAGEARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <map>
+#include <mutex>
+#include <set>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Memory for the large in-memory caches, the UTXO cache above all. Blocks
+ * are carved from 2 MiB chunks aligned so each can be backed by one huge
+ * page: small ones such as hash map nodes in steps of 16 bytes, mid-size
+ * ones such as the bucket arrays of all but the largest maps in powers of
+ * two, each size from chunks of its own. Blocks over half a chunk get a
+ * mapping of their own. Random lookups across a cache of many gigabytes
+ * are bound by TLB misses with 4 KiB pages, and one 2 MiB entry covers
+ * what 512 small ones do.
+ *
+ * Options decide how memory mapped from then on is backed: transparent
+ * huge pages asked for with madvise, or explicit ones from the pool the
+ * administrator reserved (MAP_HUGETLB), falling back to transparent ones
+ * when that pool is empty; and on machines with more than one NUMA node,
+ * pages interleaved across all of them, so lookups spread over every
+ * socket's memory instead of all going to the one that first touched it.
+ *
+ * Thread-safe. Threads allocate from one of several pools, each behind
+ * its own lock, so connect threads rarely contend; a freed block goes back
+ * to the pool of the chunk it came from. Freed memory is reused; Trim()
+ * returns the chunks nothing is allocated from any more to the system,
+ * e.g. once a flush has emptied a cache. Destroying the arena returns the
+ * rest, and must not happen before everything allocated from it is freed.
+ */
+class PageArena {
+public:
+    enum HugePages {
+        HUGEPAGES_OFF,
+        HUGEPAGES_TRANSPARENT,
+        HUGEPAGES_EXPLICIT,
+    };
+
+    struct Options {
+        HugePages hugePages;
+        bool fNumaInterleave;
+
+        Options() : hugePages(HUGEPAGES_OFF), fNumaInterleave(false) {}
+    };
+
+    struct Stats {
+        /** Bytes in chunks and large blocks. */
+        uint64_t nMappedBytes;
+        /** Of those, bytes in explicit huge pages. */
+        uint64_t nExplicitBytes;
+        /** Mappings that asked for explicit huge pages and got transparent
+         *  ones. */
+        uint64_t nExplicitFallbacks;
+        /** Mappings interleaved across NUMA nodes. */
+        uint64_t nInterleaved;
+
+        Stats() : nMappedBytes(0), nExplicitBytes(0), nExplicitFallbacks(0), nInterleaved(0) {}
+    };
+
+    static const size_t CHUNK_SIZE = 2 << 20;
+    /** Blocks up to this size come from per-thread pools, in steps of 16
+     *  bytes. */
+    static const size_t MAX_SMALL_SIZE = 512;
+    /** Blocks up to this size come from chunks split into powers of two. */
+    static const size_t MAX_MID_SIZE = CHUNK_SIZE / 2;
+
+    explicit PageArena(const Options& options = Options());
+    ~PageArena();
+
+    /** The arena of default-constructed allocators; never destroyed. */
+    static PageArena& Default();
+
+    /** Applies to memory mapped from now on. */
+    void SetOptions(const Options& options);
+    Options GetOptions() const;
+    Stats GetStats() const;
+
+    /** Throws std::bad_alloc when out of memory. */
+    void* Allocate(size_t nSize);
+    /** nSize as passed to Allocate(). */
+    void Deallocate(void* p, size_t nSize);
+    /** Unmaps every chunk with no block allocated from it; returns the
+     *  bytes released. */
+    size_t Trim();
+
+    static const char* HugePagesName(HugePages hugePages);
+    /** Online NUMA nodes; 1 where the system does not say. */
+    static int NumaNodes();
+
+private:
+    static const size_t NUM_POOLS = 16;
+    static const size_t NUM_CLASSES = MAX_SMALL_SIZE / 16;
+    /** Mid-size blocks are 1 KiB to MAX_MID_SIZE. */
+    static const int MIN_MID_SHIFT = 10;
+    static const size_t NUM_MID_CLASSES = 11;
+
+    /** Room for a ChunkHeader, keeping blocks 16-byte aligned. */
+    static const size_t CHUNK_HEADER_SIZE = 16;
+
+    /** Ahead of the blocks of a small-block chunk. */
+    struct ChunkHeader {
+        size_t nPool;
+        /** Blocks allocated and not yet freed. */
+        size_t nLive;
+    };
+
+    struct Pool {
+        std::mutex mutex;
+        void* freeList[NUM_CLASSES];
+        unsigned char* pBumpChunk;
+        unsigned char* pBump;
+        size_t nBumpLeft;
+        /** Keeps pools apart on separate cache lines. */
+        char padding[64];
+
+        Pool() : pBumpChunk(NULL), pBump(NULL), nBumpLeft(0)
+        {
+            for (size_t i = 0; i < NUM_CLASSES; i++)
+                freeList[i] = NULL;
+        }
+    };
+
+    /** A chunk of mid-size blocks, which have no room for a header. */
+    struct MidChunk {
+        size_t nClass;
+        size_t nLive;
+    };
+
+    Pool pools[NUM_POOLS];
+
+    std::mutex midMutex;
+    std::vector<void*> midFree[NUM_MID_CLASSES];
+    std::map<void*, MidChunk> midChunks;
+
+    mutable std::mutex mapMutex;
+    Options options;
+    Stats stats;
+    std::vector<void*> chunks;
+
+    /** nSize bytes, a multiple of CHUNK_SIZE, aligned to CHUNK_SIZE and
+     *  backed as the options say; NULL on failure. */
+    void* Map(size_t nSize);
+    void Unmap(void* p, size_t nSize);
+    /** Unmaps chunks and forgets them. */
+    void ReleaseChunks(const std::set<void*>& released);
+
+    void* AllocateMid(size_t nSize);
+    void DeallocateMid(void* p, size_t nSize);
+
+    PageArena(const PageArena&);
+    PageArena& operator=(const PageArena&);
+};
+
+/** A standard allocator over a PageArena, PageArena::Default() unless
+ *  given another; containers moved or swapped take theirs along. */
+template <typename T>
+class ArenaAllocator {
+    static_assert(alignof(T) <= 16, "arena blocks are 16-byte aligned");
+
+public:
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    ArenaAllocator() : arena(&PageArena::Default()) {}
+    explicit ArenaAllocator(PageArena* arena) : arena(arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.GetArena())
+    {
+    }
+
+    T* allocate(size_t n) { return static_cast<T*>(arena->Allocate(n * sizeof(T))); }
+    void deallocate(T* p, size_t n) { arena->Deallocate(p, n * sizeof(T)); }
+
+    PageArena* GetArena() const { return arena; }
+
+private:
+    PageArena* arena;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)
+{
+    return a.GetArena() == b.GetArena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)
+{
+    return a.GetArena() != b.GetArena();
+}
+
+#endif // ONECOIN_PAGEARENA_H
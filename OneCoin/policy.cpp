@@ -0,0 +1,207 @@
+#include "policy.h"
+#include "script.h"
+#include "serialize.h"
+
+namespace {
+
+/** Script::GetOp over raw bytes, without building a Script. */
+bool GetRawOp(const unsigned char*& pc, const unsigned char* end, unsigned int& op, size_t& nPushSize)
+{
+    if (pc >= end)
+        return false;
+    op = *pc++;
+    nPushSize = 0;
+    if (op > OP_PUSHDATA4)
+        return true;
+    if (op < OP_PUSHDATA1) {
+        nPushSize = op;
+    } else if (op == OP_PUSHDATA1) {
+        if (end - pc < 1)
+            return false;
+        nPushSize = *pc++;
+    } else if (op == OP_PUSHDATA2) {
+        if (end - pc < 2)
+            return false;
+        nPushSize = ReadLE16(pc);
+        pc += 2;
+    } else {
+        if (end - pc < 4)
+            return false;
+        nPushSize = ReadLE32(pc);
+        pc += 4;
+    }
+    if ((size_t)(end - pc) < nPushSize)
+        return false;
+    pc += nPushSize;
+    return true;
+}
+
+/** Sigops of a script; a truncated push ends the count, as it ends the
+ *  script. fPushOnly tells whether every op is a push. */
+unsigned int ScanScript(const unsigned char* script, size_t nSize, bool& fPushOnly)
+{
+    const unsigned char* pc = script;
+    const unsigned char* end = script + nSize;
+    unsigned int nSigOps = 0;
+    unsigned int op;
+    size_t nPush;
+    fPushOnly = true;
+    while (pc < end) {
+        if (!GetRawOp(pc, end, op, nPush)) {
+            fPushOnly = false;
+            break;
+        }
+        if (op > OP_16)
+            fPushOnly = false;
+        if (op == OP_CHECKSIG || op == OP_CHECKSIGVERIFY)
+            nSigOps++;
+        else if (op == OP_CHECKMULTISIG || op == OP_CHECKMULTISIGVERIFY)
+            nSigOps += 20;
+    }
+    return nSigOps;
+}
+
+bool IsPubKeyPush(const unsigned char* p, const unsigned char* end)
+{
+    if (end - p >= 34 && p[0] == 33 && (p[1] == 0x02 || p[1] == 0x03))
+        return true;
+    return end - p >= 66 && p[0] == 65 && p[1] == 0x04;
+}
+
+/** Bare m-of-n multisig with 1 <= m <= n <= MAX_STANDARD_BARE_MULTISIG_KEYS. */
+bool IsStandardMultisig(const unsigned char* script, size_t nSize)
+{
+    const unsigned char* end = script + nSize;
+    if (nSize < 37 || script[nSize - 1] != OP_CHECKMULTISIG)
+        return false;
+    if (script[0] < OP_1 || script[0] > OP_16 || end[-2] < OP_1 || end[-2] > OP_16)
+        return false;
+    int nRequired = Script::DecodeOP_N((opcodetype)script[0]);
+    int nKeys = Script::DecodeOP_N((opcodetype)end[-2]);
+    if (nRequired > nKeys || nKeys > MAX_STANDARD_BARE_MULTISIG_KEYS)
+        return false;
+    const unsigned char* pc = script + 1;
+    for (int i = 0; i < nKeys; i++) {
+        if (!IsPubKeyPush(pc, end - 2))
+            return false;
+        pc += pc[0] + 1;
+    }
+    return pc == end - 2;
+}
+
+enum OutputKind {
+    OUTPUT_NONSTANDARD,
+    OUTPUT_PAYMENT,
+    OUTPUT_NULL_DATA,
+};
+
+OutputKind ClassifyOutput(const unsigned char* script, size_t nSize)
+{
+    // P2PKH, P2SH, then P2PK with a compressed or uncompressed key.
+    if (nSize == 25 && script[0] == OP_DUP && script[1] == OP_HASH160 && script[2] == 0x14 &&
+        script[23] == OP_EQUALVERIFY && script[24] == OP_CHECKSIG)
+        return OUTPUT_PAYMENT;
+    if (nSize == 23 && script[0] == OP_HASH160 && script[1] == 0x14 && script[22] == OP_EQUAL)
+        return OUTPUT_PAYMENT;
+    if ((nSize == 35 || nSize == 67) && script[nSize - 1] == OP_CHECKSIG && IsPubKeyPush(script, script + nSize - 1))
+        return OUTPUT_PAYMENT;
+    if (IsStandardMultisig(script, nSize))
+        return OUTPUT_PAYMENT;
+    if (nSize >= 1 && script[0] == OP_RETURN && nSize <= MAX_OP_RETURN_RELAY) {
+        bool fPushOnly;
+        ScanScript(script + 1, nSize - 1, fPushOnly);
+        if (fPushOnly)
+            return OUTPUT_NULL_DATA;
+    }
+    return OUTPUT_NONSTANDARD;
+}
+
+bool Reject(std::string& reason, const char* why)
+{
+    reason = why;
+    return false;
+}
+
+} // namespace
+
+Amount GetDustThreshold(const unsigned char* script, size_t nScriptSize)
+{
+    if ((nScriptSize >= 1 && script[0] == OP_RETURN) || nScriptSize > MAX_SCRIPT_SIZE)
+        return 0;
+    // The output itself, plus the input that spends it later: outpoint,
+    // sequence and a scriptSig with one signature and a compressed key.
+    size_t nOutputSize = 8 + GetCompactSizeLen(nScriptSize) + nScriptSize;
+    size_t nSpendSize = 32 + 4 + 1 + 107 + 4;
+    return (Amount)(nOutputSize + nSpendSize) * DUST_RELAY_TX_FEE / 1000;
+}
+
+bool CheckTransactionPolicy(const unsigned char* data, size_t len, TxPolicyStats& stats, std::string& reason)
+{
+    stats = TxPolicyStats();
+    stats.nSize = len;
+    stats.nWeight = (int64_t)len * WITNESS_SCALE_FACTOR;
+    if (stats.nWeight > MAX_STANDARD_TX_WEIGHT)
+        return Reject(reason, "tx-size");
+    if (len < MIN_STANDARD_TX_SIZE)
+        return Reject(reason, "tx-size-small");
+
+    try {
+        ByteReader r(data, len);
+        int32_t nVersion = (int32_t)r.ReadU32();
+        if (nVersion < 1 || nVersion > MAX_STANDARD_VERSION)
+            return Reject(reason, "version");
+
+        stats.nInputs = r.ReadCompactSize();
+        if (stats.nInputs == 0)
+            return Reject(reason, "bad-txns-vin-empty");
+        for (size_t i = 0; i < stats.nInputs; i++) {
+            r.Skip(36);
+            size_t nScriptSize = r.ReadCompactSize();
+            const unsigned char* script = r.Position();
+            r.Skip(nScriptSize);
+            if (nScriptSize > MAX_STANDARD_SCRIPTSIG_SIZE)
+                return Reject(reason, "scriptsig-size");
+            bool fPushOnly;
+            stats.nSigOps += ScanScript(script, nScriptSize, fPushOnly);
+            if (!fPushOnly)
+                return Reject(reason, "scriptsig-not-pushonly");
+            r.Skip(4);
+        }
+
+        stats.nOutputs = r.ReadCompactSize();
+        if (stats.nOutputs == 0)
+            return Reject(reason, "bad-txns-vout-empty");
+        size_t nDataOutputs = 0;
+        for (size_t i = 0; i < stats.nOutputs; i++) {
+            Amount nValue = (Amount)r.ReadU64();
+            size_t nScriptSize = r.ReadCompactSize();
+            const unsigned char* script = r.Position();
+            r.Skip(nScriptSize);
+            if (nValue < 0)
+                return Reject(reason, "bad-txns-vout-negative");
+            if (nValue > MAX_MONEY)
+                return Reject(reason, "bad-txns-vout-toolarge");
+            stats.nValueOut += nValue;
+            if (!MoneyRange(stats.nValueOut))
+                return Reject(reason, "bad-txns-txouttotal-toolarge");
+            OutputKind kind = ClassifyOutput(script, nScriptSize);
+            if (kind == OUTPUT_NONSTANDARD)
+                return Reject(reason, "scriptpubkey");
+            if (kind == OUTPUT_NULL_DATA && ++nDataOutputs > 1)
+                return Reject(reason, "multi-op-return");
+            if (nValue < GetDustThreshold(script, nScriptSize))
+                return Reject(reason, "dust");
+            bool fPushOnly;
+            stats.nSigOps += ScanScript(script, nScriptSize, fPushOnly);
+        }
+        r.Skip(4);
+        if (!r.Empty())
+            return Reject(reason, "tx-trailing-data");
+    } catch (const SerializeError&) {
+        return Reject(reason, "tx-decode");
+    }
+
+    if (stats.nSigOps > MAX_STANDARD_TX_SIGOPS)
+        return Reject(reason, "bad-txns-too-many-sigops");
+    return true;
+}
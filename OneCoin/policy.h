@@ -0,0 +1,60 @@
+#ifndef ONECOIN_POLICY_H
+#define ONECOIN_POLICY_H
+
+#include "amount.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+/**
+ * Relay policy: which transactions a node forwards and holds for mining,
+ * beyond what consensus allows. None of it applies to blocks.
+ */
+
+/** Weight is four units per byte; there is no witness data to discount. */
+static const unsigned int WITNESS_SCALE_FACTOR = 4;
+static const int64_t MAX_STANDARD_TX_WEIGHT = 400000;
+/** Smaller transactions could be confused with the inner nodes of a merkle tree. */
+static const size_t MIN_STANDARD_TX_SIZE = 65;
+static const int32_t MAX_STANDARD_VERSION = 2;
+/** Enough for a 15-of-15 multisig spend through P2SH. */
+static const size_t MAX_STANDARD_SCRIPTSIG_SIZE = 1650;
+static const unsigned int MAX_STANDARD_TX_SIGOPS = 4000;
+/** Bare multisig outputs relay with at most this many keys. */
+static const int MAX_STANDARD_BARE_MULTISIG_KEYS = 3;
+/** OP_RETURN plus up to 80 bytes of data. */
+static const size_t MAX_OP_RETURN_RELAY = 83;
+/** Fee rate, per 1000 bytes, at which spending an output costs more than
+ *  it is worth. */
+static const Amount DUST_RELAY_TX_FEE = 3000;
+
+/** Outputs below this are dust: spending them would cost more in fees at
+ *  DUST_RELAY_TX_FEE than they hold. Zero for unspendable scripts. */
+Amount GetDustThreshold(const unsigned char* script, size_t nScriptSize);
+
+/** Counts of a transaction that passed CheckTransactionPolicy. */
+struct TxPolicyStats {
+    size_t nSize;
+    int64_t nWeight;
+    /** CHECKSIG counts one and CHECKMULTISIG twenty, in every script;
+     *  signatures inside P2SH redeem scripts need the spent coins and are
+     *  counted once those are known. */
+    unsigned int nSigOps;
+    size_t nInputs;
+    size_t nOutputs;
+    Amount nValueOut;
+
+    TxPolicyStats() : nSize(0), nWeight(0), nSigOps(0), nInputs(0), nOutputs(0), nValueOut(0) {}
+};
+
+/**
+ * Checks size, weight, sigops, output values, dust and standardness of a
+ * serialized transaction in one pass over its bytes, without building a
+ * Transaction. Meant to run first on anything a peer relays, so spam is
+ * turned away before any allocation; whatever passes still needs the full
+ * checks. On failure reason holds the reject reason.
+ */
+bool CheckTransactionPolicy(const unsigned char* data, size_t len, TxPolicyStats& stats, std::string& reason);
+
+#endif // ONECOIN_POLICY_H
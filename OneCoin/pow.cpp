@@ -0,0 +1,74 @@
+#include "pow.h"
+
+bool CheckProofOfWork(const uint256& hash, uint32_t nBits, const ConsensusParams& params)
+{
+    bool fNegative, fOverflow;
+    arith_uint256 target;
+    target.SetCompact(nBits, &fNegative, &fOverflow);
+    if (fNegative || fOverflow || target == 0 || target > params.powLimit)
+        return false;
+    return UintToArith256(hash) <= target;
+}
+
+arith_uint256 GetBlockProof(uint32_t nBits)
+{
+    bool fNegative, fOverflow;
+    arith_uint256 target;
+    target.SetCompact(nBits, &fNegative, &fOverflow);
+    if (fNegative || fOverflow || target == 0)
+        return 0;
+    // 2**256 / (target+1) does not fit in 256 bits, but it equals
+    // (2**256 - target - 1) / (target + 1) + 1 = ~target / (target + 1) + 1.
+    return (~target / (target + 1)) + 1;
+}
+
+uint32_t CalculateNextWorkRequired(uint32_t lastBits, int64_t nFirstBlockTime, int64_t nLastBlockTime,
+    const ConsensusParams& params)
+{
+    if (params.fPowNoRetargeting)
+        return lastBits;
+
+    int64_t nActualTimespan = nLastBlockTime - nFirstBlockTime;
+    if (nActualTimespan < params.nPowTargetTimespan / 4)
+        nActualTimespan = params.nPowTargetTimespan / 4;
+    if (nActualTimespan > params.nPowTargetTimespan * 4)
+        nActualTimespan = params.nPowTargetTimespan * 4;
+
+    arith_uint256 bnNew;
+    bnNew.SetCompact(lastBits);
+    // Divide first when the product could overflow 256 bits.
+    bool fShift = bnNew.bits() > 256 - 32;
+    if (fShift)
+        bnNew >>= 32;
+    bnNew *= (uint32_t)nActualTimespan;
+    bnNew /= arith_uint256((uint64_t)params.nPowTargetTimespan);
+    if (fShift)
+        bnNew <<= 32;
+    if (bnNew > params.powLimit)
+        bnNew = params.powLimit;
+    return bnNew.GetCompact();
+}
+
+uint32_t GetNextWorkRequired(const BlockIndex* pindexLast, const ConsensusParams& params)
+{
+    int64_t interval = params.DifficultyAdjustmentInterval();
+    if ((pindexLast->nHeight + 1) % interval != 0)
+        return pindexLast->nBits;
+    const BlockIndex* pindexFirst = pindexLast->GetAncestor(pindexLast->nHeight - (int)(interval - 1));
+    return CalculateNextWorkRequired(pindexLast->nBits, pindexFirst->GetBlockTime(), pindexLast->GetBlockTime(), params);
+}
+
+double GetDifficulty(uint32_t nBits)
+{
+    int nShift = (nBits >> 24) & 0xff;
+    double dDiff = (double)0x0000ffff / (double)(nBits & 0x00ffffff);
+    while (nShift < 29) {
+        dDiff *= 256.0;
+        nShift++;
+    }
+    while (nShift > 29) {
+        dDiff /= 256.0;
+        nShift--;
+    }
+    return dDiff;
+}
@@ -0,0 +1,30 @@
+#ifndef ONECOIN_POW_H
+#define ONECOIN_POW_H
+
+#include "arith_uint256.h"
+#include "chain.h"
+#include "consensus.h"
+#include "uint256.h"
+
+#include <stdint.h>
+
+/** True when hash meets the target encoded in nBits and nBits is within the
+ *  chain's proof-of-work limit. */
+bool CheckProofOfWork(const uint256& hash, uint32_t nBits, const ConsensusParams& params);
+
+/** Expected number of hashes needed to find a block at nBits; this is what
+ *  chainwork sums. Zero for an invalid nBits. */
+arith_uint256 GetBlockProof(uint32_t nBits);
+
+/** nBits for the block after a full retarget interval spanning
+ *  [nFirstBlockTime, nLastBlockTime] and ending at lastBits. */
+uint32_t CalculateNextWorkRequired(uint32_t lastBits, int64_t nFirstBlockTime, int64_t nLastBlockTime,
+    const ConsensusParams& params);
+
+/** nBits required for the block after pindexLast. */
+uint32_t GetNextWorkRequired(const BlockIndex* pindexLast, const ConsensusParams& params);
+
+/** Difficulty relative to the minimum (nBits 0x1d00ffff), for display. */
+double GetDifficulty(uint32_t nBits);
+
+#endif // ONECOIN_POW_H
@@ -0,0 +1,136 @@
+#include "script.h"
+#include "serialize.h"
+
+std::vector<unsigned char> ScriptNumSerialize(int64_t value)
+{
+    std::vector<unsigned char> result;
+    if (value == 0)
+        return result;
+    bool neg = value < 0;
+    uint64_t absvalue = neg ? ~(uint64_t)value + 1 : (uint64_t)value;
+    while (absvalue) {
+        result.push_back(absvalue & 0xff);
+        absvalue >>= 8;
+    }
+    // If the top byte already has its high bit set, add a byte for the sign.
+    if (result.back() & 0x80)
+        result.push_back(neg ? 0x80 : 0);
+    else if (neg)
+        result.back() |= 0x80;
+    return result;
+}
+
+Script& Script::operator<<(opcodetype opcode)
+{
+    push_back((unsigned char)opcode);
+    return *this;
+}
+
+Script& Script::operator<<(int64_t n)
+{
+    if (n == -1 || (n >= 1 && n <= 16)) {
+        push_back((unsigned char)(n + (OP_1 - 1)));
+    } else if (n == 0) {
+        push_back(OP_0);
+    } else {
+        *this << ScriptNumSerialize(n);
+    }
+    return *this;
+}
+
+Script& Script::operator<<(const std::vector<unsigned char>& data)
+{
+    if (data.size() < OP_PUSHDATA1) {
+        push_back((unsigned char)data.size());
+    } else if (data.size() <= 0xff) {
+        push_back(OP_PUSHDATA1);
+        push_back((unsigned char)data.size());
+    } else if (data.size() <= 0xffff) {
+        push_back(OP_PUSHDATA2);
+        unsigned char len[2];
+        WriteLE16(len, (uint16_t)data.size());
+        insert(end(), len, len + 2);
+    } else {
+        push_back(OP_PUSHDATA4);
+        unsigned char len[4];
+        WriteLE32(len, (uint32_t)data.size());
+        insert(end(), len, len + 4);
+    }
+    insert(end(), data.begin(), data.end());
+    return *this;
+}
+
+bool Script::GetOp(const_iterator& pc, opcodetype& opcode, std::vector<unsigned char>* data) const
+{
+    opcode = OP_INVALIDOPCODE;
+    if (data)
+        data->clear();
+    if (pc >= end())
+        return false;
+
+    unsigned int op = *pc++;
+    if (op <= OP_PUSHDATA4) {
+        size_t nSize = 0;
+        if (op < OP_PUSHDATA1) {
+            nSize = op;
+        } else if (op == OP_PUSHDATA1) {
+            if (end() - pc < 1)
+                return false;
+            nSize = *pc++;
+        } else if (op == OP_PUSHDATA2) {
+            if (end() - pc < 2)
+                return false;
+            nSize = ReadLE16(&*pc);
+            pc += 2;
+        } else {
+            if (end() - pc < 4)
+                return false;
+            nSize = ReadLE32(&*pc);
+            pc += 4;
+        }
+        if ((size_t)(end() - pc) < nSize)
+            return false;
+        if (data)
+            data->assign(pc, pc + nSize);
+        pc += nSize;
+    }
+    opcode = (opcodetype)op;
+    return true;
+}
+
+bool Script::IsPushOnly() const
+{
+    const_iterator pc = begin();
+    while (pc < end()) {
+        opcodetype opcode;
+        if (!GetOp(pc, opcode))
+            return false;
+        if (opcode > OP_16)
+            return false;
+    }
+    return true;
+}
+
+Script GetScriptForPubKeyHash(const unsigned char hash160[20])
+{
+    Script script;
+    script << OP_DUP << OP_HASH160 << std::vector<unsigned char>(hash160, hash160 + 20) << OP_EQUALVERIFY << OP_CHECKSIG;
+    return script;
+}
+
+Script GetScriptForScriptHash(const unsigned char hash160[20])
+{
+    Script script;
+    script << OP_HASH160 << std::vector<unsigned char>(hash160, hash160 + 20) << OP_EQUAL;
+    return script;
+}
+
+Script GetScriptForMultisig(int nRequired, const std::vector<std::vector<unsigned char> >& pubkeys)
+{
+    Script script;
+    script << Script::EncodeOP_N(nRequired);
+    for (size_t i = 0; i < pubkeys.size(); i++)
+        script << pubkeys[i];
+    script << Script::EncodeOP_N((int)pubkeys.size()) << OP_CHECKMULTISIG;
+    return script;
+}
@@ -0,0 +1,204 @@
+#ifndef ONECOIN_SERIALIZE_H
+#define ONECOIN_SERIALIZE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/** Little-endian integer encoding used by every on-wire and on-disk format. */
+
+inline uint16_t ReadLE16(const unsigned char* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+inline uint32_t ReadLE32(const unsigned char* p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+inline uint64_t ReadLE64(const unsigned char* p)
+{
+    return (uint64_t)ReadLE32(p) | (uint64_t)ReadLE32(p + 4) << 32;
+}
+
+inline void WriteLE16(unsigned char* p, uint16_t x)
+{
+    p[0] = (unsigned char)x;
+    p[1] = (unsigned char)(x >> 8);
+}
+
+inline void WriteLE32(unsigned char* p, uint32_t x)
+{
+    p[0] = (unsigned char)x;
+    p[1] = (unsigned char)(x >> 8);
+    p[2] = (unsigned char)(x >> 16);
+    p[3] = (unsigned char)(x >> 24);
+}
+
+inline void WriteLE64(unsigned char* p, uint64_t x)
+{
+    WriteLE32(p, (uint32_t)x);
+    WriteLE32(p + 4, (uint32_t)(x >> 32));
+}
+
+/** Thrown when a reader runs out of input or meets a malformed length. */
+class SerializeError : public std::runtime_error {
+public:
+    explicit SerializeError(const std::string& msg) : std::runtime_error(msg) {}
+};
+
+/** Upper bound for any length prefix we are willing to allocate for. */
+static const uint64_t MAX_SERIALIZED_SIZE = 0x02000000;
+
+inline size_t GetCompactSizeLen(uint64_t n)
+{
+    return n < 253 ? 1 : n <= 0xffff ? 3 : n <= 0xffffffff ? 5 : 9;
+}
+
+/** Appends serialized values to a byte vector. */
+class ByteWriter {
+public:
+    explicit ByteWriter(std::vector<unsigned char>& out) : out(out) {}
+
+    void WriteU8(uint8_t x) { out.push_back(x); }
+    void WriteU16(uint16_t x) { WriteLE16(Grow(2), x); }
+    void WriteU32(uint32_t x) { WriteLE32(Grow(4), x); }
+    void WriteU64(uint64_t x) { WriteLE64(Grow(8), x); }
+    void WriteBytes(const unsigned char* data, size_t len)
+    {
+        if (len)
+            memcpy(Grow(len), data, len);
+    }
+    void WriteCompactSize(uint64_t n)
+    {
+        if (n < 253) {
+            WriteU8((uint8_t)n);
+        } else if (n <= 0xffff) {
+            WriteU8(253);
+            WriteU16((uint16_t)n);
+        } else if (n <= 0xffffffff) {
+            WriteU8(254);
+            WriteU32((uint32_t)n);
+        } else {
+            WriteU8(255);
+            WriteU64(n);
+        }
+    }
+    /** Base-128, most significant group first, with one subtracted per
+     *  continuation so each value has exactly one encoding. */
+    void WriteVarInt(uint64_t n)
+    {
+        unsigned char tmp[10];
+        int len = 0;
+        while (true) {
+            tmp[len] = (unsigned char)((n & 0x7f) | (len ? 0x80 : 0x00));
+            if (n <= 0x7f)
+                break;
+            n = (n >> 7) - 1;
+            len++;
+        }
+        do {
+            WriteU8(tmp[len]);
+        } while (len--);
+    }
+    /** Length-prefixed byte string. */
+    void WriteVarBytes(const std::vector<unsigned char>& v)
+    {
+        WriteCompactSize(v.size());
+        WriteBytes(v.data(), v.size());
+    }
+
+private:
+    std::vector<unsigned char>& out;
+
+    unsigned char* Grow(size_t n)
+    {
+        out.resize(out.size() + n);
+        return &out[out.size() - n];
+    }
+};
+
+/** Reads serialized values from a byte range it does not own. */
+class ByteReader {
+public:
+    ByteReader(const unsigned char* data, size_t len) : pos(data), end(data + len) {}
+    explicit ByteReader(const std::vector<unsigned char>& v) : pos(v.data()), end(v.data() + v.size()) {}
+
+    uint8_t ReadU8() { return *Take(1); }
+    uint16_t ReadU16() { return ReadLE16(Take(2)); }
+    uint32_t ReadU32() { return ReadLE32(Take(4)); }
+    uint64_t ReadU64() { return ReadLE64(Take(8)); }
+    void ReadBytes(unsigned char* dst, size_t len)
+    {
+        if (len)
+            memcpy(dst, Take(len), len);
+    }
+    uint64_t ReadCompactSize()
+    {
+        uint8_t first = ReadU8();
+        uint64_t n;
+        if (first < 253) {
+            n = first;
+        } else if (first == 253) {
+            n = ReadU16();
+            if (n < 253)
+                throw SerializeError("non-canonical compact size");
+        } else if (first == 254) {
+            n = ReadU32();
+            if (n <= 0xffff)
+                throw SerializeError("non-canonical compact size");
+        } else {
+            n = ReadU64();
+            if (n <= 0xffffffff)
+                throw SerializeError("non-canonical compact size");
+        }
+        if (n > MAX_SERIALIZED_SIZE)
+            throw SerializeError("compact size too large");
+        return n;
+    }
+    uint64_t ReadVarInt()
+    {
+        uint64_t n = 0;
+        while (true) {
+            uint8_t byte = ReadU8();
+            if (n > (UINT64_MAX >> 7))
+                throw SerializeError("varint too large");
+            n = (n << 7) | (byte & 0x7f);
+            if (!(byte & 0x80))
+                return n;
+            if (n == UINT64_MAX)
+                throw SerializeError("varint too large");
+            n++;
+        }
+    }
+    void ReadVarBytes(std::vector<unsigned char>& v)
+    {
+        size_t len = ReadCompactSize();
+        const unsigned char* p = Take(len);
+        v.assign(p, p + len);
+    }
+    void Skip(size_t len) { Take(len); }
+
+    size_t Remaining() const { return end - pos; }
+    bool Empty() const { return pos == end; }
+    const unsigned char* Position() const { return pos; }
+
+private:
+    const unsigned char* pos;
+    const unsigned char* end;
+
+    const unsigned char* Take(size_t n)
+    {
+        if ((size_t)(end - pos) < n)
+            throw SerializeError("end of data");
+        const unsigned char* p = pos;
+        pos += n;
+        return p;
+    }
+};
+
+#endif // ONECOIN_SERIALIZE_H
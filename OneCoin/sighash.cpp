@@ -0,0 +1,89 @@
+#include "sighash.h"
+#include "hash.h"
+#include "serialize.h"
+
+namespace {
+
+/** scriptCode with OP_CODESEPARATORs dropped. */
+void WriteScriptCode(ByteWriter& w, const Script& scriptCode)
+{
+    Script::const_iterator pc = scriptCode.begin();
+    opcodetype opcode;
+    bool fHasSeparator = false;
+    while (pc < scriptCode.end() && scriptCode.GetOp(pc, opcode)) {
+        if (opcode == OP_CODESEPARATOR) {
+            fHasSeparator = true;
+            break;
+        }
+    }
+    if (!fHasSeparator) {
+        w.WriteVarBytes(scriptCode);
+        return;
+    }
+    Script stripped;
+    pc = scriptCode.begin();
+    Script::const_iterator begin = pc;
+    while (pc < scriptCode.end()) {
+        if (!scriptCode.GetOp(pc, opcode)) {
+            stripped.insert(stripped.end(), begin, scriptCode.end());
+            break;
+        }
+        if (opcode != OP_CODESEPARATOR)
+            stripped.insert(stripped.end(), begin, pc);
+        begin = pc;
+    }
+    w.WriteVarBytes(stripped);
+}
+
+} // namespace
+
+uint256 SignatureHash(const Script& scriptCode, const Transaction& txTo, unsigned int nIn, int nHashType)
+{
+    static const unsigned char one[32] = {1};
+    if (nIn >= txTo.vin.size())
+        return uint256(one);
+    bool fAnyoneCanPay = nHashType & SIGHASH_ANYONECANPAY;
+    bool fHashSingle = (nHashType & 0x1f) == SIGHASH_SINGLE;
+    bool fHashNone = (nHashType & 0x1f) == SIGHASH_NONE;
+    if (fHashSingle && nIn >= txTo.vout.size())
+        return uint256(one);
+
+    std::vector<unsigned char> buf;
+    buf.reserve(txTo.GetTotalSize() + scriptCode.size() + 4);
+    ByteWriter w(buf);
+    w.WriteU32((uint32_t)txTo.nVersion);
+
+    unsigned int nInputs = fAnyoneCanPay ? 1 : (unsigned int)txTo.vin.size();
+    w.WriteCompactSize(nInputs);
+    for (unsigned int i = 0; i < nInputs; i++) {
+        unsigned int n = fAnyoneCanPay ? nIn : i;
+        const TxIn& in = txTo.vin[n];
+        w.WriteBytes(in.prevout.hash.begin(), 32);
+        w.WriteU32(in.prevout.n);
+        if (n == nIn)
+            WriteScriptCode(w, scriptCode);
+        else
+            w.WriteCompactSize(0);
+        // Other inputs' sequences are not signed under NONE and SINGLE.
+        w.WriteU32(n != nIn && (fHashSingle || fHashNone) ? 0 : in.nSequence);
+    }
+
+    unsigned int nOutputs = fHashNone ? 0 : (fHashSingle ? nIn + 1 : (unsigned int)txTo.vout.size());
+    w.WriteCompactSize(nOutputs);
+    for (unsigned int i = 0; i < nOutputs; i++) {
+        if (fHashSingle && i != nIn) {
+            // Blank output: value -1 and an empty script.
+            w.WriteU64((uint64_t)-1);
+            w.WriteCompactSize(0);
+        } else {
+            w.WriteU64((uint64_t)txTo.vout[i].nValue);
+            w.WriteVarBytes(txTo.vout[i].scriptPubKey);
+        }
+    }
+    w.WriteU32(txTo.nLockTime);
+    w.WriteU32((uint32_t)nHashType);
+
+    unsigned char hash[32];
+    Sha256d(buf, hash);
+    return uint256(hash);
+}
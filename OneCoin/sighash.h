@@ -0,0 +1,26 @@
+#ifndef ONECOIN_SIGHASH_H
+#define ONECOIN_SIGHASH_H
+
+#include "script.h"
+#include "transaction.h"
+#include "uint256.h"
+
+/** Signature hash types; the last byte of every signature. */
+enum {
+    SIGHASH_ALL = 1,
+    SIGHASH_NONE = 2,
+    SIGHASH_SINGLE = 3,
+    SIGHASH_ANYONECANPAY = 0x80,
+};
+
+/**
+ * The digest a signature for input nIn commits to: the transaction with
+ * every scriptSig emptied except input nIn's, which is replaced by
+ * scriptCode, then the 4-byte hash type, hashed with SHA-256d. NONE and
+ * SINGLE blank other outputs and sequences; ANYONECANPAY keeps only input
+ * nIn. SINGLE without a matching output yields the value one, as the
+ * original client did.
+ */
+uint256 SignatureHash(const Script& scriptCode, const Transaction& txTo, unsigned int nIn, int nHashType);
+
+#endif // ONECOIN_SIGHASH_H
@@ -0,0 +1,225 @@
+#include "snapshot.h"
+#include "compressor.h"
+#include "crc32c.h"
+#include "fs.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace {
+
+/** Payload size at which the writer closes a record. */
+const size_t SNAPSHOT_RECORD_BYTES = 1 << 20;
+/** Largest record a reader accepts; one transaction may overshoot the
+ *  size above by the outputs of a whole block. */
+const uint32_t MAX_SNAPSHOT_RECORD = 64 << 20;
+const size_t SNAPSHOT_HEADER_SIZE = 4 + 4 + 32 + 8 + 4;
+const size_t RECORD_HEADER_SIZE = 4 + 4;
+
+/** Groups coins by transaction into records as they arrive in outpoint
+ *  order. */
+class RecordWriter {
+public:
+    explicit RecordWriter(FILE* file) : file(file), ok(true), nCoins(0), nBytes(0), nGroupCoins(0) {}
+
+    void Add(const OutPoint& outpoint, const Coin& coin)
+    {
+        if (nGroupCoins && outpoint.hash != txid)
+            EndGroup();
+        txid = outpoint.hash;
+        ByteWriter w(group);
+        w.WriteVarInt(outpoint.n);
+        SerializeCompressedCoin(w, coin);
+        nGroupCoins++;
+        nCoins++;
+    }
+
+    /** Writes what is pending; false if any write failed. */
+    bool Finish()
+    {
+        if (nGroupCoins)
+            EndGroup();
+        WriteRecord();
+        return ok;
+    }
+
+    uint64_t Coins() const { return nCoins; }
+    uint64_t Bytes() const { return nBytes; }
+
+private:
+    FILE* file;
+    bool ok;
+    uint64_t nCoins;
+    uint64_t nBytes;
+    std::vector<unsigned char> payload;
+    uint256 txid;
+    std::vector<unsigned char> group;
+    uint64_t nGroupCoins;
+
+    void EndGroup()
+    {
+        ByteWriter w(payload);
+        w.WriteBytes(txid.begin(), 32);
+        w.WriteCompactSize(nGroupCoins);
+        w.WriteBytes(group.data(), group.size());
+        group.clear();
+        nGroupCoins = 0;
+        if (payload.size() >= SNAPSHOT_RECORD_BYTES)
+            WriteRecord();
+    }
+
+    void WriteRecord()
+    {
+        if (payload.empty())
+            return;
+        unsigned char header[RECORD_HEADER_SIZE];
+        WriteLE32(header, (uint32_t)payload.size());
+        WriteLE32(header + 4, Crc32c(payload.data(), payload.size()));
+        ok = ok && fwrite(header, 1, sizeof(header), file) == sizeof(header) &&
+             fwrite(payload.data(), 1, payload.size(), file) == payload.size();
+        nBytes += sizeof(header) + payload.size();
+        payload.clear();
+    }
+};
+
+/** Adds the coins of one record to coins. prev is the last outpoint seen,
+ *  which every coin must follow. Throws SerializeError. */
+void ReadRecord(const std::vector<unsigned char>& payload, CoinsMap& coins, OutPoint& prev, uint64_t& nCoins)
+{
+    ByteReader r(payload);
+    while (!r.Empty()) {
+        unsigned char hash[32];
+        r.ReadBytes(hash, sizeof(hash));
+        uint256 txid(hash);
+        uint64_t nCount = r.ReadCompactSize();
+        if (nCount == 0)
+            throw SerializeError("empty transaction");
+        for (uint64_t i = 0; i < nCount; i++) {
+            uint64_t n = r.ReadVarInt();
+            if (n > UINT32_MAX)
+                throw SerializeError("output index out of range");
+            OutPoint outpoint(txid, (uint32_t)n);
+            if (!prev.IsNull() && !(prev < outpoint))
+                throw SerializeError("coins out of order");
+            CoinsCacheEntry& entry = coins[outpoint];
+            UnserializeCompressedCoin(r, entry.coin);
+            entry.flags = CoinsCacheEntry::DIRTY | CoinsCacheEntry::FRESH;
+            prev = outpoint;
+            nCoins++;
+        }
+    }
+}
+
+} // namespace
+
+bool WriteCoinsSnapshot(const CoinsViewStore& view, const std::string& path, SnapshotInfo& info, std::string& error)
+{
+    info = SnapshotInfo();
+    info.hashBlock = view.GetBestBlock();
+    uint64_t nExpected = view.GetCoinCount();
+
+    std::string tmpPath = path + ".new";
+    FILE* file = fopen(tmpPath.c_str(), "wb");
+    if (!file) {
+        error = "cannot open " + tmpPath;
+        return false;
+    }
+    std::vector<unsigned char> header;
+    ByteWriter w(header);
+    w.WriteBytes(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    w.WriteU32(SNAPSHOT_VERSION);
+    w.WriteBytes(info.hashBlock.begin(), 32);
+    w.WriteU64(nExpected);
+    w.WriteU32(Crc32c(header.data(), header.size()));
+    bool ok = fwrite(header.data(), 1, header.size(), file) == header.size();
+
+    RecordWriter records(file);
+    view.ForEachCoin([&](const OutPoint& outpoint, const Coin& coin) {
+        records.Add(outpoint, coin);
+        return true;
+    });
+    ok = records.Finish() && ok;
+    ok = fflush(file) == 0 && fsync(fileno(file)) == 0 && ok;
+    ok = fclose(file) == 0 && ok;
+    if (ok && records.Coins() != nExpected) {
+        RemoveFile(tmpPath);
+        error = "coin count changed while writing " + path;
+        return false;
+    }
+    if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        RemoveFile(tmpPath);
+        error = "cannot write " + path;
+        return false;
+    }
+    info.nCoins = records.Coins();
+    info.nBytes = header.size() + records.Bytes();
+    return true;
+}
+
+bool LoadCoinsSnapshot(const std::string& path, CoinsView& view, SnapshotInfo& info, std::string& error)
+{
+    info = SnapshotInfo();
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        error = "cannot open " + path;
+        return false;
+    }
+    unsigned char header[SNAPSHOT_HEADER_SIZE];
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) ||
+        memcmp(header, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 || ReadLE32(header + 4) != SNAPSHOT_VERSION) {
+        fclose(file);
+        error = path + " is not a coins snapshot";
+        return false;
+    }
+    if (Crc32c(header, SNAPSHOT_HEADER_SIZE - 4) != ReadLE32(header + SNAPSHOT_HEADER_SIZE - 4)) {
+        fclose(file);
+        error = "corrupt header in " + path;
+        return false;
+    }
+    info.hashBlock = uint256(header + 8);
+    uint64_t nExpected = ReadLE64(header + 40);
+    info.nBytes = sizeof(header);
+
+    // Each record goes to view once the next one is read, so the last write
+    // carries the best block.
+    CoinsMap coins;
+    std::vector<unsigned char> payload;
+    OutPoint prev;
+    error.clear();
+    while (error.empty()) {
+        unsigned char recordHeader[RECORD_HEADER_SIZE];
+        size_t nRead = fread(recordHeader, 1, sizeof(recordHeader), file);
+        if (nRead == 0 && feof(file))
+            break;
+        uint32_t nSize = nRead == sizeof(recordHeader) ? ReadLE32(recordHeader) : 0;
+        if (nSize == 0 || nSize > MAX_SNAPSHOT_RECORD) {
+            error = "malformed record in " + path;
+            break;
+        }
+        payload.resize(nSize);
+        if (fread(payload.data(), 1, nSize, file) != nSize) {
+            error = "truncated record in " + path;
+            break;
+        }
+        if (Crc32c(payload.data(), nSize) != ReadLE32(recordHeader + 4)) {
+            error = "corrupt record in " + path;
+            break;
+        }
+        info.nBytes += sizeof(recordHeader) + nSize;
+        view.BatchWrite(coins, uint256());
+        coins.clear();
+        try {
+            ReadRecord(payload, coins, prev, info.nCoins);
+        } catch (const SerializeError& e) {
+            error = std::string("malformed record in ") + path + ": " + e.what();
+        }
+    }
+    fclose(file);
+    if (error.empty() && info.nCoins != nExpected)
+        error = path + " holds a different number of coins than its header";
+    if (!error.empty())
+        return false;
+    view.BatchWrite(coins, info.hashBlock);
+    return true;
+}
@@ -0,0 +1,40 @@
+#ifndef ONECOIN_SNAPSHOT_H
+#define ONECOIN_SNAPSHOT_H
+
+#include "coinsdb.h"
+#include "uint256.h"
+
+#include <stdint.h>
+#include <string>
+
+/**
+ * A UTXO set snapshot: a copy of the coins at one block in a single file.
+ *
+ * The file starts with SNAPSHOT_MAGIC, a version, the block hash, the
+ * coin count and a CRC-32C of those. Records follow, each a 4-byte
+ * little-endian payload length, a 4-byte little-endian CRC-32C of the
+ * payload and a payload of whole transactions: the txid, a compact size
+ * count of its unspent outputs and, per output, a varint index and the
+ * coin in the compressed form of compressor.h. Transactions come in
+ * outpoint order, so the same UTXO set always gives the same file.
+ */
+
+static const unsigned char SNAPSHOT_MAGIC[4] = {'o', 'c', 'u', 's'};
+static const uint32_t SNAPSHOT_VERSION = 2;
+
+struct SnapshotInfo {
+    uint256 hashBlock;
+    uint64_t nCoins;
+    uint64_t nBytes;
+
+    SnapshotInfo() : nCoins(0), nBytes(0) {}
+};
+
+/** Writes the coins of view to path, replacing it once complete. */
+bool WriteCoinsSnapshot(const CoinsViewStore& view, const std::string& path, SnapshotInfo& info, std::string& error);
+
+/** Adds the coins of the snapshot at path to view, which should be empty,
+ *  and makes its block the best block. False on a malformed file. */
+bool LoadCoinsSnapshot(const std::string& path, CoinsView& view, SnapshotInfo& info, std::string& error);
+
+#endif // ONECOIN_SNAPSHOT_H
@@ -0,0 +1,612 @@
+#include "stratum.h"
+#include "encoding.h"
+#include "merkle.h"
+#include "serialize.h"
+
+#include "../include/catch2/json.hpp"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+using nlohmann::json;
+
+namespace {
+
+/** Longest request line we buffer before dropping the connection. */
+const size_t MAX_LINE_LENGTH = 16 * 1024;
+
+std::string HexU32BE(uint32_t x)
+{
+    unsigned char be[4] = {(unsigned char)(x >> 24), (unsigned char)(x >> 16), (unsigned char)(x >> 8), (unsigned char)x};
+    return HexStr(be, 4);
+}
+
+bool ParseU32BE(const std::string& str, uint32_t& x)
+{
+    unsigned char be[4];
+    if (str.size() != 8 || !HexDecode(str.data(), str.size(), be))
+        return false;
+    x = (uint32_t)be[0] << 24 | (uint32_t)be[1] << 16 | (uint32_t)be[2] << 8 | be[3];
+    return true;
+}
+
+bool SetNonBlocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+json ErrorValue(int code)
+{
+    const char* msg = "Other/Unknown";
+    switch (code) {
+    case STRATUM_ERR_JOB_NOT_FOUND: msg = "Job not found"; break;
+    case STRATUM_ERR_DUPLICATE_SHARE: msg = "Duplicate share"; break;
+    case STRATUM_ERR_LOW_DIFFICULTY: msg = "Low difficulty share"; break;
+    case STRATUM_ERR_UNAUTHORIZED: msg = "Unauthorized worker"; break;
+    case STRATUM_ERR_NOT_SUBSCRIBED: msg = "Not subscribed"; break;
+    }
+    json err = json::array();
+    err.push_back(code);
+    err.push_back(msg);
+    err.push_back(nullptr);
+    return err;
+}
+
+} // namespace
+
+arith_uint256 StratumDifficultyToTarget(double difficulty)
+{
+    // diff1 = 0xffff << 208. Dividing by difficulty is done as a
+    // multiplication by the 32.32 fixed-point reciprocal; (diff1 >> 32) has
+    // 192 bits, so the product cannot overflow 256 bits.
+    static const arith_uint256 diff1 = arith_uint256::FromCompact(0x1d00ffff);
+    if (!(difficulty > 0))
+        return ~arith_uint256();
+    double mul = 4294967296.0 / difficulty;
+    if (mul >= 18446744073709551615.0)
+        return ~arith_uint256();
+    if (mul < 1)
+        mul = 1;
+    return (diff1 >> 32) * arith_uint256((uint64_t)mul);
+}
+
+std::string StratumPrevHash(const uint256& hash)
+{
+    unsigned char swapped[32];
+    for (int i = 0; i < 32; i++)
+        swapped[i] = hash.begin()[(i & ~3) + 3 - (i & 3)];
+    return HexStr(swapped, 32);
+}
+
+StratumJob::StratumJob(const std::string& id, const BlockTemplate& tmpl, size_t extranonce1Size, size_t extranonce2Size,
+    size_t nMaxShares)
+    : id(id), hashPrevBlock(tmpl.block.hashPrevBlock), nVersion(tmpl.block.nVersion), nBits(tmpl.block.nBits),
+      nTime(tmpl.block.nTime), nMinTime((uint32_t)tmpl.nMinTime), nHeight(tmpl.nHeight),
+      extranonce1Size(extranonce1Size), extranonce2Size(extranonce2Size), nMaxShares(nMaxShares),
+      networkTarget(arith_uint256::FromCompact(tmpl.block.nBits)), nGeneration(0)
+{
+    SplitCoinbase(MutableTransaction(*tmpl.block.vtx[0]));
+
+    // The branch for leaf 0 never includes leaf 0 itself, so a placeholder
+    // coinbase hash is fine here.
+    std::vector<uint256> leaves(tmpl.block.vtx.size());
+    for (size_t i = 1; i < tmpl.block.vtx.size(); i++)
+        leaves[i] = tmpl.block.vtx[i]->GetHash();
+    merkleBranch = ComputeMerkleBranch(leaves, 0);
+    txs.assign(tmpl.block.vtx.begin() + 1, tmpl.block.vtx.end());
+}
+
+StratumJob::StratumJob(const std::string& id, const StratumJob& prev)
+    : id(id), hashPrevBlock(prev.hashPrevBlock), nVersion(prev.nVersion), nBits(prev.nBits), nTime(prev.nTime),
+      nMinTime(prev.nMinTime), nHeight(prev.nHeight), extranonce1Size(prev.extranonce1Size),
+      extranonce2Size(prev.extranonce2Size), nMaxShares(prev.nMaxShares), networkTarget(prev.networkTarget),
+      nGeneration(prev.nGeneration + 1), merkleBranch(prev.merkleBranch), txs(prev.txs)
+{
+    std::vector<unsigned char> raw(prev.coinb1);
+    raw.insert(raw.end(), extranonce1Size + extranonce2Size, 0);
+    raw.insert(raw.end(), prev.coinb2.begin(), prev.coinb2.end());
+    ByteReader reader(raw);
+    SplitCoinbase(MutableTransaction(*ReadTransaction(reader)));
+}
+
+void StratumJob::SplitCoinbase(MutableTransaction coinbase)
+{
+    // Rebuild the coinbase with a zeroed extranonce push after the height and
+    // cut it around that push. Renewed jobs tag the height with their
+    // generation, which changes every header hash of the job.
+    size_t extranonceSize = extranonce1Size + extranonce2Size;
+    Script prefix = CoinbaseHeightScript(nHeight);
+    if (nGeneration > 0)
+        prefix << (int64_t)nGeneration;
+    Script& scriptSig = coinbase.vin[0].scriptSig;
+    scriptSig = prefix;
+    scriptSig.push_back((unsigned char)extranonceSize);
+    scriptSig.insert(scriptSig.end(), extranonceSize, 0);
+
+    std::vector<unsigned char> full = SerializeTransaction(coinbase);
+    size_t split = 4 + 1 + 36 + GetCompactSizeLen(scriptSig.size()) + prefix.size() + 1;
+    coinb1.assign(full.begin(), full.begin() + split);
+    coinb2.assign(full.begin() + split + extranonceSize, full.end());
+    coinb1State.Write(coinb1.data(), coinb1.size());
+}
+
+uint256 StratumJob::CoinbaseHash(const unsigned char* extranonce1, const unsigned char* extranonce2) const
+{
+    Sha256 sha = coinb1State;
+    sha.Write(extranonce1, extranonce1Size);
+    sha.Write(extranonce2, extranonce2Size);
+    sha.Write(coinb2.data(), coinb2.size());
+    unsigned char hash[32];
+    sha.Finalize(hash);
+    Sha256().Write(hash, 32).Finalize(hash);
+    return uint256(hash);
+}
+
+StratumJob::ShareResult StratumJob::CheckShare(const unsigned char* extranonce1, const unsigned char* extranonce2,
+    uint32_t ntime, uint32_t nonce, const arith_uint256& shareTarget, int64_t nMaxTime, BlockHeader* header)
+{
+    if (ntime < nMinTime || (int64_t)ntime > nMaxTime)
+        return SHARE_BAD_NTIME;
+
+    BlockHeader h;
+    h.nVersion = nVersion;
+    h.hashPrevBlock = hashPrevBlock;
+    h.hashMerkleRoot = ComputeMerkleRootFromBranch(CoinbaseHash(extranonce1, extranonce2), merkleBranch, 0);
+    h.nTime = ntime;
+    h.nBits = nBits;
+    h.nNonce = nonce;
+    uint256 hash = h.GetHash();
+    arith_uint256 value = UintToArith256(hash);
+
+    if (value > shareTarget && value > networkTarget)
+        return SHARE_LOW_DIFFICULTY;
+    if (seenShares.count(hash))
+        return SHARE_DUPLICATE;
+    // A block is worth far more than the bound on the history, so it is
+    // taken even from a full job.
+    bool fBlock = value <= networkTarget;
+    if (!fBlock && seenShares.size() >= nMaxShares)
+        return SHARE_STALE;
+    seenShares.insert(hash);
+    if (header)
+        *header = h;
+    return fBlock ? SHARE_BLOCK : SHARE_VALID;
+}
+
+Block StratumJob::AssembleBlock(const BlockHeader& header, const unsigned char* extranonce1, const unsigned char* extranonce2) const
+{
+    std::vector<unsigned char> raw(coinb1);
+    raw.insert(raw.end(), extranonce1, extranonce1 + extranonce1Size);
+    raw.insert(raw.end(), extranonce2, extranonce2 + extranonce2Size);
+    raw.insert(raw.end(), coinb2.begin(), coinb2.end());
+    ByteReader reader(raw);
+
+    Block block(header);
+    block.vtx.reserve(txs.size() + 1);
+    block.vtx.push_back(ReadTransaction(reader));
+    block.vtx.insert(block.vtx.end(), txs.begin(), txs.end());
+    return block;
+}
+
+std::string StratumJob::NotifyParams(bool fCleanJobs) const
+{
+    json branch = json::array();
+    for (size_t i = 0; i < merkleBranch.size(); i++)
+        branch.push_back(HexStr(merkleBranch[i].begin(), 32));
+    json params = json::array();
+    params.push_back(id);
+    params.push_back(StratumPrevHash(hashPrevBlock));
+    params.push_back(HexStr(coinb1));
+    params.push_back(HexStr(coinb2));
+    params.push_back(branch);
+    params.push_back(HexU32BE((uint32_t)nVersion));
+    params.push_back(HexU32BE(nBits));
+    params.push_back(HexU32BE(nTime));
+    params.push_back(fCleanJobs);
+    return params.dump();
+}
+
+const size_t StratumJob::DEFAULT_MAX_SHARES;
+const size_t StratumServer::EXTRANONCE1_SIZE;
+
+struct StratumServer::Client {
+    int fd;
+    std::string inbuf;
+    std::string outbuf;
+    unsigned char extranonce1[EXTRANONCE1_SIZE];
+    bool subscribed;
+    bool authorized;
+    /** Set when outbuf overflows; the server thread then drops the client. */
+    bool fDisconnect;
+    arith_uint256 shareTarget;
+
+    Client(int fd) : fd(fd), subscribed(false), authorized(false), fDisconnect(false) {}
+};
+
+StratumServer::StratumServer(const Options& options, const BlockFoundFn& blockFound)
+    : options(options), blockFound(blockFound), listenFd(-1), boundPort(0), interrupt(false), nextJobId(1),
+      nextExtranonce1(1), statConnections(0), statAccepted(0), statRejected(0), statBlocks(0)
+{
+    wakeFds[0] = wakeFds[1] = -1;
+}
+
+StratumServer::~StratumServer()
+{
+    Stop();
+}
+
+bool StratumServer::Start(std::string& error)
+{
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        error = std::string("socket: ") + strerror(errno);
+        return false;
+    }
+    int one = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(options.port);
+    if (inet_pton(AF_INET, options.bindAddress.c_str(), &addr.sin_addr) != 1) {
+        error = "invalid bind address " + options.bindAddress;
+        Stop();
+        return false;
+    }
+    if (bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(listenFd, 128) < 0) {
+        error = std::string("bind: ") + strerror(errno);
+        Stop();
+        return false;
+    }
+    socklen_t len = sizeof(addr);
+    getsockname(listenFd, (struct sockaddr*)&addr, &len);
+    boundPort = ntohs(addr.sin_port);
+
+    if (pipe(wakeFds) < 0 || !SetNonBlocking(wakeFds[0]) || !SetNonBlocking(wakeFds[1]) || !SetNonBlocking(listenFd)) {
+        error = std::string("pipe: ") + strerror(errno);
+        Stop();
+        return false;
+    }
+    interrupt = false;
+    thread = std::thread(&StratumServer::ThreadMain, this);
+    return true;
+}
+
+void StratumServer::Stop()
+{
+    interrupt = true;
+    if (wakeFds[1] >= 0) {
+        char c = 0;
+        if (write(wakeFds[1], &c, 1) < 0) {
+            // The loop also wakes up on its poll timeout.
+        }
+    }
+    if (thread.joinable())
+        thread.join();
+    for (std::map<int, std::unique_ptr<Client> >::iterator it = clients.begin(); it != clients.end(); ++it)
+        close(it->first);
+    clients.clear();
+    if (listenFd >= 0)
+        close(listenFd);
+    for (int i = 0; i < 2; i++) {
+        if (wakeFds[i] >= 0)
+            close(wakeFds[i]);
+        wakeFds[i] = -1;
+    }
+    listenFd = -1;
+}
+
+std::string StratumServer::NewJobId()
+{
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%llx", (unsigned long long)nextJobId++);
+    return buf;
+}
+
+void StratumServer::UpdateTemplate(const BlockTemplate& tmpl)
+{
+    // Building the job hashes the whole transaction list, so do it here
+    // rather than on the server thread.
+    std::shared_ptr<StratumJob> job = std::make_shared<StratumJob>(NewJobId(), tmpl, EXTRANONCE1_SIZE,
+        options.extranonce2Size, options.maxJobShares);
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        pendingJobs.push_back(job);
+    }
+    if (wakeFds[1] >= 0) {
+        char c = 1;
+        if (write(wakeFds[1], &c, 1) < 0) {
+            // Pipe full: a wakeup is already pending.
+        }
+    }
+}
+
+StratumServer::Stats StratumServer::GetStats() const
+{
+    Stats stats;
+    stats.connections = statConnections;
+    stats.sharesAccepted = statAccepted;
+    stats.sharesRejected = statRejected;
+    stats.blocksFound = statBlocks;
+    return stats;
+}
+
+void StratumServer::ThreadMain()
+{
+    std::vector<struct pollfd> fds;
+    while (!interrupt) {
+        fds.clear();
+        struct pollfd pfd;
+        pfd.fd = listenFd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        fds.push_back(pfd);
+        pfd.fd = wakeFds[0];
+        fds.push_back(pfd);
+        for (std::map<int, std::unique_ptr<Client> >::iterator it = clients.begin(); it != clients.end(); ++it) {
+            pfd.fd = it->first;
+            pfd.events = POLLIN | (it->second->outbuf.empty() ? 0 : POLLOUT);
+            fds.push_back(pfd);
+        }
+        if (poll(fds.data(), fds.size(), 1000) < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (fds[1].revents & POLLIN) {
+            char buf[64];
+            while (read(wakeFds[0], buf, sizeof(buf)) > 0) {
+            }
+        }
+        InstallPendingJobs();
+        if (fds[0].revents & POLLIN)
+            AcceptClients();
+
+        for (size_t i = 2; i < fds.size(); i++) {
+            std::map<int, std::unique_ptr<Client> >::iterator it = clients.find(fds[i].fd);
+            if (it == clients.end())
+                continue;
+            bool ok = true;
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+                ok = ReadClient(*it->second);
+            if (ok && !it->second->outbuf.empty())
+                ok = WriteClient(*it->second);
+            if (!ok || it->second->fDisconnect) {
+                close(it->first);
+                clients.erase(it);
+            }
+        }
+    }
+}
+
+void StratumServer::AcceptClients()
+{
+    while (true) {
+        int fd = accept(listenFd, NULL, NULL);
+        if (fd < 0)
+            return;
+        if (!SetNonBlocking(fd)) {
+            close(fd);
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        std::unique_ptr<Client> client(new Client(fd));
+        uint32_t en1 = nextExtranonce1++;
+        for (size_t i = 0; i < EXTRANONCE1_SIZE; i++)
+            client->extranonce1[i] = (unsigned char)(en1 >> (8 * (EXTRANONCE1_SIZE - 1 - i)));
+        client->shareTarget = StratumDifficultyToTarget(options.difficulty);
+        clients[fd] = std::move(client);
+        statConnections++;
+    }
+}
+
+void StratumServer::InstallPendingJobs()
+{
+    std::vector<std::shared_ptr<StratumJob> > incoming;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        incoming.swap(pendingJobs);
+    }
+    for (size_t i = 0; i < incoming.size(); i++)
+        InstallJob(incoming[i]);
+}
+
+void StratumServer::InstallJob(const std::shared_ptr<StratumJob>& job)
+{
+    bool fClean = !currentJob || currentJob->PrevHash() != job->PrevHash();
+    if (fClean) {
+        // Work on the old tip can never become a block any more.
+        jobs.clear();
+        jobOrder.clear();
+    }
+    jobs[job->Id()] = job;
+    jobOrder.push_back(job->Id());
+    while (jobOrder.size() > options.maxJobs) {
+        jobs.erase(jobOrder.front());
+        jobOrder.erase(jobOrder.begin());
+    }
+    currentJob = job;
+    for (std::map<int, std::unique_ptr<Client> >::iterator it = clients.begin(); it != clients.end(); ++it) {
+        if (it->second->subscribed)
+            SendNotify(*it->second, fClean);
+    }
+}
+
+bool StratumServer::ReadClient(Client& client)
+{
+    char buf[65536];
+    while (true) {
+        ssize_t n = recv(client.fd, buf, sizeof(buf), 0);
+        if (n == 0)
+            return false;
+        if (n < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        client.inbuf.append(buf, n);
+
+        size_t start = 0, nl;
+        while ((nl = client.inbuf.find('\n', start)) != std::string::npos) {
+            HandleLine(client, client.inbuf.substr(start, nl - start));
+            start = nl + 1;
+        }
+        client.inbuf.erase(0, start);
+        if (client.inbuf.size() > MAX_LINE_LENGTH)
+            return false;
+        if ((size_t)n < sizeof(buf))
+            return true;
+    }
+}
+
+bool StratumServer::WriteClient(Client& client)
+{
+    while (!client.outbuf.empty()) {
+        ssize_t n = send(client.fd, client.outbuf.data(), client.outbuf.size(), MSG_NOSIGNAL);
+        if (n < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        client.outbuf.erase(0, n);
+    }
+    return true;
+}
+
+void StratumServer::Send(Client& client, const std::string& msg)
+{
+    if (client.fDisconnect)
+        return;
+    if (client.outbuf.size() + msg.size() + 1 > options.maxSendBuffer) {
+        client.fDisconnect = true;
+        client.outbuf.clear();
+        return;
+    }
+    client.outbuf += msg;
+    client.outbuf += '\n';
+}
+
+void StratumServer::SendNotify(Client& client, bool fCleanJobs)
+{
+    if (!currentJob)
+        return;
+    Send(client, "{\"id\":null,\"method\":\"mining.notify\",\"params\":" + currentJob->NotifyParams(fCleanJobs) + "}");
+}
+
+void StratumServer::HandleLine(Client& client, const std::string& line)
+{
+    if (line.empty() || line == "\r")
+        return;
+    json request = json::parse(line, nullptr, false);
+    if (request.is_discarded() || !request.is_object())
+        return;
+
+    json id = request.contains("id") ? request["id"] : json();
+    json params = request.contains("params") && request["params"].is_array() ? request["params"] : json::array();
+    std::string method = request.contains("method") && request["method"].is_string() ? request["method"].get<std::string>() : "";
+
+    json response;
+    response["id"] = id;
+    response["result"] = nullptr;
+    response["error"] = nullptr;
+
+    if (method == "mining.subscribe") {
+        json subscription = json::array();
+        subscription.push_back(json::array({"mining.set_difficulty", HexStr(client.extranonce1, EXTRANONCE1_SIZE)}));
+        subscription.push_back(json::array({"mining.notify", HexStr(client.extranonce1, EXTRANONCE1_SIZE)}));
+        json result = json::array();
+        result.push_back(subscription);
+        result.push_back(HexStr(client.extranonce1, EXTRANONCE1_SIZE));
+        result.push_back(options.extranonce2Size);
+        response["result"] = result;
+        client.subscribed = true;
+        Send(client, response.dump());
+
+        json diff;
+        diff["id"] = nullptr;
+        diff["method"] = "mining.set_difficulty";
+        diff["params"] = json::array({options.difficulty});
+        Send(client, diff.dump());
+        SendNotify(client, true);
+        return;
+    } else if (method == "mining.authorize") {
+        client.authorized = params.size() >= 1 && params[0].is_string();
+        response["result"] = client.authorized;
+    } else if (method == "mining.extranonce.subscribe") {
+        response["result"] = false;
+    } else if (method == "mining.submit") {
+        int err;
+        if (!client.subscribed) {
+            err = STRATUM_ERR_NOT_SUBSCRIBED;
+        } else if (!client.authorized) {
+            err = STRATUM_ERR_UNAUTHORIZED;
+        } else if (params.size() < 5 || !params[1].is_string() || !params[2].is_string() || !params[3].is_string() ||
+                   !params[4].is_string()) {
+            err = STRATUM_ERR_OTHER;
+        } else {
+            err = HandleSubmit(client, params[1].get<std::string>(), params[2].get<std::string>(),
+                params[3].get<std::string>(), params[4].get<std::string>());
+        }
+        if (err) {
+            statRejected++;
+            response["error"] = ErrorValue(err);
+        } else {
+            statAccepted++;
+            response["result"] = true;
+        }
+    } else {
+        response["error"] = ErrorValue(STRATUM_ERR_OTHER);
+    }
+    Send(client, response.dump());
+}
+
+int StratumServer::HandleSubmit(Client& client, const std::string& jobId, const std::string& extranonce2Hex,
+    const std::string& ntimeHex, const std::string& nonceHex)
+{
+    std::map<std::string, std::shared_ptr<StratumJob> >::iterator it = jobs.find(jobId);
+    if (it == jobs.end())
+        return STRATUM_ERR_JOB_NOT_FOUND;
+
+    unsigned char extranonce2[32];
+    uint32_t ntime, nonce;
+    if (extranonce2Hex.size() != 2 * options.extranonce2Size || options.extranonce2Size > sizeof(extranonce2) ||
+        !HexDecode(extranonce2Hex.data(), extranonce2Hex.size(), extranonce2) ||
+        !ParseU32BE(ntimeHex, ntime) || !ParseU32BE(nonceHex, nonce)) {
+        return STRATUM_ERR_OTHER;
+    }
+
+    std::shared_ptr<StratumJob> job = it->second;
+    BlockHeader header;
+    int64_t nMaxTime = (int64_t)time(NULL) + options.maxTimeDrift;
+    StratumJob::ShareResult result =
+        job->CheckShare(client.extranonce1, extranonce2, ntime, nonce, client.shareTarget, nMaxTime, &header);
+    if (job == currentJob && job->ShareCount() >= options.maxJobShares - options.maxJobShares / 4) {
+        // Hand out the same work under a fresh history while the last
+        // quarter of this one still takes the shares already in flight.
+        InstallJob(std::make_shared<StratumJob>(NewJobId(), *job));
+    }
+    switch (result) {
+    case StratumJob::SHARE_BLOCK:
+        statBlocks++;
+        if (blockFound)
+            blockFound(job->AssembleBlock(header, client.extranonce1, extranonce2));
+        return 0;
+    case StratumJob::SHARE_VALID:
+        return 0;
+    case StratumJob::SHARE_DUPLICATE:
+        return STRATUM_ERR_DUPLICATE_SHARE;
+    case StratumJob::SHARE_LOW_DIFFICULTY:
+        return STRATUM_ERR_LOW_DIFFICULTY;
+    case StratumJob::SHARE_BAD_NTIME:
+        return STRATUM_ERR_OTHER;
+    case StratumJob::SHARE_STALE:
+        return STRATUM_ERR_JOB_NOT_FOUND;
+    }
+    return STRATUM_ERR_OTHER;
+}
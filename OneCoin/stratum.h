@@ -0,0 +1,213 @@
+#ifndef ONECOIN_STRATUM_H
+#define ONECOIN_STRATUM_H
+
+#include "arith_uint256.h"
+#include "block.h"
+#include "hash.h"
+#include "miner.h"
+#include "uint256.h"
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+/** Stratum v1 error codes. */
+enum StratumError {
+    STRATUM_ERR_OTHER = 20,
+    STRATUM_ERR_JOB_NOT_FOUND = 21,
+    STRATUM_ERR_DUPLICATE_SHARE = 22,
+    STRATUM_ERR_LOW_DIFFICULTY = 23,
+    STRATUM_ERR_UNAUTHORIZED = 24,
+    STRATUM_ERR_NOT_SUBSCRIBED = 25,
+};
+
+/** Share target for a pool difficulty, where difficulty 1 is nBits 0x1d00ffff. */
+arith_uint256 StratumDifficultyToTarget(double difficulty);
+
+/** Previous block hash in the word-swapped hex form miners expect. */
+std::string StratumPrevHash(const uint256& hash);
+
+/**
+ * Work derived once from a block template and shared by every connection:
+ * the coinbase split around the extranonce, the Merkle branch of the
+ * coinbase and the SHA-256 state after coinb1. Validating a share then costs
+ * the coinbase tail, one hash per branch level and the header hash.
+ */
+class StratumJob {
+public:
+    enum ShareResult {
+        SHARE_VALID,
+        SHARE_BLOCK,          //!< valid and meets the network target
+        SHARE_LOW_DIFFICULTY,
+        SHARE_DUPLICATE,
+        SHARE_BAD_NTIME,
+        SHARE_STALE,          //!< the job remembers no more shares below the network target
+    };
+
+    static const size_t DEFAULT_MAX_SHARES = 1 << 18;
+
+    /** The job accepts at most nMaxShares shares that do not solve a block,
+     *  so the hashes it keeps to spot duplicates stay bounded. */
+    StratumJob(const std::string& id, const BlockTemplate& tmpl, size_t extranonce1Size, size_t extranonce2Size,
+        size_t nMaxShares = DEFAULT_MAX_SHARES);
+    /** The same work as prev under a new id, with an empty share history.
+     *  The coinbase carries the job's generation, so no share of prev hashes
+     *  the same here. */
+    StratumJob(const std::string& id, const StratumJob& prev);
+
+    const std::string& Id() const { return id; }
+    const uint256& PrevHash() const { return hashPrevBlock; }
+    int Height() const { return nHeight; }
+    size_t ShareCount() const { return seenShares.size(); }
+
+    /** Checks a submitted share. ntime may roll forward from the template
+     *  time up to nMaxTime. On success *header holds the solved header. */
+    ShareResult CheckShare(const unsigned char* extranonce1, const unsigned char* extranonce2, uint32_t ntime,
+        uint32_t nonce, const arith_uint256& shareTarget, int64_t nMaxTime, BlockHeader* header);
+
+    /** Full block for a share that met the network target. */
+    Block AssembleBlock(const BlockHeader& header, const unsigned char* extranonce1, const unsigned char* extranonce2) const;
+
+    /** Parameters of the mining.notify message. */
+    std::string NotifyParams(bool fCleanJobs) const;
+
+    const std::vector<unsigned char>& Coinb1() const { return coinb1; }
+    const std::vector<unsigned char>& Coinb2() const { return coinb2; }
+    const std::vector<uint256>& MerkleBranch() const { return merkleBranch; }
+
+private:
+    std::string id;
+    uint256 hashPrevBlock;
+    int32_t nVersion;
+    uint32_t nBits;
+    uint32_t nTime;
+    uint32_t nMinTime;
+    int nHeight;
+    size_t extranonce1Size;
+    size_t extranonce2Size;
+    size_t nMaxShares;
+    arith_uint256 networkTarget;
+    /** How many times the template's job was renewed before this one. */
+    uint32_t nGeneration;
+
+    std::vector<unsigned char> coinb1;
+    std::vector<unsigned char> coinb2;
+    std::vector<uint256> merkleBranch;
+    /** SHA-256 state after absorbing coinb1. */
+    Sha256 coinb1State;
+    std::vector<TransactionRef> txs;
+
+    /** Header hashes of accepted shares, to reject resubmissions. */
+    std::unordered_set<uint256, Uint256Hasher> seenShares;
+
+    void SplitCoinbase(MutableTransaction coinbase);
+    uint256 CoinbaseHash(const unsigned char* extranonce1, const unsigned char* extranonce2) const;
+};
+
+/**
+ * Stratum v1 server for external mining hardware. One thread runs a poll()
+ * loop over all connections and validates shares inline; templates are
+ * turned into jobs on the caller's thread and handed over through a queue.
+ */
+class StratumServer {
+public:
+    struct Options {
+        std::string bindAddress;
+        uint16_t port;
+        /** Pool share difficulty assigned to new connections. */
+        double difficulty;
+        size_t extranonce2Size;
+        /** How far past the local clock a share's ntime may be rolled. */
+        int64_t maxTimeDrift;
+        /** Jobs kept for late shares on the same previous block. */
+        size_t maxJobs;
+        /** Shares each job accepts; see StratumJob. The server renews the
+         *  current job once it is three quarters full. */
+        size_t maxJobShares;
+        /** Replies queued for a client that does not read them before it is
+         *  disconnected. */
+        size_t maxSendBuffer;
+
+        Options()
+            : bindAddress("127.0.0.1"), port(0), difficulty(1.0), extranonce2Size(4), maxTimeDrift(7200), maxJobs(8),
+              maxJobShares(StratumJob::DEFAULT_MAX_SHARES), maxSendBuffer(1 << 20)
+        {
+        }
+    };
+
+    struct Stats {
+        uint64_t connections;
+        uint64_t sharesAccepted;
+        uint64_t sharesRejected;
+        uint64_t blocksFound;
+    };
+
+    typedef std::function<void(const Block&)> BlockFoundFn;
+
+    static const size_t EXTRANONCE1_SIZE = 4;
+
+    StratumServer(const Options& options, const BlockFoundFn& blockFound);
+    ~StratumServer();
+
+    /** Binds and starts the server thread. */
+    bool Start(std::string& error);
+    void Stop();
+    /** The bound port, useful when Options::port is 0. */
+    uint16_t GetPort() const { return boundPort; }
+
+    /** Publishes a new job. Connected miners drop old work when the
+     *  previous block changed. Safe to call from any thread. */
+    void UpdateTemplate(const BlockTemplate& tmpl);
+
+    Stats GetStats() const;
+
+private:
+    struct Client;
+
+    Options options;
+    BlockFoundFn blockFound;
+    int listenFd;
+    int wakeFds[2];
+    uint16_t boundPort;
+    std::thread thread;
+    std::atomic<bool> interrupt;
+
+    std::mutex pendingMutex;
+    std::vector<std::shared_ptr<StratumJob> > pendingJobs;
+    uint64_t nextJobId;
+
+    // Owned by the server thread.
+    std::map<int, std::unique_ptr<Client> > clients;
+    std::map<std::string, std::shared_ptr<StratumJob> > jobs;
+    std::vector<std::string> jobOrder;
+    std::shared_ptr<StratumJob> currentJob;
+    uint32_t nextExtranonce1;
+
+    std::atomic<uint64_t> statConnections;
+    std::atomic<uint64_t> statAccepted;
+    std::atomic<uint64_t> statRejected;
+    std::atomic<uint64_t> statBlocks;
+
+    void ThreadMain();
+    void AcceptClients();
+    void InstallPendingJobs();
+    void InstallJob(const std::shared_ptr<StratumJob>& job);
+    std::string NewJobId();
+    bool ReadClient(Client& client);
+    bool WriteClient(Client& client);
+    void HandleLine(Client& client, const std::string& line);
+    /** Returns 0 for an accepted share or a StratumError code. */
+    int HandleSubmit(Client& client, const std::string& jobId, const std::string& extranonce2,
+        const std::string& ntime, const std::string& nonce);
+    void Send(Client& client, const std::string& msg);
+    void SendNotify(Client& client, bool fCleanJobs);
+};
+
+#endif // ONECOIN_STRATUM_H
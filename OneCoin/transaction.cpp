@@ -0,0 +1,88 @@
+#include "transaction.h"
+#include "hash.h"
+
+namespace {
+
+template <typename Tx>
+uint256 ComputeHash(const Tx& tx)
+{
+    std::vector<unsigned char> buf = SerializeTransaction(tx);
+    unsigned char hash[32];
+    Sha256d(buf.data(), buf.size(), hash);
+    return uint256(hash);
+}
+
+}
+
+MutableTransaction::MutableTransaction(const Transaction& tx)
+    : nVersion(tx.nVersion), vin(tx.vin), vout(tx.vout), nLockTime(tx.nLockTime)
+{
+}
+
+uint256 MutableTransaction::GetHash() const
+{
+    return ComputeHash(*this);
+}
+
+Transaction::Transaction(const MutableTransaction& tx)
+    : nVersion(tx.nVersion), vin(tx.vin), vout(tx.vout), nLockTime(tx.nLockTime), hash(ComputeHash(*this))
+{
+}
+
+Transaction::Transaction(MutableTransaction&& tx)
+    : nVersion(tx.nVersion), vin(std::move(tx.vin)), vout(std::move(tx.vout)), nLockTime(tx.nLockTime),
+      hash(ComputeHash(*this))
+{
+}
+
+Amount Transaction::GetValueOut() const
+{
+    Amount nValueOut = 0;
+    for (size_t i = 0; i < vout.size(); i++)
+        nValueOut += vout[i].nValue;
+    return nValueOut;
+}
+
+size_t Transaction::GetTotalSize() const
+{
+    size_t size = 4 + GetCompactSizeLen(vin.size()) + GetCompactSizeLen(vout.size()) + 4;
+    for (size_t i = 0; i < vin.size(); i++)
+        size += 36 + GetCompactSizeLen(vin[i].scriptSig.size()) + vin[i].scriptSig.size() + 4;
+    for (size_t i = 0; i < vout.size(); i++)
+        size += 8 + GetCompactSizeLen(vout[i].scriptPubKey.size()) + vout[i].scriptPubKey.size();
+    return size;
+}
+
+void UnserializeTransaction(ByteReader& r, MutableTransaction& tx)
+{
+    tx.nVersion = (int32_t)r.ReadU32();
+    // Bound counts by the bytes left so a bogus count cannot force a huge
+    // allocation: an input takes at least 41 bytes and an output 9.
+    uint64_t nIn = r.ReadCompactSize();
+    if (nIn > r.Remaining() / 41)
+        throw SerializeError("input count exceeds data");
+    tx.vin.resize(nIn);
+    for (size_t i = 0; i < tx.vin.size(); i++) {
+        TxIn& in = tx.vin[i];
+        r.ReadBytes(in.prevout.hash.begin(), 32);
+        in.prevout.n = r.ReadU32();
+        r.ReadVarBytes(in.scriptSig);
+        in.nSequence = r.ReadU32();
+    }
+    uint64_t nOut = r.ReadCompactSize();
+    if (nOut > r.Remaining() / 9)
+        throw SerializeError("output count exceeds data");
+    tx.vout.resize(nOut);
+    for (size_t i = 0; i < tx.vout.size(); i++) {
+        tx.vout[i].nValue = (Amount)r.ReadU64();
+        r.ReadVarBytes(tx.vout[i].scriptPubKey);
+    }
+    tx.nLockTime = r.ReadU32();
+}
+
+TransactionRef ReadTransaction(ByteReader& r)
+{
+    MutableTransaction tx;
+    UnserializeTransaction(r, tx);
+    return MakeTransactionRef(std::move(tx));
+}
@@ -0,0 +1,144 @@
+#ifndef ONECOIN_TRANSACTION_H
+#define ONECOIN_TRANSACTION_H
+
+#include "amount.h"
+#include "script.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <stdint.h>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/** Reference to one output of a previous transaction. */
+class OutPoint {
+public:
+    uint256 hash;
+    uint32_t n;
+
+    OutPoint() : n((uint32_t)-1) {}
+    OutPoint(const uint256& hash, uint32_t n) : hash(hash), n(n) {}
+
+    bool IsNull() const { return hash.IsNull() && n == (uint32_t)-1; }
+
+    friend bool operator==(const OutPoint& a, const OutPoint& b) { return a.n == b.n && a.hash == b.hash; }
+    friend bool operator!=(const OutPoint& a, const OutPoint& b) { return !(a == b); }
+    friend bool operator<(const OutPoint& a, const OutPoint& b)
+    {
+        int cmp = a.hash.Compare(b.hash);
+        return cmp < 0 || (cmp == 0 && a.n < b.n);
+    }
+};
+
+struct OutPointHasher {
+    size_t operator()(const OutPoint& out) const { return hasher(out.hash) ^ (out.n * 0x9e3779b97f4a7c15ULL); }
+
+private:
+    Uint256Hasher hasher;
+};
+
+class TxIn {
+public:
+    static const uint32_t SEQUENCE_FINAL = 0xffffffff;
+
+    OutPoint prevout;
+    Script scriptSig;
+    uint32_t nSequence;
+
+    TxIn() : nSequence(SEQUENCE_FINAL) {}
+    explicit TxIn(const OutPoint& prevout, const Script& scriptSig = Script(), uint32_t nSequence = SEQUENCE_FINAL)
+        : prevout(prevout), scriptSig(scriptSig), nSequence(nSequence) {}
+};
+
+class TxOut {
+public:
+    Amount nValue;
+    Script scriptPubKey;
+
+    TxOut() : nValue(-1) {}
+    TxOut(Amount nValue, const Script& scriptPubKey) : nValue(nValue), scriptPubKey(scriptPubKey) {}
+
+    bool IsNull() const { return nValue == -1; }
+
+    friend bool operator==(const TxOut& a, const TxOut& b) { return a.nValue == b.nValue && a.scriptPubKey == b.scriptPubKey; }
+};
+
+class Transaction;
+
+/** Transaction under construction. */
+struct MutableTransaction {
+    int32_t nVersion;
+    std::vector<TxIn> vin;
+    std::vector<TxOut> vout;
+    uint32_t nLockTime;
+
+    MutableTransaction() : nVersion(1), nLockTime(0) {}
+    explicit MutableTransaction(const Transaction& tx);
+
+    uint256 GetHash() const;
+};
+
+/** Immutable transaction with its txid computed once at construction. */
+class Transaction {
+public:
+    const int32_t nVersion;
+    const std::vector<TxIn> vin;
+    const std::vector<TxOut> vout;
+    const uint32_t nLockTime;
+
+    explicit Transaction(const MutableTransaction& tx);
+    explicit Transaction(MutableTransaction&& tx);
+
+    const uint256& GetHash() const { return hash; }
+    bool IsCoinBase() const { return vin.size() == 1 && vin[0].prevout.IsNull(); }
+    /** Sum of output values; callers check MoneyRange on each output first. */
+    Amount GetValueOut() const;
+    size_t GetTotalSize() const;
+
+private:
+    const uint256 hash;
+};
+
+typedef std::shared_ptr<const Transaction> TransactionRef;
+
+template <typename Tx>
+inline TransactionRef MakeTransactionRef(Tx&& tx)
+{
+    return std::make_shared<const Transaction>(std::forward<Tx>(tx));
+}
+
+template <typename Tx>
+void SerializeTransaction(ByteWriter& w, const Tx& tx)
+{
+    w.WriteU32((uint32_t)tx.nVersion);
+    w.WriteCompactSize(tx.vin.size());
+    for (size_t i = 0; i < tx.vin.size(); i++) {
+        const TxIn& in = tx.vin[i];
+        w.WriteBytes(in.prevout.hash.begin(), 32);
+        w.WriteU32(in.prevout.n);
+        w.WriteVarBytes(in.scriptSig);
+        w.WriteU32(in.nSequence);
+    }
+    w.WriteCompactSize(tx.vout.size());
+    for (size_t i = 0; i < tx.vout.size(); i++) {
+        w.WriteU64((uint64_t)tx.vout[i].nValue);
+        w.WriteVarBytes(tx.vout[i].scriptPubKey);
+    }
+    w.WriteU32(tx.nLockTime);
+}
+
+/** Throws SerializeError on malformed input. */
+void UnserializeTransaction(ByteReader& r, MutableTransaction& tx);
+TransactionRef ReadTransaction(ByteReader& r);
+
+template <typename Tx>
+std::vector<unsigned char> SerializeTransaction(const Tx& tx)
+{
+    std::vector<unsigned char> out;
+    ByteWriter w(out);
+    SerializeTransaction(w, tx);
+    return out;
+}
+
+#endif // ONECOIN_TRANSACTION_H
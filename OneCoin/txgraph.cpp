@@ -0,0 +1,96 @@
+#include "txgraph.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace {
+
+/** Union-find over transaction indexes with path halving. */
+class DisjointSets {
+public:
+    explicit DisjointSets(size_t n) : parent(n)
+    {
+        for (size_t i = 0; i < n; i++)
+            parent[i] = (uint32_t)i;
+    }
+
+    uint32_t Find(uint32_t x)
+    {
+        while (parent[x] != x) {
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    }
+
+    /** Keeps the smaller root, so a group's root is its first transaction. */
+    void Union(uint32_t a, uint32_t b)
+    {
+        a = Find(a);
+        b = Find(b);
+        if (a < b)
+            parent[b] = a;
+        else if (b < a)
+            parent[a] = b;
+    }
+
+private:
+    std::vector<uint32_t> parent;
+};
+
+} // namespace
+
+size_t BlockTxGraph::LargestGroup() const
+{
+    size_t nLargest = 0;
+    for (size_t i = 0; i < groups.size(); i++)
+        nLargest = std::max(nLargest, groups[i].size());
+    return nLargest;
+}
+
+void BuildBlockTxGraph(const std::vector<TransactionRef>& vtx, BlockTxGraph& graph)
+{
+    graph.groups.clear();
+    graph.nInBlockSpends = 0;
+    if (vtx.size() < 2)
+        return;
+
+    size_t nInputs = 0;
+    std::unordered_map<uint256, uint32_t, Uint256Hasher> txIndex;
+    txIndex.reserve(vtx.size());
+    for (size_t i = 1; i < vtx.size(); i++) {
+        txIndex.emplace(vtx[i]->GetHash(), (uint32_t)i);
+        nInputs += vtx[i]->vin.size();
+    }
+
+    // Later spenders of an outpoint join its first spender; CheckTxInputs
+    // then finds the conflict within one group.
+    DisjointSets sets(vtx.size());
+    std::unordered_map<OutPoint, uint32_t, OutPointHasher> spender;
+    spender.reserve(nInputs);
+    for (size_t i = 1; i < vtx.size(); i++) {
+        const std::vector<TxIn>& vin = vtx[i]->vin;
+        for (size_t j = 0; j < vin.size(); j++) {
+            std::unordered_map<uint256, uint32_t, Uint256Hasher>::const_iterator parent = txIndex.find(vin[j].prevout.hash);
+            if (parent != txIndex.end()) {
+                sets.Union((uint32_t)i, parent->second);
+                graph.nInBlockSpends++;
+            }
+            std::pair<std::unordered_map<OutPoint, uint32_t, OutPointHasher>::iterator, bool> ins =
+                spender.emplace(vin[j].prevout, (uint32_t)i);
+            if (!ins.second)
+                sets.Union((uint32_t)i, ins.first->second);
+        }
+    }
+
+    // Roots are first transactions, so groups come out in block order.
+    std::vector<uint32_t> groupOf(vtx.size(), UINT32_MAX);
+    for (size_t i = 1; i < vtx.size(); i++) {
+        uint32_t root = sets.Find((uint32_t)i);
+        if (groupOf[root] == UINT32_MAX) {
+            groupOf[root] = (uint32_t)graph.groups.size();
+            graph.groups.push_back(std::vector<uint32_t>());
+        }
+        graph.groups[groupOf[root]].push_back((uint32_t)i);
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef ONECOIN_TXGRAPH_H
+#define ONECOIN_TXGRAPH_H
+
+#include "transaction.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * The non-coinbase transactions of a block split into groups that touch
+ * disjoint sets of coins, so each group can be checked and applied on its
+ * own. Two transactions share a group when one spends an output of the
+ * other or both spend the same output.
+ */
+struct BlockTxGraph {
+    /** Indexes into the block's transactions, in block order within each
+     *  group; groups are ordered by their first transaction. */
+    std::vector<std::vector<uint32_t> > groups;
+    /** Inputs spending an output created in the same block. */
+    size_t nInBlockSpends;
+
+    BlockTxGraph() : nInBlockSpends(0) {}
+
+    size_t LargestGroup() const;
+};
+
+/** Groups vtx[1..]; vtx[0] is the coinbase, whose outputs cannot be spent
+ *  in their own block. */
+void BuildBlockTxGraph(const std::vector<TransactionRef>& vtx, BlockTxGraph& graph);
+
+#endif // ONECOIN_TXGRAPH_H
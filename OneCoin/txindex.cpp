@@ -0,0 +1,102 @@
+#include "txindex.h"
+#include "serialize.h"
+
+#include <string.h>
+#include <stdexcept>
+
+namespace {
+
+/** Entries are under 't' + txid. */
+const char DB_TX = 't';
+
+std::string TxKey(const uint256& txid)
+{
+    std::string key(1 + 32, DB_TX);
+    memcpy(&key[1], txid.begin(), 32);
+    return key;
+}
+
+} // namespace
+
+TxIndex::TxIndex(const std::string& dir, Chainstate& chainstate) : BaseIndex("transaction index", dir, chainstate)
+{
+}
+
+TxIndex::~TxIndex()
+{
+    Stop();
+}
+
+bool TxIndex::FindTx(const uint256& txid, TxIndexEntry& entry) const
+{
+    std::string value;
+    if (!store || !store->Get(TxKey(txid), value))
+        return false;
+    try {
+        ByteReader r((const unsigned char*)value.data(), value.size());
+        uint64_t nFile = r.ReadVarInt();
+        uint64_t nPos = r.ReadVarInt();
+        uint64_t nTxOffset = r.ReadVarInt();
+        uint64_t nTxSize = r.ReadVarInt();
+        if (!r.Empty() || nFile > INT32_MAX || nPos > UINT32_MAX || nTxOffset > UINT32_MAX || nTxSize > UINT32_MAX)
+            throw SerializeError("out of range");
+        entry.blockPos = FlatFilePos((int)nFile, (unsigned int)nPos);
+        entry.nTxOffset = (uint32_t)nTxOffset;
+        entry.nTxSize = (uint32_t)nTxSize;
+    } catch (const SerializeError&) {
+        throw std::runtime_error("corrupt entry in the transaction index");
+    }
+    return true;
+}
+
+bool TxIndex::GetTransaction(const uint256& txid, TransactionRef& tx, uint256& hashBlock) const
+{
+    TxIndexEntry entry;
+    if (!FindTx(txid, entry))
+        return false;
+    std::vector<unsigned char> header, data;
+    if (!blockStore.ReadBlockPart(entry.blockPos, 0, BlockHeader::SIZE, header) ||
+        !blockStore.ReadBlockPart(entry.blockPos, entry.nTxOffset, entry.nTxSize, data)) {
+        return false;
+    }
+    try {
+        ByteReader r(data);
+        tx = ReadTransaction(r);
+        if (!r.Empty())
+            return false;
+    } catch (const SerializeError&) {
+        return false;
+    }
+    if (tx->GetHash() != txid)
+        return false;
+    BlockHeader blockHeader;
+    blockHeader.Deserialize(header.data());
+    hashBlock = blockHeader.GetHash();
+    return true;
+}
+
+void TxIndex::WriteBlocks(const std::vector<BlockRef>& blocks, const uint256& hashBest)
+{
+    LsmWriteBatch batch;
+    std::vector<unsigned char> buf;
+    for (size_t i = 0; i < blocks.size(); i++) {
+        if (!blocks[i].fConnect)
+            continue;
+        Block block;
+        ReadBlock(blocks[i], block);
+        uint32_t nOffset = BlockHeader::SIZE + GetCompactSizeLen(block.vtx.size());
+        for (size_t j = 0; j < block.vtx.size(); j++) {
+            uint32_t nSize = (uint32_t)block.vtx[j]->GetTotalSize();
+            buf.clear();
+            ByteWriter w(buf);
+            w.WriteVarInt(blocks[i].blockPos.nFile);
+            w.WriteVarInt(blocks[i].blockPos.nPos);
+            w.WriteVarInt(nOffset);
+            w.WriteVarInt(nSize);
+            batch.Put(TxKey(block.vtx[j]->GetHash()), std::string(buf.begin(), buf.end()));
+            nOffset += nSize;
+        }
+    }
+    PutBestBlock(batch, hashBest);
+    store->Write(batch);
+}
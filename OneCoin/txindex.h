@@ -0,0 +1,46 @@
+#ifndef ONECOIN_TXINDEX_H
+#define ONECOIN_TXINDEX_H
+
+#include "baseindex.h"
+#include "chain.h"
+#include "transaction.h"
+#include "uint256.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/** Where a transaction is stored: its block and its bytes within the
+ *  serialized block. */
+struct TxIndexEntry {
+    FlatFilePos blockPos;
+    uint32_t nTxOffset;
+    uint32_t nTxSize;
+
+    TxIndexEntry() : nTxOffset(0), nTxSize(0) {}
+};
+
+/**
+ * An optional index from txid to block file position, so a transaction is
+ * found with one lookup and read with two small reads of its block. See
+ * BaseIndex for how it is built and kept up to date.
+ *
+ * A disconnected block's entries stay: they point at a block still on
+ * disk, which GetTransaction() reports, and are overwritten if the
+ * transactions confirm again.
+ */
+class TxIndex : public BaseIndex {
+public:
+    TxIndex(const std::string& dir, Chainstate& chainstate);
+    ~TxIndex();
+
+    bool FindTx(const uint256& txid, TxIndexEntry& entry) const;
+    /** Reads an indexed transaction back from the block files along with
+     *  the hash of the block holding it. */
+    bool GetTransaction(const uint256& txid, TransactionRef& tx, uint256& hashBlock) const;
+
+protected:
+    void WriteBlocks(const std::vector<BlockRef>& blocks, const uint256& hashBest);
+};
+
+#endif // ONECOIN_TXINDEX_H
@@ -0,0 +1,167 @@
+#include "txorphanage.h"
+
+#include <algorithm>
+
+namespace {
+
+/** Removes one copy of txid from v, in any order. */
+void SwapRemove(std::vector<uint256>& v, const uint256& txid)
+{
+    std::vector<uint256>::iterator it = std::find(v.begin(), v.end(), txid);
+    if (it == v.end())
+        return;
+    *it = v.back();
+    v.pop_back();
+}
+
+} // namespace
+
+TxOrphanage::TxOrphanage(size_t nMaxBytes, size_t nMaxPeerBytes, uint64_t seed)
+    : nMaxBytes(nMaxBytes), nMaxPeerBytes(nMaxPeerBytes), rng(seed), nTotalUsage(0), nEvicted(0)
+{
+}
+
+size_t TxOrphanage::Usage(const Transaction& tx)
+{
+    // The entry with its map node and list slots, then an index slot per input.
+    return tx.GetTotalSize() + sizeof(OrphanEntry) + 3 * sizeof(uint256) + 2 * sizeof(void*) +
+           tx.vin.size() * (sizeof(OutPoint) + sizeof(uint256) + 2 * sizeof(void*));
+}
+
+bool TxOrphanage::AddTx(const TransactionRef& tx, NodeId peer)
+{
+    const uint256& txid = tx->GetHash();
+    if (orphans.count(txid) || tx->GetTotalSize() > MAX_ORPHAN_TX_SIZE)
+        return false;
+    size_t nUsage = Usage(*tx);
+    if (nUsage > nMaxPeerBytes || nUsage > nMaxBytes)
+        return false;
+
+    PeerOrphans& mine = peers[peer];
+    OrphanEntry& entry = orphans[txid];
+    entry.tx = tx;
+    entry.peer = peer;
+    entry.nUsage = nUsage;
+    entry.nPos = txids.size();
+    entry.nPeerPos = mine.txids.size();
+    txids.push_back(txid);
+    mine.txids.push_back(txid);
+    mine.nUsage += nUsage;
+    nTotalUsage += nUsage;
+    for (size_t i = 0; i < tx->vin.size(); i++)
+        byPrevout[tx->vin[i].prevout].push_back(txid);
+
+    while (mine.nUsage > nMaxPeerBytes)
+        EvictRandom(mine.txids);
+    while (nTotalUsage > nMaxBytes)
+        EvictRandom(txids);
+    return orphans.count(txid) != 0;
+}
+
+TransactionRef TxOrphanage::GetTx(const uint256& txid) const
+{
+    OrphanMap::const_iterator it = orphans.find(txid);
+    return it == orphans.end() ? TransactionRef() : it->second.tx;
+}
+
+bool TxOrphanage::EraseTx(const uint256& txid)
+{
+    OrphanMap::iterator it = orphans.find(txid);
+    if (it == orphans.end())
+        return false;
+    Erase(it);
+    return true;
+}
+
+size_t TxOrphanage::EraseForPeer(NodeId peer)
+{
+    std::unordered_map<NodeId, PeerOrphans>::iterator it = peers.find(peer);
+    if (it == peers.end())
+        return 0;
+    // Erase() drops the peer along with its last orphan.
+    std::vector<uint256> mine(it->second.txids);
+    for (size_t i = 0; i < mine.size(); i++)
+        EraseTx(mine[i]);
+    return mine.size();
+}
+
+size_t TxOrphanage::EraseForBlock(const Block& block)
+{
+    std::vector<uint256> gone;
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        const Transaction& tx = *block.vtx[i];
+        if (orphans.count(tx.GetHash()))
+            gone.push_back(tx.GetHash());
+        if (tx.IsCoinBase())
+            continue;
+        for (size_t j = 0; j < tx.vin.size(); j++) {
+            std::unordered_map<OutPoint, std::vector<uint256>, OutPointHasher>::const_iterator spenders =
+                byPrevout.find(tx.vin[j].prevout);
+            if (spenders != byPrevout.end())
+                gone.insert(gone.end(), spenders->second.begin(), spenders->second.end());
+        }
+    }
+    size_t nErased = 0;
+    for (size_t i = 0; i < gone.size(); i++)
+        nErased += EraseTx(gone[i]);
+    return nErased;
+}
+
+void TxOrphanage::GetChildren(const Transaction& parent, std::vector<TransactionRef>& children) const
+{
+    children.clear();
+    std::vector<uint256> found;
+    for (size_t i = 0; i < parent.vout.size(); i++) {
+        std::unordered_map<OutPoint, std::vector<uint256>, OutPointHasher>::const_iterator spenders =
+            byPrevout.find(OutPoint(parent.GetHash(), (uint32_t)i));
+        if (spenders != byPrevout.end())
+            found.insert(found.end(), spenders->second.begin(), spenders->second.end());
+    }
+    // A child spending several outputs of parent is indexed under each.
+    std::sort(found.begin(), found.end());
+    found.erase(std::unique(found.begin(), found.end()), found.end());
+    for (size_t i = 0; i < found.size(); i++)
+        children.push_back(orphans.find(found[i])->second.tx);
+}
+
+size_t TxOrphanage::PeerUsage(NodeId peer) const
+{
+    std::unordered_map<NodeId, PeerOrphans>::const_iterator it = peers.find(peer);
+    return it == peers.end() ? 0 : it->second.nUsage;
+}
+
+void TxOrphanage::Erase(OrphanMap::iterator it)
+{
+    const OrphanEntry& entry = it->second;
+    const Transaction& tx = *entry.tx;
+    for (size_t i = 0; i < tx.vin.size(); i++) {
+        std::unordered_map<OutPoint, std::vector<uint256>, OutPointHasher>::iterator spenders =
+            byPrevout.find(tx.vin[i].prevout);
+        if (spenders == byPrevout.end())
+            continue;
+        SwapRemove(spenders->second, it->first);
+        if (spenders->second.empty())
+            byPrevout.erase(spenders);
+    }
+
+    // Move the last orphan of each list into the freed slot.
+    txids[entry.nPos] = txids.back();
+    orphans[txids[entry.nPos]].nPos = entry.nPos;
+    txids.pop_back();
+    PeerOrphans& mine = peers[entry.peer];
+    mine.txids[entry.nPeerPos] = mine.txids.back();
+    orphans[mine.txids[entry.nPeerPos]].nPeerPos = entry.nPeerPos;
+    mine.txids.pop_back();
+    mine.nUsage -= entry.nUsage;
+    nTotalUsage -= entry.nUsage;
+    if (mine.txids.empty())
+        peers.erase(entry.peer);
+    orphans.erase(it);
+}
+
+void TxOrphanage::EvictRandom(const std::vector<uint256>& from)
+{
+    uint256 txid = from[rng() % from.size()];
+    EraseTx(txid);
+    nEvicted++;
+}
@@ -0,0 +1,91 @@
+#ifndef ONECOIN_TXORPHANAGE_H
+#define ONECOIN_TXORPHANAGE_H
+
+#include "block.h"
+#include "transaction.h"
+#include "uint256.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+typedef int64_t NodeId;
+
+/** Largest orphan kept: bigger ones are cheaper to fetch again than to hold. */
+static const size_t MAX_ORPHAN_TX_SIZE = 100000;
+static const size_t DEFAULT_MAX_ORPHAN_BYTES = 5000000;
+static const size_t DEFAULT_MAX_ORPHAN_PEER_BYTES = 500000;
+
+/**
+ * Transactions that arrived before one of their parents, held until the
+ * parent shows up. Orphans are indexed by the outpoints they spend, so a new
+ * transaction finds its waiting children with one lookup per output.
+ *
+ * Memory is bounded twice: each peer's orphans stay within a quota and all
+ * of them within a total, both counted as serialized size plus the entry and
+ * index overhead. Going over either evicts orphans at random, from the peer
+ * or from the whole pool, so a peer cannot choose what gets pushed out.
+ */
+class TxOrphanage {
+public:
+    TxOrphanage(size_t nMaxBytes = DEFAULT_MAX_ORPHAN_BYTES, size_t nMaxPeerBytes = DEFAULT_MAX_ORPHAN_PEER_BYTES,
+                uint64_t seed = std::random_device()());
+
+    /** Stores tx from peer. False if it is already held, too large, or was
+     *  evicted straight away to make room. */
+    bool AddTx(const TransactionRef& tx, NodeId peer);
+    bool HaveTx(const uint256& txid) const { return orphans.count(txid) != 0; }
+    TransactionRef GetTx(const uint256& txid) const;
+    bool EraseTx(const uint256& txid);
+    /** Drops everything a disconnected peer sent. */
+    size_t EraseForPeer(NodeId peer);
+    /** Drops orphans the block includes or conflicts with. */
+    size_t EraseForBlock(const Block& block);
+
+    /** Orphans spending an output of parent, each once, in no set order. */
+    void GetChildren(const Transaction& parent, std::vector<TransactionRef>& children) const;
+
+    size_t Size() const { return orphans.size(); }
+    size_t TotalUsage() const { return nTotalUsage; }
+    size_t PeerUsage(NodeId peer) const;
+    /** Orphans evicted to stay within the bounds since construction. */
+    uint64_t EvictedCount() const { return nEvicted; }
+
+    /** What an orphan counts against the bounds. */
+    static size_t Usage(const Transaction& tx);
+
+private:
+    struct OrphanEntry {
+        TransactionRef tx;
+        NodeId peer;
+        size_t nUsage;
+        /** Positions in txids and in the peer's txids, for O(1) removal. */
+        size_t nPos;
+        size_t nPeerPos;
+    };
+    struct PeerOrphans {
+        std::vector<uint256> txids;
+        size_t nUsage;
+
+        PeerOrphans() : nUsage(0) {}
+    };
+    typedef std::unordered_map<uint256, OrphanEntry, Uint256Hasher> OrphanMap;
+
+    size_t nMaxBytes;
+    size_t nMaxPeerBytes;
+    std::mt19937_64 rng;
+    OrphanMap orphans;
+    /** Every orphan, for picking one at random. */
+    std::vector<uint256> txids;
+    std::unordered_map<NodeId, PeerOrphans> peers;
+    std::unordered_map<OutPoint, std::vector<uint256>, OutPointHasher> byPrevout;
+    size_t nTotalUsage;
+    uint64_t nEvicted;
+
+    void Erase(OrphanMap::iterator it);
+    void EvictRandom(const std::vector<uint256>& from);
+};
+
+#endif // ONECOIN_TXORPHANAGE_H
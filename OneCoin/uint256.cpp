@@ -0,0 +1,35 @@
+#include "uint256.h"
+#include "encoding.h"
+
+#include <random>
+
+uint256::uint256(const std::vector<unsigned char>& vch)
+{
+    memset(data, 0, sizeof(data));
+    memcpy(data, vch.data(), vch.size() < WIDTH ? vch.size() : WIDTH);
+}
+
+std::string uint256::GetHex() const
+{
+    unsigned char rev[WIDTH];
+    for (size_t i = 0; i < WIDTH; i++)
+        rev[i] = data[WIDTH - 1 - i];
+    return HexStr(rev, WIDTH);
+}
+
+bool uint256::SetHex(const std::string& str)
+{
+    unsigned char rev[WIDTH];
+    std::string s = str.compare(0, 2, "0x") == 0 ? str.substr(2) : str;
+    if (s.size() != 2 * WIDTH || !HexDecode(s.data(), s.size(), rev))
+        return false;
+    for (size_t i = 0; i < WIDTH; i++)
+        data[i] = rev[WIDTH - 1 - i];
+    return true;
+}
+
+Uint256Hasher::Uint256Hasher()
+{
+    static const uint64_t process_salt = ((uint64_t)std::random_device()() << 32) | std::random_device()();
+    salt = process_salt;
+}
@@ -0,0 +1,74 @@
+#ifndef ONECOIN_UINT256_H
+#define ONECOIN_UINT256_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+/** Opaque 256-bit blob: block hashes, txids and Merkle roots. Bytes are kept
+ *  in the order they are hashed and serialized; GetHex() shows them reversed,
+ *  as block explorers do. Use arith_uint256 for arithmetic. */
+class uint256 {
+public:
+    static const size_t WIDTH = 32;
+
+    uint256() { memset(data, 0, sizeof(data)); }
+    explicit uint256(const std::vector<unsigned char>& vch);
+    explicit uint256(const unsigned char* bytes) { memcpy(data, bytes, sizeof(data)); }
+
+    bool IsNull() const
+    {
+        uint64_t acc = 0;
+        for (size_t i = 0; i < WIDTH; i += 8)
+            acc |= GetUint64(i / 8);
+        return acc == 0;
+    }
+    void SetNull() { memset(data, 0, sizeof(data)); }
+
+    int Compare(const uint256& other) const { return memcmp(data, other.data, sizeof(data)); }
+    friend bool operator==(const uint256& a, const uint256& b) { return a.Compare(b) == 0; }
+    friend bool operator!=(const uint256& a, const uint256& b) { return a.Compare(b) != 0; }
+    friend bool operator<(const uint256& a, const uint256& b) { return a.Compare(b) < 0; }
+
+    std::string GetHex() const;
+    /** Parses the reversed hex form produced by GetHex(). */
+    bool SetHex(const std::string& str);
+    static uint256 FromHex(const std::string& str)
+    {
+        uint256 r;
+        r.SetHex(str);
+        return r;
+    }
+
+    /** Little-endian 64-bit word `pos` (0..3). */
+    uint64_t GetUint64(size_t pos) const
+    {
+        const unsigned char* p = data + pos * 8;
+        return (uint64_t)p[0] | (uint64_t)p[1] << 8 | (uint64_t)p[2] << 16 | (uint64_t)p[3] << 24 |
+               (uint64_t)p[4] << 32 | (uint64_t)p[5] << 40 | (uint64_t)p[6] << 48 | (uint64_t)p[7] << 56;
+    }
+
+    unsigned char* begin() { return data; }
+    unsigned char* end() { return data + WIDTH; }
+    const unsigned char* begin() const { return data; }
+    const unsigned char* end() const { return data + WIDTH; }
+    static size_t size() { return WIDTH; }
+
+private:
+    unsigned char data[WIDTH];
+};
+
+/** Hash functor for unordered containers keyed by hashes. The keys are
+ *  already uniformly distributed, so a salted word is enough. */
+struct Uint256Hasher {
+    size_t operator()(const uint256& h) const { return (size_t)(h.GetUint64(1) ^ salt); }
+
+    Uint256Hasher();
+
+private:
+    uint64_t salt;
+};
+
+#endif // ONECOIN_UINT256_H
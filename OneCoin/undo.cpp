@@ -0,0 +1,32 @@
+#include "undo.h"
+#include "compressor.h"
+
+void SerializeBlockUndo(ByteWriter& w, const BlockUndo& undo)
+{
+    w.WriteCompactSize(undo.vtxundo.size());
+    for (size_t i = 0; i < undo.vtxundo.size(); i++) {
+        const std::vector<Coin>& prevouts = undo.vtxundo[i].vprevout;
+        w.WriteCompactSize(prevouts.size());
+        for (size_t j = 0; j < prevouts.size(); j++)
+            SerializeCompressedCoin(w, prevouts[j]);
+    }
+}
+
+void UnserializeBlockUndo(ByteReader& r, BlockUndo& undo)
+{
+    // Bound counts by the bytes left: each entry takes at least one byte
+    // and a compressed coin at least three.
+    uint64_t nTx = r.ReadCompactSize();
+    if (nTx > r.Remaining())
+        throw SerializeError("undo transaction count exceeds data");
+    undo.vtxundo.assign(nTx, TxUndo());
+    for (size_t i = 0; i < nTx; i++) {
+        uint64_t nIn = r.ReadCompactSize();
+        if (nIn > r.Remaining() / 3)
+            throw SerializeError("undo input count exceeds data");
+        std::vector<Coin>& prevouts = undo.vtxundo[i].vprevout;
+        prevouts.resize(nIn);
+        for (size_t j = 0; j < nIn; j++)
+            UnserializeCompressedCoin(r, prevouts[j]);
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef ONECOIN_UNDO_H
+#define ONECOIN_UNDO_H
+
+#include "coins.h"
+#include "serialize.h"
+
+#include <vector>
+
+/** The coins a transaction spent, in input order. */
+struct TxUndo {
+    std::vector<Coin> vprevout;
+};
+
+/** Everything needed to disconnect a block: one TxUndo per non-coinbase
+ *  transaction. */
+struct BlockUndo {
+    std::vector<TxUndo> vtxundo;
+};
+
+/** Spent coins in their compressed form, see compressor.h. */
+void SerializeBlockUndo(ByteWriter& w, const BlockUndo& undo);
+/** Throws SerializeError on malformed input. */
+void UnserializeBlockUndo(ByteReader& r, BlockUndo& undo);
+
+#endif // ONECOIN_UNDO_H
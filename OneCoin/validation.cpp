@@ -0,0 +1,1474 @@
+#include "validation.h"
+#include "consensus.h"
+#include "fs.h"
+#include "interpreter.h"
+#include "merkle.h"
+#include "pow.h"
+#include "snapshot.h"
+#include "txgraph.h"
+#include "workqueue.h"
+
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <deque>
+#include <iterator>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+bool CheckTransaction(const Transaction& tx, ValidationState& state)
+{
+    if (tx.vin.empty())
+        return state.Invalid("bad-txns-vin-empty");
+    if (tx.vout.empty())
+        return state.Invalid("bad-txns-vout-empty");
+    if (tx.GetTotalSize() > MAX_BLOCK_SIZE)
+        return state.Invalid("bad-txns-oversize");
+
+    Amount nValueOut = 0;
+    for (size_t i = 0; i < tx.vout.size(); i++) {
+        if (tx.vout[i].nValue < 0)
+            return state.Invalid("bad-txns-vout-negative");
+        if (tx.vout[i].nValue > MAX_MONEY)
+            return state.Invalid("bad-txns-vout-toolarge");
+        nValueOut += tx.vout[i].nValue;
+        if (!MoneyRange(nValueOut))
+            return state.Invalid("bad-txns-txouttotal-toolarge");
+    }
+
+    if (tx.IsCoinBase()) {
+        if (tx.vin[0].scriptSig.size() < 2 || tx.vin[0].scriptSig.size() > 100)
+            return state.Invalid("bad-cb-length");
+        return true;
+    }
+
+    // Small input counts are far more common than large ones; a sort beats
+    // building a set for them.
+    std::vector<OutPoint> prevouts;
+    prevouts.reserve(tx.vin.size());
+    for (size_t i = 0; i < tx.vin.size(); i++) {
+        if (tx.vin[i].prevout.IsNull())
+            return state.Invalid("bad-txns-prevout-null");
+        prevouts.push_back(tx.vin[i].prevout);
+    }
+    std::sort(prevouts.begin(), prevouts.end());
+    if (std::adjacent_find(prevouts.begin(), prevouts.end()) != prevouts.end())
+        return state.Invalid("bad-txns-inputs-duplicate");
+    return true;
+}
+
+bool CheckTxInputs(const Transaction& tx, ValidationState& state, const CoinsViewCache& inputs, int nSpendHeight,
+    Amount& txfee)
+{
+    Amount nValueIn = 0;
+    for (size_t i = 0; i < tx.vin.size(); i++) {
+        const Coin& coin = inputs.AccessCoin(tx.vin[i].prevout);
+        if (coin.IsSpent())
+            return state.Invalid("bad-txns-inputs-missingorspent");
+        if (coin.fCoinBase && nSpendHeight - coin.nHeight < COINBASE_MATURITY)
+            return state.Invalid("bad-txns-premature-spend-of-coinbase");
+        nValueIn += coin.out.nValue;
+        if (!MoneyRange(coin.out.nValue) || !MoneyRange(nValueIn))
+            return state.Invalid("bad-txns-inputvalues-outofrange");
+    }
+    Amount nValueOut = tx.GetValueOut();
+    if (nValueIn < nValueOut)
+        return state.Invalid("bad-txns-in-belowout");
+    txfee = nValueIn - nValueOut;
+    return true;
+}
+
+static bool InvalidScript(ValidationState& state, ScriptError error)
+{
+    return state.Invalid(std::string("mandatory-script-verify-flag-failed (") + ScriptErrorString(error) + ")");
+}
+
+bool CheckInputScripts(const Transaction& tx, ValidationState& state, const CoinsViewCache& inputs, unsigned int flags)
+{
+    for (size_t i = 0; i < tx.vin.size(); i++) {
+        const Coin& coin = inputs.AccessCoin(tx.vin[i].prevout);
+        ScriptError error;
+        if (!VerifyScript(tx.vin[i].scriptSig, coin.out.scriptPubKey, flags,
+                TransactionSignatureChecker(tx, (unsigned int)i), &error)) {
+            return InvalidScript(state, error);
+        }
+    }
+    return true;
+}
+
+bool IsFinalTx(const Transaction& tx, int nBlockHeight, int64_t nBlockTime)
+{
+    if (tx.nLockTime == 0)
+        return true;
+    if ((int64_t)tx.nLockTime < (tx.nLockTime < LOCKTIME_THRESHOLD ? (int64_t)nBlockHeight : nBlockTime))
+        return true;
+    for (size_t i = 0; i < tx.vin.size(); i++) {
+        if (tx.vin[i].nSequence != TxIn::SEQUENCE_FINAL)
+            return false;
+    }
+    return true;
+}
+
+bool CheckBlockHeader(const BlockHeader& header, ValidationState& state, const ConsensusParams& params, bool fCheckPOW)
+{
+    if (fCheckPOW && !CheckProofOfWork(header.GetHash(), header.nBits, params))
+        return state.Invalid("high-hash");
+    return true;
+}
+
+bool CheckBlock(const Block& block, ValidationState& state, const ConsensusParams& params, bool fCheckPOW,
+    bool fCheckMerkleRoot)
+{
+    if (!CheckBlockHeader(block, state, params, fCheckPOW))
+        return false;
+
+    if (fCheckMerkleRoot) {
+        bool mutated;
+        if (BlockMerkleRoot(block, &mutated) != block.hashMerkleRoot)
+            return state.Invalid("bad-txnmrklroot");
+        // Duplicated transactions give the same root as the honest block,
+        // so they must be rejected rather than cached as invalid.
+        if (mutated)
+            return state.Invalid("bad-txns-duplicate");
+    }
+
+    if (block.vtx.empty())
+        return state.Invalid("bad-blk-length");
+    size_t nSize = BlockHeader::SIZE + GetCompactSizeLen(block.vtx.size());
+    for (size_t i = 0; i < block.vtx.size(); i++)
+        nSize += block.vtx[i]->GetTotalSize();
+    if (nSize > MAX_BLOCK_SIZE)
+        return state.Invalid("bad-blk-length");
+
+    if (!block.vtx[0]->IsCoinBase())
+        return state.Invalid("bad-cb-missing");
+    for (size_t i = 1; i < block.vtx.size(); i++) {
+        if (block.vtx[i]->IsCoinBase())
+            return state.Invalid("bad-cb-multiple");
+    }
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        if (!CheckTransaction(*block.vtx[i], state))
+            return false;
+    }
+    return true;
+}
+
+bool BlockIndexWorkComparator::operator()(const BlockIndex* a, const BlockIndex* b) const
+{
+    if (a->nChainWork != b->nChainWork)
+        return a->nChainWork > b->nChainWork;
+    if (a->nSequenceId != b->nSequenceId)
+        return a->nSequenceId < b->nSequenceId;
+    return a < b;
+}
+
+namespace {
+
+/** Blocks with fewer transactions are connected in order: the graph and
+ *  the thread hand-off cost more than they save. */
+const size_t PARALLEL_CONNECT_MIN_TXS = 32;
+/** Shards of the coins view the connect threads share. */
+const size_t CONNECT_SHARDS = 64;
+/** Tasks per connect thread; each takes a run of groups through one cache,
+ *  since most groups are a single payment. */
+const size_t CONNECT_TASKS_PER_THREAD = 8;
+
+/** Checks a non-coinbase transaction against view, spends its inputs into
+ *  txundo and adds its outputs. */
+bool ConnectTransaction(const Transaction& tx, size_t nTx, ValidationState& state, int nHeight,
+    CoinsViewCache& view, TxUndo& txundo, const BlockScriptChecks* pchecks, bool fScriptChecks, Amount& txfee)
+{
+    if (!CheckTxInputs(tx, state, view, nHeight, txfee))
+        return false;
+    if (!fScriptChecks) {
+        // Assumed valid: the spends above are all that is checked.
+    } else if (pchecks && (*pchecks)[nTx].fChecked) {
+        if ((*pchecks)[nTx].error != SCRIPT_ERR_OK)
+            return InvalidScript(state, (*pchecks)[nTx].error);
+    } else if (!CheckInputScripts(tx, state, view, MANDATORY_SCRIPT_VERIFY_FLAGS)) {
+        return false;
+    }
+
+    std::vector<Coin>& prevouts = txundo.vprevout;
+    prevouts.resize(tx.vin.size());
+    for (size_t j = 0; j < tx.vin.size(); j++)
+        view.SpendCoin(tx.vin[j].prevout, &prevouts[j]);
+    view.AddCoins(tx, nHeight);
+    return true;
+}
+
+/** Blocks queued between two replay stages. */
+const size_t REPLAY_QUEUE_SIZE = 4;
+/** Blocks whose outputs the prefetch stage resolves from memory: more than
+ *  can be queued between it and the connecting thread, whose coins are not
+ *  in the coins tip yet. */
+const size_t REPLAY_RECENT_BLOCKS = 16;
+
+/** A block on its way through the replay stages. */
+struct ReplayItem {
+    FlatFilePos pos;
+    Block block;
+    /** Output script each input spends, over the inputs of every
+     *  non-coinbase transaction in order; prevFound is 0 for the ones the
+     *  prefetch stage could not find. */
+    std::vector<Script> prevScripts;
+    std::vector<char> prevFound;
+    BlockScriptChecks checks;
+};
+
+bool ReadReplayBlock(const unsigned char* data, size_t len, Block& block)
+{
+    try {
+        ByteReader r(data, len);
+        UnserializeBlock(r, block);
+    } catch (const SerializeError&) {
+        return false;
+    }
+    return true;
+}
+
+/** Blocks a reindex hashes or deserializes per task, and hands on together. */
+const size_t REINDEX_CHUNK_BLOCKS = 64;
+const int REINDEX_HEIGHT_UNKNOWN = -2;
+
+/** A record of the mapped block files, as a reindex orders them. */
+struct ReindexRecord {
+    FlatFilePos pos;
+    const unsigned char* data;
+    size_t len;
+    uint256 hash;
+    uint256 hashPrev;
+    /** -1 for records left out: too short for a header, a copy of an
+     *  earlier record, or not connected to the block tree. */
+    int nHeight;
+
+    ReindexRecord() : data(NULL), len(0), nHeight(-1) {}
+};
+
+/**
+ * Finds the outputs a block's inputs spend before the blocks ahead of it are
+ * connected. Outputs of recent blocks come from the blocks themselves, the
+ * rest from the coins tip in one batch, which also warms its cache for the
+ * connecting thread. An outpoint's txid fixes the output, so what is found is right
+ * for every input that turns out to be spendable; the others fail when the
+ * block is connected, before their scripts matter.
+ */
+class ReplayPrefetcher {
+public:
+    ReplayPrefetcher(CoinsViewCache& coins, std::mutex& coinsMutex) : coins(coins), coinsMutex(coinsMutex) {}
+
+    void Prefetch(ReplayItem& item)
+    {
+        const std::vector<TransactionRef>& vtx = item.block.vtx;
+        Remember(vtx);
+
+        size_t nInputs = 0;
+        for (size_t i = 1; i < vtx.size(); i++)
+            nInputs += vtx[i]->vin.size();
+        item.prevScripts.assign(nInputs, Script());
+        item.prevFound.assign(nInputs, 0);
+        std::vector<size_t> missing;
+        std::vector<OutPoint> missingOutpoints;
+        size_t nInput = 0;
+        for (size_t i = 1; i < vtx.size(); i++) {
+            for (size_t j = 0; j < vtx[i]->vin.size(); j++, nInput++) {
+                const OutPoint& prevout = vtx[i]->vin[j].prevout;
+                RecentMap::const_iterator it = recentTx.find(prevout.hash);
+                if (it != recentTx.end() && prevout.n < it->second->vout.size()) {
+                    item.prevScripts[nInput] = it->second->vout[prevout.n].scriptPubKey;
+                    item.prevFound[nInput] = 1;
+                } else {
+                    missing.push_back(nInput);
+                    missingOutpoints.push_back(prevout);
+                }
+            }
+        }
+        if (missing.empty())
+            return;
+
+        // One batch for everything the recent blocks do not have: the
+        // coins tip reads all of its misses from disk at once.
+        std::vector<Coin> found;
+        {
+            std::lock_guard<std::mutex> lock(coinsMutex);
+            coins.GetCoins(missingOutpoints, found);
+        }
+        for (size_t m = 0; m < missing.size(); m++) {
+            if (found[m].IsSpent())
+                continue;
+            item.prevScripts[missing[m]] = std::move(found[m].out.scriptPubKey);
+            item.prevFound[missing[m]] = 1;
+        }
+    }
+
+private:
+    typedef std::unordered_map<uint256, TransactionRef, Uint256Hasher> RecentMap;
+
+    CoinsViewCache& coins;
+    std::mutex& coinsMutex;
+    RecentMap recentTx;
+    std::deque<std::vector<TransactionRef> > recentBlocks;
+
+    void Remember(const std::vector<TransactionRef>& vtx)
+    {
+        for (size_t i = 0; i < vtx.size(); i++)
+            recentTx[vtx[i]->GetHash()] = vtx[i];
+        recentBlocks.push_back(vtx);
+        if (recentBlocks.size() <= REPLAY_RECENT_BLOCKS)
+            return;
+        const std::vector<TransactionRef>& oldest = recentBlocks.front();
+        for (size_t i = 0; i < oldest.size(); i++) {
+            RecentMap::iterator it = recentTx.find(oldest[i]->GetHash());
+            if (it != recentTx.end() && it->second == oldest[i])
+                recentTx.erase(it);
+        }
+        recentBlocks.pop_front();
+    }
+};
+
+/** Verifies the scripts of every transaction whose spent outputs were all
+ *  found, up to the first failure: connecting stops there. */
+void CheckReplayScripts(ReplayItem& item)
+{
+    const std::vector<TransactionRef>& vtx = item.block.vtx;
+    item.checks.assign(vtx.size(), TxScriptCheck());
+    size_t nInput = 0;
+    for (size_t i = 1; i < vtx.size(); i++) {
+        const Transaction& tx = *vtx[i];
+        size_t nFirst = nInput;
+        nInput += tx.vin.size();
+        if (std::find(item.prevFound.begin() + nFirst, item.prevFound.begin() + nInput, 0) !=
+            item.prevFound.begin() + nInput)
+            continue;
+        TxScriptCheck& check = item.checks[i];
+        check.fChecked = true;
+        for (size_t j = 0; j < tx.vin.size(); j++) {
+            if (!VerifyScript(tx.vin[j].scriptSig, item.prevScripts[nFirst + j], MANDATORY_SCRIPT_VERIFY_FLAGS,
+                    TransactionSignatureChecker(tx, (unsigned int)j), &check.error))
+                return;
+        }
+    }
+}
+
+} // namespace
+
+Chainstate::Chainstate(const ChainParams& params, const std::string& datadir)
+    : params(params), blockStore(datadir + "/blocks", params.MessageStart()), nBlockSequenceId(1),
+      coinsDir(datadir + "/chainstate"), coinsDB(new CoinsViewDB(coinsDir)), coinsTip(new CoinsViewCache(coinsDB.get())),
+      nCoinsCacheLimit(1 << 20), fReplayPipeline(true), fReindex(false),
+      hashAssumeValid(params.GetConsensus().defaultAssumeValid), nPruneTarget(0), nPruneKeepBlocks(MIN_BLOCKS_TO_KEEP),
+      nPrunedFiles(0), nPruneHeight(-1), nPruneCheckFile(-1), nCheckpointHeight(-1)
+{
+    SetConnectThreads(std::thread::hardware_concurrency());
+}
+
+Chainstate::~Chainstate()
+{
+    Flush();
+}
+
+void Chainstate::SetConnectThreads(unsigned int nThreads)
+{
+    if (nThreads > 1)
+        connectWorkers.reset(new WorkerPool(nThreads));
+    else
+        connectWorkers.reset();
+}
+
+void Chainstate::SetCoinsBackend(CoinsBackend backend)
+{
+    coinsTip.reset();
+    if (backend == COINS_BACKEND_LSM) {
+        CoinsViewLsm* lsm = new CoinsViewLsm(coinsDir);
+        // Load() starts from these coins, so a flush has to reach the disk.
+        lsm->SetSyncWrites(true);
+        coinsDB.reset(lsm);
+    } else {
+        coinsDB.reset(new CoinsViewDB(coinsDir));
+    }
+    coinsTip.reset(new CoinsViewCache(coinsDB.get()));
+}
+
+bool Chainstate::Load(std::string& error)
+{
+    const std::string& dir = blockStore.Dir();
+    int nKeepUndoFile = -1;
+    if (!coinsDB->Open(error) || !LoadCheckpoint(nKeepUndoFile, error))
+        return false;
+    // A crash may have left pruned files behind.
+    for (int nFile = 0; nFile < nPrunedFiles; nFile++) {
+        RemoveFile(blockStore.BlockFilePath(nFile));
+        RemoveFile(blockStore.UndoFilePath(nFile));
+    }
+    // Undo data is regenerated while the block files are replayed, except
+    // for the blocks the checkpoint restored.
+    std::vector<int> files = blockStore.ListFiles();
+    for (size_t i = 0; i < files.size(); i++) {
+        if (files[i] > nKeepUndoFile && !RemoveFile(blockStore.UndoFilePath(files[i]))) {
+            error = "cannot remove " + blockStore.UndoFilePath(files[i]);
+            return false;
+        }
+    }
+    if (!blockStore.Open(error))
+        return false;
+    // Coins kept from before the last checkpoint catch up with it.
+    ValidationState state;
+    if (!ActivateBestChain(state)) {
+        error = "cannot reconnect the saved blocks: " + state.GetRejectReason();
+        return false;
+    }
+    if (!ReplayBlockFiles(error))
+        return false;
+    // The block index answers from here on.
+    if (LookupBlockIndex(hashAssumeValid))
+        setAssumeValidBlocks.clear();
+
+    if (!chainActive.Tip()) {
+        if (!mapBlockIndex.empty()) {
+            error = "block files in " + dir + " do not hold a valid genesis block";
+            return false;
+        }
+        if (!ProcessNewBlock(params.GenesisBlock(), state)) {
+            error = "cannot store genesis block: " + state.GetRejectReason();
+            return false;
+        }
+    }
+    nPruneCheckFile = -1;
+    return !IsPruneMode() || FlushCoins(error);
+}
+
+bool Chainstate::FindAssumeValidBlocks(std::string& error)
+{
+    setAssumeValidBlocks.clear();
+    if (hashAssumeValid.IsNull())
+        return true;
+
+    // Headers only: the walk back needs each block's parent.
+    std::unordered_map<uint256, uint256, Uint256Hasher> mapPrev;
+    for (int nFile = nPrunedFiles; nFile <= blockStore.LastFile(); nFile++) {
+        bool ok = blockStore.ScanBlockFile(nFile, [&](const FlatFilePos&, const unsigned char* data, size_t len) {
+            if (len < BlockHeader::SIZE)
+                return;
+            BlockHeader header;
+            header.Deserialize(data);
+            mapPrev.emplace(header.GetHash(), header.hashPrevBlock);
+        });
+        if (!ok) {
+            error = "cannot read " + blockStore.BlockFilePath(nFile);
+            return false;
+        }
+    }
+    MarkAssumeValidBlocks([&](const uint256& hash, uint256& hashPrev) {
+        std::unordered_map<uint256, uint256, Uint256Hasher>::const_iterator it = mapPrev.find(hash);
+        if (it == mapPrev.end())
+            return false;
+        hashPrev = it->second;
+        return true;
+    });
+    return true;
+}
+
+void Chainstate::MarkAssumeValidBlocks(const std::function<bool(const uint256& hash, uint256& hashPrev)>& findPrev)
+{
+    setAssumeValidBlocks.clear();
+    if (hashAssumeValid.IsNull())
+        return;
+    // A hash names one block, so whatever the walk reaches is an ancestor
+    // even if the chain turns out to be invalid further up.
+    uint256 hash = hashAssumeValid;
+    uint256 hashPrev;
+    while (findPrev(hash, hashPrev) && setAssumeValidBlocks.insert(hash).second) {
+        if (hash == params.GetConsensus().hashGenesisBlock)
+            break;
+        hash = hashPrev;
+    }
+}
+
+bool Chainstate::IsAssumedValid(const BlockIndex* pindex) const
+{
+    if (hashAssumeValid.IsNull())
+        return false;
+    const BlockIndex* pindexAssumed = LookupBlockIndex(hashAssumeValid);
+    if (pindexAssumed)
+        return pindexAssumed->GetAncestor(pindex->nHeight) == pindex;
+    return setAssumeValidBlocks.count(pindex->GetBlockHash()) != 0;
+}
+
+bool Chainstate::ReplayBlock(const Block& block, const FlatFilePos& pos, const BlockScriptChecks* pchecks,
+    std::string& error)
+{
+    uint256 hash = block.GetHash();
+    if (mapBlockIndex.count(hash))
+        return true;
+    // Blocks whose parent is missing or invalid are skipped.
+    if (hash != params.GetConsensus().hashGenesisBlock && !mapBlockIndex.count(block.hashPrevBlock))
+        return true;
+    ValidationState state;
+    BlockIndex* pindex = NULL;
+    if (!AcceptBlock(block, state, &pindex, &pos))
+        return true;
+    std::lock_guard<std::mutex> lock(coinsMutex);
+    if (!ActivateBestChain(state, &block, pchecks) && state.IsError()) {
+        error = "replaying " + blockStore.BlockFilePath(pos.nFile) + ": " + state.GetRejectReason();
+        return false;
+    }
+    return true;
+}
+
+bool Chainstate::ReplayBlockFiles(std::string& error)
+{
+    if (fReindex)
+        return ReindexBlockFiles(error);
+    if (!FindAssumeValidBlocks(error))
+        return false;
+    // Deserialize and run the context-free checks, file by file.
+    ReplaySource source = [this](const ReplayPushFn& push, std::string& readError) {
+        bool fStop = false;
+        for (int nFile = nPrunedFiles; nFile <= blockStore.LastFile() && !fStop; nFile++) {
+            bool ok = blockStore.ScanBlockFile(nFile,
+                [&](const FlatFilePos& pos, const unsigned char* data, size_t len) {
+                    Block block;
+                    if (fStop || !ReadReplayBlock(data, len, block))
+                        return;
+                    ValidationState state;
+                    if (CheckBlock(block, state, params.GetConsensus()))
+                        fStop = !push(pos, block);
+                });
+            if (!ok) {
+                readError = "cannot read " + blockStore.BlockFilePath(nFile);
+                return false;
+            }
+        }
+        return true;
+    };
+    return fReplayPipeline ? ReplayBlocksPipelined(source, error) : ReplayBlocks(source, error);
+}
+
+bool Chainstate::ReindexBlockFiles(std::string& error)
+{
+    WorkerPool workers(std::max(1u, std::thread::hardware_concurrency()));
+
+    // Map every block file and find its records, a file per task.
+    const size_t nFiles = blockStore.LastFile() + 1 - nPrunedFiles;
+    std::vector<MappedFile> files(nFiles);
+    std::vector<std::vector<ReindexRecord> > fileRecords(nFiles);
+    std::vector<char> fileMapped(nFiles, 0);
+    workers.Run(nFiles, [&](size_t i) {
+        int nFile = nPrunedFiles + (int)i;
+        if (!files[i].Open(blockStore.BlockFilePath(nFile)))
+            return;
+        fileMapped[i] = 1;
+        blockStore.ScanBlockRecords(nFile, files[i].Data(), files[i].Size(),
+            [&](const FlatFilePos& pos, const unsigned char* data, size_t len) {
+                ReindexRecord record;
+                record.pos = pos;
+                record.data = data;
+                record.len = len;
+                fileRecords[i].push_back(record);
+            });
+    });
+    std::vector<ReindexRecord> records;
+    for (size_t i = 0; i < nFiles; i++) {
+        if (!fileMapped[i]) {
+            error = "cannot read " + blockStore.BlockFilePath(nPrunedFiles + (int)i);
+            return false;
+        }
+        records.insert(records.end(), fileRecords[i].begin(), fileRecords[i].end());
+        std::vector<ReindexRecord>().swap(fileRecords[i]);
+    }
+
+    // Hash the headers.
+    workers.Run((records.size() + REINDEX_CHUNK_BLOCKS - 1) / REINDEX_CHUNK_BLOCKS, [&](size_t nChunk) {
+        size_t nEnd = std::min(records.size(), (nChunk + 1) * REINDEX_CHUNK_BLOCKS);
+        for (size_t i = nChunk * REINDEX_CHUNK_BLOCKS; i < nEnd; i++) {
+            ReindexRecord& record = records[i];
+            if (record.len < BlockHeader::SIZE)
+                continue;
+            BlockHeader header;
+            header.Deserialize(record.data);
+            record.hash = header.GetHash();
+            record.hashPrev = header.hashPrevBlock;
+            record.nHeight = REINDEX_HEIGHT_UNKNOWN;
+        }
+    });
+
+    // Rebuild the block tree from the headers: a block's height is its
+    // parent's plus one, starting from the genesis block or a block the
+    // checkpoint restored. Copies after the first and blocks with no
+    // way back are left out.
+    std::unordered_map<uint256, size_t, Uint256Hasher> mapRecord;
+    mapRecord.reserve(records.size());
+    for (size_t i = 0; i < records.size(); i++) {
+        if (records[i].nHeight == REINDEX_HEIGHT_UNKNOWN && !mapRecord.emplace(records[i].hash, i).second)
+            records[i].nHeight = -1;
+    }
+    std::vector<size_t> path;
+    for (size_t i = 0; i < records.size(); i++) {
+        size_t j = i;
+        int nHeight = -1;
+        while (records[j].nHeight == REINDEX_HEIGHT_UNKNOWN) {
+            const ReindexRecord& record = records[j];
+            if (mapBlockIndex.count(record.hash)) {
+                records[j].nHeight = -1;
+                break;
+            }
+            if (record.hash == params.GetConsensus().hashGenesisBlock) {
+                records[j].nHeight = 0;
+                break;
+            }
+            BlockMap::const_iterator it = mapBlockIndex.find(record.hashPrev);
+            if (it != mapBlockIndex.end()) {
+                records[j].nHeight = it->second->nHeight + 1;
+                break;
+            }
+            std::unordered_map<uint256, size_t, Uint256Hasher>::const_iterator prev = mapRecord.find(record.hashPrev);
+            if (prev == mapRecord.end()) {
+                records[j].nHeight = -1;
+                break;
+            }
+            path.push_back(j);
+            j = prev->second;
+        }
+        nHeight = records[j].nHeight;
+        while (!path.empty()) {
+            nHeight = nHeight < 0 ? -1 : nHeight + 1;
+            records[path.back()].nHeight = nHeight;
+            path.pop_back();
+        }
+    }
+    MarkAssumeValidBlocks([&](const uint256& hash, uint256& hashPrev) {
+        std::unordered_map<uint256, size_t, Uint256Hasher>::const_iterator it = mapRecord.find(hash);
+        if (it == mapRecord.end())
+            return false;
+        hashPrev = records[it->second].hashPrev;
+        return true;
+    });
+
+    // Parents before children, and siblings in the order they were stored.
+    std::vector<size_t> order;
+    for (size_t i = 0; i < records.size(); i++) {
+        if (records[i].nHeight >= 0)
+            order.push_back(i);
+    }
+    std::stable_sort(order.begin(), order.end(),
+        [&](size_t a, size_t b) { return records[a].nHeight < records[b].nHeight; });
+
+    // Deserialize and run the context-free checks a chunk at a time, in
+    // parallel, and hand the blocks on in height order.
+    ReplaySource source = [&](const ReplayPushFn& push, std::string&) {
+        std::vector<Block> blocks;
+        std::vector<char> checked;
+        for (size_t nStart = 0; nStart < order.size(); nStart += REINDEX_CHUNK_BLOCKS) {
+            size_t nCount = std::min(REINDEX_CHUNK_BLOCKS, order.size() - nStart);
+            blocks.assign(nCount, Block());
+            checked.assign(nCount, 0);
+            workers.Run(nCount, [&](size_t k) {
+                const ReindexRecord& record = records[order[nStart + k]];
+                ValidationState state;
+                checked[k] = ReadReplayBlock(record.data, record.len, blocks[k]) &&
+                             CheckBlock(blocks[k], state, params.GetConsensus());
+            });
+            for (size_t k = 0; k < nCount; k++) {
+                if (checked[k] && !push(records[order[nStart + k]].pos, blocks[k]))
+                    return true;
+            }
+        }
+        return true;
+    };
+    return fReplayPipeline ? ReplayBlocksPipelined(source, error) : ReplayBlocks(source, error);
+}
+
+bool Chainstate::ReplayBlocks(const ReplaySource& source, std::string& error)
+{
+    bool fFailed = false;
+    std::string readError;
+    bool ok = source([&](const FlatFilePos& pos, Block& block) {
+        fFailed = !ReplayBlock(block, pos, NULL, error);
+        return !fFailed;
+    }, readError);
+    if (fFailed)
+        return false;
+    if (!ok) {
+        error = readError;
+        return false;
+    }
+    return true;
+}
+
+bool Chainstate::ReplayBlocksPipelined(const ReplaySource& source, std::string& error)
+{
+    BlockingQueue<ReplayItem> read(REPLAY_QUEUE_SIZE), fetched(REPLAY_QUEUE_SIZE), verified(REPLAY_QUEUE_SIZE);
+
+    // Take the blocks from the source, checked.
+    std::string readError;
+    std::thread reader([&] {
+        source([&](const FlatFilePos& pos, Block& block) {
+            ReplayItem item;
+            item.pos = pos;
+            item.block = std::move(block);
+            return read.Push(std::move(item));
+        }, readError);
+        read.Close();
+    });
+
+    // Look up the outputs the inputs spend.
+    std::thread prefetcher([&] {
+        ReplayPrefetcher prefetch(*coinsTip, coinsMutex);
+        ReplayItem item;
+        while (read.Pop(item)) {
+            prefetch.Prefetch(item);
+            if (!fetched.Push(std::move(item)))
+                break;
+        }
+        read.Close();
+        fetched.Close();
+    });
+
+    // Run the scripts, except for blocks that will be assumed valid.
+    std::thread verifier([&] {
+        ReplayItem item;
+        while (fetched.Pop(item)) {
+            if (!setAssumeValidBlocks.count(item.block.GetHash()))
+                CheckReplayScripts(item);
+            if (!verified.Push(std::move(item)))
+                break;
+        }
+        fetched.Close();
+        verified.Close();
+    });
+
+    // Connect, here, since everything else in the chain state belongs to
+    // this thread.
+    bool fFailed = false;
+    ReplayItem item;
+    while (!fFailed && verified.Pop(item))
+        fFailed = !ReplayBlock(item.block, item.pos, &item.checks, error);
+    verified.Close();
+    verifier.join();
+    prefetcher.join();
+    reader.join();
+
+    if (fFailed)
+        return false;
+    if (!readError.empty()) {
+        error = readError;
+        return false;
+    }
+    return true;
+}
+
+const BlockIndex* Chainstate::LookupBlockIndex(const uint256& hash) const
+{
+    BlockMap::const_iterator it = mapBlockIndex.find(hash);
+    return it == mapBlockIndex.end() ? NULL : it->second;
+}
+
+bool Chainstate::ContextualCheckBlockHeader(const BlockHeader& header, ValidationState& state,
+    const BlockIndex* pindexPrev)
+{
+    if (header.nBits != GetNextWorkRequired(pindexPrev, params.GetConsensus()))
+        return state.Invalid("bad-diffbits");
+    if (header.GetBlockTime() <= pindexPrev->GetMedianTimePast())
+        return state.Invalid("time-too-old");
+    if (header.GetBlockTime() > (int64_t)time(NULL) + MAX_FUTURE_BLOCK_TIME)
+        return state.Invalid("time-too-new");
+    return true;
+}
+
+bool Chainstate::ContextualCheckBlock(const Block& block, ValidationState& state, const BlockIndex* pindexPrev)
+{
+    int nHeight = pindexPrev->nHeight + 1;
+    int64_t nLockTimeCutoff = pindexPrev->GetMedianTimePast();
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        if (!IsFinalTx(*block.vtx[i], nHeight, nLockTimeCutoff))
+            return state.Invalid("bad-txns-nonfinal");
+    }
+    // The coinbase must commit to the height, which also keeps coinbase
+    // txids unique.
+    Script expect = Script() << (int64_t)nHeight;
+    const Script& scriptSig = block.vtx[0]->vin[0].scriptSig;
+    if (scriptSig.size() < expect.size() || !std::equal(expect.begin(), expect.end(), scriptSig.begin()))
+        return state.Invalid("bad-cb-height");
+    return true;
+}
+
+BlockIndex* Chainstate::AddToBlockIndex(const BlockHeader& header, const uint256& hash)
+{
+    BlockIndex* pindex = blockIndexArena.Add(header);
+    BlockMap::iterator it = mapBlockIndex.insert(std::make_pair(hash, pindex)).first;
+    pindex->phashBlock = &it->first;
+    BlockMap::iterator prev = mapBlockIndex.find(header.hashPrevBlock);
+    if (prev != mapBlockIndex.end() && hash != params.GetConsensus().hashGenesisBlock) {
+        pindex->pprev = prev->second;
+        pindex->nHeight = pindex->pprev->nHeight + 1;
+        pindex->nChainWork = pindex->pprev->nChainWork;
+        pindex->BuildSkip();
+    }
+    pindex->nChainWork += GetBlockProof(pindex->nBits);
+    return pindex;
+}
+
+void Chainstate::InvalidBlockFound(BlockIndex* pindex)
+{
+    pindex->nStatus |= BLOCK_FAILED_VALID;
+    setBlockIndexCandidates.erase(pindex);
+    // Rare enough that a scan of the index beats keeping child links.
+    for (BlockMap::iterator it = mapBlockIndex.begin(); it != mapBlockIndex.end(); ++it) {
+        BlockIndex* pindexWalk = it->second;
+        if (pindexWalk != pindex && pindexWalk->GetAncestor(pindex->nHeight) == pindex) {
+            pindexWalk->nStatus |= BLOCK_FAILED_CHILD;
+            setBlockIndexCandidates.erase(pindexWalk);
+        }
+    }
+}
+
+bool Chainstate::AcceptBlock(const Block& block, ValidationState& state, BlockIndex** ppindex, const FlatFilePos* pos)
+{
+    uint256 hash = block.GetHash();
+    const BlockIndex* pindexPrev = NULL;
+    if (hash != params.GetConsensus().hashGenesisBlock) {
+        pindexPrev = LookupBlockIndex(block.hashPrevBlock);
+        if (!pindexPrev)
+            return state.Invalid("prev-blk-not-found");
+        if (pindexPrev->nStatus & BLOCK_FAILED_MASK)
+            return state.Invalid("bad-prevblk");
+        if (!ContextualCheckBlockHeader(block, state, pindexPrev) || !ContextualCheckBlock(block, state, pindexPrev))
+            return false;
+    }
+
+    FlatFilePos blockPos;
+    if (pos)
+        blockPos = *pos;
+    else if (!blockStore.WriteBlock(block, blockPos))
+        return state.Error("failed to write block");
+
+    BlockIndex* pindex = AddToBlockIndex(block, hash);
+    if (blockPos.nFile >= (int)vFileMaxHeight.size())
+        vFileMaxHeight.resize(blockPos.nFile + 1, -1);
+    vFileMaxHeight[blockPos.nFile] = std::max(vFileMaxHeight[blockPos.nFile], pindex->nHeight);
+    pindex->blockPos = blockPos;
+    pindex->nTx = (unsigned int)block.vtx.size();
+    pindex->nStatus |= BLOCK_HAVE_DATA | BLOCK_VALID_TREE;
+    pindex->nSequenceId = nBlockSequenceId++;
+    if (!chainActive.Tip() || !BlockIndexWorkComparator()(chainActive.Tip(), pindex))
+        setBlockIndexCandidates.insert(pindex);
+    if (ppindex)
+        *ppindex = pindex;
+    return true;
+}
+
+bool Chainstate::ProcessNewBlock(const Block& block, ValidationState& state, bool* fNewBlock)
+{
+    if (fNewBlock)
+        *fNewBlock = false;
+    uint256 hash = block.GetHash();
+    const BlockIndex* pindexExisting = LookupBlockIndex(hash);
+    if (pindexExisting)
+        return !(pindexExisting->nStatus & BLOCK_FAILED_MASK) || state.Invalid("duplicate-invalid");
+    if (setFailedBlocks.count(hash))
+        return state.Invalid("duplicate-invalid");
+
+    // A child of a failed block is invalid whatever it holds. Its proof of
+    // work is still checked, so junk headers cannot fill the cache.
+    const BlockIndex* pindexPrev = LookupBlockIndex(block.hashPrevBlock);
+    if ((pindexPrev && (pindexPrev->nStatus & BLOCK_FAILED_MASK)) || setFailedBlocks.count(block.hashPrevBlock)) {
+        if (!CheckBlockHeader(block, state, params.GetConsensus()))
+            return false;
+        setFailedBlocks.insert(hash);
+        return state.Invalid("bad-prevblk");
+    }
+
+    // Failures in CheckBlock are not cached: a mutated copy of a valid
+    // block has the same hash.
+    BlockIndex* pindex = NULL;
+    if (!CheckBlock(block, state, params.GetConsensus()))
+        return false;
+    if (!AcceptBlock(block, state, &pindex, NULL)) {
+        if (state.IsInvalid() && pindexPrev)
+            setFailedBlocks.insert(hash);
+        return false;
+    }
+    if (fNewBlock)
+        *fNewBlock = true;
+
+    ValidationState activateState;
+    if (!ActivateBestChain(activateState, &block)) {
+        state = activateState;
+        return false;
+    }
+    // Other blocks failing to connect is not this block's fault.
+    if (pindex->nStatus & BLOCK_FAILED_MASK) {
+        state = activateState;
+        return false;
+    }
+    return true;
+}
+
+BlockIndex* Chainstate::FindMostWorkChain()
+{
+    while (!setBlockIndexCandidates.empty()) {
+        BlockIndex* pindexNew = *setBlockIndexCandidates.begin();
+        if (pindexNew == chainActive.Tip())
+            return pindexNew;
+        // Reject candidates built on a block that failed to connect.
+        const BlockIndex* pindexFork = chainActive.FindFork(pindexNew);
+        bool fInvalidAncestor = false;
+        bool fPruned = false;
+        for (BlockIndex* pindex = pindexNew; pindex != pindexFork; pindex = pindex->pprev) {
+            if (pindex->nStatus & BLOCK_FAILED_MASK) {
+                fInvalidAncestor = true;
+                break;
+            }
+            fPruned |= !(pindex->nStatus & BLOCK_HAVE_DATA);
+        }
+        // Nor can a reorg disconnect blocks whose data was pruned.
+        const uint32_t nDisconnectData = BLOCK_HAVE_DATA | BLOCK_HAVE_UNDO;
+        for (const BlockIndex* pindex = chainActive.Tip(); pindex && pindex != pindexFork; pindex = pindex->pprev)
+            fPruned |= (pindex->nStatus & nDisconnectData) != nDisconnectData;
+        if (!fInvalidAncestor && !fPruned)
+            return pindexNew;
+        if (fInvalidAncestor)
+            pindexNew->nStatus |= BLOCK_FAILED_CHILD;
+        setBlockIndexCandidates.erase(setBlockIndexCandidates.begin());
+    }
+    return NULL;
+}
+
+bool Chainstate::ConnectBlock(const Block& block, ValidationState& state, BlockIndex* pindex, CoinsViewCache& view,
+    BlockUndo& blockundo, const BlockScriptChecks* pchecks)
+{
+    if (pchecks && pchecks->size() != block.vtx.size())
+        pchecks = NULL;
+
+    // The genesis coinbase is not spendable and never enters the UTXO set.
+    if (pindex->GetBlockHash() == params.GetConsensus().hashGenesisBlock) {
+        view.SetBestBlock(pindex->GetBlockHash());
+        return true;
+    }
+
+    // Cache misses go to disk together rather than one input at a time.
+    std::vector<OutPoint> inputs;
+    for (size_t i = 1; i < block.vtx.size(); i++) {
+        for (size_t j = 0; j < block.vtx[i]->vin.size(); j++)
+            inputs.push_back(block.vtx[i]->vin[j].prevout);
+    }
+    view.FetchCoins(inputs);
+    // A block's header fixes its parent, so it spends the same coins each
+    // time it connects: scripts that passed once pass again after a reorg.
+    bool fReconnect = (pindex->nStatus & BLOCK_VALID_SCRIPTS) != 0;
+    bool fAssumed = !fReconnect && IsAssumedValid(pindex);
+    bool fScriptChecks = !fReconnect && !fAssumed;
+
+    Amount nFees = 0;
+    blockundo.vtxundo.clear();
+    blockundo.vtxundo.resize(block.vtx.size() - 1);
+    view.AddCoins(*block.vtx[0], pindex->nHeight);
+    if (connectWorkers && block.vtx.size() > PARALLEL_CONNECT_MIN_TXS) {
+        if (!ConnectTransactionsParallel(block, state, pindex, view, blockundo, pchecks, fScriptChecks, nFees))
+            return false;
+    } else {
+        for (size_t i = 1; i < block.vtx.size(); i++) {
+            Amount txfee;
+            if (!ConnectTransaction(*block.vtx[i], i, state, pindex->nHeight, view, blockundo.vtxundo[i - 1], pchecks,
+                    fScriptChecks, txfee))
+                return false;
+            nFees += txfee;
+            if (!MoneyRange(nFees))
+                return state.Invalid("bad-txns-accumulated-fee-outofrange");
+        }
+    }
+
+    Amount blockReward = nFees + GetBlockSubsidy(pindex->nHeight, params.GetConsensus());
+    if (block.vtx[0]->GetValueOut() > blockReward)
+        return state.Invalid("bad-cb-amount");
+
+    view.SetBestBlock(pindex->GetBlockHash());
+    if (fReconnect)
+        connectStats.nReconnected++;
+    else if (fAssumed)
+        connectStats.nAssumedValid++;
+    else
+        connectStats.nScriptChecked++;
+    return true;
+}
+
+bool Chainstate::ConnectTransactionsParallel(const Block& block, ValidationState& state, const BlockIndex* pindex,
+    CoinsViewCache& view, BlockUndo& blockundo, const BlockScriptChecks* pchecks, bool fScriptChecks, Amount& nFees)
+{
+    BlockTxGraph graph;
+    BuildBlockTxGraph(block.vtx, graph);
+
+    struct GroupResult {
+        Amount nFees;
+        /** First transaction of the group that failed, or 0. */
+        size_t nFailedTx;
+        ValidationState state;
+
+        GroupResult() : nFees(0), nFailedTx(0) {}
+    };
+    std::vector<GroupResult> results(graph.groups.size());
+    CoinsViewSharded sharded(&view, CONNECT_SHARDS);
+    size_t nGroups = graph.groups.size();
+    size_t nTasks = std::min(nGroups, connectWorkers->Size() * CONNECT_TASKS_PER_THREAD);
+    connectWorkers->Run(nTasks, [&](size_t nTask) {
+        // A failed group leaves its coins half applied, but no other group
+        // touches them and the block is rejected anyway.
+        CoinsViewCache local(&sharded);
+        for (size_t g = nTask * nGroups / nTasks; g < (nTask + 1) * nGroups / nTasks; g++) {
+            const std::vector<uint32_t>& group = graph.groups[g];
+            GroupResult& result = results[g];
+            for (size_t k = 0; k < group.size(); k++) {
+                size_t i = group[k];
+                Amount txfee;
+                if (!ConnectTransaction(*block.vtx[i], i, result.state, pindex->nHeight, local,
+                        blockundo.vtxundo[i - 1], pchecks, fScriptChecks, txfee)) {
+                    result.nFailedTx = i;
+                    break;
+                }
+                result.nFees += txfee;
+                if (!MoneyRange(result.nFees)) {
+                    result.state.Invalid("bad-txns-accumulated-fee-outofrange");
+                    result.nFailedTx = i;
+                    break;
+                }
+            }
+        }
+        local.Flush();
+    });
+
+    // Groups share no coins, so each failure is the one an in-order loop
+    // would meet at that transaction; report the earliest.
+    const GroupResult* pfailed = NULL;
+    for (size_t g = 0; g < results.size(); g++) {
+        if (results[g].nFailedTx && (!pfailed || results[g].nFailedTx < pfailed->nFailedTx))
+            pfailed = &results[g];
+    }
+    if (pfailed) {
+        state = pfailed->state;
+        return false;
+    }
+    for (size_t g = 0; g < results.size(); g++) {
+        nFees += results[g].nFees;
+        if (!MoneyRange(nFees))
+            return state.Invalid("bad-txns-accumulated-fee-outofrange");
+    }
+    sharded.Flush();
+    return true;
+}
+
+Chainstate::DisconnectResult Chainstate::DisconnectBlock(const Block& block, const BlockIndex* pindex,
+    CoinsViewCache& view)
+{
+    BlockUndo blockundo;
+    if (!(pindex->nStatus & BLOCK_HAVE_UNDO) || !blockStore.ReadUndo(pindex->undoPos, pindex->GetBlockHash(), blockundo))
+        return DISCONNECT_FAILED;
+    if (blockundo.vtxundo.size() + 1 != block.vtx.size())
+        return DISCONNECT_FAILED;
+
+    // The outputs to remove and the spent coins' slots, from disk in one
+    // batch; restoring is then in memory.
+    std::vector<OutPoint> touched;
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        const Transaction& tx = *block.vtx[i];
+        for (size_t j = 0; j < tx.vout.size(); j++)
+            touched.push_back(OutPoint(tx.GetHash(), (uint32_t)j));
+        if (i > 0) {
+            for (size_t j = 0; j < tx.vin.size(); j++)
+                touched.push_back(tx.vin[j].prevout);
+        }
+    }
+    view.FetchCoins(touched);
+
+    bool fClean = true;
+    for (size_t i = block.vtx.size(); i-- > 0;) {
+        const Transaction& tx = *block.vtx[i];
+        for (size_t j = 0; j < tx.vout.size(); j++) {
+            if (tx.vout[j].scriptPubKey.IsUnspendable())
+                continue;
+            Coin coin;
+            if (!view.SpendCoin(OutPoint(tx.GetHash(), (uint32_t)j), &coin) || !(coin.out == tx.vout[j]))
+                fClean = false;
+        }
+        if (i == 0)
+            break;
+        std::vector<Coin>& prevouts = blockundo.vtxundo[i - 1].vprevout;
+        if (prevouts.size() != tx.vin.size())
+            return DISCONNECT_FAILED;
+        for (size_t j = tx.vin.size(); j-- > 0;) {
+            bool fOverwrite = view.HaveCoin(tx.vin[j].prevout);
+            if (fOverwrite)
+                fClean = false;
+            view.AddCoin(tx.vin[j].prevout, std::move(prevouts[j]), fOverwrite);
+        }
+    }
+    view.SetBestBlock(block.hashPrevBlock);
+    return fClean ? DISCONNECT_OK : DISCONNECT_UNCLEAN;
+}
+
+bool Chainstate::ConnectTip(ValidationState& state, BlockIndex* pindexNew, const Block* pblock,
+    const BlockScriptChecks* pchecks)
+{
+    Block blockRead;
+    if (!pblock || pblock->GetHash() != pindexNew->GetBlockHash()) {
+        if (!blockStore.ReadBlock(pindexNew->blockPos, blockRead))
+            return state.Error("failed to read block " + pindexNew->GetBlockHash().GetHex());
+        pblock = &blockRead;
+        pchecks = NULL;
+    }
+
+    CoinsViewCache view(coinsTip.get());
+    BlockUndo blockundo;
+    if (!ConnectBlock(*pblock, state, pindexNew, view, blockundo, pchecks)) {
+        if (state.IsInvalid())
+            InvalidBlockFound(pindexNew);
+        return false;
+    }
+    if (!(pindexNew->nStatus & BLOCK_HAVE_UNDO) && pindexNew->pprev) {
+        if (!blockStore.WriteUndo(blockundo, pindexNew->GetBlockHash(), pindexNew->blockPos.nFile, pindexNew->undoPos))
+            return state.Error("failed to write undo data");
+        pindexNew->nStatus |= BLOCK_HAVE_UNDO;
+    }
+    pindexNew->nStatus |= BLOCK_VALID_SCRIPTS;
+    view.Flush();
+    chainActive.SetTip(pindexNew);
+    for (size_t i = 0; i < vListeners.size(); i++)
+        vListeners[i]->BlockConnected(*pblock, pindexNew);
+    std::string error;
+    if (!FlushIfNeeded(error))
+        return state.Error(error);
+    return true;
+}
+
+bool Chainstate::DisconnectTip(ValidationState& state)
+{
+    BlockIndex* pindexDelete = chainActive.Tip();
+    Block block;
+    if (!blockStore.ReadBlock(pindexDelete->blockPos, block))
+        return state.Error("failed to read block " + pindexDelete->GetBlockHash().GetHex());
+    CoinsViewCache view(coinsTip.get());
+    if (DisconnectBlock(block, pindexDelete, view) != DISCONNECT_OK)
+        return state.Error("failed to disconnect block " + pindexDelete->GetBlockHash().GetHex());
+    view.Flush();
+    chainActive.SetTip(pindexDelete->pprev);
+    for (size_t i = 0; i < vListeners.size(); i++)
+        vListeners[i]->BlockDisconnected(block, pindexDelete);
+    // The old tip may become the best chain again if the new one fails.
+    setBlockIndexCandidates.insert(pindexDelete);
+    return true;
+}
+
+bool Chainstate::ActivateBestChainStep(ValidationState& state, BlockIndex* pindexMostWork, const Block* pblock,
+    const BlockScriptChecks* pchecks)
+{
+    const BlockIndex* pindexFork = chainActive.FindFork(pindexMostWork);
+    while (chainActive.Tip() && chainActive.Tip() != pindexFork) {
+        if (!DisconnectTip(state))
+            return false;
+    }
+
+    std::vector<BlockIndex*> connect;
+    for (BlockIndex* pindex = pindexMostWork; pindex != pindexFork; pindex = pindex->pprev)
+        connect.push_back(pindex);
+    for (size_t i = connect.size(); i-- > 0;) {
+        if (!ConnectTip(state, connect[i], pblock, pchecks)) {
+            // An invalid block is recorded and the caller picks the next best
+            // candidate; anything else is fatal.
+            return state.IsInvalid();
+        }
+    }
+    return true;
+}
+
+bool Chainstate::ActivateBestChain(ValidationState& state, const Block* pblock, const BlockScriptChecks* pchecks)
+{
+    while (true) {
+        BlockIndex* pindexMostWork = FindMostWorkChain();
+        if (!pindexMostWork || pindexMostWork == chainActive.Tip())
+            break;
+        ValidationState stepState;
+        if (!ActivateBestChainStep(stepState, pindexMostWork, pblock, pchecks)) {
+            state = stepState;
+            return false;
+        }
+        if (stepState.IsInvalid())
+            state = stepState;
+    }
+    // Drop candidates that can no longer beat the tip.
+    while (chainActive.Tip() && !setBlockIndexCandidates.empty() &&
+           BlockIndexWorkComparator()(chainActive.Tip(), *setBlockIndexCandidates.rbegin()))
+        setBlockIndexCandidates.erase(std::prev(setBlockIndexCandidates.end()));
+    return true;
+}
+
+bool Chainstate::FlushIfNeeded(std::string& error)
+{
+    if (coinsTip->CacheSize() <= nCoinsCacheLimit)
+        return true;
+    blockStore.Flush();
+    return FlushCoins(error);
+}
+
+void Chainstate::Flush()
+{
+    blockStore.Flush();
+    std::string error;
+    if (!FlushCoins(error))
+        throw std::runtime_error(error);
+}
+
+bool Chainstate::FlushCoins(std::string& error)
+{
+    // Load() replays the blocks after the saved index onto the coins a
+    // store keeps, so those must never get ahead of the index.
+    if (coinsDB->IsPersistent() && chainActive.Tip() && !WriteCheckpoint(error))
+        return false;
+    coinsTip->Flush();
+    coinsTip->ReleaseMemory();
+    // Pruning needs a checkpoint, which costs least right after a flush.
+    return PruneIfNeeded(error);
+}
+
+void Chainstate::RegisterListener(ChainListener* listener)
+{
+    vListeners.push_back(listener);
+}
+
+void Chainstate::UnregisterListener(ChainListener* listener)
+{
+    vListeners.erase(std::remove(vListeners.begin(), vListeners.end(), listener), vListeners.end());
+}
+
+void Chainstate::SetPruneTarget(uint64_t nBytes, int nKeepBlocks)
+{
+    nPruneTarget = nBytes;
+    nPruneKeepBlocks = nKeepBlocks;
+    nPruneCheckFile = -1;
+}
+
+namespace {
+
+/** blocks/index.dat: this magic, a version, the pruned file count, the
+ *  prune height plus one and the checkpoint height, then one entry per
+ *  block of the active chain from genesis up. */
+const unsigned char PRUNE_INDEX_MAGIC[4] = {'o', 'c', 'b', 'i'};
+const uint32_t PRUNE_INDEX_VERSION = 1;
+
+void WriteFilePos(ByteWriter& w, const FlatFilePos& pos)
+{
+    w.WriteVarInt((uint64_t)(pos.nFile + 1));
+    w.WriteVarInt(pos.nPos);
+}
+
+FlatFilePos ReadFilePos(ByteReader& r)
+{
+    uint64_t nFile = r.ReadVarInt();
+    uint64_t nPos = r.ReadVarInt();
+    if (nFile > INT32_MAX || nPos > UINT32_MAX)
+        throw SerializeError("file position out of range");
+    return nFile == 0 ? FlatFilePos() : FlatFilePos((int)nFile - 1, (unsigned int)nPos);
+}
+
+} // namespace
+
+std::string Chainstate::IndexPath() const
+{
+    return blockStore.Dir() + "/index.dat";
+}
+
+std::string Chainstate::SnapshotPath(int nHeight) const
+{
+    return blockStore.Dir() + "/coins-" + std::to_string(nHeight) + ".snapshot";
+}
+
+bool Chainstate::PruneIfNeeded(std::string& error)
+{
+    if (!nPruneTarget || !chainActive.Tip() || blockStore.LastFile() == nPruneCheckFile)
+        return true;
+    nPruneCheckFile = blockStore.LastFile();
+    return PruneBlockFiles(error);
+}
+
+bool Chainstate::PruneBlockFiles(std::string& error)
+{
+    // Oldest files first, so the pruned ones are always those below
+    // nPrunedFiles. The file being written is never pruned.
+    std::vector<uint64_t> vFileBytes;
+    uint64_t nBytes = 0;
+    for (int nFile = nPrunedFiles; nFile <= blockStore.LastFile(); nFile++) {
+        int64_t nBlockBytes = FileSize(blockStore.BlockFilePath(nFile));
+        int64_t nUndoBytes = FileSize(blockStore.UndoFilePath(nFile));
+        vFileBytes.push_back((uint64_t)std::max<int64_t>(nBlockBytes, 0) + std::max<int64_t>(nUndoBytes, 0));
+        nBytes += vFileBytes.back();
+    }
+    int nLastPrunable = Height() - nPruneKeepBlocks;
+    int nPruneFiles = nPrunedFiles;
+    int nNewPruneHeight = nPruneHeight;
+    while (nBytes > nPruneTarget && nPruneFiles < blockStore.LastFile()) {
+        int nMaxHeight = nPruneFiles < (int)vFileMaxHeight.size() ? vFileMaxHeight[nPruneFiles] : -1;
+        if (nMaxHeight > nLastPrunable)
+            break;
+        nBytes -= vFileBytes[nPruneFiles - nPrunedFiles];
+        nNewPruneHeight = std::max(nNewPruneHeight, nMaxHeight);
+        nPruneFiles++;
+    }
+    if (nPruneFiles == nPrunedFiles)
+        return true;
+
+    for (BlockMap::iterator it = mapBlockIndex.begin(); it != mapBlockIndex.end(); ++it) {
+        BlockIndex* pindex = it->second;
+        if (!pindex->blockPos.IsNull() && pindex->blockPos.nFile < nPruneFiles) {
+            pindex->nStatus &= ~(BLOCK_HAVE_DATA | BLOCK_HAVE_UNDO);
+            pindex->blockPos = FlatFilePos();
+            pindex->undoPos = FlatFilePos();
+        }
+    }
+    int nFirstFile = nPrunedFiles;
+    nPrunedFiles = nPruneFiles;
+    nPruneHeight = nNewPruneHeight;
+    // Load() cannot replay what is deleted, so the chain state the files
+    // built is saved first.
+    if (!WriteCheckpoint(error))
+        return false;
+    for (int nFile = nFirstFile; nFile < nPrunedFiles; nFile++)
+        blockStore.PruneFile(nFile);
+    return true;
+}
+
+bool Chainstate::WriteCheckpoint(std::string& error)
+{
+    int nHeight = Height();
+    // A store that keeps its coins needs no snapshot of them.
+    SnapshotInfo info;
+    if (!coinsDB->IsPersistent() && !WriteCoinsSnapshot(*coinsDB, SnapshotPath(nHeight), info, error))
+        return false;
+
+    std::vector<unsigned char> data;
+    ByteWriter w(data);
+    w.WriteBytes(PRUNE_INDEX_MAGIC, sizeof(PRUNE_INDEX_MAGIC));
+    w.WriteU32(PRUNE_INDEX_VERSION);
+    w.WriteVarInt(nPrunedFiles);
+    w.WriteVarInt(nPruneHeight + 1);
+    w.WriteVarInt(nHeight);
+    for (int h = 0; h <= nHeight; h++) {
+        const BlockIndex* pindex = chainActive[h];
+        unsigned char header[BlockHeader::SIZE];
+        pindex->GetBlockHeader().Serialize(header);
+        w.WriteBytes(header, sizeof(header));
+        w.WriteVarInt(pindex->nTx);
+        w.WriteVarInt(pindex->nStatus);
+        WriteFilePos(w, pindex->blockPos);
+        WriteFilePos(w, pindex->undoPos);
+    }
+    if (!ReplaceFile(IndexPath(), data)) {
+        error = "cannot write " + IndexPath();
+        return false;
+    }
+    // The index names the new snapshot now, if any.
+    if (nCheckpointHeight >= 0 && (nCheckpointHeight != nHeight || coinsDB->IsPersistent()))
+        RemoveFile(SnapshotPath(nCheckpointHeight));
+    nCheckpointHeight = nHeight;
+    return true;
+}
+
+bool Chainstate::LoadCheckpoint(int& nKeepUndoFile, std::string& error)
+{
+    nKeepUndoFile = -1;
+    std::string path = IndexPath();
+    if (!FileExists(path)) {
+        if (coinsDB->GetBestBlock().IsNull())
+            return true;
+        error = "coins in " + coinsDir + " have no block index to go with them";
+        return false;
+    }
+    std::vector<unsigned char> data;
+    if (!ReadFile(path, data)) {
+        error = "cannot read " + path;
+        return false;
+    }
+    BlockIndex* pindexTip = NULL;
+    try {
+        ByteReader r(data);
+        unsigned char magic[sizeof(PRUNE_INDEX_MAGIC)];
+        r.ReadBytes(magic, sizeof(magic));
+        if (memcmp(magic, PRUNE_INDEX_MAGIC, sizeof(magic)) != 0 || r.ReadU32() != PRUNE_INDEX_VERSION)
+            throw SerializeError("unknown format");
+        uint64_t nPrunedFilesIn = r.ReadVarInt();
+        uint64_t nPruneHeightIn = r.ReadVarInt();
+        uint64_t nHeight = r.ReadVarInt();
+        if (nPrunedFilesIn > INT32_MAX || nPruneHeightIn > INT32_MAX || nHeight > INT32_MAX)
+            throw SerializeError("value out of range");
+        for (uint64_t h = 0; h <= nHeight; h++) {
+            unsigned char raw[BlockHeader::SIZE];
+            r.ReadBytes(raw, sizeof(raw));
+            BlockHeader header;
+            header.Deserialize(raw);
+            uint256 hash = header.GetHash();
+            if (pindexTip ? header.hashPrevBlock != pindexTip->GetBlockHash() :
+                            hash != params.GetConsensus().hashGenesisBlock)
+                throw SerializeError("blocks do not form a chain");
+            BlockIndex* pindex = AddToBlockIndex(header, hash);
+            uint64_t nTx = r.ReadVarInt();
+            uint64_t nStatus = r.ReadVarInt();
+            if (nTx > UINT32_MAX || nStatus > UINT32_MAX)
+                throw SerializeError("value out of range");
+            pindex->nTx = (unsigned int)nTx;
+            pindex->nStatus = (uint32_t)nStatus;
+            pindex->blockPos = ReadFilePos(r);
+            pindex->undoPos = ReadFilePos(r);
+            pindex->nSequenceId = nBlockSequenceId++;
+            int nFile = pindex->blockPos.nFile;
+            if (nFile >= 0) {
+                if (nFile >= (int)vFileMaxHeight.size())
+                    vFileMaxHeight.resize(nFile + 1, -1);
+                vFileMaxHeight[nFile] = std::max(vFileMaxHeight[nFile], pindex->nHeight);
+            }
+            if (pindex->nStatus & BLOCK_HAVE_UNDO)
+                nKeepUndoFile = std::max(nKeepUndoFile, pindex->undoPos.nFile);
+            pindexTip = pindex;
+        }
+        if (!r.Empty())
+            throw SerializeError("trailing data");
+        nPrunedFiles = (int)nPrunedFilesIn;
+        nPruneHeight = (int)nPruneHeightIn - 1;
+        nCheckpointHeight = (int)nHeight;
+    } catch (const SerializeError& e) {
+        error = "corrupt block index " + path + ": " + e.what();
+        return false;
+    }
+    setBlockIndexCandidates.insert(pindexTip);
+
+    // The coins come back at the tip from a snapshot, or from the store
+    // at the tip or below it, in which case Load() reconnects the rest.
+    // Without either, and with no block file pruned, it connects them all.
+    std::string snapshot = SnapshotPath(nCheckpointHeight);
+    if (coinsDB->GetBestBlock().IsNull() && (nPrunedFiles > 0 || FileExists(snapshot))) {
+        SnapshotInfo info;
+        if (!LoadCoinsSnapshot(snapshot, *coinsDB, info, error))
+            return false;
+        if (info.hashBlock != pindexTip->GetBlockHash()) {
+            error = snapshot + " does not match " + path;
+            return false;
+        }
+    }
+    BlockIndex* pindexCoins = NULL;
+    if (!coinsDB->GetBestBlock().IsNull()) {
+        BlockMap::iterator it = mapBlockIndex.find(coinsDB->GetBestBlock());
+        pindexCoins = it == mapBlockIndex.end() ? NULL : it->second;
+        if (!pindexCoins || pindexTip->GetAncestor(pindexCoins->nHeight) != pindexCoins) {
+            error = "coins in " + coinsDir + " are at block " + coinsDB->GetBestBlock().GetHex() + ", not in " + path;
+            return false;
+        }
+    }
+    chainActive.SetTip(pindexCoins);
+    // Snapshots written before a crash kept the index from naming them.
+    std::vector<std::string> names;
+    ListDirectory(blockStore.Dir(), names);
+    std::string current = "coins-" + std::to_string(nCheckpointHeight) + ".snapshot";
+    for (size_t i = 0; i < names.size(); i++) {
+        if (names[i].compare(0, 6, "coins-") == 0 && names[i] != current)
+            RemoveFile(blockStore.Dir() + "/" + names[i]);
+    }
+    return true;
+}
@@ -0,0 +1,376 @@
+#ifndef ONECOIN_VALIDATION_H
+#define ONECOIN_VALIDATION_H
+
+#include "amount.h"
+#include "block.h"
+#include "blockstore.h"
+#include "chain.h"
+#include "chainparams.h"
+#include "coins.h"
+#include "coinsdb.h"
+#include "interpreter.h"
+#include "undo.h"
+#include "uint256.h"
+#include "workqueue.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/** How far ahead of the local clock a block's time may be. */
+static const int64_t MAX_FUTURE_BLOCK_TIME = 2 * 60 * 60;
+/** nLockTime values below this are block heights, above it timestamps. */
+static const uint32_t LOCKTIME_THRESHOLD = 500000000;
+/** Blocks below the tip whose block and undo files pruning always keeps,
+ *  so reorgs up to this deep still find their data. */
+static const int MIN_BLOCKS_TO_KEEP = 288;
+/** Smallest prune budget the command line accepts. */
+static const uint64_t MIN_PRUNE_TARGET = 550ULL << 20;
+
+/** Outcome of a validation step: valid, invalid (the data is bad) or an
+ *  error (we could not check it, e.g. a disk failure). */
+class ValidationState {
+public:
+    enum Mode {
+        MODE_VALID,
+        MODE_INVALID,
+        MODE_ERROR,
+    };
+
+    ValidationState() : mode(MODE_VALID) {}
+
+    bool Invalid(const std::string& reason)
+    {
+        mode = MODE_INVALID;
+        rejectReason = reason;
+        return false;
+    }
+    bool Error(const std::string& reason)
+    {
+        mode = MODE_ERROR;
+        rejectReason = reason;
+        return false;
+    }
+
+    bool IsValid() const { return mode == MODE_VALID; }
+    bool IsInvalid() const { return mode == MODE_INVALID; }
+    bool IsError() const { return mode == MODE_ERROR; }
+    const std::string& GetRejectReason() const { return rejectReason; }
+
+private:
+    Mode mode;
+    std::string rejectReason;
+};
+
+/** Context-free transaction checks. */
+bool CheckTransaction(const Transaction& tx, ValidationState& state);
+/** Checks that the inputs of a non-coinbase tx exist, are mature and cover
+ *  the outputs; sets txfee. */
+bool CheckTxInputs(const Transaction& tx, ValidationState& state, const CoinsViewCache& inputs, int nSpendHeight,
+    Amount& txfee);
+/** Runs every input's scriptSig against the output it spends, which must
+ *  still be in inputs. */
+bool CheckInputScripts(const Transaction& tx, ValidationState& state, const CoinsViewCache& inputs, unsigned int flags);
+bool IsFinalTx(const Transaction& tx, int nBlockHeight, int64_t nBlockTime);
+
+/** Outcome of checking a transaction's scripts ahead of ConnectBlock. */
+struct TxScriptCheck {
+    bool fChecked;
+    ScriptError error;
+
+    TxScriptCheck() : fChecked(false), error(SCRIPT_ERR_OK) {}
+};
+
+/** One entry per transaction of a block. ConnectBlock checks unchecked
+ *  transactions itself. */
+typedef std::vector<TxScriptCheck> BlockScriptChecks;
+
+bool CheckBlockHeader(const BlockHeader& header, ValidationState& state, const ConsensusParams& params,
+    bool fCheckPOW = true);
+/** Context-free block checks: proof of work, Merkle root, size and the
+ *  transactions themselves. */
+bool CheckBlock(const Block& block, ValidationState& state, const ConsensusParams& params, bool fCheckPOW = true,
+    bool fCheckMerkleRoot = true);
+
+/** How the blocks connected since a Chainstate was created were validated. */
+struct ConnectStats {
+    /** Blocks whose scripts were run. */
+    uint64_t nScriptChecked;
+    /** Blocks connected without running scripts, as the assume-valid block
+     *  or one of its ancestors. */
+    uint64_t nAssumedValid;
+    /** Blocks connected again, as a reorg back to their chain does, whose
+     *  scripts already passed. */
+    uint64_t nReconnected;
+
+    ConnectStats() : nScriptChecked(0), nAssumedValid(0), nReconnected(0) {}
+};
+
+/** How the chainstate keeps the UTXO set on disk. */
+enum CoinsBackend {
+    /** CoinsViewDB: a record log with every outpoint indexed in memory. */
+    COINS_BACKEND_LOG,
+    /** CoinsViewLsm: an LSM store, for sets larger than memory. */
+    COINS_BACKEND_LSM,
+};
+
+/** Told of every block the active chain gains or loses, on the thread
+ *  that changed it, once the coins tip reflects the change. */
+class ChainListener {
+public:
+    virtual ~ChainListener() {}
+    virtual void BlockConnected(const Block& block, const BlockIndex* pindex) = 0;
+    virtual void BlockDisconnected(const Block& block, const BlockIndex* pindex) = 0;
+};
+
+/** Orders block index entries by chainwork, then by arrival. */
+struct BlockIndexWorkComparator {
+    bool operator()(const BlockIndex* a, const BlockIndex* b) const;
+};
+
+/**
+ * The block tree, the active chain and the UTXO set for it.
+ *
+ * Blocks enter through ProcessNewBlock(), are stored in the block files and
+ * the chain with the most work is activated, reorganizing when needed. Load()
+ * rebuilds the block tree by replaying the block files, starting from the
+ * last checkpoint when there is one.
+ *
+ * A checkpoint is the active chain's block index in blocks/index.dat plus
+ * the UTXO set at its tip. A coins store that keeps its coins across
+ * restarts holds the UTXO set itself, so every coins flush first saves the
+ * index; Load() reconnects whatever blocks of it the coins had not reached.
+ *
+ * In prune mode the oldest block and undo files are deleted once they take
+ * more than a byte budget, down to a window of recent blocks. Pruning runs
+ * right after the coins are flushed and first saves a checkpoint, with the
+ * UTXO set in a snapshot next to the index unless the store keeps it;
+ * Load() starts from those and replays only the block files left. Blocks
+ * at or below GetPruneHeight() may be gone and are not served.
+ *
+ * Replay is pipelined: while one block is connected, the next has its
+ * scripts verified and the one after has the outputs it spends looked up,
+ * each stage on its own thread, so the replay rate is set by the slowest
+ * stage rather than by their sum.
+ *
+ * Blocks up to a configured assume-valid block are connected with every
+ * check but their scripts: proof of work, Merkle roots, amounts and spends
+ * of existing, mature coins still hold them to the rules.
+ *
+ * With more than one connect thread, the transactions of a large block are
+ * split into groups that touch disjoint coins, and the groups are checked
+ * and applied concurrently through a sharded view of the coins.
+ */
+class Chainstate {
+public:
+    enum DisconnectResult {
+        DISCONNECT_OK,
+        DISCONNECT_UNCLEAN,
+        DISCONNECT_FAILED,
+    };
+
+    /** Blocks live in datadir/blocks and the UTXO set in
+     *  datadir/chainstate. */
+    Chainstate(const ChainParams& params, const std::string& datadir);
+    ~Chainstate();
+
+    /** Opens the block files and replays them; starts a new chain from the
+     *  genesis block when there are none. */
+    bool Load(std::string& error);
+
+    /** Checks and stores a block and activates the best chain. Returns false
+     *  when the block is invalid or could not be stored; a valid block on a
+     *  side chain returns true. */
+    bool ProcessNewBlock(const Block& block, ValidationState& state, bool* fNewBlock = NULL);
+    /** Switches to the most-work valid chain. pchecks, when given, holds
+     *  script results for pblock. */
+    bool ActivateBestChain(ValidationState& state, const Block* pblock = NULL, const BlockScriptChecks* pchecks = NULL);
+
+    /** Applies block to view and fills blockundo. Assumes CheckBlock and the
+     *  contextual header checks passed. Script results already in pchecks
+     *  are used instead of running the scripts again. */
+    bool ConnectBlock(const Block& block, ValidationState& state, BlockIndex* pindex, CoinsViewCache& view,
+        BlockUndo& blockundo, const BlockScriptChecks* pchecks = NULL);
+    DisconnectResult DisconnectBlock(const Block& block, const BlockIndex* pindex, CoinsViewCache& view);
+
+    const BlockIndex* Tip() const { return chainActive.Tip(); }
+    const ActiveChain& GetActiveChain() const { return chainActive; }
+    int Height() const { return chainActive.Height(); }
+    const BlockIndex* LookupBlockIndex(const uint256& hash) const;
+    size_t BlockIndexSize() const { return mapBlockIndex.size(); }
+
+    CoinsViewCache& CoinsTip() { return *coinsTip; }
+    /** The UTXO set below the cache, as of the last Flush(). */
+    const CoinsViewStore& CoinsDB() const { return *coinsDB; }
+    BlockStore& GetBlockStore() { return blockStore; }
+    const ChainParams& GetParams() const { return params; }
+
+    /** Where the UTXO set is kept; COINS_BACKEND_LOG by default. Takes
+     *  effect on the next Load(). */
+    void SetCoinsBackend(CoinsBackend backend);
+    /** Coins cached above the backing store before a flush is forced. */
+    void SetCoinsCacheLimit(size_t nEntries) { nCoinsCacheLimit = nEntries; }
+    /** Replays the block files through the stage threads (the default) or
+     *  one block at a time on the calling thread. */
+    void SetReplayPipeline(bool fEnable) { fReplayPipeline = fEnable; }
+    /** Rebuilds the chain state from the block files in height order
+     *  rather than file by file: every file is mapped into memory, the
+     *  headers are hashed in parallel to rebuild the block tree, and the
+     *  blocks are deserialized and checked in parallel on their way into
+     *  the replay. Blocks stored before their parents are connected too,
+     *  which a replay in file order skips. Takes effect on the next Load(). */
+    void SetReindex(bool fEnable) { fReindex = fEnable; }
+    /** Threads that connect the transactions of one block, the calling
+     *  thread included; 1 connects them in order. Defaults to the number
+     *  of cores. */
+    void SetConnectThreads(unsigned int nThreads);
+    unsigned int GetConnectThreads() const { return connectWorkers ? connectWorkers->Size() : 1; }
+    /** Connects this block and its ancestors without running their scripts;
+     *  a null hash runs every script. Takes effect on the next Load(), which
+     *  finds the ancestors in the block files, or once the block is in the
+     *  block index. Defaults to the network's defaultAssumeValid. */
+    void SetAssumeValid(const uint256& hash) { hashAssumeValid = hash; }
+    const uint256& GetAssumeValid() const { return hashAssumeValid; }
+    const ConnectStats& GetConnectStats() const { return connectStats; }
+    /** Deletes the oldest block files while all of them take more than
+     *  nBytes, keeping those with any of the last nKeepBlocks blocks; 0
+     *  turns pruning off. Checked when the coins are flushed, if a new
+     *  block file was started since, and after Load(). */
+    void SetPruneTarget(uint64_t nBytes, int nKeepBlocks = MIN_BLOCKS_TO_KEEP);
+    bool IsPruneMode() const { return nPruneTarget != 0; }
+    /** Highest block whose data may be deleted, -1 when nothing was pruned;
+     *  what a peer can ask this node for starts above it. */
+    int GetPruneHeight() const { return nPruneHeight; }
+    /** Writes cached coins and buffered block data down. Throws
+     *  std::runtime_error when the checkpoint cannot be saved. */
+    void Flush();
+
+    /** Adds a listener, which must outlive its registration. Blocks replayed
+     *  by Load() reach those registered before it. */
+    void RegisterListener(ChainListener* listener);
+    void UnregisterListener(ChainListener* listener);
+
+private:
+    const ChainParams& params;
+    BlockStore blockStore;
+
+    BlockIndexArena blockIndexArena;
+    typedef std::unordered_map<uint256, BlockIndex*, Uint256Hasher> BlockMap;
+    BlockMap mapBlockIndex;
+    /** Blocks that could become the tip: at least as much work as it. */
+    std::set<BlockIndex*, BlockIndexWorkComparator> setBlockIndexCandidates;
+    ActiveChain chainActive;
+    /** Invalid blocks outside the block index: those that failed after
+     *  CheckBlock tied their contents to the header, and children of any
+     *  failed block. Announcing one again costs a lookup. */
+    std::unordered_set<uint256, Uint256Hasher> setFailedBlocks;
+    uint64_t nBlockSequenceId;
+
+    const std::string coinsDir;
+    std::unique_ptr<CoinsViewStore> coinsDB;
+    std::unique_ptr<CoinsViewCache> coinsTip;
+    size_t nCoinsCacheLimit;
+    bool fReplayPipeline;
+    bool fReindex;
+    /** Held while replay changes the coins tip, so the prefetch stage can
+     *  read it from its own thread. */
+    std::mutex coinsMutex;
+
+    uint256 hashAssumeValid;
+    /** The assume-valid block and its ancestors as found in the block files
+     *  before replay, while the block index does not reach it yet. Fixed
+     *  while the replay stages run. */
+    std::unordered_set<uint256, Uint256Hasher> setAssumeValidBlocks;
+    ConnectStats connectStats;
+    std::unique_ptr<WorkerPool> connectWorkers;
+
+    uint64_t nPruneTarget;
+    int nPruneKeepBlocks;
+    /** Block files below this number are pruned. */
+    int nPrunedFiles;
+    int nPruneHeight;
+    /** Highest height of a block stored in each block file, -1 if none. */
+    std::vector<int> vFileMaxHeight;
+    /** Last block file the prune check ran for; it runs once per file. */
+    int nPruneCheckFile;
+    /** Height of the last checkpoint, -1 if none. */
+    int nCheckpointHeight;
+
+    std::vector<ChainListener*> vListeners;
+
+    bool ContextualCheckBlockHeader(const BlockHeader& header, ValidationState& state, const BlockIndex* pindexPrev);
+    bool ContextualCheckBlock(const Block& block, ValidationState& state, const BlockIndex* pindexPrev);
+    /** Stores a checked block; pos is given when the block is already on
+     *  disk, e.g. while replaying the block files. */
+    bool AcceptBlock(const Block& block, ValidationState& state, BlockIndex** ppindex, const FlatFilePos* pos);
+    BlockIndex* AddToBlockIndex(const BlockHeader& header, const uint256& hash);
+    /** Marks pindex failed and every block built on it failed too. */
+    void InvalidBlockFound(BlockIndex* pindex);
+
+    /** Fills setAssumeValidBlocks from the headers in the block files. */
+    bool FindAssumeValidBlocks(std::string& error);
+    /** Fills setAssumeValidBlocks by walking back from the assume-valid
+     *  block; findPrev gives a stored block's parent. */
+    void MarkAssumeValidBlocks(const std::function<bool(const uint256& hash, uint256& hashPrev)>& findPrev);
+    /** Whether pindex is the assume-valid block or one of its ancestors. */
+    bool IsAssumedValid(const BlockIndex* pindex) const;
+    /** Takes a block that passed CheckBlock and its position; false stops
+     *  the source. */
+    typedef std::function<bool(const FlatFilePos& pos, Block& block)> ReplayPushFn;
+    /** Pushes blocks in the order they are to be connected until push
+     *  returns false; false with an error if the block files cannot be
+     *  read. */
+    typedef std::function<bool(const ReplayPushFn& push, std::string& error)> ReplaySource;
+
+    bool ReplayBlockFiles(std::string& error);
+    /** The reindex replay, see SetReindex(). */
+    bool ReindexBlockFiles(std::string& error);
+    bool ReplayBlocks(const ReplaySource& source, std::string& error);
+    bool ReplayBlocksPipelined(const ReplaySource& source, std::string& error);
+    /** Accepts and activates one block from the block files that passed
+     *  CheckBlock. False on a fatal error. */
+    bool ReplayBlock(const Block& block, const FlatFilePos& pos, const BlockScriptChecks* pchecks, std::string& error);
+
+    /** Checks and applies vtx[1..] group by group on the connect threads;
+     *  ConnectBlock's loop, with the same outcome. */
+    bool ConnectTransactionsParallel(const Block& block, ValidationState& state, const BlockIndex* pindex,
+        CoinsViewCache& view, BlockUndo& blockundo, const BlockScriptChecks* pchecks, bool fScriptChecks,
+        Amount& nFees);
+
+    BlockIndex* FindMostWorkChain();
+    bool ActivateBestChainStep(ValidationState& state, BlockIndex* pindexMostWork, const Block* pblock,
+        const BlockScriptChecks* pchecks);
+    bool ConnectTip(ValidationState& state, BlockIndex* pindexNew, const Block* pblock,
+        const BlockScriptChecks* pchecks);
+    bool DisconnectTip(ValidationState& state);
+    /** Flushes the coins once the cache outgrows its limit. */
+    bool FlushIfNeeded(std::string& error);
+    /** Flushes the coins, saving the checkpoint first when the store keeps
+     *  them, then prunes. Block data must be flushed already. */
+    bool FlushCoins(std::string& error);
+
+    std::string IndexPath() const;
+    std::string SnapshotPath(int nHeight) const;
+    /** Prunes when a block file was started since the last check. The
+     *  coins must be flushed. */
+    bool PruneIfNeeded(std::string& error);
+    bool PruneBlockFiles(std::string& error);
+    /** Saves the active chain's block index and, unless the store keeps
+     *  it, the UTXO set at the tip, which must be flushed. */
+    bool WriteCheckpoint(std::string& error);
+    /** Restores the block index and coins of the last checkpoint, if any,
+     *  into the empty chainstate, before the block files are opened, and
+     *  checks the coins a store kept against it. The tip is left where
+     *  the coins are. nKeepUndoFile is set to the last undo file the saved
+     *  blocks use. */
+    bool LoadCheckpoint(int& nKeepUndoFile, std::string& error);
+};
+
+#endif // ONECOIN_VALIDATION_H
@@ -0,0 +1,71 @@
+#include "workqueue.h"
+
+WorkerPool::WorkerPool(unsigned int nThreads)
+    : nThreads(nThreads ? nThreads : 1), batch(NULL), nTasks(0), nNext(0), nPending(0), fStop(false)
+{
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        fStop = true;
+    }
+    workCond.notify_all();
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+}
+
+void WorkerPool::Run(size_t nTasksIn, const std::function<void(size_t)>& fn)
+{
+    if (nTasksIn == 0)
+        return;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (threads.size() + 1 < nThreads)
+        threads.push_back(std::thread(&WorkerPool::ThreadMain, this));
+    batch = &fn;
+    nTasks = nTasksIn;
+    nNext = 0;
+    nPending = nTasksIn;
+    error = std::exception_ptr();
+    workCond.notify_all();
+    Work(lock);
+    doneCond.wait(lock, [this] { return nPending == 0; });
+    batch = NULL;
+    if (error) {
+        std::exception_ptr rethrow = error;
+        error = std::exception_ptr();
+        std::rethrow_exception(rethrow);
+    }
+}
+
+void WorkerPool::ThreadMain()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        workCond.wait(lock, [this] { return fStop || (batch && nNext < nTasks); });
+        if (fStop)
+            return;
+        Work(lock);
+    }
+}
+
+void WorkerPool::Work(std::unique_lock<std::mutex>& lock)
+{
+    while (batch && nNext < nTasks) {
+        size_t nTask = nNext++;
+        const std::function<void(size_t)>& fn = *batch;
+        lock.unlock();
+        std::exception_ptr thrown;
+        try {
+            fn(nTask);
+        } catch (...) {
+            thrown = std::current_exception();
+        }
+        lock.lock();
+        if (thrown && !error)
+            error = thrown;
+        if (--nPending == 0)
+            doneCond.notify_one();
+    }
+}
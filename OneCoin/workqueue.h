@@ -0,0 +1,99 @@
+#ifndef ONECOIN_WORKQUEUE_H
+#define ONECOIN_WORKQUEUE_H
+
+#include <stddef.h>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * Bounded FIFO between two threads. Push() blocks while the queue is full
+ * and Pop() while it is empty; Close() wakes both sides, after which Push()
+ * fails and Pop() drains what is left before failing too.
+ */
+template <typename T>
+class BlockingQueue {
+public:
+    explicit BlockingQueue(size_t nCapacity) : nCapacity(nCapacity), fClosed(false) {}
+
+    bool Push(T&& item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return fClosed || items.size() < nCapacity; });
+        if (fClosed)
+            return false;
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    bool Pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return fClosed || !items.empty(); });
+        if (items.empty())
+            return false;
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void Close()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        fClosed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+private:
+    const size_t nCapacity;
+    bool fClosed;
+    std::deque<T> items;
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+};
+
+/**
+ * Threads that share out the tasks of one batch at a time, the calling
+ * thread included. They start on first use and wait for the next batch in
+ * between. An exception thrown by a task is rethrown by Run() once the
+ * batch has finished.
+ */
+class WorkerPool {
+public:
+    /** nThreads counts the caller: nThreads - 1 threads are started. */
+    explicit WorkerPool(unsigned int nThreads);
+    ~WorkerPool();
+
+    /** Calls fn(0) .. fn(nTasks - 1) in any order across the threads and
+     *  returns when all have returned. */
+    void Run(size_t nTasks, const std::function<void(size_t)>& fn);
+    unsigned int Size() const { return nThreads; }
+
+private:
+    const unsigned int nThreads;
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable workCond;
+    std::condition_variable doneCond;
+    const std::function<void(size_t)>* batch;
+    size_t nTasks;
+    size_t nNext;
+    size_t nPending;
+    std::exception_ptr error;
+    bool fStop;
+
+    void ThreadMain();
+    /** Runs tasks of the current batch until none are left to start. */
+    void Work(std::unique_lock<std::mutex>& lock);
+};
+
+#endif // ONECOIN_WORKQUEUE_H
@@ -0,0 +1,66 @@
+#include "bench.h"
+#include "../OneCoin/headersync.h"
+#include "../OneCoin/pow.h"
+
+#include <vector>
+
+static void ArithCompare(benchmark::State& state)
+{
+    arith_uint256 target = arith_uint256::FromCompact(0x1d00ffff);
+    arith_uint256 hash(0x1234, 0x5678, 0x9abc, 0x00000000ffff0000ULL);
+    while (state.KeepRunning()) {
+        hash += 1;
+        bool ok = hash <= target;
+        benchmark::DoNotOptimize(ok);
+    }
+}
+
+static void ArithBlockProof(benchmark::State& state)
+{
+    uint32_t nBits = 0x1b0404cb;
+    while (state.KeepRunning()) {
+        arith_uint256 proof = GetBlockProof(nBits);
+        benchmark::DoNotOptimize(proof);
+    }
+}
+
+static void HeaderSyncProcess(benchmark::State& state)
+{
+    ConsensusParams params;
+    params.powLimit = arith_uint256::FromCompact(0x207fffff);
+    params.nPowTargetSpacing = 600;
+    params.nPowTargetTimespan = 14 * 24 * 60 * 60;
+    params.fPowNoRetargeting = true;
+
+    HeaderSyncTip tip;
+    tip.nHeight = 0;
+    tip.nBits = 0x207fffff;
+    tip.nTime = 0;
+    tip.nPeriodStartTime = 0;
+
+    const size_t count = 1000;
+    std::vector<unsigned char> raw(count * BlockHeader::SIZE);
+    BlockHeader header;
+    uint256 prev;
+    for (size_t i = 0; i < count; i++) {
+        header.hashPrevBlock = prev;
+        header.nTime = i + 1;
+        header.nBits = 0x207fffff;
+        header.nNonce = 0;
+        while (!CheckProofOfWork(header.GetHash(), header.nBits, params))
+            header.nNonce++;
+        header.Serialize(&raw[i * BlockHeader::SIZE]);
+        prev = header.GetHash();
+    }
+
+    state.SetItemsPerIteration(count);
+    while (state.KeepRunning()) {
+        HeaderSyncValidator validator(params, tip);
+        HeaderSyncValidator::Result result = validator.ProcessRaw(raw.data(), count, NULL);
+        benchmark::DoNotOptimize(result);
+    }
+}
+
+BENCHMARK(ArithCompare);
+BENCHMARK(ArithBlockProof);
+BENCHMARK(HeaderSyncProcess);
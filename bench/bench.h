@@ -0,0 +1,78 @@
+#ifndef ONECOIN_BENCH_BENCH_H
+#define ONECOIN_BENCH_BENCH_H
+
+#include <stdint.h>
+#include <chrono>
+#include <map>
+#include <string>
+
+/*
+ * Minimal benchmark harness. A benchmark is a function taking a State and
+ * looping on KeepRunning(); the runner grows the iteration count until the
+ * loop has run for the minimum time and reports the mean time per iteration.
+ *
+ *     static void HexEncode(benchmark::State& state)
+ *     {
+ *         while (state.KeepRunning()) { ... }
+ *     }
+ *     BENCHMARK(HexEncode);
+ */
+
+namespace benchmark {
+
+typedef std::chrono::steady_clock clock;
+
+class State {
+public:
+    explicit State(double min_time) : min_time(min_time), count(0), check_at(1) {}
+
+    bool KeepRunning();
+
+    /** Items handled per iteration, for reporting throughput. */
+    void SetItemsPerIteration(uint64_t items) { items_per_iter = items; }
+
+    uint64_t Iterations() const { return count; }
+    double Elapsed() const { return elapsed; }
+    uint64_t ItemsPerIteration() const { return items_per_iter; }
+
+private:
+    double min_time;
+    uint64_t count;
+    uint64_t check_at;
+    uint64_t items_per_iter = 1;
+    double elapsed = 0;
+    clock::time_point start;
+};
+
+typedef void (*BenchFunction)(State&);
+
+class BenchRunner {
+public:
+    BenchRunner(const std::string& name, BenchFunction func);
+
+    /** Runs every benchmark whose name matches the regex filter. */
+    static void RunAll(const std::string& filter, double min_time);
+
+private:
+    typedef std::map<std::string, BenchFunction> BenchmarkMap;
+    static BenchmarkMap& Benchmarks();
+};
+
+/** Data directory of the shared synthetic chain: the one given with
+ *  -dataset=<dir>, or a small one generated under /tmp on first use and
+ *  kept for later runs. Checked against its manifest once per run; empty
+ *  when no usable dataset exists. */
+const std::string& DatasetDir();
+
+/** Keeps the compiler from discarding a computed value. */
+template <typename T>
+inline void DoNotOptimize(T const& value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+} // namespace benchmark
+
+#define BENCHMARK(n) static benchmark::BenchRunner bench_runner_##n(#n, n);
+
+#endif // ONECOIN_BENCH_BENCH_H
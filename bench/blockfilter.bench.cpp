@@ -0,0 +1,76 @@
+#include "bench.h"
+#include "../OneCoin/blockfilter.h"
+#include "../OneCoin/hash.h"
+
+#include <random>
+
+namespace {
+
+/** Output scripts of typical sizes: 25-byte P2PKH and 23-byte P2SH. */
+GCSElementSet RandomScripts(size_t nCount)
+{
+    std::mt19937 rng(42);
+    GCSElementSet scripts(nCount);
+    for (size_t i = 0; i < nCount; i++) {
+        scripts[i].resize(i % 3 == 0 ? 23 : 25);
+        for (size_t j = 0; j < scripts[i].size(); j++)
+            scripts[i][j] = (unsigned char)rng();
+    }
+    return scripts;
+}
+
+}
+
+static void SipHashScalar(benchmark::State& state)
+{
+    GCSElementSet scripts = RandomScripts(4096);
+    std::vector<uint64_t> hashes(scripts.size());
+    state.SetItemsPerIteration(scripts.size());
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < scripts.size(); i++)
+            hashes[i] = SipHash(1, 2, scripts[i].data(), scripts[i].size());
+        benchmark::DoNotOptimize(hashes);
+    }
+}
+
+static void SipHashBatched(benchmark::State& state)
+{
+    GCSElementSet scripts = RandomScripts(4096);
+    std::vector<uint64_t> hashes(scripts.size());
+    state.SetItemsPerIteration(scripts.size());
+    while (state.KeepRunning()) {
+        SipHashBatch(1, 2, scripts, hashes.data());
+        benchmark::DoNotOptimize(hashes);
+    }
+}
+
+/** A filter over the scripts of a full block's worth of outputs and
+ *  inputs. */
+static void GCSFilterBuild(benchmark::State& state)
+{
+    GCSElementSet scripts = RandomScripts(4096);
+    state.SetItemsPerIteration(scripts.size());
+    while (state.KeepRunning()) {
+        GCSFilter filter(GCSFilter::Params(1, 2), scripts);
+        benchmark::DoNotOptimize(filter);
+    }
+}
+
+/** A wallet of 100 scripts checked against one block's filter. */
+static void GCSFilterMatchAny(benchmark::State& state)
+{
+    GCSFilter filter(GCSFilter::Params(1, 2), RandomScripts(4096));
+    GCSElementSet wallet = RandomScripts(100);
+    for (size_t i = 0; i < wallet.size(); i++)
+        wallet[i][0] ^= 0x80;
+    state.SetItemsPerIteration(wallet.size());
+    while (state.KeepRunning()) {
+        bool fMatch = filter.MatchAny(wallet);
+        benchmark::DoNotOptimize(fMatch);
+    }
+}
+
+BENCHMARK(SipHashScalar);
+BENCHMARK(SipHashBatched);
+BENCHMARK(GCSFilterBuild);
+BENCHMARK(GCSFilterMatchAny);
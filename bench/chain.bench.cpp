@@ -0,0 +1,85 @@
+#include "bench.h"
+#include "../OneCoin/chain.h"
+
+#include <string.h>
+#include <deque>
+#include <random>
+
+namespace {
+
+/** Headers in the benchmark chain, about ten years of blocks. */
+const int CHAIN_LENGTH = 500000;
+
+struct LongChain {
+    BlockIndexArena arena;
+    std::deque<uint256> hashes;
+    ActiveChain chain;
+    /** The tip of a fork 100 blocks off the active tip. */
+    BlockIndex* pindexFork;
+};
+
+BlockIndex* AddHeader(LongChain& chain, BlockIndex* pprev)
+{
+    BlockHeader header;
+    header.nTime = pprev ? pprev->nTime + 600 : 1000;
+    header.nNonce = (uint32_t)chain.arena.size();
+    BlockIndex* pindex = chain.arena.Add(header);
+    unsigned char hash[32] = {};
+    uint64_t n = chain.arena.size();
+    memcpy(hash, &n, sizeof(n));
+    chain.hashes.push_back(uint256(hash));
+    pindex->phashBlock = &chain.hashes.back();
+    if (pprev) {
+        pindex->pprev = pprev;
+        pindex->nHeight = pprev->nHeight + 1;
+        pindex->BuildSkip();
+    }
+    return pindex;
+}
+
+LongChain& GetLongChain()
+{
+    static LongChain chain;
+    if (chain.chain.Tip())
+        return chain;
+    BlockIndex* pindex = NULL;
+    for (int i = 0; i <= CHAIN_LENGTH; i++)
+        pindex = AddHeader(chain, pindex);
+    chain.chain.SetTip(pindex);
+    BlockIndex* pindexFork = pindex->GetAncestor(CHAIN_LENGTH - 100);
+    for (int i = 0; i < 101; i++)
+        pindexFork = AddHeader(chain, pindexFork);
+    chain.pindexFork = pindexFork;
+    return chain;
+}
+
+} // namespace
+
+/** Random ancestors of the tip of a long header chain. */
+static void ChainGetAncestor(benchmark::State& state)
+{
+    LongChain& chain = GetLongChain();
+    std::mt19937 rng(1);
+    while (state.KeepRunning()) {
+        const BlockIndex* pindex = chain.chain.Tip()->GetAncestor(rng() % CHAIN_LENGTH);
+        benchmark::DoNotOptimize(pindex);
+    }
+}
+
+/** What a headers message from a peer on a short fork costs: its fork
+ *  point with the active chain, a locator from it and the median time. */
+static void ChainHeadersFork(benchmark::State& state)
+{
+    LongChain& chain = GetLongChain();
+    while (state.KeepRunning()) {
+        const BlockIndex* pindexFork = chain.chain.FindFork(chain.pindexFork);
+        std::vector<uint256> locator = chain.chain.GetLocator(chain.pindexFork);
+        int64_t nTime = chain.pindexFork->GetMedianTimePast();
+        benchmark::DoNotOptimize(pindexFork);
+        benchmark::DoNotOptimize(locator);
+        benchmark::DoNotOptimize(nTime);
+    }
+}
+
+BENCHMARK(ChainGetAncestor);
+BENCHMARK(ChainHeadersFork);
@@ -0,0 +1,46 @@
+#include "bench.h"
+#include "../OneCoin/chaingen.h"
+#include "../OneCoin/validation.h"
+
+#include <stdio.h>
+
+/** Rebuilds the chain state from the dataset's block files, as a restart
+ *  does; one full replay per iteration, throughput in transactions. */
+static void Replay(benchmark::State& state, bool fPipeline, bool fAssumeValid = false, bool fReindex = false)
+{
+    const std::string& datadir = benchmark::DatasetDir();
+    ChainManifest manifest;
+    std::string error;
+    if (datadir.empty() || !ReadChainManifest(datadir, manifest, error))
+        return;
+    std::unique_ptr<const ChainParams> params = CreateChainParams(manifest.network);
+    state.SetItemsPerIteration(manifest.nTransactions);
+    while (state.KeepRunning()) {
+        Chainstate chainstate(*params, datadir);
+        chainstate.SetReplayPipeline(fPipeline);
+        chainstate.SetReindex(fReindex);
+        chainstate.SetAssumeValid(fAssumeValid ? manifest.tip : uint256());
+        if (!chainstate.Load(error) || chainstate.Tip()->GetBlockHash() != manifest.tip) {
+            fprintf(stderr, "ChainReplay: %s\n", error.empty() ? "tip does not match the manifest" : error.c_str());
+            return;
+        }
+    }
+}
+
+static void ChainReplay(benchmark::State& state) { Replay(state, true); }
+/** The same replay one block at a time on one thread: the stage sum the
+ *  pipeline is measured against. */
+static void ChainReplaySerial(benchmark::State& state) { Replay(state, false); }
+/** Replay with the manifest tip as the assume-valid block: every check but
+ *  the scripts. */
+static void ChainReplayAssumeValid(benchmark::State& state) { Replay(state, true, true); }
+/** -reindex: the block files mapped, headers hashed in parallel, blocks
+ *  connected in height order. */
+static void ChainReindex(benchmark::State& state) { Replay(state, true, false, true); }
+static void ChainReindexAssumeValid(benchmark::State& state) { Replay(state, true, true, true); }
+
+BENCHMARK(ChainReplay);
+BENCHMARK(ChainReplaySerial);
+BENCHMARK(ChainReplayAssumeValid);
+BENCHMARK(ChainReindex);
+BENCHMARK(ChainReindexAssumeValid);
@@ -0,0 +1,100 @@
+#include "bench.h"
+#include "../OneCoin/coinsdb.h"
+#include "../OneCoin/fs.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <random>
+
+namespace {
+
+/** Coins in the benchmark store, about 24 MB on disk. */
+const size_t COLD_COINS = 1000000;
+/** Lookups per batch: the inputs of a large block. */
+const size_t COLD_BATCH = 2000;
+
+struct ColdStore {
+    std::unique_ptr<CoinsViewDB> db;
+    std::vector<OutPoint> outpoints;
+};
+
+ColdStore& GetColdStore()
+{
+    static ColdStore store;
+    if (store.db)
+        return store;
+    std::string dir = "/tmp/onecoin_bench_coinsdb";
+    RemoveAll(dir);
+    store.db.reset(new CoinsViewDB(dir));
+    std::string error;
+    if (!store.db->Open(error)) {
+        fprintf(stderr, "coins database: %s\n", error.c_str());
+        store.db.reset();
+        return store;
+    }
+    std::mt19937_64 rng(1);
+    CoinsViewCache cache(store.db.get());
+    for (size_t i = 0; i < COLD_COINS; i++) {
+        unsigned char hash[32];
+        for (int j = 0; j < 32; j += 8) {
+            uint64_t r = rng();
+            memcpy(hash + j, &r, 8);
+        }
+        OutPoint outpoint(uint256(hash), 0);
+        unsigned char hash160[20];
+        memcpy(hash160, hash, 20);
+        cache.AddCoin(outpoint, Coin(TxOut(COIN, GetScriptForPubKeyHash(hash160)), (int)(i / 1000), false), false);
+        store.outpoints.push_back(outpoint);
+        if (cache.CacheSize() >= 100000)
+            cache.Flush();
+    }
+    cache.Flush();
+    return store;
+}
+
+/** Drops the store from the page cache, so every lookup is a device read,
+ *  as it is for a UTXO set much larger than RAM. */
+void EvictColdStore(const ColdStore& store)
+{
+    int fd = open(store.db->FilePath().c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+void ColdLookups(benchmark::State& state, BatchReader::Method method)
+{
+    ColdStore& store = GetColdStore();
+    if (!store.db)
+        return;
+    store.db->SetReadMethod(method);
+    if (method != BatchReader::READ_AUTO && store.db->GetReadMethod() != method) {
+        fprintf(stderr, "%s reads are not available\n", BatchReader::MethodName(method));
+        return;
+    }
+    std::mt19937 rng(2);
+    std::vector<OutPoint> batch(COLD_BATCH);
+    std::vector<Coin> coins;
+    state.SetItemsPerIteration(COLD_BATCH);
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < batch.size(); i++)
+            batch[i] = store.outpoints[rng() % store.outpoints.size()];
+        EvictColdStore(store);
+        store.db->GetCoins(batch, coins);
+        benchmark::DoNotOptimize(coins);
+    }
+}
+
+} // namespace
+
+static void CoinsDBColdSerial(benchmark::State& state) { ColdLookups(state, BatchReader::READ_SERIAL); }
+static void CoinsDBColdThreads(benchmark::State& state) { ColdLookups(state, BatchReader::READ_THREADS); }
+static void CoinsDBColdIoUring(benchmark::State& state) { ColdLookups(state, BatchReader::READ_IO_URING); }
+
+BENCHMARK(CoinsDBColdSerial);
+BENCHMARK(CoinsDBColdThreads);
+BENCHMARK(CoinsDBColdIoUring);
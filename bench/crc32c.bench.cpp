@@ -0,0 +1,56 @@
+#include "bench.h"
+#include "../OneCoin/crc32c.h"
+
+#include <vector>
+
+namespace {
+
+/** About a full block's worth of bytes. */
+std::vector<unsigned char> RandomBytes()
+{
+    std::vector<unsigned char> data(1 << 20);
+    uint32_t x = 1;
+    for (size_t i = 0; i < data.size(); i++) {
+        x = x * 1103515245 + 12345;
+        data[i] = (unsigned char)(x >> 16);
+    }
+    return data;
+}
+
+}
+
+/** Items are bytes. */
+static void Crc32cHardware(benchmark::State& state)
+{
+    std::vector<unsigned char> data = RandomBytes();
+    state.SetItemsPerIteration(data.size());
+    while (state.KeepRunning()) {
+        uint32_t crc = Crc32c(data.data(), data.size());
+        benchmark::DoNotOptimize(crc);
+    }
+}
+
+static void Crc32cSlicingBy8(benchmark::State& state)
+{
+    std::vector<unsigned char> data = RandomBytes();
+    state.SetItemsPerIteration(data.size());
+    while (state.KeepRunning()) {
+        uint32_t crc = Crc32cExtendPortable(0, data.data(), data.size());
+        benchmark::DoNotOptimize(crc);
+    }
+}
+
+/** The size of an undo record or a log record of a few coins. */
+static void Crc32cShort(benchmark::State& state)
+{
+    std::vector<unsigned char> data = RandomBytes();
+    state.SetItemsPerIteration(64);
+    while (state.KeepRunning()) {
+        uint32_t crc = Crc32c(data.data(), 64);
+        benchmark::DoNotOptimize(crc);
+    }
+}
+
+BENCHMARK(Crc32cHardware);
+BENCHMARK(Crc32cSlicingBy8);
+BENCHMARK(Crc32cShort);
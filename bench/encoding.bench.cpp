@@ -0,0 +1,225 @@
+#include "bench.h"
+#include "../OneCoin/encoding.h"
+
+#include <stdlib.h>
+#include <random>
+
+namespace {
+
+std::vector<unsigned char> RandomBytes(size_t len)
+{
+    std::mt19937 rng(42);
+    std::vector<unsigned char> v(len);
+    for (size_t i = 0; i < len; i++)
+        v[i] = (unsigned char)rng();
+    return v;
+}
+
+/** Reference implementations the fast paths are measured against. */
+std::string NaiveHexStr(const std::vector<unsigned char>& data)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string str;
+    for (size_t i = 0; i < data.size(); i++) {
+        str += digits[data[i] >> 4];
+        str += digits[data[i] & 15];
+    }
+    return str;
+}
+
+std::vector<unsigned char> NaiveParseHex(const std::string& str)
+{
+    std::vector<unsigned char> out;
+    for (size_t i = 0; i + 1 < str.size(); i += 2)
+        out.push_back((unsigned char)strtoul(str.substr(i, 2).c_str(), NULL, 16));
+    return out;
+}
+
+/** Byte-at-a-time base58 with a quadratic inner loop. */
+std::string NaiveEncodeBase58(const std::vector<unsigned char>& data)
+{
+    static const char digits[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+    size_t zeros = 0;
+    while (zeros < data.size() && data[zeros] == 0)
+        zeros++;
+    std::vector<unsigned char> b58((data.size() - zeros) * 138 / 100 + 1);
+    size_t length = 0;
+    for (size_t i = zeros; i < data.size(); i++) {
+        int carry = data[i];
+        size_t j = 0;
+        for (std::vector<unsigned char>::reverse_iterator it = b58.rbegin(); (carry != 0 || j < length) && it != b58.rend(); ++it, ++j) {
+            carry += 256 * (*it);
+            *it = carry % 58;
+            carry /= 58;
+        }
+        length = j;
+    }
+    std::vector<unsigned char>::iterator it = b58.begin() + (b58.size() - length);
+    while (it != b58.end() && *it == 0)
+        it++;
+    std::string str(zeros, '1');
+    while (it != b58.end())
+        str += digits[*(it++)];
+    return str;
+}
+
+/** Polymod with one branch per generator bit, as written in BIP173. */
+uint32_t NaivePolyMod(const std::vector<uint8_t>& v)
+{
+    static const uint32_t gen[5] = {0x3b6a57b2, 0x26508e6d, 0x1ea119fa, 0x3d4233dd, 0x2a1462b3};
+    uint32_t chk = 1;
+    for (size_t i = 0; i < v.size(); i++) {
+        uint32_t top = chk >> 25;
+        chk = ((chk & 0x1ffffff) << 5) ^ v[i];
+        for (int j = 0; j < 5; j++) {
+            if ((top >> j) & 1)
+                chk ^= gen[j];
+        }
+    }
+    return chk;
+}
+
+std::string NaiveBech32Encode(const std::string& hrp, const std::vector<uint8_t>& values)
+{
+    static const char charset[] = "qpzry9x8gf2tvdw0s3jn54khce6mua7l";
+    std::vector<uint8_t> enc;
+    for (size_t i = 0; i < hrp.size(); i++)
+        enc.push_back(hrp[i] >> 5);
+    enc.push_back(0);
+    for (size_t i = 0; i < hrp.size(); i++)
+        enc.push_back(hrp[i] & 31);
+    enc.insert(enc.end(), values.begin(), values.end());
+    enc.resize(enc.size() + 6);
+    uint32_t mod = NaivePolyMod(enc) ^ 1;
+    std::string str = hrp + '1';
+    for (size_t i = 0; i < values.size(); i++)
+        str += charset[values[i]];
+    for (int i = 0; i < 6; i++)
+        str += charset[(mod >> (5 * (5 - i))) & 31];
+    return str;
+}
+
+}
+
+static void HexEncodeNaive(benchmark::State& state)
+{
+    std::vector<unsigned char> data = RandomBytes(1024);
+    state.SetItemsPerIteration(data.size());
+    while (state.KeepRunning()) {
+        std::string s = NaiveHexStr(data);
+        benchmark::DoNotOptimize(s);
+    }
+}
+
+static void HexEncodeFast(benchmark::State& state)
+{
+    std::vector<unsigned char> data = RandomBytes(1024);
+    state.SetItemsPerIteration(data.size());
+    while (state.KeepRunning()) {
+        std::string s = HexStr(data);
+        benchmark::DoNotOptimize(s);
+    }
+}
+
+static void HexDecodeNaive(benchmark::State& state)
+{
+    std::string hex = HexStr(RandomBytes(1024));
+    state.SetItemsPerIteration(hex.size() / 2);
+    while (state.KeepRunning()) {
+        std::vector<unsigned char> v = NaiveParseHex(hex);
+        benchmark::DoNotOptimize(v);
+    }
+}
+
+static void HexDecodeFast(benchmark::State& state)
+{
+    std::string hex = HexStr(RandomBytes(1024));
+    state.SetItemsPerIteration(hex.size() / 2);
+    while (state.KeepRunning()) {
+        std::vector<unsigned char> v = ParseHex(hex);
+        benchmark::DoNotOptimize(v);
+    }
+}
+
+static void Base58AddressNaive(benchmark::State& state)
+{
+    std::vector<unsigned char> payload = RandomBytes(BASE58_ADDRESS_PAYLOAD);
+    payload[0] = 0;
+    while (state.KeepRunning()) {
+        std::string s = NaiveEncodeBase58(payload);
+        benchmark::DoNotOptimize(s);
+    }
+}
+
+static void Base58AddressGeneric(benchmark::State& state)
+{
+    std::vector<unsigned char> payload = RandomBytes(BASE58_ADDRESS_PAYLOAD);
+    payload[0] = 0;
+    while (state.KeepRunning()) {
+        std::string s = EncodeBase58(payload);
+        benchmark::DoNotOptimize(s);
+    }
+}
+
+static void Base58AddressFixed(benchmark::State& state)
+{
+    std::vector<unsigned char> payload = RandomBytes(BASE58_ADDRESS_PAYLOAD);
+    payload[0] = 0;
+    while (state.KeepRunning()) {
+        std::string s = EncodeBase58Address(payload.data());
+        benchmark::DoNotOptimize(s);
+    }
+}
+
+static void Base58AddressDecode(benchmark::State& state)
+{
+    std::vector<unsigned char> payload = RandomBytes(BASE58_ADDRESS_PAYLOAD);
+    payload[0] = 0;
+    std::string str = EncodeBase58Address(payload.data());
+    unsigned char out[BASE58_ADDRESS_PAYLOAD];
+    while (state.KeepRunning()) {
+        bool ok = DecodeBase58Address(str, out);
+        benchmark::DoNotOptimize(ok);
+    }
+}
+
+static void Bech32EncodeNaive(benchmark::State& state)
+{
+    std::vector<uint8_t> values(1, 0);
+    bech32::ConvertBits(8, 5, true, RandomBytes(32), values);
+    while (state.KeepRunning()) {
+        std::string s = NaiveBech32Encode("oc", values);
+        benchmark::DoNotOptimize(s);
+    }
+}
+
+static void Bech32EncodeTable(benchmark::State& state)
+{
+    std::vector<uint8_t> values(1, 0);
+    bech32::ConvertBits(8, 5, true, RandomBytes(32), values);
+    while (state.KeepRunning()) {
+        std::string s = bech32::Encode(bech32::BECH32, "oc", values);
+        benchmark::DoNotOptimize(s);
+    }
+}
+
+static void Bech32DecodeTable(benchmark::State& state)
+{
+    std::string addr = bech32::EncodeAddress("oc", 0, RandomBytes(32));
+    while (state.KeepRunning()) {
+        bech32::DecodeResult r = bech32::Decode(addr);
+        benchmark::DoNotOptimize(r);
+    }
+}
+
+BENCHMARK(HexEncodeNaive);
+BENCHMARK(HexEncodeFast);
+BENCHMARK(HexDecodeNaive);
+BENCHMARK(HexDecodeFast);
+BENCHMARK(Base58AddressNaive);
+BENCHMARK(Base58AddressGeneric);
+BENCHMARK(Base58AddressFixed);
+BENCHMARK(Base58AddressDecode);
+BENCHMARK(Bech32EncodeNaive);
+BENCHMARK(Bech32EncodeTable);
+BENCHMARK(Bech32DecodeTable);
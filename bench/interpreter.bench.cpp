@@ -0,0 +1,97 @@
+#include "bench.h"
+#include "../OneCoin/hash.h"
+#include "../OneCoin/interpreter.h"
+
+#include <stdio.h>
+
+namespace {
+
+/** Accepts every signature, so the benchmarks time the interpreter rather
+ *  than the elliptic curve arithmetic. */
+class AlwaysValidChecker : public BaseSignatureChecker {
+public:
+    bool CheckSig(const StackItem&, const StackItem&, const Script&) const { return true; }
+};
+
+std::vector<unsigned char> FakeSig(unsigned char n)
+{
+    std::vector<unsigned char> sig(72, n);
+    sig[0] = 0x30;
+    return sig;
+}
+
+std::vector<unsigned char> FakePubKey(unsigned char n)
+{
+    std::vector<unsigned char> pubkey(33, n);
+    pubkey[0] = 0x02;
+    return pubkey;
+}
+
+struct Spend {
+    Script scriptSig;
+    Script scriptPubKey;
+};
+
+Spend PayToPubKeyHash()
+{
+    std::vector<unsigned char> pubkey = FakePubKey(1);
+    unsigned char hash[20];
+    Hash160(pubkey.data(), pubkey.size(), hash);
+    Spend spend;
+    spend.scriptSig << FakeSig(1) << pubkey;
+    spend.scriptPubKey = GetScriptForPubKeyHash(hash);
+    return spend;
+}
+
+Spend PayToScriptHashMultisig()
+{
+    std::vector<std::vector<unsigned char> > pubkeys;
+    for (unsigned char i = 1; i <= 3; i++)
+        pubkeys.push_back(FakePubKey(i));
+    Script redeem = GetScriptForMultisig(2, pubkeys);
+    unsigned char hash[20];
+    Hash160(redeem.data(), redeem.size(), hash);
+    Spend spend;
+    spend.scriptSig << OP_0 << FakeSig(1) << FakeSig(2) << std::vector<unsigned char>(redeem.begin(), redeem.end());
+    spend.scriptPubKey = GetScriptForScriptHash(hash);
+    return spend;
+}
+
+void Run(benchmark::State& state, const Spend& spend, bool fFast)
+{
+    AlwaysValidChecker checker;
+    ScriptError error;
+    while (state.KeepRunning()) {
+        bool ok = fFast ? VerifyScript(spend.scriptSig, spend.scriptPubKey, MANDATORY_SCRIPT_VERIFY_FLAGS, checker, &error)
+                        : VerifyScriptGeneric(spend.scriptSig, spend.scriptPubKey, MANDATORY_SCRIPT_VERIFY_FLAGS, checker, &error);
+        if (!ok) {
+            fprintf(stderr, "script failed: %s\n", ScriptErrorString(error));
+            return;
+        }
+    }
+}
+
+} // namespace
+
+static void VerifyP2PKHFast(benchmark::State& state) { Run(state, PayToPubKeyHash(), true); }
+static void VerifyP2PKHGeneric(benchmark::State& state) { Run(state, PayToPubKeyHash(), false); }
+static void VerifyP2SHMultisigFast(benchmark::State& state) { Run(state, PayToScriptHashMultisig(), true); }
+static void VerifyP2SHMultisigGeneric(benchmark::State& state) { Run(state, PayToScriptHashMultisig(), false); }
+
+/** Arithmetic and stack shuffling with no fast path: the interpreter's
+ *  dispatch and stack item handling on their own. */
+static void VerifyArithmetic(benchmark::State& state)
+{
+    Spend spend;
+    spend.scriptSig << OP_1;
+    for (int i = 0; i < 50; i++)
+        spend.scriptPubKey << OP_DUP << OP_1ADD << OP_SWAP << OP_DROP;
+    spend.scriptPubKey << 51 << OP_EQUAL;
+    Run(state, spend, false);
+}
+
+BENCHMARK(VerifyP2PKHFast);
+BENCHMARK(VerifyP2PKHGeneric);
+BENCHMARK(VerifyP2SHMultisigFast);
+BENCHMARK(VerifyP2SHMultisigGeneric);
+BENCHMARK(VerifyArithmetic);
@@ -0,0 +1,175 @@
+#include "bench.h"
+#include "../OneCoin/fs.h"
+#include "../OneCoin/lsm.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/** Keys in the lookup store: outpoint-sized keys, coin-sized values,
+ *  about 70 MB before compression and many times the memtable. */
+const size_t LSM_KEYS = 1000000;
+/** Puts per write batch: the coins of a cache flush. */
+const size_t LSM_BATCH = 10000;
+/** Durable writes per thread and iteration in the sync benchmarks. */
+const size_t SYNC_WRITES = 16;
+
+/** splitmix64: hashes n so keys arrive in random order, as txids do. */
+uint64_t Mix(uint64_t n)
+{
+    n += 0x9e3779b97f4a7c15ULL;
+    n = (n ^ (n >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    n = (n ^ (n >> 27)) * 0x94d049bb133111ebULL;
+    return n ^ (n >> 31);
+}
+
+std::string OutPointKey(uint64_t n)
+{
+    std::string key(37, 'c');
+    for (int i = 0; i < 4; i++) {
+        uint64_t r = Mix(n * 4 + i);
+        memcpy(&key[1 + 8 * i], &r, 8);
+    }
+    return key;
+}
+
+std::string CoinValue(uint64_t n)
+{
+    std::string value(33, '\0');
+    memcpy(&value[0], &n, 8);
+    value[8] = 0x76;
+    value[9] = (char)0xa9;
+    return value;
+}
+
+LsmStore* GetLookupStore()
+{
+    static std::unique_ptr<LsmStore> store;
+    if (store)
+        return store.get();
+    std::string dir = "/tmp/onecoin_bench_lsm";
+    RemoveAll(dir);
+    store.reset(new LsmStore(dir));
+    std::string error;
+    if (!store->Open(error)) {
+        fprintf(stderr, "lsm store: %s\n", error.c_str());
+        store.reset();
+        return NULL;
+    }
+    LsmWriteBatch batch;
+    for (size_t i = 0; i < LSM_KEYS; i++) {
+        batch.Put(OutPointKey(i), CoinValue(i));
+        if (batch.Count() == LSM_BATCH) {
+            store->Write(batch);
+            batch.Clear();
+        }
+    }
+    store->Write(batch);
+    store->Flush();
+    store->WaitForCompactions();
+    return store.get();
+}
+
+/** Threads each making small durable writes, as concurrent flushes of
+ *  per-block chainstate updates do. */
+void SyncWrites(benchmark::State& state, unsigned int nThreads)
+{
+    std::string dir = "/tmp/onecoin_bench_lsm_sync";
+    RemoveAll(dir);
+    LsmStore store(dir);
+    std::string error;
+    if (!store.Open(error)) {
+        fprintf(stderr, "lsm store: %s\n", error.c_str());
+        return;
+    }
+    uint64_t n = 0;
+    state.SetItemsPerIteration(nThreads * SYNC_WRITES);
+    while (state.KeepRunning()) {
+        std::vector<std::thread> threads;
+        for (unsigned int t = 0; t < nThreads; t++, n += SYNC_WRITES) {
+            threads.push_back(std::thread([&store, n] {
+                for (size_t i = 0; i < SYNC_WRITES; i++) {
+                    LsmWriteBatch batch;
+                    batch.Put(OutPointKey(n + i), CoinValue(n + i));
+                    store.Write(batch, true);
+                }
+            }));
+        }
+        for (size_t t = 0; t < threads.size(); t++)
+            threads[t].join();
+    }
+    LsmStats stats = store.GetStats();
+    if (stats.nSyncs)
+        fprintf(stderr, "%u threads: %.2f writes per sync\n", nThreads, (double)stats.nWrites / stats.nSyncs);
+    store.Close();
+    RemoveAll(dir);
+}
+
+} // namespace
+
+/** Point lookups of random present keys in a compacted store. */
+static void LsmRandomGet(benchmark::State& state)
+{
+    LsmStore* store = GetLookupStore();
+    if (!store)
+        return;
+    std::mt19937 rng(1);
+    std::string value;
+    while (state.KeepRunning()) {
+        bool found = store->Get(OutPointKey(rng() % LSM_KEYS), value);
+        benchmark::DoNotOptimize(found);
+    }
+}
+
+/** Lookups of keys that are not there, which the filters answer. */
+static void LsmMissingGet(benchmark::State& state)
+{
+    LsmStore* store = GetLookupStore();
+    if (!store)
+        return;
+    std::mt19937 rng(2);
+    std::string value;
+    while (state.KeepRunning()) {
+        bool found = store->Get(OutPointKey(LSM_KEYS + rng()), value);
+        benchmark::DoNotOptimize(found);
+    }
+}
+
+/** Batches of new keys written into a growing store, flushes and
+ *  compactions included. */
+static void LsmBulkWrite(benchmark::State& state)
+{
+    std::string dir = "/tmp/onecoin_bench_lsm_write";
+    RemoveAll(dir);
+    LsmStore store(dir);
+    std::string error;
+    if (!store.Open(error)) {
+        fprintf(stderr, "lsm store: %s\n", error.c_str());
+        return;
+    }
+    uint64_t n = 0;
+    LsmWriteBatch batch;
+    state.SetItemsPerIteration(LSM_BATCH);
+    while (state.KeepRunning()) {
+        batch.Clear();
+        for (size_t i = 0; i < LSM_BATCH; i++, n++)
+            batch.Put(OutPointKey(n), CoinValue(n));
+        store.Write(batch);
+    }
+    store.WaitForCompactions();
+    store.Close();
+    RemoveAll(dir);
+}
+
+static void LsmSyncWrites1Thread(benchmark::State& state) { SyncWrites(state, 1); }
+static void LsmSyncWrites8Threads(benchmark::State& state) { SyncWrites(state, 8); }
+
+BENCHMARK(LsmRandomGet);
+BENCHMARK(LsmMissingGet);
+BENCHMARK(LsmBulkWrite);
+BENCHMARK(LsmSyncWrites1Thread);
+BENCHMARK(LsmSyncWrites8Threads);
@@ -0,0 +1,111 @@
+#include "bench.h"
+#include "../OneCoin/chaingen.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <regex>
+
+namespace benchmark {
+
+bool State::KeepRunning()
+{
+    if (count == 0)
+        start = clock::now();
+    if (++count < check_at)
+        return true;
+    elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    if (elapsed >= min_time) {
+        count--;
+        return false;
+    }
+    check_at *= 2;
+    return true;
+}
+
+static std::string datasetArg;
+
+const std::string& DatasetDir()
+{
+    static std::string dir;
+    static bool checked = false;
+    if (checked)
+        return dir;
+    checked = true;
+    std::string datadir = datasetArg.empty() ? "/tmp/onecoin_bench_dataset" : datasetArg;
+    std::unique_ptr<const ChainParams> params = CreateChainParams("regtest");
+    ChainManifest manifest;
+    std::string error;
+    if (!ReadChainManifest(datadir, manifest, error)) {
+        if (!datasetArg.empty()) {
+            fprintf(stderr, "-dataset: %s\n", error.c_str());
+            return dir;
+        }
+        ChainGenOptions options;
+        options.nHeight = 250;
+        options.nTxPerBlock = 100;
+        fprintf(stderr, "generating a %d-block dataset in %s\n", options.nHeight, datadir.c_str());
+        if (!ChainGenerator(*params, options).Run(datadir, manifest, error)) {
+            fprintf(stderr, "generating dataset: %s\n", error.c_str());
+            return dir;
+        }
+    }
+    if (!VerifyChainDataset(datadir, manifest, error)) {
+        fprintf(stderr, "dataset %s: %s\n", datadir.c_str(), error.c_str());
+        return dir;
+    }
+    dir = datadir;
+    return dir;
+}
+
+BenchRunner::BenchmarkMap& BenchRunner::Benchmarks()
+{
+    static BenchmarkMap benchmarks;
+    return benchmarks;
+}
+
+BenchRunner::BenchRunner(const std::string& name, BenchFunction func)
+{
+    Benchmarks().insert(std::make_pair(name, func));
+}
+
+void BenchRunner::RunAll(const std::string& filter, double min_time)
+{
+    std::regex re(filter);
+    printf("%-40s %14s %14s %16s\n", "benchmark", "iterations", "ns/iter", "items/s");
+    for (BenchmarkMap::const_iterator it = Benchmarks().begin(); it != Benchmarks().end(); ++it) {
+        if (!std::regex_search(it->first, re))
+            continue;
+        State state(min_time);
+        it->second(state);
+        if (state.Iterations() == 0)
+            continue;
+        double per_iter = state.Elapsed() / state.Iterations();
+        printf("%-40s %14llu %14.1f %16.0f\n", it->first.c_str(), (unsigned long long)state.Iterations(),
+            per_iter * 1e9, state.ItemsPerIteration() / per_iter);
+        fflush(stdout);
+    }
+}
+
+} // namespace benchmark
+
+int main(int argc, char** argv)
+{
+    std::string filter = ".*";
+    double min_time = 0.5;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "-filter=", 8) == 0) {
+            filter = argv[i] + 8;
+        } else if (strncmp(argv[i], "-min_time=", 10) == 0) {
+            min_time = atof(argv[i] + 10);
+        } else if (strncmp(argv[i], "-dataset=", 9) == 0) {
+            benchmark::datasetArg = argv[i] + 9;
+        } else {
+            fprintf(stderr, "Usage: %s [-filter=<regex>] [-min_time=<seconds>] [-dataset=<dir>]\n", argv[0]);
+            return (1);
+        }
+    }
+    benchmark::BenchRunner::RunAll(filter, min_time);
+
+    return (0);
+}
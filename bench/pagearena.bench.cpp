@@ -0,0 +1,112 @@
+#include "bench.h"
+#include "../OneCoin/coins.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <functional>
+#include <vector>
+
+namespace {
+
+/** Coins in the cache, about 450 MB of nodes: far beyond what the TLB
+ *  covers with 4 KiB pages, and within what it covers with 2 MiB ones. */
+const uint32_t LOOKUP_COINS = 4000000;
+
+uint64_t SplitMix64(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/** The outpoint of coin i, computed rather than read from a table that
+ *  would take TLB entries of its own. */
+OutPoint LookupOutPoint(uint32_t i)
+{
+    unsigned char hash[32];
+    for (int j = 0; j < 4; j++) {
+        uint64_t r = SplitMix64((uint64_t)i * 4 + j);
+        memcpy(hash + 8 * j, &r, 8);
+    }
+    return OutPoint(uint256(hash), 0);
+}
+
+/**
+ * Chases a single cycle through every coin: each coin's height names the
+ * next one to look up, so no lookup starts before the previous one ends
+ * and the time per item is the latency of one lookup into a cold cache.
+ */
+void ChasedLookups(benchmark::State& state, const PageArena::Options& options)
+{
+    if (options.fNumaInterleave && PageArena::NumaNodes() < 2)
+        fprintf(stderr, "one NUMA node: nothing to interleave\n");
+    PageArena arena(options);
+    {
+        CoinsMap map(0, OutPointHasher(), std::equal_to<OutPoint>(),
+            ArenaAllocator<std::pair<const OutPoint, CoinsCacheEntry> >(&arena));
+        map.reserve(LOOKUP_COINS);
+        // Sattolo's shuffle, for one cycle through them all.
+        std::vector<uint32_t> next(LOOKUP_COINS);
+        for (uint32_t i = 0; i < LOOKUP_COINS; i++)
+            next[i] = i;
+        uint64_t x = 1;
+        for (uint32_t i = LOOKUP_COINS - 1; i > 0; i--) {
+            x = SplitMix64(x);
+            std::swap(next[i], next[x % i]);
+        }
+        for (uint32_t i = 0; i < LOOKUP_COINS; i++) {
+            CoinsCacheEntry& entry = map[LookupOutPoint(i)];
+            entry.coin = Coin(TxOut(COIN, Script()), (int)next[i], false);
+        }
+        std::vector<uint32_t>().swap(next);
+
+        PageArena::Stats stats = arena.GetStats();
+        if (options.hugePages == PageArena::HUGEPAGES_EXPLICIT && stats.nExplicitFallbacks)
+            fprintf(stderr, "%llu of %llu MiB on explicit huge pages\n",
+                (unsigned long long)(stats.nExplicitBytes >> 20), (unsigned long long)(stats.nMappedBytes >> 20));
+
+        uint32_t i = 0;
+        while (state.KeepRunning()) {
+            CoinsMap::const_iterator it = map.find(LookupOutPoint(i));
+            i = (uint32_t)it->second.coin.nHeight;
+        }
+        benchmark::DoNotOptimize(i);
+    }
+}
+
+}
+
+/** 4 KiB pages throughout. */
+static void CoinsLookupSmallPages(benchmark::State& state)
+{
+    ChasedLookups(state, PageArena::Options());
+}
+
+static void CoinsLookupTransparentHugePages(benchmark::State& state)
+{
+    PageArena::Options options;
+    options.hugePages = PageArena::HUGEPAGES_TRANSPARENT;
+    ChasedLookups(state, options);
+}
+
+/** Falls back to transparent huge pages where none are reserved. */
+static void CoinsLookupExplicitHugePages(benchmark::State& state)
+{
+    PageArena::Options options;
+    options.hugePages = PageArena::HUGEPAGES_EXPLICIT;
+    ChasedLookups(state, options);
+}
+
+static void CoinsLookupHugePagesInterleaved(benchmark::State& state)
+{
+    PageArena::Options options;
+    options.hugePages = PageArena::HUGEPAGES_TRANSPARENT;
+    options.fNumaInterleave = true;
+    ChasedLookups(state, options);
+}
+
+BENCHMARK(CoinsLookupSmallPages);
+BENCHMARK(CoinsLookupTransparentHugePages);
+BENCHMARK(CoinsLookupExplicitHugePages);
+BENCHMARK(CoinsLookupHugePagesInterleaved);
@@ -0,0 +1,54 @@
+#include "bench.h"
+#include "../OneCoin/policy.h"
+#include "../OneCoin/transaction.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+/** A relay-flood transaction: a valid-looking spend whose fortieth output
+ *  is dust, so it is rejected near its end. */
+std::vector<unsigned char> SpamTransaction()
+{
+    MutableTransaction tx;
+    for (unsigned char i = 0; i < 5; i++) {
+        unsigned char hash[32] = {i};
+        std::vector<unsigned char> key(33, i);
+        key[0] = 0x02;
+        tx.vin.push_back(TxIn(OutPoint(uint256(hash), 0), Script() << std::vector<unsigned char>(72, 0x30) << key));
+    }
+    for (unsigned char i = 0; i < 40; i++) {
+        unsigned char hash160[20] = {i};
+        tx.vout.push_back(TxOut(i == 39 ? 1 : COIN, GetScriptForPubKeyHash(hash160)));
+    }
+    return SerializeTransaction(tx);
+}
+
+} // namespace
+
+/** Rejecting a spam transaction from its bytes. */
+static void PolicyCheckSerialized(benchmark::State& state)
+{
+    std::vector<unsigned char> data = SpamTransaction();
+    TxPolicyStats stats;
+    std::string reason;
+    while (state.KeepRunning()) {
+        bool ok = CheckTransactionPolicy(data.data(), data.size(), stats, reason);
+        benchmark::DoNotOptimize(ok);
+    }
+}
+
+/** What decoding the same transaction costs before any check could run. */
+static void PolicyDecodeTransaction(benchmark::State& state)
+{
+    std::vector<unsigned char> data = SpamTransaction();
+    while (state.KeepRunning()) {
+        ByteReader r(data);
+        TransactionRef tx = ReadTransaction(r);
+        benchmark::DoNotOptimize(tx);
+    }
+}
+
+BENCHMARK(PolicyCheckSerialized);
+BENCHMARK(PolicyDecodeTransaction);
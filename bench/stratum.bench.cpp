@@ -0,0 +1,59 @@
+#include "bench.h"
+#include "../OneCoin/chainparams.h"
+#include "../OneCoin/merkle.h"
+#include "../OneCoin/stratum.h"
+
+#include <memory>
+#include <vector>
+
+static BlockTemplate BenchTemplate(const ChainParams& params)
+{
+    std::vector<TransactionRef> txs;
+    std::vector<Amount> fees;
+    for (uint32_t i = 0; i < 2000; i++) {
+        MutableTransaction tx;
+        tx.vin.push_back(TxIn(OutPoint(params.GenesisBlock().GetHash(), i)));
+        tx.vout.push_back(TxOut(COIN, Script() << OP_TRUE));
+        txs.push_back(MakeTransactionRef(tx));
+        fees.push_back(0);
+    }
+    return BlockAssembler(params).CreateNewBlock(params.GenesisBlock().GetHash(), 1, 0x1d00ffff, 0, 0,
+        Script() << OP_TRUE, txs, fees);
+}
+
+/** Share check against a job built once: midstate, branch fold, header hash. */
+static void StratumCheckShare(benchmark::State& state)
+{
+    std::unique_ptr<const ChainParams> params = CreateChainParams("main");
+    BlockTemplate tmpl = BenchTemplate(*params);
+    StratumJob job("1", tmpl, 4, 4);
+    const unsigned char en1[4] = {0, 0, 0, 1};
+    unsigned char en2[4] = {0, 0, 0, 0};
+    arith_uint256 target = arith_uint256::FromCompact(0x1d00ffff);
+    uint32_t nonce = 0;
+    while (state.KeepRunning()) {
+        StratumJob::ShareResult r = job.CheckShare(en1, en2, 0, nonce++, target, 0, NULL);
+        benchmark::DoNotOptimize(r);
+    }
+}
+
+/** The same check done by rebuilding the coinbase and the whole Merkle tree. */
+static void StratumCheckShareNaive(benchmark::State& state)
+{
+    std::unique_ptr<const ChainParams> params = CreateChainParams("main");
+    BlockTemplate tmpl = BenchTemplate(*params);
+    Block block = tmpl.block;
+    uint32_t nonce = 0;
+    while (state.KeepRunning()) {
+        std::vector<unsigned char> en(8, 0);
+        en[7] = (unsigned char)nonce;
+        block.vtx[0] = MakeTransactionRef(CreateCoinbase(1, tmpl.nCoinbaseValue, Script() << OP_TRUE, en));
+        block.hashMerkleRoot = BlockMerkleRoot(block);
+        block.nNonce = nonce++;
+        uint256 hash = block.GetHash();
+        benchmark::DoNotOptimize(hash);
+    }
+}
+
+BENCHMARK(StratumCheckShare);
+BENCHMARK(StratumCheckShareNaive);
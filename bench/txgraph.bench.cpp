@@ -0,0 +1,106 @@
+#include "bench.h"
+#include "../OneCoin/fs.h"
+#include "../OneCoin/txgraph.h"
+#include "../OneCoin/validation.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <random>
+
+namespace {
+
+/** Non-coinbase transactions in the benchmark block: a large block of
+ *  two-input payments, one in ten spending the one before it. */
+const size_t CONNECT_TXS = 2000;
+
+Block MakeConnectBlock(CoinsViewCache& coins)
+{
+    std::mt19937_64 rng(1);
+    Block block;
+    MutableTransaction coinbase;
+    coinbase.vin.push_back(TxIn(OutPoint()));
+    coinbase.vin[0].scriptSig = Script() << (int64_t)200 << OP_0;
+    coinbase.vout.push_back(TxOut(50 * COIN, Script() << OP_TRUE));
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+    for (size_t i = 0; i < CONNECT_TXS; i++) {
+        MutableTransaction tx;
+        for (int k = 0; k < 2; k++) {
+            OutPoint prevout;
+            if (k == 0 && i % 10 == 9) {
+                prevout = OutPoint(block.vtx[i]->GetHash(), 1);
+            } else {
+                unsigned char hash[32];
+                for (int j = 0; j < 32; j += 8) {
+                    uint64_t r = rng();
+                    memcpy(hash + j, &r, 8);
+                }
+                prevout = OutPoint(uint256(hash), 0);
+                coins.AddCoin(prevout, Coin(TxOut(COIN, Script() << OP_TRUE), 1, false), false);
+            }
+            tx.vin.push_back(TxIn(prevout));
+        }
+        tx.vout.push_back(TxOut(COIN / 2, Script() << OP_TRUE));
+        tx.vout.push_back(TxOut(COIN / 2, Script() << OP_TRUE));
+        block.vtx.push_back(MakeTransactionRef(tx));
+    }
+    return block;
+}
+
+/** ConnectBlock on a scratch view over a coins tip holding the inputs, as
+ *  when a block arrives; throughput in transactions. */
+void Connect(benchmark::State& state, unsigned int nThreads)
+{
+    char dir[] = "/tmp/onecoin_bench_XXXXXX";
+    if (!mkdtemp(dir))
+        return;
+    std::unique_ptr<const ChainParams> params = CreateChainParams("regtest");
+    {
+        Chainstate chainstate(*params, dir);
+        std::string error;
+        if (!chainstate.Load(error))
+            return;
+        chainstate.SetConnectThreads(nThreads);
+        Block block = MakeConnectBlock(chainstate.CoinsTip());
+        uint256 hash = block.GetHash();
+        BlockIndex index(block);
+        index.phashBlock = &hash;
+        index.nHeight = 200;
+        state.SetItemsPerIteration(CONNECT_TXS);
+        while (state.KeepRunning()) {
+            CoinsViewCache view(&chainstate.CoinsTip());
+            ValidationState vstate;
+            BlockUndo undo;
+            if (!chainstate.ConnectBlock(block, vstate, &index, view, undo)) {
+                fprintf(stderr, "ConnectBlock: %s\n", vstate.GetRejectReason().c_str());
+                break;
+            }
+        }
+    }
+    RemoveAll(dir);
+}
+
+} // namespace
+
+/** Dependency graph of a 2000-transaction block. */
+static void BlockTxGraphBuild(benchmark::State& state)
+{
+    CoinsViewMemory memory;
+    CoinsViewCache coins(&memory);
+    Block block = MakeConnectBlock(coins);
+    state.SetItemsPerIteration(CONNECT_TXS);
+    BlockTxGraph graph;
+    while (state.KeepRunning()) {
+        BuildBlockTxGraph(block.vtx, graph);
+        benchmark::DoNotOptimize(graph);
+    }
+}
+
+static void ConnectBlockSerial(benchmark::State& state) { Connect(state, 1); }
+/** Four connect threads, the graph build included; only faster with the
+ *  cores to run them. */
+static void ConnectBlockParallel(benchmark::State& state) { Connect(state, 4); }
+
+BENCHMARK(BlockTxGraphBuild);
+BENCHMARK(ConnectBlockSerial);
+BENCHMARK(ConnectBlockParallel);
@@ -0,0 +1,138 @@
+#include "bench.h"
+#include "../OneCoin/fs.h"
+#include "../OneCoin/key.h"
+#include "../OneCoin/miner.h"
+#include "../OneCoin/pow.h"
+#include "../OneCoin/sighash.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/** Mine-and-connect rate of regtest's generate, one block per iteration. */
+static void RegtestGenerate(benchmark::State& state)
+{
+    char dir[] = "/tmp/onecoin_bench_XXXXXX";
+    if (!mkdtemp(dir))
+        return;
+    std::unique_ptr<const ChainParams> params = CreateChainParams("regtest");
+    {
+        Chainstate chainstate(*params, dir);
+        std::string error;
+        if (!chainstate.Load(error))
+            return;
+        Script payout = Script() << OP_TRUE;
+        while (state.KeepRunning()) {
+            ValidationState vstate;
+            std::vector<uint256> hashes = GenerateBlocks(chainstate, payout, 1, vstate);
+            benchmark::DoNotOptimize(hashes);
+        }
+    }
+    RemoveAll(dir);
+}
+
+BENCHMARK(RegtestGenerate);
+
+namespace {
+
+/** Depth of the two forks the reorg benchmark flips between. */
+const int REORG_DEPTH = 100;
+/** Base blocks: enough mature coinbases for the forks to keep growing. */
+const int REORG_BASE = 700;
+
+/** Pays the base coinbases, so every fork spend carries a signature. */
+const Key& ForkKey()
+{
+    static Key key;
+    if (!key.IsValid()) {
+        unsigned char secret[32] = {1};
+        key.Set(secret);
+    }
+    return key;
+}
+
+Script ForkPayout()
+{
+    unsigned char hash[20];
+    ForkKey().GetPubKey().GetHash160(hash);
+    return GetScriptForPubKeyHash(hash);
+}
+
+/** Mines one block on pindexPrev spending the coinbase at height nFunding
+ *  into twenty P2SH outputs, so connecting and disconnecting move coins.
+ *  nFork tells the forks' otherwise identical blocks apart. */
+Block MineForkBlock(Chainstate& chainstate, const BlockIndex* pindexPrev, int nFunding, int nFork)
+{
+    const ChainParams& params = chainstate.GetParams();
+    Block funding;
+    chainstate.GetBlockStore().ReadBlock(pindexPrev->GetAncestor(nFunding)->blockPos, funding);
+    unsigned char hash[20] = {(unsigned char)nFunding, (unsigned char)nFork};
+    MutableTransaction tx;
+    tx.vin.push_back(TxIn(OutPoint(funding.vtx[0]->GetHash(), 0)));
+    for (int i = 0; i < 20; i++)
+        tx.vout.push_back(TxOut(COIN / 100, GetScriptForScriptHash(hash)));
+    uint256 sighash = SignatureHash(ForkPayout(), Transaction(tx), 0, SIGHASH_ALL);
+    std::vector<unsigned char> sig;
+    ForkKey().Sign(sighash, sig);
+    sig.push_back((unsigned char)SIGHASH_ALL);
+    tx.vin[0].scriptSig = Script() << sig << ForkKey().GetPubKey().Raw();
+    BlockTemplate tmpl = BlockAssembler(params).CreateNewBlock(pindexPrev->GetBlockHash(), pindexPrev->nHeight + 1,
+        GetNextWorkRequired(pindexPrev, params.GetConsensus()),
+        GetNextBlockTime(pindexPrev, params.GetConsensus(), time(NULL)), pindexPrev->GetMedianTimePast() + 1,
+        Script() << OP_TRUE, std::vector<TransactionRef>(1, MakeTransactionRef(tx)), std::vector<Amount>(1, 0));
+    while (!CheckProofOfWork(tmpl.block.GetHash(), tmpl.block.nBits, params.GetConsensus()))
+        tmpl.block.nNonce++;
+    return tmpl.block;
+}
+
+/** Adds blocks to a fork until it holds nLength. */
+bool GrowFork(Chainstate& chainstate, const BlockIndex*& pindexTip, int nForkHeight, int nLength, int nFork)
+{
+    while (pindexTip->nHeight - nForkHeight < nLength) {
+        Block block = MineForkBlock(chainstate, pindexTip, pindexTip->nHeight - nForkHeight + 1, nFork);
+        ValidationState state;
+        if (!chainstate.ProcessNewBlock(block, state))
+            return false;
+        pindexTip = chainstate.LookupBlockIndex(block.GetHash());
+    }
+    return true;
+}
+
+} // namespace
+
+/** Reorganizes between two forks of REORG_DEPTH blocks and more: each
+ *  iteration grows the losing fork by enough to take over, disconnecting
+ *  the whole winner. Throughput in blocks disconnected and connected. */
+static void ReorgFlip100(benchmark::State& state)
+{
+    char dir[] = "/tmp/onecoin_bench_XXXXXX";
+    if (!mkdtemp(dir))
+        return;
+    std::unique_ptr<const ChainParams> params = CreateChainParams("regtest");
+    {
+        Chainstate chainstate(*params, dir);
+        std::string error;
+        ValidationState vstate;
+        if (!chainstate.Load(error) ||
+            (int)GenerateBlocks(chainstate, ForkPayout(), REORG_BASE, vstate).size() != REORG_BASE)
+            return;
+        const BlockIndex* pindexFork = chainstate.Tip();
+        const BlockIndex* tips[2] = {pindexFork, pindexFork};
+        if (!GrowFork(chainstate, tips[0], REORG_BASE, REORG_DEPTH, 0) ||
+            !GrowFork(chainstate, tips[1], REORG_BASE, REORG_DEPTH, 1))
+            return;
+        state.SetItemsPerIteration(2 * REORG_DEPTH);
+        while (state.KeepRunning()) {
+            int nLoser = chainstate.Tip() == tips[0] ? 1 : 0;
+            int nLength = tips[1 - nLoser]->nHeight - REORG_BASE + 1;
+            if (nLength > REORG_BASE - COINBASE_MATURITY || !GrowFork(chainstate, tips[nLoser], REORG_BASE, nLength, nLoser) ||
+                chainstate.Tip() != tips[nLoser]) {
+                fprintf(stderr, "ReorgFlip100: fork did not take over\n");
+                break;
+            }
+        }
+    }
+    RemoveAll(dir);
+}
+
+BENCHMARK(ReorgFlip100);
@@ -0,0 +1,150 @@
+#include "../include/catch2/catch.hpp"
+#include "indexutil.h"
+#include "../OneCoin/addrindex.h"
+#include "../OneCoin/fs.h"
+#include "../OneCoin/merkle.h"
+#include "../OneCoin/miner.h"
+#include "../OneCoin/pow.h"
+#include "../OneCoin/validation.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+namespace {
+
+TransactionRef Pay(const OutPoint& prevout, const std::vector<TxOut>& outputs)
+{
+    MutableTransaction tx;
+    tx.vin.push_back(TxIn(prevout));
+    tx.vout = outputs;
+    return MakeTransactionRef(tx);
+}
+
+std::vector<AddrIndexEntry> History(const AddrIndex& addrindex, const Script& script)
+{
+    std::vector<AddrIndexEntry> entries;
+    addrindex.GetHistory(AddrIndex::GetScriptHash(script), entries);
+    return entries;
+}
+
+void RequireEntry(const AddrIndexEntry& entry, int nHeight, bool fSpend, const uint256& txid, uint32_t n,
+    Amount nValue)
+{
+    REQUIRE(entry.nHeight == nHeight);
+    REQUIRE(entry.fSpend == fSpend);
+    REQUIRE(entry.txid == txid);
+    REQUIRE(entry.n == n);
+    REQUIRE(entry.nValue == nValue);
+}
+
+} // namespace
+
+TEST_CASE( "ADDRESS INDEX RECORDS RECEIPTS AND SPENDS IN CHAIN ORDER", "[addrindex]" ) {
+    TempDir dir;
+    Chainstate chainstate(RegTestParams(), dir.path);
+    std::string error;
+    REQUIRE(chainstate.Load(error));
+    ValidationState state;
+    REQUIRE(GenerateBlocks(chainstate, Script() << OP_TRUE, COINBASE_MATURITY + 1, state).size() == 101);
+
+    Script scriptA = PushScript(0xaa), scriptB = PushScript(0xbb);
+    std::vector<TxOut> outputs;
+    outputs.push_back(TxOut(30 * COIN, scriptA));
+    outputs.push_back(TxOut(19 * COIN, scriptB));
+    TransactionRef tx1 = Pay(CoinbaseAt(chainstate, 1), outputs);
+    REQUIRE(chainstate.ProcessNewBlock(MineBlock(chainstate.Tip(), std::vector<TransactionRef>(1, tx1)), state));
+    TransactionRef tx2 = Pay(OutPoint(tx1->GetHash(), 0), std::vector<TxOut>(1, TxOut(29 * COIN, scriptA)));
+    REQUIRE(chainstate.ProcessNewBlock(MineBlock(chainstate.Tip(), std::vector<TransactionRef>(1, tx2)), state));
+    REQUIRE(chainstate.Height() == 103);
+
+    // The same entries whether a batch is split across threads or not.
+    AddrIndex serial(dir.path + "/indexes/serial", chainstate);
+    serial.SetThreads(1);
+    AddrIndex parallel(dir.path + "/indexes/parallel", chainstate);
+    parallel.SetThreads(4);
+    REQUIRE(parallel.GetThreads() == 4);
+    REQUIRE(serial.Start(error));
+    REQUIRE(parallel.Start(error));
+    RequireSynced(serial, chainstate);
+    RequireSynced(parallel, chainstate);
+
+    std::vector<AddrIndexEntry> history = History(parallel, scriptA);
+    REQUIRE(history.size() == 3);
+    RequireEntry(history[0], 102, false, tx1->GetHash(), 0, 30 * COIN);
+    // A transaction's inputs come before its outputs.
+    RequireEntry(history[1], 103, true, tx2->GetHash(), 0, 30 * COIN);
+    REQUIRE(history[1].prevout == OutPoint(tx1->GetHash(), 0));
+    RequireEntry(history[2], 103, false, tx2->GetHash(), 0, 29 * COIN);
+    REQUIRE(parallel.GetBalance(AddrIndex::GetScriptHash(scriptA)) == 29 * COIN);
+    REQUIRE(parallel.GetBalance(AddrIndex::GetScriptHash(scriptB)) == 19 * COIN);
+    REQUIRE(History(parallel, PushScript(0xcc)).empty());
+
+    // Every coinbase but the unspendable genesis one paid OP_TRUE, and the
+    // one at height 1 was spent.
+    std::vector<AddrIndexEntry> coinbases = History(parallel, Script() << OP_TRUE);
+    REQUIRE(coinbases.size() == 103 + 1);
+    REQUIRE(coinbases[0].nHeight == 1);
+    RequireEntry(coinbases[102], 102, true, tx1->GetHash(), 0, 50 * COIN);
+
+    const Script scripts[] = {scriptA, scriptB, Script() << OP_TRUE};
+    for (int i = 0; i < 3; i++) {
+        std::vector<AddrIndexEntry> a = History(serial, scripts[i]), b = History(parallel, scripts[i]);
+        REQUIRE(a.size() == b.size());
+        for (size_t j = 0; j < a.size(); j++) {
+            RequireEntry(b[j], a[j].nHeight, a[j].fSpend, a[j].txid, a[j].n, a[j].nValue);
+            REQUIRE(b[j].prevout == a[j].prevout);
+        }
+    }
+}
+
+TEST_CASE( "ADDRESS INDEX REMOVES THE ENTRIES OF DISCONNECTED BLOCKS", "[addrindex]" ) {
+    TempDir dir;
+    Chainstate chainstate(RegTestParams(), dir.path);
+    std::string error;
+    REQUIRE(chainstate.Load(error));
+    ValidationState state;
+    REQUIRE(GenerateBlocks(chainstate, Script() << OP_TRUE, COINBASE_MATURITY + 1, state).size() == 101);
+    Script scriptA = PushScript(0xaa);
+    TransactionRef tx1 = Pay(CoinbaseAt(chainstate, 1), std::vector<TxOut>(1, TxOut(49 * COIN, scriptA)));
+    REQUIRE(chainstate.ProcessNewBlock(MineBlock(chainstate.Tip(), std::vector<TransactionRef>(1, tx1)), state));
+    const BlockIndex* pindexFork = chainstate.Tip();
+    TransactionRef tx2 = Pay(OutPoint(tx1->GetHash(), 0), std::vector<TxOut>(1, TxOut(48 * COIN, PushScript(0xbb))));
+    Block blockSpend = MineBlock(pindexFork, std::vector<TransactionRef>(1, tx2));
+    REQUIRE(chainstate.ProcessNewBlock(blockSpend, state));
+
+    std::string indexDir = dir.path + "/indexes/addrindex";
+    {
+        AddrIndex addrindex(indexDir, chainstate);
+        REQUIRE(addrindex.Start(error));
+        RequireSynced(addrindex, chainstate);
+        REQUIRE(History(addrindex, scriptA).size() == 2);
+        REQUIRE(addrindex.GetBalance(AddrIndex::GetScriptHash(scriptA)) == 0);
+
+        // A longer branch without the spend.
+        Block block1 = MineBlock(pindexFork, std::vector<TransactionRef>());
+        REQUIRE(chainstate.ProcessNewBlock(block1, state));
+        Block block2 = MineBlock(chainstate.LookupBlockIndex(block1.GetHash()), std::vector<TransactionRef>());
+        REQUIRE(chainstate.ProcessNewBlock(block2, state));
+        REQUIRE(chainstate.Tip()->GetBlockHash() == block2.GetHash());
+        RequireSynced(addrindex, chainstate);
+        REQUIRE(History(addrindex, scriptA).size() == 1);
+        REQUIRE(addrindex.GetBalance(AddrIndex::GetScriptHash(scriptA)) == 49 * COIN);
+        REQUIRE(History(addrindex, PushScript(0xbb)).empty());
+    }
+
+    // Back to the spending branch while stopped: the next start rolls the
+    // stale blocks back before indexing the new ones.
+    const BlockIndex* pindex = chainstate.LookupBlockIndex(blockSpend.GetHash());
+    for (int i = 0; i < 2; i++) {
+        Block block = MineBlock(pindex, std::vector<TransactionRef>());
+        REQUIRE(chainstate.ProcessNewBlock(block, state));
+        pindex = chainstate.LookupBlockIndex(block.GetHash());
+    }
+    REQUIRE(chainstate.Tip() == pindex);
+    AddrIndex addrindex(indexDir, chainstate);
+    REQUIRE(addrindex.Start(error));
+    RequireSynced(addrindex, chainstate);
+    REQUIRE(History(addrindex, scriptA).size() == 2);
+    REQUIRE(History(addrindex, PushScript(0xbb)).size() == 1);
+    REQUIRE(History(addrindex, Script() << OP_TRUE).size() == 105 + 1);
+}
@@ -0,0 +1,248 @@
+#include "../include/catch2/catch.hpp"
+#include "../OneCoin/arith_uint256.h"
+#include "../OneCoin/headersync.h"
+#include "../OneCoin/pow.h"
+
+#include <stdlib.h>
+#include <new>
+#include <vector>
+
+// Counts heap allocations so tests can assert a code path does none.
+static size_t g_allocations = 0;
+
+void* operator new(size_t size)
+{
+    g_allocations++;
+    void* p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+static_assert(arith_uint256::FromCompact(0x1d00ffff).GetLimb(3) == 0x00000000ffff0000ULL, "compact decode");
+static_assert(arith_uint256::FromCompact(0x1d00ffff).GetLimb(2) == 0, "compact decode");
+static_assert(arith_uint256::FromCompact(0x207fffff).GetLimb(3) == 0x7fffff0000000000ULL, "compact decode");
+static_assert(arith_uint256::FromCompact(0x04123456).GetLow64() == 0x12345600, "compact decode");
+static_assert(arith_uint256::FromCompact(0x02123456).GetLow64() == 0x1234, "compact decode");
+static_assert(arith_uint256::CompactOverflows(0xff123456), "compact overflow");
+static_assert(arith_uint256::CompactIsNegative(0x04923456), "compact sign");
+
+namespace {
+
+ConsensusParams MainParams()
+{
+    ConsensusParams params;
+    params.powLimit = UintToArith256(uint256::FromHex("00000000ffffffffffffffffffffffffffffffffffffffffffffffffffffffff"));
+    params.nPowTargetSpacing = 10 * 60;
+    params.nPowTargetTimespan = 14 * 24 * 60 * 60;
+    params.fPowNoRetargeting = false;
+    return params;
+}
+
+ConsensusParams EasyParams(bool fNoRetargeting)
+{
+    ConsensusParams params;
+    params.powLimit = arith_uint256::FromCompact(0x207fffff);
+    params.nPowTargetSpacing = 1;
+    params.nPowTargetTimespan = 8;
+    params.fPowNoRetargeting = fNoRetargeting;
+    return params;
+}
+
+void Mine(BlockHeader& header, const ConsensusParams& params)
+{
+    while (!CheckProofOfWork(header.GetHash(), header.nBits, params))
+        header.nNonce++;
+}
+
+}
+
+TEST_CASE( "ARITH COMPACT ENCODING", "[arith]" ) {
+    struct Vector { uint32_t nCompact; uint64_t low; bool negative; bool overflow; uint32_t roundtrip; };
+    const Vector vectors[] = {
+        {0x00000000, 0, false, false, 0},
+        {0x00123456, 0, false, false, 0},
+        {0x01003456, 0, false, false, 0},
+        {0x02000056, 0, false, false, 0},
+        {0x03000000, 0, false, false, 0},
+        {0x04000000, 0, false, false, 0},
+        {0x00923456, 0, false, false, 0},
+        {0x01803456, 0, false, false, 0},
+        {0x01123456, 0x12, false, false, 0x01120000},
+        {0x02123456, 0x1234, false, false, 0x02123400},
+        {0x03123456, 0x123456, false, false, 0x03123456},
+        {0x04123456, 0x12345600, false, false, 0x04123456},
+        {0x04923456, 0x12345600, true, false, 0x04923456},
+        {0x05009234, 0x92340000, false, false, 0x05009234},
+        {0x01fedcba, 0x7e, true, false, 0x01fe0000},
+    };
+    for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+        const Vector& v = vectors[i];
+        bool negative, overflow;
+        arith_uint256 n;
+        n.SetCompact(v.nCompact, &negative, &overflow);
+        REQUIRE(n == arith_uint256(v.low));
+        REQUIRE(negative == v.negative);
+        REQUIRE(overflow == v.overflow);
+        REQUIRE(n.GetCompact(negative) == v.roundtrip);
+    }
+
+    bool negative, overflow;
+    arith_uint256 n;
+    n.SetCompact(0x20123456, &negative, &overflow);
+    REQUIRE(n == arith_uint256(0x123456) << 8 * 29);
+    REQUIRE(n.GetCompact() == 0x20123456);
+    n.SetCompact(0xff123456, &negative, &overflow);
+    REQUIRE(overflow);
+}
+
+TEST_CASE( "ARITH OPERATIONS", "[arith]" ) {
+    arith_uint256 max = ~arith_uint256();
+    REQUIRE(max + 1 == 0);
+    REQUIRE(arith_uint256() - 1 == max);
+    REQUIRE(max.bits() == 256);
+    REQUIRE(arith_uint256(1).bits() == 1);
+    REQUIRE((arith_uint256(1) << 255).bits() == 256);
+    REQUIRE((arith_uint256(1) << 255) >> 255 == 1);
+    REQUIRE((arith_uint256(0xffffffffffffffffULL) << 64) == arith_uint256(0, 0xffffffffffffffffULL, 0, 0));
+
+    arith_uint256 a(0x0123456789abcdefULL, 0xfedcba9876543210ULL, 0x1111111111111111ULL, 0x0fffffffffffffffULL);
+    arith_uint256 b(0x9999999999999999ULL, 0x8888888888888888ULL, 0, 0);
+    REQUIRE((a + b) - b == a);
+    REQUIRE((a * b) / b != a); // truncated
+    REQUIRE(((a >> 128) * b) / b == a >> 128);
+    REQUIRE(a / a == 1);
+    REQUIRE(a / (a + 1) == 0);
+    REQUIRE(a / 0 == 0);
+    REQUIRE((a * 1000u) / arith_uint256(1000) == (a * 1000u) / 1000);
+    REQUIRE(arith_uint256(7) * 6u == 42);
+
+    REQUIRE(a > b);
+    REQUIRE(b < a);
+    REQUIRE(a >= a);
+    REQUIRE(a <= a);
+    REQUIRE(!(a < a));
+    REQUIRE(a.CompareTo(b) == 1);
+    REQUIRE(b.CompareTo(a) == -1);
+    REQUIRE(a.CompareTo(a) == 0);
+    // Ordering decided by the low limb only after equal high limbs.
+    REQUIRE(arith_uint256(1, 0, 0, 5) < arith_uint256(2, 0, 0, 5));
+    REQUIRE(arith_uint256(9, 0, 0, 4) < arith_uint256(2, 0, 0, 5));
+
+    REQUIRE(UintToArith256(ArithToUint256(a)) == a);
+    uint256 h = uint256::FromHex("000000000019d6689c085ae165831e934ff763ae46a2a6c172b3f1b60a8ce26f");
+    REQUIRE(h.GetHex() == "000000000019d6689c085ae165831e934ff763ae46a2a6c172b3f1b60a8ce26f");
+    REQUIRE(UintToArith256(h).GetHex() == h.GetHex());
+    REQUIRE(UintToArith256(h).bits() == 256 - 43);
+}
+
+TEST_CASE( "POW BLOCK PROOF AND RETARGET", "[arith]" ) {
+    REQUIRE(GetBlockProof(0x1d00ffff) == arith_uint256(0x100010001ULL));
+    REQUIRE(GetBlockProof(0) == 0);
+    REQUIRE(GetBlockProof(0x04923456) == 0);
+    REQUIRE(GetDifficulty(0x1d00ffff) == 1.0);
+
+    ConsensusParams params = MainParams();
+    REQUIRE(CalculateNextWorkRequired(0x1d00ffff, 1261130161, 1262152739, params) == 0x1d00d86a);
+    REQUIRE(CalculateNextWorkRequired(0x1d00ffff, 1231006505, 1233061996, params) == 0x1d00ffff);
+    REQUIRE(CalculateNextWorkRequired(0x1c05a3f4, 1279008237, 1279297671, params) == 0x1c0168fd);
+    REQUIRE(CalculateNextWorkRequired(0x1c387f6f, 1263163443, 1269211443, params) == 0x1d00e1fd);
+
+    // The genesis block of the main chain.
+    BlockHeader genesis;
+    genesis.nVersion = 1;
+    genesis.hashMerkleRoot = uint256::FromHex("4a5e1e4baab89f3a32518a88c31bc87f618f76673e2cc77ab2127b7afdeda33b");
+    genesis.nTime = 1231006505;
+    genesis.nBits = 0x1d00ffff;
+    genesis.nNonce = 2083236893;
+    REQUIRE(genesis.GetHash().GetHex() == "000000000019d6689c085ae165831e934ff763ae46a2a6c172b3f1b60a8ce26f");
+    REQUIRE(CheckProofOfWork(genesis.GetHash(), genesis.nBits, params));
+    genesis.nNonce++;
+    REQUIRE(!CheckProofOfWork(genesis.GetHash(), genesis.nBits, params));
+    REQUIRE(!CheckProofOfWork(uint256(), 0x207fffff, params)); // above powLimit
+}
+
+TEST_CASE( "HEADER SYNC DOES NOT ALLOCATE", "[arith]" ) {
+    ConsensusParams params = EasyParams(true);
+    HeaderSyncTip tip;
+    tip.nHeight = 0;
+    tip.nBits = 0x207fffff;
+    tip.nTime = 1000;
+    tip.nPeriodStartTime = 1000;
+    tip.nChainWork = GetBlockProof(tip.nBits);
+
+    const size_t count = 2000;
+    std::vector<unsigned char> raw(count * BlockHeader::SIZE);
+    BlockHeader header;
+    uint256 prev = tip.hash;
+    for (size_t i = 0; i < count; i++) {
+        header.hashPrevBlock = prev;
+        header.nTime = 1001 + i;
+        header.nBits = 0x207fffff;
+        header.nNonce = 0;
+        Mine(header, params);
+        header.Serialize(&raw[i * BlockHeader::SIZE]);
+        prev = header.GetHash();
+    }
+
+    HeaderSyncValidator validator(params, tip);
+    size_t processed = 0;
+    size_t before = g_allocations;
+    HeaderSyncValidator::Result result = validator.ProcessRaw(raw.data(), count, &processed);
+    size_t allocations = g_allocations - before;
+    REQUIRE(result == HeaderSyncValidator::HEADER_OK);
+    REQUIRE(allocations == 0);
+    REQUIRE(processed == count);
+    REQUIRE(validator.Tip().hash == prev);
+    REQUIRE(validator.Tip().nHeight == (int)count);
+    REQUIRE(validator.Tip().nChainWork == GetBlockProof(0x207fffff) * (uint32_t)(count + 1));
+}
+
+TEST_CASE( "HEADER SYNC REJECTS BAD HEADERS", "[arith]" ) {
+    ConsensusParams params = EasyParams(false);
+    HeaderSyncTip tip;
+    tip.nHeight = 0;
+    tip.nBits = 0x207fffff;
+    tip.nTime = 1000;
+    tip.nPeriodStartTime = 1000;
+    tip.nChainWork = 0;
+    HeaderSyncValidator validator(params, tip);
+
+    // Blocks arrive every half second, so the first retarget halves the target.
+    BlockHeader header;
+    for (int height = 1; height <= 8; height++) {
+        const HeaderSyncTip& cur = validator.Tip();
+        header.hashPrevBlock = cur.hash;
+        header.nTime = 1000 + height / 2;
+        header.nBits = height % 8 == 0 ? CalculateNextWorkRequired(cur.nBits, cur.nPeriodStartTime, cur.nTime, params) : cur.nBits;
+        header.nNonce = 0;
+        Mine(header, params);
+        REQUIRE(validator.Process(header) == HeaderSyncValidator::HEADER_OK);
+    }
+    REQUIRE(validator.Tip().nBits != 0x207fffff);
+    REQUIRE(arith_uint256().SetCompact(validator.Tip().nBits) < params.powLimit);
+
+    BlockHeader next;
+    next.hashPrevBlock = validator.Tip().hash;
+    next.nTime = 1010;
+    next.nBits = 0x207fffff;
+    Mine(next, params);
+    REQUIRE(validator.Process(next) == HeaderSyncValidator::HEADER_BAD_DIFFBITS);
+
+    next.nBits = validator.Tip().nBits;
+    next.hashPrevBlock = uint256();
+    REQUIRE(validator.Process(next) == HeaderSyncValidator::HEADER_BAD_PREVBLK);
+
+    next.hashPrevBlock = validator.Tip().hash;
+    next.nNonce = 0;
+    while (CheckProofOfWork(next.GetHash(), next.nBits, params))
+        next.nNonce++;
+    REQUIRE(validator.Process(next) == HeaderSyncValidator::HEADER_HIGH_HASH);
+    Mine(next, params);
+    REQUIRE(validator.Process(next) == HeaderSyncValidator::HEADER_OK);
+}
@@ -0,0 +1,196 @@
+#include "../include/catch2/catch.hpp"
+#include "indexutil.h"
+#include "../OneCoin/blockfilter.h"
+#include "../OneCoin/blockfilterindex.h"
+#include "../OneCoin/fs.h"
+#include "../OneCoin/hash.h"
+#include "../OneCoin/merkle.h"
+#include "../OneCoin/miner.h"
+#include "../OneCoin/pow.h"
+#include "../OneCoin/validation.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+namespace {
+
+/** Elements of 1 to 40 pseudo-random bytes, distinct by their first four. */
+GCSElementSet RandomElements(size_t nCount, uint32_t nSeed)
+{
+    GCSElementSet elements(nCount);
+    uint32_t x = nSeed;
+    for (size_t i = 0; i < nCount; i++) {
+        std::vector<unsigned char>& element = elements[i];
+        element.push_back((unsigned char)(i >> 24));
+        element.push_back((unsigned char)(i >> 16));
+        element.push_back((unsigned char)(i >> 8));
+        element.push_back((unsigned char)i);
+        x = x * 1103515245 + 12345;
+        for (size_t n = x % 37; n > 0; n--) {
+            x = x * 1103515245 + 12345;
+            element.push_back((unsigned char)(x >> 16));
+        }
+    }
+    return elements;
+}
+
+/** Every block of the active chain has the filter computed from its data,
+ *  and each header commits to the one below it. */
+void RequireIndexed(const BlockFilterIndex& filterindex, Chainstate& chainstate)
+{
+    const ActiveChain& chain = chainstate.GetActiveChain();
+    uint256 prevHeader;
+    for (int nHeight = 0; nHeight <= chain.Height(); nHeight++) {
+        const BlockIndex* pindex = chain[nHeight];
+        Block block;
+        BlockUndo undo;
+        REQUIRE(chainstate.GetBlockStore().ReadBlock(pindex->blockPos, block));
+        if (nHeight > 0)
+            REQUIRE(chainstate.GetBlockStore().ReadUndo(pindex->undoPos, pindex->GetBlockHash(), undo));
+        BlockFilter expected(block, undo);
+        BlockFilter filter;
+        uint256 header;
+        REQUIRE(filterindex.GetFilter(pindex->GetBlockHash(), filter));
+        REQUIRE(filterindex.GetFilterHeader(pindex->GetBlockHash(), header));
+        REQUIRE(filter.GetEncoded() == expected.GetEncoded());
+        REQUIRE(header == expected.ComputeHeader(prevHeader));
+        prevHeader = header;
+    }
+}
+
+} // namespace
+
+TEST_CASE( "SIPHASH MATCHES THE REFERENCE VECTORS", "[blockfilter]" ) {
+    const uint64_t k0 = 0x0706050403020100ULL, k1 = 0x0f0e0d0c0b0a0908ULL;
+    unsigned char data[64];
+    for (int i = 0; i < 64; i++)
+        data[i] = (unsigned char)i;
+    REQUIRE(SipHash(k0, k1, data, 0) == 0x726fdb47dd0e0e31ULL);
+    REQUIRE(SipHash(k0, k1, data, 8) == 0x93f5f5799a932462ULL);
+    REQUIRE(SipHash(k0, k1, data, 15) == 0xa129ca6149be45e5ULL);
+
+    // The batch agrees with one hash at a time, whether or not an item
+    // shares its length with three others.
+    GCSElementSet items;
+    for (size_t len = 0; len < 64; len++) {
+        for (size_t n = 0; n < len % 7; n++)
+            items.push_back(std::vector<unsigned char>(data, data + len));
+        items.push_back(std::vector<unsigned char>(data + 64 - len, data + 64));
+    }
+    std::vector<uint64_t> hashes(items.size());
+    SipHashBatch(k0, k1, items, hashes.data());
+    for (size_t i = 0; i < items.size(); i++)
+        REQUIRE(hashes[i] == SipHash(k0, k1, items[i].data(), items[i].size()));
+}
+
+TEST_CASE( "GCS FILTER MATCHES ITS ELEMENTS AND ROUND TRIPS", "[blockfilter]" ) {
+    GCSFilter::Params params(0x0123456789abcdefULL, 0xfedcba9876543210ULL);
+    GCSElementSet elements = RandomElements(1000, 1);
+    GCSFilter filter(params, elements);
+    REQUIRE(filter.GetN() == 1000);
+    // About P + 2 bits an element.
+    REQUIRE(filter.GetEncoded().size() < 1000 * (BASIC_FILTER_P + 3) / 8);
+    for (size_t i = 0; i < elements.size(); i++)
+        REQUIRE(filter.Match(elements[i]));
+
+    GCSFilter decoded(params, filter.GetEncoded());
+    REQUIRE(decoded.GetN() == 1000);
+    REQUIRE(decoded.MatchAny(elements));
+
+    // Others match at a rate of about 1 / M.
+    GCSElementSet others = RandomElements(20000, 2);
+    int nFalsePositives = 0;
+    for (size_t i = 0; i < others.size(); i++) {
+        others[i][0] = 0xff;
+        nFalsePositives += filter.Match(others[i]) ? 1 : 0;
+    }
+    REQUIRE(nFalsePositives < 5);
+    REQUIRE(filter.MatchAny(GCSElementSet(1, elements[500])) == true);
+    others.push_back(elements[999]);
+    REQUIRE(filter.MatchAny(others));
+
+    // Another key gives another filter.
+    GCSFilter other(GCSFilter::Params(1, 2), elements);
+    REQUIRE(other.GetEncoded() != filter.GetEncoded());
+
+    GCSFilter empty(params, GCSElementSet());
+    REQUIRE(empty.GetEncoded() == std::vector<unsigned char>(1, 0));
+    REQUIRE(!empty.Match(elements[0]));
+    REQUIRE_THROWS_AS(GCSFilter(params, std::vector<unsigned char>()), const SerializeError&);
+    // A truncated filter matches nothing past its end.
+    std::vector<unsigned char> truncated(filter.GetEncoded().begin(), filter.GetEncoded().begin() + 10);
+    REQUIRE(!GCSFilter(params, truncated).Match(elements[999]));
+}
+
+TEST_CASE( "BLOCK FILTER INDEX BUILDS, FOLLOWS AND SERVES FILTERS", "[blockfilter]" ) {
+    TempDir dir;
+    Chainstate chainstate(RegTestParams(), dir.path);
+    std::string error;
+    REQUIRE(chainstate.Load(error));
+    ValidationState state;
+    REQUIRE(GenerateBlocks(chainstate, Script() << OP_TRUE, COINBASE_MATURITY + 1, state).size() == 101);
+    MutableTransaction tx;
+    tx.vin.push_back(TxIn(CoinbaseAt(chainstate, 1)));
+    tx.vout.push_back(TxOut(20 * COIN, PushScript(0xaa)));
+    tx.vout.push_back(TxOut(29 * COIN, Script() << OP_RETURN));
+    TransactionRef pay = MakeTransactionRef(tx);
+    Block blockPay = MineBlock(chainstate.Tip(), std::vector<TransactionRef>(1, pay));
+    REQUIRE(chainstate.ProcessNewBlock(blockPay, state));
+
+    std::string indexDir = dir.path + "/indexes/blockfilter";
+    {
+        BlockFilterIndex filterindex(indexDir, chainstate);
+        REQUIRE(filterindex.Start(error));
+        RequireSynced(filterindex, chainstate);
+        RequireIndexed(filterindex, chainstate);
+
+        BlockFilter filter;
+        REQUIRE(filterindex.GetFilter(blockPay.GetHash(), filter));
+        REQUIRE(filter.GetFilter().Match(PushScript(0xaa)));
+        REQUIRE(filter.GetFilter().Match(Script() << OP_TRUE));
+        REQUIRE(!filter.GetFilter().Match(Script() << OP_RETURN));
+        REQUIRE(!filter.GetFilter().Match(PushScript(0xbb)));
+        // Both the new output and the spent coinbase pay OP_TRUE: one element.
+        REQUIRE(filter.GetFilter().GetN() == 2);
+        REQUIRE(!filterindex.GetFilter(uint256::FromHex("01"), filter));
+
+        // Ranges as light clients request them.
+        const BlockIndex* pindexStop = chainstate.Tip();
+        std::vector<BlockFilter> filters;
+        std::vector<uint256> hashes, headers;
+        REQUIRE(filterindex.GetFilterRange(90, pindexStop, filters));
+        REQUIRE(filterindex.GetFilterHashRange(90, pindexStop, hashes));
+        REQUIRE(filterindex.GetFilterHeaderRange(90, pindexStop, headers));
+        REQUIRE(filters.size() == 13);
+        REQUIRE(filters.back().GetBlockHash() == blockPay.GetHash());
+        REQUIRE(hashes.back() == filters.back().GetHash());
+        REQUIRE(headers[12] == filters[12].ComputeHeader(headers[11]));
+        REQUIRE(!filterindex.GetFilterRange(103, pindexStop, filters));
+        REQUIRE(!filterindex.GetFilterHashRange(-1, pindexStop, hashes));
+
+        // New blocks and a reorg are followed; the stale block keeps its
+        // filter.
+        const BlockIndex* pindexFork = chainstate.LookupBlockIndex(blockPay.hashPrevBlock);
+        Block block1 = MineBlock(pindexFork, std::vector<TransactionRef>());
+        REQUIRE(chainstate.ProcessNewBlock(block1, state));
+        Block block2 = MineBlock(chainstate.LookupBlockIndex(block1.GetHash()), std::vector<TransactionRef>());
+        REQUIRE(chainstate.ProcessNewBlock(block2, state));
+        REQUIRE(chainstate.Tip()->GetBlockHash() == block2.GetHash());
+        RequireSynced(filterindex, chainstate);
+        RequireIndexed(filterindex, chainstate);
+        REQUIRE(filterindex.GetFilter(blockPay.GetHash(), filter));
+    }
+
+    // A crash after appending to the filter file but before the store
+    // write leaves bytes the next start drops.
+    FILE* file = fopen((indexDir + "/fltr00000.dat").c_str(), "ab");
+    REQUIRE(file);
+    REQUIRE(fwrite("garbage", 1, 7, file) == 7);
+    fclose(file);
+    REQUIRE(GenerateBlocks(chainstate, Script() << OP_TRUE, 5, state).size() == 5);
+    BlockFilterIndex filterindex(indexDir, chainstate);
+    REQUIRE(filterindex.Start(error));
+    RequireSynced(filterindex, chainstate);
+    RequireIndexed(filterindex, chainstate);
+}
@@ -0,0 +1,55 @@
+#include "../include/catch2/catch.hpp"
+#include "../OneCoin/bloom.h"
+
+#include <string.h>
+#include <random>
+
+namespace {
+
+uint256 RandomHash(std::mt19937_64& rng)
+{
+    unsigned char hash[32];
+    for (int i = 0; i < 32; i += 8) {
+        uint64_t r = rng();
+        memcpy(hash + i, &r, 8);
+    }
+    return uint256(hash);
+}
+
+} // namespace
+
+TEST_CASE( "ROLLING BLOOM FILTER KEEPS THE RECENT AND FORGETS THE OLD", "[bloom]" ) {
+    std::mt19937_64 rng(6);
+    RollingBloomFilter filter(1000, 0.001);
+    std::vector<uint256> inserted;
+    for (int i = 0; i < 5000; i++) {
+        inserted.push_back(RandomHash(rng));
+        filter.Insert(inserted.back());
+        // The last thousand are always there.
+        for (size_t j = inserted.size() > 1000 ? inserted.size() - 1000 : 0; j < inserted.size(); j += 97)
+            REQUIRE(filter.Contains(inserted[j]));
+        REQUIRE(filter.Contains(inserted.back()));
+    }
+
+    // Early ones have rolled out.
+    size_t nRemembered = 0;
+    for (size_t i = 0; i < 1000; i++)
+        nRemembered += filter.Contains(inserted[i]);
+    REQUIRE(nRemembered < 10);
+
+    // False positives stay near the requested rate.
+    size_t nFalse = 0;
+    for (int i = 0; i < 100000; i++)
+        nFalse += filter.Contains(RandomHash(rng));
+    REQUIRE(nFalse < 300);
+
+    // Arbitrary byte strings work too.
+    const char* text = "rejected";
+    filter.Insert((const unsigned char*)text, strlen(text));
+    REQUIRE(filter.Contains((const unsigned char*)text, strlen(text)));
+
+    filter.Reset();
+    REQUIRE(!filter.Contains(inserted.back()));
+    REQUIRE(!filter.Contains((const unsigned char*)text, strlen(text)));
+    REQUIRE(filter.MemoryUsage() > 0);
+}
@@ -0,0 +1,145 @@
+#include "../include/catch2/catch.hpp"
+#include "../OneCoin/chain.h"
+
+#include <string.h>
+#include <deque>
+#include <random>
+#include <vector>
+
+namespace {
+
+/** A block tree without blocks: entries get distinct made-up hashes. */
+struct TestTree {
+    BlockIndexArena arena;
+    std::deque<uint256> hashes;
+
+    BlockIndex* Add(BlockIndex* pprev, uint32_t nTime)
+    {
+        BlockHeader header;
+        header.nTime = nTime;
+        BlockIndex* pindex = arena.Add(header);
+        unsigned char hash[32] = {};
+        uint64_t n = arena.size();
+        memcpy(hash, &n, sizeof(n));
+        hashes.push_back(uint256(hash));
+        pindex->phashBlock = &hashes.back();
+        if (pprev) {
+            pindex->pprev = pprev;
+            pindex->nHeight = pprev->nHeight + 1;
+            pindex->BuildSkip();
+        }
+        return pindex;
+    }
+
+    BlockIndex* Extend(BlockIndex* pindex, int nBlocks)
+    {
+        for (int i = 0; i < nBlocks; i++)
+            pindex = Add(pindex, (uint32_t)(pindex ? pindex->nTime + 600 : 1000));
+        return pindex;
+    }
+};
+
+const BlockIndex* WalkBack(const BlockIndex* pindex, int nHeight)
+{
+    while (pindex && pindex->nHeight > nHeight)
+        pindex = pindex->pprev;
+    return pindex;
+}
+
+} // namespace
+
+TEST_CASE( "SKIP LINKS FIND EVERY ANCESTOR", "[chain]" ) {
+    TestTree tree;
+    BlockIndex* genesis = tree.Extend(NULL, 1);
+    BlockIndex* main = tree.Extend(genesis, 20000);
+    std::vector<BlockIndex*> tips(1, main);
+    std::mt19937 rng(4);
+    for (int i = 0; i < 20; i++)
+        tips.push_back(tree.Extend(main->GetAncestor(rng() % 20000), rng() % 3000 + 1));
+    // Spans several arena chunks.
+    REQUIRE(tree.arena.size() > 2 * BlockIndexArena::CHUNK_SIZE);
+
+    for (int i = 0; i < 5000; i++) {
+        const BlockIndex* pindex = tips[rng() % tips.size()];
+        int nHeight = (int)(rng() % (pindex->nHeight + 1));
+        REQUIRE(pindex->GetAncestor(nHeight) == WalkBack(pindex, nHeight));
+    }
+    REQUIRE(main->GetAncestor(main->nHeight) == main);
+    REQUIRE(main->GetAncestor(0) == genesis);
+    REQUIRE(main->GetAncestor(-1) == NULL);
+    REQUIRE(main->GetAncestor(main->nHeight + 1) == NULL);
+
+    for (size_t a = 0; a < tips.size(); a++) {
+        for (size_t b = 0; b < tips.size(); b++) {
+            // The fork point by brute force: the highest shared ancestor.
+            const BlockIndex* pa = tips[a];
+            const BlockIndex* pb = WalkBack(tips[b], pa->nHeight);
+            pa = WalkBack(pa, pb->nHeight);
+            while (pa != pb) {
+                pa = pa->pprev;
+                pb = pb->pprev;
+            }
+            REQUIRE(LastCommonAncestor(tips[a], tips[b]) == pa);
+        }
+    }
+}
+
+TEST_CASE( "ACTIVE CHAIN FINDS FORKS AND BUILDS LOCATORS", "[chain]" ) {
+    TestTree tree;
+    BlockIndex* genesis = tree.Extend(NULL, 1);
+    BlockIndex* fork = tree.Extend(genesis, 1000);
+    BlockIndex* a = tree.Extend(fork, 500);
+    BlockIndex* b = tree.Extend(fork, 700);
+
+    ActiveChain chain;
+    REQUIRE(chain.Tip() == NULL);
+    REQUIRE(chain.Height() == -1);
+    REQUIRE(chain.FindFork(a) == NULL);
+    chain.SetTip(a);
+    REQUIRE(chain.Tip() == a);
+    REQUIRE(chain.Genesis() == genesis);
+    REQUIRE(chain.Height() == 1500);
+    for (int h = 0; h <= chain.Height(); h++)
+        REQUIRE(chain[h] == a->GetAncestor(h));
+    REQUIRE(chain[1501] == NULL);
+    REQUIRE(chain.Contains(fork));
+    REQUIRE(!chain.Contains(b));
+    REQUIRE(chain.Next(fork) == a->GetAncestor(1001));
+    REQUIRE(chain.Next(a) == NULL);
+    REQUIRE(chain.FindFork(b) == fork);
+    REQUIRE(chain.FindFork(a->GetAncestor(1200)) == a->GetAncestor(1200));
+
+    // Switching forks rewrites the heights past the fork point.
+    chain.SetTip(b);
+    REQUIRE(chain.Height() == 1700);
+    REQUIRE(chain.Contains(b->GetAncestor(1500)));
+    REQUIRE(!chain.Contains(a));
+    REQUIRE(chain.FindFork(a) == fork);
+    chain.SetTip(fork);
+    REQUIRE(chain.Tip() == fork);
+    REQUIRE(chain.Next(fork) == NULL);
+
+    // Ten single steps, then doubling, always ending at genesis; from a
+    // block off the chain too.
+    chain.SetTip(b);
+    const BlockIndex* starts[] = {b, a, genesis};
+    for (size_t s = 0; s < 3; s++) {
+        std::vector<uint256> locator = chain.GetLocator(starts[s]);
+        REQUIRE(locator.front() == starts[s]->GetBlockHash());
+        REQUIRE(locator.back() == genesis->GetBlockHash());
+        const BlockIndex* pindex = starts[s];
+        int nStep = 1;
+        for (size_t i = 0; i + 1 < locator.size(); i++) {
+            REQUIRE(locator[i] == pindex->GetBlockHash());
+            pindex = pindex->GetAncestor(std::max(pindex->nHeight - nStep, 0));
+            if (i + 1 > 10)
+                nStep *= 2;
+        }
+        REQUIRE(locator.size() < 40);
+    }
+    REQUIRE(chain.GetLocator() == chain.GetLocator(b));
+
+    REQUIRE(b->GetMedianTimePast() == b->GetAncestor(b->nHeight - 5)->GetBlockTime());
+    chain.SetTip(NULL);
+    REQUIRE(chain.Tip() == NULL);
+}
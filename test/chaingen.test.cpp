@@ -0,0 +1,195 @@
+#include "../include/catch2/catch.hpp"
+#include "util.h"
+#include "../OneCoin/chaingen.h"
+#include "../OneCoin/encoding.h"
+#include "../OneCoin/fs.h"
+#include "../OneCoin/hash.h"
+#include "../OneCoin/key.h"
+#include "../OneCoin/sighash.h"
+#include "../OneCoin/validation.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <string>
+
+namespace {
+
+/** Small enough to run in a second or two, long enough for every shape to
+ *  appear once the first coinbases mature at height 101. */
+ChainGenOptions SmallOptions()
+{
+    ChainGenOptions options;
+    options.seed = 7;
+    options.nHeight = 112;
+    options.nTxPerBlock = 20;
+    options.nMaxChainLength = 5;
+    options.nKeys = 16;
+    return options;
+}
+
+std::vector<std::vector<unsigned char> > Pushes(const Script& script)
+{
+    std::vector<std::vector<unsigned char> > pushes;
+    Script::const_iterator pc = script.begin();
+    opcodetype opcode;
+    std::vector<unsigned char> data;
+    while (pc < script.end() && script.GetOp(pc, opcode, &data)) {
+        if (opcode <= OP_PUSHDATA4)
+            pushes.push_back(data);
+    }
+    return pushes;
+}
+
+/** True when every signature in sigs verifies against one of pubkeys. */
+bool SignaturesVerify(const std::vector<std::vector<unsigned char> >& sigs,
+    const std::vector<std::vector<unsigned char> >& pubkeys, const uint256& hash)
+{
+    for (size_t i = 0; i < sigs.size(); i++) {
+        if (sigs[i].empty() || sigs[i].back() != SIGHASH_ALL)
+            return false;
+        std::vector<unsigned char> der(sigs[i].begin(), sigs[i].end() - 1);
+        bool ok = false;
+        for (size_t j = 0; j < pubkeys.size() && !ok; j++)
+            ok = PubKey(pubkeys[j]).Verify(hash, der);
+        if (!ok)
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+TEST_CASE( "KEY SIGNS DETERMINISTICALLY", "[chaingen]" ) {
+    unsigned char secret[32] = {0};
+    secret[31] = 1;
+    Key key;
+    REQUIRE(key.Set(secret));
+    REQUIRE(HexStr(key.GetPubKey().Raw()) == "0279be667ef9dcbbac55a06295ce870b07029bfcdb2dce28d959f2815b16f81798");
+
+    // RFC 6979 vector for key 1 and SHA-256("Satoshi Nakamoto").
+    const std::string msg = "Satoshi Nakamoto";
+    unsigned char hash[32];
+    Sha256Hash((const unsigned char*)msg.data(), msg.size(), hash);
+    std::vector<unsigned char> sig;
+    REQUIRE(key.Sign(uint256(hash), sig));
+    REQUIRE(HexStr(sig) == "3045022100934b1ea10a4b3c1757e2b0c017d0b6143ce3c9a7e6a4a49860d7a6ab210ee3d8"
+                           "02202442ce9d2b916064108014783e923ec36b49743e2ffa1c4496f01a512aafd9e5");
+    REQUIRE(key.GetPubKey().Verify(uint256(hash), sig));
+    hash[0] ^= 1;
+    REQUIRE(!key.GetPubKey().Verify(uint256(hash), sig));
+
+    unsigned char order[32];
+    REQUIRE(HexDecode("fffffffffffffffffffffffffffffffebaaedce6af48a03bbfd25e8cd0364141", 64, order));
+    REQUIRE(!key.Set(order));
+    memset(secret, 0, sizeof(secret));
+    REQUIRE(!key.Set(secret));
+}
+
+TEST_CASE( "CHAIN GENERATOR IS DETERMINISTIC AND REPLAYS", "[chaingen]" ) {
+    TempDir a, b;
+    ChainGenOptions options = SmallOptions();
+    ChainManifest manifest, again;
+    std::string error;
+    REQUIRE(ChainGenerator(RegTestParams(), options).Run(a.path, manifest, error));
+    REQUIRE(ChainGenerator(RegTestParams(), options).Run(b.path, again, error));
+    REQUIRE(!ChainGenerator(RegTestParams(), options).Run(a.path, again, error));
+
+    REQUIRE(manifest.nHeight == options.nHeight);
+    REQUIRE(manifest.tip == again.tip);
+    REQUIRE(manifest.files.size() == 1);
+    REQUIRE(manifest.files[0].sha256 == again.files[0].sha256);
+    for (int i = 0; i < SHAPE_COUNT; i++) {
+        INFO(ChainGenShapeName((ChainGenShape)i));
+        REQUIRE(manifest.nShapes[i] > 0);
+    }
+    REQUIRE(manifest.nDustOutputs > 0);
+
+    ChainManifest read;
+    REQUIRE(ReadChainManifest(a.path, read, error));
+    REQUIRE(read.tip == manifest.tip);
+    REQUIRE(read.options.seed == options.seed);
+    REQUIRE(read.nTransactions == manifest.nTransactions);
+    REQUIRE(read.nShapes[SHAPE_MULTISIG] == manifest.nShapes[SHAPE_MULTISIG]);
+    REQUIRE(VerifyChainDataset(a.path, read, error));
+
+    {
+        Chainstate chainstate(RegTestParams(), a.path);
+        REQUIRE(chainstate.Load(error));
+        REQUIRE(chainstate.Height() == options.nHeight);
+        REQUIRE(chainstate.Tip()->GetBlockHash() == manifest.tip);
+    }
+
+    // A different seed is a different chain.
+    TempDir c;
+    options.seed++;
+    REQUIRE(ChainGenerator(RegTestParams(), options).Run(c.path, again, error));
+    REQUIRE(again.tip != manifest.tip);
+
+    // Any change to the block files is caught.
+    FILE* file = fopen((a.path + "/blocks/blk00000.dat").c_str(), "r+b");
+    REQUIRE(file);
+    fseek(file, 1000, SEEK_SET);
+    int ch = fgetc(file);
+    fseek(file, 1000, SEEK_SET);
+    fputc(ch ^ 1, file);
+    fclose(file);
+    REQUIRE(!VerifyChainDataset(a.path, read, error));
+}
+
+TEST_CASE( "GENERATED SIGNATURES VERIFY", "[chaingen]" ) {
+    TempDir dir;
+    ChainManifest manifest;
+    std::string error;
+    REQUIRE(ChainGenerator(RegTestParams(), SmallOptions()).Run(dir.path, manifest, error));
+
+    Chainstate chainstate(RegTestParams(), dir.path);
+    REQUIRE(chainstate.Load(error));
+    std::map<uint256, TransactionRef> txs;
+    size_t nChecked[3] = {0, 0, 0};
+    for (int nHeight = 1; nHeight <= chainstate.Height(); nHeight++) {
+        const BlockIndex* pindex = chainstate.Tip()->GetAncestor(nHeight);
+        Block block;
+        REQUIRE(chainstate.GetBlockStore().ReadBlock(pindex->blockPos, block));
+        for (size_t t = 0; t < block.vtx.size(); t++) {
+            const Transaction& tx = *block.vtx[t];
+            txs[tx.GetHash()] = block.vtx[t];
+            // One input per transaction keeps the test quick.
+            if (tx.IsCoinBase())
+                continue;
+            const Script& scriptPubKey = txs.at(tx.vin[0].prevout.hash)->vout[tx.vin[0].prevout.n].scriptPubKey;
+            std::vector<std::vector<unsigned char> > pushes = Pushes(tx.vin[0].scriptSig);
+            REQUIRE(!pushes.empty());
+            if (scriptPubKey.IsPayToPubKeyHash()) {
+                REQUIRE(pushes.size() == 2);
+                unsigned char hash160[20];
+                Hash160(pushes[1].data(), pushes[1].size(), hash160);
+                REQUIRE(std::equal(hash160, hash160 + 20, scriptPubKey.begin() + 3));
+                uint256 hash = SignatureHash(scriptPubKey, tx, 0, SIGHASH_ALL);
+                REQUIRE(SignaturesVerify(std::vector<std::vector<unsigned char> >(1, pushes[0]),
+                    std::vector<std::vector<unsigned char> >(1, pushes[1]), hash));
+                nChecked[0]++;
+            } else if (scriptPubKey.IsPayToScriptHash()) {
+                // OP_0 <sig> <sig> <2-of-3 redeem script>
+                REQUIRE(pushes.size() == 4);
+                Script redeemScript(pushes[3]);
+                uint256 hash = SignatureHash(redeemScript, tx, 0, SIGHASH_ALL);
+                REQUIRE(SignaturesVerify(std::vector<std::vector<unsigned char> >(pushes.begin() + 1, pushes.begin() + 3),
+                    Pushes(redeemScript), hash));
+                nChecked[1]++;
+            } else {
+                // OP_0 <sig> against a bare 1-of-2.
+                REQUIRE(pushes.size() == 2);
+                REQUIRE(scriptPubKey.back() == OP_CHECKMULTISIG);
+                uint256 hash = SignatureHash(scriptPubKey, tx, 0, SIGHASH_ALL);
+                REQUIRE(SignaturesVerify(std::vector<std::vector<unsigned char> >(1, pushes[1]), Pushes(scriptPubKey), hash));
+                nChecked[2]++;
+            }
+        }
+    }
+    REQUIRE(nChecked[0] > 0);
+    REQUIRE(nChecked[1] > 0);
+    REQUIRE(nChecked[2] > 0);
+}
@@ -0,0 +1,278 @@
+#include "../include/catch2/catch.hpp"
+#include "util.h"
+#include "../OneCoin/batchread.h"
+#include "../OneCoin/coinsdb.h"
+#include "../OneCoin/fs.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+OutPoint RandomOutPoint(std::mt19937& rng)
+{
+    unsigned char hash[32];
+    for (int i = 0; i < 32; i++)
+        hash[i] = (unsigned char)rng();
+    return OutPoint(uint256(hash), rng() % 4);
+}
+
+Coin RandomCoin(std::mt19937& rng)
+{
+    std::vector<unsigned char> script(rng() % 40 + 1);
+    for (size_t i = 0; i < script.size(); i++)
+        script[i] = (unsigned char)rng();
+    // Unspendable outputs never enter the UTXO set.
+    script[0] = OP_DUP;
+    return Coin(TxOut(rng() % 1000000 + 1, Script(script)), rng() % 1000, rng() % 2 == 0);
+}
+
+bool SameCoin(const Coin& a, const Coin& b)
+{
+    return a.out == b.out && a.nHeight == b.nHeight && a.fCoinBase == b.fCoinBase;
+}
+
+} // namespace
+
+TEST_CASE( "BATCH READS MATCH THE FILE", "[coinsdb]" ) {
+    TempDir dir;
+    std::string path = dir.path + "/data";
+    std::mt19937 rng(5);
+    std::vector<unsigned char> data(1 << 20);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = (unsigned char)rng();
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    REQUIRE(fd >= 0);
+    REQUIRE(write(fd, data.data(), data.size()) == (ssize_t)data.size());
+
+    const BatchReader::Method methods[] = {BatchReader::READ_SERIAL, BatchReader::READ_THREADS, BatchReader::READ_IO_URING};
+    for (size_t m = 0; m < 3; m++) {
+        BatchReader reader(methods[m], 4);
+        INFO(BatchReader::MethodName(reader.GetMethod()));
+        // More requests than the ring holds at once.
+        std::vector<ReadRequest> requests(1000);
+        std::vector<unsigned char> buf(requests.size() * 100);
+        for (size_t i = 0; i < requests.size(); i++) {
+            requests[i].nSize = rng() % 100 + 1;
+            requests[i].nOffset = rng() % (data.size() - requests[i].nSize);
+            requests[i].data = &buf[i * 100];
+        }
+        REQUIRE(reader.Read(fd, requests));
+        for (size_t i = 0; i < requests.size(); i++)
+            REQUIRE(std::equal(requests[i].data, requests[i].data + requests[i].nSize, data.begin() + requests[i].nOffset));
+
+        // Reading past the end fails.
+        requests[500].nOffset = data.size() - 10;
+        requests[500].nSize = 20;
+        REQUIRE(!reader.Read(fd, requests));
+        REQUIRE(reader.Read(fd, std::vector<ReadRequest>()));
+    }
+    close(fd);
+}
+
+TEST_CASE( "COINS DATABASE MATCHES AN IN-MEMORY VIEW", "[coinsdb]" ) {
+    TempDir dir;
+    std::mt19937 rng(9);
+    CoinsViewDB db(dir.path + "/chainstate");
+    std::string error;
+    REQUIRE(db.Open(error));
+    db.SetCompactThreshold(4096);
+    CoinsViewMemory memory;
+    CoinsViewCache dbCache(&db), memoryCache(&memory);
+
+    std::vector<OutPoint> outpoints;
+    uint64_t nMaxFileSize = 0;
+    bool fCompacted = false;
+    for (int round = 0; round < 20; round++) {
+        // Grow the set, then shrink it until compaction kicks in.
+        for (int i = 0; i < 200; i++) {
+            if (outpoints.empty() || (rng() % 3 != 0) == (round < 10)) {
+                OutPoint outpoint = RandomOutPoint(rng);
+                Coin coin = RandomCoin(rng);
+                Coin copy = coin;
+                dbCache.AddCoin(outpoint, std::move(coin), false);
+                memoryCache.AddCoin(outpoint, std::move(copy), false);
+                outpoints.push_back(outpoint);
+            } else {
+                const OutPoint& outpoint = outpoints[rng() % outpoints.size()];
+                REQUIRE(dbCache.SpendCoin(outpoint) == memoryCache.SpendCoin(outpoint));
+            }
+        }
+        dbCache.SetBestBlock(uint256::FromHex("01"));
+        dbCache.Flush();
+        memoryCache.Flush();
+        REQUIRE(db.GetCoinCount() == memory.GetCoinCount());
+        REQUIRE(db.GetBestBlock() == uint256::FromHex("01"));
+        fCompacted |= db.FileSize() < nMaxFileSize;
+        nMaxFileSize = std::max(nMaxFileSize, db.FileSize());
+
+        // Batched and single lookups agree with the reference, spent and
+        // never-seen outpoints included.
+        std::vector<OutPoint> lookup(outpoints);
+        lookup.push_back(RandomOutPoint(rng));
+        std::vector<Coin> fromDB, fromMemory;
+        db.GetCoins(lookup, fromDB);
+        memory.GetCoins(lookup, fromMemory);
+        for (size_t i = 0; i < lookup.size(); i++) {
+            REQUIRE(SameCoin(fromDB[i], fromMemory[i]));
+            Coin coin;
+            REQUIRE(db.GetCoin(lookup[i], coin) == !fromMemory[i].IsSpent());
+            REQUIRE(db.HaveCoin(lookup[i]) == !fromMemory[i].IsSpent());
+        }
+
+        // A cache over the database fetches in batches too.
+        CoinsViewCache cold(&db);
+        cold.FetchCoins(lookup);
+        REQUIRE(cold.CacheSize() == db.GetCoinCount());
+        for (size_t i = 0; i < lookup.size(); i++)
+            REQUIRE(SameCoin(cold.AccessCoin(lookup[i]), fromMemory[i]));
+    }
+    REQUIRE(fCompacted);
+
+    // Opening starts afresh.
+    REQUIRE(db.Open(error));
+    REQUIRE(db.GetCoinCount() == 0);
+    REQUIRE(db.FileSize() == 0);
+}
+
+TEST_CASE( "LSM COINS VIEW MATCHES AN IN-MEMORY VIEW", "[coinsdb]" ) {
+    TempDir dir;
+    std::mt19937 rng(10);
+    LsmOptions options;
+    options.nMemtableBytes = 32 << 10;
+    options.nLevel1Bytes = 64 << 10;
+    options.nTargetFileBytes = 16 << 10;
+    CoinsViewLsm db(dir.path + "/chainstate", options);
+    std::string error;
+    REQUIRE(db.Open(error));
+    CoinsViewMemory memory;
+    CoinsViewCache dbCache(&db), memoryCache(&memory);
+
+    std::vector<OutPoint> outpoints;
+    for (int round = 0; round < 20; round++) {
+        for (int i = 0; i < 300; i++) {
+            if (outpoints.empty() || (rng() % 3 != 0) == (round < 10)) {
+                OutPoint outpoint = RandomOutPoint(rng);
+                Coin coin = RandomCoin(rng);
+                Coin copy = coin;
+                // Possible overwrites of coins the cache has not seen
+                // look them up to set FRESH, which the count relies on.
+                bool fOverwrite = rng() % 4 == 0;
+                dbCache.AddCoin(outpoint, std::move(coin), fOverwrite);
+                memoryCache.AddCoin(outpoint, std::move(copy), fOverwrite);
+                outpoints.push_back(outpoint);
+            } else {
+                const OutPoint& outpoint = outpoints[rng() % outpoints.size()];
+                REQUIRE(dbCache.SpendCoin(outpoint) == memoryCache.SpendCoin(outpoint));
+            }
+        }
+        dbCache.SetBestBlock(uint256::FromHex("02"));
+        dbCache.Flush();
+        memoryCache.Flush();
+        REQUIRE(db.GetCoinCount() == memory.GetCoinCount());
+        REQUIRE(db.GetBestBlock() == uint256::FromHex("02"));
+        for (size_t i = 0; i < outpoints.size(); i++) {
+            Coin fromDB, fromMemory;
+            REQUIRE(db.GetCoin(outpoints[i], fromDB) == memory.GetCoin(outpoints[i], fromMemory));
+            REQUIRE(SameCoin(fromDB, fromMemory));
+        }
+    }
+    REQUIRE(db.GetStore().GetStats().nFlushes > 0);
+
+    // Opening again keeps the coins.
+    size_t nCount = db.GetCoinCount();
+    REQUIRE(db.Open(error));
+    REQUIRE(db.GetCoinCount() == nCount);
+    REQUIRE(db.GetBestBlock() == uint256::FromHex("02"));
+}
+
+TEST_CASE( "LSM COINS VIEW COMES BACK AFTER A CRASH", "[coinsdb]" ) {
+    TempDir dir;
+    std::mt19937 rng(11);
+    LsmOptions options;
+    options.nMemtableBytes = 32 << 10;
+    CoinsViewMemory memory;
+    std::vector<OutPoint> outpoints;
+    uint256 hashBlock;
+    {
+        CoinsViewLsm db(dir.path + "/chainstate", options);
+        db.SetSyncWrites(true);
+        std::string error;
+        REQUIRE(db.Open(error));
+        for (int round = 0; round < 10; round++) {
+            CoinsViewCache dbCache(&db), memoryCache(&memory);
+            for (int i = 0; i < 200; i++) {
+                if (round == 0 || rng() % 3 != 0) {
+                    OutPoint outpoint = RandomOutPoint(rng);
+                    Coin coin = RandomCoin(rng);
+                    Coin copy = coin;
+                    dbCache.AddCoin(outpoint, std::move(coin), false);
+                    memoryCache.AddCoin(outpoint, std::move(copy), false);
+                    outpoints.push_back(outpoint);
+                } else {
+                    const OutPoint& outpoint = outpoints[rng() % outpoints.size()];
+                    REQUIRE(dbCache.SpendCoin(outpoint) == memoryCache.SpendCoin(outpoint));
+                }
+            }
+            hashBlock = RandomOutPoint(rng).hash;
+            dbCache.SetBestBlock(hashBlock);
+            dbCache.Flush();
+            memoryCache.Flush();
+        }
+        REQUIRE(db.GetStore().GetStats().nFlushes > 0);
+        // Gone without a flush of the store, so the last batches are only
+        // in its log.
+    }
+
+    CoinsViewLsm db(dir.path + "/chainstate", options);
+    std::string error;
+    REQUIRE(db.Open(error));
+    REQUIRE(db.GetBestBlock() == hashBlock);
+    REQUIRE(db.GetCoinCount() == memory.GetCoinCount());
+    for (size_t i = 0; i < outpoints.size(); i++) {
+        Coin fromDB, fromMemory;
+        REQUIRE(db.GetCoin(outpoints[i], fromDB) == memory.GetCoin(outpoints[i], fromMemory));
+        REQUIRE(SameCoin(fromDB, fromMemory));
+    }
+
+    // And the count carries on from there.
+    CoinsViewCache cache(&db);
+    for (size_t i = 0; i < outpoints.size(); i++)
+        cache.SpendCoin(outpoints[i]);
+    hashBlock = RandomOutPoint(rng).hash;
+    cache.SetBestBlock(hashBlock);
+    cache.Flush();
+    REQUIRE(db.GetCoinCount() == 0);
+    REQUIRE(db.Open(error));
+    REQUIRE(db.GetCoinCount() == 0);
+    REQUIRE(db.GetBestBlock() == hashBlock);
+}
+
+TEST_CASE( "STANDARD COINS ARE STORED COMPRESSED", "[coinsdb]" ) {
+    TempDir dir;
+    CoinsViewDB db(dir.path + "/chainstate");
+    std::string error;
+    REQUIRE(db.Open(error));
+    std::mt19937 rng(13);
+    CoinsViewCache cache(&db);
+    std::vector<OutPoint> outpoints;
+    for (int i = 0; i < 1000; i++) {
+        unsigned char hash160[20];
+        for (int j = 0; j < 20; j++)
+            hash160[j] = (unsigned char)rng();
+        outpoints.push_back(RandomOutPoint(rng));
+        cache.AddCoin(outpoints.back(), Coin(TxOut(COIN, GetScriptForPubKeyHash(hash160)), 100, false), false);
+    }
+    cache.Flush();
+    // A varint height, a one-byte amount and a type byte plus the hash,
+    // against 35 bytes uncompressed.
+    REQUIRE(db.FileSize() == 1000 * 24);
+    Coin coin;
+    REQUIRE(db.GetCoin(outpoints[0], coin));
+    REQUIRE(coin.out.scriptPubKey.IsPayToPubKeyHash());
+    REQUIRE(coin.out.nValue == COIN);
+}
@@ -0,0 +1,129 @@
+#include "../include/catch2/catch.hpp"
+#include "../OneCoin/compressor.h"
+#include "../OneCoin/undo.h"
+
+#include <random>
+#include <vector>
+
+namespace {
+
+std::vector<unsigned char> Compress(const Script& script)
+{
+    std::vector<unsigned char> out;
+    ByteWriter w(out);
+    WriteCompressedScript(w, script);
+    return out;
+}
+
+Script Decompress(const std::vector<unsigned char>& data)
+{
+    ByteReader r(data);
+    Script script;
+    ReadCompressedScript(r, script);
+    REQUIRE(r.Empty());
+    return script;
+}
+
+} // namespace
+
+TEST_CASE( "AMOUNTS COMPRESS AND ROUND TRIP", "[compressor]" ) {
+    REQUIRE(CompressAmount(0) == 0);
+    REQUIRE(CompressAmount(1) == 0x1);
+    REQUIRE(CompressAmount(1000000) == 0x7);
+    REQUIRE(CompressAmount(COIN) == 0x9);
+    REQUIRE(CompressAmount(50 * COIN) == 0x32);
+    REQUIRE(CompressAmount(21000000 * COIN) == 0x1406f40);
+
+    std::mt19937_64 rng(7);
+    for (int i = 0; i < 100000; i++) {
+        uint64_t n = i < 1000 ? (uint64_t)i : rng() % (MAX_MONEY + 1);
+        if (i % 3 == 0)
+            n -= n % 100000;
+        REQUIRE(DecompressAmount(CompressAmount(n)) == n);
+    }
+
+    std::vector<unsigned char> out;
+    ByteWriter w(out);
+    w.WriteVarInt(CompressAmount(50 * COIN));
+    REQUIRE(out.size() == 1);
+}
+
+TEST_CASE( "SCRIPT TEMPLATES SHRINK TO THEIR PAYLOAD", "[compressor]" ) {
+    unsigned char hash[20];
+    for (int i = 0; i < 20; i++)
+        hash[i] = (unsigned char)(i * 7);
+    Script p2pkh = GetScriptForPubKeyHash(hash);
+    Script p2sh = GetScriptForScriptHash(hash);
+    std::vector<unsigned char> pubkey(33, 0xab);
+    pubkey[0] = 0x03;
+    Script p2pk = Script() << pubkey << OP_CHECKSIG;
+    std::vector<unsigned char> uncompressed(65, 0xcd);
+    uncompressed[0] = 0x04;
+    Script p2pkLong = Script() << uncompressed << OP_CHECKSIG;
+
+    REQUIRE(Compress(p2pkh).size() == 21);
+    REQUIRE(Compress(p2sh).size() == 21);
+    REQUIRE(Compress(p2pk).size() == 33);
+    REQUIRE(Compress(p2pkLong).size() == 1 + p2pkLong.size());
+    REQUIRE(Compress(Script()).size() == 1);
+    REQUIRE(Compress(Script() << OP_TRUE).size() == 2);
+
+    REQUIRE(Decompress(Compress(p2pkh)) == p2pkh);
+    REQUIRE(Decompress(Compress(p2sh)) == p2sh);
+    REQUIRE(Decompress(Compress(p2pk)) == p2pk);
+    REQUIRE(Decompress(Compress(p2pkLong)) == p2pkLong);
+    REQUIRE(Decompress(Compress(Script())) == Script());
+
+    // Lookalikes are stored whole.
+    Script notP2pk(p2pk);
+    notP2pk[1] = 0x05;
+    REQUIRE(Compress(notP2pk).size() == 1 + notP2pk.size());
+    REQUIRE(Decompress(Compress(notP2pk)) == notP2pk);
+
+    std::mt19937 rng(3);
+    for (int i = 0; i < 2000; i++) {
+        std::vector<unsigned char> bytes(rng() % 300);
+        for (size_t j = 0; j < bytes.size(); j++)
+            bytes[j] = (unsigned char)rng();
+        Script script(bytes);
+        REQUIRE(Decompress(Compress(script)) == script);
+    }
+
+    // Unknown types and truncated scripts are errors.
+    std::vector<unsigned char> bad(1, 4);
+    REQUIRE_THROWS_AS(Decompress(bad), const SerializeError&);
+    bad = Compress(p2pkLong);
+    bad.pop_back();
+    REQUIRE_THROWS_AS(Decompress(bad), const SerializeError&);
+}
+
+TEST_CASE( "UNDO DATA USES COMPRESSED COINS", "[compressor]" ) {
+    unsigned char hash[20] = {1, 2, 3};
+    BlockUndo undo;
+    undo.vtxundo.resize(3);
+    for (size_t i = 0; i < undo.vtxundo.size(); i++) {
+        for (size_t j = 0; j <= i; j++) {
+            Coin coin(TxOut((Amount)(j + 1) * COIN / 10, GetScriptForPubKeyHash(hash)), (int)(1000 * i + j), j == 0);
+            undo.vtxundo[i].vprevout.push_back(coin);
+        }
+    }
+    std::vector<unsigned char> data;
+    ByteWriter w(data);
+    SerializeBlockUndo(w, undo);
+    // Counts, then height, amount and a 21-byte script per coin.
+    REQUIRE(data.size() <= 4 + 6 * (3 + 1 + 21));
+
+    BlockUndo read;
+    ByteReader r(data);
+    UnserializeBlockUndo(r, read);
+    REQUIRE(r.Empty());
+    REQUIRE(read.vtxundo.size() == undo.vtxundo.size());
+    for (size_t i = 0; i < undo.vtxundo.size(); i++) {
+        REQUIRE(read.vtxundo[i].vprevout.size() == undo.vtxundo[i].vprevout.size());
+        for (size_t j = 0; j < undo.vtxundo[i].vprevout.size(); j++) {
+            const Coin& a = read.vtxundo[i].vprevout[j];
+            const Coin& b = undo.vtxundo[i].vprevout[j];
+            REQUIRE((a.out == b.out && a.nHeight == b.nHeight && a.fCoinBase == b.fCoinBase));
+        }
+    }
+}
@@ -0,0 +1,51 @@
+#include "../include/catch2/catch.hpp"
+#include "../OneCoin/crc32c.h"
+
+#include <string.h>
+#include <vector>
+
+TEST_CASE( "CRC32C MATCHES THE REFERENCE VECTORS", "[crc32c]" ) {
+    // RFC 3720, appendix B.4.
+    unsigned char data[32];
+    memset(data, 0, sizeof(data));
+    REQUIRE(Crc32c(data, sizeof(data)) == 0x8a9136aa);
+    memset(data, 0xff, sizeof(data));
+    REQUIRE(Crc32c(data, sizeof(data)) == 0x62a8ab43);
+    for (int i = 0; i < 32; i++)
+        data[i] = (unsigned char)i;
+    REQUIRE(Crc32c(data, sizeof(data)) == 0x46dd794e);
+    for (int i = 0; i < 32; i++)
+        data[i] = (unsigned char)(31 - i);
+    REQUIRE(Crc32c(data, sizeof(data)) == 0x113fdb5c);
+    REQUIRE(Crc32c((const unsigned char*)"123456789", 9) == 0xe3069283);
+    REQUIRE(Crc32c(data, 0) == 0);
+}
+
+TEST_CASE( "CRC32C IS THE SAME ON EVERY PATH AND IN PIECES", "[crc32c]" ) {
+    // Long enough for the hardware path's three-stream loops, at lengths
+    // around their edges and at unaligned starts.
+    std::vector<unsigned char> data(3 * 8192 * 2 + 1000);
+    uint32_t x = 1;
+    for (size_t i = 0; i < data.size(); i++) {
+        x = x * 1103515245 + 12345;
+        data[i] = (unsigned char)(x >> 16);
+    }
+    const size_t lengths[] = {0, 1, 7, 8, 9, 255, 767, 768, 769, 3 * 256 + 8, 24575, 24576, 24577, 49152 + 999};
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        for (size_t nStart = 0; nStart < 3; nStart++) {
+            const unsigned char* p = data.data() + nStart;
+            size_t len = lengths[i];
+            uint32_t crc = Crc32c(p, len);
+            REQUIRE(crc == Crc32cExtendPortable(0, p, len));
+            REQUIRE(crc == Crc32cExtend(Crc32c(p, len / 3), p + len / 3, len - len / 3));
+            REQUIRE(crc == Crc32cExtendPortable(Crc32cExtendPortable(0, p, len / 2), p + len / 2, len - len / 2));
+        }
+    }
+    // Any flipped bit changes it.
+    uint32_t crc = Crc32c(data.data(), data.size());
+    for (size_t nBit = 0; nBit < data.size() * 8; nBit += 997) {
+        data[nBit / 8] ^= (unsigned char)(1 << (nBit % 8));
+        REQUIRE(Crc32c(data.data(), data.size()) != crc);
+        data[nBit / 8] ^= (unsigned char)(1 << (nBit % 8));
+    }
+}
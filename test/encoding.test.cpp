@@ -0,0 +1,204 @@
+#include "../include/catch2/catch.hpp"
+#include "../OneCoin/encoding.h"
+
+#include <random>
+#include <string.h>
+
+namespace {
+
+std::vector<unsigned char> RandomBytes(std::mt19937& rng, size_t len)
+{
+    std::vector<unsigned char> v(len);
+    for (size_t i = 0; i < len; i++)
+        v[i] = (unsigned char)rng();
+    return v;
+}
+
+/** Random bytes with a run of leading zeros, which base58 treats specially. */
+std::vector<unsigned char> RandomPayload(std::mt19937& rng, size_t len)
+{
+    std::vector<unsigned char> v = RandomBytes(rng, len);
+    size_t zeros = len ? rng() % (len + 1) : 0;
+    if (rng() % 2)
+        zeros = std::min<size_t>(zeros, 2);
+    for (size_t i = 0; i < zeros; i++)
+        v[i] = 0;
+    return v;
+}
+
+}
+
+TEST_CASE( "HEX KNOWN VALUES", "[encoding]" ) {
+    const unsigned char data[] = {0x00, 0x01, 0x7f, 0x80, 0xab, 0xcd, 0xef, 0xff};
+    REQUIRE(HexStr(data, sizeof(data)) == "00017f80abcdefff");
+    REQUIRE(ParseHex("00017F80abCDefFF") == std::vector<unsigned char>(data, data + sizeof(data)));
+    REQUIRE(ParseHex("0g").empty());
+    REQUIRE(ParseHex("123").empty());
+    REQUIRE(IsHex("deadBEEF"));
+    REQUIRE(!IsHex("dead beef"));
+    REQUIRE(!IsHex(""));
+}
+
+TEST_CASE( "HEX ROUND TRIP FUZZ", "[encoding]" ) {
+    std::mt19937 rng(1);
+    // Cover every length around the 16-byte vector width and its tail handling.
+    for (size_t len = 0; len < 200; len++) {
+        std::vector<unsigned char> data = RandomBytes(rng, len);
+        std::string hex = HexStr(data);
+        REQUIRE(hex.size() == 2 * len);
+        for (size_t i = 0; i < len; i++) {
+            REQUIRE(hex[2 * i] == "0123456789abcdef"[data[i] >> 4]);
+            REQUIRE(hex[2 * i + 1] == "0123456789abcdef"[data[i] & 15]);
+        }
+        for (size_t i = 0; i < hex.size(); i++) {
+            if (rng() % 2 && hex[i] >= 'a')
+                hex[i] -= 'a' - 'A';
+        }
+        std::vector<unsigned char> back(len);
+        REQUIRE(HexDecode(hex.data(), hex.size(), back.data()));
+        REQUIRE(back == data);
+    }
+}
+
+TEST_CASE( "HEX DECODE REJECTS EVERY BAD CHARACTER", "[encoding]" ) {
+    std::mt19937 rng(2);
+    std::string hex = HexStr(RandomBytes(rng, 48));
+    std::vector<unsigned char> out(48);
+    for (int c = 0; c < 256; c++) {
+        bool valid = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+        std::string bad = hex;
+        // Put the character in the vector body and in the scalar tail.
+        bad[rng() % 32] = (char)c;
+        REQUIRE(HexDecode(bad.data(), bad.size(), out.data()) == valid);
+        bad = hex;
+        bad[90 + rng() % 6] = (char)c;
+        REQUIRE(HexDecode(bad.data(), bad.size(), out.data()) == valid);
+    }
+}
+
+TEST_CASE( "BASE58 KNOWN VALUES", "[encoding]" ) {
+    REQUIRE(EncodeBase58(ParseHex("")) == "");
+    REQUIRE(EncodeBase58(ParseHex("61")) == "2g");
+    REQUIRE(EncodeBase58(ParseHex("626262")) == "a3gV");
+    REQUIRE(EncodeBase58(ParseHex("516b6fcd0f")) == "ABnLTmg");
+    REQUIRE(EncodeBase58(ParseHex("00000000000000000000")) == "1111111111");
+    REQUIRE(EncodeBase58(ParseHex("00eb15231dfceb60925886b67d065299925915aeb172c06647")) ==
+            "1NS17iag9jJgTHD1VXjvLCEnZuQ3rJDE9L");
+    REQUIRE(EncodeBase58(ParseHex("ecac89cad93923c02321")) == "EJDM8drfXA6uyA");
+
+    std::vector<unsigned char> out;
+    REQUIRE(DecodeBase58("1NS17iag9jJgTHD1VXjvLCEnZuQ3rJDE9L", out));
+    REQUIRE(HexStr(out) == "00eb15231dfceb60925886b67d065299925915aeb172c06647");
+    REQUIRE(!DecodeBase58("0OIl", out));
+}
+
+TEST_CASE( "BASE58CHECK ADDRESS", "[encoding]" ) {
+    std::vector<unsigned char> payload = ParseHex("0065a16059864a2fdbc7c99a4723a8395bc6f188eb");
+    std::string addr = EncodeBase58Check(payload);
+    REQUIRE(addr == "1AGNa15ZQXAZUgFiqJ2i7Z2DPU2J6hW62i");
+
+    std::vector<unsigned char> out;
+    REQUIRE(DecodeBase58Check(addr, out));
+    REQUIRE(out == payload);
+    addr[5] = addr[5] == 'a' ? 'b' : 'a';
+    REQUIRE(!DecodeBase58Check(addr, out));
+}
+
+TEST_CASE( "BASE58 FIXED AND GENERIC PATHS AGREE", "[encoding]" ) {
+    std::mt19937 rng(3);
+    for (int i = 0; i < 5000; i++) {
+        std::vector<unsigned char> payload = RandomPayload(rng, BASE58_ADDRESS_PAYLOAD);
+        std::string fixed = EncodeBase58Address(payload.data());
+        REQUIRE(fixed == EncodeBase58(payload));
+
+        unsigned char back[BASE58_ADDRESS_PAYLOAD];
+        REQUIRE(DecodeBase58Address(fixed, back));
+        REQUIRE(memcmp(back, payload.data(), sizeof(back)) == 0);
+    }
+    // Strings for other payload lengths must not be accepted by the fixed path.
+    unsigned char back[BASE58_ADDRESS_PAYLOAD];
+    REQUIRE(!DecodeBase58Address(EncodeBase58(RandomBytes(rng, 24)), back));
+    REQUIRE(!DecodeBase58Address("1" + EncodeBase58Address(RandomPayload(rng, 25).data()), back));
+    REQUIRE(!DecodeBase58Address(std::string(36, 'z'), back));
+}
+
+TEST_CASE( "BASE58 ROUND TRIP FUZZ", "[encoding]" ) {
+    std::mt19937 rng(4);
+    for (int i = 0; i < 2000; i++) {
+        std::vector<unsigned char> data = RandomPayload(rng, rng() % 80);
+        std::vector<unsigned char> out;
+        REQUIRE(DecodeBase58(EncodeBase58(data), out));
+        REQUIRE(out == data);
+        REQUIRE(DecodeBase58Check(EncodeBase58Check(data), out));
+        REQUIRE(out == data);
+    }
+}
+
+TEST_CASE( "BECH32 KNOWN VALUES", "[encoding]" ) {
+    const char* valid_bech32[] = {
+        "A12UEL5L",
+        "a12uel5l",
+        "abcdef1qpzry9x8gf2tvdw0s3jn54khce6mua7lmqqqxw",
+        "11qqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqc8247j",
+        "split1checkupstagehandshakeupstreamerranterredcaperred2y9e3w",
+    };
+    for (size_t i = 0; i < sizeof(valid_bech32) / sizeof(valid_bech32[0]); i++)
+        REQUIRE(bech32::Decode(valid_bech32[i]).encoding == bech32::BECH32);
+
+    const char* valid_bech32m[] = {
+        "A1LQFN3A",
+        "abcdef1l7aum6echk45nj3s0wdvt2fg8x9yrzpqzd3ryx",
+        "split1checkupstagehandshakeupstreamerranterredcaperredlc445v",
+    };
+    for (size_t i = 0; i < sizeof(valid_bech32m) / sizeof(valid_bech32m[0]); i++)
+        REQUIRE(bech32::Decode(valid_bech32m[i]).encoding == bech32::BECH32M);
+
+    const char* invalid[] = {
+        "pzry9x0s0muk",
+        "1pzry9x0s0muk",
+        "x1b4n0q5v",
+        "li1dgmt3",
+        "A1G7SGD8",
+        "10a06t8",
+        "1qzzfhee",
+        "a12UEL5L",
+    };
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+        REQUIRE(bech32::Decode(invalid[i]).encoding == bech32::INVALID);
+}
+
+TEST_CASE( "BECH32 ADDRESSES", "[encoding]" ) {
+    int witver;
+    std::vector<uint8_t> program;
+    REQUIRE(bech32::DecodeAddress("bc", "bc1qw508d6qejxtdg4y5r3zarvary0c5xw7kv8f3t4", witver, program));
+    REQUIRE(witver == 0);
+    REQUIRE(HexStr(program) == "751e76e8199196d454941c45d1b3a323f1433bd6");
+    REQUIRE(bech32::EncodeAddress("bc", 0, program) == "bc1qw508d6qejxtdg4y5r3zarvary0c5xw7kv8f3t4");
+
+    // Version 1 programs must use Bech32m.
+    REQUIRE(bech32::DecodeAddress("bc", "bc1pw508d6qejxtdg4y5r3zarvary0c5xw7kw508d6qejxtdg4y5r3zarvary0c5xw7kt5nd6y", witver, program));
+    REQUIRE(witver == 1);
+    REQUIRE(!bech32::DecodeAddress("bc", "bc1p0xlxvlhemja6c4dqv22uapctqupfhlxm9h8z3k2e72q4k9hcz7vqh2y7hd", witver, program));
+    REQUIRE(!bech32::DecodeAddress("tb", "bc1qw508d6qejxtdg4y5r3zarvary0c5xw7kv8f3t4", witver, program));
+}
+
+TEST_CASE( "BECH32 ROUND TRIP FUZZ", "[encoding]" ) {
+    std::mt19937 rng(5);
+    for (int i = 0; i < 2000; i++) {
+        int witver = rng() % 17;
+        std::vector<uint8_t> program = RandomBytes(rng, witver == 0 ? (rng() % 2 ? 20 : 32) : 2 + rng() % 39);
+        std::string addr = bech32::EncodeAddress("oc", witver, program);
+
+        int ver;
+        std::vector<uint8_t> back;
+        REQUIRE(bech32::DecodeAddress("oc", addr, ver, back));
+        REQUIRE(ver == witver);
+        REQUIRE(back == program);
+
+        // Any single-character substitution must be caught by the checksum.
+        std::string bad = addr;
+        size_t pos = 3 + rng() % (bad.size() - 3);
+        bad[pos] = bad[pos] == 'q' ? 'p' : 'q';
+        REQUIRE(!bech32::DecodeAddress("oc", bad, ver, back));
+    }
+}
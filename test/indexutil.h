@@ -0,0 +1,55 @@
+#ifndef ONECOIN_TEST_INDEXUTIL_H
+#define ONECOIN_TEST_INDEXUTIL_H
+
+#include "util.h"
+#include "../include/catch2/catch.hpp"
+#include "../OneCoin/baseindex.h"
+#include "../OneCoin/merkle.h"
+#include "../OneCoin/miner.h"
+#include "../OneCoin/pow.h"
+#include "../OneCoin/validation.h"
+
+#include <time.h>
+#include <string>
+#include <vector>
+
+/** Fixtures shared by the tests of the indexes that follow a chainstate. */
+
+/** Mines a block with txs, each paying a fee of one coin, on top of
+ *  pindexPrev, one second after the time a block there would get, so
+ *  siblings differ. */
+inline Block MineBlock(const BlockIndex* pindexPrev, const std::vector<TransactionRef>& txs)
+{
+    const ConsensusParams& consensus = RegTestParams().GetConsensus();
+    BlockTemplate tmpl = BlockAssembler(RegTestParams()).CreateNewBlock(pindexPrev->GetBlockHash(),
+        pindexPrev->nHeight + 1, GetNextWorkRequired(pindexPrev, consensus),
+        GetNextBlockTime(pindexPrev, consensus, time(NULL)) + 1, pindexPrev->GetMedianTimePast() + 1,
+        Script() << OP_TRUE, txs, std::vector<Amount>(txs.size(), COIN));
+    tmpl.block.hashMerkleRoot = BlockMerkleRoot(tmpl.block);
+    while (!CheckProofOfWork(tmpl.block.GetHash(), tmpl.block.nBits, consensus))
+        tmpl.block.nNonce++;
+    return tmpl.block;
+}
+
+/** Scripts anyone can spend, each pushing a different byte. */
+inline Script PushScript(unsigned char c)
+{
+    return Script() << std::vector<unsigned char>(1, c);
+}
+
+inline OutPoint CoinbaseAt(Chainstate& chainstate, int nHeight)
+{
+    Block block;
+    REQUIRE(chainstate.GetBlockStore().ReadBlock(chainstate.GetActiveChain()[nHeight]->blockPos, block));
+    return OutPoint(block.vtx[0]->GetHash(), 0);
+}
+
+inline void RequireSynced(BaseIndex& index, const Chainstate& chainstate)
+{
+    std::string error;
+    REQUIRE(index.WaitForSync(error));
+    REQUIRE(index.IsSynced());
+    REQUIRE(index.BestHeight() == chainstate.Height());
+}
+
+#endif // ONECOIN_TEST_INDEXUTIL_H
@@ -0,0 +1,272 @@
+#include "../include/catch2/catch.hpp"
+#include "../OneCoin/encoding.h"
+#include "../OneCoin/hash.h"
+#include "../OneCoin/interpreter.h"
+#include "../OneCoin/key.h"
+#include "../OneCoin/sighash.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<unsigned char> Bytes(const std::string& str)
+{
+    return std::vector<unsigned char>(str.begin(), str.end());
+}
+
+struct ScriptCase {
+    Script scriptSig;
+    Script scriptPubKey;
+    ScriptError expected;
+};
+
+/** Runs both verifiers and requires them to agree; returns the error. */
+ScriptError Verify(const Script& scriptSig, const Script& scriptPubKey, const BaseSignatureChecker& checker,
+    unsigned int flags = MANDATORY_SCRIPT_VERIFY_FLAGS)
+{
+    ScriptError generic = SCRIPT_ERR_UNKNOWN_ERROR, fast = SCRIPT_ERR_UNKNOWN_ERROR;
+    bool fGeneric = VerifyScriptGeneric(scriptSig, scriptPubKey, flags, checker, &generic);
+    bool fFast = VerifyScript(scriptSig, scriptPubKey, flags, checker, &fast);
+    REQUIRE(fGeneric == fFast);
+    REQUIRE(ScriptErrorString(generic) == std::string(ScriptErrorString(fast)));
+    REQUIRE(fGeneric == (generic == SCRIPT_ERR_OK));
+    return generic;
+}
+
+Key MakeKey(unsigned char n)
+{
+    unsigned char secret[32] = {0};
+    secret[31] = n;
+    Key key;
+    key.Set(secret);
+    return key;
+}
+
+std::vector<unsigned char> SignInput(const Key& key, const Script& scriptCode, const Transaction& tx, unsigned int nIn)
+{
+    std::vector<unsigned char> sig;
+    key.Sign(SignatureHash(scriptCode, tx, nIn, SIGHASH_ALL), sig);
+    sig.push_back(SIGHASH_ALL);
+    return sig;
+}
+
+} // namespace
+
+TEST_CASE( "SCRIPT INTERPRETER OPCODES", "[interpreter]" ) {
+    std::vector<unsigned char> big520(520, 0x42), big521(521, 0x42);
+    unsigned char sha256[32], sha256d[32], hash160[20], ripemd160[20];
+    std::vector<unsigned char> abc = Bytes("abc");
+    Sha256Hash(abc.data(), abc.size(), sha256);
+    Sha256d(abc.data(), abc.size(), sha256d);
+    Hash160(abc.data(), abc.size(), hash160);
+    Ripemd160(abc.data(), abc.size(), ripemd160);
+
+    Script nops201, nops202, ones1000, ones1001;
+    nops201 << OP_1;
+    for (int i = 0; i < 201; i++)
+        nops201 << OP_NOP;
+    nops202 = nops201;
+    nops202 << OP_NOP;
+    for (int i = 0; i < 1000; i++)
+        ones1000 << OP_1;
+    ones1001 = ones1000;
+    ones1001 << OP_1;
+    Script truncated = Script() << OP_1;
+    truncated.push_back(OP_PUSHDATA1);
+    Script oversized(std::vector<unsigned char>(MAX_SCRIPT_SIZE + 1, OP_1));
+
+    Script redeem = Script() << OP_1 << OP_ADD << OP_3 << OP_EQUAL;
+    unsigned char redeemHash[20];
+    Hash160(redeem.data(), redeem.size(), redeemHash);
+    std::vector<unsigned char> redeemBytes(redeem.begin(), redeem.end());
+
+    const ScriptCase cases[] = {
+        {Script() << OP_1 << OP_2, Script() << OP_ADD << OP_3 << OP_EQUAL, SCRIPT_ERR_OK},
+        {Script() << OP_2, Script() << OP_3 << OP_SUB << OP_1NEGATE << OP_EQUAL, SCRIPT_ERR_OK},
+        {Script() << OP_16 << OP_16, Script() << OP_ADD << 32 << OP_NUMEQUAL, SCRIPT_ERR_OK},
+        {Script() << OP_5 << OP_9, Script() << OP_MAX << OP_9 << OP_NUMEQUALVERIFY << OP_1, SCRIPT_ERR_OK},
+        {Script() << OP_5 << OP_9, Script() << OP_MIN << OP_9 << OP_NUMEQUALVERIFY << OP_1, SCRIPT_ERR_NUMEQUALVERIFY},
+        {Script() << OP_2 << OP_1 << OP_3, Script() << OP_WITHIN, SCRIPT_ERR_OK},
+        {Script() << OP_3 << OP_1 << OP_3, Script() << OP_WITHIN, SCRIPT_ERR_EVAL_FALSE},
+        {Script() << std::vector<unsigned char>(1, 0x80), Script() << OP_NOT, SCRIPT_ERR_OK},
+        {Script() << std::vector<unsigned char>(1, 0x80), Script() << OP_1 << OP_BOOLAND, SCRIPT_ERR_EVAL_FALSE},
+        {Script() << std::vector<unsigned char>(5, 1), Script() << OP_1ADD, SCRIPT_ERR_NUM_OVERFLOW},
+        {Script() << 0x7fffffff, Script() << OP_1ADD << (int64_t)0x80000000LL << OP_EQUAL, SCRIPT_ERR_OK},
+        {Script() << -5, Script() << OP_ABS << OP_5 << OP_EQUAL, SCRIPT_ERR_OK},
+
+        {Script(), Script() << OP_1 << OP_IF << OP_2 << OP_ELSE << OP_3 << OP_ENDIF << OP_2 << OP_EQUAL, SCRIPT_ERR_OK},
+        {Script(), Script() << OP_0 << OP_NOTIF << OP_0 << OP_IF << OP_RETURN << OP_ELSE << OP_1 << OP_ENDIF
+                            << OP_ENDIF, SCRIPT_ERR_OK},
+        {Script() << OP_0, Script() << OP_IF << OP_RETURN << OP_ENDIF << OP_1, SCRIPT_ERR_OK},
+        {Script() << OP_1, Script() << OP_IF << OP_RETURN << OP_ENDIF << OP_1, SCRIPT_ERR_OP_RETURN},
+        {Script() << OP_0, Script() << OP_IF << OP_CAT << OP_ENDIF << OP_1, SCRIPT_ERR_DISABLED_OPCODE},
+        {Script() << OP_0, Script() << OP_IF << OP_VERIF << OP_ENDIF << OP_1, SCRIPT_ERR_BAD_OPCODE},
+        {Script() << OP_0, Script() << OP_IF << OP_RESERVED << OP_ENDIF << OP_1, SCRIPT_ERR_OK},
+        {Script() << OP_1, Script() << OP_IF, SCRIPT_ERR_UNBALANCED_CONDITIONAL},
+        {Script(), Script() << OP_1 << OP_ENDIF, SCRIPT_ERR_UNBALANCED_CONDITIONAL},
+        {Script(), Script() << OP_IF << OP_ENDIF << OP_1, SCRIPT_ERR_UNBALANCED_CONDITIONAL},
+        {Script() << OP_0, Script() << OP_VERIFY << OP_1, SCRIPT_ERR_VERIFY},
+        {Script() << OP_1, Script() << OP_VERIFY, SCRIPT_ERR_EVAL_FALSE},
+        {Script(), Script(), SCRIPT_ERR_EVAL_FALSE},
+
+        {Script() << OP_1 << OP_2 << OP_3, Script() << OP_ROT << OP_1 << OP_EQUALVERIFY << OP_3 << OP_EQUALVERIFY
+                                                   << OP_2 << OP_EQUAL, SCRIPT_ERR_OK},
+        {Script() << OP_1 << OP_2, Script() << OP_TUCK << OP_DEPTH << OP_3 << OP_EQUALVERIFY << OP_2
+                                           << OP_EQUALVERIFY << OP_1 << OP_EQUALVERIFY << OP_2 << OP_EQUAL, SCRIPT_ERR_OK},
+        {Script() << OP_1 << OP_2 << OP_3 << OP_2, Script() << OP_PICK << OP_1 << OP_EQUALVERIFY << OP_DEPTH << OP_3
+                                                           << OP_EQUAL, SCRIPT_ERR_OK},
+        {Script() << OP_1 << OP_2 << OP_3 << OP_2, Script() << OP_ROLL << OP_1 << OP_EQUALVERIFY << OP_DEPTH << OP_2
+                                                           << OP_EQUAL, SCRIPT_ERR_OK},
+        {Script() << OP_1 << OP_2, Script() << OP_2 << OP_PICK, SCRIPT_ERR_INVALID_STACK_OPERATION},
+        {Script() << OP_1 << OP_2 << OP_3 << OP_4 << OP_5 << OP_6, Script() << OP_2ROT << OP_2 << OP_EQUALVERIFY
+                                                                           << OP_1 << OP_EQUAL, SCRIPT_ERR_OK},
+        {Script() << OP_1 << OP_2 << OP_3 << OP_4, Script() << OP_2SWAP << OP_2 << OP_EQUALVERIFY << OP_1
+                                                           << OP_EQUALVERIFY << OP_4 << OP_EQUAL, SCRIPT_ERR_OK},
+        {Script() << OP_1, Script() << OP_TOALTSTACK << OP_FROMALTSTACK, SCRIPT_ERR_OK},
+        {Script() << OP_1, Script() << OP_FROMALTSTACK, SCRIPT_ERR_INVALID_ALTSTACK_OPERATION},
+        {Script(), Script() << OP_DROP << OP_1, SCRIPT_ERR_INVALID_STACK_OPERATION},
+        {Script() << OP_0, Script() << OP_IFDUP << OP_DEPTH << OP_1 << OP_EQUAL, SCRIPT_ERR_OK},
+
+        {Script() << abc, Script() << OP_SHA256 << std::vector<unsigned char>(sha256, sha256 + 32) << OP_EQUAL,
+            SCRIPT_ERR_OK},
+        {Script() << abc, Script() << OP_HASH256 << std::vector<unsigned char>(sha256d, sha256d + 32) << OP_EQUAL,
+            SCRIPT_ERR_OK},
+        // OP_HASH160 <hash> OP_EQUAL alone would be a P2SH output.
+        {Script() << abc, Script() << OP_HASH160 << std::vector<unsigned char>(hash160, hash160 + 20)
+                                   << OP_EQUALVERIFY << OP_1, SCRIPT_ERR_OK},
+        {Script() << abc, Script() << OP_RIPEMD160 << std::vector<unsigned char>(ripemd160, ripemd160 + 20) << OP_EQUAL,
+            SCRIPT_ERR_OK},
+        {Script() << abc, Script() << OP_SHA1 << ParseHex("a9993e364706816aba3e25717850c26c9cd0d89d") << OP_EQUAL,
+            SCRIPT_ERR_OK},
+
+        // Pushes beyond the inline buffer move to the heap and back intact.
+        {Script() << big520, Script() << OP_DUP << OP_SIZE << 520 << OP_EQUALVERIFY << OP_SHA256 << OP_SWAP
+                                      << OP_SHA256 << OP_EQUAL, SCRIPT_ERR_OK},
+        {Script() << big521, Script() << OP_DROP << OP_1, SCRIPT_ERR_PUSH_SIZE},
+        {Script() << OP_0, Script() << OP_IF << big521 << OP_ENDIF << OP_1, SCRIPT_ERR_PUSH_SIZE},
+        {Script(), nops201, SCRIPT_ERR_OK},
+        {Script(), nops202, SCRIPT_ERR_OP_COUNT},
+        {Script(), ones1000, SCRIPT_ERR_OK},
+        {Script(), ones1001, SCRIPT_ERR_STACK_SIZE},
+        {Script(), truncated, SCRIPT_ERR_BAD_OPCODE},
+        {Script(), oversized, SCRIPT_ERR_SCRIPT_SIZE},
+
+        // With no signature checker every signature fails.
+        {Script() << OP_0, Script() << OP_0 << OP_0 << OP_CHECKMULTISIG, SCRIPT_ERR_OK},
+        {Script(), Script() << OP_0 << OP_0 << OP_CHECKMULTISIG, SCRIPT_ERR_INVALID_STACK_OPERATION},
+        {Script() << OP_0 << OP_1, Script() << OP_1 << big520 << OP_1 << OP_CHECKMULTISIG, SCRIPT_ERR_EVAL_FALSE},
+        {Script() << OP_0 << OP_1, Script() << OP_2 << OP_5 << OP_1 << OP_CHECKMULTISIG, SCRIPT_ERR_SIG_COUNT},
+        {Script() << OP_1 << OP_1, Script() << OP_CHECKSIGVERIFY << OP_1, SCRIPT_ERR_CHECKSIGVERIFY},
+
+        {Script() << OP_2 << redeemBytes, GetScriptForScriptHash(redeemHash), SCRIPT_ERR_OK},
+        {Script() << OP_3 << redeemBytes, GetScriptForScriptHash(redeemHash), SCRIPT_ERR_EVAL_FALSE},
+        {Script() << OP_2 << OP_NOP << redeemBytes, GetScriptForScriptHash(redeemHash), SCRIPT_ERR_SIG_PUSHONLY},
+        {Script() << OP_2 << abc, GetScriptForScriptHash(redeemHash), SCRIPT_ERR_EVAL_FALSE},
+    };
+
+    BaseSignatureChecker checker;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        INFO("case " << i);
+        REQUIRE(Verify(cases[i].scriptSig, cases[i].scriptPubKey, checker) == cases[i].expected);
+    }
+    // Without P2SH only the hash is checked.
+    REQUIRE(Verify(Script() << OP_2 << OP_NOP << redeemBytes, GetScriptForScriptHash(redeemHash), checker,
+                SCRIPT_VERIFY_NONE) == SCRIPT_ERR_OK);
+}
+
+TEST_CASE( "SCRIPT FAST PATHS MATCH THE INTERPRETER", "[interpreter]" ) {
+    Key keys[3] = {MakeKey(1), MakeKey(2), MakeKey(3)};
+    std::vector<std::vector<unsigned char> > pubkeys;
+    for (int i = 0; i < 3; i++)
+        pubkeys.push_back(keys[i].GetPubKey().Raw());
+    unsigned char keyHash[20];
+    keys[0].GetPubKey().GetHash160(keyHash);
+    Script p2pkh = GetScriptForPubKeyHash(keyHash);
+    Script redeem = GetScriptForMultisig(2, pubkeys);
+    unsigned char redeemHash[20];
+    Hash160(redeem.data(), redeem.size(), redeemHash);
+    Script p2sh = GetScriptForScriptHash(redeemHash);
+    Script bare = GetScriptForMultisig(1, std::vector<std::vector<unsigned char> >(pubkeys.begin(), pubkeys.begin() + 2));
+    std::vector<unsigned char> redeemBytes(redeem.begin(), redeem.end());
+
+    MutableTransaction mtx;
+    for (int i = 0; i < 3; i++)
+        mtx.vin.push_back(TxIn(OutPoint(uint256(), (uint32_t)i)));
+    mtx.vout.push_back(TxOut(COIN, p2pkh));
+    Transaction tx(mtx);
+    TransactionSignatureChecker checker0(tx, 0), checker1(tx, 1), checker2(tx, 2);
+
+    // P2PKH
+    std::vector<unsigned char> sig = SignInput(keys[0], p2pkh, tx, 0);
+    REQUIRE(Verify(Script() << sig << pubkeys[0], p2pkh, checker0) == SCRIPT_ERR_OK);
+    REQUIRE(Verify(Script() << sig << pubkeys[1], p2pkh, checker0) == SCRIPT_ERR_EQUALVERIFY);
+    REQUIRE(Verify(Script() << sig << pubkeys[0], p2pkh, checker1) == SCRIPT_ERR_EVAL_FALSE);
+    std::vector<unsigned char> badSig = sig;
+    badSig[10] ^= 1;
+    REQUIRE(Verify(Script() << badSig << pubkeys[0], p2pkh, checker0) == SCRIPT_ERR_EVAL_FALSE);
+    REQUIRE(Verify(Script() << pubkeys[0], p2pkh, checker0) == SCRIPT_ERR_INVALID_STACK_OPERATION);
+    REQUIRE(Verify(Script() << OP_1 << sig << pubkeys[0], p2pkh, checker0) == SCRIPT_ERR_OK);
+    REQUIRE(Verify(Script() << sig << OP_NOP << pubkeys[0], p2pkh, checker0) == SCRIPT_ERR_OK);
+
+    // P2SH 2-of-3: signatures must follow key order.
+    std::vector<unsigned char> sig0 = SignInput(keys[0], redeem, tx, 1);
+    std::vector<unsigned char> sig2 = SignInput(keys[2], redeem, tx, 1);
+    REQUIRE(Verify(Script() << OP_0 << sig0 << sig2 << redeemBytes, p2sh, checker1) == SCRIPT_ERR_OK);
+    REQUIRE(Verify(Script() << OP_0 << sig2 << sig0 << redeemBytes, p2sh, checker1) == SCRIPT_ERR_EVAL_FALSE);
+    REQUIRE(Verify(Script() << OP_0 << sig0 << sig0 << redeemBytes, p2sh, checker1) == SCRIPT_ERR_EVAL_FALSE);
+    REQUIRE(Verify(Script() << OP_0 << sig0 << redeemBytes, p2sh, checker1) == SCRIPT_ERR_INVALID_STACK_OPERATION);
+    REQUIRE(Verify(Script() << OP_1 << OP_0 << sig0 << sig2 << redeemBytes, p2sh, checker1) == SCRIPT_ERR_OK);
+    REQUIRE(Verify(Script() << OP_0 << sig0 << sig2 << redeemBytes, p2sh, checker0) == SCRIPT_ERR_EVAL_FALSE);
+    redeemBytes.back() = OP_CHECKMULTISIGVERIFY;
+    REQUIRE(Verify(Script() << OP_0 << sig0 << sig2 << redeemBytes, p2sh, checker1) == SCRIPT_ERR_EVAL_FALSE);
+
+    // Bare 1-of-2: either key will do.
+    std::vector<unsigned char> sig1 = SignInput(keys[1], bare, tx, 2);
+    REQUIRE(Verify(Script() << OP_0 << sig1, bare, checker2) == SCRIPT_ERR_OK);
+    REQUIRE(Verify(Script() << OP_0 << SignInput(keys[0], bare, tx, 2), bare, checker2) == SCRIPT_ERR_OK);
+    REQUIRE(Verify(Script() << OP_0 << SignInput(keys[2], bare, tx, 2), bare, checker2) == SCRIPT_ERR_EVAL_FALSE);
+    REQUIRE(Verify(Script() << sig1, bare, checker2) == SCRIPT_ERR_INVALID_STACK_OPERATION);
+    REQUIRE(Verify(Script() << OP_0 << sig1 << sig1, bare, checker2) == SCRIPT_ERR_OK);
+}
+
+TEST_CASE( "DECODED SCRIPTS AND TEMPLATES", "[interpreter]" ) {
+    std::vector<std::vector<unsigned char> > pubkeys(3, std::vector<unsigned char>(33, 0x02));
+    Script multisig = GetScriptForMultisig(2, pubkeys);
+    DecodedScript decoded(multisig);
+    int nRequired = 0;
+    REQUIRE(decoded.GetTemplate(&nRequired) == TX_MULTISIG);
+    REQUIRE(nRequired == 2);
+    REQUIRE(decoded.Ops().size() == 6);
+    REQUIRE(decoded.Ops()[1].nSize == 33);
+    REQUIRE(decoded.Data(decoded.Ops()[1])[0] == 0x02);
+
+    unsigned char hash[20] = {0};
+    REQUIRE(DecodedScript(GetScriptForPubKeyHash(hash)).GetTemplate() == TX_PUBKEYHASH);
+    REQUIRE(DecodedScript(GetScriptForScriptHash(hash)).GetTemplate() == TX_SCRIPTHASH);
+    Script threeOfTwo = Script() << OP_3 << pubkeys[0] << pubkeys[1] << OP_2 << OP_CHECKMULTISIG;
+    REQUIRE(DecodedScript(threeOfTwo).GetTemplate() == TX_NONSTANDARD);
+
+    Script pushes = Script() << OP_0 << std::vector<unsigned char>(300, 1) << OP_16;
+    REQUIRE(DecodedScript(pushes).IsPushOnly());
+    REQUIRE(!DecodedScript(pushes).IsDataPushOnly());
+    REQUIRE(DecodedScript(pushes).Ops()[1].nSize == 300);
+    Script truncated = pushes;
+    truncated.push_back(10);
+    REQUIRE(!DecodedScript(truncated).IsComplete());
+    REQUIRE(!DecodedScript(truncated).IsPushOnly());
+    REQUIRE(DecodedScript(truncated).Ops().size() == 3);
+
+    StackItem small = StackItem::FromNum(-255);
+    REQUIRE(small.size() == 2);
+    REQUIRE(small.data()[0] == 0xff);
+    REQUIRE(small.data()[1] == 0x80);
+    std::vector<unsigned char> data(StackItem::INLINE_SIZE + 1, 7);
+    StackItem large(data.data(), data.size());
+    StackItem copy = large;
+    StackItem moved = std::move(large);
+    REQUIRE(copy == moved);
+    REQUIRE(large.empty());
+    copy = small;
+    REQUIRE(copy == small);
+}
@@ -0,0 +1,316 @@
+#include "../include/catch2/catch.hpp"
+#include "util.h"
+#include "../OneCoin/fs.h"
+#include "../OneCoin/lsm.h"
+#include "../OneCoin/lz.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/** Small enough that a few thousand keys reach level 2. */
+LsmOptions SmallOptions()
+{
+    LsmOptions options;
+    options.nMemtableBytes = 16 << 10;
+    options.nBlockSize = 512;
+    options.nL0CompactionTrigger = 2;
+    options.nL0StopWritesTrigger = 4;
+    options.nLevel1Bytes = 32 << 10;
+    options.nTargetFileBytes = 8 << 10;
+    return options;
+}
+
+std::string RandomKey(std::mt19937& rng)
+{
+    // Few distinct prefixes, so keys share them as outpoints of one
+    // transaction do.
+    char key[16];
+    snprintf(key, sizeof(key), "k%02u-%06u", (unsigned int)(rng() % 8), (unsigned int)(rng() % 3000));
+    return key;
+}
+
+std::string RandomValue(std::mt19937& rng)
+{
+    std::string value(rng() % 60, 'v');
+    for (size_t i = 0; i < value.size(); i += 7)
+        value[i] = (char)rng();
+    return value;
+}
+
+void RequireSameContents(const LsmStore& store, const std::map<std::string, std::string>& model)
+{
+    for (std::map<std::string, std::string>::const_iterator it = model.begin(); it != model.end(); ++it) {
+        std::string value;
+        REQUIRE(store.Get(it->first, value));
+        REQUIRE(value == it->second);
+    }
+    std::map<std::string, std::string> scanned;
+    store.Scan("", "", [&](const std::string& key, const std::string& value) {
+        scanned[key] = value;
+        return true;
+    });
+    REQUIRE(scanned == model);
+}
+
+/** Copies the files of an open store, as a crash would leave them. */
+void CopyDirectory(const std::string& from, const std::string& to)
+{
+    REQUIRE(CreateDirectories(to));
+    std::vector<std::string> names;
+    REQUIRE(ListDirectory(from, names));
+    for (size_t i = 0; i < names.size(); i++) {
+        std::vector<unsigned char> data;
+        REQUIRE(ReadFile(from + "/" + names[i], data));
+        int fd = open((to + "/" + names[i]).c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        REQUIRE(fd >= 0);
+        REQUIRE(write(fd, data.data(), data.size()) == (ssize_t)data.size());
+        close(fd);
+    }
+}
+
+} // namespace
+
+TEST_CASE( "LZ BLOCKS ROUND TRIP", "[lsm]" ) {
+    std::mt19937 rng(3);
+    std::vector<std::vector<unsigned char> > inputs;
+    inputs.push_back(std::vector<unsigned char>());
+    inputs.push_back(std::vector<unsigned char>(3, 'a'));
+    inputs.push_back(std::vector<unsigned char>(100000, 'a'));
+    std::vector<unsigned char> random(5000);
+    for (size_t i = 0; i < random.size(); i++)
+        random[i] = (unsigned char)rng();
+    inputs.push_back(random);
+    // Repeats at every distance, long literal runs and long matches.
+    std::vector<unsigned char> mixed;
+    for (int i = 0; i < 2000; i++) {
+        size_t nLen = rng() % 300 + 1;
+        if (mixed.size() > nLen && rng() % 2) {
+            size_t from = rng() % (mixed.size() - nLen);
+            for (size_t j = 0; j < nLen; j++)
+                mixed.push_back(mixed[from + j]);
+        } else {
+            for (size_t j = 0; j < nLen; j++)
+                mixed.push_back((unsigned char)rng());
+        }
+    }
+    inputs.push_back(mixed);
+
+    for (size_t i = 0; i < inputs.size(); i++) {
+        std::vector<unsigned char> compressed, out;
+        LzCompress(inputs[i].data(), inputs[i].size(), compressed);
+        REQUIRE(LzDecompress(compressed.data(), compressed.size(), inputs[i].size(), out));
+        REQUIRE(out == inputs[i]);
+        // The size must match and every truncation is caught.
+        REQUIRE(!LzDecompress(compressed.data(), compressed.size(), inputs[i].size() + 1, out));
+        for (size_t n = 0; n < compressed.size() && n < 50; n++)
+            REQUIRE(!LzDecompress(compressed.data(), n, inputs[i].size() + (inputs[i].empty() ? 1 : 0), out));
+    }
+    std::vector<unsigned char> compressed;
+    LzCompress(inputs[2].data(), inputs[2].size(), compressed);
+    REQUIRE(compressed.size() < 1000);
+
+    // A back reference before the start of the output.
+    const unsigned char bad[] = {0x10, 'x', 0x05, 0x00};
+    std::vector<unsigned char> out;
+    REQUIRE(!LzDecompress(bad, sizeof(bad), 5, out));
+}
+
+TEST_CASE( "LSM STORE MATCHES A MAP THROUGH FLUSHES AND COMPACTIONS", "[lsm]" ) {
+    TempDir dir;
+    LsmStore store(dir.path + "/db", SmallOptions());
+    std::string error;
+    REQUIRE(store.Open(error));
+    std::mt19937 rng(11);
+    std::map<std::string, std::string> model;
+
+    for (int round = 0; round < 40; round++) {
+        LsmWriteBatch batch;
+        for (int i = 0; i < 200; i++) {
+            std::string key = RandomKey(rng);
+            if (rng() % 3 == 0) {
+                batch.Delete(key);
+                model.erase(key);
+            } else {
+                std::string value = RandomValue(rng);
+                batch.Put(key, value);
+                model[key] = value;
+            }
+        }
+        store.Write(batch);
+        for (int i = 0; i < 50; i++) {
+            std::string key = RandomKey(rng), value;
+            std::map<std::string, std::string>::const_iterator it = model.find(key);
+            REQUIRE(store.Get(key, value) == (it != model.end()));
+            if (it != model.end())
+                REQUIRE(value == it->second);
+        }
+    }
+    store.Flush();
+    store.WaitForCompactions();
+    RequireSameContents(store, model);
+
+    LsmStats stats = store.GetStats();
+    REQUIRE(stats.nFlushes > 0);
+    REQUIRE(stats.nCompactions > 0);
+    REQUIRE(stats.nFiles[0] < SmallOptions().nL0CompactionTrigger);
+    int nDeepFiles = 0;
+    for (int i = 2; i < LSM_LEVELS; i++)
+        nDeepFiles += stats.nFiles[i];
+    REQUIRE(nDeepFiles > 0);
+
+    // A bounded scan stops at its end and when told to.
+    std::map<std::string, std::string>::const_iterator first = model.lower_bound("k03");
+    std::map<std::string, std::string>::const_iterator last = model.lower_bound("k04");
+    size_t nSeen = 0;
+    store.Scan("k03", "k04", [&](const std::string& key, const std::string& value) {
+        REQUIRE(first != last);
+        REQUIRE(key == first->first);
+        REQUIRE(value == first->second);
+        ++first;
+        return ++nSeen < 10;
+    });
+    REQUIRE(nSeen == 10);
+}
+
+TEST_CASE( "LSM STORE RECOVERS FROM ITS LOG AND MANIFEST", "[lsm]" ) {
+    TempDir dir;
+    std::string path = dir.path + "/db";
+    std::mt19937 rng(12);
+    std::map<std::string, std::string> model;
+    std::string error;
+    {
+        LsmStore store(path, SmallOptions());
+        REQUIRE(store.Open(error));
+        for (int i = 0; i < 3000; i++) {
+            std::string key = RandomKey(rng), value = RandomValue(rng);
+            store.Put(key, value);
+            model[key] = value;
+        }
+        store.Flush();
+        // These stay in the log only.
+        for (int i = 0; i < 100; i++) {
+            std::string key = RandomKey(rng);
+            store.Delete(key);
+            model.erase(key);
+        }
+        store.Put("last", "in the log");
+        model["last"] = "in the log";
+    }
+
+    // A record torn by a crash is dropped, everything before it kept.
+    std::vector<std::string> names;
+    REQUIRE(ListDirectory(path, names));
+    for (size_t i = 0; i < names.size(); i++) {
+        if (names[i].find(".wal") == std::string::npos)
+            continue;
+        int fd = open((path + "/" + names[i]).c_str(), O_WRONLY | O_APPEND);
+        REQUIRE(fd >= 0);
+        const unsigned char torn[] = {50, 0, 0, 0, 1, 2, 3, 4, 1};
+        REQUIRE(write(fd, torn, sizeof(torn)) == (ssize_t)sizeof(torn));
+        close(fd);
+    }
+
+    LsmStore store(path, SmallOptions());
+    REQUIRE(store.Open(error));
+    RequireSameContents(store, model);
+    // Recovery wrote the log out as a table.
+    REQUIRE(store.GetStats().nFiles[0] + store.GetStats().nFiles[1] > 0);
+
+    store.Close();
+    REQUIRE(store.Open(error));
+    RequireSameContents(store, model);
+}
+
+TEST_CASE( "LSM STORE REFUSES A LOG CORRUPTED BEFORE ITS END", "[lsm]" ) {
+    TempDir dir;
+    std::string path = dir.path + "/db";
+    std::string error;
+    {
+        LsmStore store(path, SmallOptions());
+        REQUIRE(store.Open(error));
+        store.Put("first", "one");
+        store.Put("second", "two");
+    }
+    std::vector<std::string> names;
+    REQUIRE(ListDirectory(path, names));
+    std::string wal;
+    for (size_t i = 0; i < names.size(); i++) {
+        if (names[i].find(".wal") != std::string::npos)
+            wal = path + "/" + names[i];
+    }
+    std::vector<unsigned char> data;
+    REQUIRE(ReadFile(wal, data));
+
+    // A flipped bit in the first record fails its checksum, and the record
+    // after it shows it was no torn write.
+    std::vector<unsigned char> bad = data;
+    bad[10] ^= 0x04;
+    int fd = open(wal.c_str(), O_WRONLY | O_TRUNC);
+    REQUIRE(fd >= 0);
+    REQUIRE(write(fd, bad.data(), bad.size()) == (ssize_t)bad.size());
+    close(fd);
+    LsmStore store(path, SmallOptions());
+    REQUIRE(!store.Open(error));
+    REQUIRE(error.find("corrupt") == 0);
+}
+
+TEST_CASE( "CONCURRENT SYNC WRITES COMMIT IN GROUPS AND SURVIVE A CRASH", "[lsm]" ) {
+    TempDir dir;
+    std::string path = dir.path + "/db";
+    LsmStore store(path, SmallOptions());
+    std::string error;
+    REQUIRE(store.Open(error));
+
+    const int nThreads = 8, nWrites = 100;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nThreads; t++) {
+        threads.push_back(std::thread([&store, t] {
+            for (int i = 0; i < nWrites; i++) {
+                LsmWriteBatch batch;
+                for (int j = 0; j < 5; j++) {
+                    char key[32];
+                    snprintf(key, sizeof(key), "t%d-%04d-%d", t, i, j);
+                    batch.Put(key, std::string(20, (char)('a' + t)));
+                }
+                store.Write(batch, true);
+            }
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+    // Flushes switched logs meanwhile without losing a group.
+    store.Flush();
+    for (int t = 0; t < nThreads; t++) {
+        char key[32];
+        snprintf(key, sizeof(key), "t%d-%04d-%d", t, nWrites - 1, 4);
+        store.Put(key, "rewritten after the flush");
+    }
+    LsmStats stats = store.GetStats();
+    REQUIRE(stats.nWrites == nThreads * nWrites + nThreads);
+    REQUIRE(stats.nLogWrites <= stats.nWrites);
+    REQUIRE(stats.nSyncs <= (uint64_t)(nThreads * nWrites));
+    REQUIRE(stats.nSyncs > 0);
+
+    std::map<std::string, std::string> model;
+    store.Scan("", "", [&](const std::string& key, const std::string& value) {
+        model[key] = value;
+        return true;
+    });
+    REQUIRE(model.size() == (size_t)(nThreads * nWrites * 5));
+
+    // Without Close() the last writes exist only in the log, past the
+    // checkpoint the manifest names.
+    store.WaitForCompactions();
+    CopyDirectory(path, dir.path + "/crashed");
+    LsmStore crashed(dir.path + "/crashed", SmallOptions());
+    REQUIRE(crashed.Open(error));
+    RequireSameContents(crashed, model);
+}
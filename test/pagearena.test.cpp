@@ -0,0 +1,188 @@
+#include "../include/catch2/catch.hpp"
+#include "../OneCoin/coins.h"
+#include "../OneCoin/pagearena.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <functional>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+OutPoint RandomOutPoint(std::mt19937& rng)
+{
+    unsigned char hash[32];
+    for (int i = 0; i < 32; i++)
+        hash[i] = (unsigned char)rng();
+    return OutPoint(uint256(hash), rng() % 4);
+}
+
+} // namespace
+
+TEST_CASE( "PAGE ARENA HANDS OUT DISTINCT BLOCKS AND REUSES FREED ONES", "[pagearena]" ) {
+    PageArena arena;
+    const size_t sizes[] = {0, 1, 16, 17, 100, 512};
+    std::vector<std::pair<void*, size_t> > blocks;
+    std::set<void*> seen;
+    for (int round = 0; round < 100; round++) {
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            size_t nSize = sizes[i];
+            unsigned char* p = (unsigned char*)arena.Allocate(nSize);
+            REQUIRE((uintptr_t)p % 16 == 0);
+            REQUIRE(seen.insert(p).second);
+            memset(p, 0xab, nSize);
+            blocks.push_back(std::make_pair(p, nSize));
+        }
+    }
+    // Small blocks share 2 MiB chunks.
+    REQUIRE(arena.GetStats().nMappedBytes == PageArena::CHUNK_SIZE);
+
+    std::set<void*> freed;
+    for (size_t i = 0; i < blocks.size(); i++) {
+        if (blocks[i].second == 100)
+            freed.insert(blocks[i].first);
+        arena.Deallocate(blocks[i].first, blocks[i].second);
+    }
+    for (size_t i = 0; i < freed.size(); i++)
+        REQUIRE(freed.count(arena.Allocate(100)) == 1);
+    REQUIRE(arena.GetStats().nMappedBytes == PageArena::CHUNK_SIZE);
+}
+
+TEST_CASE( "PAGE ARENA CARVES MID-SIZE BLOCKS FROM CHUNKS AND TRIMS IDLE ONES", "[pagearena]" ) {
+    PageArena::Options options;
+    options.hugePages = PageArena::HUGEPAGES_TRANSPARENT;
+    PageArena arena(options);
+    // Bucket arrays of a growing map, among small nodes.
+    const size_t sizes[] = {513, 1024, 1025, 8 * 12289, PageArena::MAX_MID_SIZE};
+    std::vector<std::pair<void*, size_t> > blocks;
+    for (int round = 0; round < 3; round++) {
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            unsigned char* p = (unsigned char*)arena.Allocate(sizes[i]);
+            size_t nAlign = 1024;
+            while (nAlign < sizes[i])
+                nAlign *= 2;
+            REQUIRE((uintptr_t)p % nAlign == 0);
+            memset(p, 0xcd, sizes[i]);
+            blocks.push_back(std::make_pair(p, sizes[i]));
+            blocks.push_back(std::make_pair(arena.Allocate(48), 48));
+        }
+    }
+    // One chunk of small blocks, one for each of the 1, 2 and 128 KiB
+    // classes and two for three half chunks.
+    REQUIRE(arena.GetStats().nMappedBytes == 6 * PageArena::CHUNK_SIZE);
+
+    // A chunk with a block still in use stays.
+    for (size_t i = 1; i < blocks.size(); i++)
+        arena.Deallocate(blocks[i].first, blocks[i].second);
+    REQUIRE(arena.Trim() == 5 * PageArena::CHUNK_SIZE);
+    REQUIRE(arena.GetStats().nMappedBytes == PageArena::CHUNK_SIZE);
+    arena.Deallocate(blocks[0].first, blocks[0].second);
+    REQUIRE(arena.Trim() == PageArena::CHUNK_SIZE);
+    REQUIRE(arena.GetStats().nMappedBytes == 0);
+
+    // And the arena carries on after a trim.
+    void* p = arena.Allocate(2000);
+    void* q = arena.Allocate(64);
+    REQUIRE(arena.GetStats().nMappedBytes == 2 * PageArena::CHUNK_SIZE);
+    arena.Deallocate(p, 2000);
+    arena.Deallocate(q, 64);
+}
+
+TEST_CASE( "PAGE ARENA MAPS LARGE BLOCKS ALIGNED AND RETURNS THEM", "[pagearena]" ) {
+    PageArena::Options options;
+    options.hugePages = PageArena::HUGEPAGES_TRANSPARENT;
+    PageArena arena(options);
+    size_t nSize = PageArena::CHUNK_SIZE + 1;
+    unsigned char* p = (unsigned char*)arena.Allocate(nSize);
+    REQUIRE((uintptr_t)p % PageArena::CHUNK_SIZE == 0);
+    memset(p, 1, nSize);
+    REQUIRE(arena.GetStats().nMappedBytes == 2 * PageArena::CHUNK_SIZE);
+    arena.Deallocate(p, nSize);
+    REQUIRE(arena.GetStats().nMappedBytes == 0);
+
+    // Just over half a chunk takes a whole one.
+    p = (unsigned char*)arena.Allocate(PageArena::MAX_MID_SIZE + 1);
+    REQUIRE(arena.GetStats().nMappedBytes == PageArena::CHUNK_SIZE);
+    arena.Deallocate(p, PageArena::MAX_MID_SIZE + 1);
+    REQUIRE(arena.GetStats().nMappedBytes == 0);
+}
+
+TEST_CASE( "PAGE ARENA FALLS BACK WHEN NO HUGE PAGES ARE RESERVED", "[pagearena]" ) {
+    PageArena::Options options;
+    options.hugePages = PageArena::HUGEPAGES_EXPLICIT;
+    options.fNumaInterleave = true;
+    PageArena arena(options);
+    void* p = arena.Allocate(64);
+    memset(p, 0, 64);
+    // Either way the memory is there; the stats say which it got.
+    PageArena::Stats stats = arena.GetStats();
+    REQUIRE(stats.nMappedBytes == PageArena::CHUNK_SIZE);
+    REQUIRE(stats.nExplicitBytes + stats.nExplicitFallbacks * PageArena::CHUNK_SIZE == PageArena::CHUNK_SIZE);
+    REQUIRE(stats.nInterleaved == (PageArena::NumaNodes() > 1 ? 1U : 0U));
+    arena.Deallocate(p, 64);
+    REQUIRE(PageArena::NumaNodes() >= 1);
+    REQUIRE(std::string(PageArena::HugePagesName(PageArena::HUGEPAGES_EXPLICIT)) == "explicit");
+}
+
+TEST_CASE( "PAGE ARENA TAKES BACK BLOCKS FREED ON OTHER THREADS", "[pagearena]" ) {
+    PageArena arena;
+    // Each thread allocates from its own pool and frees what the previous
+    // one allocated, as a flush frees nodes connect threads inserted.
+    std::vector<void*> blocks;
+    for (int t = 0; t < 8; t++) {
+        std::vector<void*> freeing;
+        freeing.swap(blocks);
+        std::thread thread([&arena, &blocks, &freeing] {
+            for (int i = 0; i < 10000; i++)
+                blocks.push_back(arena.Allocate(48));
+            for (size_t i = 0; i < freeing.size(); i++)
+                arena.Deallocate(freeing[i], 48);
+        });
+        thread.join();
+    }
+    for (size_t i = 0; i < blocks.size(); i++)
+        arena.Deallocate(blocks[i], 48);
+    // Every freed block went back to a pool that allocates it again, so
+    // no more than one chunk per pool was ever needed.
+    REQUIRE(arena.GetStats().nMappedBytes <= 8 * PageArena::CHUNK_SIZE);
+}
+
+TEST_CASE( "COINS MAP WORKS ON AN ARENA OF ITS OWN", "[pagearena]" ) {
+    PageArena::Options options;
+    options.hugePages = PageArena::HUGEPAGES_TRANSPARENT;
+    options.fNumaInterleave = true;
+    PageArena arena(options);
+    std::mt19937 rng(1);
+    std::vector<OutPoint> outpoints;
+    {
+        CoinsMap map(0, OutPointHasher(), std::equal_to<OutPoint>(),
+            ArenaAllocator<std::pair<const OutPoint, CoinsCacheEntry> >(&arena));
+        for (int i = 0; i < 100000; i++) {
+            outpoints.push_back(RandomOutPoint(rng));
+            map[outpoints.back()].coin = Coin(TxOut(i, Script()), i, false);
+        }
+        REQUIRE(map.get_allocator().GetArena() == &arena);
+        REQUIRE(arena.GetStats().nMappedBytes > 0);
+        for (int i = 0; i < 100000; i += 7)
+            REQUIRE(map.at(outpoints[i]).coin.nHeight == i);
+
+        // A move takes the arena along.
+        CoinsMap moved;
+        moved = std::move(map);
+        REQUIRE(moved.get_allocator().GetArena() == &arena);
+        REQUIRE(moved.size() == 100000);
+        REQUIRE(moved.at(outpoints[99999]).coin.nHeight == 99999);
+    }
+    // Nodes and buckets alike go back to the system.
+    REQUIRE(arena.Trim() > 0);
+    REQUIRE(arena.GetStats().nMappedBytes == 0);
+    // The cache in the default arena is the same map.
+    CoinsMap map;
+    REQUIRE(map.get_allocator().GetArena() == &PageArena::Default());
+    map[outpoints[0]].flags = CoinsCacheEntry::DIRTY;
+    REQUIRE(map.size() == 1);
+}
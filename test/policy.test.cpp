@@ -0,0 +1,152 @@
+#include "../include/catch2/catch.hpp"
+#include "../OneCoin/policy.h"
+#include "../OneCoin/transaction.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<unsigned char> Bytes(size_t n, unsigned char c) { return std::vector<unsigned char>(n, c); }
+
+std::vector<unsigned char> PubKeyBytes(unsigned char n)
+{
+    std::vector<unsigned char> key(33, n);
+    key[0] = 0x02;
+    return key;
+}
+
+/** One P2PKH-style spend paying a P2PKH output. */
+MutableTransaction StandardTx()
+{
+    MutableTransaction tx;
+    unsigned char hash[32] = {7};
+    tx.vin.push_back(TxIn(OutPoint(uint256(hash), 1), Script() << Bytes(72, 0x30) << PubKeyBytes(1)));
+    unsigned char hash160[20] = {9};
+    tx.vout.push_back(TxOut(COIN, GetScriptForPubKeyHash(hash160)));
+    return tx;
+}
+
+bool Check(const MutableTransaction& tx, TxPolicyStats& stats, std::string& reason)
+{
+    std::vector<unsigned char> data = SerializeTransaction(tx);
+    return CheckTransactionPolicy(data.data(), data.size(), stats, reason);
+}
+
+std::string RejectReason(const MutableTransaction& tx)
+{
+    TxPolicyStats stats;
+    std::string reason;
+    return Check(tx, stats, reason) ? "" : reason;
+}
+
+} // namespace
+
+TEST_CASE( "STANDARD TRANSACTIONS PASS IN ONE PASS", "[policy]" ) {
+    MutableTransaction tx = StandardTx();
+    unsigned char hash160[20] = {3};
+    tx.vout.push_back(TxOut(COIN, GetScriptForScriptHash(hash160)));
+    tx.vout.push_back(TxOut(COIN, Script() << PubKeyBytes(2) << OP_CHECKSIG));
+    std::vector<unsigned char> uncompressed(65, 5);
+    uncompressed[0] = 0x04;
+    tx.vout.push_back(TxOut(COIN, Script() << uncompressed << OP_CHECKSIG));
+    std::vector<std::vector<unsigned char> > keys;
+    keys.push_back(PubKeyBytes(3));
+    keys.push_back(PubKeyBytes(4));
+    tx.vout.push_back(TxOut(COIN, GetScriptForMultisig(1, keys)));
+    tx.vout.push_back(TxOut(0, Script() << OP_RETURN << Bytes(80, 0xaa)));
+    tx.nVersion = 2;
+
+    TxPolicyStats stats;
+    std::string reason;
+    REQUIRE(Check(tx, stats, reason));
+    size_t nSize = SerializeTransaction(tx).size();
+    REQUIRE(stats.nSize == nSize);
+    REQUIRE(stats.nWeight == (int64_t)nSize * 4);
+    REQUIRE(stats.nInputs == 1);
+    REQUIRE(stats.nOutputs == 6);
+    REQUIRE(stats.nValueOut == 5 * COIN);
+    // Three CHECKSIGs and one CHECKMULTISIG.
+    REQUIRE(stats.nSigOps == 23);
+
+    // A P2PKH output is dust below 546 at the default rate.
+    unsigned char p2pkh[25];
+    Script script = GetScriptForPubKeyHash(hash160);
+    std::copy(script.begin(), script.end(), p2pkh);
+    REQUIRE(GetDustThreshold(p2pkh, sizeof(p2pkh)) == 546);
+    tx.vout[0].nValue = 546;
+    REQUIRE(RejectReason(tx) == "");
+    tx.vout[0].nValue = 545;
+    REQUIRE(RejectReason(tx) == "dust");
+    tx.vout[0].nValue = COIN;
+
+    // Malformed bytes of every length are rejected, never thrown on.
+    std::vector<unsigned char> data = SerializeTransaction(tx);
+    for (size_t len = 0; len < data.size(); len++) {
+        REQUIRE(!CheckTransactionPolicy(data.data(), len, stats, reason));
+        REQUIRE((reason == "tx-decode" || reason == "tx-size-small"));
+    }
+    data.push_back(0);
+    REQUIRE(!CheckTransactionPolicy(data.data(), data.size(), stats, reason));
+    REQUIRE(reason == "tx-trailing-data");
+}
+
+TEST_CASE( "NONSTANDARD TRANSACTIONS ARE REJECTED WITH A REASON", "[policy]" ) {
+    MutableTransaction tx = StandardTx();
+    tx.nVersion = 3;
+    REQUIRE(RejectReason(tx) == "version");
+
+    tx = StandardTx();
+    tx.vin[0].scriptSig = Script(Bytes(MAX_STANDARD_SCRIPTSIG_SIZE + 1, OP_1));
+    REQUIRE(RejectReason(tx) == "scriptsig-size");
+    tx.vin[0].scriptSig = Script() << Bytes(72, 0x30) << OP_DUP;
+    REQUIRE(RejectReason(tx) == "scriptsig-not-pushonly");
+
+    tx = StandardTx();
+    tx.vout[0].scriptPubKey = Script() << OP_TRUE;
+    REQUIRE(RejectReason(tx) == "scriptpubkey");
+    std::vector<std::vector<unsigned char> > keys;
+    for (unsigned char i = 0; i < 4; i++)
+        keys.push_back(PubKeyBytes(i));
+    tx.vout[0].scriptPubKey = GetScriptForMultisig(1, keys);
+    REQUIRE(RejectReason(tx) == "scriptpubkey");
+    tx.vout[0].scriptPubKey = Script() << OP_RETURN << Bytes(81, 0xaa);
+    REQUIRE(RejectReason(tx) == "scriptpubkey");
+
+    tx = StandardTx();
+    tx.vout.push_back(TxOut(0, Script() << OP_RETURN << Bytes(10, 1)));
+    REQUIRE(RejectReason(tx) == "");
+    tx.vout.push_back(TxOut(0, Script() << OP_RETURN << Bytes(10, 2)));
+    REQUIRE(RejectReason(tx) == "multi-op-return");
+
+    tx = StandardTx();
+    tx.vout[0].nValue = -1;
+    REQUIRE(RejectReason(tx) == "bad-txns-vout-negative");
+    tx.vout[0].nValue = MAX_MONEY + 1;
+    REQUIRE(RejectReason(tx) == "bad-txns-vout-toolarge");
+    tx.vout[0].nValue = MAX_MONEY;
+    tx.vout.push_back(tx.vout[0]);
+    REQUIRE(RejectReason(tx) == "bad-txns-txouttotal-toolarge");
+
+    tx = StandardTx();
+    tx.vout.clear();
+    REQUIRE(RejectReason(tx) == "bad-txns-vout-empty");
+
+    // Bare 1-of-1 multisig outputs count twenty sigops each.
+    tx = StandardTx();
+    keys.resize(1);
+    while (tx.vout.size() <= MAX_STANDARD_TX_SIGOPS / 20)
+        tx.vout.push_back(TxOut(COIN, GetScriptForMultisig(1, keys)));
+    REQUIRE(RejectReason(tx) == "bad-txns-too-many-sigops");
+
+    tx = StandardTx();
+    while (SerializeTransaction(tx).size() * WITNESS_SCALE_FACTOR <= (size_t)MAX_STANDARD_TX_WEIGHT)
+        tx.vout.push_back(tx.vout[0]);
+    REQUIRE(RejectReason(tx) == "tx-size");
+
+    tx = StandardTx();
+    tx.vin[0].scriptSig = Script();
+    tx.vout[0].scriptPubKey = Script() << OP_RETURN;
+    tx.vout[0].nValue = 0;
+    REQUIRE(RejectReason(tx) == "tx-size-small");
+}
@@ -0,0 +1,195 @@
+#include "../include/catch2/catch.hpp"
+#include "util.h"
+#include "../OneCoin/coinsdb.h"
+#include "../OneCoin/fs.h"
+#include "../OneCoin/snapshot.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+uint256 RandomHash(std::mt19937& rng)
+{
+    unsigned char hash[32];
+    for (int i = 0; i < 32; i++)
+        hash[i] = (unsigned char)rng();
+    return uint256(hash);
+}
+
+/** Mostly pay-to-pubkey-hash outputs, as on a real chain, plus some
+ *  scripts no template covers. */
+Coin RandomCoin(std::mt19937& rng)
+{
+    unsigned char hash160[20];
+    for (int i = 0; i < 20; i++)
+        hash160[i] = (unsigned char)rng();
+    Script script = GetScriptForPubKeyHash(hash160);
+    if (rng() % 5 == 0) {
+        std::vector<unsigned char> raw(rng() % 60 + 1, (unsigned char)rng());
+        raw[0] = OP_DUP;
+        script = Script(raw);
+    }
+    return Coin(TxOut((rng() % 5000 + 1) * 100000, script), rng() % 100000, rng() % 10 == 0);
+}
+
+void AddCoins(CoinsView& view, std::mt19937 rng, size_t nTransactions)
+{
+    CoinsViewCache cache(&view);
+    for (size_t i = 0; i < nTransactions; i++) {
+        uint256 txid = RandomHash(rng);
+        int nOutputs = rng() % 4 + 1;
+        for (int n = 0; n < nOutputs; n++)
+            cache.AddCoin(OutPoint(txid, rng() % 8 == 0 ? 300 + n : n), RandomCoin(rng), true);
+    }
+    cache.SetBestBlock(uint256::FromHex("03"));
+    cache.Flush();
+}
+
+bool SameCoin(const Coin& a, const Coin& b)
+{
+    return a.out == b.out && a.nHeight == b.nHeight && a.fCoinBase == b.fCoinBase;
+}
+
+void RequireSameCoins(const CoinsViewStore& store, const CoinsView& view)
+{
+    REQUIRE(view.GetCoinCount() == store.GetCoinCount());
+    REQUIRE(view.GetBestBlock() == store.GetBestBlock());
+    size_t nSeen = 0;
+    store.ForEachCoin([&](const OutPoint& outpoint, const Coin& coin) {
+        Coin loaded;
+        REQUIRE(view.GetCoin(outpoint, loaded));
+        REQUIRE(SameCoin(loaded, coin));
+        nSeen++;
+        return true;
+    });
+    REQUIRE(nSeen == store.GetCoinCount());
+}
+
+void WriteBytes(const std::string& path, const std::vector<unsigned char>& data)
+{
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    REQUIRE(fd >= 0);
+    REQUIRE(write(fd, data.data(), data.size()) == (ssize_t)data.size());
+    close(fd);
+}
+
+} // namespace
+
+TEST_CASE( "COINS STORES ITERATE IN OUTPOINT ORDER", "[snapshot]" ) {
+    TempDir dir;
+    CoinsViewDB db(dir.path + "/db");
+    CoinsViewLsm lsm(dir.path + "/lsm");
+    std::string error;
+    REQUIRE(db.Open(error));
+    REQUIRE(lsm.Open(error));
+    std::mt19937 rng(21);
+    AddCoins(db, rng, 2000);
+    AddCoins(lsm, rng, 2000);
+
+    std::vector<OutPoint> fromDB, fromLsm;
+    db.ForEachCoin([&](const OutPoint& outpoint, const Coin&) {
+        fromDB.push_back(outpoint);
+        return true;
+    });
+    lsm.ForEachCoin([&](const OutPoint& outpoint, const Coin&) {
+        fromLsm.push_back(outpoint);
+        return true;
+    });
+    REQUIRE(fromDB.size() == db.GetCoinCount());
+    REQUIRE(fromDB == fromLsm);
+    for (size_t i = 1; i < fromDB.size(); i++)
+        REQUIRE(fromDB[i - 1] < fromDB[i]);
+
+    size_t nSeen = 0;
+    db.ForEachCoin([&](const OutPoint&, const Coin&) { return ++nSeen < 10; });
+    REQUIRE(nSeen == 10);
+}
+
+TEST_CASE( "COINS ROUND TRIP THROUGH A SNAPSHOT", "[snapshot]" ) {
+    TempDir dir;
+    CoinsViewDB db(dir.path + "/db");
+    CoinsViewLsm lsm(dir.path + "/lsm");
+    std::string error;
+    REQUIRE(db.Open(error));
+    REQUIRE(lsm.Open(error));
+    std::mt19937 rng(22);
+    // Enough coins for several records.
+    const size_t nTransactions = 40000;
+    AddCoins(db, rng, nTransactions);
+    AddCoins(lsm, rng, nTransactions);
+
+    // Both stores give the same bytes.
+    SnapshotInfo dbInfo, lsmInfo;
+    REQUIRE(WriteCoinsSnapshot(db, dir.path + "/db.snapshot", dbInfo, error));
+    REQUIRE(WriteCoinsSnapshot(lsm, dir.path + "/lsm.snapshot", lsmInfo, error));
+    std::vector<unsigned char> dbBytes, lsmBytes;
+    REQUIRE(ReadFile(dir.path + "/db.snapshot", dbBytes));
+    REQUIRE(ReadFile(dir.path + "/lsm.snapshot", lsmBytes));
+    REQUIRE(dbBytes == lsmBytes);
+    REQUIRE(dbInfo.nCoins == db.GetCoinCount());
+    REQUIRE(dbInfo.nBytes == dbBytes.size());
+    REQUIRE(dbInfo.hashBlock == uint256::FromHex("03"));
+    REQUIRE(!FileExists(dir.path + "/db.snapshot.new"));
+    // Against outpoints, heights, amounts and scripts stored as is.
+    uint64_t nRawBytes = 0;
+    db.ForEachCoin([&](const OutPoint&, const Coin& coin) {
+        nRawBytes += 36 + 4 + 8 + 1 + coin.out.scriptPubKey.size();
+        return true;
+    });
+    REQUIRE(dbBytes.size() * 3 < nRawBytes * 2);
+
+    CoinsViewMemory memory;
+    SnapshotInfo loaded;
+    REQUIRE(LoadCoinsSnapshot(dir.path + "/db.snapshot", memory, loaded, error));
+    REQUIRE(loaded.nCoins == dbInfo.nCoins);
+    REQUIRE(loaded.nBytes == dbInfo.nBytes);
+    RequireSameCoins(db, memory);
+    CoinsViewLsm reloaded(dir.path + "/reloaded");
+    REQUIRE(reloaded.Open(error));
+    REQUIRE(LoadCoinsSnapshot(dir.path + "/lsm.snapshot", reloaded, loaded, error));
+    RequireSameCoins(lsm, reloaded);
+
+    // Truncated, corrupt and foreign files are refused.
+    std::string path = dir.path + "/bad.snapshot";
+    std::vector<unsigned char> bad(dbBytes.begin(), dbBytes.end() - 1);
+    WriteBytes(path, bad);
+    CoinsViewMemory scratch;
+    REQUIRE(!LoadCoinsSnapshot(path, scratch, loaded, error));
+    bad.assign(dbBytes.begin(), dbBytes.begin() + dbBytes.size() / 2);
+    WriteBytes(path, bad);
+    REQUIRE(!LoadCoinsSnapshot(path, scratch, loaded, error));
+    bad = dbBytes;
+    bad[0] ^= 1;
+    WriteBytes(path, bad);
+    REQUIRE(!LoadCoinsSnapshot(path, scratch, loaded, error));
+    // A flipped bit anywhere fails a checksum, even where the coins would
+    // still decode.
+    for (size_t nPos = 8; nPos < dbBytes.size(); nPos += dbBytes.size() / 7) {
+        bad = dbBytes;
+        bad[nPos] ^= 0x10;
+        WriteBytes(path, bad);
+        CoinsViewMemory corrupt;
+        REQUIRE(!LoadCoinsSnapshot(path, corrupt, loaded, error));
+        REQUIRE(error.find("corrupt") == 0);
+    }
+    REQUIRE(!LoadCoinsSnapshot(dir.path + "/missing", scratch, loaded, error));
+}
+
+TEST_CASE( "AN EMPTY UTXO SET GIVES A HEADER-ONLY SNAPSHOT", "[snapshot]" ) {
+    TempDir dir;
+    CoinsViewDB db(dir.path + "/db");
+    std::string error;
+    REQUIRE(db.Open(error));
+    SnapshotInfo info;
+    REQUIRE(WriteCoinsSnapshot(db, dir.path + "/empty.snapshot", info, error));
+    REQUIRE(info.nCoins == 0);
+    REQUIRE(FileSize(dir.path + "/empty.snapshot") == (int64_t)info.nBytes);
+    CoinsViewMemory memory;
+    REQUIRE(LoadCoinsSnapshot(dir.path + "/empty.snapshot", memory, info, error));
+    REQUIRE(memory.GetCoinCount() == 0);
+}
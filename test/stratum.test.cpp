@@ -0,0 +1,385 @@
+#include "../include/catch2/catch.hpp"
+#include "../include/catch2/json.hpp"
+#include "../OneCoin/chainparams.h"
+#include "../OneCoin/encoding.h"
+#include "../OneCoin/hash.h"
+#include "../OneCoin/merkle.h"
+#include "../OneCoin/stratum.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+using nlohmann::json;
+
+namespace {
+
+const ChainParams& MainParams()
+{
+    static std::unique_ptr<const ChainParams> params = CreateChainParams("main");
+    return *params;
+}
+
+BlockTemplate MakeTemplate(uint32_t nBits, size_t extraTxs)
+{
+    std::vector<TransactionRef> txs;
+    std::vector<Amount> fees;
+    for (size_t i = 0; i < extraTxs; i++) {
+        MutableTransaction tx;
+        tx.vin.push_back(TxIn(OutPoint(MainParams().GenesisBlock().vtx[0]->GetHash(), (uint32_t)i)));
+        tx.vout.push_back(TxOut(COIN, Script() << OP_TRUE));
+        txs.push_back(MakeTransactionRef(tx));
+        fees.push_back(1000);
+    }
+    return BlockAssembler(MainParams()).CreateNewBlock(MainParams().GenesisBlock().GetHash(), 1, nBits, time(NULL),
+        MainParams().GenesisBlock().nTime + 1, Script() << OP_TRUE, txs, fees);
+}
+
+/** Just enough of a Stratum client to subscribe, follow jobs and submit. */
+class TestMiner {
+public:
+    explicit TestMiner(uint16_t port)
+    {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+        connected = connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0;
+    }
+    ~TestMiner() { close(fd); }
+
+    bool connected;
+
+    void Call(int id, const std::string& method, const json& params)
+    {
+        json req;
+        req["id"] = id;
+        req["method"] = method;
+        req["params"] = params;
+        std::string line = req.dump() + "\n";
+        REQUIRE(send(fd, line.data(), line.size(), 0) == (ssize_t)line.size());
+    }
+
+    /** Next message, or a discarded value on timeout. */
+    json Read()
+    {
+        while (true) {
+            size_t nl = buf.find('\n');
+            if (nl != std::string::npos) {
+                json msg = json::parse(buf.substr(0, nl), nullptr, false);
+                buf.erase(0, nl + 1);
+                if (msg.contains("method") && msg["method"] == "mining.notify")
+                    notify = msg["params"];
+                return msg;
+            }
+            struct pollfd pfd = {fd, POLLIN, 0};
+            if (poll(&pfd, 1, 5000) <= 0)
+                return json::parse("", nullptr, false);
+            char tmp[4096];
+            ssize_t n = recv(fd, tmp, sizeof(tmp), 0);
+            if (n <= 0)
+                return json::parse("", nullptr, false);
+            buf.append(tmp, n);
+        }
+    }
+
+    /** Reads until the response to request id. */
+    json Response(int id)
+    {
+        while (true) {
+            json msg = Read();
+            if (msg.is_discarded() || (msg.contains("id") && msg["id"] == id))
+                return msg;
+        }
+    }
+
+    /** Builds the header from the last notify exactly as mining hardware does
+     *  and grinds nonces until the hash meets target. */
+    json Solve(const std::string& extranonce1, const std::string& extranonce2, const arith_uint256& target)
+    {
+        std::vector<unsigned char> coinbase = ParseHex(notify[2].get<std::string>() + extranonce1 + extranonce2 +
+                                                       notify[3].get<std::string>());
+        unsigned char hash[32];
+        Sha256d(coinbase, hash);
+        uint256 root(hash);
+        for (size_t i = 0; i < notify[4].size(); i++)
+            root = Hash64(root, uint256(ParseHex(notify[4][i].get<std::string>())));
+
+        std::vector<unsigned char> prev = ParseHex(notify[1].get<std::string>());
+        for (size_t i = 0; i < 32; i += 4)
+            std::reverse(prev.begin() + i, prev.begin() + i + 4);
+
+        BlockHeader header;
+        header.nVersion = (int32_t)strtoul(notify[5].get<std::string>().c_str(), NULL, 16);
+        header.hashPrevBlock = uint256(prev);
+        header.hashMerkleRoot = root;
+        header.nBits = (uint32_t)strtoul(notify[6].get<std::string>().c_str(), NULL, 16);
+        header.nTime = (uint32_t)strtoul(notify[7].get<std::string>().c_str(), NULL, 16);
+        for (header.nNonce = 0; UintToArith256(header.GetHash()) > target; header.nNonce++) {
+        }
+        char nonce[9];
+        snprintf(nonce, sizeof(nonce), "%08x", header.nNonce);
+        return json::array({"worker", notify[0], extranonce2, notify[7], nonce});
+    }
+
+    /** Sends raw bytes; false once the server has dropped us. */
+    bool SendRaw(const std::string& data)
+    {
+        return send(fd, data.data(), data.size(), MSG_NOSIGNAL) == (ssize_t)data.size();
+    }
+
+    /** Reads and discards until the server closes the connection; false if
+     *  it stays open. */
+    bool WaitClosed()
+    {
+        while (true) {
+            struct pollfd pfd = {fd, POLLIN, 0};
+            if (poll(&pfd, 1, 5000) <= 0)
+                return false;
+            char tmp[65536];
+            if (recv(fd, tmp, sizeof(tmp), 0) <= 0)
+                return true;
+        }
+    }
+
+    json notify;
+
+private:
+    int fd;
+    std::string buf;
+};
+
+}
+
+TEST_CASE( "STRATUM DIFFICULTY TARGETS", "[stratum]" ) {
+    REQUIRE(StratumDifficultyToTarget(1.0) == arith_uint256::FromCompact(0x1d00ffff));
+    REQUIRE(StratumDifficultyToTarget(16.0) == arith_uint256::FromCompact(0x1d00ffff) >> 4);
+    REQUIRE(StratumDifficultyToTarget(0.0) == ~arith_uint256());
+    REQUIRE(StratumDifficultyToTarget(-1.0) == ~arith_uint256());
+
+    uint256 h = uint256::FromHex("00000000000000000007878ec04bb2b2e12317804810f4c26033585b3f81ffaa");
+    REQUIRE(StratumPrevHash(h) == "3f81ffaa6033585b4810f4c2e1231780c04bb2b20007878e0000000000000000");
+}
+
+TEST_CASE( "STRATUM JOB SPLITS THE COINBASE AROUND THE EXTRANONCE", "[stratum]" ) {
+    BlockTemplate tmpl = MakeTemplate(0x207fffff, 5);
+    StratumJob job("1", tmpl, 4, 4);
+    REQUIRE(job.MerkleBranch().size() == 3);
+
+    const unsigned char en1[4] = {1, 2, 3, 4};
+    const unsigned char en2[4] = {5, 6, 7, 8};
+    BlockHeader header;
+    arith_uint256 hard = arith_uint256::FromCompact(0x1d00ffff) >> 32;
+    StratumJob::ShareResult result = StratumJob::SHARE_LOW_DIFFICULTY;
+    uint32_t nonce;
+    for (nonce = 0; result == StratumJob::SHARE_LOW_DIFFICULTY; nonce++)
+        result = job.CheckShare(en1, en2, tmpl.block.nTime, nonce, hard, tmpl.block.nTime, &header);
+    // Regtest-style bits: the first nonce that passes meets the network target.
+    REQUIRE(result == StratumJob::SHARE_BLOCK);
+
+    Block block = job.AssembleBlock(header, en1, en2);
+    REQUIRE(block.vtx.size() == 6);
+    REQUIRE(BlockMerkleRoot(block) == header.hashMerkleRoot);
+    REQUIRE(block.vtx[0]->vout[0].nValue == tmpl.nCoinbaseValue);
+    REQUIRE(block.GetHash() == header.GetHash());
+
+    REQUIRE(job.CheckShare(en1, en2, tmpl.block.nTime, nonce - 1, hard, tmpl.block.nTime, NULL) ==
+            StratumJob::SHARE_DUPLICATE);
+    REQUIRE(job.CheckShare(en1, en2, (uint32_t)tmpl.nMinTime - 1, 0, hard, tmpl.block.nTime, NULL) ==
+            StratumJob::SHARE_BAD_NTIME);
+    REQUIRE(job.CheckShare(en1, en2, tmpl.block.nTime + 1, 0, hard, tmpl.block.nTime, NULL) ==
+            StratumJob::SHARE_BAD_NTIME);
+}
+
+TEST_CASE( "STRATUM JOB ACCEPTS A BOUNDED NUMBER OF SHARES", "[stratum]" ) {
+    BlockTemplate tmpl = MakeTemplate(0x1d00ffff, 0);
+    StratumJob job("1", tmpl, 4, 4, 3);
+    const unsigned char en1[4] = {1, 2, 3, 4};
+    const unsigned char en2[4] = {5, 6, 7, 8};
+    arith_uint256 easy = ~arith_uint256();
+    for (uint32_t nonce = 0; nonce < 3; nonce++)
+        REQUIRE(job.CheckShare(en1, en2, tmpl.block.nTime, nonce, easy, tmpl.block.nTime, NULL) ==
+                StratumJob::SHARE_VALID);
+    REQUIRE(job.CheckShare(en1, en2, tmpl.block.nTime, 3, easy, tmpl.block.nTime, NULL) == StratumJob::SHARE_STALE);
+    REQUIRE(job.CheckShare(en1, en2, tmpl.block.nTime, 0, easy, tmpl.block.nTime, NULL) ==
+            StratumJob::SHARE_DUPLICATE);
+}
+
+TEST_CASE( "STRATUM JOB TAKES A BLOCK AFTER ITS SHARE HISTORY IS FULL", "[stratum]" ) {
+    BlockTemplate tmpl = MakeTemplate(0x207fffff, 2);
+    StratumJob job("1", tmpl, 4, 4, 2);
+    const unsigned char en1[4] = {1, 2, 3, 4};
+    const unsigned char en2[4] = {5, 6, 7, 8};
+    arith_uint256 easy = ~arith_uint256();
+    // Regtest-style bits: about every other nonce solves a block. Fill the
+    // history until a share is turned away, then look for a block.
+    BlockHeader header;
+    StratumJob::ShareResult result = StratumJob::SHARE_VALID;
+    uint32_t nonce;
+    for (nonce = 0; result != StratumJob::SHARE_STALE; nonce++)
+        result = job.CheckShare(en1, en2, tmpl.block.nTime, nonce, easy, tmpl.block.nTime, NULL);
+    REQUIRE(job.ShareCount() >= 2);
+    for (; result == StratumJob::SHARE_STALE; nonce++)
+        result = job.CheckShare(en1, en2, tmpl.block.nTime, nonce, easy, tmpl.block.nTime, &header);
+    REQUIRE(result == StratumJob::SHARE_BLOCK);
+    REQUIRE(job.AssembleBlock(header, en1, en2).GetHash() == header.GetHash());
+    REQUIRE(job.CheckShare(en1, en2, tmpl.block.nTime, nonce - 1, easy, tmpl.block.nTime, NULL) ==
+            StratumJob::SHARE_DUPLICATE);
+}
+
+TEST_CASE( "STRATUM JOB RENEWS WITH A FRESH HISTORY", "[stratum]" ) {
+    BlockTemplate tmpl = MakeTemplate(0x1d00ffff, 3);
+    StratumJob job("1", tmpl, 4, 4, 1);
+    const unsigned char en1[4] = {1, 2, 3, 4};
+    const unsigned char en2[4] = {5, 6, 7, 8};
+    arith_uint256 easy = ~arith_uint256();
+    BlockHeader header, renewedHeader;
+    REQUIRE(job.CheckShare(en1, en2, tmpl.block.nTime, 0, easy, tmpl.block.nTime, &header) ==
+            StratumJob::SHARE_VALID);
+    REQUIRE(job.CheckShare(en1, en2, tmpl.block.nTime, 1, easy, tmpl.block.nTime, NULL) == StratumJob::SHARE_STALE);
+
+    StratumJob renewed("2", job);
+    REQUIRE(renewed.Id() == "2");
+    REQUIRE(renewed.ShareCount() == 0);
+    REQUIRE(renewed.MerkleBranch() == job.MerkleBranch());
+    REQUIRE(renewed.Coinb1() != job.Coinb1());
+    REQUIRE(renewed.Coinb2() == job.Coinb2());
+
+    // The same submission is new work for the renewed job.
+    REQUIRE(renewed.CheckShare(en1, en2, tmpl.block.nTime, 0, easy, tmpl.block.nTime, &renewedHeader) ==
+            StratumJob::SHARE_VALID);
+    REQUIRE(renewedHeader.GetHash() != header.GetHash());
+    Block block = renewed.AssembleBlock(renewedHeader, en1, en2);
+    REQUIRE(BlockMerkleRoot(block) == renewedHeader.hashMerkleRoot);
+    REQUIRE(block.vtx[0]->vout[0].nValue == tmpl.nCoinbaseValue);
+}
+
+TEST_CASE( "STRATUM SERVER DROPS A CLIENT THAT DOES NOT READ", "[stratum]" ) {
+    StratumServer::Options options;
+    options.maxSendBuffer = 64 << 10;
+    StratumServer server(options, StratumServer::BlockFoundFn());
+    std::string error;
+    REQUIRE(server.Start(error));
+    server.UpdateTemplate(MakeTemplate(0x1d00ffff, 0));
+
+    // Requests whose replies pile up once the socket buffers are full.
+    std::string batch;
+    for (int i = 0; i < 1000; i++)
+        batch += "{\"id\":1,\"method\":\"mining.subscribe\",\"params\":[]}\n";
+    TestMiner miner(server.GetPort());
+    REQUIRE(miner.connected);
+    for (int i = 0; i < 2000 && miner.SendRaw(batch); i++) {
+    }
+    REQUIRE(miner.WaitClosed());
+
+    // Other miners are still served.
+    TestMiner other(server.GetPort());
+    REQUIRE(other.connected);
+    other.Call(1, "mining.subscribe", json::array());
+    REQUIRE(other.Response(1)["error"].is_null());
+    server.Stop();
+}
+
+TEST_CASE( "STRATUM SERVER ACCEPTS SHARES FROM A MINER", "[stratum]" ) {
+    StratumServer::Options options;
+    options.difficulty = 1e-9;
+    std::vector<Block> found;
+    std::mutex foundMutex;
+    StratumServer server(options, [&](const Block& block) {
+        std::lock_guard<std::mutex> lock(foundMutex);
+        found.push_back(block);
+    });
+    std::string error;
+    REQUIRE(server.Start(error));
+    // Main-network bits: shares at difficulty 1e-9 are plentiful, blocks are not.
+    server.UpdateTemplate(MakeTemplate(0x1d00ffff, 2));
+
+    TestMiner miner(server.GetPort());
+    REQUIRE(miner.connected);
+    miner.Call(1, "mining.subscribe", json::array({"test/1.0"}));
+    json sub = miner.Response(1);
+    REQUIRE(sub["error"].is_null());
+    std::string extranonce1 = sub["result"][1];
+    REQUIRE(extranonce1.size() == 2 * StratumServer::EXTRANONCE1_SIZE);
+    REQUIRE(sub["result"][2] == options.extranonce2Size);
+
+    miner.Call(2, "mining.submit", json::array({"worker", "1", "00000000", "00000000", "00000000"}));
+    REQUIRE(miner.Response(2)["error"][0] == STRATUM_ERR_UNAUTHORIZED);
+
+    miner.Call(3, "mining.authorize", json::array({"worker", "x"}));
+    REQUIRE(miner.Response(3)["result"] == true);
+    REQUIRE(!miner.notify.is_null());
+
+    json share = miner.Solve(extranonce1, "0000002a", StratumDifficultyToTarget(options.difficulty));
+    miner.Call(4, "mining.submit", share);
+    json resp = miner.Response(4);
+    REQUIRE(resp["error"].is_null());
+    REQUIRE(resp["result"] == true);
+
+    miner.Call(5, "mining.submit", share);
+    REQUIRE(miner.Response(5)["error"][0] == STRATUM_ERR_DUPLICATE_SHARE);
+
+    share[1] = "ffff";
+    miner.Call(6, "mining.submit", share);
+    REQUIRE(miner.Response(6)["error"][0] == STRATUM_ERR_JOB_NOT_FOUND);
+
+    // A new previous block invalidates outstanding work.
+    BlockTemplate next = MakeTemplate(0x1d00ffff, 0);
+    next.block.hashPrevBlock = uint256::FromHex("01");
+    std::string oldJob = miner.notify[0];
+    server.UpdateTemplate(next);
+    while (miner.notify[0] == oldJob)
+        REQUIRE(!miner.Read().is_discarded());
+    REQUIRE(miner.notify[8] == true);
+    share[1] = oldJob;
+    miner.Call(7, "mining.submit", share);
+    REQUIRE(miner.Response(7)["error"][0] == STRATUM_ERR_JOB_NOT_FOUND);
+
+    StratumServer::Stats stats = server.GetStats();
+    REQUIRE(stats.sharesAccepted == 1);
+    REQUIRE(stats.sharesRejected == 4);
+    REQUIRE(found.empty());
+    server.Stop();
+}
+
+TEST_CASE( "STRATUM SERVER RENEWS A JOB BEFORE ITS SHARE HISTORY FILLS", "[stratum]" ) {
+    StratumServer::Options options;
+    options.difficulty = 1e-9;
+    options.maxJobShares = 4;
+    StratumServer server(options, StratumServer::BlockFoundFn());
+    std::string error;
+    REQUIRE(server.Start(error));
+    server.UpdateTemplate(MakeTemplate(0x1d00ffff, 1));
+
+    TestMiner miner(server.GetPort());
+    REQUIRE(miner.connected);
+    miner.Call(1, "mining.subscribe", json::array({"test/1.0"}));
+    std::string extranonce1 = miner.Response(1)["result"][1];
+    miner.Call(2, "mining.authorize", json::array({"worker", "x"}));
+    REQUIRE(miner.Response(2)["result"] == true);
+    std::string firstJob = miner.notify[0];
+
+    // Three of four shares fill the history far enough for a renewal.
+    const char* extranonce2[] = {"00000001", "00000002", "00000003"};
+    for (int i = 0; i < 3; i++) {
+        miner.Call(3 + i, "mining.submit", miner.Solve(extranonce1, extranonce2[i],
+            StratumDifficultyToTarget(options.difficulty)));
+        REQUIRE(miner.Response(3 + i)["result"] == true);
+    }
+    while (miner.notify[0] == firstJob)
+        REQUIRE(!miner.Read().is_discarded());
+    REQUIRE(miner.notify[8] == false);
+
+    // Work from the renewed job hashes differently, so the same extranonce
+    // counts again.
+    json share = miner.Solve(extranonce1, extranonce2[0], StratumDifficultyToTarget(options.difficulty));
+    miner.Call(6, "mining.submit", share);
+    REQUIRE(miner.Response(6)["result"] == true);
+    REQUIRE(server.GetStats().sharesAccepted == 4);
+    server.Stop();
+}
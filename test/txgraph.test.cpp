@@ -0,0 +1,154 @@
+#include "../include/catch2/catch.hpp"
+#include "../OneCoin/coins.h"
+#include "../OneCoin/txgraph.h"
+#include "../OneCoin/workqueue.h"
+
+#include <atomic>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+OutPoint RandomOutPoint(std::mt19937& rng)
+{
+    unsigned char hash[32];
+    for (int i = 0; i < 32; i++)
+        hash[i] = (unsigned char)rng();
+    return OutPoint(uint256(hash), rng() % 4);
+}
+
+TransactionRef Tx(const std::vector<OutPoint>& prevouts, uint32_t nLockTime = 0)
+{
+    MutableTransaction tx;
+    for (size_t i = 0; i < prevouts.size(); i++)
+        tx.vin.push_back(TxIn(prevouts[i]));
+    tx.vout.push_back(TxOut(COIN, Script() << OP_TRUE));
+    tx.vout.push_back(TxOut(COIN, Script() << OP_TRUE));
+    tx.nLockTime = nLockTime;
+    return MakeTransactionRef(tx);
+}
+
+OutPoint Out(const TransactionRef& tx, uint32_t n) { return OutPoint(tx->GetHash(), n); }
+
+} // namespace
+
+TEST_CASE( "BLOCK TRANSACTIONS ARE GROUPED BY THE COINS THEY SHARE", "[txgraph]" ) {
+    std::mt19937 rng(3);
+    OutPoint shared = RandomOutPoint(rng);
+    std::vector<TransactionRef> vtx;
+    MutableTransaction coinbase;
+    coinbase.vin.push_back(TxIn(OutPoint()));
+    coinbase.vout.push_back(TxOut(50 * COIN, Script() << OP_TRUE));
+    vtx.push_back(MakeTransactionRef(coinbase));
+    vtx.push_back(Tx(std::vector<OutPoint>(1, RandomOutPoint(rng))));                 // 1
+    vtx.push_back(Tx(std::vector<OutPoint>(1, RandomOutPoint(rng))));                 // 2
+    vtx.push_back(Tx(std::vector<OutPoint>(1, Out(vtx[1], 0))));                      // 3: spends 1
+    vtx.push_back(Tx(std::vector<OutPoint>(1, shared)));                              // 4
+    vtx.push_back(Tx(std::vector<OutPoint>(1, RandomOutPoint(rng))));                 // 5
+    vtx.push_back(Tx(std::vector<OutPoint>(1, shared), 1));                           // 6: conflicts with 4
+    std::vector<OutPoint> joined;
+    joined.push_back(Out(vtx[3], 1));
+    joined.push_back(Out(vtx[5], 0));
+    vtx.push_back(Tx(joined));                                                        // 7: joins 1 and 5
+    TransactionRef later = Tx(std::vector<OutPoint>(1, Out(vtx[0], 0)));
+    vtx.push_back(Tx(std::vector<OutPoint>(1, Out(later, 1))));                       // 8: spends 9
+    vtx.push_back(later);                                                             // 9: spends the coinbase
+
+    BlockTxGraph graph;
+    BuildBlockTxGraph(vtx, graph);
+    std::vector<std::vector<uint32_t> > expect;
+    expect.push_back(std::vector<uint32_t>{1, 3, 5, 7});
+    expect.push_back(std::vector<uint32_t>{2});
+    expect.push_back(std::vector<uint32_t>{4, 6});
+    expect.push_back(std::vector<uint32_t>{8, 9});
+    REQUIRE(graph.groups == expect);
+    REQUIRE(graph.nInBlockSpends == 4);
+    REQUIRE(graph.LargestGroup() == 4);
+
+    // A block with only a coinbase has nothing to group.
+    vtx.resize(1);
+    BuildBlockTxGraph(vtx, graph);
+    REQUIRE(graph.groups.empty());
+}
+
+TEST_CASE( "WORKER POOL RUNS EVERY TASK ONCE", "[txgraph]" ) {
+    WorkerPool pool(4);
+    for (int round = 0; round < 20; round++) {
+        std::vector<std::atomic<int> > counts(round * 37 + 1);
+        for (size_t i = 0; i < counts.size(); i++)
+            counts[i] = 0;
+        pool.Run(counts.size(), [&](size_t i) { counts[i]++; });
+        for (size_t i = 0; i < counts.size(); i++)
+            REQUIRE(counts[i] == 1);
+    }
+
+    // A throwing task does not stop the others; Run() rethrows after them.
+    std::atomic<int> nRun(0);
+    REQUIRE_THROWS_AS(pool.Run(100, [&](size_t i) {
+        nRun++;
+        if (i == 50)
+            throw std::runtime_error("task failed");
+    }), const std::runtime_error&);
+    REQUIRE(nRun == 100);
+    pool.Run(0, [&](size_t) { nRun++; });
+    REQUIRE(nRun == 100);
+}
+
+TEST_CASE( "SHARDED COINS VIEW MATCHES AN IN-ORDER ONE", "[txgraph]" ) {
+    std::mt19937 rng(11);
+    CoinsViewMemory memory, reference;
+    CoinsViewCache base(&memory), referenceBase(&reference);
+    std::vector<OutPoint> outpoints;
+    for (int i = 0; i < 2000; i++) {
+        OutPoint outpoint = RandomOutPoint(rng);
+        base.AddCoin(outpoint, Coin(TxOut(i + 1, Script() << OP_TRUE), i, false), false);
+        referenceBase.AddCoin(outpoint, Coin(TxOut(i + 1, Script() << OP_TRUE), i, false), false);
+        outpoints.push_back(outpoint);
+    }
+    base.Flush();
+    referenceBase.Flush();
+
+    // Each task spends its own slice and adds new coins, some of which it
+    // spends again.
+    const size_t nTasks = 40, nSlice = outpoints.size() / nTasks;
+    // Catch assertions are not thread-safe; failed spends are counted.
+    std::atomic<int> nFailed(0);
+    auto apply = [&](CoinsView& view, size_t nTask) {
+        CoinsViewCache local(&view);
+        for (size_t i = nTask * nSlice; i < (nTask + 1) * nSlice; i++) {
+            Coin coin;
+            if (!local.SpendCoin(outpoints[i], &coin))
+                nFailed++;
+            OutPoint created(outpoints[i].hash, outpoints[i].n + 100);
+            local.AddCoin(created, std::move(coin), false);
+            if (i % 3 == 0 && !local.SpendCoin(created))
+                nFailed++;
+        }
+        local.Flush();
+    };
+
+    CoinsViewCache blockView(&memory);
+    CoinsViewSharded sharded(&blockView, 16);
+    WorkerPool pool(4);
+    pool.Run(nTasks, [&](size_t nTask) { apply(sharded, nTask); });
+    sharded.Flush();
+    blockView.Flush();
+
+    CoinsViewCache referenceView(&reference);
+    for (size_t nTask = 0; nTask < nTasks; nTask++)
+        apply(referenceView, nTask);
+    referenceView.Flush();
+    REQUIRE(nFailed == 0);
+
+    REQUIRE(memory.GetCoinCount() == reference.GetCoinCount());
+    for (size_t i = 0; i < outpoints.size(); i++) {
+        OutPoint created(outpoints[i].hash, outpoints[i].n + 100);
+        Coin a, b;
+        REQUIRE(memory.GetCoin(outpoints[i], a) == reference.GetCoin(outpoints[i], b));
+        REQUIRE(memory.GetCoin(created, a) == reference.GetCoin(created, b));
+        REQUIRE(a.out == b.out);
+        REQUIRE(a.nHeight == b.nHeight);
+        REQUIRE(memory.HaveCoin(created) == (i % 3 != 0));
+    }
+}
@@ -0,0 +1,159 @@
+#include "../include/catch2/catch.hpp"
+#include "indexutil.h"
+#include "../OneCoin/fs.h"
+#include "../OneCoin/merkle.h"
+#include "../OneCoin/miner.h"
+#include "../OneCoin/pow.h"
+#include "../OneCoin/txindex.h"
+#include "../OneCoin/validation.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+namespace {
+
+TransactionRef Spend(const OutPoint& prevout, Amount value)
+{
+    MutableTransaction tx;
+    tx.vin.push_back(TxIn(prevout));
+    tx.vout.push_back(TxOut(value, Script() << OP_TRUE));
+    return MakeTransactionRef(tx);
+}
+
+/** Every transaction of the active chain is found in its block. */
+void RequireIndexed(const TxIndex& txindex, Chainstate& chainstate)
+{
+    const ActiveChain& chain = chainstate.GetActiveChain();
+    for (int nHeight = 0; nHeight <= chain.Height(); nHeight++) {
+        Block block;
+        REQUIRE(chainstate.GetBlockStore().ReadBlock(chain[nHeight]->blockPos, block));
+        for (size_t i = 0; i < block.vtx.size(); i++) {
+            TransactionRef tx;
+            uint256 hashBlock;
+            REQUIRE(txindex.GetTransaction(block.vtx[i]->GetHash(), tx, hashBlock));
+            REQUIRE(SerializeTransaction(*tx) == SerializeTransaction(*block.vtx[i]));
+            // Coinbases of equal height and fees share a txid across forks.
+            if (i > 0)
+                REQUIRE(hashBlock == chain[nHeight]->GetBlockHash());
+        }
+    }
+}
+
+uint256 BlockOf(const TxIndex& txindex, const uint256& txid)
+{
+    TransactionRef tx;
+    uint256 hashBlock;
+    REQUIRE(txindex.GetTransaction(txid, tx, hashBlock));
+    return hashBlock;
+}
+
+} // namespace
+
+TEST_CASE( "TXINDEX CATCHES UP, FOLLOWS NEW BLOCKS AND RESUMES", "[txindex]" ) {
+    TempDir dir;
+    Chainstate chainstate(RegTestParams(), dir.path);
+    std::string error;
+    REQUIRE(chainstate.Load(error));
+    ValidationState state;
+    REQUIRE(GenerateBlocks(chainstate, Script() << OP_TRUE, COINBASE_MATURITY + 1, state).size() == 101);
+    // A block of several transactions, so entries carry offsets past the
+    // coinbase.
+    std::vector<TransactionRef> txs;
+    txs.push_back(Spend(CoinbaseAt(chainstate, 1), 49 * COIN));
+    txs.push_back(Spend(CoinbaseAt(chainstate, 2), 49 * COIN));
+    txs.push_back(Spend(OutPoint(txs[0]->GetHash(), 0), 48 * COIN));
+    REQUIRE(chainstate.ProcessNewBlock(MineBlock(chainstate.Tip(), txs), state));
+    REQUIRE(chainstate.Height() == 102);
+
+    std::string indexDir = dir.path + "/indexes/txindex";
+    {
+        TxIndex txindex(indexDir, chainstate);
+        REQUIRE(txindex.Start(error));
+        REQUIRE(!txindex.Start(error));
+        RequireSynced(txindex, chainstate);
+        RequireIndexed(txindex, chainstate);
+        TxIndexEntry entry;
+        REQUIRE(txindex.FindTx(txs[2]->GetHash(), entry));
+        REQUIRE(entry.blockPos.nFile == chainstate.Tip()->blockPos.nFile);
+        REQUIRE(entry.blockPos.nPos == chainstate.Tip()->blockPos.nPos);
+        REQUIRE(entry.nTxSize == txs[2]->GetTotalSize());
+        REQUIRE(!txindex.FindTx(uint256::FromHex("01"), entry));
+
+        // Blocks connected while running are followed.
+        txs.assign(1, Spend(CoinbaseAt(chainstate, 3), 49 * COIN));
+        REQUIRE(chainstate.ProcessNewBlock(MineBlock(chainstate.Tip(), txs), state));
+        REQUIRE(GenerateBlocks(chainstate, Script() << OP_TRUE, 20, state).size() == 20);
+        RequireSynced(txindex, chainstate);
+        REQUIRE(BlockOf(txindex, txs[0]->GetHash()) == chainstate.GetActiveChain()[103]->GetBlockHash());
+        RequireIndexed(txindex, chainstate);
+    }
+
+    // Blocks connected while it was stopped are caught up on the next start.
+    txs.assign(1, Spend(CoinbaseAt(chainstate, 5), 49 * COIN));
+    REQUIRE(chainstate.ProcessNewBlock(MineBlock(chainstate.Tip(), txs), state));
+    REQUIRE(GenerateBlocks(chainstate, Script() << OP_TRUE, 10, state).size() == 10);
+    TxIndex txindex(indexDir, chainstate);
+    REQUIRE(txindex.Start(error));
+    RequireSynced(txindex, chainstate);
+    REQUIRE(BlockOf(txindex, txs[0]->GetHash()) == chainstate.GetActiveChain()[124]->GetBlockHash());
+    RequireIndexed(txindex, chainstate);
+}
+
+TEST_CASE( "TXINDEX FOLLOWS REORGS AND REWINDS A STALE BEST BLOCK", "[txindex]" ) {
+    TempDir dir;
+    Chainstate chainstate(RegTestParams(), dir.path);
+    std::string error;
+    REQUIRE(chainstate.Load(error));
+    ValidationState state;
+    REQUIRE(GenerateBlocks(chainstate, Script() << OP_TRUE, COINBASE_MATURITY + 1, state).size() == 101);
+    const BlockIndex* pindexFork = chainstate.Tip();
+    TransactionRef a = Spend(CoinbaseAt(chainstate, 1), 49 * COIN);
+    TransactionRef b = Spend(CoinbaseAt(chainstate, 2), 49 * COIN);
+    Block blockA = MineBlock(pindexFork, std::vector<TransactionRef>(1, a));
+    REQUIRE(chainstate.ProcessNewBlock(blockA, state));
+
+    std::string indexDir = dir.path + "/indexes/txindex";
+    {
+        TxIndex txindex(indexDir, chainstate);
+        REQUIRE(txindex.Start(error));
+        RequireSynced(txindex, chainstate);
+        REQUIRE(BlockOf(txindex, a->GetHash()) == blockA.GetHash());
+
+        // A longer branch without a: a keeps pointing at its stale block.
+        Block blockB1 = MineBlock(pindexFork, std::vector<TransactionRef>(1, b));
+        REQUIRE(chainstate.ProcessNewBlock(blockB1, state));
+        Block blockB2 = MineBlock(chainstate.LookupBlockIndex(blockB1.GetHash()), std::vector<TransactionRef>());
+        REQUIRE(chainstate.ProcessNewBlock(blockB2, state));
+        REQUIRE(chainstate.Tip()->GetBlockHash() == blockB2.GetHash());
+        RequireSynced(txindex, chainstate);
+        REQUIRE(BlockOf(txindex, b->GetHash()) == blockB1.GetHash());
+        REQUIRE(BlockOf(txindex, a->GetHash()) == blockA.GetHash());
+        RequireIndexed(txindex, chainstate);
+    }
+
+    // Back to a's branch while stopped: the index's best block left the
+    // chain, so the next start rewinds to the fork.
+    const BlockIndex* pindexA = chainstate.LookupBlockIndex(blockA.GetHash());
+    Block blockA2 = MineBlock(pindexA, std::vector<TransactionRef>());
+    REQUIRE(chainstate.ProcessNewBlock(blockA2, state));
+    Block blockA3 = MineBlock(chainstate.LookupBlockIndex(blockA2.GetHash()), std::vector<TransactionRef>());
+    REQUIRE(chainstate.ProcessNewBlock(blockA3, state));
+    REQUIRE(chainstate.Tip()->GetBlockHash() == blockA3.GetHash());
+    TxIndex txindex(indexDir, chainstate);
+    REQUIRE(txindex.Start(error));
+    RequireSynced(txindex, chainstate);
+    REQUIRE(BlockOf(txindex, a->GetHash()) == blockA.GetHash());
+    RequireIndexed(txindex, chainstate);
+}
+
+TEST_CASE( "TXINDEX IS REFUSED IN PRUNE MODE", "[txindex]" ) {
+    TempDir dir;
+    Chainstate chainstate(RegTestParams(), dir.path);
+    chainstate.SetPruneTarget(MIN_PRUNE_TARGET);
+    std::string error;
+    REQUIRE(chainstate.Load(error));
+    TxIndex txindex(dir.path + "/indexes/txindex", chainstate);
+    REQUIRE(!txindex.Start(error));
+    REQUIRE(!txindex.IsSynced());
+    REQUIRE(!txindex.WaitForSync(error));
+}
@@ -0,0 +1,220 @@
+#include "../include/catch2/catch.hpp"
+#include "../OneCoin/txorphanage.h"
+
+#include <algorithm>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+/** A random transaction DAG: each transaction spends outputs of earlier
+ *  ones, or of the funding outpoints, and every output is spent once. */
+std::vector<TransactionRef> MakeTxDag(std::mt19937& rng, size_t nTxs, std::vector<OutPoint>& funding)
+{
+    std::vector<OutPoint> unspent;
+    for (uint32_t i = 0; i < 64; i++) {
+        unsigned char hash[32] = {0xf0, (unsigned char)i};
+        funding.push_back(OutPoint(uint256(hash), i));
+    }
+    unspent = funding;
+    std::vector<TransactionRef> txs;
+    for (size_t i = 0; i < nTxs; i++) {
+        MutableTransaction tx;
+        size_t nIn = std::min<size_t>(rng() % 3 + 1, unspent.size());
+        for (size_t j = 0; j < nIn; j++) {
+            size_t pick = rng() % unspent.size();
+            tx.vin.push_back(TxIn(unspent[pick]));
+            unspent[pick] = unspent.back();
+            unspent.pop_back();
+        }
+        size_t nOut = rng() % 3 + 1;
+        for (size_t j = 0; j < nOut; j++)
+            tx.vout.push_back(TxOut(1000, Script() << OP_TRUE));
+        txs.push_back(MakeTransactionRef(tx));
+        for (size_t j = 0; j < nOut; j++)
+            unspent.push_back(OutPoint(txs.back()->GetHash(), (uint32_t)j));
+    }
+    return txs;
+}
+
+/** Stands in for the mempool: accepts a transaction once every coin it
+ *  spends is available, and then resolves its waiting children. */
+struct Acceptor {
+    TxOrphanage& orphanage;
+    std::unordered_set<OutPoint, OutPointHasher> available;
+    size_t nAccepted;
+    size_t nRetries;
+
+    Acceptor(TxOrphanage& orphanage, const std::vector<OutPoint>& funding)
+        : orphanage(orphanage), available(funding.begin(), funding.end()), nAccepted(0), nRetries(0) {}
+
+    bool TryAccept(const Transaction& tx)
+    {
+        for (size_t i = 0; i < tx.vin.size(); i++) {
+            if (!available.count(tx.vin[i].prevout))
+                return false;
+        }
+        for (size_t i = 0; i < tx.vin.size(); i++)
+            available.erase(tx.vin[i].prevout);
+        for (size_t i = 0; i < tx.vout.size(); i++)
+            available.insert(OutPoint(tx.GetHash(), (uint32_t)i));
+        nAccepted++;
+        return true;
+    }
+
+    void Receive(const TransactionRef& tx, NodeId peer)
+    {
+        if (!TryAccept(*tx)) {
+            orphanage.AddTx(tx, peer);
+            return;
+        }
+        std::vector<TransactionRef> work(1, tx), children;
+        while (!work.empty()) {
+            TransactionRef parent = work.back();
+            work.pop_back();
+            orphanage.GetChildren(*parent, children);
+            for (size_t i = 0; i < children.size(); i++) {
+                nRetries++;
+                if (TryAccept(*children[i])) {
+                    orphanage.EraseTx(children[i]->GetHash());
+                    work.push_back(children[i]);
+                }
+            }
+        }
+    }
+};
+
+} // namespace
+
+TEST_CASE( "ORPHANS RESOLVE WHEN THEIR PARENTS ARRIVE", "[txorphanage]" ) {
+    std::mt19937 rng(3);
+    std::vector<OutPoint> funding;
+    std::vector<TransactionRef> txs = MakeTxDag(rng, 5000, funding);
+    size_t nInputs = 0;
+    for (size_t i = 0; i < txs.size(); i++)
+        nInputs += txs[i]->vin.size();
+
+    // Reversed order makes nearly everything an orphan; shuffled is a burst
+    // of relay; each gets a fresh pool with room for all of it.
+    for (int order = 0; order < 2; order++) {
+        std::vector<TransactionRef> arrivals(txs);
+        if (order == 0)
+            std::reverse(arrivals.begin(), arrivals.end());
+        else
+            std::shuffle(arrivals.begin(), arrivals.end(), rng);
+        TxOrphanage orphanage(100000000, 100000000, 7);
+        Acceptor acceptor(orphanage, funding);
+        size_t nMaxOrphans = 0;
+        for (size_t i = 0; i < arrivals.size(); i++) {
+            acceptor.Receive(arrivals[i], (NodeId)(rng() % 8));
+            nMaxOrphans = std::max(nMaxOrphans, orphanage.Size());
+        }
+        REQUIRE(acceptor.nAccepted == txs.size());
+        REQUIRE(orphanage.Size() == 0);
+        REQUIRE(orphanage.TotalUsage() == 0);
+        REQUIRE(orphanage.EvictedCount() == 0);
+        REQUIRE(nMaxOrphans > txs.size() / 4);
+        // Each orphan is retried only when one of its parents arrives.
+        REQUIRE(acceptor.nRetries <= nInputs);
+    }
+}
+
+TEST_CASE( "ORPHAN POOL STAYS WITHIN ITS BOUNDS", "[txorphanage]" ) {
+    std::mt19937 rng(11);
+    std::vector<OutPoint> funding;
+    std::vector<TransactionRef> txs = MakeTxDag(rng, 4000, funding);
+    std::reverse(txs.begin(), txs.end());
+    const size_t nMaxBytes = 100000, nMaxPeerBytes = 20000;
+    TxOrphanage orphanage(nMaxBytes, nMaxPeerBytes, 5);
+
+    // Peer 0 floods; peers 1-9 trickle.
+    for (size_t i = 0; i < txs.size(); i++) {
+        NodeId peer = i % 2 == 0 ? 0 : (NodeId)(rng() % 9 + 1);
+        if (orphanage.AddTx(txs[i], peer))
+            REQUIRE(!orphanage.AddTx(txs[i], peer));
+        REQUIRE(orphanage.TotalUsage() <= nMaxBytes);
+        REQUIRE(orphanage.PeerUsage(peer) <= nMaxPeerBytes);
+    }
+    REQUIRE(orphanage.EvictedCount() + orphanage.Size() == txs.size());
+    REQUIRE(orphanage.PeerUsage(0) <= nMaxPeerBytes);
+    REQUIRE(orphanage.TotalUsage() > nMaxBytes - nMaxPeerBytes);
+
+    // The index only ever names orphans still held.
+    std::vector<TransactionRef> children;
+    size_t nIndexed = 0;
+    for (size_t i = 0; i < txs.size(); i++) {
+        orphanage.GetChildren(*txs[i], children);
+        for (size_t j = 0; j < children.size(); j++)
+            REQUIRE(orphanage.HaveTx(children[j]->GetHash()));
+        nIndexed += children.size();
+    }
+    REQUIRE(nIndexed > 0);
+
+    size_t nHeld = orphanage.Size();
+    size_t nErased = 0;
+    for (NodeId peer = 0; peer < 10; peer++) {
+        nErased += orphanage.EraseForPeer(peer);
+        REQUIRE(orphanage.PeerUsage(peer) == 0);
+    }
+    REQUIRE(nErased == nHeld);
+    REQUIRE(orphanage.Size() == 0);
+    REQUIRE(orphanage.TotalUsage() == 0);
+    for (size_t i = 0; i < txs.size(); i++) {
+        orphanage.GetChildren(*txs[i], children);
+        REQUIRE(children.empty());
+    }
+
+    // Oversized transactions are never held.
+    MutableTransaction big;
+    big.vin.push_back(TxIn(funding[0]));
+    big.vout.push_back(TxOut(1, Script(std::vector<unsigned char>(MAX_ORPHAN_TX_SIZE, OP_TRUE))));
+    REQUIRE(!orphanage.AddTx(MakeTransactionRef(big), 1));
+    TxOrphanage roomy(10000000, 10000000, 1);
+    REQUIRE(!roomy.AddTx(MakeTransactionRef(big), 1));
+}
+
+TEST_CASE( "BLOCKS CLEAR INCLUDED AND CONFLICTING ORPHANS", "[txorphanage]" ) {
+    std::mt19937 rng(17);
+    std::vector<OutPoint> funding;
+    std::vector<TransactionRef> txs = MakeTxDag(rng, 200, funding);
+    TxOrphanage orphanage(10000000, 10000000, 2);
+    for (size_t i = 0; i < txs.size(); i++)
+        REQUIRE(orphanage.AddTx(txs[i], (NodeId)(i % 3)));
+    REQUIRE(orphanage.GetTx(txs[10]->GetHash()) == txs[10]);
+
+    // A parent with an orphan child gets every child once.
+    std::vector<TransactionRef> children;
+    size_t nWithChildren = 0;
+    for (size_t i = 0; i < txs.size(); i++) {
+        orphanage.GetChildren(*txs[i], children);
+        std::unordered_set<uint256, Uint256Hasher> unique;
+        for (size_t j = 0; j < children.size(); j++) {
+            REQUIRE(unique.insert(children[j]->GetHash()).second);
+            bool fSpends = false;
+            for (size_t k = 0; k < children[j]->vin.size(); k++)
+                fSpends |= children[j]->vin[k].prevout.hash == txs[i]->GetHash();
+            REQUIRE(fSpends);
+        }
+        nWithChildren += !children.empty();
+    }
+    REQUIRE(nWithChildren > 0);
+
+    // txs[20] is in the block; a double spend of txs[30]'s first input
+    // conflicts with it.
+    Block block;
+    MutableTransaction coinbase;
+    coinbase.vin.push_back(TxIn(OutPoint()));
+    coinbase.vout.push_back(TxOut(1, Script() << OP_TRUE));
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+    block.vtx.push_back(txs[20]);
+    MutableTransaction conflict;
+    conflict.vin.push_back(TxIn(txs[30]->vin[0].prevout));
+    conflict.vout.push_back(TxOut(1, Script() << OP_TRUE));
+    block.vtx.push_back(MakeTransactionRef(conflict));
+    REQUIRE(orphanage.EraseForBlock(block) == 2);
+    REQUIRE(!orphanage.HaveTx(txs[20]->GetHash()));
+    REQUIRE(!orphanage.HaveTx(txs[30]->GetHash()));
+    REQUIRE(orphanage.Size() == txs.size() - 2);
+    REQUIRE(orphanage.EraseForBlock(block) == 0);
+}
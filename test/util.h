@@ -0,0 +1,31 @@
+#ifndef ONECOIN_TEST_UTIL_H
+#define ONECOIN_TEST_UTIL_H
+
+#include "../OneCoin/chainparams.h"
+#include "../OneCoin/fs.h"
+
+#include <stdlib.h>
+#include <memory>
+#include <string>
+
+/** Fixtures shared by the test files. */
+
+inline const ChainParams& RegTestParams()
+{
+    static std::unique_ptr<const ChainParams> params = CreateChainParams("regtest");
+    return *params;
+}
+
+/** A scratch directory removed on destruction. */
+struct TempDir {
+    std::string path;
+
+    TempDir()
+    {
+        char tmpl[] = "/tmp/onecoin_test_XXXXXX";
+        path = mkdtemp(tmpl);
+    }
+    ~TempDir() { RemoveAll(path); }
+};
+
+#endif // ONECOIN_TEST_UTIL_H
@@ -0,0 +1,956 @@
+#include "../include/catch2/catch.hpp"
+#include "util.h"
+#include "../OneCoin/chaingen.h"
+#include "../OneCoin/fs.h"
+#include "../OneCoin/hash.h"
+#include "../OneCoin/interpreter.h"
+#include "../OneCoin/merkle.h"
+#include "../OneCoin/miner.h"
+#include "../OneCoin/pow.h"
+#include "../OneCoin/validation.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+namespace {
+
+/** Mines a block with txs on top of pindexPrev, which need not be the tip. */
+Block MineBlock(const BlockIndex* pindexPrev, const std::vector<TransactionRef>& txs, Amount nFees = 0)
+{
+    const ConsensusParams& consensus = RegTestParams().GetConsensus();
+    BlockTemplate tmpl = BlockAssembler(RegTestParams()).CreateNewBlock(pindexPrev->GetBlockHash(),
+        pindexPrev->nHeight + 1, GetNextWorkRequired(pindexPrev, consensus),
+        GetNextBlockTime(pindexPrev, consensus, time(NULL)), pindexPrev->GetMedianTimePast() + 1,
+        Script() << OP_TRUE, txs, std::vector<Amount>(txs.size(), txs.empty() ? 0 : nFees / (Amount)txs.size()));
+    while (!CheckProofOfWork(tmpl.block.GetHash(), tmpl.block.nBits, consensus))
+        tmpl.block.nNonce++;
+    return tmpl.block;
+}
+
+void Remine(Block& block)
+{
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    while (!CheckProofOfWork(block.GetHash(), block.nBits, RegTestParams().GetConsensus()))
+        block.nNonce++;
+}
+
+TransactionRef Spend(const OutPoint& prevout, Amount value)
+{
+    MutableTransaction tx;
+    tx.vin.push_back(TxIn(prevout));
+    tx.vout.push_back(TxOut(value, Script() << OP_TRUE));
+    return MakeTransactionRef(tx);
+}
+
+OutPoint CoinbaseAt(Chainstate& chainstate, int nHeight)
+{
+    const BlockIndex* pindex = chainstate.Tip()->GetAncestor(nHeight);
+    Block block;
+    REQUIRE(chainstate.GetBlockStore().ReadBlock(pindex->blockPos, block));
+    return OutPoint(block.vtx[0]->GetHash(), 0);
+}
+
+void CopyDirectory(const std::string& from, const std::string& to)
+{
+    std::vector<std::string> names;
+    REQUIRE(ListDirectory(from, names));
+    REQUIRE(CreateDirectories(to));
+    for (size_t i = 0; i < names.size(); i++) {
+        std::vector<unsigned char> data;
+        REQUIRE(ReadFile(from + "/" + names[i], data));
+        REQUIRE(ReplaceFile(to + "/" + names[i], data));
+    }
+}
+
+}
+
+TEST_CASE( "REGTEST GENERATE BUILDS AND RELOADS A CHAIN", "[validation]" ) {
+    TempDir dir;
+    uint256 tip;
+    {
+        Chainstate chainstate(RegTestParams(), dir.path);
+        std::string error;
+        REQUIRE(chainstate.Load(error));
+        REQUIRE(chainstate.Height() == 0);
+        REQUIRE(chainstate.Tip()->GetBlockHash() == RegTestParams().GenesisBlock().GetHash());
+
+        ValidationState state;
+        std::vector<uint256> hashes = GenerateBlocks(chainstate, Script() << OP_TRUE, 300, state);
+        REQUIRE(state.IsValid());
+        REQUIRE(hashes.size() == 300);
+        REQUIRE(chainstate.Height() == 300);
+        REQUIRE(chainstate.Tip()->GetBlockHash() == hashes.back());
+        chainstate.Flush();
+        REQUIRE(chainstate.CoinsTip().GetCoinCount() == 300);
+        // Halvings every 150 blocks on regtest.
+        REQUIRE(chainstate.CoinsTip().AccessCoin(CoinbaseAt(chainstate, 150)).out.nValue == 25 * COIN);
+        REQUIRE(chainstate.CoinsTip().AccessCoin(CoinbaseAt(chainstate, 149)).out.nValue == 50 * COIN);
+        // Block times stay above the median of their predecessors.
+        for (const BlockIndex* pindex = chainstate.Tip(); pindex->pprev; pindex = pindex->pprev)
+            REQUIRE(pindex->GetBlockTime() > pindex->pprev->GetMedianTimePast());
+        tip = chainstate.Tip()->GetBlockHash();
+    }
+
+    // Either coins backend rebuilds the same set.
+    const CoinsBackend backends[] = {COINS_BACKEND_LOG, COINS_BACKEND_LSM};
+    for (int i = 0; i < 2; i++) {
+        Chainstate reloaded(RegTestParams(), dir.path);
+        reloaded.SetCoinsBackend(backends[i]);
+        std::string error;
+        REQUIRE(reloaded.Load(error));
+        REQUIRE(reloaded.Height() == 300);
+        REQUIRE(reloaded.Tip()->GetBlockHash() == tip);
+        reloaded.Flush();
+        REQUIRE(reloaded.CoinsTip().GetCoinCount() == 300);
+        REQUIRE(reloaded.CoinsTip().AccessCoin(CoinbaseAt(reloaded, 150)).out.nValue == 25 * COIN);
+    }
+}
+
+TEST_CASE( "LSM COINS ARE KEPT ACROSS RESTARTS AND CATCH UP WITH THE INDEX", "[validation]" ) {
+    TempDir dir;
+    std::string coinsDir = dir.path + "/chainstate";
+    std::string error;
+    ValidationState state;
+    {
+        Chainstate chainstate(RegTestParams(), dir.path);
+        chainstate.SetCoinsBackend(COINS_BACKEND_LSM);
+        REQUIRE(chainstate.Load(error));
+        REQUIRE(GenerateBlocks(chainstate, Script() << OP_TRUE, 150, state).size() == 150);
+    }
+    CopyDirectory(coinsDir, dir.path + "/saved");
+    uint256 tip;
+    {
+        Chainstate chainstate(RegTestParams(), dir.path);
+        chainstate.SetCoinsBackend(COINS_BACKEND_LSM);
+        REQUIRE(chainstate.Load(error));
+        REQUIRE(chainstate.Height() == 150);
+        // The coins were there already, so nothing was connected.
+        REQUIRE(chainstate.GetConnectStats().nScriptChecked == 0);
+        REQUIRE(chainstate.GetConnectStats().nReconnected == 0);
+        REQUIRE(chainstate.CoinsDB().GetCoinCount() == 150);
+        REQUIRE(GenerateBlocks(chainstate, Script() << OP_TRUE, 50, state).size() == 50);
+        tip = chainstate.Tip()->GetBlockHash();
+    }
+
+    // A crash after the index was saved and before the coins were leaves
+    // them behind it; the blocks in between are connected again.
+    REQUIRE(RemoveAll(coinsDir));
+    CopyDirectory(dir.path + "/saved", coinsDir);
+    {
+        Chainstate chainstate(RegTestParams(), dir.path);
+        chainstate.SetCoinsBackend(COINS_BACKEND_LSM);
+        REQUIRE(chainstate.Load(error));
+        REQUIRE(chainstate.Tip()->GetBlockHash() == tip);
+        REQUIRE(chainstate.GetConnectStats().nReconnected == 50);
+        REQUIRE(chainstate.GetConnectStats().nScriptChecked == 0);
+        chainstate.Flush();
+        REQUIRE(chainstate.CoinsDB().GetBestBlock() == tip);
+        REQUIRE(chainstate.CoinsDB().GetCoinCount() == 200);
+    }
+
+    // Coins the index does not reach are not used.
+    {
+        Chainstate other(RegTestParams(), dir.path + "/other");
+        other.SetCoinsBackend(COINS_BACKEND_LSM);
+        REQUIRE(other.Load(error));
+        REQUIRE(GenerateBlocks(other, Script() << OP_DUP, 1, state).size() == 1);
+    }
+    std::vector<unsigned char> data;
+    REQUIRE(ReadFile(dir.path + "/other/blocks/index.dat", data));
+    REQUIRE(ReplaceFile(dir.path + "/blocks/index.dat", data));
+    Chainstate mismatched(RegTestParams(), dir.path);
+    mismatched.SetCoinsBackend(COINS_BACKEND_LSM);
+    REQUIRE(!mismatched.Load(error));
+    REQUIRE(error.find("not in") != std::string::npos);
+}
+
+TEST_CASE( "COINBASE MATURITY AND DOUBLE SPENDS", "[validation]" ) {
+    TempDir dir;
+    Chainstate chainstate(RegTestParams(), dir.path);
+    std::string error;
+    REQUIRE(chainstate.Load(error));
+    ValidationState state;
+    REQUIRE(GenerateBlocks(chainstate, Script() << OP_TRUE, COINBASE_MATURITY + 1, state).size() == 101);
+
+    // The next block is at height 102: coinbases up to height 2 are mature.
+    OutPoint mature = CoinbaseAt(chainstate, 2);
+    OutPoint immature = CoinbaseAt(chainstate, 3);
+
+    Block premature = MineBlock(chainstate.Tip(), std::vector<TransactionRef>(1, Spend(immature, 49 * COIN)));
+    REQUIRE(!chainstate.ProcessNewBlock(premature, state));
+    REQUIRE(state.GetRejectReason() == "bad-txns-premature-spend-of-coinbase");
+    REQUIRE(chainstate.Height() == 101);
+
+    std::vector<TransactionRef> txs;
+    txs.push_back(Spend(mature, 49 * COIN));
+    txs.push_back(Spend(OutPoint(txs[0]->GetHash(), 0), 48 * COIN));
+    Block good = MineBlock(chainstate.Tip(), txs, 2 * COIN);
+    state = ValidationState();
+    REQUIRE(chainstate.ProcessNewBlock(good, state));
+    REQUIRE(chainstate.Height() == 102);
+    REQUIRE(!chainstate.CoinsTip().HaveCoin(mature));
+    REQUIRE(!chainstate.CoinsTip().HaveCoin(OutPoint(txs[0]->GetHash(), 0)));
+    REQUIRE(chainstate.CoinsTip().AccessCoin(OutPoint(txs[1]->GetHash(), 0)).out.nValue == 48 * COIN);
+    REQUIRE(chainstate.CoinsTip().AccessCoin(OutPoint(good.vtx[0]->GetHash(), 0)).out.nValue == 52 * COIN);
+
+    Block doubleSpend = MineBlock(chainstate.Tip(), std::vector<TransactionRef>(1, Spend(mature, 10 * COIN)));
+    REQUIRE(!chainstate.ProcessNewBlock(doubleSpend, state));
+    REQUIRE(state.GetRejectReason() == "bad-txns-inputs-missingorspent");
+    REQUIRE(chainstate.Height() == 102);
+}
+
+TEST_CASE( "INVALID BLOCKS ARE REJECTED", "[validation]" ) {
+    TempDir dir;
+    Chainstate chainstate(RegTestParams(), dir.path);
+    std::string error;
+    REQUIRE(chainstate.Load(error));
+
+    ValidationState state;
+    Block block = MineBlock(chainstate.Tip(), std::vector<TransactionRef>());
+    block.hashMerkleRoot = uint256();
+    while (!CheckProofOfWork(block.GetHash(), block.nBits, RegTestParams().GetConsensus()))
+        block.nNonce++;
+    REQUIRE(!chainstate.ProcessNewBlock(block, state));
+    REQUIRE(state.GetRejectReason() == "bad-txnmrklroot");
+
+    block = MineBlock(chainstate.Tip(), std::vector<TransactionRef>());
+    MutableTransaction coinbase(*block.vtx[0]);
+    coinbase.vout[0].nValue += 1;
+    block.vtx[0] = MakeTransactionRef(coinbase);
+    Remine(block);
+    state = ValidationState();
+    REQUIRE(!chainstate.ProcessNewBlock(block, state));
+    REQUIRE(state.GetRejectReason() == "bad-cb-amount");
+    // Found only while connecting, so the block is stored and marked failed.
+    uint256 overpaid = block.GetHash();
+    REQUIRE((chainstate.LookupBlockIndex(overpaid)->nStatus & BLOCK_FAILED_VALID) != 0);
+    REQUIRE(!chainstate.ProcessNewBlock(block, state));
+    REQUIRE(state.GetRejectReason() == "duplicate-invalid");
+
+    block = MineBlock(chainstate.Tip(), std::vector<TransactionRef>());
+    coinbase = MutableTransaction(*block.vtx[0]);
+    coinbase.vin[0].scriptSig = Script() << (int64_t)7 << OP_0;
+    block.vtx[0] = MakeTransactionRef(coinbase);
+    Remine(block);
+    state = ValidationState();
+    REQUIRE(!chainstate.ProcessNewBlock(block, state));
+    REQUIRE(state.GetRejectReason() == "bad-cb-height");
+
+    block = MineBlock(chainstate.Tip(), std::vector<TransactionRef>());
+    block.nBits = 0x207ffffe;
+    Remine(block);
+    state = ValidationState();
+    REQUIRE(!chainstate.ProcessNewBlock(block, state));
+    REQUIRE(state.GetRejectReason() == "bad-diffbits");
+
+    block = MineBlock(chainstate.Tip(), std::vector<TransactionRef>());
+    block.nTime = (uint32_t)chainstate.Tip()->GetMedianTimePast();
+    Remine(block);
+    state = ValidationState();
+    REQUIRE(!chainstate.ProcessNewBlock(block, state));
+    REQUIRE(state.GetRejectReason() == "time-too-old");
+
+    block = MineBlock(chainstate.Tip(), std::vector<TransactionRef>());
+    block.hashPrevBlock = uint256::FromHex("01");
+    Remine(block);
+    state = ValidationState();
+    REQUIRE(!chainstate.ProcessNewBlock(block, state));
+    REQUIRE(state.GetRejectReason() == "prev-blk-not-found");
+
+    REQUIRE(chainstate.Height() == 0);
+    REQUIRE(chainstate.BlockIndexSize() == 2);
+}
+
+TEST_CASE( "REORGANIZES TO THE CHAIN WITH MORE WORK", "[validation]" ) {
+    TempDir dir;
+    Chainstate chainstate(RegTestParams(), dir.path);
+    std::string error;
+    REQUIRE(chainstate.Load(error));
+    ValidationState state;
+    REQUIRE(GenerateBlocks(chainstate, Script() << OP_TRUE, 110, state).size() == 110);
+
+    // A spend on the original chain that the fork does not contain.
+    OutPoint spent = CoinbaseAt(chainstate, 5);
+    TransactionRef tx = Spend(spent, 50 * COIN);
+    const BlockIndex* pindexFork = chainstate.Tip();
+    REQUIRE(chainstate.ProcessNewBlock(MineBlock(pindexFork, std::vector<TransactionRef>(1, tx)), state));
+    REQUIRE(chainstate.ProcessNewBlock(MineBlock(chainstate.Tip(), std::vector<TransactionRef>()), state));
+    uint256 oldTip = chainstate.Tip()->GetBlockHash();
+    REQUIRE(chainstate.Height() == 112);
+    REQUIRE(!chainstate.CoinsTip().HaveCoin(spent));
+
+    // Two blocks on the fork tie; the first seen keeps the tip.
+    Block a = MineBlock(pindexFork, std::vector<TransactionRef>());
+    a.nTime++;
+    Remine(a);
+    REQUIRE(chainstate.ProcessNewBlock(a, state));
+    Block b = MineBlock(chainstate.LookupBlockIndex(a.GetHash()), std::vector<TransactionRef>());
+    REQUIRE(chainstate.ProcessNewBlock(b, state));
+    REQUIRE(chainstate.Tip()->GetBlockHash() == oldTip);
+
+    Block c = MineBlock(chainstate.LookupBlockIndex(b.GetHash()), std::vector<TransactionRef>());
+    REQUIRE(chainstate.ProcessNewBlock(c, state));
+    REQUIRE(chainstate.Tip()->GetBlockHash() == c.GetHash());
+    REQUIRE(chainstate.Height() == 113);
+    REQUIRE(chainstate.CoinsTip().HaveCoin(spent));
+    REQUIRE(!chainstate.CoinsTip().HaveCoin(OutPoint(tx->GetHash(), 0)));
+    chainstate.Flush();
+    REQUIRE(chainstate.CoinsTip().GetCoinCount() == 113);
+}
+
+TEST_CASE( "SCRIPTS ARE CHECKED WHEN BLOCKS CONNECT", "[validation]" ) {
+    TempDir dir;
+    Chainstate chainstate(RegTestParams(), dir.path);
+    std::string error;
+    REQUIRE(chainstate.Load(error));
+    ValidationState state;
+    REQUIRE(GenerateBlocks(chainstate, Script() << OP_TRUE, COINBASE_MATURITY + 1, state).size() == 101);
+
+    MutableTransaction locked;
+    locked.vin.push_back(TxIn(CoinbaseAt(chainstate, 1)));
+    locked.vout.push_back(TxOut(49 * COIN, Script() << OP_2 << OP_EQUAL));
+    Block block = MineBlock(chainstate.Tip(), std::vector<TransactionRef>(1, MakeTransactionRef(locked)), COIN);
+    REQUIRE(chainstate.ProcessNewBlock(block, state));
+
+    MutableTransaction unlock;
+    unlock.vin.push_back(TxIn(OutPoint(locked.GetHash(), 0)));
+    unlock.vin[0].scriptSig = Script() << OP_3;
+    unlock.vout.push_back(TxOut(48 * COIN, Script() << OP_TRUE));
+    block = MineBlock(chainstate.Tip(), std::vector<TransactionRef>(1, MakeTransactionRef(unlock)), COIN);
+    REQUIRE(!chainstate.ProcessNewBlock(block, state));
+    REQUIRE(state.GetRejectReason() == std::string("mandatory-script-verify-flag-failed (") +
+        ScriptErrorString(SCRIPT_ERR_EVAL_FALSE) + ")");
+    REQUIRE(chainstate.Height() == 102);
+
+    unlock.vin[0].scriptSig = Script() << OP_2;
+    block = MineBlock(chainstate.Tip(), std::vector<TransactionRef>(1, MakeTransactionRef(unlock)), COIN);
+    state = ValidationState();
+    REQUIRE(chainstate.ProcessNewBlock(block, state));
+    REQUIRE(chainstate.Height() == 103);
+}
+
+TEST_CASE( "PIPELINED REPLAY MATCHES A SERIAL ONE", "[validation]" ) {
+    TempDir dir;
+    ChainGenOptions options;
+    options.seed = 3;
+    options.nHeight = 104;
+    options.nTxPerBlock = 10;
+    options.nMaxChainLength = 3;
+    options.nKeys = 8;
+    ChainManifest manifest;
+    std::string error;
+    REQUIRE(ChainGenerator(RegTestParams(), options).Run(dir.path, manifest, error));
+
+    // Store a block whose only spend has no signature and a valid block
+    // beside it.
+    uint256 invalid, tip;
+    {
+        Chainstate chainstate(RegTestParams(), dir.path);
+        REQUIRE(chainstate.Load(error));
+        Block block = MineBlock(chainstate.Tip(), std::vector<TransactionRef>(1, Spend(CoinbaseAt(chainstate, 5), COIN)));
+        invalid = block.GetHash();
+        ValidationState state;
+        REQUIRE(!chainstate.ProcessNewBlock(block, state));
+        REQUIRE(state.GetRejectReason().find("mandatory-script-verify-flag-failed") == 0);
+
+        block = MineBlock(chainstate.Tip(), std::vector<TransactionRef>());
+        state = ValidationState();
+        REQUIRE(chainstate.ProcessNewBlock(block, state));
+        tip = block.GetHash();
+    }
+
+    size_t nCoins[2];
+    for (int fPipeline = 0; fPipeline < 2; fPipeline++) {
+        Chainstate chainstate(RegTestParams(), dir.path);
+        chainstate.SetReplayPipeline(fPipeline != 0);
+        REQUIRE(chainstate.Load(error));
+        REQUIRE(chainstate.Tip()->GetBlockHash() == tip);
+        REQUIRE(chainstate.Height() == options.nHeight + 1);
+        REQUIRE((chainstate.LookupBlockIndex(invalid)->nStatus & BLOCK_FAILED_VALID) != 0);
+        chainstate.Flush();
+        nCoins[fPipeline] = chainstate.CoinsTip().GetCoinCount();
+    }
+    REQUIRE(nCoins[0] == nCoins[1]);
+    REQUIRE(nCoins[0] > 0);
+}
+
+TEST_CASE( "REINDEX CONNECTS STORED BLOCKS IN HEIGHT ORDER", "[validation]" ) {
+    TempDir dir;
+    ChainGenOptions options;
+    options.seed = 5;
+    options.nHeight = 104;
+    options.nTxPerBlock = 10;
+    options.nKeys = 8;
+    ChainManifest manifest;
+    std::string error;
+    REQUIRE(ChainGenerator(RegTestParams(), options).Run(dir.path, manifest, error));
+
+    // Store a block before its parent, as a crash between the two writes
+    // of an out-of-order download would leave them.
+    uint256 parent, child;
+    size_t nCoinsBefore;
+    {
+        Chainstate chainstate(RegTestParams(), dir.path);
+        REQUIRE(chainstate.Load(error));
+        chainstate.Flush();
+        nCoinsBefore = chainstate.CoinsTip().GetCoinCount();
+        Block block = MineBlock(chainstate.Tip(), std::vector<TransactionRef>());
+        parent = block.GetHash();
+        BlockIndex indexParent(block);
+        indexParent.phashBlock = &parent;
+        indexParent.pprev = const_cast<BlockIndex*>(chainstate.Tip());
+        indexParent.nHeight = chainstate.Height() + 1;
+        Block next = MineBlock(&indexParent, std::vector<TransactionRef>());
+        child = next.GetHash();
+        FlatFilePos pos;
+        REQUIRE(chainstate.GetBlockStore().WriteBlock(next, pos));
+        REQUIRE(chainstate.GetBlockStore().WriteBlock(block, pos));
+    }
+
+    // A replay in file order meets the child first and leaves it out.
+    {
+        Chainstate chainstate(RegTestParams(), dir.path);
+        REQUIRE(chainstate.Load(error));
+        REQUIRE(chainstate.Tip()->GetBlockHash() == parent);
+        REQUIRE(chainstate.LookupBlockIndex(child) == NULL);
+    }
+
+    for (int fPipeline = 0; fPipeline < 2; fPipeline++) {
+        Chainstate chainstate(RegTestParams(), dir.path);
+        chainstate.SetReplayPipeline(fPipeline != 0);
+        chainstate.SetReindex(true);
+        REQUIRE(chainstate.Load(error));
+        REQUIRE(chainstate.Tip()->GetBlockHash() == child);
+        REQUIRE(chainstate.Height() == options.nHeight + 2);
+        REQUIRE(chainstate.GetConnectStats().nScriptChecked == (uint64_t)options.nHeight + 2);
+        chainstate.Flush();
+        REQUIRE(chainstate.CoinsTip().GetCoinCount() == nCoinsBefore + 2);
+    }
+
+    // Assume-valid finds its ancestors among the reindexed headers.
+    Chainstate chainstate(RegTestParams(), dir.path);
+    chainstate.SetReindex(true);
+    chainstate.SetAssumeValid(child);
+    REQUIRE(chainstate.Load(error));
+    REQUIRE(chainstate.Tip()->GetBlockHash() == child);
+    REQUIRE(chainstate.GetConnectStats().nScriptChecked == 0);
+    REQUIRE(chainstate.GetConnectStats().nAssumedValid == (uint64_t)options.nHeight + 2);
+}
+
+TEST_CASE( "ASSUME-VALID SKIPS SCRIPTS BELOW THE TRUSTED BLOCK", "[validation]" ) {
+    TempDir dir;
+    ChainGenOptions options;
+    options.seed = 4;
+    options.nHeight = 104;
+    options.nTxPerBlock = 10;
+    options.nKeys = 8;
+    ChainManifest manifest;
+    std::string error;
+    REQUIRE(ChainGenerator(RegTestParams(), options).Run(dir.path, manifest, error));
+
+    // Store a block spending a coinbase without a signature and a child of
+    // it, which could never be accepted on top of an invalid block.
+    uint256 invalid, child, middle;
+    {
+        Chainstate chainstate(RegTestParams(), dir.path);
+        REQUIRE(chainstate.Load(error));
+        REQUIRE(chainstate.GetConnectStats().nAssumedValid == 0);
+        REQUIRE(chainstate.GetConnectStats().nScriptChecked == (uint64_t)options.nHeight);
+        middle = chainstate.Tip()->GetAncestor(50)->GetBlockHash();
+
+        Block block = MineBlock(chainstate.Tip(), std::vector<TransactionRef>(1, Spend(CoinbaseAt(chainstate, 5), COIN)));
+        invalid = block.GetHash();
+        ValidationState state;
+        REQUIRE(!chainstate.ProcessNewBlock(block, state));
+
+        BlockIndex indexInvalid(block);
+        indexInvalid.phashBlock = &invalid;
+        indexInvalid.pprev = const_cast<BlockIndex*>(chainstate.Tip());
+        indexInvalid.nHeight = chainstate.Height() + 1;
+        Block next = MineBlock(&indexInvalid, std::vector<TransactionRef>());
+        child = next.GetHash();
+        FlatFilePos pos;
+        REQUIRE(chainstate.GetBlockStore().WriteBlock(next, pos));
+    }
+
+    for (int fPipeline = 0; fPipeline < 2; fPipeline++) {
+        Chainstate chainstate(RegTestParams(), dir.path);
+        chainstate.SetReplayPipeline(fPipeline != 0);
+        chainstate.SetAssumeValid(child);
+        REQUIRE(chainstate.Load(error));
+        REQUIRE(chainstate.Tip()->GetBlockHash() == child);
+        REQUIRE(chainstate.GetConnectStats().nScriptChecked == 0);
+        REQUIRE(chainstate.GetConnectStats().nAssumedValid == (uint64_t)options.nHeight + 2);
+    }
+
+    {
+        Chainstate chainstate(RegTestParams(), dir.path);
+        chainstate.SetAssumeValid(child);
+        REQUIRE(chainstate.Load(error));
+
+        // Spends are still checked: the unsigned spend cannot happen twice.
+        Block block = MineBlock(chainstate.Tip(), std::vector<TransactionRef>(1, Spend(CoinbaseAt(chainstate, 5), COIN)));
+        ValidationState state;
+        REQUIRE(!chainstate.ProcessNewBlock(block, state));
+        REQUIRE(state.GetRejectReason() == "bad-txns-inputs-missingorspent");
+
+        // New blocks are not below the assume-valid block.
+        block = MineBlock(chainstate.Tip(), std::vector<TransactionRef>(1, Spend(CoinbaseAt(chainstate, 6), COIN)));
+        state = ValidationState();
+        REQUIRE(!chainstate.ProcessNewBlock(block, state));
+        REQUIRE(state.GetRejectReason().find("mandatory-script-verify-flag-failed") == 0);
+    }
+
+    // Only the ancestors are assumed valid, and nothing without the setting.
+    Chainstate partial(RegTestParams(), dir.path);
+    partial.SetAssumeValid(middle);
+    REQUIRE(partial.Load(error));
+    REQUIRE(partial.Height() == options.nHeight);
+    REQUIRE(partial.GetConnectStats().nAssumedValid == 50);
+    REQUIRE(partial.GetConnectStats().nScriptChecked == (uint64_t)options.nHeight - 50);
+    REQUIRE((partial.LookupBlockIndex(invalid)->nStatus & BLOCK_FAILED_VALID) != 0);
+}
+
+TEST_CASE( "PARALLEL CONNECT MATCHES AN IN-ORDER ONE", "[validation]" ) {
+    TempDir dir;
+    Chainstate chainstate(RegTestParams(), dir.path);
+    chainstate.SetConnectThreads(1);
+    std::string error;
+    REQUIRE(chainstate.Load(error));
+    ValidationState state;
+    REQUIRE(GenerateBlocks(chainstate, Script() << OP_TRUE, COINBASE_MATURITY + 1, state).size() == 101);
+
+    const int nOutputs = 40;
+    MutableTransaction fan;
+    fan.vin.push_back(TxIn(CoinbaseAt(chainstate, 1)));
+    for (int i = 0; i < nOutputs; i++)
+        fan.vout.push_back(TxOut(COIN, Script() << OP_TRUE));
+    Block block = MineBlock(chainstate.Tip(), std::vector<TransactionRef>(1, MakeTransactionRef(fan)), 10 * COIN);
+    REQUIRE(chainstate.ProcessNewBlock(block, state));
+
+    // Independent payments plus a chain spending within the block.
+    std::vector<TransactionRef> txs;
+    for (int i = 0; i < nOutputs; i++)
+        txs.push_back(Spend(OutPoint(fan.GetHash(), i), COIN));
+    txs.push_back(Spend(OutPoint(txs[0]->GetHash(), 0), COIN));
+    txs.push_back(Spend(OutPoint(txs.back()->GetHash(), 0), COIN));
+
+    auto connect = [&](const Block& candidate, unsigned int nThreads, ValidationState& result, BlockUndo& undo,
+                       std::vector<Coin>& outputs) {
+        chainstate.SetConnectThreads(nThreads);
+        uint256 hash = candidate.GetHash();
+        BlockIndex index(candidate);
+        index.phashBlock = &hash;
+        index.pprev = const_cast<BlockIndex*>(chainstate.Tip());
+        index.nHeight = chainstate.Height() + 1;
+        CoinsViewCache view(&chainstate.CoinsTip());
+        bool ok = chainstate.ConnectBlock(candidate, result, &index, view, undo);
+        outputs.clear();
+        for (size_t i = 0; i < candidate.vtx.size(); i++) {
+            const Transaction& tx = *candidate.vtx[i];
+            for (size_t j = 0; j < tx.vin.size(); j++)
+                outputs.push_back(view.AccessCoin(tx.vin[j].prevout));
+            for (size_t j = 0; j < tx.vout.size(); j++)
+                outputs.push_back(view.AccessCoin(OutPoint(tx.GetHash(), (uint32_t)j)));
+        }
+        return ok;
+    };
+    auto requireSame = [&](const Block& candidate) {
+        ValidationState serialState, parallelState;
+        BlockUndo serialUndo, parallelUndo;
+        std::vector<Coin> serialCoins, parallelCoins;
+        bool fSerial = connect(candidate, 1, serialState, serialUndo, serialCoins);
+        bool fParallel = connect(candidate, 4, parallelState, parallelUndo, parallelCoins);
+        REQUIRE(fSerial == fParallel);
+        REQUIRE(serialState.GetRejectReason() == parallelState.GetRejectReason());
+        if (!fSerial)
+            return serialState.GetRejectReason();
+        REQUIRE(serialUndo.vtxundo.size() == parallelUndo.vtxundo.size());
+        for (size_t i = 0; i < serialUndo.vtxundo.size(); i++) {
+            const std::vector<Coin>& a = serialUndo.vtxundo[i].vprevout;
+            const std::vector<Coin>& b = parallelUndo.vtxundo[i].vprevout;
+            REQUIRE(a.size() == b.size());
+            for (size_t j = 0; j < a.size(); j++)
+                REQUIRE((a[j].out == b[j].out && a[j].nHeight == b[j].nHeight));
+        }
+        REQUIRE(serialCoins.size() == parallelCoins.size());
+        for (size_t i = 0; i < serialCoins.size(); i++)
+            REQUIRE((serialCoins[i].out == parallelCoins[i].out && serialCoins[i].nHeight == parallelCoins[i].nHeight));
+        return std::string();
+    };
+
+    REQUIRE(requireSame(MineBlock(chainstate.Tip(), txs)) == "");
+
+    // The earliest failing transaction decides the reason, whichever group
+    // finishes first.
+    std::vector<TransactionRef> bad(txs);
+    bad[24] = Spend(OutPoint(uint256::FromHex("0101010101010101010101010101010101010101010101010101010101010101"), 0), COIN);
+    REQUIRE(requireSame(MineBlock(chainstate.Tip(), bad)) == "bad-txns-inputs-missingorspent");
+    bad[9] = Spend(CoinbaseAt(chainstate, 60), COIN);
+    REQUIRE(requireSame(MineBlock(chainstate.Tip(), bad)) == "bad-txns-premature-spend-of-coinbase");
+
+    // Conflicting spends land in one group.
+    bad = txs;
+    bad[30] = Spend(OutPoint(fan.GetHash(), 3), 2 * COIN / 3);
+    REQUIRE(requireSame(MineBlock(chainstate.Tip(), bad)) == "bad-txns-inputs-missingorspent");
+
+    chainstate.SetConnectThreads(4);
+    REQUIRE(chainstate.ProcessNewBlock(MineBlock(chainstate.Tip(), txs), state));
+    REQUIRE(chainstate.Height() == 103);
+}
+
+TEST_CASE( "DEEP REORGS FLIP BETWEEN FORKS AND RESTORE THE COINS", "[validation]" ) {
+    TempDir dir;
+    Chainstate chainstate(RegTestParams(), dir.path);
+    std::string error;
+    REQUIRE(chainstate.Load(error));
+    ValidationState state;
+    REQUIRE(GenerateBlocks(chainstate, Script() << OP_TRUE, 110, state).size() == 110);
+    const BlockIndex* pindexFork = chainstate.Tip();
+
+    // Each fork pays a coinbase to P2SH outputs, which later blocks spend,
+    // so the undo data holds compressed templates.
+    Script redeem = Script() << OP_TRUE;
+    unsigned char redeemHash[20];
+    Hash160(redeem.data(), redeem.size(), redeemHash);
+    std::vector<unsigned char> redeemBytes(redeem.begin(), redeem.end());
+    auto extend = [&](const uint256& hashPrev, int nBlocks, const OutPoint& funding, int nFirst, uint256& hashTip) {
+        const BlockIndex* pindex = chainstate.LookupBlockIndex(hashPrev);
+        MutableTransaction fan;
+        fan.vin.push_back(TxIn(funding));
+        for (int i = 0; i < 40; i++)
+            fan.vout.push_back(TxOut(COIN, GetScriptForScriptHash(redeemHash)));
+        for (int i = 0; i < nBlocks; i++) {
+            std::vector<TransactionRef> txs;
+            if (nFirst == 0 && i == 0) {
+                txs.push_back(MakeTransactionRef(fan));
+            } else {
+                MutableTransaction spend;
+                spend.vin.push_back(TxIn(OutPoint(fan.GetHash(), nFirst + i)));
+                spend.vin[0].scriptSig = Script() << redeemBytes;
+                spend.vout.push_back(TxOut(COIN / 2, Script() << OP_TRUE));
+                txs.push_back(MakeTransactionRef(spend));
+            }
+            Block block = MineBlock(pindex, txs);
+            REQUIRE(chainstate.ProcessNewBlock(block, state));
+            pindex = chainstate.LookupBlockIndex(block.GetHash());
+        }
+        hashTip = pindex->GetBlockHash();
+        return fan.GetHash();
+    };
+
+    uint256 tipA, tipB;
+    uint256 fanA = extend(pindexFork->GetBlockHash(), 30, CoinbaseAt(chainstate, 1), 0, tipA);
+    REQUIRE(chainstate.Tip()->GetBlockHash() == tipA);
+    chainstate.Flush();
+    size_t nCoinsA = chainstate.CoinsTip().GetCoinCount();
+    uint64_t nChecked = chainstate.GetConnectStats().nScriptChecked;
+
+    // B overtakes A by one block, then A overtakes B, twice.
+    uint256 fanB = extend(pindexFork->GetBlockHash(), 31, CoinbaseAt(chainstate, 2), 0, tipB);
+    REQUIRE(chainstate.Tip()->GetBlockHash() == tipB);
+    REQUIRE(chainstate.Height() == 141);
+    REQUIRE(!chainstate.CoinsTip().HaveCoin(OutPoint(fanA, 5)));
+    REQUIRE(chainstate.CoinsTip().HaveCoin(CoinbaseAt(chainstate, 1)));
+    REQUIRE(chainstate.CoinsTip().HaveCoin(OutPoint(fanB, 35)));
+    REQUIRE(!chainstate.CoinsTip().HaveCoin(OutPoint(fanB, 5)));
+    chainstate.Flush();
+    size_t nCoinsB = chainstate.CoinsTip().GetCoinCount();
+
+    extend(tipA, 2, CoinbaseAt(chainstate, 1), 30, tipA);
+    REQUIRE(chainstate.Tip()->GetBlockHash() == tipA);
+    chainstate.Flush();
+    REQUIRE(chainstate.CoinsTip().GetCoinCount() == nCoinsA + 2);
+    REQUIRE(chainstate.CoinsTip().HaveCoin(OutPoint(fanA, 35)));
+    REQUIRE(!chainstate.CoinsTip().HaveCoin(OutPoint(fanA, 30)));
+    REQUIRE(!chainstate.CoinsTip().HaveCoin(CoinbaseAt(chainstate, 1)));
+
+    extend(tipB, 2, CoinbaseAt(chainstate, 2), 31, tipB);
+    REQUIRE(chainstate.Tip()->GetBlockHash() == tipB);
+    chainstate.Flush();
+    REQUIRE(chainstate.CoinsTip().GetCoinCount() == nCoinsB + 2);
+
+    // Blocks seen connected before skip their scripts the second time.
+    const ConnectStats& stats = chainstate.GetConnectStats();
+    REQUIRE(stats.nScriptChecked == nChecked + 31 + 2 + 2);
+    REQUIRE(stats.nReconnected == 30 + 31);
+}
+
+TEST_CASE( "FAILED BLOCKS AND THEIR DESCENDANTS ARE DROPPED BY HASH", "[validation]" ) {
+    TempDir dir;
+    Chainstate chainstate(RegTestParams(), dir.path);
+    std::string error;
+    REQUIRE(chainstate.Load(error));
+    ValidationState state;
+    REQUIRE(GenerateBlocks(chainstate, Script() << OP_TRUE, 110, state).size() == 110);
+
+    // A contextual failure never reaches the block index, yet is remembered.
+    Block bad = MineBlock(chainstate.Tip(), std::vector<TransactionRef>());
+    MutableTransaction coinbase(*bad.vtx[0]);
+    coinbase.vin[0].scriptSig = Script() << (int64_t)7 << OP_0;
+    bad.vtx[0] = MakeTransactionRef(coinbase);
+    Remine(bad);
+    REQUIRE(!chainstate.ProcessNewBlock(bad, state));
+    REQUIRE(state.GetRejectReason() == "bad-cb-height");
+    state = ValidationState();
+    REQUIRE(!chainstate.ProcessNewBlock(bad, state));
+    REQUIRE(state.GetRejectReason() == "duplicate-invalid");
+
+    // So is its child, once it shows proof of work.
+    Block child = MineBlock(chainstate.Tip(), std::vector<TransactionRef>());
+    child.hashPrevBlock = bad.GetHash();
+    while (CheckProofOfWork(child.GetHash(), child.nBits, RegTestParams().GetConsensus()))
+        child.nNonce++;
+    state = ValidationState();
+    REQUIRE(!chainstate.ProcessNewBlock(child, state));
+    REQUIRE(state.GetRejectReason() == "high-hash");
+    Remine(child);
+    state = ValidationState();
+    REQUIRE(!chainstate.ProcessNewBlock(child, state));
+    REQUIRE(state.GetRejectReason() == "bad-prevblk");
+    state = ValidationState();
+    REQUIRE(!chainstate.ProcessNewBlock(child, state));
+    REQUIRE(state.GetRejectReason() == "duplicate-invalid");
+
+    // A mutated copy of a valid block does not condemn the original.
+    std::vector<TransactionRef> txs;
+    txs.push_back(Spend(CoinbaseAt(chainstate, 5), 50 * COIN));
+    txs.push_back(Spend(CoinbaseAt(chainstate, 6), 50 * COIN));
+    Block valid = MineBlock(chainstate.Tip(), txs);
+    Block mutated = valid;
+    mutated.vtx.push_back(mutated.vtx.back());
+    REQUIRE(mutated.GetHash() == valid.GetHash());
+    state = ValidationState();
+    REQUIRE(!chainstate.ProcessNewBlock(mutated, state));
+    REQUIRE(state.GetRejectReason() == "bad-txns-duplicate");
+    REQUIRE(chainstate.ProcessNewBlock(valid, state));
+    const BlockIndex* pindexFork = chainstate.Tip();
+
+    // A fork whose first block spends a missing coin is stored while it has
+    // less work, then fails to connect once it overtakes: every block on it
+    // is marked, and later children are dropped unseen.
+    for (int i = 0; i < 3; i++)
+        REQUIRE(chainstate.ProcessNewBlock(MineBlock(chainstate.Tip(), std::vector<TransactionRef>()), state));
+    const BlockIndex* pindexMain = chainstate.Tip();
+    std::vector<uint256> fork;
+    const BlockIndex* pindex = pindexFork;
+    for (int i = 0; i < 4; i++) {
+        std::vector<TransactionRef> forkTxs;
+        if (i == 0)
+            forkTxs.push_back(Spend(OutPoint(uint256::FromHex("02"), 0), COIN));
+        Block block = MineBlock(pindex, forkTxs);
+        block.nTime++;
+        Remine(block);
+        state = ValidationState();
+        REQUIRE(chainstate.ProcessNewBlock(block, state) == (i < 3));
+        fork.push_back(block.GetHash());
+        pindex = chainstate.LookupBlockIndex(block.GetHash());
+        REQUIRE(pindex);
+    }
+    REQUIRE(state.GetRejectReason() == "bad-txns-inputs-missingorspent");
+    REQUIRE(chainstate.Tip() == pindexMain);
+    REQUIRE((chainstate.LookupBlockIndex(fork[0])->nStatus & BLOCK_FAILED_MASK) == BLOCK_FAILED_VALID);
+    for (size_t i = 1; i < fork.size(); i++)
+        REQUIRE((chainstate.LookupBlockIndex(fork[i])->nStatus & BLOCK_FAILED_MASK) == BLOCK_FAILED_CHILD);
+    for (const BlockIndex* pindexWalk = pindexMain; pindexWalk; pindexWalk = pindexWalk->pprev)
+        REQUIRE(!(pindexWalk->nStatus & BLOCK_FAILED_MASK));
+
+    size_t nIndexed = chainstate.BlockIndexSize();
+    Block next = MineBlock(pindex, std::vector<TransactionRef>());
+    state = ValidationState();
+    REQUIRE(!chainstate.ProcessNewBlock(next, state));
+    REQUIRE(state.GetRejectReason() == "bad-prevblk");
+    state = ValidationState();
+    REQUIRE(!chainstate.ProcessNewBlock(next, state));
+    REQUIRE(state.GetRejectReason() == "duplicate-invalid");
+    REQUIRE(chainstate.BlockIndexSize() == nIndexed);
+    REQUIRE(chainstate.Tip() == pindexMain);
+}
+
+TEST_CASE( "PRUNING KEEPS TO ITS BUDGET AND RELOADS FROM ITS CHECKPOINT", "[validation]" ) {
+    TempDir dir;
+    const unsigned int nFileSize = 4096;
+    const uint64_t nTarget = 16 << 10;
+    const int nKeep = 20;
+    OutPoint spendable;
+    uint256 tip;
+    int nPruneHeight;
+    {
+        Chainstate chainstate(RegTestParams(), dir.path);
+        chainstate.GetBlockStore().SetMaxFileSize(nFileSize);
+        chainstate.SetPruneTarget(nTarget, nKeep);
+        // Pruning runs when the coins are flushed.
+        chainstate.SetCoinsCacheLimit(20);
+        std::string error;
+        REQUIRE(chainstate.Load(error));
+        ValidationState state;
+        REQUIRE(GenerateBlocks(chainstate, Script() << OP_TRUE, 1, state).size() == 1);
+        spendable = CoinbaseAt(chainstate, 1);
+        REQUIRE(GenerateBlocks(chainstate, Script() << OP_TRUE, 149, state).size() == 149);
+        chainstate.GetBlockStore().WaitForPruning();
+
+        // Within budget, give or take the file being written, and the
+        // window of recent blocks is intact.
+        nPruneHeight = chainstate.GetPruneHeight();
+        REQUIRE(nPruneHeight > 0);
+        REQUIRE(nPruneHeight <= chainstate.Height() - nKeep);
+        REQUIRE(!chainstate.GetBlockStore().HaveFile(0));
+        uint64_t nBytes = 0;
+        std::vector<int> files = chainstate.GetBlockStore().ListFiles();
+        for (size_t i = 0; i < files.size(); i++)
+            nBytes += FileSize(chainstate.GetBlockStore().BlockFilePath(files[i])) +
+                      FileSize(chainstate.GetBlockStore().UndoFilePath(files[i]));
+        REQUIRE(nBytes <= nTarget + 2 * nFileSize);
+        for (const BlockIndex* pindex = chainstate.Tip(); pindex; pindex = pindex->pprev) {
+            bool fHaveData = (pindex->nStatus & BLOCK_HAVE_DATA) != 0;
+            if (pindex->nHeight > nPruneHeight)
+                REQUIRE(fHaveData);
+            if (!fHaveData)
+                REQUIRE(pindex->nHeight <= nPruneHeight);
+        }
+
+        // A fork from below the prune height cannot be activated, however
+        // much work it has.
+        const BlockIndex* pindexFork = chainstate.Tip()->GetAncestor(nPruneHeight - 1);
+        tip = chainstate.Tip()->GetBlockHash();
+        int nForkBlocks = chainstate.Height() - pindexFork->nHeight + 1;
+        for (int i = 0; i < nForkBlocks; i++) {
+            Block block = MineBlock(pindexFork, std::vector<TransactionRef>());
+            // Not the block the chain already has at this height.
+            block.nTime++;
+            Remine(block);
+            REQUIRE(chainstate.ProcessNewBlock(block, state));
+            pindexFork = chainstate.LookupBlockIndex(block.GetHash());
+        }
+        REQUIRE(pindexFork->nChainWork > chainstate.Tip()->nChainWork);
+        REQUIRE(chainstate.Tip()->GetBlockHash() == tip);
+        chainstate.Flush();
+    }
+
+    // The chain and its coins come back without the pruned files, and
+    // coins from pruned blocks can be spent.
+    Chainstate reloaded(RegTestParams(), dir.path);
+    reloaded.GetBlockStore().SetMaxFileSize(nFileSize);
+    reloaded.SetPruneTarget(nTarget, nKeep);
+    std::string error;
+    REQUIRE(reloaded.Load(error));
+    REQUIRE(reloaded.Tip()->GetBlockHash() == tip);
+    REQUIRE(reloaded.GetPruneHeight() >= nPruneHeight);
+    nPruneHeight = reloaded.GetPruneHeight();
+    reloaded.Flush();
+    REQUIRE(reloaded.CoinsTip().GetCoinCount() == 150);
+    REQUIRE(reloaded.CoinsTip().AccessCoin(spendable).out.nValue == 50 * COIN);
+    ValidationState state;
+    Block block = MineBlock(reloaded.Tip(), std::vector<TransactionRef>(1, Spend(spendable, 49 * COIN)), COIN);
+    REQUIRE(reloaded.ProcessNewBlock(block, state));
+    REQUIRE(reloaded.Tip()->GetBlockHash() == block.GetHash());
+    REQUIRE(GenerateBlocks(reloaded, Script() << OP_TRUE, 60, state).size() == 60);
+    // Nothing is pruned before the coins are flushed.
+    REQUIRE(reloaded.GetPruneHeight() == nPruneHeight);
+    reloaded.Flush();
+    reloaded.GetBlockStore().WaitForPruning();
+    REQUIRE(reloaded.GetPruneHeight() > nPruneHeight);
+    tip = reloaded.Tip()->GetBlockHash();
+
+    Chainstate again(RegTestParams(), dir.path);
+    REQUIRE(again.Load(error));
+    REQUIRE(again.Tip()->GetBlockHash() == tip);
+    again.Flush();
+    REQUIRE(again.CoinsTip().GetCoinCount() == 211);
+    REQUIRE(again.CoinsTip().AccessCoin(spendable).IsSpent());
+
+    // Shallow reorgs still find the block and undo data they need,
+    // including that of blocks restored from the checkpoint.
+    const BlockIndex* pindexFork = again.Tip()->GetAncestor(again.Height() - 5);
+    for (int i = 0; i < 6; i++) {
+        Block fork = MineBlock(pindexFork, std::vector<TransactionRef>());
+        fork.nTime++;
+        Remine(fork);
+        REQUIRE(again.ProcessNewBlock(fork, state));
+        pindexFork = again.LookupBlockIndex(fork.GetHash());
+    }
+    REQUIRE(again.Tip() == pindexFork);
+    again.Flush();
+    REQUIRE(again.CoinsTip().GetCoinCount() == 212);
+}
+
+TEST_CASE( "PRUNING WITH LSM COINS WRITES NO SNAPSHOT", "[validation]" ) {
+    TempDir dir;
+    uint256 tip;
+    for (int run = 0; run < 2; run++) {
+        Chainstate chainstate(RegTestParams(), dir.path);
+        chainstate.GetBlockStore().SetMaxFileSize(4096);
+        chainstate.SetCoinsBackend(COINS_BACKEND_LSM);
+        chainstate.SetPruneTarget(16 << 10, 20);
+        chainstate.SetCoinsCacheLimit(20);
+        std::string error;
+        REQUIRE(chainstate.Load(error));
+        if (run == 0) {
+            ValidationState state;
+            REQUIRE(GenerateBlocks(chainstate, Script() << OP_TRUE, 150, state).size() == 150);
+            chainstate.GetBlockStore().WaitForPruning();
+            REQUIRE(chainstate.GetPruneHeight() > 0);
+            REQUIRE(!chainstate.GetBlockStore().HaveFile(0));
+            tip = chainstate.Tip()->GetBlockHash();
+        } else {
+            // The store's own coins take the snapshot's place.
+            REQUIRE(chainstate.Tip()->GetBlockHash() == tip);
+            REQUIRE(chainstate.GetConnectStats().nScriptChecked == 0);
+            chainstate.Flush();
+            REQUIRE(chainstate.CoinsDB().GetCoinCount() == 150);
+        }
+        std::vector<std::string> names;
+        REQUIRE(ListDirectory(chainstate.GetBlockStore().Dir(), names));
+        for (size_t i = 0; i < names.size(); i++)
+            REQUIRE(names[i].find(".snapshot") == std::string::npos);
+    }
+}
+
+TEST_CASE( "BLOCK AND UNDO RECORDS CORRUPTED ON DISK READ AS MISSING", "[validation]" ) {
+    TempDir dir;
+    const BlockIndex* pindexSpend;
+    uint256 hashParent;
+    {
+        Chainstate chainstate(RegTestParams(), dir.path);
+        std::string error;
+        REQUIRE(chainstate.Load(error));
+        ValidationState state;
+        REQUIRE(GenerateBlocks(chainstate, Script() << OP_TRUE, COINBASE_MATURITY + 1, state).size() == 101);
+        TransactionRef spend = Spend(CoinbaseAt(chainstate, 1), COIN);
+        Block block = MineBlock(chainstate.Tip(), std::vector<TransactionRef>(1, spend), 49 * COIN);
+        REQUIRE(chainstate.ProcessNewBlock(block, state));
+        pindexSpend = chainstate.Tip();
+        hashParent = pindexSpend->pprev->GetBlockHash();
+        const BlockStore& store = chainstate.GetBlockStore();
+
+        Block read;
+        BlockUndo undo;
+        REQUIRE(store.ReadBlock(pindexSpend->blockPos, read));
+        REQUIRE(store.ReadUndo(pindexSpend->undoPos, pindexSpend->GetBlockHash(), undo));
+        // Undo data only applies to its own block.
+        REQUIRE(!store.ReadUndo(pindexSpend->undoPos, hashParent, undo));
+
+        // One flipped bit in each record's payload.
+        const FlatFilePos* positions[2] = {&pindexSpend->blockPos, &pindexSpend->undoPos};
+        for (int i = 0; i < 2; i++) {
+            std::string path = i == 0 ? store.BlockFilePath(positions[i]->nFile) :
+                                        store.UndoFilePath(positions[i]->nFile);
+            long nOffset = positions[i]->nPos + 4;
+            FILE* file = fopen(path.c_str(), "r+b");
+            REQUIRE(file);
+            REQUIRE(fseek(file, nOffset, SEEK_SET) == 0);
+            int c = fgetc(file);
+            REQUIRE(fseek(file, nOffset, SEEK_SET) == 0);
+            REQUIRE(fputc(c ^ 0x20, file) != EOF);
+            fclose(file);
+        }
+        REQUIRE(!store.ReadBlock(pindexSpend->blockPos, read));
+        REQUIRE(!store.ReadUndo(pindexSpend->undoPos, pindexSpend->GetBlockHash(), undo));
+    }
+
+    // The replay passes over the corrupt block as it would over garbage.
+    Chainstate chainstate(RegTestParams(), dir.path);
+    std::string error;
+    REQUIRE(chainstate.Load(error));
+    REQUIRE(chainstate.Tip()->GetBlockHash() == hashParent);
+}